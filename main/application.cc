@@ -11,6 +11,35 @@
 #include "assets/lang_config.h"
 #include "mcp_server.h"
 #include "audio_debugger.h"
+#include "audio_payload_pool.h"
+#include "pcm_kernels.h"
+#include "boot_profiler.h"
+#include "metrics.h"
+#include "audio_trace.h"
+#include "stall_detector.h"
+#include "power_governor.h"
+#include "audio_benchmark.h"
+#include "protocol_trace.h"
+#include "pooled_text.h"
+#include "hot_path_profile.h"
+#include "flash_guard.h"
+#include "task_stack.h"
+#include "timer_service.h"
+#include "task_manifest.h"
+#include "async_log.h"
+#include "memory_pressure.h"
+#include "performance_profile.h"
+#include "signal_levels.h"
+#if CONFIG_CRASH_RING
+#include "crash_ring.h"
+#endif
+#if CONFIG_THERMAL_GOVERNOR
+#include "thermal_governor.h"
+#include "led/led_effect.h"
+#endif
+#if CONFIG_QUICK_BOOT
+#include "quick_boot.h"
+#endif
 
 #if CONFIG_USE_AUDIO_PROCESSOR
 #include "afe_audio_processor.h"
@@ -27,6 +56,7 @@
 #endif
 
 #include <cstring>
+#include <algorithm>
 #include <esp_log.h>
 #include <cJSON.h>
 #include <driver/gpio.h>
@@ -34,6 +64,27 @@
 
 #define TAG "Application"
 
+static MetricGauge metric_send_queue("audio.send_queue");
+static MetricGauge metric_decode_queue("audio.decode_queue");
+#if CONFIG_AUDIO_DRIFT_COMPENSATION
+static MetricGauge metric_drift_ppm("audio.drift_ppm");
+#endif
+static MetricCounter metric_decode_failed("audio.decode_failed");
+#if CONFIG_OPUS_INBAND_FEC
+// 丢失的下行帧中用下一包的带内 FEC 恢复的
+static MetricCounter metric_fec_decoded("audio.fec_decoded");
+#endif
+static MetricHistogram metric_decode_us("audio.decode_us", METRIC_DURATION_US_BOUNDS);
+static MetricHistogram metric_encode_us("audio.encode_us", METRIC_DURATION_US_BOUNDS);
+static MetricGauge metric_encode_ring("audio.encode_ring");
+static MetricCounter metric_encode_overflows("audio.encode_overflows");
+static MetricHistogram metric_schedule_wait_us("main.schedule_wait_us", METRIC_DURATION_US_BOUNDS);
+static MetricCounter metric_schedule_heap("main.schedule_heap");
+static MetricCounter metric_schedule_overflow("main.schedule_overflow");
+static MetricCounter metric_output_prewarm("audio.output_prewarm");
+static MetricCounter metric_output_cold_start("audio.output_cold_start");
+// 从省电模式唤醒到进入聆听的耗时
+static MetricHistogram metric_wake_to_listen_us("power.wake_to_listen_us", METRIC_NETWORK_US_BOUNDS);
 
 static const char* const STATE_STRINGS[] = {
     "unknown",
@@ -46,13 +97,32 @@ static const char* const STATE_STRINGS[] = {
     "upgrading",
     "activating",
     "audio_testing",
+    "benchmarking",
     "fatal_error",
     "invalid_state"
 };
 
 Application::Application() {
     event_group_ = xEventGroupCreate();
+#if CONFIG_BACKGROUND_TASK_MULTI_WORKER
+    // 音频解码放在 core 1，界面更新和其它后台任务放在 core 0，界面更新不排在耗时的后台任务后面
+    auto& manifest = TaskManifest::GetInstance();
+    auto worker = [&manifest](TaskRole role, uint32_t lane_mask) {
+        auto& spec = manifest.Get(role);
+        return BackgroundWorkerConfig{spec.name, spec.stack_size, spec.priority, spec.core, lane_mask};
+    };
+    background_task_ = new BackgroundTask({
+        worker(kTaskAudioWorker, BACKGROUND_LANE_BIT(kBackgroundLaneDecode)),
+        worker(kTaskUiWorker, BACKGROUND_LANE_BIT(kBackgroundLaneUi)),
+        worker(kTaskBackground, BACKGROUND_LANE_BIT(kBackgroundLaneHousekeeping)),
+    });
+#else
     background_task_ = new BackgroundTask(4096 * 7);
+#endif
+    // 解码一次只有一帧在执行，编码在单独的任务里进行
+    background_task_->SetLaneLimit(kBackgroundLaneDecode, 2);
+    audio_send_queue_.SetTraceStage(kAudioTraceSendWait);
+    audio_decode_queue_.SetTraceStage(kAudioTraceDecodeWait);
 
 #if CONFIG_USE_DEVICE_AEC
     aec_mode_ = kAecOnDeviceSide;
@@ -62,13 +132,18 @@ Application::Application() {
     aec_mode_ = kAecOff;
 #endif
 
-#if CONFIG_USE_AUDIO_PROCESSOR
+#if CONFIG_USE_SHARED_AFE
+    afe_front_end_ = std::make_unique<AfeFrontEnd>();
+    audio_processor_ = std::make_unique<AfeAudioProcessor>(afe_front_end_.get());
+#elif CONFIG_USE_AUDIO_PROCESSOR
     audio_processor_ = std::make_unique<AfeAudioProcessor>();
 #else
     audio_processor_ = std::make_unique<NoAudioProcessor>();
 #endif
 
-#if CONFIG_USE_AFE_WAKE_WORD
+#if CONFIG_USE_SHARED_AFE
+    wake_word_ = std::make_unique<AfeWakeWord>(afe_front_end_.get());
+#elif CONFIG_USE_AFE_WAKE_WORD
     wake_word_ = std::make_unique<AfeWakeWord>();
 #elif CONFIG_USE_ESP_WAKE_WORD
     wake_word_ = std::make_unique<EspWakeWord>();
@@ -76,23 +151,29 @@ Application::Application() {
     wake_word_ = std::make_unique<NoWakeWord>();
 #endif
 
-    esp_timer_create_args_t clock_timer_args = {
+    // 每秒的时钟允许推迟 50ms，和其它定时器合并唤醒
+    clock_timer_ = TimerService::GetInstance().Create("clock_timer", [this]() {
+        OnClockTimer();
+    }, 50);
+
+    esp_timer_create_args_t drain_timer_args = {
         .callback = [](void* arg) {
             Application* app = (Application*)arg;
-            app->OnClockTimer();
+            xEventGroupSetBits(app->event_group_, SPEAKER_DRAINED_EVENT);
         },
         .arg = this,
         .dispatch_method = ESP_TIMER_TASK,
-        .name = "clock_timer",
+        .name = "drain_timer",
         .skip_unhandled_events = true
     };
-    esp_timer_create(&clock_timer_args, &clock_timer_handle_);
+    esp_timer_create(&drain_timer_args, &drain_timer_handle_);
 }
 
 Application::~Application() {
-    if (clock_timer_handle_ != nullptr) {
-        esp_timer_stop(clock_timer_handle_);
-        esp_timer_delete(clock_timer_handle_);
+    TimerService::GetInstance().Stop(clock_timer_);
+    if (drain_timer_handle_ != nullptr) {
+        esp_timer_stop(drain_timer_handle_);
+        esp_timer_delete(drain_timer_handle_);
     }
     if (background_task_ != nullptr) {
         delete background_task_;
@@ -133,8 +214,19 @@ void Application::CheckNewVersion(Ota& ota) {
         }
         retry_count = 0;
         retry_delay = 10; // 重置重试延迟时间
+#if CONFIG_QUICK_BOOT
+        QuickBoot::GetInstance().MarkVersionChecked();
+#endif
 
-        if (ota.HasNewVersion()) {
+        bool upgrade_now = ota.HasNewVersion();
+#if CONFIG_OTA_BACKGROUND_UPGRADE
+        // 先照常启动，新固件由后台任务下载
+        if (upgrade_now) {
+            upgrade_now = false;
+            StartBackgroundUpgrade();
+        }
+#endif
+        if (upgrade_now) {
             Alert(Lang::Strings::OTA_UPGRADE, Lang::Strings::UPGRADING, "happy", Lang::Sounds::P3_UPGRADE);
 
             vTaskDelay(pdMS_TO_TICKS(3000));
@@ -147,14 +239,16 @@ void Application::CheckNewVersion(Ota& ota) {
 
             auto& board = Board::GetInstance();
             board.SetPowerSaveMode(false);
+            // 模型可能还在 boot_init 任务中加载
+            xEventGroupWaitBits(event_group_, BOOT_INIT_DONE_EVENT, pdFALSE, pdFALSE, portMAX_DELAY);
             wake_word_->StopDetection();
             // 预先关闭音频输出，避免升级过程有音频操作
             auto codec = board.GetAudioCodec();
             codec->EnableInput(false);
             codec->EnableOutput(false);
             {
-                std::lock_guard<std::mutex> lock(mutex_);
-                audio_decode_queue_.clear();
+                std::lock_guard<std::mutex> lock(audio_decode_mutex_);
+                audio_decode_queue_.Clear();
             }
             background_task_->WaitForCompletion();
             delete background_task_;
@@ -175,7 +269,7 @@ void Application::CheckNewVersion(Ota& ota) {
             return;
         }
 
-        // No new version, mark the current version as valid
+        // No new version (or downloading in background), mark the current version as valid
         ota.MarkCurrentVersionValid();
         if (!ota.HasActivationCode() && !ota.HasActivationChallenge()) {
             xEventGroupSetBits(event_group_, CHECK_NEW_VERSION_DONE_EVENT);
@@ -208,10 +302,131 @@ void Application::CheckNewVersion(Ota& ota) {
     }
 }
 
+// 已经用缓存的配置启动，这里只更新配置；需要升级或重新激活时在空闲时重启，启动后按前台流程处理
+// 开启后台升级时新固件直接在这个任务中下载
+void Application::CheckNewVersionInBackground() {
+    const int MAX_RETRY = 10;
+    Ota ota;
+    int retry_delay = 10;
+    for (int retry_count = 0; !ota.CheckVersion(); retry_count++) {
+        if (retry_count + 1 >= MAX_RETRY) {
+            ESP_LOGE(TAG, "Too many retries, exit background version check");
+            return;
+        }
+        ESP_LOGW(TAG, "Background version check failed, retry in %d seconds", retry_delay);
+        vTaskDelay(pdMS_TO_TICKS(retry_delay * 1000));
+        retry_delay = std::min(retry_delay * 2, 600);
+    }
+#if CONFIG_QUICK_BOOT
+    QuickBoot::GetInstance().MarkVersionChecked();
+#endif
+
+    bool has_server_time = ota.HasServerTime();
+    Schedule([this, has_server_time]() {
+        has_server_time_ = has_server_time;
+    });
+
+    if (!ota.HasNewVersion() && !ota.HasActivationCode() && !ota.HasActivationChallenge()) {
+        ota.MarkCurrentVersionValid();
+        return;
+    }
+#if CONFIG_OTA_BACKGROUND_UPGRADE
+    if (!ota.HasActivationCode() && !ota.HasActivationChallenge()) {
+        ota.MarkCurrentVersionValid();
+        background_upgrade_started_ = true;
+        BackgroundUpgrade(ota);
+        return;
+    }
+#endif
+
+    ESP_LOGI(TAG, "New version or activation required, rebooting when idle");
+    while (true) {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+        if (device_state_ == kDeviceStateIdle) {
+            Schedule([this]() {
+                if (device_state_ == kDeviceStateIdle) {
+                    Reboot();
+                }
+            });
+            return;
+        }
+    }
+}
+
+#if CONFIG_OTA_BACKGROUND_UPGRADE
+void Application::StartBackgroundUpgrade() {
+    if (background_upgrade_started_) {
+        return;
+    }
+    background_upgrade_started_ = true;
+    // 前台的 Ota 对象在 Start 返回后就销毁了，后台任务重新检查一次版本
+    auto& spec = TaskManifest::GetInstance().Get(kTaskCheckVersion);
+    xTaskCreatePinnedToCore([](void* arg) {
+        Application* app = (Application*)arg;
+        app->CheckNewVersionInBackground();
+        vTaskDelete(NULL);
+    }, spec.name, spec.stack_size, this, spec.priority, nullptr, spec.core);
+}
+
+// 空闲时下载，设备开始使用时暂停；下载完成后在设定的时段空闲时重启生效
+void Application::BackgroundUpgrade(Ota& ota) {
+    const int MAX_RETRY = 5;
+    vTaskPrioritySet(NULL, 1);
+    ota.SetBackgroundMode([this]() {
+        return device_state_ != kDeviceStateIdle;
+    });
+
+    ESP_LOGI(TAG, "Downloading firmware %s in background", ota.GetFirmwareVersion().c_str());
+    int retry_delay = 60;
+    for (int retry_count = 0; ; ) {
+        while (device_state_ != kDeviceStateIdle) {
+            vTaskDelay(pdMS_TO_TICKS(1000));
+        }
+        if (ota.StartUpgrade(nullptr)) {
+            break;
+        }
+        // 被对话打断的不算失败，回到空闲后继续
+        if (device_state_ != kDeviceStateIdle) {
+            continue;
+        }
+        if (++retry_count >= MAX_RETRY) {
+            ESP_LOGE(TAG, "Background upgrade failed %d times, giving up", MAX_RETRY);
+            return;
+        }
+        ESP_LOGW(TAG, "Background upgrade failed, retry in %d seconds", retry_delay);
+        vTaskDelay(pdMS_TO_TICKS(retry_delay * 1000));
+        retry_delay = std::min(retry_delay * 4, 3600);
+    }
+
+    ESP_LOGI(TAG, "Firmware %s is ready, applying at hour %d when idle", ota.GetFirmwareVersion().c_str(),
+        CONFIG_OTA_UPGRADE_APPLY_HOUR);
+    while (true) {
+        vTaskDelay(pdMS_TO_TICKS(30000));
+        if (device_state_ != kDeviceStateIdle) {
+            continue;
+        }
+        if (CONFIG_OTA_UPGRADE_APPLY_HOUR >= 0 && has_server_time_) {
+            time_t now = time(NULL);
+            struct tm local;
+            localtime_r(&now, &local);
+            if (local.tm_hour != CONFIG_OTA_UPGRADE_APPLY_HOUR) {
+                continue;
+            }
+        }
+        Schedule([this]() {
+            if (device_state_ == kDeviceStateIdle) {
+                ESP_LOGI(TAG, "Rebooting to apply firmware upgrade");
+                Reboot();
+            }
+        });
+    }
+}
+#endif
+
 void Application::ShowActivationCode(const std::string& code, const std::string& message) {
     struct digit_sound {
         char digit;
-        const std::string_view& sound;
+        std::string_view sound;
     };
     static const std::array<digit_sound, 10> digit_sounds{{
         digit_sound{'0', Lang::Sounds::P3_0},
@@ -259,52 +474,296 @@ void Application::DismissAlert() {
     }
 }
 
-void Application::PlaySound(const std::string_view& sound) {
-    // Wait for the previous sound to finish
-    {
-        std::unique_lock<std::mutex> lock(mutex_);
-        audio_decode_cv_.wait(lock, [this]() {
-            return audio_decode_queue_.empty();
-        });
-    }
-    background_task_->WaitForCompletion();
-
-    const char* data = sound.data();
-    size_t size = sound.size();
-    for (const char* p = data; p < data + size; ) {
-        auto p3 = (BinaryProtocol3*)p;
-        p += sizeof(BinaryProtocol3);
+void Application::PlaySound(const std::string_view& sound, uint32_t start_ms) {
+    // 由音频任务在解码队列空闲时从 flash 中逐帧读取，这里不阻塞
+    // 有预解码 PCM 的提示音直接送入混音器，不占用提示音解码器
+    sound_player_.Enqueue(sound, start_ms);
+    NotifyAudioOutput();
+}
 
-        auto payload_size = ntohs(p3->payload_size);
-        AudioStreamPacket packet;
-        packet.sample_rate = 16000;
-        packet.frame_duration = 60;
-        packet.payload.resize(payload_size);
-        memcpy(packet.payload.data(), p3->payload, payload_size);
-        p += payload_size;
+#if CONFIG_SOUND_PARTITION_PLAYBACK
+int Application::PlayStoredSound(uint32_t start_ms) {
+    // 分区只映射一次，之后一直保留
+    static std::string_view sound = SoundPlayer::MapPartition(CONFIG_SOUND_PARTITION_LABEL);
+    P3File file;
+    if (sound.empty() || !file.Open(sound)) {
+        return -1;
+    }
+    sound_player_.Clear();
+    PlaySound(sound, start_ms);
+    return (int)file.duration_ms();
+}
+#endif
 
-        std::lock_guard<std::mutex> lock(mutex_);
-        audio_decode_queue_.emplace_back(std::move(packet));
+// 队列满时等待音频任务消费，不能在 audio_loop 中调用
+void Application::PushDecodeQueue(const uint8_t* payload, size_t size, int sample_rate, int frame_duration) {
+    std::unique_lock<std::mutex> lock(audio_decode_mutex_);
+    while (!audio_decode_queue_.Push(sample_rate, frame_duration, 0, payload, size)) {
+        if (audio_decode_queue_.empty()) {
+            ESP_LOGW(TAG, "Audio packet of %u bytes does not fit in the decode queue", size);
+            return;
+        }
+        audio_decode_cv_.wait_for(lock, std::chrono::milliseconds(OPUS_FRAME_DURATION_MS));
     }
+    NotifyAudioOutput();
 }
 
 void Application::EnterAudioTestingMode() {
     ESP_LOGI(TAG, "Entering audio testing mode");
+#if CONFIG_AUDIO_SELF_TEST
+    // 自检结束后在 FinishAudioSelfTest 中回到配网模式
+    SetDeviceState(kDeviceStateAudioTesting);
+    StartAudioSelfTest();
+#else
     ResetDecoder();
+    if (!audio_testing_queue_) {
+        audio_testing_queue_ = std::make_unique<AudioPacketQueue>(AUDIO_TESTING_MAX_DURATION_MS / OPUS_FRAME_DURATION_MS,
+            AUDIO_TESTING_QUEUE_BYTES);
+    }
     SetDeviceState(kDeviceStateAudioTesting);
+#endif
 }
 
 void Application::ExitAudioTestingMode() {
+#if CONFIG_AUDIO_SELF_TEST
+    if (audio_self_test_.active()) {
+        ESP_LOGI(TAG, "Audio self test is running");
+        return;
+    }
+#endif
     ESP_LOGI(TAG, "Exiting audio testing mode");
     SetDeviceState(kDeviceStateWifiConfiguring);
-    // Copy audio_testing_queue_ to audio_decode_queue_
-    std::lock_guard<std::mutex> lock(mutex_);
-    audio_decode_queue_ = std::move(audio_testing_queue_);
-    audio_decode_cv_.notify_all();
+    // Play back audio_testing_queue_ from the main loop, the decode queue is smaller than the recording
+    Schedule([this]() {
+        if (!audio_testing_queue_) {
+            return;
+        }
+        AudioStreamPacket packet;
+        while (audio_testing_queue_->Pop(packet)) {
+            PushDecodeQueue(packet.payload.data(), packet.payload.size(), packet.sample_rate, packet.frame_duration);
+        }
+    });
+}
+
+bool Application::StartTransportBenchmark(int frames_per_second, int duration_seconds) {
+    if (device_state_ != kDeviceStateIdle && device_state_ != kDeviceStateListening) {
+        ESP_LOGW(TAG, "Transport benchmark requires idle or listening state, current: %s", STATE_STRINGS[device_state_]);
+        return false;
+    }
+    if (!protocol_->IsAudioChannelOpened()) {
+        SetDeviceState(kDeviceStateConnecting);
+        if (!protocol_->OpenAudioChannel()) {
+            SetDeviceState(kDeviceStateIdle);
+            return false;
+        }
+    } else if (device_state_ == kDeviceStateListening) {
+        protocol_->SendStopListening();
+    }
+
+    audio_send_queue_.Clear();
+    uplink_retry_ = false;
+    SetDeviceState(kDeviceStateBenchmarking);
+    if (!transport_benchmark_.Start(Lang::Sounds::P3_ACTIVATION, frames_per_second, duration_seconds)) {
+        SetDeviceState(kDeviceStateIdle);
+        return false;
+    }
+    return true;
+}
+
+void Application::StopTransportBenchmark() {
+    transport_benchmark_.Stop();
+}
+
+#if CONFIG_AEC_CALIBRATION
+void Application::CalibrateAec() {
+    Schedule([this]() {
+        auto codec = Board::GetInstance().GetAudioCodec();
+        if (device_state_ != kDeviceStateIdle || aec_calibrator_.active()) {
+            ESP_LOGW(TAG, "AEC calibration needs idle state");
+            return;
+        }
+        // 录制从提示音开始播放时起算，回采通道先不做延迟，测到的是原始的对齐关系
+        bool started = aec_calibrator_.Start(codec->GetInputFormat(), [this](bool ok, const AecCalibration& calibration) {
+            Schedule([this, ok, calibration]() {
+                FinishAecCalibration(ok, calibration);
+            });
+        });
+        if (!started) {
+            return;
+        }
+        ESP_LOGI(TAG, "AEC calibration started");
+        reference_aligner_.Configure(codec->GetInputFormat(), 0);
+        wake_word_->StopDetection();
+        codec->EnableInput(true);
+        codec->EnableOutput(true);
+        audio_processor_->Start();
+        NotifyAudioInput();
+        PlaySound(Lang::Sounds::P3_ACTIVATION);
+    });
+}
+
+void Application::FinishAecCalibration(bool ok, const AecCalibration& calibration) {
+    auto codec = Board::GetInstance().GetAudioCodec();
+    AecCalibration saved;
+    if (ok) {
+        reference_aligner_.Configure(codec->GetInputFormat(), calibration.delay_samples);
+    } else if (AecCalibration::Load(saved)) {
+        // 这次没测到回声，继续用之前的结果
+        reference_aligner_.Configure(codec->GetInputFormat(), saved.delay_samples);
+    }
+    if (device_state_ == kDeviceStateIdle) {
+        audio_processor_->Stop();
+        wake_word_->StartDetection();
+    }
+}
+#endif
+
+#if CONFIG_AUDIO_SELF_TEST
+void Application::StartAudioSelfTest(std::function<void(const std::string& json)> callback) {
+    Schedule([this, callback = std::move(callback)]() {
+        bool testing = device_state_ == kDeviceStateAudioTesting;
+        if ((device_state_ != kDeviceStateIdle && !testing) || audio_self_test_.active()) {
+            ESP_LOGW(TAG, "Audio self test needs idle state");
+            if (callback) {
+                callback("{\"error\":\"Audio self test needs idle state\"}");
+            }
+            return;
+        }
+        auto codec = Board::GetInstance().GetAudioCodec();
+        ResetDecoder();
+        // 扫频包由自检任务送入解码队列，队列满时在那里等待播放任务消费
+        bool started = audio_self_test_.Start(codec, [this](const std::vector<std::vector<uint8_t>>& packets) {
+            for (auto& packet : packets) {
+                PushDecodeQueue(packet.data(), packet.size(), 16000, OPUS_FRAME_DURATION_MS);
+            }
+        }, [this, callback](const AudioSelfTestResult& result) {
+            Schedule([this, result]() {
+                FinishAudioSelfTest(result);
+            });
+            if (callback) {
+                callback(result.GetJson());
+            }
+        });
+        if (!started) {
+            if (callback) {
+                callback("{\"error\":\"Failed to start audio self test\"}");
+            }
+            return;
+        }
+        codec->EnableInput(true);
+        codec->EnableOutput(true);
+        // 配网模式下 AFE 可能还没有初始化，只测延迟、编解码和 I2S；空闲时运行 AFE 测量回声衰减
+        self_test_afe_ = !testing;
+        if (self_test_afe_) {
+            wake_word_->StopDetection();
+            audio_processor_->Start();
+        }
+        NotifyAudioInput();
+    });
+}
+
+void Application::FinishAudioSelfTest(const AudioSelfTestResult& result) {
+    if (self_test_afe_) {
+        self_test_afe_ = false;
+        if (device_state_ == kDeviceStateIdle) {
+            audio_processor_->Stop();
+            wake_word_->StartDetection();
+        }
+    }
+    if (device_state_ == kDeviceStateAudioTesting) {
+        SetDeviceState(kDeviceStateWifiConfiguring);
+    }
+    auto display = Board::GetInstance().GetDisplay();
+    display->SetChatMessage("system", result.GetSummary().c_str());
+}
+#endif
+
+#if CONFIG_AUDIO_LOOPBACK_TEST
+void Application::StartLoopbackTest() {
+    Schedule([this]() {
+        if (device_state_ != kDeviceStateIdle || loopback_test_) {
+            ESP_LOGW(TAG, "Loopback test needs idle state");
+            return;
+        }
+        std::string_view sound = Lang::Sounds::P3_ACTIVATION;
+        P3File file;
+        if (!file.Open(sound) || file.frame_count() == 0) {
+            ESP_LOGE(TAG, "No sound for loopback test");
+            return;
+        }
+        if (loopback_timer_ == nullptr) {
+            esp_timer_create_args_t args = {
+                .callback = [](void* arg) {
+                    auto app = (Application*)arg;
+                    app->Schedule([app]() {
+                        app->OnLoopbackTimer();
+                    });
+                },
+                .arg = this,
+                .dispatch_method = ESP_TIMER_TASK,
+                .name = "loopback_test",
+                .skip_unhandled_events = true,
+            };
+            esp_timer_create(&args, &loopback_timer_);
+        }
+
+        // 先开始采集和 AFE，留出一段静音作为噪声底，再播放测试音
+        ESP_LOGI(TAG, "Loopback test started, %lu ms", (unsigned long)file.duration_ms());
+        loopback_test_ = true;
+        loopback_playing_ = false;
+        loopback_sound_ms_ = file.duration_ms();
+        wake_word_->StopDetection();
+        auto codec = Board::GetInstance().GetAudioCodec();
+        codec->EnableInput(true);
+        codec->EnableOutput(true);
+        audio_processor_->Start();
+        audio_debugger_->Event("loopback_start");
+        NotifyAudioInput();
+        esp_timer_start_once(loopback_timer_, CONFIG_AUDIO_LOOPBACK_LEAD_MS * 1000);
+    });
+}
+
+void Application::OnLoopbackTimer() {
+    if (!loopback_test_) {
+        return;
+    }
+    if (loopback_playing_) {
+        StopLoopbackTest("loopback_end");
+        return;
+    }
+    if (sound_player_.IsPlaying()) {
+        // 其它提示音（例如启动完成的提示音）还没播完，重新计算静音段
+        audio_debugger_->Event("loopback_start");
+        esp_timer_start_once(loopback_timer_, CONFIG_AUDIO_LOOPBACK_LEAD_MS * 1000);
+        return;
+    }
+    loopback_playing_ = true;
+    audio_debugger_->Event("loopback_play");
+    PlaySound(Lang::Sounds::P3_ACTIVATION);
+    // 播放结束后再录一段，覆盖回声拖尾
+    esp_timer_start_once(loopback_timer_, (uint64_t)(loopback_sound_ms_ + CONFIG_AUDIO_LOOPBACK_TAIL_MS) * 1000);
+}
+
+void Application::StopLoopbackTest(const char* event) {
+    if (!loopback_test_) {
+        return;
+    }
+    esp_timer_stop(loopback_timer_);
+    audio_processor_->Stop();
+    audio_debugger_->Event(event);
+    loopback_test_ = false;
+    ESP_LOGI(TAG, "Loopback test finished: %s", event);
+    if (device_state_ == kDeviceStateIdle) {
+        wake_word_->StartDetection();
+    }
 }
+#endif
 
 void Application::ToggleChatState() {
-    if (device_state_ == kDeviceStateActivating) {
+    if (device_state_ == kDeviceStateBenchmarking) {
+        StopTransportBenchmark();
+        return;
+    } else if (device_state_ == kDeviceStateActivating) {
         SetDeviceState(kDeviceStateIdle);
         return;
     } else if (device_state_ == kDeviceStateWifiConfiguring) {
@@ -322,14 +781,14 @@ void Application::ToggleChatState() {
 
     if (device_state_ == kDeviceStateIdle) {
         Schedule([this]() {
+            auto mode = aec_mode_ == kAecOff ? kListeningModeAutoStop : kListeningModeRealtime;
             if (!protocol_->IsAudioChannelOpened()) {
-                SetDeviceState(kDeviceStateConnecting);
-                if (!protocol_->OpenAudioChannel()) {
+                if (!OpenAudioChannel(mode)) {
                     return;
                 }
             }
 
-            SetListeningMode(aec_mode_ == kAecOff ? kListeningModeAutoStop : kListeningModeRealtime);
+            SetListeningMode(mode);
         });
     } else if (device_state_ == kDeviceStateSpeaking) {
         Schedule([this]() {
@@ -337,11 +796,172 @@ void Application::ToggleChatState() {
         });
     } else if (device_state_ == kDeviceStateListening) {
         Schedule([this]() {
-            protocol_->CloseAudioChannel();
+            ParkAudioChannel();
         });
     }
 }
 
+// 握手期间就开始采集和编码，音频暂存在发送队列里（最多 AUDIO_QUEUE_DURATION_MS），
+// 主循环在发送 listen start 之后按顺序发出，唤醒后马上说话也不会丢掉开头
+bool Application::OpenAudioChannel(ListeningMode mode) {
+    SetDeviceState(kDeviceStateConnecting);
+    audio_send_queue_.Clear();
+    uplink_retry_ = false;
+    StartUplinkCapture(mode);
+    uplink_staging_ = true;
+
+    latency_tracer_.Mark(kLatencyConnectStart);
+#if CONFIG_DUAL_NETWORK_HOT_STANDBY
+    // 两种传输层在当前网络上的得分都超过阈值时，如果待机网络可用就在对话开始前换过去
+    int best_score = transport_policy_.Score(protocol_kind_);
+    int other_score = transport_policy_.Score(OtherTransport(protocol_kind_));
+    if (standby_protocol_ && other_score >= 0 && (best_score < 0 || other_score < best_score)) {
+        best_score = other_score;
+    }
+    if (best_score > CONFIG_DUAL_NETWORK_DEGRADED_SCORE_MS) {
+        ESP_LOGW(TAG, "Link degraded (score %d), try standby network", best_score);
+        SwitchNetwork(false);
+    }
+#endif
+#if CONFIG_ENABLE_PROTOCOL_FAILOVER
+    if (standby_protocol_ && transport_policy_.Choose(protocol_kind_) != protocol_kind_) {
+        ESP_LOGI(TAG, "Prefer %s by link quality", TransportKindName(OtherTransport(protocol_kind_)));
+        SwitchProtocol();
+    }
+    failover_armed_ = standby_protocol_ != nullptr;
+#endif
+    bool opened = OpenProtocolChannel();
+#if CONFIG_ENABLE_PROTOCOL_FAILOVER
+    failover_armed_ = false;
+    if (!opened && SwitchProtocol()) {
+        opened = OpenProtocolChannel();
+    }
+#endif
+#if CONFIG_PROTOCOL_FAILOVER_SWITCH_NETWORK
+    if (!opened) {
+        // 所有传输层都连续失败，可能是当前网络的问题，有备用网络的板子切换网络
+        // 待机网络已经注册时不用重启，马上在新网络上重新握手
+        bool all_failing = transport_policy_.failures(protocol_kind_) >= CONFIG_PROTOCOL_FAILOVER_SWITCH_FAILURES;
+        if (standby_protocol_) {
+            auto standby_kind = OtherTransport(protocol_kind_);
+            all_failing = all_failing && transport_policy_.failures(standby_kind) >= CONFIG_PROTOCOL_FAILOVER_SWITCH_FAILURES;
+        }
+        if (all_failing) {
+            ESP_LOGW(TAG, "All transports keep failing, switching network");
+            if (SwitchNetwork(true)) {
+                opened = OpenProtocolChannel();
+            }
+        }
+    }
+#endif
+    if (!opened) {
+        uplink_staging_ = false;
+        audio_processor_->Stop();
+        audio_send_queue_.Clear();
+        uplink_retry_ = false;
+    }
+    return opened;
+}
+
+// 打开当前协议的音频通道，握手时间记入链路质量统计
+bool Application::OpenProtocolChannel() {
+    int64_t start_time = esp_timer_get_time();
+    bool opened = protocol_->OpenAudioChannel();
+    int elapsed_ms = (esp_timer_get_time() - start_time) / 1000;
+    ESP_LOGI(TAG, "Audio channel handshake %s in %d ms, %u packets staged", opened ? "done" : "failed",
+        elapsed_ms, audio_send_queue_.size());
+#if CONFIG_ENABLE_PROTOCOL_FAILOVER
+    transport_policy_.OnHandshake(protocol_kind_, opened, elapsed_ms);
+#endif
+    return opened;
+}
+
+#if CONFIG_ENABLE_PROTOCOL_FAILOVER
+// 换用备用协议，原协议的通道先关闭，之后它的回调事件都会被忽略。只在主循环中调用
+bool Application::SwitchProtocol() {
+    if (!standby_protocol_) {
+        return false;
+    }
+    std::swap(protocol_, standby_protocol_);
+    protocol_kind_ = OtherTransport(protocol_kind_);
+    if (standby_protocol_->IsAudioChannelOpened()) {
+        standby_protocol_->CloseAudioChannel();
+    }
+    protocol_->SetUplinkFrameDuration(GetPreferredUplinkFrameDuration());
+    ESP_LOGI(TAG, "Switched to %s", TransportKindName(protocol_kind_));
+    return true;
+}
+
+// 会话中当前协议出错，在备用协议上重新握手并按原来的监听模式继续对话
+void Application::ResumeOnStandbyProtocol(ListeningMode mode) {
+    if (!failover_pending_) {
+        return;
+    }
+    transport_policy_.OnFailure(protocol_kind_);
+    SwitchProtocol();
+    failover_pending_ = false;
+    ResetDecoder();
+    if (!OpenAudioChannel(mode)) {
+        return;
+    }
+    SetListeningMode(mode);
+}
+#endif
+
+#if CONFIG_PROTOCOL_FAILOVER_SWITCH_NETWORK
+// 切换到备用网络，不需要重启时重新启动两个协议，让 MQTT 等长连接建立在新网络上。只在主循环中调用
+bool Application::SwitchNetwork(bool allow_restart) {
+    if (!Board::GetInstance().SwitchToBackupNetwork(allow_restart)) {
+        return false;
+    }
+    transport_policy_.Reset();
+    if (protocol_->IsAudioChannelOpened()) {
+        protocol_->CloseAudioChannel();
+    }
+    protocol_->Start();
+    if (standby_protocol_) {
+        if (standby_protocol_->IsAudioChannelOpened()) {
+            standby_protocol_->CloseAudioChannel();
+        }
+        standby_protocol_->Start();
+    }
+    return true;
+}
+#endif
+
+void Application::StartUplinkCapture(ListeningMode mode) {
+    // 编码器由编码任务在下一帧之前重置
+    uplink_frame_reset_ = true;
+#if CONFIG_UPLINK_VAD_GATE
+    // 设备端 AEC 会关闭 VAD，服务端 AEC 依赖逐帧对齐的时间戳，这两种情况不做门控
+    uplink_gate_.Reset(mode != kListeningModeManualStop && aec_mode_ == kAecOff);
+#else
+    uplink_gate_.Reset(false);
+#endif
+#if CONFIG_DEVICE_ENDPOINTING
+    // 只有自动停止模式由设备判断说完，设备端 AEC 会关闭 VAD
+    endpoint_detector_.Reset(mode == kListeningModeAutoStop && aec_mode_ != kAecOnDeviceSide);
+    endpoint_tick_ = -1;
+#endif
+    playout_clock_.ResetCapture();
+    audio_processor_->Start();
+    wake_word_->StopDetection();
+    NotifyAudioInput();
+}
+
+// 结束对话。开启了通道保温时只停止监听并保持连接，下次唤醒不用重新握手
+void Application::ParkAudioChannel() {
+#if CONFIG_AUDIO_CHANNEL_KEEP_WARM
+    if (protocol_->IsAudioChannelOpened()) {
+        ESP_LOGI(TAG, "Park audio channel for %d seconds", CONFIG_AUDIO_CHANNEL_PARK_SECONDS);
+        protocol_->SendStopListening();
+        SetDeviceState(kDeviceStateIdle);
+        return;
+    }
+#endif
+    protocol_->CloseAudioChannel();
+}
+
 void Application::StartListening() {
     if (device_state_ == kDeviceStateActivating) {
         SetDeviceState(kDeviceStateIdle);
@@ -359,8 +979,7 @@ void Application::StartListening() {
     if (device_state_ == kDeviceStateIdle) {
         Schedule([this]() {
             if (!protocol_->IsAudioChannelOpened()) {
-                SetDeviceState(kDeviceStateConnecting);
-                if (!protocol_->OpenAudioChannel()) {
+                if (!OpenAudioChannel(kListeningModeManualStop)) {
                     return;
                 }
             }
@@ -400,62 +1019,148 @@ void Application::StopListening() {
 }
 
 void Application::Start() {
+    auto& boot_profiler = BootProfiler::GetInstance();
     auto& board = Board::GetInstance();
+    boot_profiler.Mark("board_ready");
+    // 板子在构造函数中调整完任务清单后检查一次
+    TaskManifest::GetInstance().Validate();
+    PowerGovernor::GetInstance().Initialize();
     SetDeviceState(kDeviceStateStarting);
 
     /* Setup the display */
     auto display = board.GetDisplay();
+    boot_profiler.Mark("display_ready");
+    SubscribeMemoryPressure();
 
     /* Setup the audio codec */
     auto codec = board.GetAudioCodec();
-    opus_decoder_ = std::make_unique<OpusDecoderWrapper>(codec->output_sample_rate(), 1, OPUS_FRAME_DURATION_MS);
-    opus_encoder_ = std::make_unique<OpusEncoderWrapper>(16000, 1, OPUS_FRAME_DURATION_MS);
-    opus_encoder_->SetComplexity(0);
-    if (aec_mode_ != kAecOff) {
-        ESP_LOGI(TAG, "AEC mode: %d, setting opus encoder complexity to 0", aec_mode_);
-        opus_encoder_->SetComplexity(0);
-    } else {
-#if CONFIG_USE_AUDIO_PROCESSOR
-        ESP_LOGI(TAG, "Audio processor detected, setting opus encoder complexity to 5");
-        opus_encoder_->SetComplexity(5);
-#else
-        ESP_LOGI(TAG, "Audio processor not detected, setting opus encoder complexity to 0");
-        opus_encoder_->SetComplexity(0);
+    decoder_cache_.Configure(codec->output_sample_rate());
+    SetDecodeSampleRate(codec->output_sample_rate(), OPUS_FRAME_DURATION_MS);
+    // 提示音固定为 16kHz 60ms
+    prompt_decoder_ = std::make_unique<OpusDecoderWrapper>(16000, 1, 60);
+    if (codec->output_sample_rate() != 16000) {
+        prompt_resampler_.Configure(16000, codec->output_sample_rate());
+    }
+    audio_mixer_.Configure(codec->output_sample_rate() * OPUS_FRAME_DURATION_MS / 1000);
+    // 提示音播放时压低 TTS
+    audio_mixer_.SetDucked(kAudioSourceTts, true);
+    playout_clock_.Configure(codec->dma_desc_num() * AUDIO_CODEC_DMA_FRAME_NUM);
+#if CONFIG_SOUND_PCM_CACHE
+    // 常用的短提示音第一次播放后缓存解码结果
+    sound_player_.AddCacheable(Lang::Sounds::P3_POPUP);
+    sound_player_.AddCacheable(Lang::Sounds::P3_SUCCESS);
+    sound_player_.AddCacheable(Lang::Sounds::P3_EXCLAMATION);
 #endif
+#if CONFIG_SOUND_PCM_ASSETS
+    // 预解码的 PCM 按构建时的板级采样率生成，运行时采样率不同则仍播放 p3
+    if (codec->output_sample_rate() == Lang::Sounds::PCM_SAMPLE_RATE) {
+        for (auto& [sound, pcm] : Lang::Sounds::PCM_ASSETS) {
+            sound_player_.AddPcm(sound, pcm);
+        }
+    } else {
+        ESP_LOGW(TAG, "PCM sounds are %dHz but output is %dHz, use p3 instead",
+            Lang::Sounds::PCM_SAMPLE_RATE, codec->output_sample_rate());
     }
-
+#endif
     if (codec->input_sample_rate() != 16000) {
         input_resampler_.Configure(codec->input_sample_rate(), 16000);
         reference_resampler_.Configure(codec->input_sample_rate(), 16000);
     }
+#if AUDIO_PIPELINE_SPECIALIZED
+    board_pipeline_ = codec->input_sample_rate() == BoardAudioPipeline::kInputSampleRate
+        && codec->input_channels() == BoardAudioPipeline::kInputChannels
+        && codec->output_sample_rate() == BoardAudioPipeline::kOutputSampleRate;
+    if (!board_pipeline_) {
+        ESP_LOGW(TAG, "Codec is %dHz x%d / %dHz, not the board config, use the generic audio pipeline",
+            codec->input_sample_rate(), codec->input_channels(), codec->output_sample_rate());
+    }
+#endif
     codec->Start();
-
-#if CONFIG_USE_AUDIO_PROCESSOR
+#if CONFIG_AEC_CALIBRATION
+    // 用保存的校准结果对齐回采通道，AEC 从第一句话开始就不用重新估计延迟
+    AecCalibration calibration;
+    if (codec->input_reference() && AecCalibration::Load(calibration)) {
+        ESP_LOGI(TAG, "AEC reference delay %d samples", calibration.delay_samples);
+        reference_aligner_.Configure(codec->GetInputFormat(), calibration.delay_samples);
+    }
+#endif
+#if CONFIG_FLASH_GUARD
+    // 聆听时采集 DMA 很快就满；播放时只要 DMA 里缓冲的音频够覆盖一次擦写就不会欠载
+    FlashGuard::GetInstance().SetGapProbe([this, codec]() {
+        DeviceState state = device_state_;
+        if (state == kDeviceStateListening || state == kDeviceStateAudioTesting) {
+            return false;
+        }
+        if (state == kDeviceStateSpeaking) {
+            return !codec->output_enabled() || codec->output_drain_ms() >= FLASH_GUARD_MIN_BUFFERED_MS;
+        }
+        return true;
+    });
+#endif
+
+    // 编码器和唤醒词/AFE 模型只在开始采集后才需要，放到 core 1 上和联网、检查版本同时进行
+    auto& manifest = TaskManifest::GetInstance();
+    auto& boot_spec = manifest.Get(kTaskBootInit);
+    if (xTaskCreatePinnedToCore([](void* arg) {
+        Application* app = (Application*)arg;
+        app->InitializeAudioPipeline();
+        vTaskDelete(NULL);
+    }, boot_spec.name, boot_spec.stack_size, this, boot_spec.priority, nullptr, boot_spec.core) != pdPASS) {
+        InitializeAudioPipeline();
+    }
+    boot_profiler.Mark("codec_start");
+
+    // 采集和播放分成两个任务，采集由 I2S 读阻塞驱动，播放由解码队列的任务通知驱动
+    // 开启音频处理时绑定在 core 1，由任务清单决定
+    auto& input_spec = manifest.Get(kTaskAudioInput);
     xTaskCreatePinnedToCore([](void* arg) {
         Application* app = (Application*)arg;
-        app->AudioLoop();
+        app->AudioInputLoop();
         vTaskDelete(NULL);
-    }, "audio_loop", 4096 * 2, this, 8, &audio_loop_task_handle_, 1);
-#else
-    xTaskCreate([](void* arg) {
+    }, input_spec.name, input_spec.stack_size, this, input_spec.priority, &audio_input_task_handle_, input_spec.core);
+    auto& output_spec = manifest.Get(kTaskAudioOutput);
+    xTaskCreatePinnedToCore([](void* arg) {
         Application* app = (Application*)arg;
-        app->AudioLoop();
+        app->AudioOutputLoop();
         vTaskDelete(NULL);
-    }, "audio_loop", 4096 * 2, this, 8, &audio_loop_task_handle_);
-#endif
+    }, output_spec.name, output_spec.stack_size, this, output_spec.priority, &audio_output_task_handle_, output_spec.core);
 
     /* Start the clock timer to update the status bar */
-    esp_timer_start_periodic(clock_timer_handle_, 1000000);
+    TimerService::GetInstance().StartPeriodic(clock_timer_, 1000);
 
     /* Wait for the network to be ready */
     board.StartNetwork();
+    boot_profiler.Mark("network_up");
 
     // Update the status bar immediately to show the network state
     display->UpdateStatusBar(true);
 
     // Check for new firmware version or get the MQTT broker address
     Ota ota;
-    CheckNewVersion(ota);
+    bool check_in_background = false;
+#if CONFIG_USE_OTA_CONFIG_CACHE
+    // 上次的响应不需要升级或激活时直接用缓存的配置启动协议，版本检查放到后台
+    check_in_background = ota.LoadCachedResponse() && !ota.HasNewVersion()
+        && !ota.HasActivationCode() && !ota.HasActivationChallenge()
+        && (ota.HasMqttConfig() || ota.HasWebsocketConfig());
+#endif
+    bool skip_version_check = false;
+#if CONFIG_QUICK_BOOT
+    // 深度睡眠唤醒时距离上次检查不久，后台也不再检查，省掉一次 HTTPS 请求
+    auto& quick_boot = QuickBoot::GetInstance();
+    skip_version_check = check_in_background && quick_boot.active() && !quick_boot.VersionCheckDue();
+#endif
+    if (skip_version_check) {
+        ESP_LOGI(TAG, "Quick boot, using cached OTA config without version check");
+        xEventGroupSetBits(event_group_, CHECK_NEW_VERSION_DONE_EVENT);
+    } else if (check_in_background) {
+        ESP_LOGI(TAG, "Using cached OTA config, checking version in background");
+        xEventGroupSetBits(event_group_, CHECK_NEW_VERSION_DONE_EVENT);
+    } else {
+        CheckNewVersion(ota);
+    }
+
+    boot_profiler.Mark("ota_check_done");
 
     // Initialize the protocol
     display->SetStatus(Lang::Strings::LOADING_PROTOCOL);
@@ -465,183 +1170,93 @@ void Application::Start() {
     McpServer::GetInstance().AddCommonTools();
 #endif
 
+    RegisterMessageHandlers();
     if (ota.HasMqttConfig()) {
-        protocol_ = std::make_unique<MqttProtocol>();
+        protocol_kind_ = kTransportMqttUdp;
     } else if (ota.HasWebsocketConfig()) {
-        protocol_ = std::make_unique<WebsocketProtocol>();
+        protocol_kind_ = kTransportWebsocket;
     } else {
         ESP_LOGW(TAG, "No protocol specified in the OTA config, using MQTT");
-        protocol_ = std::make_unique<MqttProtocol>();
     }
+#if CONFIG_ENABLE_PROTOCOL_FAILOVER
+    transport_policy_.Load();
+    transport_policy_.LogStatus();
+    if (ota.HasMqttConfig() && ota.HasWebsocketConfig()) {
+        // 两种配置都有时按历史链路质量选择，另一种作为备用
+        protocol_kind_ = transport_policy_.Choose(protocol_kind_);
+        auto standby_kind = OtherTransport(protocol_kind_);
+        standby_protocol_ = CreateProtocol(standby_kind);
+        InitializeProtocol(*standby_protocol_);
+        ESP_LOGI(TAG, "Using %s, standby %s", TransportKindName(protocol_kind_), TransportKindName(standby_kind));
+    }
+#endif
+    protocol_ = CreateProtocol(protocol_kind_);
+    InitializeProtocol(*protocol_);
 
-    protocol_->OnNetworkError([this](const std::string& message) {
-        SetDeviceState(kDeviceStateIdle);
-        Alert(Lang::Strings::ERROR, message.c_str(), "sad", Lang::Sounds::P3_EXCLAMATION);
-    });
-    protocol_->OnIncomingAudio([this](AudioStreamPacket&& packet) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (device_state_ == kDeviceStateSpeaking && audio_decode_queue_.size() < MAX_AUDIO_PACKETS_IN_QUEUE) {
-            audio_decode_queue_.emplace_back(std::move(packet));
-        }
-    });
-    protocol_->OnAudioChannelOpened([this, codec, &board]() {
-        board.SetPowerSaveMode(false);
-        if (protocol_->server_sample_rate() != codec->output_sample_rate()) {
-            ESP_LOGW(TAG, "Server sample rate %d does not match device output sample rate %d, resampling may cause distortion",
-                protocol_->server_sample_rate(), codec->output_sample_rate());
-        }
-
-#if CONFIG_IOT_PROTOCOL_XIAOZHI
-        auto& thing_manager = iot::ThingManager::GetInstance();
-        protocol_->SendIotDescriptors(thing_manager.GetDescriptorsJson());
-        std::string states;
-        if (thing_manager.GetStatesJson(states, false)) {
-            protocol_->SendIotStates(states);
+    // 基准测试的包在 esp_timer 任务中入队，测试期间没有编码任务产生上行音频
+    transport_benchmark_.OnSend([this](const AudioStreamPacket& packet) {
+        if (!audio_send_queue_.Push(packet)) {
+            return false;
         }
-#endif
+        xEventGroupSetBits(event_group_, SEND_AUDIO_EVENT);
+        return true;
     });
-    protocol_->OnAudioChannelClosed([this, &board]() {
-        board.SetPowerSaveMode(true);
+    transport_benchmark_.OnFinished([this]() {
+        // 通道保持打开，服务器还要通过 MCP 取回结果，之后由服务器断开
         Schedule([this]() {
-            auto display = Board::GetInstance().GetDisplay();
-            display->SetChatMessage("system", "");
-            SetDeviceState(kDeviceStateIdle);
-        });
-    });
-    protocol_->OnIncomingJson([this, display](const cJSON* root) {
-        // Parse JSON data
-        auto type = cJSON_GetObjectItem(root, "type");
-        if (strcmp(type->valuestring, "tts") == 0) {
-            auto state = cJSON_GetObjectItem(root, "state");
-            if (strcmp(state->valuestring, "start") == 0) {
-                Schedule([this]() {
-                    aborted_ = false;
-                    if (device_state_ == kDeviceStateIdle || device_state_ == kDeviceStateListening) {
-                        SetDeviceState(kDeviceStateSpeaking);
-                    }
-                });
-            } else if (strcmp(state->valuestring, "stop") == 0) {
-                Schedule([this]() {
-                    background_task_->WaitForCompletion();
-                    if (device_state_ == kDeviceStateSpeaking) {
-                        if (listening_mode_ == kListeningModeManualStop) {
-                            SetDeviceState(kDeviceStateIdle);
-                        } else {
-                            SetDeviceState(kDeviceStateListening);
-                        }
-                    }
-                });
-            } else if (strcmp(state->valuestring, "sentence_start") == 0) {
-                auto text = cJSON_GetObjectItem(root, "text");
-                if (cJSON_IsString(text)) {
-                    ESP_LOGI(TAG, "<< %s", text->valuestring);
-                    Schedule([this, display, message = std::string(text->valuestring)]() {
-                        display->SetChatMessage("assistant", message.c_str());
-                    });
-                }
-            }
-        } else if (strcmp(type->valuestring, "stt") == 0) {
-            auto text = cJSON_GetObjectItem(root, "text");
-            if (cJSON_IsString(text)) {
-                ESP_LOGI(TAG, ">> %s", text->valuestring);
-                Schedule([this, display, message = std::string(text->valuestring)]() {
-                    display->SetChatMessage("user", message.c_str());
-                });
-            }
-        } else if (strcmp(type->valuestring, "llm") == 0) {
-            auto emotion = cJSON_GetObjectItem(root, "emotion");
-            if (cJSON_IsString(emotion)) {
-                Schedule([this, display, emotion_str = std::string(emotion->valuestring)]() {
-                    display->SetEmotion(emotion_str.c_str());
-                });
-            }
-#if CONFIG_IOT_PROTOCOL_MCP
-        } else if (strcmp(type->valuestring, "mcp") == 0) {
-            auto payload = cJSON_GetObjectItem(root, "payload");
-            if (cJSON_IsObject(payload)) {
-                McpServer::GetInstance().ParseMessage(payload);
-            }
-#endif
-#if CONFIG_IOT_PROTOCOL_XIAOZHI
-        } else if (strcmp(type->valuestring, "iot") == 0) {
-            auto commands = cJSON_GetObjectItem(root, "commands");
-            if (cJSON_IsArray(commands)) {
-                auto& thing_manager = iot::ThingManager::GetInstance();
-                for (int i = 0; i < cJSON_GetArraySize(commands); ++i) {
-                    auto command = cJSON_GetArrayItem(commands, i);
-                    thing_manager.Invoke(command);
-                }
-            }
-#endif
-        } else if (strcmp(type->valuestring, "system") == 0) {
-            auto command = cJSON_GetObjectItem(root, "command");
-            if (cJSON_IsString(command)) {
-                ESP_LOGI(TAG, "System command: %s", command->valuestring);
-                if (strcmp(command->valuestring, "reboot") == 0) {
-                    // Do a reboot if user requests a OTA update
-                    Schedule([this]() {
-                        Reboot();
-                    });
-                } else {
-                    ESP_LOGW(TAG, "Unknown system command: %s", command->valuestring);
-                }
-            }
-        } else if (strcmp(type->valuestring, "alert") == 0) {
-            auto status = cJSON_GetObjectItem(root, "status");
-            auto message = cJSON_GetObjectItem(root, "message");
-            auto emotion = cJSON_GetObjectItem(root, "emotion");
-            if (cJSON_IsString(status) && cJSON_IsString(message) && cJSON_IsString(emotion)) {
-                Alert(status->valuestring, message->valuestring, emotion->valuestring, Lang::Sounds::P3_VIBRATION);
-            } else {
-                ESP_LOGW(TAG, "Alert command requires status, message and emotion");
+            if (device_state_ == kDeviceStateBenchmarking) {
+                SetDeviceState(kDeviceStateIdle);
             }
-        } else {
-            ESP_LOGW(TAG, "Unknown message type: %s", type->valuestring);
-        }
+        });
     });
+
     bool protocol_started = protocol_->Start();
+    boot_profiler.Mark("protocol_started");
+    ProtocolTrace::StartReplay();
 
     audio_debugger_ = std::make_unique<AudioDebugger>();
-    audio_processor_->Initialize(codec);
-    audio_processor_->OnOutput([this](std::vector<int16_t>&& data) {
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            if (audio_send_queue_.size() >= MAX_AUDIO_PACKETS_IN_QUEUE) {
-                ESP_LOGW(TAG, "Too many audio packets in queue, drop the newest packet");
-                return;
-            }
+    // 回调注册和开始检测要等模型加载完成
+    xEventGroupWaitBits(event_group_, BOOT_INIT_DONE_EVENT, pdTRUE, pdFALSE, portMAX_DELAY);
+    audio_processor_->OnOutput([this](std::span<const int16_t> data) {
+        audio_debugger_->Write(kAudioDebugAfeOutput, data, 16000);
+#if CONFIG_AUDIO_SELF_TEST
+        if (audio_self_test_.active()) {
+            audio_self_test_.FeedProcessed(data);
+            return;
         }
-        background_task_->Schedule([this, data = std::move(data)]() mutable {
-            opus_encoder_->Encode(std::move(data), [this](std::vector<uint8_t>&& opus) {
-                AudioStreamPacket packet;
-                packet.payload = std::move(opus);
-#ifdef CONFIG_USE_SERVER_AEC
-                {
-                    std::lock_guard<std::mutex> lock(timestamp_mutex_);
-                    if (!timestamp_queue_.empty()) {
-                        packet.timestamp = timestamp_queue_.front();
-                        timestamp_queue_.pop_front();
-                    } else {
-                        packet.timestamp = 0;
-                    }
-
-                    if (timestamp_queue_.size() > 3) { // 限制队列长度3
-                        timestamp_queue_.pop_front(); // 该包发送前先出队保持队列长度
-                        return;
-                    }
-                }
 #endif
-                std::lock_guard<std::mutex> lock(mutex_);
-                if (audio_send_queue_.size() >= MAX_AUDIO_PACKETS_IN_QUEUE) {
-                    ESP_LOGW(TAG, "Too many audio packets in queue, drop the oldest packet");
-                    audio_send_queue_.pop_front();
-                }
-                audio_send_queue_.emplace_back(std::move(packet));
-                xEventGroupSetBits(event_group_, SEND_AUDIO_EVENT);
+#if CONFIG_AUDIO_LOOPBACK_TEST
+        if (loopback_test_) {
+            return;
+        }
+#endif
+#if CONFIG_AEC_CALIBRATION
+        if (aec_calibrator_.active()) {
+            return;
+        }
+#endif
+#if CONFIG_DEVICE_ENDPOINTING
+        if (endpoint_detector_.triggered()) {
+            // 已经发送 listen stop，尾部的静音不再上传
+            return;
+        }
+        if (endpoint_detector_.Process(data.size())) {
+            audio_debugger_->Event("endpoint");
+            Schedule([this]() {
+                OnEndpoint();
             });
+        }
+#endif
+        uplink_gate_.Process(data, [this](std::span<const int16_t> data, uint32_t timestamp, bool onset) {
+            EncodeUplinkAudio(data, timestamp, onset);
         });
     });
     audio_processor_->OnVadStateChange([this](bool speaking) {
+        audio_debugger_->Event(speaking ? "vad_speech" : "vad_silence");
+        uplink_gate_.OnVadStateChange(speaking);
+#if CONFIG_DEVICE_ENDPOINTING
+        endpoint_detector_.OnVadStateChange(speaking);
+#endif
         if (device_state_ == kDeviceStateListening) {
             Schedule([this, speaking]() {
                 if (speaking) {
@@ -655,33 +1270,34 @@ void Application::Start() {
         }
     });
 
-    wake_word_->Initialize(codec);
     wake_word_->OnWakeWordDetected([this](const std::string& wake_word) {
+        audio_debugger_->Event("wake_word");
         Schedule([this, &wake_word]() {
             if (!protocol_) {
                 return;
             }
 
             if (device_state_ == kDeviceStateIdle) {
+                latency_tracer_.BeginTurn();
+                latency_tracer_.Mark(kLatencyWakeWord);
                 wake_word_->EncodeWakeWordData();
 
+                auto mode = aec_mode_ == kAecOff ? kListeningModeAutoStop : kListeningModeRealtime;
                 if (!protocol_->IsAudioChannelOpened()) {
-                    SetDeviceState(kDeviceStateConnecting);
-                    if (!protocol_->OpenAudioChannel()) {
+                    if (!OpenAudioChannel(mode)) {
                         wake_word_->StartDetection();
+                        NotifyAudioInput();
                         return;
                     }
                 }
 
                 ESP_LOGI(TAG, "Wake word detected: %s", wake_word.c_str());
 #if CONFIG_USE_AFE_WAKE_WORD
-                AudioStreamPacket packet;
-                // Encode and send the wake word data to the server
-                while (wake_word_->GetWakeWordOpus(packet.payload)) {
-                    protocol_->SendAudio(packet);
-                }
-                // Set the chat state to wake word detected
-                protocol_->SendWakeWordDetected(wake_word);
+                // 唤醒词音频边编码边在 SEND_AUDIO_EVENT 中发送，发完后再发 detect 消息，
+                // 期间聆听的实时音频在发送队列中排在后面
+                wake_word_upload_ = true;
+                wake_word_upload_word_ = wake_word;
+                xEventGroupSetBits(event_group_, SEND_AUDIO_EVENT);
 #else
                 // Play the pop up sound to indicate the wake word is detected
                 // And wait 60ms to make sure the queue has been processed by audio task
@@ -689,7 +1305,7 @@ void Application::Start() {
                 PlaySound(Lang::Sounds::P3_POPUP);
                 vTaskDelay(pdMS_TO_TICKS(60));
 #endif
-                SetListeningMode(aec_mode_ == kAecOff ? kListeningModeAutoStop : kListeningModeRealtime);
+                SetListeningMode(mode);
             } else if (device_state_ == kDeviceStateSpeaking) {
                 AbortSpeaking(kAbortReasonWakeWordDetected);
             } else if (device_state_ == kDeviceStateActivating) {
@@ -697,14 +1313,34 @@ void Application::Start() {
             }
         });
     });
+    wake_word_->OnWakeWordOpusEncoded([this]() {
+        xEventGroupSetBits(event_group_, SEND_AUDIO_EVENT);
+    });
+    wake_word_->OnCommandDetected([this](LocalCommand command) {
+        audio_debugger_->Event("local_command");
+        Schedule([this, command]() {
+            ExecuteLocalIntent({command}, "");
+        });
+    });
     wake_word_->StartDetection();
+    NotifyAudioInput();
 
     // Wait for the new version check to finish
     xEventGroupWaitBits(event_group_, CHECK_NEW_VERSION_DONE_EVENT, pdTRUE, pdFALSE, portMAX_DELAY);
     SetDeviceState(kDeviceStateIdle);
 
     has_server_time_ = ota.HasServerTime();
-    if (protocol_started) {
+    bool resume_chat = false;
+#if CONFIG_QUICK_BOOT
+    // 用户按键唤醒是为了说话，不播放启动提示，直接进入聆听
+    resume_chat = protocol_started && quick_boot.active() && quick_boot.woken_by_user();
+#endif
+    if (resume_chat) {
+        display->SetChatMessage("system", "");
+        Schedule([this]() {
+            ToggleChatState();
+        });
+    } else if (protocol_started) {
         std::string message = std::string(Lang::Strings::VERSION) + ota.GetCurrentVersion();
         display->ShowNotification(message.c_str());
         display->SetChatMessage("system", "");
@@ -713,24 +1349,432 @@ void Application::Start() {
         PlaySound(Lang::Sounds::P3_SUCCESS);
     }
 
+    if (check_in_background && !skip_version_check) {
+        auto& spec = TaskManifest::GetInstance().Get(kTaskCheckVersion);
+        xTaskCreatePinnedToCore([](void* arg) {
+            Application* app = (Application*)arg;
+            app->CheckNewVersionInBackground();
+            vTaskDelete(NULL);
+        }, spec.name, spec.stack_size, this, spec.priority, nullptr, spec.core);
+    }
+
+    boot_profiler.Mark("ready");
+    boot_profiler.LogReport();
+
     // Print heap stats
     SystemInfo::PrintHeapStats();
+
+#if CONFIG_ENABLE_AUDIO_BENCHMARK
+    AudioBenchmark::RunInBackground();
+#endif
+#if CONFIG_AUDIO_LOOPBACK_ON_BOOT
+    StartLoopbackTest();
+#endif
     
     // Enter the main event loop
     MainEventLoop();
 }
 
+// 启动阶段在 boot_init 任务中的部分：创建编码器，加载 AFE 和唤醒词模型
+void Application::InitializeAudioPipeline() {
+    auto codec = Board::GetInstance().GetAudioCodec();
+    opus_encoder_ = std::make_unique<OpusStreamEncoder>(16000, 1, OPUS_FRAME_DURATION_MS);
+    int complexity = 0;
+    if (aec_mode_ != kAecOff) {
+        ESP_LOGI(TAG, "AEC mode: %d, setting opus encoder complexity to 0", aec_mode_);
+    } else {
+#if CONFIG_USE_AUDIO_PROCESSOR
+        ESP_LOGI(TAG, "Audio processor detected, setting opus encoder complexity to 5");
+        complexity = 5;
+#else
+        ESP_LOGI(TAG, "Audio processor not detected, setting opus encoder complexity to 0");
+#endif
+    }
+    auto& performance = PerformanceProfile::GetInstance();
+    complexity = performance.Get(kPerfOpusComplexity, complexity);
+#if CONFIG_OPUS_ENCODER_ADAPTIVE
+    // 运行时根据编码耗时和发送队列调整，初始值同上
+    encoder_controller_.Configure(complexity, performance.Get(kPerfOpusMaxComplexity, CONFIG_OPUS_ENCODER_MAX_COMPLEXITY), true);
+#else
+    encoder_controller_.Configure(complexity, complexity, true);
+#endif
+    encoder_controller_.Apply(*opus_encoder_);
+    // 编码任务默认放在 core 0，和 core 1 上的 AFE、采集任务错开，提高编码复杂度不会挤占 AEC/NS
+    auto& encoder_spec = TaskManifest::GetInstance().Get(kTaskAudioEncoder);
+    xTaskCreatePinnedToCore([](void* arg) {
+        Application* app = (Application*)arg;
+        app->AudioEncodeLoop();
+        vTaskDelete(NULL);
+    }, encoder_spec.name, encoder_spec.stack_size, this, encoder_spec.priority, &audio_encode_task_handle_,
+        encoder_spec.core);
+
+    audio_processor_->Initialize(codec);
+    wake_word_->Initialize(codec);
+    BootProfiler::GetInstance().Mark("wake_word_ready");
+    xEventGroupSetBits(event_group_, BOOT_INIT_DONE_EVENT);
+}
+
+std::unique_ptr<Protocol> Application::CreateProtocol(TransportKind kind) {
+    if (kind == kTransportWebsocket) {
+        return std::make_unique<WebsocketProtocol>();
+    }
+    return std::make_unique<MqttProtocol>();
+}
+
+// 注册协议回调，当前协议和备用协议共用同一套回调，回调中总是操作 protocol_
+void Application::InitializeProtocol(Protocol& protocol) {
+    auto& board = Board::GetInstance();
+    auto codec = board.GetAudioCodec();
+    protocol.SetUplinkFrameDuration(GetPreferredUplinkFrameDuration());
+#if CONFIG_USE_DESCRIPTOR_CACHE
+    {
+        std::string iot_hash;
+        std::string mcp_hash;
+#if CONFIG_IOT_PROTOCOL_XIAOZHI
+        iot_hash = iot::ThingManager::GetInstance().GetDescriptorsHash();
+#endif
+#if CONFIG_IOT_PROTOCOL_MCP
+        mcp_hash = McpServer::GetInstance().GetToolsHash();
+#endif
+        protocol.SetDescriptorHashes(iot_hash, mcp_hash);
+    }
+#endif
+
+    protocol.OnNetworkError([this, &protocol](const std::string& message) {
+        // 切换后备用协议的迟到事件不影响当前会话
+        if (&protocol != protocol_.get()) {
+            return;
+        }
+#if CONFIG_ENABLE_PROTOCOL_FAILOVER
+        if (failover_armed_) {
+            // OpenAudioChannel 会换备用协议重试
+            ESP_LOGW(TAG, "Handshake on %s failed: %s", TransportKindName(protocol_kind_), message.c_str());
+            return;
+        }
+        if (standby_protocol_ && (device_state_ == kDeviceStateListening || device_state_ == kDeviceStateSpeaking)) {
+            if (!failover_pending_) {
+                failover_pending_ = true;
+                ESP_LOGW(TAG, "Network error on %s: %s, failing over", TransportKindName(protocol_kind_), message.c_str());
+                Schedule([this, mode = listening_mode_]() {
+                    ResumeOnStandbyProtocol(mode);
+                });
+            }
+            return;
+        }
+#endif
+        SetDeviceState(kDeviceStateIdle);
+        Alert(Lang::Strings::ERROR, message.c_str(), "sad", Lang::Sounds::P3_EXCLAMATION);
+    });
+    protocol.OnIncomingAudio([this](const AudioStreamPacketView& packet) {
+        if (device_state_ == kDeviceStateBenchmarking) {
+            transport_benchmark_.OnPacket(packet);
+            return;
+        }
+        // 经过抖动缓冲重排后直接拷贝进解码队列，中间不再经过临时 vector
+        std::lock_guard<std::mutex> lock(audio_decode_mutex_);
+        if (device_state_ == kDeviceStateSpeaking) {
+            latency_tracer_.Mark(kLatencyFirstDownlink);
+            jitter_buffer_.Put(packet);
+#if CONFIG_TTS_PHRASE_CACHE
+            phrase_cache_.Record(packet.sample_rate, packet.frame_duration, packet.payload, packet.payload_size);
+#endif
+#if CONFIG_ENABLE_PROTOCOL_FAILOVER
+            downlink_packets_++;
+#endif
+            NotifyAudioOutput();
+        }
+    });
+    protocol.OnAudioChannelOpened([this, codec, &board, &protocol]() {
+        if (&protocol != protocol_.get()) {
+            return;
+        }
+        latency_tracer_.Mark(kLatencyChannelOpened);
+        latency_tracer_.BeginSession();
+#if CONFIG_IOT_PROTOCOL_MCP
+        // 新会话不会再等待上一个会话的工具结果
+        McpServer::GetInstance().CancelToolCalls();
+#endif
+#if CONFIG_ENABLE_PROTOCOL_FAILOVER
+        session_received_base_ = downlink_packets_;
+        session_lost_base_ = jitter_buffer_.lost_packets();
+#endif
+        playback_monitor_.ResetSession();
+        board.SetPowerSaveMode(false);
+        // 服务器可能在 hello 中改用别的上行帧长，解码队列按下行帧长换算包数
+        SetUplinkFrameDuration(protocol_->uplink_frame_duration());
+        if (protocol_->server_frame_duration() > 0) {
+            audio_decode_queue_.SetMaxPackets(QueuePackets(protocol_->server_frame_duration()));
+        }
+        if (protocol_->server_sample_rate() != codec->output_sample_rate() &&
+            !AudioResampler::IsIntegerRatio(protocol_->server_sample_rate(), codec->output_sample_rate())) {
+            LOGW_LIMITED(TAG, 60000, "Server sample rate %d does not match device output sample rate %d, resampling may cause distortion",
+                protocol_->server_sample_rate(), codec->output_sample_rate());
+        }
+
+#if CONFIG_IOT_PROTOCOL_XIAOZHI
+        auto& thing_manager = iot::ThingManager::GetInstance();
+        if (!protocol_->iot_descriptors_cached()) {
+            protocol_->SendIotDescriptors(thing_manager.GetDescriptorsJson());
+        }
+        std::string states;
+        if (thing_manager.GetStatesJson(states, false)) {
+            protocol_->SendIotStates(states);
+        }
+#endif
+    });
+    protocol.OnAudioChannelClosed([this, &board, &protocol]() {
+        if (&protocol != protocol_.get()) {
+            return;
+        }
+        board.SetPowerSaveMode(true);
+#if CONFIG_ENABLE_PROTOCOL_FAILOVER
+        // 切换发生在主循环中，这里记下关闭时使用的协议和是否正在切换
+        Schedule([this, kind = protocol_kind_, failing_over = failover_pending_.load()]() {
+#else
+        Schedule([this]() {
+#endif
+            StopTransportBenchmark();
+            encoder_controller_.LogDrops();
+            latency_tracer_.LogSession();
+            latency_tracer_.BeginTurn();
+#if CONFIG_ENABLE_PROTOCOL_FAILOVER
+            transport_policy_.OnSession(kind, downlink_packets_ - session_received_base_,
+                jitter_buffer_.lost_packets() - session_lost_base_);
+            if (failing_over) {
+                // 正在切换到备用协议，保持当前状态
+                return;
+            }
+#endif
+            auto display = Board::GetInstance().GetDisplay();
+            display->SetChatMessage("system", "");
+            SetDeviceState(kDeviceStateIdle);
+        });
+    });
+    protocol.OnIncomingControl([this](const ControlMessage& message) {
+        if (!message_dispatcher_.Dispatch(message)) {
+            ESP_LOGW(TAG, "Unknown message type: %.*s", (int)message.type_name().size(), message.type_name().data());
+        }
+    });
+    protocol.OnIncomingJson([](const cJSON*) {
+        ESP_LOGW(TAG, "Message without type");
+    });
+}
+
+// 内置的消息处理函数，板子可以通过 GetMessageDispatcher() 注册自己的消息类型
+void Application::RegisterMessageHandlers() {
+    auto display = Board::GetInstance().GetDisplay();
+    message_dispatcher_.Register("tts", "start", [this](const ControlMessage& message) {
+        latency_tracer_.Mark(kLatencyTtsStart);
+#if CONFIG_TTS_PHRASE_CACHE
+        // 带 cache_id 的这一轮音频录进缓存，没有时结束上一次没完成的录制
+        phrase_cache_.BeginRecord(message.Get(kControlFieldCacheId));
+#endif
+        Schedule([this]() {
+            StartTts();
+        });
+    });
+    message_dispatcher_.Register("tts", "stop", [this](const ControlMessage&) {
+        Schedule([this]() {
+            StopTts();
+        });
+    });
+#if CONFIG_TTS_PHRASE_CACHE
+    message_dispatcher_.Register("tts", "play_cached", [this](const ControlMessage& message) {
+        latency_tracer_.Mark(kLatencyTtsStart);
+        std::string id(message.Get(kControlFieldCacheId));
+        Schedule([this, id = std::move(id)]() {
+            PlayCachedPhrase(id);
+        });
+    });
+#endif
+    message_dispatcher_.Register("tts", "sentence_start", [this, display](const ControlMessage& message) {
+        if (!message.Has(kControlFieldText)) {
+            return;
+        }
+        PooledText text(message.Get(kControlFieldText));
+        ESP_LOGI(TAG, "<< %s", text.c_str());
+        Schedule([this, display, text = std::move(text)]() {
+            // 同一轮回复的后续句子接在同一个气泡后面
+            if (assistant_message_open_) {
+                display->AppendChatMessage("assistant", text.c_str());
+            } else {
+                display->SetChatMessage("assistant", text.c_str());
+                assistant_message_open_ = true;
+            }
+        });
+    });
+    // 其余 tts 状态不需要处理
+    message_dispatcher_.Register("tts", [](const ControlMessage&) {});
+    message_dispatcher_.Register("stt", [this, display](const ControlMessage& message) {
+        latency_tracer_.Mark(kLatencySttReceived);
+        if (message.Has(kControlFieldText)) {
+            PooledText text(message.Get(kControlFieldText));
+            ESP_LOGI(TAG, ">> %s", text.c_str());
+#if CONFIG_LOCAL_INTENT_FAST_PATH
+            LocalIntent intent;
+            if (LocalIntentMatcher::Match(text.c_str(), intent)) {
+                ESP_LOGI(TAG, "Local intent %d (%d)", intent.command, intent.value);
+                Schedule([this, intent, command_text = std::string(text.c_str())]() {
+                    ExecuteLocalIntent(intent, command_text);
+                });
+            }
+#endif
+            Schedule([this, display, text = std::move(text)]() {
+                display->SetChatMessage("user", text.c_str());
+            });
+        }
+    });
+    message_dispatcher_.Register("llm", [this, display](const ControlMessage& message) {
+        if (message.Has(kControlFieldEmotion)) {
+            Schedule([this, display, emotion = PooledText(message.Get(kControlFieldEmotion))]() {
+                display->SetEmotion(emotion.c_str());
+            });
+        }
+    });
+#if CONFIG_IOT_PROTOCOL_MCP
+    message_dispatcher_.Register("mcp", [](const ControlMessage& message) {
+        if (message.json() != nullptr) {
+            auto payload = cJSON_GetObjectItem(message.json(), "payload");
+            if (cJSON_IsObject(payload) || cJSON_IsArray(payload)) {
+                McpServer::GetInstance().ParseMessage(payload);
+            }
+        } else if (message.Has(kControlFieldPayload)) {
+            // 紧凑消息中的 payload 直接在接收缓冲区中解析
+            McpServer::GetInstance().ParseMessage(message.Get(kControlFieldPayload));
+        }
+    });
+#endif
+#if CONFIG_IOT_PROTOCOL_XIAOZHI
+    message_dispatcher_.Register("iot", [](const ControlMessage& message) {
+        if (message.json() == nullptr) {
+            return;
+        }
+        auto commands = cJSON_GetObjectItem(message.json(), "commands");
+        if (cJSON_IsArray(commands)) {
+            auto& thing_manager = iot::ThingManager::GetInstance();
+            for (int i = 0; i < cJSON_GetArraySize(commands); ++i) {
+                auto command = cJSON_GetArrayItem(commands, i);
+                thing_manager.Invoke(command);
+            }
+        }
+    });
+#endif
+    message_dispatcher_.Register("system", [this](const ControlMessage& message) {
+        if (!message.Has(kControlFieldCommand)) {
+            return;
+        }
+        auto command = message.Get(kControlFieldCommand);
+        ESP_LOGI(TAG, "System command: %.*s", (int)command.size(), command.data());
+        if (command == "reboot") {
+            // Do a reboot if user requests a OTA update
+            Schedule([this]() {
+                Reboot();
+            });
+        } else {
+            ESP_LOGW(TAG, "Unknown system command: %.*s", (int)command.size(), command.data());
+        }
+    });
+#if CONFIG_OPUS_INBAND_FEC
+    // 服务器统计的上行丢包率，决定是否打开上行的带内 FEC
+    message_dispatcher_.Register("receiver_report", [this](const ControlMessage& message) {
+        auto loss = cJSON_GetObjectItem(message.json(), "loss");
+        if (cJSON_IsNumber(loss)) {
+            encoder_controller_.OnRemoteLoss(loss->valueint);
+        }
+    });
+#endif
+    message_dispatcher_.Register("alert", [this](const ControlMessage& message) {
+        if (message.Has(kControlFieldStatus) && message.Has(kControlFieldMessage) && message.Has(kControlFieldEmotion)) {
+            // 二进制字段不以 0 结尾
+            auto status = std::string(message.Get(kControlFieldStatus));
+            auto text = std::string(message.Get(kControlFieldMessage));
+            auto emotion = std::string(message.Get(kControlFieldEmotion));
+            Alert(status.c_str(), text.c_str(), emotion.c_str(), Lang::Sounds::P3_VIBRATION);
+        } else {
+            ESP_LOGW(TAG, "Alert command requires status, message and emotion");
+        }
+    });
+}
+
+// 队列的字节空间是预分配的，缩小包数上限让积压的下行和上行音频更早被丢弃，排队中的包少占用解码和发送时的临时内存
+size_t Application::QueuePackets(int frame_duration) const {
+    // 服务器下发的队列时长不能超过预分配的字节空间对应的时长
+    int duration = std::min(PerformanceProfile::GetInstance().Get(kPerfAudioQueueMs, AUDIO_QUEUE_DURATION_MS), AUDIO_QUEUE_DURATION_MS);
+    size_t packets = std::max(duration / frame_duration, 2);
+    if (queues_shrunk_) {
+        packets = std::max<size_t>(packets / 2, 2);
+    }
+    return packets;
+}
+
+// 内存紧张时的降级措施，板子持有的显示和摄像头由这里代为订阅
+void Application::SubscribeMemoryPressure() {
+    auto& pressure = MemoryPressure::GetInstance();
+    pressure.Subscribe(kMemoryStageAudioQueues, [this](bool engaged) {
+        queues_shrunk_ = engaged;
+        audio_send_queue_.SetMaxPackets(QueuePackets(uplink_frame_duration_));
+        int downlink_duration = protocol_ ? protocol_->server_frame_duration() : OPUS_FRAME_DURATION_MS;
+        audio_decode_queue_.SetMaxPackets(QueuePackets(downlink_duration > 0 ? downlink_duration : OPUS_FRAME_DURATION_MS));
+    });
+    pressure.Subscribe(kMemoryStageCameraPreview, [](bool engaged) {
+        auto camera = Board::GetInstance().GetCamera();
+        if (camera != nullptr) {
+            camera->SetLowMemory(engaged);
+        }
+    });
+    pressure.Subscribe(kMemoryStageGlyphCache, [](bool engaged) {
+        Board::GetInstance().GetDisplay()->SetLowMemory(engaged);
+    });
+}
+
+#if CONFIG_THERMAL_GOVERNOR
+void Application::ApplyThermalLevel() {
+    auto& step = ThermalGovernor::GetStep(ThermalGovernor::GetInstance().level());
+    encoder_controller_.SetComplexityCap(step.max_complexity);
+    LedEffectEngine::GetInstance().SetFrameInterval(step.led_frame_ms);
+    Board::GetInstance().GetDisplay()->SetThrottled(step.display_throttled);
+    audio_processor_->SetReducedProcessing(step.afe_reduced);
+}
+#endif
+
 void Application::OnClockTimer() {
     clock_ticks_++;
+#if CONFIG_CRASH_RING
+    CrashRing::GetInstance().Sample(audio_send_queue_.size(), audio_decode_queue_.size());
+#endif
 
-    auto display = Board::GetInstance().GetDisplay();
+    auto& board = Board::GetInstance();
+    auto display = board.GetDisplay();
     display->UpdateStatusBar();
+    // 空闲时在这里读电量计和网络状态，MCP 查询设备状态时直接返回快照
+    if (clock_ticks_ % DEVICE_STATUS_REFRESH_SECONDS == 0 && device_state_ == kDeviceStateIdle) {
+        board.RefreshDeviceStatus();
+    }
+#if CONFIG_MEMORY_PRESSURE_MONITOR
+    // 等级变化时订阅方在这里直接释放内存，不经过 Schedule，内存紧张时 Schedule 本身也可能失败
+    MemoryPressure::GetInstance().Update();
+#endif
+
+#if CONFIG_LOCK_PROFILER
+    if (clock_ticks_ % LOCK_PROFILER_REPORT_SECONDS == 0) {
+        LockProfiler::Report();
+    }
+#endif
 
     // Print the debug info every 10 seconds
     if (clock_ticks_ % 10 == 0) {
         // SystemInfo::PrintTaskCpuUsage(pdMS_TO_TICKS(1000));
         // SystemInfo::PrintTaskList();
         SystemInfo::PrintHeapStats();
+        PowerGovernor::GetInstance().UpdateMetrics();
+        Metrics::GetInstance().Sample();
+#if CONFIG_THERMAL_GOVERNOR
+        if (ThermalGovernor::GetInstance().Update()) {
+            Schedule([this]() {
+                ApplyThermalLevel();
+            });
+        }
+#endif
 
         // If we have synchronized server time, set the status to clock "HH:MM" if the device is idle
         if (has_server_time_) {
@@ -745,217 +1789,908 @@ void Application::OnClockTimer() {
             }
         }
     }
+
+#if CONFIG_OPUS_INBAND_FEC
+    if (clock_ticks_ % RECEIVER_REPORT_INTERVAL_SECONDS == 0) {
+        Schedule([this]() {
+            SendReceiverReport();
+        });
+    }
+#endif
+
+#if CONFIG_DEVICE_ENDPOINTING
+    // 说完之后服务器一直没有回复（例如没有识别出文字），回到待机
+    if (endpoint_tick_ >= 0 && clock_ticks_ - endpoint_tick_ >= CONFIG_ENDPOINT_REPLY_TIMEOUT_SECONDS) {
+        endpoint_tick_ = -1;
+        Schedule([this]() {
+            if (device_state_ == kDeviceStateListening && !audio_processor_->IsRunning()) {
+                ESP_LOGW(TAG, "No reply after end of speech");
+                SetDeviceState(kDeviceStateIdle);
+            }
+        });
+    }
+#endif
+
+#if CONFIG_AUDIO_CHANNEL_KEEP_WARM
+    // 状态切换时 clock_ticks_ 清零，这里就是空闲的秒数，在服务器超时之前主动关闭保温的通道
+    int park_seconds = CONFIG_AUDIO_CHANNEL_PARK_SECONDS;
+#if CONFIG_ADAPTIVE_KEEPALIVE
+    // 有保活时服务器不会超时，通道可以保持更久
+    if (device_state_ == kDeviceStateIdle && protocol_ && protocol_->keepalive_enabled()) {
+        park_seconds = CONFIG_KEEPALIVE_PARK_SECONDS;
+        Schedule([this]() {
+            if (device_state_ == kDeviceStateIdle) {
+                protocol_->PollKeepalive();
+            }
+        });
+    }
+#endif
+    if (device_state_ == kDeviceStateIdle && clock_ticks_ == park_seconds) {
+        Schedule([this]() {
+            if (device_state_ == kDeviceStateIdle && protocol_ && protocol_->IsAudioChannelOpened()) {
+                ESP_LOGI(TAG, "Close parked audio channel");
+                protocol_->CloseAudioChannel();
+            }
+        });
+    }
+#endif
+
+    // 每分钟检查一次 I2S 采集是否丢帧
+    if (clock_ticks_ % 60 == 0) {
+        Schedule([]() {
+            Board::GetInstance().GetAudioCodec()->TuneDmaBuffers();
+        });
+    }
+}
+
+// Add a async task to MainLoop
+void Application::PushMainTask(MainTask&& callback, const void* caller) {
+    if (callback.on_heap()) {
+        metric_schedule_heap.Add();
+    }
+    int64_t now = esp_timer_get_time();
+    {
+        std::lock_guard<ProfiledMutex> lock(mutex_);
+        // 溢出链表里还有任务时新任务也排到链表后面，保持先进先出
+        if (main_tasks_count_ < MAIN_TASK_QUEUE_SIZE && main_tasks_overflow_.empty()) {
+            auto& slot = main_tasks_[(main_tasks_head_ + main_tasks_count_) % MAIN_TASK_QUEUE_SIZE];
+            slot.callback = std::move(callback);
+            slot.caller = caller;
+            slot.enqueue_us = now;
+            main_tasks_count_++;
+        } else {
+            metric_schedule_overflow.Add();
+            main_tasks_overflow_.push_back({std::move(callback), caller, now});
+        }
+    }
+    xEventGroupSetBits(event_group_, SCHEDULE_EVENT);
+}
+
+bool Application::PopMainTask(ScheduledTask& task) {
+    std::lock_guard<ProfiledMutex> lock(mutex_);
+    if (main_tasks_count_ > 0) {
+        task = std::move(main_tasks_[main_tasks_head_]);
+        main_tasks_head_ = (main_tasks_head_ + 1) % MAIN_TASK_QUEUE_SIZE;
+        main_tasks_count_--;
+        return true;
+    }
+    if (!main_tasks_overflow_.empty()) {
+        task = std::move(main_tasks_overflow_.front());
+        main_tasks_overflow_.pop_front();
+        return true;
+    }
+    return false;
+}
+
+// The Main Event Loop controls the chat state and websocket connection
+// If other tasks need to access the websocket or chat state,
+// they should use Schedule to call this function
+void Application::MainEventLoop() {
+    // Raise the priority of the main event loop to avoid being interrupted by background tasks (which has priority 2)
+    vTaskPrioritySet(NULL, 3);
+    main_loop_running_ = true;
+
+    while (true) {
+        auto bits = xEventGroupWaitBits(event_group_, SCHEDULE_EVENT | SEND_AUDIO_EVENT | SPEAKER_DRAINED_EVENT,
+            pdTRUE, pdFALSE, portMAX_DELAY);
+
+        if (bits & SPEAKER_DRAINED_EVENT) {
+            OnSpeakerDrained();
+        }
+
+        if ((bits & SEND_AUDIO_EVENT) && wake_word_upload_ && !SendWakeWordOpus()) {
+            // 唤醒词音频还没发完，实时音频留在队列中
+            bits &= ~SEND_AUDIO_EVENT;
+        }
+
+        if (bits & SEND_AUDIO_EVENT) {
+            StallScope stall(kStallLoopMain, "SendAudio");
+            encoder_controller_.OnSendQueueDepth(audio_send_queue_.size(), audio_send_queue_.max_packets());
+            metric_send_queue.Set(audio_send_queue_.size());
+            protocol_->SetUplinkFec(encoder_controller_.fec());
+            int64_t send_start = esp_timer_get_time();
+            bool send_failed = false;
+            while (uplink_retry_ || audio_send_queue_.Pop(uplink_packet_)) {
+                uplink_retry_ = false;
+                uint32_t packet_send_us = AudioTrace::Now();
+                if (protocol_->SendAudio(uplink_packet_)) {
+                    latency_tracer_.Mark(kLatencyFirstUplink);
+                    AudioTrace::Record(kAudioTraceSend, packet_send_us);
+                    AudioTrace::Record(kAudioTraceUplink, uplink_packet_.trace_us);
+                    continue;
+                }
+                send_failed = true;
+                if (protocol_->IsAudioChannelOpened()) {
+                    // 通道还在（例如 UDP 发送缓冲区暂时满了），保留没发出去的包，下一帧入队时重试，
+                    // 队列积压由编码器降档消化，而不是直接丢掉语音
+                    uplink_retry_ = true;
+                    break;
+                }
+                // 通道已经断开，丢弃剩余的包
+                encoder_controller_.OnSendFailed();
+                while (audio_send_queue_.Pop(uplink_packet_)) {
+                    encoder_controller_.OnSendFailed();
+                }
+                break;
+            }
+            if (!send_failed) {
+                protocol_->FlushAudio(false);
+            }
+            encoder_controller_.OnSendDuration(esp_timer_get_time() - send_start, uplink_frame_duration_);
+        }
+
+        if (bits & SCHEDULE_EVENT) {
+            // 只处理本轮开始前已经入队的任务，执行期间新入队的任务会重新置位 SCHEDULE_EVENT
+            size_t pending;
+            {
+                std::lock_guard<ProfiledMutex> lock(mutex_);
+                pending = main_tasks_count_ + main_tasks_overflow_.size();
+            }
+            ScheduledTask task;
+            while (pending-- > 0 && PopMainTask(task)) {
+                metric_schedule_wait_us.Record(esp_timer_get_time() - task.enqueue_us);
+                StallScope stall(kStallLoopMain, "Schedule", task.caller);
+#if CONFIG_CRASH_RING
+                CrashRing::GetInstance().RecordSchedule(task.caller);
+#endif
+                task.callback();
+                task.callback.Reset();
+            }
+        }
+    }
+}
+
+void Application::NotifyAudioInput() {
+    if (audio_input_task_handle_ != nullptr) {
+        xTaskNotifyGive(audio_input_task_handle_);
+    }
+}
+
+void Application::NotifyAudioOutput(uint32_t bits) {
+    if (audio_output_task_handle_ != nullptr) {
+        xTaskNotify(audio_output_task_handle_, bits, eSetBits);
+    }
+}
+
+// 采集任务，I2S 读会阻塞到 DMA 缓冲区填满，没有消费者时睡眠等待通知
+void Application::AudioInputLoop() {
+    while (true) {
+        StallDetector::Begin(kStallLoopAudioInput, "OnAudioInput");
+        bool has_input = OnAudioInput();
+        StallDetector::End(kStallLoopAudioInput);
+        if (has_input) {
+            continue;
+        }
+        // 有消费者但暂时读不到数据（例如输入被关闭）时短暂等待后重试
+        TickType_t timeout = portMAX_DELAY;
+        if (wake_word_->IsDetectionRunning() || audio_processor_->IsRunning()) {
+            timeout = pdMS_TO_TICKS(uplink_frame_duration_ / 2);
+        }
+        ulTaskNotifyTake(pdTRUE, timeout);
+    }
+}
+
+// 播放任务，每次最多调度一个解码任务，等它写完 I2S 再取下一帧
+// 写 I2S 会阻塞到 DMA 有空闲缓冲区，所以解码完成的通知按播放速度到达
+void Application::AudioOutputLoop() {
+    auto codec = Board::GetInstance().GetAudioCodec();
+    const int idle_check_ms = 1000;
+    while (true) {
+        uint32_t bits = 0;
+        // 从调度解码到写完 I2S 算一次工作，解码任务卡住时播放也会停住
+        StallDetector::Begin(kStallLoopAudioOutput, "OnAudioOutput");
+        if (codec->output_enabled() && OnAudioOutput()) {
+            while (!(bits & AUDIO_OUTPUT_DONE_NOTIFY)) {
+                xTaskNotifyWait(0, UINT32_MAX, &bits, portMAX_DELAY);
+            }
+            StallDetector::End(kStallLoopAudioOutput);
+            continue;
+        }
+        StallDetector::End(kStallLoopAudioOutput);
+        // 还有数据没播（起播前缓冲、调度失败）时按最短帧长重试，其它时候只需要定期检查是否长时间静音
+        TickType_t timeout = portMAX_DELAY;
+        if (codec->output_enabled() && (!audio_decode_queue_.empty() || sound_player_.IsPlaying())) {
+            timeout = pdMS_TO_TICKS(MIN_OPUS_FRAME_DURATION_MS);
+        } else if (codec->output_enabled()) {
+            timeout = pdMS_TO_TICKS(idle_check_ms);
+        }
+        xTaskNotifyWait(0, UINT32_MAX, &bits, timeout);
+    }
+}
+
+// 返回 true 表示已经调度了解码任务，完成后会发送 AUDIO_OUTPUT_DONE_NOTIFY
+bool Application::OnAudioOutput() {
+    auto now = std::chrono::steady_clock::now();
+    auto codec = Board::GetInstance().GetAudioCodec();
+    auto& pool = AudioPayloadPool::GetInstance();
+    size_t frame_samples = audio_mixer_.frame_samples();
+
+    // 输出刚打开，功放还没稳定，有数据时输出任务按最短帧长重试
+    if (codec->output_warmup_remaining_ms() > 0) {
+        return false;
+    }
+
+    // TTS 源，说话状态下先缓冲到抖动缓冲的目标深度再起播
+    AudioStreamPacket packet;
+    bool has_packet = false;
+    UpdatePlaybackMonitor(codec);
+    if (audio_mixer_.Buffered(kAudioSourceTts) < frame_samples) {
+        if (!(device_state_ == kDeviceStateSpeaking && !jitter_buffer_.ReadyToPlay())) {
+            packet.payload = pool.Acquire();
+            has_packet = audio_decode_queue_.Pop(packet);
+            metric_decode_queue.Set(audio_decode_queue_.size());
+            if (has_packet) {
+                audio_decode_cv_.notify_all();
+                // Synchronize the sample rate and frame duration
+                SetDecodeSampleRate(packet.sample_rate, packet.frame_duration);
+                if (underrun_pending_) {
+                    // 欠载之后又收到了数据，说明是一句话中间的网络空洞
+                    underrun_pending_ = false;
+                    playback_monitor_.OnNetworkUnderrun();
+                }
+                concealed_in_gap_ = 0;
+            } else {
+                pool.Release(std::move(packet.payload));
+            }
+        } else if (jitter_buffer_.underrun()) {
+            underrun_pending_ = true;
+#if CONFIG_PLAYBACK_CONCEALMENT
+            // 重新缓冲期间先用 PLC 延续前面的声音，Opus 的 PLC 会逐渐衰减，不会突然断掉
+            if (concealed_in_gap_ < PLAYBACK_CONCEAL_MAX_FRAMES) {
+                concealed_in_gap_++;
+                packet.payload = pool.Acquire();
+                packet.payload.clear();
+                packet.sample_rate = opus_decoder_->sample_rate();
+                packet.frame_duration = opus_decoder_->duration_ms();
+                packet.timestamp = 0;
+                has_packet = true;
+                playback_monitor_.OnConcealed();
+            }
+#endif
+        }
+    }
+
+    // 提示音源，和 TTS 同时播放，不再排在 TTS 后面
+    SoundFrame sound_frame;
+    bool has_sound = false;
+    std::vector<uint8_t> sound_payload;
+    if (audio_mixer_.Buffered(kAudioSourcePrompt) < frame_samples) {
+        has_sound = sound_player_.Next(sound_frame, frame_samples);
+        if (has_sound && sound_frame.payload_size > 0) {
+            sound_payload = pool.Acquire();
+            sound_payload.assign(sound_frame.payload, sound_frame.payload + sound_frame.payload_size);
+        }
+    }
+
+    if (!has_packet && !has_sound && !audio_mixer_.IsActive(kAudioSourceTts) && !audio_mixer_.IsActive(kAudioSourcePrompt)) {
+        // Disable the output if there is no audio data for a long time
+        if (device_state_ == kDeviceStateIdle) {
+            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_output_time_).count();
+            if (duration > codec->output_idle_off_ms()) {
+                codec->EnableOutput(false);
+            }
+        }
+        return false;
+    }
+
+    uint32_t epoch = playback_epoch_;
+    if (background_task_->Schedule(kBackgroundLaneDecode, [this, codec, packet = std::move(packet), has_packet,
+            sound_frame, has_sound, sound_payload = std::move(sound_payload), epoch]() mutable {
+        PowerBoostGuard boost;
+#ifdef CONFIG_USE_SERVER_AEC
+        size_t tts_buffered = 0;
+#endif
+        // 解码、重采样和混音都写入预分配的缓冲区，解码通道只有一个 worker，不会并发访问
+        if (has_packet && epoch != playback_epoch_) {
+            // 提交之后发生了打断，这一包 TTS 作废，提示音照常播放
+            AudioPayloadPool::GetInstance().Release(std::move(packet.payload));
+            has_packet = false;
+        }
+        if (has_packet) {
+            DecodeTtsPacket(codec, packet);
+        }
+        if (has_sound) {
+            DecodeSoundFrame(codec, sound_frame, sound_payload);
+        }
+#ifdef CONFIG_USE_SERVER_AEC
+        tts_buffered = audio_mixer_.Buffered(kAudioSourceTts);
+#endif
+        // 打断时请求的清空在混音开始时生效，旧的 TTS 不会再写入
+        if (audio_mixer_.Mix(output_mix_buffer_)) {
+            uint32_t write_start_us = AudioTrace::Now();
+            codec->OutputData(output_mix_buffer_);
+            AudioTrace::Record(kAudioTraceI2sWrite, write_start_us);
+            SignalLevels::GetInstance().Publish(kSignalPlayback, output_mix_buffer_.data(), output_mix_buffer_.size());
+            if (audio_debugger_) {
+                audio_debugger_->Write(kAudioDebugPlayback, output_mix_buffer_, codec->output_sample_rate());
+            }
+            if (has_packet) {
+                AudioTrace::Record(kAudioTraceDownlink, packet.trace_us);
+            }
+            last_output_time_ = std::chrono::steady_clock::now();
+#ifdef CONFIG_USE_SERVER_AEC
+            playout_clock_.OnOutput(tts_buffered, output_mix_buffer_.size(), codec->output_sample_rate());
+#endif
+        }
+        NotifyAudioOutput(AUDIO_OUTPUT_DONE_NOTIFY);
+    }) != kBackgroundScheduleOk) {
+        return false;
+    }
+    return true;
+}
+
+// 在播放任务中调用，把 codec 和抖动缓冲新增的欠载/溢出计入本次会话
+void Application::UpdatePlaybackMonitor(AudioCodec* codec) {
+    uint32_t underruns = codec->output_underruns();
+    uint32_t delta = underruns - last_codec_underruns_;
+    last_codec_underruns_ = underruns;
+    // 解码队列已经空了的欠载由网络造成，单独统计
+    if (delta > 0 && device_state_ == kDeviceStateSpeaking && !jitter_buffer_.underrun() && audio_decode_queue_.size() > 0) {
+        playback_monitor_.OnCpuUnderruns(delta);
+    }
+    uint32_t overflows = jitter_buffer_.overflow_packets();
+    if (overflows != last_overflows_) {
+        playback_monitor_.OnOverflows(overflows - last_overflows_);
+        last_overflows_ = overflows;
+    }
+}
+
+void Application::DecodeTtsPacket(AudioCodec* codec, AudioStreamPacket& packet) {
+    auto& pool = AudioPayloadPool::GetInstance();
+    if (aborted_) {
+        pool.Release(std::move(packet.payload));
+        audio_mixer_.RequestClear(kAudioSourceTts);
+        return;
+    }
+
+    int64_t start_time = esp_timer_get_time();
+    bool decoded;
+    {
+        HotPathScope profile(kHotPathDecode);
+#if CONFIG_OPUS_INBAND_FEC
+        if (packet.fec) {
+            decoded = opus_decoder_->DecodeFec(packet.payload, output_pcm_buffer_);
+            metric_fec_decoded.Add();
+        } else {
+            decoded = opus_decoder_->Decode(std::move(packet.payload), output_pcm_buffer_);
+        }
+#else
+        decoded = opus_decoder_->Decode(std::move(packet.payload), output_pcm_buffer_);
+#endif
+    }
+    pool.Release(std::move(packet.payload));
+    if (!decoded) {
+        metric_decode_failed.Add();
+        return;
+    }
+    metric_decode_us.Record(esp_timer_get_time() - start_time);
+    AudioTrace::Record(kAudioTraceDecode, start_time);
+    if (audio_debugger_) {
+        audio_debugger_->Write(kAudioDebugTts, output_pcm_buffer_, opus_decoder_->sample_rate());
+    }
+    // Resample if the sample rate is different
+    std::span<const int16_t> pcm = output_pcm_buffer_;
+    if (output_resampler_ != nullptr) {
+        AudioTraceScope trace(kAudioTraceOutputResample);
+        output_resampled_buffer_.resize(output_resampler_->GetOutputSamples(output_pcm_buffer_.size()));
+        output_resampler_->Process(output_pcm_buffer_.data(), output_pcm_buffer_.size(), output_resampled_buffer_.data());
+        pcm = output_resampled_buffer_;
+    }
+#if CONFIG_AUDIO_DRIFT_COMPENSATION
+    // 起播之后按解码队列的深度微调播放速度，长回复中队列保持在目标深度附近
+    if (device_state_ == kDeviceStateSpeaking) {
+        int queued_ms = audio_decode_queue_.size() * packet.frame_duration +
+            audio_mixer_.Buffered(kAudioSourceTts) * 1000 / codec->output_sample_rate();
+        drift_compensator_.Update(queued_ms, jitter_buffer_.target_ms(), packet.frame_duration);
+        metric_drift_ppm.Set(drift_compensator_.ppm());
+        pcm = drift_compensator_.Process(pcm);
+    }
+#endif
+    audio_mixer_.Write(kAudioSourceTts, pcm.data(), pcm.size());
+#ifdef CONFIG_USE_SERVER_AEC
+    playout_clock_.OnStreamWritten(packet.timestamp, output_pcm_buffer_.size(), opus_decoder_->sample_rate());
+#endif
+    if (device_state_ == kDeviceStateSpeaking) {
+        latency_tracer_.Mark(kLatencyFirstPcm);
+    }
 }
 
-// Add a async task to MainLoop
-void Application::Schedule(std::function<void()> callback) {
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        main_tasks_.push_back(std::move(callback));
+void Application::DecodeSoundFrame(AudioCodec* codec, const SoundFrame& frame, std::vector<uint8_t>& payload) {
+    if (frame.pcm != nullptr) {
+        // 缓存或预解码的 PCM 已经是输出采样率
+        audio_mixer_.Write(kAudioSourcePrompt, frame.pcm, frame.samples);
+        return;
+    }
+    if (frame.payload_size == 0) {
+        sound_player_.AppendCache(frame, std::vector<int16_t>());
+        return;
     }
-    xEventGroupSetBits(event_group_, SCHEDULE_EVENT);
-}
-
-// The Main Event Loop controls the chat state and websocket connection
-// If other tasks need to access the websocket or chat state,
-// they should use Schedule to call this function
-void Application::MainEventLoop() {
-    // Raise the priority of the main event loop to avoid being interrupted by background tasks (which has priority 2)
-    vTaskPrioritySet(NULL, 3);
 
-    while (true) {
-        auto bits = xEventGroupWaitBits(event_group_, SCHEDULE_EVENT | SEND_AUDIO_EVENT, pdTRUE, pdFALSE, portMAX_DELAY);
+    // 提示音使用独立的解码器，不打断 TTS 解码器的状态
+    bool decoded = prompt_decoder_->Decode(std::move(payload), prompt_pcm_buffer_);
+    AudioPayloadPool::GetInstance().Release(std::move(payload));
+    if (!decoded) {
+        return;
+    }
+    if (prompt_decoder_->sample_rate() != codec->output_sample_rate()) {
+        prompt_resampled_buffer_.resize(prompt_resampler_.GetOutputSamples(prompt_pcm_buffer_.size()));
+        prompt_resampler_.Process(prompt_pcm_buffer_.data(), prompt_pcm_buffer_.size(), prompt_resampled_buffer_.data());
+        sound_player_.AppendCache(frame, prompt_resampled_buffer_);
+        audio_mixer_.Write(kAudioSourcePrompt, prompt_resampled_buffer_.data(), prompt_resampled_buffer_.size());
+    } else {
+        sound_player_.AppendCache(frame, prompt_pcm_buffer_);
+        audio_mixer_.Write(kAudioSourcePrompt, prompt_pcm_buffer_.data(), prompt_pcm_buffer_.size());
+    }
+}
 
-        if (bits & SEND_AUDIO_EVENT) {
-            std::unique_lock<std::mutex> lock(mutex_);
-            auto packets = std::move(audio_send_queue_);
-            lock.unlock();
-            for (auto& packet : packets) {
-                if (!protocol_->SendAudio(packet)) {
-                    break;
-                }
-            }
+// data 借用 AFE 的输出缓冲区，在这里复制到帧队列的槽位中，时间戳是这个块开头的采集时间
+void Application::EncodeUplinkAudio(std::span<const int16_t> data, uint32_t timestamp, bool onset) {
+    int frame_duration = uplink_frame_duration_;
+    size_t frame_samples = frame_duration * 16000 / 1000;
+    if (uplink_frame_reset_.exchange(false) || onset || uplink_frame_samples_ != frame_samples) {
+        // 新的一次聆听、一段语音的开头或帧长变化，丢弃拼了一半的帧，下一帧编码前重置编码器
+        if (uplink_frame_ != nullptr) {
+            uplink_frame_->samples.clear();
         }
+        uplink_frame_samples_ = frame_samples;
+        uplink_frame_onset_ = true;
+    }
 
-        if (bits & SCHEDULE_EVENT) {
-            std::unique_lock<std::mutex> lock(mutex_);
-            auto tasks = std::move(main_tasks_);
-            lock.unlock();
-            for (auto& task : tasks) {
-                task();
+    size_t offset = 0;
+    while (offset < data.size()) {
+        if (uplink_frame_ == nullptr || uplink_frame_->samples.empty()) {
+            uplink_frame_ = encode_ring_.Back();
+            if (uplink_frame_ == nullptr) {
+                // 编码任务跟不上，丢弃这一块，下一帧重置编码器避免前后不连续
+                ESP_LOGW(TAG, "Encode ring is full, drop %u samples", data.size() - offset);
+                metric_encode_overflows.Add();
+                encoder_controller_.OnPacketDropped();
+                uplink_frame_onset_ = true;
+                return;
             }
+            uplink_frame_->timestamp = timestamp + offset * 1000 / 16000;
+        }
+        auto& samples = uplink_frame_->samples;
+        size_t count = std::min(frame_samples - samples.size(), data.size() - offset);
+        samples.insert(samples.end(), data.begin() + offset, data.begin() + offset + count);
+        offset += count;
+        if (samples.size() == frame_samples) {
+            uplink_frame_->frame_duration = frame_duration;
+            uplink_frame_->onset = uplink_frame_onset_;
+            uplink_frame_->testing = false;
+            uplink_frame_onset_ = false;
+            CommitUplinkFrame();
         }
     }
 }
 
-// The Audio Loop is used to input and output audio data
-void Application::AudioLoop() {
-    auto codec = Board::GetInstance().GetAudioCodec();
+void Application::CommitUplinkFrame() {
+#ifdef CONFIG_USE_SERVER_AEC
+    // 服务端用这个时间戳找到对应的回声参考
+    uplink_frame_->timestamp = playout_clock_.MapCapture(uplink_frame_->timestamp);
+#endif
+    uplink_frame_->trace_us = AudioTrace::Now();
+    uplink_frame_ = nullptr;
+    encode_ring_.Commit();
+    metric_encode_ring.Set(encode_ring_.size());
+    if (audio_encode_task_handle_ != nullptr) {
+        xTaskNotifyGive(audio_encode_task_handle_);
+    }
+}
+
+// 上行编码任务，和 AFE 的 fetch 循环分开，编码慢时只会让帧队列变长，不会拖住 AEC/NS
+void Application::AudioEncodeLoop() {
     while (true) {
-        OnAudioInput();
-        if (codec->output_enabled()) {
-            OnAudioOutput();
+        auto frame = encode_ring_.Front();
+        if (frame == nullptr) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
         }
+        EncodeFrame(*frame);
+        encode_ring_.Pop();
     }
 }
 
-void Application::OnAudioOutput() {
-    if (busy_decoding_audio_) {
+void Application::EncodeFrame(AudioFrameRing::Frame& frame) {
+    AudioTrace::Record(kAudioTraceEncodeWait, frame.trace_us);
+    PowerBoostGuard boost;
+    int rebuild_duration = encoder_rebuild_duration_.exchange(0);
+    if (rebuild_duration > 0) {
+        opus_encoder_ = std::make_unique<OpusStreamEncoder>(16000, 1, rebuild_duration);
+        encoder_controller_.Invalidate();
+    } else if (frame.onset) {
+        // 门控恢复发送或重新开始聆听时丢弃编码器里残留的上一段音频
+        opus_encoder_->ResetState();
+    }
+    encoder_controller_.Apply(*opus_encoder_);
+    int64_t start_time = esp_timer_get_time();
+    bool encoded;
+    {
+        HotPathScope profile(kHotPathEncode);
+        encoded = opus_encoder_->Encode(std::move(frame.samples), uplink_opus_);
+    }
+    // 帧长切换瞬间拼好的旧帧长度和新编码器不符，编码失败时直接丢弃
+    if (!encoded) {
         return;
     }
+    int64_t encode_us = esp_timer_get_time() - start_time;
+    if (!frame.testing) {
+        encoder_controller_.OnFrameEncoded(encode_us, frame.frame_duration);
+        metric_encode_us.Record(encode_us);
+    }
+    AudioTrace::Record(kAudioTraceEncode, start_time);
 
-    auto now = std::chrono::steady_clock::now();
-    auto codec = Board::GetInstance().GetAudioCodec();
-    const int max_silence_seconds = 10;
-
-    std::unique_lock<std::mutex> lock(mutex_);
-    if (audio_decode_queue_.empty()) {
-        // Disable the output if there is no audio data for a long time
-        if (device_state_ == kDeviceStateIdle) {
-            auto duration = std::chrono::duration_cast<std::chrono::seconds>(now - last_output_time_).count();
-            if (duration > max_silence_seconds) {
-                codec->EnableOutput(false);
-            }
+    if (frame.testing) {
+        if (!audio_testing_queue_->Push(16000, frame.frame_duration, 0, uplink_opus_.data(), uplink_opus_.size())) {
+            LOGW_LIMITED(TAG, 1000, "Audio testing queue is full, drop the packet");
         }
         return;
     }
-
-    auto packet = std::move(audio_decode_queue_.front());
-    audio_decode_queue_.pop_front();
-    lock.unlock();
-    audio_decode_cv_.notify_all();
-
-    // Synchronize the sample rate and frame duration
-    SetDecodeSampleRate(packet.sample_rate, packet.frame_duration);
-
-    busy_decoding_audio_ = true;
-    if (!background_task_->Schedule([this, codec, packet = std::move(packet)]() mutable {
-        busy_decoding_audio_ = false;
-        if (aborted_) {
-            return;
-        }
-
-        std::vector<int16_t> pcm;
-        if (!opus_decoder_->Decode(std::move(packet.payload), pcm)) {
-            return;
-        }
-        // Resample if the sample rate is different
-        if (opus_decoder_->sample_rate() != codec->output_sample_rate()) {
-            int target_size = output_resampler_.GetOutputSamples(pcm.size());
-            std::vector<int16_t> resampled(target_size);
-            output_resampler_.Process(pcm.data(), pcm.size(), resampled.data());
-            pcm = std::move(resampled);
-        }
-        codec->OutputData(pcm);
-#ifdef CONFIG_USE_SERVER_AEC
-        std::lock_guard<std::mutex> lock(timestamp_mutex_);
-        timestamp_queue_.push_back(packet.timestamp);
-#endif
-        last_output_time_ = std::chrono::steady_clock::now();
-    })) {
-        busy_decoding_audio_ = false;
+    // 只有主循环会出队，队列满时丢弃最新的包
+    if (!audio_send_queue_.Push(16000, frame.frame_duration, frame.timestamp, uplink_opus_.data(), uplink_opus_.size(),
+            frame.trace_us)) {
+        LOGW_LIMITED(TAG, 1000, "Too many audio packets in queue, drop the newest packet");
+        encoder_controller_.OnPacketDropped();
     }
+    xEventGroupSetBits(event_group_, SEND_AUDIO_EVENT);
 }
 
-void Application::OnAudioInput() {
+// 返回 false 表示没有读到音频
+bool Application::OnAudioInput() {
     if (device_state_ == kDeviceStateAudioTesting) {
-        if (audio_testing_queue_.size() >= AUDIO_TESTING_MAX_DURATION_MS / OPUS_FRAME_DURATION_MS) {
+#if CONFIG_AUDIO_SELF_TEST
+        // 自检只需要原始输入，ReadAudio 交给 audio_self_test_，不再编码录音
+        return ReadAudio(audio_input_buffer_, 16000, 16000 * OPUS_FRAME_DURATION_MS / 1000);
+#else
+        if (audio_testing_queue_->full()) {
             ExitAudioTestingMode();
-            return;
+            return true;
         }
-        std::vector<int16_t> data;
-        int samples = OPUS_FRAME_DURATION_MS * 16000 / 1000;
-        if (ReadAudio(data, 16000, samples)) {
-            background_task_->Schedule([this, data = std::move(data)]() mutable {
-                opus_encoder_->Encode(std::move(data), [this](std::vector<uint8_t>&& opus) {
-                    AudioStreamPacket packet;
-                    packet.payload = std::move(opus);
-                    packet.frame_duration = OPUS_FRAME_DURATION_MS;
-                    packet.sample_rate = 16000;
-                    std::lock_guard<std::mutex> lock(mutex_);
-                    audio_testing_queue_.push_back(std::move(packet));
-                });
-            });
-            return;
+        int frame_duration = uplink_frame_duration_;
+        int samples = frame_duration * 16000 / 1000;
+        auto frame = encode_ring_.Back();
+        if (frame != nullptr) {
+            if (ReadAudio(frame->samples, 16000, samples)) {
+                frame->timestamp = 0;
+                frame->trace_us = 0;
+                frame->frame_duration = frame_duration;
+                frame->onset = false;
+                frame->testing = true;
+                encode_ring_.Commit();
+                if (audio_encode_task_handle_ != nullptr) {
+                    xTaskNotifyGive(audio_encode_task_handle_);
+                }
+                return true;
+            }
+            frame->samples.clear();
         }
+#endif
     }
 
-    if (wake_word_->IsDetectionRunning()) {
-        std::vector<int16_t> data;
+#if CONFIG_USE_SHARED_AFE
+    // 共用前端时聆听中也在检测唤醒词，只由降噪这一路送数据，避免同一段输入送两次
+    bool feed_wake_word = wake_word_->IsDetectionRunning() && !audio_processor_->IsRunning();
+#else
+    bool feed_wake_word = wake_word_->IsDetectionRunning();
+#endif
+    if (feed_wake_word) {
         int samples = wake_word_->GetFeedSize();
         if (samples > 0) {
-            if (ReadAudio(data, 16000, samples)) {
-                wake_word_->Feed(data);
-                return;
+            if (ReadAudio(audio_input_buffer_, 16000, samples)) {
+                // 待机时唤醒词检测在降频状态下运行，计算期间临时升频，不影响唤醒延迟
+                PowerBoostGuard boost;
+                wake_word_->Feed(audio_input_buffer_);
+                return true;
             }
         }
     }
 
     if (audio_processor_->IsRunning()) {
-        std::vector<int16_t> data;
         int samples = audio_processor_->GetFeedSize();
         if (samples > 0) {
-            if (ReadAudio(data, 16000, samples)) {
-                audio_processor_->Feed(data);
-                return;
+            if (ReadAudio(audio_input_buffer_, 16000, samples)) {
+                playout_clock_.OnCaptureRead(audio_input_buffer_.size() / Board::GetInstance().GetAudioCodec()->input_channels());
+                AudioTraceScope trace(kAudioTraceAfeFeed);
+                audio_processor_->Feed(audio_input_buffer_);
+                return true;
             }
         }
     }
+    return false;
+}
+
+int Application::GetPreferredUplinkFrameDuration() const {
+    // 实时模式下用更短的帧降低首包和打断延迟，其它模式 60ms 帧头开销更小
+    if (aec_mode_ != kAecOff) {
+        return CONFIG_REALTIME_FRAME_DURATION_MS;
+    }
+    return OPUS_FRAME_DURATION_MS;
+}
 
-    vTaskDelay(pdMS_TO_TICKS(OPUS_FRAME_DURATION_MS / 2));
+void Application::SetUplinkFrameDuration(int frame_duration) {
+    if (frame_duration <= 0 || uplink_frame_duration_.exchange(frame_duration) == frame_duration) {
+        return;
+    }
+    ESP_LOGI(TAG, "Uplink frame duration: %d ms", frame_duration);
+    // 队列按时长计算，帧越短能容纳的包越多
+    audio_send_queue_.SetMaxPackets(QueuePackets(frame_duration));
+    // 编码器只在编码任务里使用，由编码任务在下一帧之前重建，不需要加锁
+    encoder_rebuild_duration_ = frame_duration;
 }
 
 bool Application::ReadAudio(std::vector<int16_t>& data, int sample_rate, int samples) {
+    if (!ReadCodecAudio(data, sample_rate, samples)) {
+        return false;
+    }
+    if (sample_rate == 16000) {
+        // 能量门控和削波检测读这一份统计，不再各自遍历
+        int channels = Board::GetInstance().GetAudioCodec()->input_channels();
+        SignalLevels::GetInstance().Publish(kSignalCapture, data.data(), data.size() / channels, channels);
+    }
+#if CONFIG_AUDIO_SELF_TEST
+    if (sample_rate == 16000) {
+        audio_self_test_.Feed(data);
+    }
+#endif
+#if CONFIG_AEC_CALIBRATION
+    if (sample_rate == 16000) {
+        aec_calibrator_.Feed(data);
+        reference_aligner_.Process(data);
+    }
+#endif
+    return true;
+}
+
+bool Application::ReadCodecAudio(std::vector<int16_t>& data, int sample_rate, int samples) {
     auto codec = Board::GetInstance().GetAudioCodec();
     if (!codec->input_enabled()) {
         return false;
     }
+    int input_rate = codec->input_sample_rate();
+    if (input_rate != last_input_rate_) {
+        // codec 切换过采样率，重采样器里还是切换前的历史
+        std::lock_guard<std::mutex> lock(read_audio_mutex_);
+        input_resampler_.Reset();
+        reference_resampler_.Reset();
+        last_input_rate_ = input_rate;
+    }
+#if AUDIO_PIPELINE_SPECIALIZED
+    // 待机降到 16kHz 时不再是板级参数，走通用路径
+    if (board_pipeline_ && sample_rate == 16000 && input_rate == BoardAudioPipeline::kInputSampleRate) {
+        return ReadBoardAudio(codec, data, samples);
+    }
+#endif
 
-    if (codec->input_sample_rate() != sample_rate) {
-        data.resize(samples * codec->input_sample_rate() / sample_rate);
-        if (!codec->InputData(data)) {
+    // 中间缓冲区是成员变量，稳定运行后 resize 不会再分配内存
+    std::lock_guard<std::mutex> lock(read_audio_mutex_);
+    if (input_rate != sample_rate) {
+        raw_input_buffer_.resize(samples * input_rate / sample_rate);
+        uint32_t read_start_us = AudioTrace::Now();
+        if (!codec->InputData(raw_input_buffer_)) {
             return false;
         }
+        AudioTrace::Record(kAudioTraceI2sRead, read_start_us);
+        AudioTraceScope trace(kAudioTraceInputResample);
+        HotPathScope profile(kHotPathInputResample);
         if (codec->input_channels() == 2) {
-            auto mic_channel = std::vector<int16_t>(data.size() / 2);
-            auto reference_channel = std::vector<int16_t>(data.size() / 2);
-            for (size_t i = 0, j = 0; i < mic_channel.size(); ++i, j += 2) {
-                mic_channel[i] = data[j];
-                reference_channel[i] = data[j + 1];
-            }
-            auto resampled_mic = std::vector<int16_t>(input_resampler_.GetOutputSamples(mic_channel.size()));
-            auto resampled_reference = std::vector<int16_t>(reference_resampler_.GetOutputSamples(reference_channel.size()));
-            input_resampler_.Process(mic_channel.data(), mic_channel.size(), resampled_mic.data());
-            reference_resampler_.Process(reference_channel.data(), reference_channel.size(), resampled_reference.data());
-            data.resize(resampled_mic.size() + resampled_reference.size());
-            for (size_t i = 0, j = 0; i < resampled_mic.size(); ++i, j += 2) {
-                data[j] = resampled_mic[i];
-                data[j + 1] = resampled_reference[i];
-            }
+            size_t frames = raw_input_buffer_.size() / 2;
+            mic_buffer_.resize(frames);
+            reference_buffer_.resize(frames);
+            pcm::Deinterleave(raw_input_buffer_.data(), mic_buffer_.data(), reference_buffer_.data(), frames);
+            resampled_mic_buffer_.resize(input_resampler_.GetOutputSamples(frames));
+            resampled_reference_buffer_.resize(reference_resampler_.GetOutputSamples(frames));
+            input_resampler_.Process(mic_buffer_.data(), frames, resampled_mic_buffer_.data());
+            reference_resampler_.Process(reference_buffer_.data(), frames, resampled_reference_buffer_.data());
+            data.resize(resampled_mic_buffer_.size() * 2);
+            pcm::Interleave(resampled_mic_buffer_.data(), resampled_reference_buffer_.data(), data.data(),
+                resampled_mic_buffer_.size());
         } else {
-            auto resampled = std::vector<int16_t>(input_resampler_.GetOutputSamples(data.size()));
-            input_resampler_.Process(data.data(), data.size(), resampled.data());
-            data = std::move(resampled);
+            data.resize(input_resampler_.GetOutputSamples(raw_input_buffer_.size()));
+            input_resampler_.Process(raw_input_buffer_.data(), raw_input_buffer_.size(), data.data());
         }
     } else {
         data.resize(samples);
+        uint32_t read_start_us = AudioTrace::Now();
         if (!codec->InputData(data)) {
             return false;
         }
+        AudioTrace::Record(kAudioTraceI2sRead, read_start_us);
     }
     
     // 音频调试：发送原始音频数据
     if (audio_debugger_) {
-        audio_debugger_->Feed(data);
+        audio_debugger_->Feed(data, codec->input_channels(), sample_rate);
     }
     
     return true;
 }
 
+#if AUDIO_PIPELINE_SPECIALIZED
+// 按编译期的板级参数展开的采集路径，输出固定为 16kHz，用不到的重采样和声道拆分不会编译进来
+bool Application::ReadBoardAudio(AudioCodec* codec, std::vector<int16_t>& data, int samples) {
+    using Pipeline = BoardAudioPipeline;
+    std::lock_guard<std::mutex> lock(read_audio_mutex_);
+    uint32_t read_start_us = AudioTrace::Now();
+    if constexpr (Pipeline::kInputSampleRate == 16000) {
+        data.resize(samples);
+        if (!codec->InputData(data)) {
+            return false;
+        }
+        AudioTrace::Record(kAudioTraceI2sRead, read_start_us);
+    } else {
+        raw_input_buffer_.resize(samples * Pipeline::kInputSampleRate / 16000);
+        if (!codec->InputData(raw_input_buffer_)) {
+            return false;
+        }
+        AudioTrace::Record(kAudioTraceI2sRead, read_start_us);
+        AudioTraceScope trace(kAudioTraceInputResample);
+        if constexpr (Pipeline::kInputChannels == 2) {
+            size_t frames = raw_input_buffer_.size() / 2;
+            mic_buffer_.resize(frames);
+            reference_buffer_.resize(frames);
+            pcm::Deinterleave(raw_input_buffer_.data(), mic_buffer_.data(), reference_buffer_.data(), frames);
+            resampled_mic_buffer_.resize(input_resampler_.GetOutputSamples(frames));
+            resampled_reference_buffer_.resize(reference_resampler_.GetOutputSamples(frames));
+            input_resampler_.Process(mic_buffer_.data(), frames, resampled_mic_buffer_.data());
+            reference_resampler_.Process(reference_buffer_.data(), frames, resampled_reference_buffer_.data());
+            data.resize(resampled_mic_buffer_.size() * 2);
+            pcm::Interleave(resampled_mic_buffer_.data(), resampled_reference_buffer_.data(), data.data(),
+                resampled_mic_buffer_.size());
+        } else {
+            data.resize(input_resampler_.GetOutputSamples(raw_input_buffer_.size()));
+            input_resampler_.Process(raw_input_buffer_.data(), raw_input_buffer_.size(), data.data());
+        }
+    }
+
+    if (audio_debugger_) {
+        audio_debugger_->Feed(data, Pipeline::kInputChannels, 16000);
+    }
+    return true;
+}
+#endif
+
+void Application::StartTts() {
+    aborted_ = false;
+    assistant_message_open_ = false;
+    PrewarmOutput();
+    if (device_state_ == kDeviceStateIdle || device_state_ == kDeviceStateListening) {
+        SetDeviceState(kDeviceStateSpeaking);
+    }
+}
+
+#if CONFIG_OPUS_INBAND_FEC
+// 只报告上一次报告以来的增量，没有收到下行音频时不发
+void Application::SendReceiverReport() {
+    if (!protocol_ || !protocol_->receiver_report_enabled() || !protocol_->IsAudioChannelOpened()) {
+        return;
+    }
+    uint32_t received = jitter_buffer_.received_packets();
+    uint32_t lost = jitter_buffer_.lost_packets();
+    uint32_t recovered = jitter_buffer_.fec_packets();
+    if (received == report_received_base_ && lost == report_lost_base_) {
+        return;
+    }
+    protocol_->SendReceiverReport(received - report_received_base_, lost - report_lost_base_,
+        recovered - report_recovered_base_);
+    report_received_base_ = received;
+    report_lost_base_ = lost;
+    report_recovered_base_ = recovered;
+}
+#endif
+
+void Application::StopTts() {
+#if CONFIG_TTS_PHRASE_CACHE
+    phrase_cache_.EndRecord(!aborted_);
+#endif
+    if (latency_tracer_.EndTurn()) {
+#if CONFIG_REPORT_LATENCY_STATS
+        protocol_->SendLatencyReport(latency_tracer_.GetSessionJson());
+#endif
+    }
+    // 句子之间的正常停顿不算欠载
+    underrun_pending_ = false;
+    if (playback_monitor_.HasEvents()) {
+        auto stats = playback_monitor_.GetSessionJson();
+        ESP_LOGW(TAG, "Playback stats: %s", stats.c_str());
+#if CONFIG_REPORT_PLAYBACK_STATS
+        protocol_->SendPlaybackReport(stats);
+#endif
+    }
+    if (device_state_ == kDeviceStateSpeaking) {
+        if (listening_mode_ == kListeningModeManualStop) {
+            SetDeviceState(kDeviceStateIdle);
+        } else {
+            SetDeviceState(kDeviceStateListening);
+        }
+    }
+}
+
+#if CONFIG_TTS_PHRASE_CACHE
+// 缓存的句子当作一轮完整的 TTS 播放，播完后和收到 tts stop 一样切换状态
+void Application::PlayCachedPhrase(const std::string& id) {
+    auto phrase = phrase_cache_.Find(id);
+    if (!phrase) {
+        ESP_LOGW(TAG, "Phrase %s not cached", id.c_str());
+        protocol_->SendTtsCacheMiss(id);
+        return;
+    }
+    ESP_LOGI(TAG, "Play cached phrase %s", id.c_str());
+    StartTts();
+    if (device_state_ != kDeviceStateSpeaking) {
+        return;
+    }
+    uint32_t epoch = playback_epoch_;
+    // PushDecodeQueue 在队列满时等待，放到单独的任务中，不阻塞主循环
+    TaskStack::Create("phrase_play", 4096, 2, kTaskStackPsram, [this, phrase, epoch]() {
+        auto& frames = phrase->frames;
+        size_t pos = 0;
+        while (pos + 2 <= frames.size() && playback_epoch_ == epoch) {
+            size_t size = (frames[pos] << 8) | frames[pos + 1];
+            PushDecodeQueue(frames.data() + pos + 2, size, phrase->sample_rate, phrase->frame_duration);
+            pos += 2 + size;
+        }
+        // 等解码队列取空，切到聆听时会清空没解码的包
+        while (playback_epoch_ == epoch) {
+            {
+                std::lock_guard<std::mutex> lock(audio_decode_mutex_);
+                if (audio_decode_queue_.empty()) {
+                    break;
+                }
+            }
+            vTaskDelay(pdMS_TO_TICKS(phrase->frame_duration));
+        }
+        Schedule([this, epoch]() {
+            if (playback_epoch_ == epoch) {
+                StopTts();
+            }
+        });
+    });
+}
+#endif
+
 void Application::AbortSpeaking(AbortReason reason) {
     ESP_LOGI(TAG, "Abort speaking");
     aborted_ = true;
+#if CONFIG_TTS_PHRASE_CACHE
+    phrase_cache_.EndRecord(false);
+#endif
+    // 先让设备安静下来再通知服务器：丢弃排队的 TTS 包和已解码的 PCM，作废已提交的解码任务
+    playback_epoch_++;
+    {
+        std::lock_guard<std::mutex> lock(audio_decode_mutex_);
+        audio_decode_queue_.Clear();
+        jitter_buffer_.Reset();
+    }
+    audio_mixer_.RequestClear(kAudioSourceTts);
+    audio_decode_cv_.notify_all();
+#if CONFIG_AUDIO_FLUSH_ON_ABORT
+    // DMA 里还有几十毫秒已经写入的音频，渐弱后直接清空
+    Board::GetInstance().GetAudioCodec()->FlushOutput();
+#endif
     protocol_->SendAbortSpeaking(reason);
+#if CONFIG_IOT_PROTOCOL_MCP
+    McpServer::GetInstance().CancelToolCalls();
+#endif
 }
 
 void Application::SetListeningMode(ListeningMode mode) {
@@ -969,56 +2704,85 @@ void Application::SetDeviceState(DeviceState state) {
     }
     
     clock_ticks_ = 0;
+#if CONFIG_DEVICE_ENDPOINTING
+    endpoint_tick_ = -1;
+#endif
+#if CONFIG_AUDIO_LOOPBACK_TEST
+    // 测试期间进入其它状态，结果作废
+    StopLoopbackTest("loopback_abort");
+#endif
     auto previous_state = device_state_;
     device_state_ = state;
     ESP_LOGI(TAG, "STATE: %s", STATE_STRINGS[device_state_]);
-    // The state is changed, wait for all background tasks to finish
-    background_task_->WaitForCompletion();
+#if CONFIG_CRASH_RING
+    CrashRing::GetInstance().RecordState(STATE_STRINGS[device_state_]);
+#endif
+    if (audio_debugger_) {
+        audio_debugger_->Event(STATE_STRINGS[device_state_]);
+    }
+    // 切换状态不再等待后台任务：解码队列在各状态里清空，编码帧由编码任务按顺序处理完，
+    // 界面和指示灯的更新交给 UI 通道，不阻塞主循环
+    capture_pending_ = false;
+    PostStateUi(state);
 
     auto& board = Board::GetInstance();
-    auto display = board.GetDisplay();
-    auto led = board.GetLed();
-    led->OnStateChanged();
+    PowerGovernor::GetInstance().SetProfile(state == kDeviceStateIdle ? kPowerProfileIdle : kPowerProfileActive);
+    // 待机只检测唤醒词，输出关闭后 codec 可以降到 16kHz
+    board.GetAudioCodec()->SetIdleListening(state == kDeviceStateIdle);
     switch (state) {
         case kDeviceStateUnknown:
         case kDeviceStateIdle:
-            display->SetStatus(Lang::Strings::STANDBY);
-            display->SetEmotion("neutral");
+            // 唤醒后没有进入聆听（只按了音量键或者握手失败）不计入唤醒耗时
+            sleep_wake_us_ = 0;
             audio_processor_->Stop();
             wake_word_->StartDetection();
+            // 连接失败回到待机时恢复省电，通道还开着时等它关闭
+            if (previous_state == kDeviceStateConnecting && protocol_ && !protocol_->IsAudioChannelOpened()) {
+                board.SetPowerSaveMode(true);
+            }
             break;
         case kDeviceStateConnecting:
-            display->SetStatus(Lang::Strings::CONNECTING);
-            display->SetEmotion("neutral");
-            display->SetChatMessage("system", "");
-            timestamp_queue_.clear();
+            // 握手期间就关闭 Wi-Fi 省电，不等音频通道打开，减少唤醒后的首包延迟
+            board.SetPowerSaveMode(false);
+            playout_clock_.Reset();
             break;
         case kDeviceStateListening:
-            display->SetStatus(Lang::Strings::LISTENING);
-            display->SetEmotion("neutral");
+            if (sleep_wake_us_ != 0) {
+                int64_t wake_us = esp_timer_get_time() - sleep_wake_us_;
+                sleep_wake_us_ = 0;
+                metric_wake_to_listen_us.Record(wake_us);
+                ESP_LOGI(TAG, "Wake to listening: %lld ms", wake_us / 1000);
+            }
+            // 聆听之后大概率会有回复
+            PrewarmOutput();
             // Update the IoT states before sending the start listening command
 #if CONFIG_IOT_PROTOCOL_XIAOZHI
             UpdateIotStates();
 #endif
 
-            // Make sure the audio processor is running
-            if (!audio_processor_->IsRunning()) {
+            if (uplink_staging_) {
+                // 握手期间已经在采集，暂存的音频在 listen start 之后发出
+                uplink_staging_ = false;
+                protocol_->SendStartListening(listening_mode_);
+            } else if (!audio_processor_->IsRunning()) {
+                // Make sure the audio processor is running
                 // Send the start listening command
                 protocol_->SendStartListening(listening_mode_);
                 if (previous_state == kDeviceStateSpeaking) {
-                    audio_decode_queue_.clear();
+                    {
+                        std::lock_guard<std::mutex> lock(audio_decode_mutex_);
+                        audio_decode_queue_.Clear();
+                        jitter_buffer_.Reset();
+                    }
                     audio_decode_cv_.notify_all();
-                    // FIXME: Wait for the speaker to empty the buffer
-                    vTaskDelay(pdMS_TO_TICKS(120));
+                    // 扬声器里还有没播完的 TTS，播完再开始采集，采集在 OnSpeakerDrained 中开始
+                    WaitSpeakerDrained();
+                    break;
                 }
-                opus_encoder_->ResetState();
-                audio_processor_->Start();
-                wake_word_->StopDetection();
+                StartUplinkCapture(listening_mode_);
             }
             break;
         case kDeviceStateSpeaking:
-            display->SetStatus(Lang::Strings::SPEAKING);
-
             if (listening_mode_ != kListeningModeRealtime) {
                 audio_processor_->Stop();
                 // Only AFE wake word can be detected in speaking mode
@@ -1030,42 +2794,148 @@ void Application::SetDeviceState(DeviceState state) {
             }
             ResetDecoder();
             break;
+        case kDeviceStateBenchmarking:
+            audio_processor_->Stop();
+            wake_word_->StopDetection();
+            break;
         default:
             // Do nothing
             break;
     }
+    // 采集任务没有消费者时在等待通知
+    NotifyAudioInput();
+}
+
+// 状态对应的界面在 UI 通道中按顺序执行，指示灯读取执行时的最新状态
+void Application::PostStateUi(DeviceState state) {
+    auto update = [state]() {
+        auto& board = Board::GetInstance();
+        auto display = board.GetDisplay();
+        board.GetLed()->OnStateChanged();
+        display->SetRefreshActive(state == kDeviceStateConnecting || state == kDeviceStateListening ||
+            state == kDeviceStateSpeaking);
+        auto camera = board.GetCamera();
+        if (camera != nullptr) {
+            camera->SetActive(state == kDeviceStateListening || state == kDeviceStateSpeaking);
+        }
+        switch (state) {
+            case kDeviceStateUnknown:
+            case kDeviceStateIdle:
+                display->SetStatus(Lang::Strings::STANDBY);
+                display->SetEmotion("neutral");
+                break;
+            case kDeviceStateConnecting:
+                display->SetStatus(Lang::Strings::CONNECTING);
+                display->SetEmotion("neutral");
+                display->SetChatMessage("system", "");
+                break;
+            case kDeviceStateListening:
+                display->SetStatus(Lang::Strings::LISTENING);
+                display->SetEmotion("neutral");
+                break;
+            case kDeviceStateSpeaking:
+                display->SetStatus(Lang::Strings::SPEAKING);
+                break;
+            case kDeviceStateBenchmarking:
+                display->SetChatMessage("system", "Transport benchmark");
+                break;
+            default:
+                break;
+        }
+    };
+    // 升级前后台任务已经删除，直接更新
+    if (background_task_ == nullptr || background_task_->Schedule(kBackgroundLaneUi, update) != kBackgroundScheduleOk) {
+        update();
+    }
+}
+
+// 等 codec 的播放 DMA 播空，输出已关闭时立即开始；没有 DMA 回调的 codec 由定时器兜底
+void Application::WaitSpeakerDrained() {
+    auto codec = Board::GetInstance().GetAudioCodec();
+    capture_pending_ = true;
+    if (!codec->output_enabled()) {
+        xEventGroupSetBits(event_group_, SPEAKER_DRAINED_EVENT);
+        return;
+    }
+    codec->NotifyOutputDrained(event_group_, SPEAKER_DRAINED_EVENT);
+    // 最多还有一帧正在解码写入
+    int timeout_ms = codec->output_drain_ms() + OPUS_FRAME_DURATION_MS + 20;
+    esp_timer_stop(drain_timer_handle_);
+    esp_timer_start_once(drain_timer_handle_, timeout_ms * 1000);
+}
+
+void Application::OnSpeakerDrained() {
+    esp_timer_stop(drain_timer_handle_);
+    // 等待期间状态又变了（例如再次打断进入说话）就不再开始采集
+    if (!capture_pending_ || device_state_ != kDeviceStateListening) {
+        return;
+    }
+    capture_pending_ = false;
+    StartUplinkCapture(listening_mode_);
 }
 
 void Application::ResetDecoder() {
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<std::mutex> lock(audio_decode_mutex_);
+    sound_player_.Clear();
+    audio_mixer_.RequestClear(kAudioSourceTts);
+    audio_mixer_.RequestClear(kAudioSourcePrompt);
     opus_decoder_->ResetState();
-    audio_decode_queue_.clear();
+#if CONFIG_AUDIO_DRIFT_COMPENSATION
+    drift_compensator_.Reset();
+#endif
+    audio_decode_queue_.Clear();
+    jitter_buffer_.Reset();
     audio_decode_cv_.notify_all();
     last_output_time_ = std::chrono::steady_clock::now();
     auto codec = Board::GetInstance().GetAudioCodec();
-    codec->EnableOutput(true);
+    if (!codec->output_enabled()) {
+        // 没有提前预热，开头的一段会等功放稳定后才播放
+        metric_output_cold_start.Add();
+        codec->EnableOutput(true);
+    }
+    NotifyAudioOutput();
 }
 
-void Application::SetDecodeSampleRate(int sample_rate, int frame_duration) {
-    if (opus_decoder_->sample_rate() == sample_rate && opus_decoder_->duration_ms() == frame_duration) {
+#if CONFIG_DEVICE_ENDPOINTING
+// 设备判定一句话说完：立即通知服务器并停止采集，保持聆听状态等待回复，收到 tts start 后进入说话状态
+void Application::OnEndpoint() {
+    if (device_state_ != kDeviceStateListening || listening_mode_ != kListeningModeAutoStop || !protocol_) {
         return;
     }
+    protocol_->SendStopListening();
+    audio_processor_->Stop();
+    endpoint_tick_ = clock_ticks_;
+}
+#endif
 
-    opus_decoder_.reset();
-    opus_decoder_ = std::make_unique<OpusDecoderWrapper>(sample_rate, 1, frame_duration);
-
+// 预计马上要播放回复时提前打开输出，功放稳定时间和 TTS 首包的网络延迟重叠
+void Application::PrewarmOutput() {
+#if CONFIG_AUDIO_OUTPUT_PREWARM
     auto codec = Board::GetInstance().GetAudioCodec();
-    if (opus_decoder_->sample_rate() != codec->output_sample_rate()) {
-        ESP_LOGI(TAG, "Resampling audio from %d to %d", opus_decoder_->sample_rate(), codec->output_sample_rate());
-        output_resampler_.Configure(opus_decoder_->sample_rate(), codec->output_sample_rate());
+    last_output_time_ = std::chrono::steady_clock::now();
+    if (!codec->output_enabled()) {
+        metric_output_prewarm.Add();
+        codec->EnableOutput(true);
+    }
+#endif
+}
+
+void Application::SetDecodeSampleRate(int sample_rate, int frame_duration) {
+    if (opus_decoder_ != nullptr && opus_decoder_->sample_rate() == sample_rate && opus_decoder_->duration_ms() == frame_duration) {
+        return;
     }
+
+    // 切换回用过的参数时复用缓存的实例，只重置状态
+    auto& entry = decoder_cache_.Get(sample_rate, frame_duration);
+    opus_decoder_ = entry.decoder.get();
+    output_resampler_ = entry.resampler.get();
 }
 
-void Application::UpdateIotStates() {
+void Application::UpdateIotStates(bool dirty_only) {
 #if CONFIG_IOT_PROTOCOL_XIAOZHI
     auto& thing_manager = iot::ThingManager::GetInstance();
     std::string states;
-    if (thing_manager.GetStatesJson(states, true)) {
+    if (thing_manager.GetStatesJson(states, true, dirty_only) && protocol_) {
         protocol_->SendIotStates(states);
     }
 #endif
@@ -1076,8 +2946,32 @@ void Application::Reboot() {
     esp_restart();
 }
 
+// 发送已经编码好的唤醒词包，全部发完返回 true
+bool Application::SendWakeWordOpus() {
+    while (true) {
+        auto state = wake_word_->TryGetWakeWordOpus(wake_word_packet_.payload);
+        if (state == kWakeWordOpusPending) {
+            return false;
+        }
+        if (state == kWakeWordOpusDone) {
+            break;
+        }
+        if (protocol_->IsAudioChannelOpened() && protocol_->SendAudio(wake_word_packet_)) {
+            latency_tracer_.Mark(kLatencyFirstUplink);
+        }
+    }
+    wake_word_upload_ = false;
+    if (protocol_->IsAudioChannelOpened()) {
+        protocol_->FlushAudio();
+        protocol_->SendWakeWordDetected(wake_word_upload_word_);
+    }
+    return true;
+}
+
 void Application::WakeWordInvoke(const std::string& wake_word) {
     if (device_state_ == kDeviceStateIdle) {
+        latency_tracer_.BeginTurn();
+        latency_tracer_.Mark(kLatencyWakeWord);
         ToggleChatState();
         Schedule([this, wake_word]() {
             if (protocol_) {
@@ -1091,12 +2985,77 @@ void Application::WakeWordInvoke(const std::string& wake_word) {
     } else if (device_state_ == kDeviceStateListening) {   
         Schedule([this]() {
             if (protocol_) {
-                protocol_->CloseAudioChannel();
+                ParkAudioChannel();
             }
         });
     }
 }
 
+// 有 MCP 时通过同名工具执行，服务器随后收到通知，不会再执行一次
+static void RunLocalTool(const char* tool, const char* key, int value, const std::string& text,
+    const std::function<void()>& fallback) {
+#if CONFIG_IOT_PROTOCOL_MCP
+    cJSON* arguments = cJSON_CreateObject();
+    cJSON_AddNumberToObject(arguments, key, value);
+    bool done = McpServer::GetInstance().CallToolLocally(tool, arguments, text);
+    cJSON_Delete(arguments);
+    if (done) {
+        return;
+    }
+#endif
+    fallback();
+}
+
+// 离线命令词和 stt 中匹配到的简单命令在本地立即执行，不等服务器的 LLM
+void Application::ExecuteLocalIntent(const LocalIntent& intent, const std::string& text) {
+    auto& board = Board::GetInstance();
+    auto codec = board.GetAudioCodec();
+    auto backlight = board.GetBacklight();
+    switch (intent.command) {
+        case kLocalCommandVolumeUp:
+        case kLocalCommandVolumeDown:
+        case kLocalCommandVolumeSet: {
+            int volume = intent.value;
+            if (intent.command != kLocalCommandVolumeSet) {
+                volume = codec->output_volume() + (intent.command == kLocalCommandVolumeUp ? 10 : -10);
+            }
+            volume = std::clamp(volume, 0, 100);
+            RunLocalTool("self.audio_speaker.set_volume", "volume", volume, text, [codec, volume]() {
+                codec->SetOutputVolume(volume);
+            });
+            board.GetDisplay()->ShowNotification(Lang::Strings::VOLUME + std::to_string(volume));
+            break;
+        }
+        case kLocalCommandBrightnessUp:
+        case kLocalCommandBrightnessDown:
+        case kLocalCommandBrightnessSet: {
+            if (backlight == nullptr) {
+                break;
+            }
+            int brightness = intent.value;
+            if (intent.command != kLocalCommandBrightnessSet) {
+                brightness = backlight->brightness() + (intent.command == kLocalCommandBrightnessUp ? 10 : -10);
+            }
+            brightness = std::clamp(brightness, 0, 100);
+            RunLocalTool("self.screen.set_brightness", "brightness", brightness, text, [backlight, brightness]() {
+                backlight->SetBrightness(brightness, true);
+            });
+            break;
+        }
+        case kLocalCommandStop:
+            if (device_state_ == kDeviceStateSpeaking) {
+                AbortSpeaking(kAbortReasonNone);
+            } else if (device_state_ == kDeviceStateListening && protocol_) {
+                ParkAudioChannel();
+            }
+            break;
+    }
+}
+
+void Application::OnSleepWake() {
+    sleep_wake_us_ = esp_timer_get_time();
+}
+
 bool Application::CanEnterSleepMode() {
     if (device_state_ != kDeviceStateIdle) {
         return false;
@@ -1118,6 +3077,19 @@ void Application::SendMcpMessage(const std::string& payload) {
     });
 }
 
+bool Application::McpChunksEnabled() const {
+    return protocol_ && protocol_->mcp_chunks_enabled();
+}
+
+// 主循环按顺序执行，同一条消息的块不会乱序
+void Application::SendMcpChunk(uint32_t message_id, uint32_t index, bool last, std::string fragment) {
+    Schedule([this, message_id, index, last, fragment = std::move(fragment)]() {
+        if (protocol_) {
+            protocol_->SendMcpChunk(message_id, index, last, fragment);
+        }
+    });
+}
+
 void Application::SetAecMode(AecMode mode) {
     aec_mode_ = mode;
     Schedule([this]() {
@@ -1142,5 +3114,9 @@ void Application::SetAecMode(AecMode mode) {
         if (protocol_ && protocol_->IsAudioChannelOpened()) {
             protocol_->CloseAudioChannel();
         }
+        // 下次 hello 按新模式申请帧长
+        if (protocol_) {
+            protocol_->SetUplinkFrameDuration(GetPreferredUplinkFrameDuration());
+        }
     });
 }
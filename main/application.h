@@ -13,20 +13,58 @@
 #include <condition_variable>
 #include <memory>
 
-#include <opus_encoder.h>
 #include <opus_decoder.h>
-#include <opus_resampler.h>
 
 #include "protocol.h"
+#include "audio_resampler.h"
+#include "decoder_cache.h"
+#include "drift_compensator.h"
+#include "audio_pipeline.h"
+#include "memory_profile.h"
 #include "ota.h"
 #include "background_task.h"
 #include "audio_processor.h"
 #include "wake_word.h"
+#include "local_intent.h"
 #include "audio_debugger.h"
+#include "audio_packet_queue.h"
+#include "audio_frame_ring.h"
+#include "jitter_buffer.h"
+#include "latency_tracer.h"
+#include "playback_monitor.h"
+#if CONFIG_TTS_PHRASE_CACHE
+#include "phrase_cache.h"
+#endif
+#include "aec_calibration.h"
+#include "audio_self_test.h"
+#include "encoder_controller.h"
+#include "uplink_gate.h"
+#include "endpoint_detector.h"
+#include "sound_player.h"
+#include "audio_mixer.h"
+#include "playout_clock.h"
+#include "transport_benchmark.h"
+#include "transport_policy.h"
+#include "message_dispatcher.h"
+#include "inplace_function.h"
+#include "lock_profiler.h"
+#if CONFIG_USE_SHARED_AFE
+#include "afe_front_end.h"
+#endif
 
 #define SCHEDULE_EVENT (1 << 0)
 #define SEND_AUDIO_EVENT (1 << 1)
 #define CHECK_NEW_VERSION_DONE_EVENT (1 << 2)
+#define BOOT_INIT_DONE_EVENT (1 << 3)
+#define SPEAKER_DRAINED_EVENT (1 << 4)
+
+// 主循环任务队列的槽位数，以及每个回调可以内联保存的捕获大小
+#define MAIN_TASK_QUEUE_SIZE 32
+#define MAIN_TASK_CAPTURE_SIZE 32
+
+// 播放任务的任务通知位
+#define AUDIO_OUTPUT_DATA_NOTIFY (1 << 0)
+#define AUDIO_OUTPUT_DONE_NOTIFY (1 << 1)
 
 enum AecMode {
     kAecOff,
@@ -45,12 +83,27 @@ enum DeviceState {
     kDeviceStateUpgrading,
     kDeviceStateActivating,
     kDeviceStateAudioTesting,
+    kDeviceStateBenchmarking,
     kDeviceStateFatalError
 };
 
+// 默认帧长，提示音资源也按 60ms 编码；上行帧长在每次会话开始时确定
 #define OPUS_FRAME_DURATION_MS 60
-#define MAX_AUDIO_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
+#define MIN_OPUS_FRAME_DURATION_MS 20
+// 队列按时长计算，包数上限随帧长调整，时长按板子的内存档位选择
+#define AUDIO_QUEUE_DURATION_MS MEMORY_PROFILE_AUDIO_QUEUE_MS
+// 下行接收报告的间隔
+#define RECEIVER_REPORT_INTERVAL_SECONDS 5
+#define MAX_AUDIO_PACKETS_IN_QUEUE (AUDIO_QUEUE_DURATION_MS / OPUS_FRAME_DURATION_MS)
+// 等待编码的 PCM 帧数，编码任务跟不上时多出来的帧直接丢弃
+#define AUDIO_ENCODE_RING_FRAMES 8
 #define AUDIO_TESTING_MAX_DURATION_MS 10000
+// 队列按包内联存储负载，按平均包长预留字节空间，帧长越短包越小
+#define AUDIO_PACKET_QUEUE_BYTES (MAX_AUDIO_PACKETS_IN_QUEUE * 400)
+#define AUDIO_TESTING_QUEUE_BYTES (AUDIO_TESTING_MAX_DURATION_MS / OPUS_FRAME_DURATION_MS * 192)
+// 上行门控保留的语音前导和静音拖尾时长
+#define UPLINK_GATE_PREROLL_MS 300
+#define UPLINK_GATE_HANGOVER_MS 300
 
 class Application {
 public:
@@ -65,7 +118,13 @@ public:
     void Start();
     DeviceState GetDeviceState() const { return device_state_; }
     bool IsVoiceDetected() const { return voice_detected_; }
-    void Schedule(std::function<void()> callback);
+    // 捕获不超过 MAIN_TASK_CAPTURE_SIZE 字节的回调直接存进主循环的固定队列，不分配内存
+    template <typename F>
+    [[gnu::noinline]] void Schedule(F&& callback) {
+        PushMainTask(MainTask(std::forward<F>(callback)), __builtin_return_address(0));
+    }
+    // 启动完成、开始处理 Schedule 的任务之后为 true
+    bool IsMainLoopRunning() const { return main_loop_running_; }
     void SetDeviceState(DeviceState state);
     void Alert(const char* status, const char* message, const char* emotion = "", const std::string_view& sound = "");
     void DismissAlert();
@@ -73,70 +132,290 @@ public:
     void ToggleChatState();
     void StartListening();
     void StopListening();
-    void UpdateIotStates();
+    void UpdateIotStates(bool dirty_only = false);
     void Reboot();
     void WakeWordInvoke(const std::string& wake_word);
-    void PlaySound(const std::string_view& sound);
+    void PlaySound(const std::string_view& sound, uint32_t start_ms = 0);
+#if CONFIG_SOUND_PARTITION_PLAYBACK
+    // 播放 sound 分区中的长音频（p3 v2），返回音频时长，分区无效时返回 -1
+    int PlayStoredSound(uint32_t start_ms);
+#endif
     bool CanEnterSleepMode();
+    // PowerSaveTimer 退出省电模式时调用，进入聆听时统计唤醒耗时
+    void OnSleepWake();
     void SendMcpMessage(const std::string& payload);
+    // 服务器确认了 mcp_chunks 时为 true，见 McpMessageWriter
+    bool McpChunksEnabled() const;
+    void SendMcpChunk(uint32_t message_id, uint32_t index, bool last, std::string fragment);
     void SetAecMode(AecMode mode);
     bool ReadAudio(std::vector<int16_t>& data, int sample_rate, int samples);
     AecMode GetAecMode() const { return aec_mode_; }
     BackgroundTask* GetBackgroundTask() const { return background_task_; }
+    Protocol* GetProtocol() const { return protocol_.get(); }
+    // 板子在协议启动之前注册自己的消息类型
+    MessageDispatcher& GetMessageDispatcher() { return message_dispatcher_; }
+    // 通过当前配置的传输层做回环基准测试，服务器端使用 scripts/transport_benchmark_server.py
+    bool StartTransportBenchmark(int frames_per_second, int duration_seconds);
+    void StopTransportBenchmark();
+    std::string GetTransportBenchmarkResult() const { return transport_benchmark_.GetResultJson(); }
+#if CONFIG_AEC_CALIBRATION
+    // 空闲时播放提示音测量扬声器到麦克风的延迟，保存后每次启动用来对齐回采通道
+    void CalibrateAec();
+#endif
+#if CONFIG_AUDIO_LOOPBACK_TEST
+    // 空闲时播放测试音并运行 AFE，结果不上传，由 scripts/audio_loopback_test.py 从调试数据流中分析
+    void StartLoopbackTest();
+#endif
+#if CONFIG_AUDIO_SELF_TEST
+    // 空闲或音频测试模式下运行音频链路自检，结果显示在屏幕上；callback 在后台任务中调用，参数是 JSON 结果
+    void StartAudioSelfTest(std::function<void(const std::string& json)> callback = nullptr);
+#endif
 
 private:
+    using MainTask = InplaceFunction<MAIN_TASK_CAPTURE_SIZE>;
+    struct ScheduledTask {
+        MainTask callback;
+        const void* caller = nullptr;   // 调用 Schedule 的代码地址，卡顿时用来定位
+        int64_t enqueue_us = 0;
+    };
+
     Application();
     ~Application();
 
+    void PushMainTask(MainTask&& callback, const void* caller);
+    bool PopMainTask(ScheduledTask& task);
+
+#if CONFIG_USE_SHARED_AFE
+    // 唤醒词和降噪共用的 AFE，要比两者后析构
+    std::unique_ptr<AfeFrontEnd> afe_front_end_;
+#endif
     std::unique_ptr<WakeWord> wake_word_;
     std::unique_ptr<AudioProcessor> audio_processor_;
     std::unique_ptr<AudioDebugger> audio_debugger_;
-    std::mutex mutex_;
-    std::list<std::function<void()>> main_tasks_;
+    ProfiledMutex mutex_{kLockApplication};
+    // 固定大小的环形队列，满了以后临时放进 main_tasks_overflow_，主循环里调用 Schedule 也不会阻塞或丢任务
+    ScheduledTask main_tasks_[MAIN_TASK_QUEUE_SIZE];
+    size_t main_tasks_head_ = 0;
+    size_t main_tasks_count_ = 0;
+    std::list<ScheduledTask> main_tasks_overflow_;
+    std::atomic<bool> main_loop_running_{false};
     std::unique_ptr<Protocol> protocol_;
+    MessageDispatcher message_dispatcher_;
+    TransportKind protocol_kind_ = kTransportMqttUdp;
+#if CONFIG_ENABLE_PROTOCOL_FAILOVER
+    // OTA 同时下发两种配置时的另一种协议，握手失败或会话中出错时换用
+    std::unique_ptr<Protocol> standby_protocol_;
+    TransportPolicy transport_policy_;
+    bool failover_armed_ = false;
+    std::atomic<bool> failover_pending_{false};
+#if CONFIG_AEC_CALIBRATION
+    AecCalibrator aec_calibrator_;
+    ReferenceAligner reference_aligner_;
+    void FinishAecCalibration(bool ok, const AecCalibration& calibration);
+#endif
+#if CONFIG_AUDIO_LOOPBACK_TEST
+    std::atomic<bool> loopback_test_{false};
+    esp_timer_handle_t loopback_timer_ = nullptr;
+    bool loopback_playing_ = false;
+    uint32_t loopback_sound_ms_ = 0;
+    void OnLoopbackTimer();
+    void StopLoopbackTest(const char* event);
+#endif
+#if CONFIG_AUDIO_SELF_TEST
+    AudioSelfTest audio_self_test_;
+    // 空闲时为自检打开了 AFE
+    bool self_test_afe_ = false;
+    void FinishAudioSelfTest(const AudioSelfTestResult& result);
+#endif
+    std::atomic<uint32_t> downlink_packets_{0};
+    uint32_t session_received_base_ = 0;
+    uint32_t session_lost_base_ = 0;
+#endif
+#if CONFIG_OPUS_INBAND_FEC
+    // 上一次接收报告时的累计值
+    uint32_t report_received_base_ = 0;
+    uint32_t report_lost_base_ = 0;
+    uint32_t report_recovered_base_ = 0;
+    void SendReceiverReport();
+#endif
     EventGroupHandle_t event_group_ = nullptr;
-    esp_timer_handle_t clock_timer_handle_ = nullptr;
+    int clock_timer_ = -1;
+    // 从说话切到聆听时等扬声器播完再开始采集，由 codec 的 DMA 播空中断或超时定时器触发 SPEAKER_DRAINED_EVENT
+    esp_timer_handle_t drain_timer_handle_ = nullptr;
+    bool capture_pending_ = false;
     volatile DeviceState device_state_ = kDeviceStateUnknown;
     ListeningMode listening_mode_ = kListeningModeAutoStop;
     AecMode aec_mode_ = kAecOff;
 
     bool has_server_time_ = false;
     bool aborted_ = false;
+    // 本轮 tts 已经显示过第一句，只在主循环中访问
+    bool assistant_message_open_ = false;
+    // 打断时加一，已经提交但还没执行的解码任务发现变化后直接丢弃
+    std::atomic<uint32_t> playback_epoch_{0};
+    bool background_upgrade_started_ = false;
     bool voice_detected_ = false;
-    bool busy_decoding_audio_ = false;
+    // 握手期间已经开始采集，只在主循环中访问
+    bool uplink_staging_ = false;
     int clock_ticks_ = 0;
     TaskHandle_t check_new_version_task_handle_ = nullptr;
 
     // Audio encode / decode
-    TaskHandle_t audio_loop_task_handle_ = nullptr;
+    TaskHandle_t audio_input_task_handle_ = nullptr;
+    TaskHandle_t audio_output_task_handle_ = nullptr;
     BackgroundTask* background_task_ = nullptr;
     std::chrono::steady_clock::time_point last_output_time_;
-    std::list<AudioStreamPacket> audio_send_queue_;
-    std::list<AudioStreamPacket> audio_decode_queue_;
+    AudioPacketQueue audio_send_queue_{MAX_AUDIO_PACKETS_IN_QUEUE, AUDIO_PACKET_QUEUE_BYTES};
+    // 发送失败但通道仍然打开时保留的包，只在主循环中访问
+    AudioStreamPacket uplink_packet_;
+    bool uplink_retry_ = false;
+    // 唤醒词音频正在后台编码和发送
+    bool wake_word_upload_ = false;
+    std::string wake_word_upload_word_;
+    AudioStreamPacket wake_word_packet_;
+    AudioPacketQueue audio_decode_queue_{MAX_AUDIO_PACKETS_IN_QUEUE, AUDIO_PACKET_QUEUE_BYTES};
+    std::atomic<int> uplink_frame_duration_{OPUS_FRAME_DURATION_MS};
+    // 内存紧张时队列包数上限减半
+    std::atomic<bool> queues_shrunk_{false};
+    std::atomic<int64_t> sleep_wake_us_{0};
+    // 解码队列有多个生产者（网络任务、音频测试回放），生产者之间用这个锁串行化
+    std::mutex audio_decode_mutex_;
     std::condition_variable audio_decode_cv_;
-    std::list<AudioStreamPacket> audio_testing_queue_;
+    JitterBuffer jitter_buffer_{audio_decode_queue_};
+    LatencyTracer latency_tracer_;
+    PlaybackMonitor playback_monitor_;
+#if CONFIG_TTS_PHRASE_CACHE
+    PhraseCache phrase_cache_;
+    void PlayCachedPhrase(const std::string& id);
+#endif
+    // 以下只在播放任务中访问，underrun_pending_ 在 tts stop 时由主循环清除
+    std::atomic<bool> underrun_pending_{false};
+    int concealed_in_gap_ = 0;
+    uint32_t last_codec_underruns_ = 0;
+    uint32_t last_overflows_ = 0;
+    EncoderController encoder_controller_;
+    UplinkGate uplink_gate_{16000, UPLINK_GATE_PREROLL_MS, UPLINK_GATE_HANGOVER_MS};
+#if CONFIG_DEVICE_ENDPOINTING
+    EndpointDetector endpoint_detector_{16000, CONFIG_ENDPOINT_MIN_SPEECH_MS, CONFIG_ENDPOINT_HANGOVER_MS};
+    // 设备判定说完时的 clock_ticks_，等待回复期间有效，否则为 -1
+    int endpoint_tick_ = -1;
+#endif
+    SoundPlayer sound_player_;
+    AudioMixer audio_mixer_;
+    std::unique_ptr<AudioPacketQueue> audio_testing_queue_;
+
+    // 服务端 AEC：上行包的时间戳是采集时正在播放的下行音频时间戳
+    PlayoutClock playout_clock_;
+    TransportBenchmark transport_benchmark_;
+
+    std::unique_ptr<OpusStreamEncoder> opus_encoder_;
+    // 上行 PCM 在音频处理任务里直接拼接到帧队列的槽位中，由单独的编码任务取出编码
+    // 音频测试只在配网时进行，这时音频处理器没有运行，两处生产者不会同时写入
+    AudioFrameRing encode_ring_{AUDIO_ENCODE_RING_FRAMES, 16000 * OPUS_FRAME_DURATION_MS / 1000};
+    AudioFrameRing::Frame* uplink_frame_ = nullptr;     // 正在拼接的帧
+    size_t uplink_frame_samples_ = 0;
+    bool uplink_frame_onset_ = false;
+    std::atomic<bool> uplink_frame_reset_{false};
+    TaskHandle_t audio_encode_task_handle_ = nullptr;
+    // 以下只在编码任务中使用：编码器和它的输出缓冲区；帧长变化时由编码任务重建编码器
+    std::atomic<int> encoder_rebuild_duration_{0};
+    std::vector<uint8_t> uplink_opus_;
+    // 当前 TTS 参数对应的解码器和重采样器，实例由 decoder_cache_ 持有
+    DecoderCache decoder_cache_;
+    OpusStreamDecoder* opus_decoder_ = nullptr;
+    AudioResampler* output_resampler_ = nullptr;
+    std::unique_ptr<OpusDecoderWrapper> prompt_decoder_;
+#if CONFIG_AUDIO_DRIFT_COMPENSATION
+    DriftCompensator drift_compensator_;
+#endif
 
-    // 新增：用于维护音频包的timestamp队列
-    std::list<uint32_t> timestamp_queue_;
-    std::mutex timestamp_mutex_;
+    AudioResampler input_resampler_;
+    AudioResampler reference_resampler_;
+    // 上一次采集时 codec 的采样率，变化后重置重采样器
+    int last_input_rate_ = 0;
+    AudioResampler prompt_resampler_;
 
-    std::unique_ptr<OpusEncoderWrapper> opus_encoder_;
-    std::unique_ptr<OpusDecoderWrapper> opus_decoder_;
+    // 采集路径的中间缓冲区，避免每帧分配内存
+    std::mutex read_audio_mutex_;
+    std::vector<int16_t> audio_input_buffer_;
+    std::vector<int16_t> raw_input_buffer_;
+    std::vector<int16_t> mic_buffer_;
+    std::vector<int16_t> reference_buffer_;
+    std::vector<int16_t> resampled_mic_buffer_;
+    std::vector<int16_t> resampled_reference_buffer_;
+#if AUDIO_PIPELINE_SPECIALIZED
+    // codec 的运行时参数与编译期的板级参数一致时采集走特化路径
+    bool board_pipeline_ = false;
+    bool ReadBoardAudio(AudioCodec* codec, std::vector<int16_t>& data, int samples);
+#endif
 
-    OpusResampler input_resampler_;
-    OpusResampler reference_resampler_;
-    OpusResampler output_resampler_;
+    // 播放路径的解码与重采样缓冲区
+    std::vector<int16_t> output_pcm_buffer_;
+    std::vector<int16_t> output_resampled_buffer_;
+    std::vector<int16_t> prompt_pcm_buffer_;
+    std::vector<int16_t> prompt_resampled_buffer_;
+    std::vector<int16_t> output_mix_buffer_;
 
     void MainEventLoop();
-    void OnAudioInput();
-    void OnAudioOutput();
+    bool OnAudioInput();
+    int GetPreferredUplinkFrameDuration() const;
+    void SetUplinkFrameDuration(int frame_duration);
+    void UpdatePlaybackMonitor(AudioCodec* codec);
+    bool SendWakeWordOpus();
+    void StartTts();
+    void StopTts();
+    bool ReadCodecAudio(std::vector<int16_t>& data, int sample_rate, int samples);
+    void DecodeTtsPacket(AudioCodec* codec, AudioStreamPacket& packet);
+    void DecodeSoundFrame(AudioCodec* codec, const SoundFrame& frame, std::vector<uint8_t>& payload);
+    void PostStateUi(DeviceState state);
+#if CONFIG_THERMAL_GOVERNOR
+    void ApplyThermalLevel();
+#endif
+    size_t QueuePackets(int frame_duration) const;
+    void SubscribeMemoryPressure();
+    void ExecuteLocalIntent(const LocalIntent& intent, const std::string& text);
+    void WaitSpeakerDrained();
+    void OnSpeakerDrained();
+    void EncodeUplinkAudio(std::span<const int16_t> data, uint32_t timestamp, bool onset);
+    void CommitUplinkFrame();
+    void AudioEncodeLoop();
+    void EncodeFrame(AudioFrameRing::Frame& frame);
+    bool OnAudioOutput();
+    void NotifyAudioInput();
+    void NotifyAudioOutput(uint32_t bits = AUDIO_OUTPUT_DATA_NOTIFY);
     void ResetDecoder();
+    void PrewarmOutput();
+#if CONFIG_DEVICE_ENDPOINTING
+    void OnEndpoint();
+#endif
+    void PushDecodeQueue(const uint8_t* payload, size_t size, int sample_rate, int frame_duration);
     void SetDecodeSampleRate(int sample_rate, int frame_duration);
     void CheckNewVersion(Ota& ota);
+    void CheckNewVersionInBackground();
+#if CONFIG_OTA_BACKGROUND_UPGRADE
+    void StartBackgroundUpgrade();
+    void BackgroundUpgrade(Ota& ota);
+#endif
+    void InitializeAudioPipeline();
     void ShowActivationCode(const std::string& code, const std::string& message);
     void OnClockTimer();
     void SetListeningMode(ListeningMode mode);
-    void AudioLoop();
+    void ParkAudioChannel();
+    bool OpenAudioChannel(ListeningMode mode);
+    bool OpenProtocolChannel();
+    static std::unique_ptr<Protocol> CreateProtocol(TransportKind kind);
+    void InitializeProtocol(Protocol& protocol);
+    void RegisterMessageHandlers();
+#if CONFIG_ENABLE_PROTOCOL_FAILOVER
+    bool SwitchProtocol();
+    void ResumeOnStandbyProtocol(ListeningMode mode);
+#endif
+#if CONFIG_PROTOCOL_FAILOVER_SWITCH_NETWORK
+    bool SwitchNetwork(bool allow_restart);
+#endif
+    void StartUplinkCapture(ListeningMode mode);
+    void AudioInputLoop();
+    void AudioOutputLoop();
     void EnterAudioTestingMode();
     void ExitAudioTestingMode();
 };
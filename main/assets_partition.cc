@@ -0,0 +1,69 @@
+#include "assets_partition.h"
+
+#include <esp_log.h>
+#include <esp_mmap_assets.h>
+#include <cstring>
+
+#include "mmap_generate_assets.h"
+
+#define TAG "AssetsPartition"
+
+AssetsPartition::AssetsPartition() {
+    // 不做整体校验，单独更新过的资源分区的校验和与固件中记录的不同
+    const mmap_assets_config_t config = {
+        .partition_label = CONFIG_ASSETS_PARTITION_LABEL,
+        .max_files = MMAP_ASSETS_FILES,
+        .checksum = MMAP_ASSETS_CHECKSUM,
+        .flags = {.mmap_enable = true, .full_check = false},
+    };
+    mmap_assets_handle_t handle = nullptr;
+    esp_err_t err = mmap_assets_new(&config, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to map assets partition %s: %s", CONFIG_ASSETS_PARTITION_LABEL, esp_err_to_name(err));
+        return;
+    }
+    handle_ = handle;
+    file_count_ = mmap_assets_get_total_files(handle);
+    ESP_LOGI(TAG, "Mapped %d assets from partition %s", file_count_, CONFIG_ASSETS_PARTITION_LABEL);
+}
+
+std::string_view AssetsPartition::Find(const char* name) const {
+    if (handle_ == nullptr) {
+        return std::string_view();
+    }
+    auto handle = (mmap_assets_handle_t)handle_;
+    // 文件只有几十个，线性查找即可
+    for (int i = 0; i < file_count_; i++) {
+        if (strcmp(mmap_assets_get_name(handle, i), name) == 0) {
+            return std::string_view((const char*)mmap_assets_get_mem(handle, i), mmap_assets_get_size(handle, i));
+        }
+    }
+    return std::string_view();
+}
+
+std::string_view AssetsPartition::Get(const char* name) {
+    auto data = Find(name);
+    if (data.empty()) {
+        ESP_LOGW(TAG, "Asset %s not found", name);
+    }
+    return data;
+}
+
+const lv_font_t* AssetsPartition::GetFont(const char* name, const lv_font_t* fallback) {
+#if CONFIG_LV_USE_FS_MEMFS
+    auto data = Find(name);
+    if (data.empty()) {
+        return fallback;
+    }
+    // 字形数据由 LVGL 解析到堆上，分区中只保存原始文件
+    auto font = lv_binfont_create_from_buffer((void*)data.data(), data.size());
+    if (font == nullptr) {
+        ESP_LOGW(TAG, "Failed to load font %s", name);
+        return fallback;
+    }
+    ESP_LOGI(TAG, "Loaded font %s from assets partition", name);
+    return font;
+#else
+    return fallback;
+#endif
+}
@@ -0,0 +1,42 @@
+#ifndef ASSETS_PARTITION_H
+#define ASSETS_PARTITION_H
+
+#include <string_view>
+#include <lvgl.h>
+
+// 资源分区：提示音、字体和图片打包到单独的 assets 分区，用 mmap 直接映射，不链接进固件
+// 固件 OTA 包因此变小，资源也可以单独烧录更新（文件数量不变时不需要重新编译固件）
+class AssetsPartition {
+public:
+    static AssetsPartition& GetInstance() {
+        static AssetsPartition instance;
+        return instance;
+    }
+
+    bool available() const { return handle_ != nullptr; }
+    // 按文件名查找，返回映射在 flash 中的内容，找不到时返回空
+    std::string_view Get(const char* name);
+    // 加载 LVGL 二进制字体（lv_font_conv --format bin），不存在时返回 fallback
+    const lv_font_t* GetFont(const char* name, const lv_font_t* fallback);
+
+private:
+    void* handle_ = nullptr;
+    int file_count_ = 0;
+
+    AssetsPartition();
+    std::string_view Find(const char* name) const;
+    ~AssetsPartition() = default;
+    AssetsPartition(const AssetsPartition&) = delete;
+    AssetsPartition& operator=(const AssetsPartition&) = delete;
+};
+
+// 资源分区中的一个文件，用到时才查找，可以像内嵌资源的 std::string_view 一样传递
+struct AssetRef {
+    const char* name;
+
+    operator std::string_view() const {
+        return AssetsPartition::GetInstance().Get(name);
+    }
+};
+
+#endif // ASSETS_PARTITION_H
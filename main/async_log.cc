@@ -0,0 +1,85 @@
+#include "async_log.h"
+#include "task_manifest.h"
+#include "metrics.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/ringbuf.h>
+#include <esp_timer.h>
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+
+#define TAG "AsyncLog"
+
+// 单条日志格式化的最大长度，更长的截断
+#define ASYNC_LOG_LINE_SIZE 256
+
+// 缓冲区满时丢弃的日志条数
+static MetricCounter metric_dropped("log.dropped");
+// 限流宏抑制掉的日志条数
+static MetricCounter metric_suppressed("log.suppressed");
+
+#if CONFIG_ASYNC_LOG_BUFFER_SIZE > 0
+static RingbufHandle_t log_ring = nullptr;
+
+static int AsyncVprintf(const char* format, va_list args) {
+    char line[ASYNC_LOG_LINE_SIZE];
+    int length = vsnprintf(line, sizeof(line), format, args);
+    if (length <= 0) {
+        return length;
+    }
+    length = std::min<int>(length, sizeof(line) - 1);
+    if (xRingbufferSend(log_ring, line, length, 0) != pdTRUE) {
+        metric_dropped.Add();
+    }
+    return length;
+}
+
+static void DrainTask() {
+    while (true) {
+        size_t size = 0;
+        auto item = static_cast<char*>(xRingbufferReceive(log_ring, &size, portMAX_DELAY));
+        if (item == nullptr) {
+            continue;
+        }
+        fwrite(item, 1, size, stdout);
+        vRingbufferReturnItem(log_ring, item);
+    }
+}
+#endif
+
+void AsyncLog::Install() {
+#if CONFIG_ASYNC_LOG_BUFFER_SIZE > 0
+    if (log_ring != nullptr) {
+        return;
+    }
+    log_ring = xRingbufferCreate(CONFIG_ASYNC_LOG_BUFFER_SIZE, RINGBUF_TYPE_NOSPLIT);
+    if (log_ring == nullptr) {
+        ESP_LOGE(TAG, "Failed to create log ring");
+        return;
+    }
+    // 写串口会经过 VFS 和 UART 驱动，栈放在内部 SRAM
+    // 串口输出放在最低的优先级，只在别的任务都空闲时输出
+    if (!TaskManifest::GetInstance().Create(kTaskAsyncLog, []() { DrainTask(); })) {
+        vRingbufferDelete(log_ring);
+        log_ring = nullptr;
+        ESP_LOGE(TAG, "Failed to create log task");
+        return;
+    }
+    esp_log_set_vprintf(AsyncVprintf);
+    ESP_LOGI(TAG, "Async log enabled, %d bytes", CONFIG_ASYNC_LOG_BUFFER_SIZE);
+#endif
+}
+
+bool LogRateLimit::Allow(uint32_t& suppressed) {
+    int64_t now = esp_timer_get_time();
+    // 多个任务同时进入时最多多放行一条，不影响计数
+    if (now < next_us_.load(std::memory_order_relaxed)) {
+        suppressed_.fetch_add(1, std::memory_order_relaxed);
+        metric_suppressed.Add();
+        return false;
+    }
+    next_us_.store(now + interval_us_, std::memory_order_relaxed);
+    suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <esp_log.h>
+
+#include <atomic>
+#include <cstdint>
+
+// 日志异步输出：ESP_LOGx 格式化后放进环形缓冲区，由低优先级任务写到串口
+// 115200 波特率下一行日志要阻塞调用者几毫秒，异步后音频和网络任务只付出一次格式化的开销
+// 缓冲区满时丢弃新的日志并计数；panic 输出不经过这里，复位前还在缓冲区中的日志会丢失
+class AsyncLog {
+public:
+    // 启动时尽早调用一次，之后的 ESP_LOGx 才会异步输出
+    static void Install();
+};
+
+// 每个调用点独立计时，interval_ms 内只放行一次，其余的计入被抑制的次数
+class LogRateLimit {
+public:
+    explicit LogRateLimit(uint32_t interval_ms) : interval_us_(interval_ms * 1000LL) {}
+
+    // 放行时 suppressed 返回上次放行以来被抑制的次数
+    bool Allow(uint32_t& suppressed);
+
+private:
+    int64_t interval_us_;
+    std::atomic<int64_t> next_us_{0};
+    std::atomic<uint32_t> suppressed_{0};
+};
+
+// 热路径上的日志用这些宏，比如每个音频包都可能触发的警告；被抑制的次数附在下一条日志后面
+#define LOG_LEVEL_LIMITED(level, tag, interval_ms, format, ...) do { \
+        if (LOG_LOCAL_LEVEL >= level && esp_log_level_get(tag) >= level) { \
+            static LogRateLimit log_rate_limit(interval_ms); \
+            uint32_t log_suppressed; \
+            if (log_rate_limit.Allow(log_suppressed)) { \
+                if (log_suppressed > 0) { \
+                    ESP_LOG_LEVEL_LOCAL(level, tag, format " (%lu suppressed)", ##__VA_ARGS__, (unsigned long)log_suppressed); \
+                } else { \
+                    ESP_LOG_LEVEL_LOCAL(level, tag, format, ##__VA_ARGS__); \
+                } \
+            } \
+        } \
+    } while (0)
+
+#define LOGE_LIMITED(tag, interval_ms, format, ...) LOG_LEVEL_LIMITED(ESP_LOG_ERROR, tag, interval_ms, format, ##__VA_ARGS__)
+#define LOGW_LIMITED(tag, interval_ms, format, ...) LOG_LEVEL_LIMITED(ESP_LOG_WARN, tag, interval_ms, format, ##__VA_ARGS__)
+#define LOGI_LIMITED(tag, interval_ms, format, ...) LOG_LEVEL_LIMITED(ESP_LOG_INFO, tag, interval_ms, format, ##__VA_ARGS__)
+#define LOGD_LIMITED(tag, interval_ms, format, ...) LOG_LEVEL_LIMITED(ESP_LOG_DEBUG, tag, interval_ms, format, ##__VA_ARGS__)
+
+#endif // ASYNC_LOG_H
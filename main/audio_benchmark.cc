@@ -0,0 +1,291 @@
+#include "audio_benchmark.h"
+#include "application.h"
+#include "audio_resampler.h"
+#include "pcm_kernels.h"
+#include "task_stack.h"
+#include "memory_placement.h"
+
+#if CONFIG_USE_AUDIO_PROCESSOR
+#include <esp_afe_sr_models.h>
+#endif
+
+#include <esp_log.h>
+#include <esp_cpu.h>
+#include <esp_chip_info.h>
+#include <freertos/semphr.h>
+#include <cJSON.h>
+#include <opus_encoder.h>
+#include <opus_decoder.h>
+
+#include <algorithm>
+#include <cmath>
+
+#define TAG "AudioBenchmark"
+
+// Opus 编码需要较大的栈，和唤醒词编码任务一样
+#define AUDIO_BENCHMARK_STACK_SIZE (4096 * 8)
+// 每种采样率合成的输入长度
+#define AUDIO_BENCHMARK_INPUT_MS 3000
+
+static std::mutex benchmark_mutex;
+
+std::string AudioBenchmark::Run() {
+    // 同一时间只跑一个，结果才不互相干扰
+    std::lock_guard<std::mutex> lock(benchmark_mutex);
+    struct Context {
+        AudioBenchmark benchmark;
+        SemaphoreHandle_t done = xSemaphoreCreateBinary();
+    } context;
+    // 周期计数器是每个核独立的，任务固定在一个核上
+    bool created = TaskStack::Create("audio_bench", AUDIO_BENCHMARK_STACK_SIZE, 1, kTaskStackPsram, [&context]() {
+        context.benchmark.Execute();
+        xSemaphoreGive(context.done);
+    }, nullptr, portNUM_PROCESSORS - 1);
+    if (!created) {
+        vSemaphoreDelete(context.done);
+        return "{\"error\":\"failed to create task\"}";
+    }
+    xSemaphoreTake(context.done, portMAX_DELAY);
+    vSemaphoreDelete(context.done);
+    return context.benchmark.GetJson();
+}
+
+void AudioBenchmark::RunInBackground() {
+    TaskStack::Create("audio_bench_boot", 4096, 1, kTaskStackInternal, []() {
+        Run();
+    });
+}
+
+void AudioBenchmark::Execute() {
+    ESP_LOGI(TAG, "Running audio benchmark...");
+    GenerateInput(pcm16k_, 16000);
+    GenerateInput(pcm24k_, 24000);
+    GenerateInput(pcm48k_, 48000);
+
+    BenchmarkOpus();
+    BenchmarkResampler();
+    BenchmarkPcmKernels();
+    BenchmarkAfe();
+    psram_contention_ = MemoryPlacement::MeasureContention();
+    LogTable();
+}
+
+// 150Hz 基音加 8 个衰减的谐波，按 4Hz 调幅模仿音节，再叠加白噪声；用固定种子每次生成相同的数据
+void AudioBenchmark::GenerateInput(std::vector<int16_t>& pcm, int sample_rate) {
+    pcm.resize(sample_rate * AUDIO_BENCHMARK_INPUT_MS / 1000);
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < pcm.size(); i++) {
+        float t = (float)i / sample_rate;
+        float voiced = 0;
+        for (int harmonic = 1; harmonic <= 8; harmonic++) {
+            voiced += sinf(2 * M_PI * 150 * harmonic * t) / harmonic;
+        }
+        float envelope = 0.5f + 0.5f * sinf(2 * M_PI * 4 * t);
+        seed = seed * 1664525 + 1013904223;
+        float noise = ((int32_t)(seed >> 16) - 32768) / 32768.0f;
+        pcm[i] = (int16_t)(6000 * envelope * voiced + 500 * noise);
+    }
+}
+
+template <typename F>
+void AudioBenchmark::Measure(const char* name, int calls, int frame_us, F&& kernel) {
+    Result result;
+    result.name = name;
+    result.frame_us = frame_us;
+    // 预热一次，填充缓存和内部状态
+    kernel(0);
+    for (int i = 0; i < calls; i++) {
+        uint32_t start = esp_cpu_get_cycle_count();
+        kernel(i);
+        uint32_t cycles = esp_cpu_get_cycle_count() - start;
+        result.calls++;
+        result.total_cycles += cycles;
+        result.min_cycles = std::min(result.min_cycles, cycles);
+    }
+    results_.push_back(result);
+}
+
+void AudioBenchmark::BenchmarkOpus() {
+    const int frame_us = OPUS_FRAME_DURATION_MS * 1000;
+    const size_t frame_samples = 16000 * OPUS_FRAME_DURATION_MS / 1000;
+    const int frames = pcm16k_.size() / frame_samples;
+    std::vector<std::vector<uint8_t>> packets;
+
+    // 对话中 AFE 打开时默认用 complexity 5，3 作为降级的参考
+    static const struct {
+        int complexity;
+        const char* name;
+    } encoders[] = {{0, "opus_encode_c0"}, {3, "opus_encode_c3"}, {5, "opus_encode_c5"}};
+    for (auto& config : encoders) {
+        int complexity = config.complexity;
+        OpusEncoderWrapper encoder(16000, 1, OPUS_FRAME_DURATION_MS);
+        encoder.SetComplexity(complexity);
+        Measure(config.name, frames, frame_us, [&](int i) {
+            auto begin = pcm16k_.begin() + (i % frames) * frame_samples;
+            std::vector<int16_t> pcm(begin, begin + frame_samples);
+            encoder.Encode(std::move(pcm), [&](std::vector<uint8_t>&& opus) {
+                if (complexity == 5 && packets.size() < (size_t)frames) {
+                    packets.push_back(std::move(opus));
+                }
+            });
+        });
+    }
+    if (packets.empty()) {
+        ESP_LOGW(TAG, "No opus packets encoded");
+        return;
+    }
+
+    for (int sample_rate : {16000, 24000}) {
+        OpusDecoderWrapper decoder(sample_rate, 1, OPUS_FRAME_DURATION_MS);
+        std::vector<int16_t> pcm;
+        Measure(sample_rate == 16000 ? "opus_decode_16k" : "opus_decode_24k", packets.size(), frame_us, [&](int i) {
+            auto packet = packets[i % packets.size()];
+            decoder.Decode(std::move(packet), pcm);
+        });
+    }
+}
+
+void AudioBenchmark::BenchmarkResampler() {
+    struct Case {
+        const char* name;
+        int input_rate;
+        int output_rate;
+        const std::vector<int16_t>* input;
+    };
+    const Case cases[] = {
+        {"resample_24k_16k", 24000, 16000, &pcm24k_},
+        {"resample_48k_16k", 48000, 16000, &pcm48k_},
+        {"resample_16k_24k", 16000, 24000, &pcm16k_},
+        {"resample_16k_48k", 16000, 48000, &pcm16k_},
+    };
+    for (auto& item : cases) {
+        AudioResampler resampler;
+        resampler.Configure(item.input_rate, item.output_rate);
+        int frame_samples = item.input_rate * OPUS_FRAME_DURATION_MS / 1000;
+        int frames = item.input->size() / frame_samples;
+        std::vector<int16_t> output(resampler.GetOutputSamples(frame_samples));
+        Measure(item.name, frames, OPUS_FRAME_DURATION_MS * 1000, [&](int i) {
+            resampler.Process(item.input->data() + (i % frames) * frame_samples, frame_samples, output.data());
+        });
+    }
+}
+
+// 一帧 I2S 数据的格式转换，和 codec 读写路径上的调用方式相同
+void AudioBenchmark::BenchmarkPcmKernels() {
+    const int frame_us = OPUS_FRAME_DURATION_MS * 1000;
+    const size_t samples = 16000 * OPUS_FRAME_DURATION_MS / 1000;
+    std::vector<int32_t> wide(samples * 2);
+    std::vector<int16_t> narrow(samples * 2);
+    std::vector<int16_t> left(samples);
+    std::vector<int16_t> right(samples);
+    int32_t gain = pcm::VolumeToGain(70);
+    const int calls = 50;
+
+    Measure("pcm_int16_to_int32", calls, frame_us, [&](int) {
+        pcm::Int16ToInt32(pcm16k_.data(), wide.data(), samples, gain);
+    });
+    Measure("pcm_int32_to_int16", calls, frame_us, [&](int) {
+        pcm::Int32ToInt16(wide.data(), narrow.data(), samples, 16);
+    });
+    Measure("pcm_apply_gain", calls, frame_us, [&](int) {
+        pcm::ApplyGain(narrow.data(), samples, gain);
+    });
+    Measure("pcm_deinterleave", calls, frame_us, [&](int) {
+        pcm::Deinterleave(pcm16k_.data(), left.data(), right.data(), samples);
+    });
+    Measure("pcm_interleave", calls, frame_us, [&](int) {
+        pcm::Interleave(left.data(), right.data(), narrow.data(), samples);
+    });
+    Measure("pcm_analyze_level", calls, frame_us, [&](int) {
+        pcm::LevelStats stats;
+        pcm::AnalyzeLevel(pcm16k_.data(), samples, 1, stats);
+    });
+}
+
+// 单麦克风、只开 VAD 的 AFE，和没有设备 AEC 时的配置相同，不加载 NS 模型
+void AudioBenchmark::BenchmarkAfe() {
+#if CONFIG_USE_AUDIO_PROCESSOR
+    afe_config_t* afe_config = afe_config_init("M", NULL, AFE_TYPE_VC, AFE_MODE_HIGH_PERF);
+    afe_config->aec_init = false;
+    afe_config->ns_init = false;
+    afe_config->vad_init = true;
+    afe_config->agc_init = false;
+    afe_config->memory_alloc_mode = AFE_MEMORY_ALLOC_MORE_PSRAM;
+    auto afe_iface = esp_afe_handle_from_config(afe_config);
+    auto afe_data = afe_iface->create_from_config(afe_config);
+    afe_config_free(afe_config);
+    if (afe_data == nullptr) {
+        ESP_LOGW(TAG, "Failed to create AFE");
+        return;
+    }
+    int chunk = afe_iface->get_feed_chunksize(afe_data);
+    int chunks = pcm16k_.size() / chunk;
+    int timeouts = 0;
+    // fetch 在调用者的任务中完成处理，一次 feed 对应一次 fetch
+    Measure("afe_feed_fetch", chunks, chunk * 1000000LL / 16000, [&](int i) {
+        afe_iface->feed(afe_data, pcm16k_.data() + (i % chunks) * chunk);
+        auto result = afe_iface->fetch_with_delay(afe_data, pdMS_TO_TICKS(100));
+        if (result == nullptr || result->ret_value == ESP_FAIL) {
+            timeouts++;
+        }
+    });
+    if (timeouts > 0) {
+        ESP_LOGW(TAG, "AFE fetch timed out %d times, afe_feed_fetch includes the waiting time", timeouts);
+    }
+    afe_iface->destroy(afe_data);
+#endif
+}
+
+void AudioBenchmark::LogTable() const {
+    esp_chip_info_t chip_info;
+    esp_chip_info(&chip_info);
+    ESP_LOGI(TAG, "Chip %s rev %d.%d, %d cores, %d MHz, opus %s", CONFIG_IDF_TARGET, chip_info.revision / 100,
+        chip_info.revision % 100, chip_info.cores, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ, OPUS_BUILD_INFO);
+    ESP_LOGI(TAG, "%-20s %6s %12s %12s %9s %7s", "kernel", "calls", "avg cycles", "min cycles", "avg us", "load");
+    for (auto& result : results_) {
+        uint32_t average = result.calls > 0 ? result.total_cycles / result.calls : 0;
+        uint32_t average_us = average / CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+        if (result.frame_us > 0) {
+            // 百分比保留两位小数
+            unsigned long load = (uint64_t)average_us * 10000 / result.frame_us;
+            ESP_LOGI(TAG, "%-20s %6d %12lu %12lu %9lu %3lu.%02lu%%", result.name, result.calls, (unsigned long)average,
+                (unsigned long)result.min_cycles, (unsigned long)average_us, load / 100, load % 100);
+        } else {
+            ESP_LOGI(TAG, "%-20s %6d %12lu %12lu %9lu %7s", result.name, result.calls, (unsigned long)average,
+                (unsigned long)result.min_cycles, (unsigned long)average_us, "-");
+        }
+    }
+    if (psram_contention_ >= 0) {
+        ESP_LOGI(TAG, "PSRAM read slowdown under contention from the other core: %d%%", psram_contention_);
+    }
+}
+
+std::string AudioBenchmark::GetJson() const {
+    esp_chip_info_t chip_info;
+    esp_chip_info(&chip_info);
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "chip", CONFIG_IDF_TARGET);
+    cJSON_AddNumberToObject(root, "revision", chip_info.revision);
+    cJSON_AddNumberToObject(root, "cores", chip_info.cores);
+    cJSON_AddNumberToObject(root, "cpu_mhz", CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+    cJSON_AddStringToObject(root, "opus", OPUS_BUILD_INFO);
+    if (psram_contention_ >= 0) {
+        cJSON_AddNumberToObject(root, "psram_contention_pct", psram_contention_);
+    }
+    cJSON* kernels = cJSON_AddArrayToObject(root, "kernels");
+    for (auto& result : results_) {
+        uint32_t average = result.calls > 0 ? result.total_cycles / result.calls : 0;
+        cJSON* item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "name", result.name);
+        cJSON_AddNumberToObject(item, "calls", result.calls);
+        cJSON_AddNumberToObject(item, "avg_cycles", average);
+        cJSON_AddNumberToObject(item, "min_cycles", result.min_cycles);
+        cJSON_AddNumberToObject(item, "frame_us", result.frame_us);
+        cJSON_AddItemToArray(kernels, item);
+    }
+    char* json = cJSON_PrintUnformatted(root);
+    std::string result(json);
+    cJSON_free(json);
+    cJSON_Delete(root);
+    return result;
+}
@@ -0,0 +1,50 @@
+#ifndef AUDIO_BENCHMARK_H
+#define AUDIO_BENCHMARK_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 音频热路径的微基准测试
+// 用合成的语音样数据（多个谐波加噪声，每次相同）在单独的任务里依次运行 Opus 编解码、重采样、
+// PCM 格式转换和 AFE，按 CPU 周期计数统计每次调用的平均和最小开销，打印一张按芯片区分的表
+// load 是平均耗时占一帧实时长度的百分比，超过 100% 说明这个核跑不过实时
+// 最后测量 PSRAM 争用，和启动时 MemoryPlacement 用的是同一个测试
+class AudioBenchmark {
+public:
+    // 阻塞直到测试完成，返回 JSON 结果
+    static std::string Run();
+    // 启动时调用，在后台运行并只打印结果
+    static void RunInBackground();
+
+private:
+    struct Result {
+        const char* name;
+        int calls = 0;
+        uint64_t total_cycles = 0;
+        uint32_t min_cycles = UINT32_MAX;
+        int frame_us = 0;       // 一次调用处理的音频时长，0 表示不计算 load
+    };
+
+    std::vector<Result> results_;
+    std::vector<int16_t> pcm16k_;
+    std::vector<int16_t> pcm24k_;
+    std::vector<int16_t> pcm48k_;
+    // 另一个核搬运 PSRAM 时读 PSRAM 变慢的百分比，-1 表示没有测量
+    int psram_contention_ = -1;
+
+    void Execute();
+    void GenerateInput(std::vector<int16_t>& pcm, int sample_rate);
+    template <typename F>
+    void Measure(const char* name, int calls, int frame_us, F&& kernel);
+
+    void BenchmarkOpus();
+    void BenchmarkResampler();
+    void BenchmarkPcmKernels();
+    void BenchmarkAfe();
+
+    void LogTable() const;
+    std::string GetJson() const;
+};
+
+#endif // AUDIO_BENCHMARK_H
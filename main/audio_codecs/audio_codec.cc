@@ -3,22 +3,86 @@
 #include "settings.h"
 
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_attr.h>
 #include <cstring>
+#include <algorithm>
 #include <driver/i2s_common.h>
 
 #define TAG "AudioCodec"
 
+// 超过这个时间没有读写，DMA 队列溢出是空闲造成的，不计数
+#define AUDIO_CODEC_ACTIVE_WINDOW_MS 200
+// 每个调节周期内采集溢出达到这个次数就增加描述符
+#define AUDIO_CODEC_OVERRUN_THRESHOLD 3
+// 连续这么多个周期没有溢出就减少一个描述符，不低于默认值
+#define AUDIO_CODEC_CLEAN_WINDOWS 60
+// 清空播放时的渐弱时长，避免从当前幅度直接跳到 0 产生咔哒声
+#define AUDIO_CODEC_FLUSH_FADE_MS 4
+
 AudioCodec::AudioCodec() {
+#if CONFIG_AUDIO_CODEC_DMA_AUTOTUNE
+    Settings settings("audio", false);
+    saved_desc_num_ = settings.GetInt("dma_desc_num", AUDIO_CODEC_DMA_DESC_NUM);
+    saved_desc_num_ = std::min(std::max(saved_desc_num_, AUDIO_CODEC_DMA_DESC_MIN), AUDIO_CODEC_DMA_DESC_MAX);
+    dma_desc_num_ = saved_desc_num_;
+#endif
 }
 
 AudioCodec::~AudioCodec() {
 }
 
 void AudioCodec::OutputData(std::vector<int16_t>& data) {
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    last_output_ms_ = esp_timer_get_time() / 1000;
+    output_dsp_.Process(data.data(), data.size(), output_channels_, software_volume_ ? output_volume_ : -1);
     Write(data.data(), data.size());
+    int channels = std::min(output_channels_, 2);
+    if ((int)data.size() >= channels) {
+        std::copy(data.end() - channels, data.end(), last_output_);
+    }
+}
+
+size_t AudioCodec::PreloadOutput(const int16_t* data, size_t samples) {
+    size_t loaded = 0;
+    i2s_channel_preload_data(tx_handle_, data, samples * sizeof(int16_t), &loaded);
+    return loaded / sizeof(int16_t);
+}
+
+void AudioCodec::FlushOutput() {
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    if (tx_handle_ == nullptr || !output_enabled_) {
+        return;
+    }
+    if (i2s_channel_disable(tx_handle_) != ESP_OK) {
+        return;
+    }
+    int channels = std::min(output_channels_, 2);
+    int fade_frames = std::max(1, output_sample_rate_ * AUDIO_CODEC_FLUSH_FADE_MS / 1000);
+    std::vector<int16_t> buffer(AUDIO_CODEC_DMA_FRAME_NUM * channels, 0);
+    int frame = 0;
+    // 重复预载直到 DMA 缓冲区全部被覆盖，之后的部分都是静音
+    while (true) {
+        std::fill(buffer.begin(), buffer.end(), 0);
+        for (size_t i = 0; i < buffer.size() / channels && frame + (int)i < fade_frames; i++) {
+            int gain = fade_frames - frame - i;
+            for (int c = 0; c < channels; c++) {
+                buffer[i * channels + c] = last_output_[c] * gain / fade_frames;
+            }
+        }
+        size_t loaded = PreloadOutput(buffer.data(), buffer.size());
+        frame += loaded / channels;
+        if (loaded < buffer.size()) {
+            break;
+        }
+    }
+    std::fill(std::begin(last_output_), std::end(last_output_), 0);
+    ESP_ERROR_CHECK_WITHOUT_ABORT(i2s_channel_enable(tx_handle_));
 }
 
 bool AudioCodec::InputData(std::vector<int16_t>& data) {
+    last_input_ms_ = esp_timer_get_time() / 1000;
+    std::lock_guard<std::mutex> lock(input_mutex_);
     int samples = Read(data.data(), data.size());
     if (samples > 0) {
         return true;
@@ -34,6 +98,9 @@ void AudioCodec::Start() {
         output_volume_ = 10;
     }
 
+    output_dsp_.SetProfile(output_dsp_profile_, output_sample_rate_);
+
+    RegisterDmaCallbacks();
     ESP_ERROR_CHECK(i2s_channel_enable(tx_handle_));
     ESP_ERROR_CHECK(i2s_channel_enable(rx_handle_));
 
@@ -63,5 +130,150 @@ void AudioCodec::EnableOutput(bool enable) {
         return;
     }
     output_enabled_ = enable;
+    if (enable) {
+        output_enabled_us_ = esp_timer_get_time();
+    }
     ESP_LOGI(TAG, "Set output enable to %s", enable ? "true" : "false");
 }
+
+std::string AudioCodec::GetInputFormat() const {
+    if (input_format_ != nullptr) {
+        return input_format_;
+    }
+    int ref_num = input_reference_ ? 1 : 0;
+    std::string format(input_channels_ - ref_num, 'M');
+    format.append(ref_num, 'R');
+    return format;
+}
+
+void AudioCodec::SetIdleListening(bool idle) {
+#if CONFIG_AUDIO_CODEC_IDLE_SAMPLE_RATE
+    std::lock_guard<std::mutex> lock(input_mutex_);
+    idle_listening_ = idle;
+    SwitchSampleRate();
+#endif
+}
+
+void AudioCodec::UpdateSampleRate(bool output_on) {
+#if CONFIG_AUDIO_CODEC_IDLE_SAMPLE_RATE
+    std::lock_guard<std::mutex> lock(input_mutex_);
+    output_on_ = output_on;
+    SwitchSampleRate();
+#endif
+}
+
+// 输出一直是构造时的采样率，只有输出关闭的待机期间采集降到 16kHz，切换时听不到声音
+void AudioCodec::SwitchSampleRate() {
+    if (!idle_rate_supported_) {
+        return;
+    }
+    int sample_rate = idle_listening_ && !output_on_ ? AUDIO_CODEC_IDLE_SAMPLE_RATE : output_sample_rate_;
+    if (sample_rate == input_sample_rate_) {
+        return;
+    }
+    int64_t start = esp_timer_get_time();
+    input_sample_rate_ = sample_rate;
+    ApplyInputSampleRate();
+    ESP_LOGI(TAG, "Input sample rate %d Hz, switched in %lld us", sample_rate, esp_timer_get_time() - start);
+}
+
+void AudioCodec::SetOutputDspProfile(const OutputDspProfile& profile) {
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    output_dsp_profile_ = profile;
+    output_dsp_.SetProfile(profile, output_sample_rate_);
+    ESP_LOGI(TAG, "Output DSP: gain %d dB, limiter %d dBFS, bass shelf %d Hz %d dB", profile.gain_db,
+        profile.limiter_dbfs, profile.bass_shelf_hz, profile.bass_shelf_db);
+}
+
+void AudioCodec::SetOutputPowerPolicy(int idle_off_ms, int warmup_ms) {
+    output_idle_off_ms_ = idle_off_ms;
+    output_warmup_ms_ = warmup_ms;
+}
+
+int AudioCodec::output_warmup_remaining_ms() const {
+    if (!output_enabled_) {
+        return 0;
+    }
+    int elapsed_ms = (esp_timer_get_time() - output_enabled_us_) / 1000;
+    return elapsed_ms < output_warmup_ms_ ? output_warmup_ms_ - elapsed_ms : 0;
+}
+
+bool IRAM_ATTR AudioCodec::OnRecvQueueOverflow(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx) {
+    auto codec = static_cast<AudioCodec*>(user_ctx);
+    if (uint32_t(esp_timer_get_time() / 1000) - codec->last_input_ms_ < AUDIO_CODEC_ACTIVE_WINDOW_MS) {
+        codec->input_overruns_++;
+    }
+    return false;
+}
+
+bool IRAM_ATTR AudioCodec::OnSendQueueOverflow(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx) {
+    auto codec = static_cast<AudioCodec*>(user_ctx);
+    if (uint32_t(esp_timer_get_time() / 1000) - codec->last_output_ms_ < AUDIO_CODEC_ACTIVE_WINDOW_MS) {
+        codec->output_underruns_++;
+    }
+    // 发送队列溢出说明 DMA 已经没有新数据，写入的音频都播完了
+    EventGroupHandle_t group = codec->drain_group_.exchange(nullptr);
+    if (group != nullptr) {
+        BaseType_t woken = pdFALSE;
+        xEventGroupSetBitsFromISR(group, codec->drain_bits_, &woken);
+        return woken == pdTRUE;
+    }
+    return false;
+}
+
+void AudioCodec::NotifyOutputDrained(EventGroupHandle_t group, EventBits_t bits) {
+    drain_bits_ = bits;
+    drain_group_ = group;
+}
+
+int AudioCodec::output_drain_ms() const {
+    if (output_sample_rate_ <= 0) {
+        return 0;
+    }
+    return dma_desc_num_ * AUDIO_CODEC_DMA_FRAME_NUM * 1000 / output_sample_rate_;
+}
+
+void AudioCodec::RegisterDmaCallbacks() {
+    i2s_event_callbacks_t callbacks = {};
+    if (rx_handle_ != nullptr) {
+        callbacks.on_recv_q_ovf = OnRecvQueueOverflow;
+        ESP_ERROR_CHECK_WITHOUT_ABORT(i2s_channel_register_event_callback(rx_handle_, &callbacks, this));
+    }
+    if (tx_handle_ != nullptr) {
+        callbacks = {};
+        callbacks.on_send_q_ovf = OnSendQueueOverflow;
+        ESP_ERROR_CHECK_WITHOUT_ABORT(i2s_channel_register_event_callback(tx_handle_, &callbacks, this));
+    }
+}
+
+void AudioCodec::TuneDmaBuffers() {
+    uint32_t overruns = input_overruns_;
+    uint32_t delta = overruns - tuned_overruns_;
+    tuned_overruns_ = overruns;
+    if (delta > 0) {
+        ESP_LOGW(TAG, "I2S capture overruns: %lu (total %lu), playback underruns: %lu, DMA descriptors: %d",
+            delta, overruns, output_underruns_.load(), dma_desc_num_);
+    }
+
+#if CONFIG_AUDIO_CODEC_DMA_AUTOTUNE
+    int desc_num = saved_desc_num_;
+    if (delta >= AUDIO_CODEC_OVERRUN_THRESHOLD) {
+        clean_windows_ = 0;
+        // 每次启动只加一次，避免在新值生效前一直往上加
+        if (saved_desc_num_ <= dma_desc_num_) {
+            desc_num = std::min(dma_desc_num_ + 2, AUDIO_CODEC_DMA_DESC_MAX);
+        }
+    } else if (delta == 0 && ++clean_windows_ >= AUDIO_CODEC_CLEAN_WINDOWS) {
+        clean_windows_ = 0;
+        if (saved_desc_num_ >= dma_desc_num_) {
+            desc_num = std::max(dma_desc_num_ - 1, AUDIO_CODEC_DMA_DESC_NUM);
+        }
+    }
+    if (desc_num != saved_desc_num_) {
+        ESP_LOGI(TAG, "DMA descriptor number %d -> %d, takes effect after restart", dma_desc_num_, desc_num);
+        saved_desc_num_ = desc_num;
+        Settings settings("audio", true);
+        settings.SetInt("dma_desc_num", desc_num);
+    }
+#endif
+}
@@ -7,13 +7,21 @@
 
 #include <vector>
 #include <string>
+#include <atomic>
+#include <mutex>
 #include <functional>
 
 #include "board.h"
+#include "output_dsp.h"
 
-#define AUDIO_CODEC_DMA_DESC_NUM 6
-#define AUDIO_CODEC_DMA_FRAME_NUM 240
+// DMA 描述符越多抗欠载能力越强，但播放延迟也越大
+#define AUDIO_CODEC_DMA_DESC_NUM CONFIG_AUDIO_CODEC_DMA_DESC_NUM
+#define AUDIO_CODEC_DMA_FRAME_NUM CONFIG_AUDIO_CODEC_DMA_FRAME_NUM
+#define AUDIO_CODEC_DMA_DESC_MIN 2
+#define AUDIO_CODEC_DMA_DESC_MAX 16
 #define AUDIO_CODEC_DEFAULT_MIC_GAIN 30.0
+// 唤醒词模型的采样率
+#define AUDIO_CODEC_IDLE_SAMPLE_RATE 16000
 
 class AudioCodec {
 public:
@@ -33,10 +41,42 @@ public:
     inline int input_sample_rate() const { return input_sample_rate_; }
     inline int output_sample_rate() const { return output_sample_rate_; }
     inline int input_channels() const { return input_channels_; }
+    // AFE 的输入格式，每个字符对应一个交错的输入通道，M 为麦克风、R 为回采、N 为不使用
+    std::string GetInputFormat() const;
     inline int output_channels() const { return output_channels_; }
     inline int output_volume() const { return output_volume_; }
     inline bool input_enabled() const { return input_enabled_; }
     inline bool output_enabled() const { return output_enabled_; }
+    inline int output_idle_off_ms() const { return output_idle_off_ms_; }
+    inline int output_warmup_ms() const { return output_warmup_ms_; }
+    inline int dma_desc_num() const { return dma_desc_num_; }
+    // 读写进行中 DMA 队列溢出的次数，采集侧溢出意味着丢帧
+    inline uint32_t input_overruns() const { return input_overruns_; }
+    inline uint32_t output_underruns() const { return output_underruns_; }
+
+    // 待机静音多久后关闭输出，以及重新打开输出后 codec 和功放稳定所需的时间，由板子按实测的功耗和启动延迟设置
+    void SetOutputPowerPolicy(int idle_off_ms, int warmup_ms);
+    // 待机只检测唤醒词时调用。支持的 codec 在输出关闭期间把 I2S 和 codec 降到 AUDIO_CODEC_IDLE_SAMPLE_RATE，
+    // 采集不用重采样，时钟也更低；打开输出之前恢复构造时的采样率，input_sample_rate() 随之变化
+    void SetIdleListening(bool idle);
+
+    // 板子按扬声器设置输出处理（固定增益、低频衰减、限幅阈值），构造 codec 之后调用
+    void SetOutputDspProfile(const OutputDspProfile& profile);
+
+    // 最近一次打开输出后还没有稳定的剩余时间，输出关闭或已经稳定时为 0
+    int output_warmup_remaining_ms() const;
+
+    // 定期调用，根据采集溢出次数调整 DMA 描述符数量，新的值保存到 NVS，下次启动生效
+    void TuneDmaBuffers();
+
+    // 播放 DMA 下一次没有数据可发（已写入的音频全部播完）时，在中断里给 group 置 bits，只触发一次
+    // 没有注册 DMA 回调的 codec 或输出已停止时不会触发，调用方需要自己设超时
+    void NotifyOutputDrained(EventGroupHandle_t group, EventBits_t bits);
+    // 按当前 DMA 配置估算播完已写入数据所需的时间
+    int output_drain_ms() const;
+    // 丢弃播放 DMA 中还没播出的音频：停止发送通道，用从最后一个采样渐弱到 0 的短斜坡和静音填满 DMA 后重新启动
+    // 正在进行的 OutputData 写完当前帧后才会执行，最多等一帧
+    void FlushOutput();
 
 protected:
     i2s_chan_handle_t tx_handle_ = nullptr;
@@ -49,11 +89,60 @@ protected:
     int input_sample_rate_ = 0;
     int output_sample_rate_ = 0;
     int input_channels_ = 1;
+    // 通道顺序不是“麦克风在前、回采在后”的 codec 设置，nullptr 时按 input_channels_ 和 input_reference_ 生成
+    const char* input_format_ = nullptr;
     int output_channels_ = 1;
     int output_volume_ = 70;
+    // 没有硬件音量的 codec 置为 true，音量由输出处理在 Write 之前调节
+    bool software_volume_ = false;
+    // 控制接口所在的 I2C 总线，派生类修改寄存器时按音频优先级占用（I2cBusLock），没有 I2C 控制时为 nullptr
+    void* control_bus_ = nullptr;
+    int output_idle_off_ms_ = CONFIG_AUDIO_OUTPUT_IDLE_OFF_MS;
+    int output_warmup_ms_ = CONFIG_AUDIO_OUTPUT_WARMUP_MS;
+    int64_t output_enabled_us_ = 0;
+    // 派生类创建 I2S 通道时使用，启动时从 NVS 读取自动调节后的值
+    int dma_desc_num_ = AUDIO_CODEC_DMA_DESC_NUM;
+
+    std::atomic<uint32_t> input_overruns_{0};
+    std::atomic<uint32_t> output_underruns_{0};
+    std::atomic<EventGroupHandle_t> drain_group_{nullptr};
+    EventBits_t drain_bits_ = 0;
+    // 毫秒，32 位原子变量才能在中断里安全读取
+    std::atomic<uint32_t> last_input_ms_{0};
+    std::atomic<uint32_t> last_output_ms_{0};
+
+    // 支持运行时切换采样率的 codec 在构造函数中置为 true，输入输出须共用同一个采样率
+    bool idle_rate_supported_ = false;
+    // 派生类在打开输出之前以 true、关闭输出之后以 false 调用，按待机状态决定采集的采样率
+    void UpdateSampleRate(bool output_on);
+    // 输出关闭时按新的 input_sample_rate_ 重新打开采集，I2S 时钟由 esp_codec_dev_open 重新配置；调用时没有并发的 Read
+    virtual void ApplyInputSampleRate() {}
+
+    // 在通道使能之前注册 DMA 队列溢出回调
+    void RegisterDmaCallbacks();
+    // FlushOutput 在发送通道停止时调用，把 int16 采样按通道的数据格式预载到 DMA，返回实际载入的采样数
+    virtual size_t PreloadOutput(const int16_t* data, size_t samples);
 
     virtual int Read(int16_t* dest, int samples) = 0;
     virtual int Write(const int16_t* data, int samples) = 0;
+
+private:
+    // OutputData 和 FlushOutput 互斥，通道停止期间不能写入
+    std::mutex output_mutex_;
+    // InputData 和采样率切换互斥
+    std::mutex input_mutex_;
+    bool idle_listening_ = false;
+    bool output_on_ = false;
+    int16_t last_output_[2] = {};
+    OutputDspProfile output_dsp_profile_;
+    OutputDsp output_dsp_;
+    uint32_t tuned_overruns_ = 0;
+    int clean_windows_ = 0;
+    int saved_desc_num_ = AUDIO_CODEC_DMA_DESC_NUM;
+
+    void SwitchSampleRate();
+    static bool OnRecvQueueOverflow(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx);
+    static bool OnSendQueueOverflow(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx);
 };
 
 #endif // _AUDIO_CODEC_H
@@ -0,0 +1,141 @@
+#include "audio_resampler.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <cmath>
+
+#define TAG "AudioResampler"
+
+static inline int16_t SaturateInt16(int32_t value) {
+    return (int16_t)std::min<int32_t>(std::max<int32_t>(value, INT16_MIN), INT16_MAX);
+}
+
+bool AudioResampler::IsIntegerRatio(int input_sample_rate, int output_sample_rate) {
+    if (input_sample_rate <= 0 || output_sample_rate <= 0 || input_sample_rate == output_sample_rate) {
+        return false;
+    }
+    int high = std::max(input_sample_rate, output_sample_rate);
+    int low = std::min(input_sample_rate, output_sample_rate);
+    return high % low == 0 && high / low <= AUDIO_RESAMPLER_MAX_FACTOR;
+}
+
+void AudioResampler::Configure(int input_sample_rate, int output_sample_rate) {
+    input_sample_rate_ = input_sample_rate;
+    output_sample_rate_ = output_sample_rate;
+    up_factor_ = 1;
+    down_factor_ = 1;
+    coefficients_.clear();
+    work_.clear();
+
+    if (!IsIntegerRatio(input_sample_rate, output_sample_rate)) {
+        fallback_.Configure(input_sample_rate, output_sample_rate);
+        return;
+    }
+
+    int factor;
+    if (output_sample_rate > input_sample_rate) {
+        factor = up_factor_ = output_sample_rate / input_sample_rate;
+    } else {
+        factor = down_factor_ = input_sample_rate / output_sample_rate;
+    }
+    DesignFilter(factor);
+    ESP_LOGI(TAG, "Polyphase resampler %d -> %d, %d taps", input_sample_rate, output_sample_rate, (int)coefficients_.size());
+}
+
+void AudioResampler::Reset() {
+    if (!is_integer_ratio()) {
+        fallback_.Configure(input_sample_rate_, output_sample_rate_);
+        return;
+    }
+    work_.assign(history_, 0);
+    next_position_ = history_;
+}
+
+void AudioResampler::DesignFilter(int factor) {
+    // Blackman 窗的 sinc 低通，截止频率略低于低采样率的奈奎斯特频率
+    int length = factor * AUDIO_RESAMPLER_TAPS_PER_PHASE;
+    double cutoff = 0.45 / factor;
+    double center = (length - 1) / 2.0;
+    std::vector<double> h(length);
+    double sum = 0;
+    for (int i = 0; i < length; i++) {
+        double x = i - center;
+        double sinc = x == 0 ? 2 * cutoff : sin(2 * M_PI * cutoff * x) / (M_PI * x);
+        double window = 0.42 - 0.5 * cos(2 * M_PI * i / (length - 1)) + 0.08 * cos(4 * M_PI * i / (length - 1));
+        h[i] = sinc * window;
+        sum += h[i];
+    }
+
+    coefficients_.resize(length);
+    if (up_factor_ > 1) {
+        // 每个相位的增益为 1，插入的零值样本由 factor 倍增益补偿
+        taps_ = AUDIO_RESAMPLER_TAPS_PER_PHASE;
+        for (int phase = 0; phase < factor; phase++) {
+            for (int k = 0; k < taps_; k++) {
+                double value = h[k * factor + phase] / sum * factor;
+                coefficients_[phase * taps_ + k] = SaturateInt16(lround(value * 32768));
+            }
+        }
+    } else {
+        taps_ = length;
+        for (int i = 0; i < length; i++) {
+            coefficients_[i] = SaturateInt16(lround(h[i] / sum * 32768));
+        }
+    }
+    history_ = taps_ - 1;
+    work_.assign(history_, 0);
+    next_position_ = history_;
+}
+
+int AudioResampler::GetOutputSamples(int input_samples) const {
+    if (up_factor_ > 1) {
+        return input_samples * up_factor_;
+    }
+    if (down_factor_ > 1) {
+        return input_samples / down_factor_;
+    }
+    return fallback_.GetOutputSamples(input_samples);
+}
+
+void AudioResampler::Process(const int16_t* input, int input_samples, int16_t* output) {
+    if (!is_integer_ratio()) {
+        fallback_.Process(input, input_samples, output);
+        return;
+    }
+
+    // work_ 中前 history_ 个样本是上一次的尾部，容量稳定后不再分配
+    work_.resize(history_ + input_samples);
+    std::copy(input, input + input_samples, work_.begin() + history_);
+    const int16_t* coefficients = coefficients_.data();
+
+    if (up_factor_ > 1) {
+        for (int n = 0; n < input_samples; n++) {
+            const int16_t* x = work_.data() + n + history_;
+            for (int phase = 0; phase < up_factor_; phase++) {
+                const int16_t* c = coefficients + phase * taps_;
+                int32_t acc = 0;
+                for (int k = 0; k < taps_; k++) {
+                    acc += c[k] * x[-k];
+                }
+                *output++ = SaturateInt16(acc >> 15);
+            }
+        }
+    } else {
+        int max_output = input_samples / down_factor_;
+        size_t total = work_.size();
+        size_t position = next_position_;
+        for (int produced = 0; position < total && produced < max_output; produced++) {
+            const int16_t* x = work_.data() + position;
+            int32_t acc = 0;
+            for (int k = 0; k < taps_; k++) {
+                acc += coefficients[k] * x[-k];
+            }
+            *output++ = SaturateInt16(acc >> 15);
+            position += down_factor_;
+        }
+        next_position_ = position - input_samples;
+    }
+
+    std::copy(work_.end() - history_, work_.end(), work_.begin());
+    work_.resize(history_);
+}
@@ -0,0 +1,49 @@
+#ifndef AUDIO_RESAMPLER_H
+#define AUDIO_RESAMPLER_H
+
+#include <opus_resampler.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// 整数倍重采样的最大倍数和每个相位的滤波器阶数
+#define AUDIO_RESAMPLER_MAX_FACTOR 6
+#define AUDIO_RESAMPLER_TAPS_PER_PHASE 8
+
+// 与 OpusResampler 接口一致的重采样器
+// 采样率是整数倍关系时（例如 16k -> 48k、48k -> 16k）使用定点多相 FIR，开销远小于通用重采样
+// 其它情况退回 OpusResampler
+class AudioResampler {
+public:
+    void Configure(int input_sample_rate, int output_sample_rate);
+    void Process(const int16_t* input, int input_samples, int16_t* output);
+    int GetOutputSamples(int input_samples) const;
+    // 清空滤波器历史，保留已经设计好的系数
+    void Reset();
+
+    int input_sample_rate() const { return input_sample_rate_; }
+    int output_sample_rate() const { return output_sample_rate_; }
+    bool is_integer_ratio() const { return up_factor_ > 1 || down_factor_ > 1; }
+
+    // 两个采样率之间能否用整数倍重采样
+    static bool IsIntegerRatio(int input_sample_rate, int output_sample_rate);
+
+private:
+    int input_sample_rate_ = 0;
+    int output_sample_rate_ = 0;
+    int up_factor_ = 1;
+    int down_factor_ = 1;
+    OpusResampler fallback_;
+
+    // 上采样时按相位排列 coefficients_[phase * taps + k]，下采样时为一组完整的滤波器
+    std::vector<int16_t> coefficients_;
+    int taps_ = 0;
+    std::vector<int16_t> work_;
+    size_t history_ = 0;
+    size_t next_position_ = 0;
+
+    void DesignFilter(int factor);
+};
+
+#endif // AUDIO_RESAMPLER_H
@@ -1,4 +1,5 @@
 #include "box_audio_codec.h"
+#include "i2c_bus.h"
 
 #include <esp_log.h>
 #include <driver/i2c_master.h>
@@ -8,12 +9,19 @@
 
 BoxAudioCodec::BoxAudioCodec(void* i2c_master_handle, int input_sample_rate, int output_sample_rate,
     gpio_num_t mclk, gpio_num_t bclk, gpio_num_t ws, gpio_num_t dout, gpio_num_t din,
-    gpio_num_t pa_pin, uint8_t es8311_addr, uint8_t es7210_addr, bool input_reference) {
+    gpio_num_t pa_pin, uint8_t es8311_addr, uint8_t es7210_addr, bool input_reference, int input_mics) {
     duplex_ = true; // 是否双工
+    control_bus_ = i2c_master_handle;
     input_reference_ = input_reference; // 是否使用参考输入，实现回声消除
-    input_channels_ = input_reference_ ? 2 : 1; // 输入通道数
+    input_mics_ = input_mics;
+    input_channels_ = input_mics_ + (input_reference_ ? 1 : 0); // 输入通道数
+    if (input_mics_ > 1) {
+        // ES7210 的 TDM 第 0、2 路是麦克风，第 1 路是回采，读出后保持这个顺序
+        input_format_ = input_reference_ ? "MRM" : "MM";
+    }
     input_sample_rate_ = input_sample_rate;
     output_sample_rate_ = output_sample_rate;
+    idle_rate_supported_ = true;
 
     CreateDuplexChannels(mclk, bclk, ws, dout, din);
 
@@ -96,7 +104,7 @@ void BoxAudioCodec::CreateDuplexChannels(gpio_num_t mclk, gpio_num_t bclk, gpio_
     i2s_chan_config_t chan_cfg = {
         .id = I2S_NUM_0,
         .role = I2S_ROLE_MASTER,
-        .dma_desc_num = AUDIO_CODEC_DMA_DESC_NUM,
+        .dma_desc_num = (uint32_t)dma_desc_num_,
         .dma_frame_num = AUDIO_CODEC_DMA_FRAME_NUM,
         .auto_clear_after_cb = true,
         .auto_clear_before_cb = false,
@@ -179,27 +187,48 @@ void BoxAudioCodec::CreateDuplexChannels(gpio_num_t mclk, gpio_num_t bclk, gpio_
 }
 
 void BoxAudioCodec::SetOutputVolume(int volume) {
+    I2cBusLock lock(control_bus_, kI2cPriorityAudio);
     ESP_ERROR_CHECK(esp_codec_dev_set_out_vol(output_dev_, volume));
     AudioCodec::SetOutputVolume(volume);
 }
 
+void BoxAudioCodec::OpenInput() {
+    esp_codec_dev_sample_info_t fs = {
+        .bits_per_sample = 16,
+        .channel = 4,
+        .channel_mask = ESP_CODEC_DEV_MAKE_CHANNEL_MASK(0),
+        .sample_rate = (uint32_t)input_sample_rate_,
+        .mclk_multiple = 0,
+    };
+    uint16_t mic_mask = ESP_CODEC_DEV_MAKE_CHANNEL_MASK(0);
+    if (input_mics_ > 1) {
+        mic_mask |= ESP_CODEC_DEV_MAKE_CHANNEL_MASK(2);
+    }
+    fs.channel_mask = mic_mask;
+    if (input_reference_) {
+        fs.channel_mask |= ESP_CODEC_DEV_MAKE_CHANNEL_MASK(1);
+    }
+    ESP_ERROR_CHECK(esp_codec_dev_open(input_dev_, &fs));
+    ESP_ERROR_CHECK(esp_codec_dev_set_in_channel_gain(input_dev_, mic_mask, AUDIO_CODEC_DEFAULT_MIC_GAIN));
+}
+
+// 采集和播放共用 I2S 时钟，输出关闭时重新打开采集即按新的采样率配置
+void BoxAudioCodec::ApplyInputSampleRate() {
+    if (!input_enabled_) {
+        return;
+    }
+    I2cBusLock lock(control_bus_, kI2cPriorityAudio);
+    ESP_ERROR_CHECK(esp_codec_dev_close(input_dev_));
+    OpenInput();
+}
+
 void BoxAudioCodec::EnableInput(bool enable) {
     if (enable == input_enabled_) {
         return;
     }
+    I2cBusLock lock(control_bus_, kI2cPriorityAudio);
     if (enable) {
-        esp_codec_dev_sample_info_t fs = {
-            .bits_per_sample = 16,
-            .channel = 4,
-            .channel_mask = ESP_CODEC_DEV_MAKE_CHANNEL_MASK(0),
-            .sample_rate = (uint32_t)output_sample_rate_,
-            .mclk_multiple = 0,
-        };
-        if (input_reference_) {
-            fs.channel_mask |= ESP_CODEC_DEV_MAKE_CHANNEL_MASK(1);
-        }
-        ESP_ERROR_CHECK(esp_codec_dev_open(input_dev_, &fs));
-        ESP_ERROR_CHECK(esp_codec_dev_set_in_channel_gain(input_dev_, ESP_CODEC_DEV_MAKE_CHANNEL_MASK(0), AUDIO_CODEC_DEFAULT_MIC_GAIN));
+        OpenInput();
     } else {
         ESP_ERROR_CHECK(esp_codec_dev_close(input_dev_));
     }
@@ -211,20 +240,29 @@ void BoxAudioCodec::EnableOutput(bool enable) {
         return;
     }
     if (enable) {
-        // Play 16bit 1 channel
-        esp_codec_dev_sample_info_t fs = {
-            .bits_per_sample = 16,
-            .channel = 1,
-            .channel_mask = 0,
-            .sample_rate = (uint32_t)output_sample_rate_,
-            .mclk_multiple = 0,
-        };
-        ESP_ERROR_CHECK(esp_codec_dev_open(output_dev_, &fs));
-        ESP_ERROR_CHECK(esp_codec_dev_set_out_vol(output_dev_, output_volume_));
-    } else {
-        ESP_ERROR_CHECK(esp_codec_dev_close(output_dev_));
+        UpdateSampleRate(true);
+    }
+    {
+        I2cBusLock lock(control_bus_, kI2cPriorityAudio);
+        if (enable) {
+            // Play 16bit 1 channel
+            esp_codec_dev_sample_info_t fs = {
+                .bits_per_sample = 16,
+                .channel = 1,
+                .channel_mask = 0,
+                .sample_rate = (uint32_t)output_sample_rate_,
+                .mclk_multiple = 0,
+            };
+            ESP_ERROR_CHECK(esp_codec_dev_open(output_dev_, &fs));
+            ESP_ERROR_CHECK(esp_codec_dev_set_out_vol(output_dev_, output_volume_));
+        } else {
+            ESP_ERROR_CHECK(esp_codec_dev_close(output_dev_));
+        }
     }
     AudioCodec::EnableOutput(enable);
+    if (!enable) {
+        UpdateSampleRate(false);
+    }
 }
 
 int BoxAudioCodec::Read(int16_t* dest, int samples) {
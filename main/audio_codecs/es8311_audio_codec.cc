@@ -1,4 +1,5 @@
 #include "es8311_audio_codec.h"
+#include "i2c_bus.h"
 
 #include <esp_log.h>
 
@@ -8,6 +9,7 @@ Es8311AudioCodec::Es8311AudioCodec(void* i2c_master_handle, i2c_port_t i2c_port,
     gpio_num_t mclk, gpio_num_t bclk, gpio_num_t ws, gpio_num_t dout, gpio_num_t din,
     gpio_num_t pa_pin, uint8_t es8311_addr, bool use_mclk, bool pa_inverted) {
     duplex_ = true; // 是否双工
+    control_bus_ = i2c_master_handle;
     input_reference_ = false; // 是否使用参考输入，实现回声消除
     input_channels_ = 1; // 输入通道数
     input_sample_rate_ = input_sample_rate;
@@ -16,6 +18,7 @@ Es8311AudioCodec::Es8311AudioCodec(void* i2c_master_handle, i2c_port_t i2c_port,
     pa_inverted_ = pa_inverted;
 
     assert(input_sample_rate_ == output_sample_rate_);
+    idle_rate_supported_ = true;
     CreateDuplexChannels(mclk, bclk, ws, dout, din);
 
     // Do initialize of related interface: data_if, ctrl_if and gpio_if
@@ -64,6 +67,7 @@ Es8311AudioCodec::~Es8311AudioCodec() {
 }
 
 void Es8311AudioCodec::UpdateDeviceState() {
+    I2cBusLock lock(control_bus_, kI2cPriorityAudio);
     if ((input_enabled_ || output_enabled_) && dev_ == nullptr) {
         esp_codec_dev_cfg_t dev_cfg = {
             .dev_type = ESP_CODEC_DEV_TYPE_IN_OUT,
@@ -99,7 +103,7 @@ void Es8311AudioCodec::CreateDuplexChannels(gpio_num_t mclk, gpio_num_t bclk, gp
     i2s_chan_config_t chan_cfg = {
         .id = I2S_NUM_0,
         .role = I2S_ROLE_MASTER,
-        .dma_desc_num = AUDIO_CODEC_DMA_DESC_NUM,
+        .dma_desc_num = (uint32_t)dma_desc_num_,
         .dma_frame_num = AUDIO_CODEC_DMA_FRAME_NUM,
         .auto_clear_after_cb = true,
         .auto_clear_before_cb = false,
@@ -150,6 +154,7 @@ void Es8311AudioCodec::CreateDuplexChannels(gpio_num_t mclk, gpio_num_t bclk, gp
 }
 
 void Es8311AudioCodec::SetOutputVolume(int volume) {
+    I2cBusLock lock(control_bus_, kI2cPriorityAudio);
     ESP_ERROR_CHECK(esp_codec_dev_set_out_vol(dev_, volume));
     AudioCodec::SetOutputVolume(volume);
 }
@@ -166,8 +171,27 @@ void Es8311AudioCodec::EnableOutput(bool enable) {
     if (enable == output_enabled_) {
         return;
     }
+    if (enable) {
+        UpdateSampleRate(true);
+    }
     AudioCodec::EnableOutput(enable);
     UpdateDeviceState();
+    if (!enable) {
+        UpdateSampleRate(false);
+    }
+}
+
+// 输入输出共用一个设备，删除后由 UpdateDeviceState 按新的采样率重新创建
+void Es8311AudioCodec::ApplyInputSampleRate() {
+    if (dev_ == nullptr) {
+        return;
+    }
+    {
+        I2cBusLock lock(control_bus_, kI2cPriorityAudio);
+        esp_codec_dev_delete(dev_);
+        dev_ = nullptr;
+    }
+    UpdateDeviceState();
 }
 
 int Es8311AudioCodec::Read(int16_t* dest, int samples) {
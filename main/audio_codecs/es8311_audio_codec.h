@@ -24,6 +24,7 @@ private:
 
     virtual int Read(int16_t* dest, int samples) override;
     virtual int Write(const int16_t* data, int samples) override;
+    virtual void ApplyInputSampleRate() override;
 
 public:
     Es8311AudioCodec(void* i2c_master_handle, i2c_port_t i2c_port, int input_sample_rate, int output_sample_rate,
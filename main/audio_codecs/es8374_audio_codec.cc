@@ -1,4 +1,5 @@
 #include "es8374_audio_codec.h"
+#include "i2c_bus.h"
 
 #include <esp_log.h>
 
@@ -8,6 +9,7 @@ Es8374AudioCodec::Es8374AudioCodec(void* i2c_master_handle, i2c_port_t i2c_port,
     gpio_num_t mclk, gpio_num_t bclk, gpio_num_t ws, gpio_num_t dout, gpio_num_t din,
     gpio_num_t pa_pin, uint8_t es8374_addr, bool use_mclk) {
     duplex_ = true; // 是否双工
+    control_bus_ = i2c_master_handle;
     input_reference_ = false; // 是否使用参考输入，实现回声消除
     input_channels_ = 1; // 输入通道数
     input_sample_rate_ = input_sample_rate;
@@ -77,8 +79,8 @@ void Es8374AudioCodec::CreateDuplexChannels(gpio_num_t mclk, gpio_num_t bclk, gp
     i2s_chan_config_t chan_cfg = {
         .id = I2S_NUM_0,
         .role = I2S_ROLE_MASTER,
-        .dma_desc_num = 6,
-        .dma_frame_num = 240,
+        .dma_desc_num = (uint32_t)dma_desc_num_,
+        .dma_frame_num = AUDIO_CODEC_DMA_FRAME_NUM,
         .auto_clear_after_cb = true,
         .auto_clear_before_cb = false,
         .intr_priority = 0,
@@ -128,6 +130,7 @@ void Es8374AudioCodec::CreateDuplexChannels(gpio_num_t mclk, gpio_num_t bclk, gp
 }
 
 void Es8374AudioCodec::SetOutputVolume(int volume) {
+    I2cBusLock lock(control_bus_, kI2cPriorityAudio);
     ESP_ERROR_CHECK(esp_codec_dev_set_out_vol(output_dev_, volume));
     AudioCodec::SetOutputVolume(volume);
 }
@@ -136,6 +139,7 @@ void Es8374AudioCodec::EnableInput(bool enable) {
     if (enable == input_enabled_) {
         return;
     }
+    I2cBusLock lock(control_bus_, kI2cPriorityAudio);
     if (enable) {
         esp_codec_dev_sample_info_t fs = {
             .bits_per_sample = 16,
@@ -156,6 +160,7 @@ void Es8374AudioCodec::EnableOutput(bool enable) {
     if (enable == output_enabled_) {
         return;
     }
+    I2cBusLock lock(control_bus_, kI2cPriorityAudio);
     if (enable) {
         // Play 16bit 1 channel
         esp_codec_dev_sample_info_t fs = {
@@ -1,4 +1,5 @@
 #include "es8388_audio_codec.h"
+#include "i2c_bus.h"
 
 #include <esp_log.h>
 
@@ -8,11 +9,13 @@ Es8388AudioCodec::Es8388AudioCodec(void* i2c_master_handle, i2c_port_t i2c_port,
     gpio_num_t mclk, gpio_num_t bclk, gpio_num_t ws, gpio_num_t dout, gpio_num_t din,
     gpio_num_t pa_pin, uint8_t es8388_addr) {
     duplex_ = true; // 是否双工
+    control_bus_ = i2c_master_handle;
     input_reference_ = false; // 是否使用参考输入，实现回声消除
     input_channels_ = 1; // 输入通道数
     input_sample_rate_ = input_sample_rate;
     output_sample_rate_ = output_sample_rate;
-    pa_pin_ = pa_pin;                                                                                                                                                                                     CreateDuplexChannels(mclk, bclk, ws, dout, din);
+    pa_pin_ = pa_pin;
+    idle_rate_supported_ = true;                                                                                                                                                                                     CreateDuplexChannels(mclk, bclk, ws, dout, din);
 
     // Do initialize of related interface: data_if, ctrl_if and gpio_if
     audio_codec_i2s_cfg_t i2s_cfg = {
@@ -85,7 +88,7 @@ void Es8388AudioCodec::CreateDuplexChannels(gpio_num_t mclk, gpio_num_t bclk, gp
     i2s_chan_config_t chan_cfg = {
         .id = I2S_NUM_0,
         .role = I2S_ROLE_MASTER,
-        .dma_desc_num = AUDIO_CODEC_DMA_DESC_NUM,
+        .dma_desc_num = (uint32_t)dma_desc_num_,
         .dma_frame_num = AUDIO_CODEC_DMA_FRAME_NUM,
         .auto_clear_after_cb = true,
         .auto_clear_before_cb = false,
@@ -132,24 +135,39 @@ void Es8388AudioCodec::CreateDuplexChannels(gpio_num_t mclk, gpio_num_t bclk, gp
 }
 
 void Es8388AudioCodec::SetOutputVolume(int volume) {
+    I2cBusLock lock(control_bus_, kI2cPriorityAudio);
     ESP_ERROR_CHECK(esp_codec_dev_set_out_vol(output_dev_, volume));
     AudioCodec::SetOutputVolume(volume);
 }
 
+void Es8388AudioCodec::OpenInput() {
+    esp_codec_dev_sample_info_t fs = {
+        .bits_per_sample = 16,
+        .channel = 1,
+        .channel_mask = 0,
+        .sample_rate = (uint32_t)input_sample_rate_,
+        .mclk_multiple = 0,
+    };
+    ESP_ERROR_CHECK(esp_codec_dev_open(input_dev_, &fs));
+    ESP_ERROR_CHECK(esp_codec_dev_set_in_gain(input_dev_, 24.0));
+}
+
+void Es8388AudioCodec::ApplyInputSampleRate() {
+    if (!input_enabled_) {
+        return;
+    }
+    I2cBusLock lock(control_bus_, kI2cPriorityAudio);
+    ESP_ERROR_CHECK(esp_codec_dev_close(input_dev_));
+    OpenInput();
+}
+
 void Es8388AudioCodec::EnableInput(bool enable) {
     if (enable == input_enabled_) {
         return;
     }
+    I2cBusLock lock(control_bus_, kI2cPriorityAudio);
     if (enable) {
-        esp_codec_dev_sample_info_t fs = {
-            .bits_per_sample = 16,
-            .channel = 1,
-            .channel_mask = 0,
-            .sample_rate = (uint32_t)input_sample_rate_,
-            .mclk_multiple = 0,
-        };
-        ESP_ERROR_CHECK(esp_codec_dev_open(input_dev_, &fs));
-        ESP_ERROR_CHECK(esp_codec_dev_set_in_gain(input_dev_, 24.0));
+        OpenInput();
     } else {
         ESP_ERROR_CHECK(esp_codec_dev_close(input_dev_));
     }
@@ -161,33 +179,42 @@ void Es8388AudioCodec::EnableOutput(bool enable) {
         return;
     }
     if (enable) {
-        esp_codec_dev_sample_info_t fs = {
-            .bits_per_sample = 16,
-            .channel = 1,
-            .channel_mask = 0,
-            .sample_rate = (uint32_t)output_sample_rate_,
-            .mclk_multiple = 0,
-        };
-        ESP_ERROR_CHECK(esp_codec_dev_open(output_dev_, &fs));
-        ESP_ERROR_CHECK(esp_codec_dev_set_out_vol(output_dev_, output_volume_));
-
-        // Set analog output volume to 0dB, default is -45dB
-        uint8_t reg_val = 30; // 0dB
-        uint8_t regs[] = { 46, 47, 48, 49 }; // HP_LVOL, HP_RVOL, SPK_LVOL, SPK_RVOL
-        for (uint8_t reg : regs) {
-            ctrl_if_->write_reg(ctrl_if_, reg, 1, &reg_val, 1);
-        }
+        UpdateSampleRate(true);
+    }
+    {
+        I2cBusLock lock(control_bus_, kI2cPriorityAudio);
+        if (enable) {
+            esp_codec_dev_sample_info_t fs = {
+                .bits_per_sample = 16,
+                .channel = 1,
+                .channel_mask = 0,
+                .sample_rate = (uint32_t)output_sample_rate_,
+                .mclk_multiple = 0,
+            };
+            ESP_ERROR_CHECK(esp_codec_dev_open(output_dev_, &fs));
+            ESP_ERROR_CHECK(esp_codec_dev_set_out_vol(output_dev_, output_volume_));
+
+            // Set analog output volume to 0dB, default is -45dB
+            uint8_t reg_val = 30; // 0dB
+            uint8_t regs[] = { 46, 47, 48, 49 }; // HP_LVOL, HP_RVOL, SPK_LVOL, SPK_RVOL
+            for (uint8_t reg : regs) {
+                ctrl_if_->write_reg(ctrl_if_, reg, 1, &reg_val, 1);
+            }
 
-        if (pa_pin_ != GPIO_NUM_NC) {
-            gpio_set_level(pa_pin_, 1);
-        }
-    } else {
-        ESP_ERROR_CHECK(esp_codec_dev_close(output_dev_));
-        if (pa_pin_ != GPIO_NUM_NC) {
-            gpio_set_level(pa_pin_, 0);
+            if (pa_pin_ != GPIO_NUM_NC) {
+                gpio_set_level(pa_pin_, 1);
+            }
+        } else {
+            ESP_ERROR_CHECK(esp_codec_dev_close(output_dev_));
+            if (pa_pin_ != GPIO_NUM_NC) {
+                gpio_set_level(pa_pin_, 0);
+            }
         }
     }
     AudioCodec::EnableOutput(enable);
+    if (!enable) {
+        UpdateSampleRate(false);
+    }
 }
 
 int Es8388AudioCodec::Read(int16_t* dest, int samples) {
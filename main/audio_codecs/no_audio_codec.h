@@ -8,10 +8,19 @@
 
 class NoAudioCodec : public AudioCodec {
 private:
+    // 读写各自复用一块 int32 缓冲区
+    std::vector<int32_t> write_buffer_;
+    std::vector<int32_t> read_buffer_;
+
     virtual int Write(const int16_t* data, int samples) override;
     virtual int Read(int16_t* dest, int samples) override;
 
+protected:
+    // 发送通道是 32 位，和 Write 一样转换后再预载
+    virtual size_t PreloadOutput(const int16_t* data, size_t samples) override;
+
 public:
+    NoAudioCodec();
     virtual ~NoAudioCodec();
 };
 
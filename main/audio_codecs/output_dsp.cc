@@ -0,0 +1,167 @@
+#include "output_dsp.h"
+#include "pcm_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+// 限幅器压下峰值所用的时间
+#define OUTPUT_DSP_ATTACK_MS 1
+// 限幅器从 -6 dB 恢复到 0 dB 所用的时间
+#define OUTPUT_DSP_RELEASE_MS 100
+
+static inline int16_t SaturateInt16(int32_t value) {
+    return (int16_t)std::min<int32_t>(std::max<int32_t>(value, INT16_MIN), INT16_MAX);
+}
+
+static inline int32_t PeakOf(const int16_t* data, size_t samples) {
+    int32_t peak = 0;
+    for (size_t i = 0; i < samples; i++) {
+        peak = std::max<int32_t>(peak, std::abs((int32_t)data[i]));
+    }
+    return peak;
+}
+
+void OutputDsp::SetProfile(const OutputDspProfile& profile, int sample_rate) {
+    sample_rate = std::max(sample_rate, 8000);
+    int gain_db = std::min(std::max(profile.gain_db, -20), 12);
+    profile_gain_ = (int32_t)(pow(10.0, gain_db / 20.0) * 65536);
+    int limiter_dbfs = std::min(std::max(profile.limiter_dbfs, -20), 0);
+    limiter_threshold_ = (int32_t)(pow(10.0, limiter_dbfs / 20.0) * INT16_MAX);
+    limiter_attack_frames_ = std::max(1, sample_rate * OUTPUT_DSP_ATTACK_MS / 1000);
+    limiter_release_step_ = std::max(1, 16384 / (sample_rate * OUTPUT_DSP_RELEASE_MS / 1000));
+
+    if (profile.bass_shelf_hz > 0 && profile.bass_shelf_hz < sample_rate / 2 && profile.bass_shelf_db != 0) {
+        int shelf_db = std::min(std::max(profile.bass_shelf_db, -24), 12);
+        shelf_alpha_ = (int32_t)((1.0 - exp(-2.0 * M_PI * profile.bass_shelf_hz / sample_rate)) * 32768);
+        shelf_mix_ = (int32_t)((pow(10.0, shelf_db / 20.0) - 1.0) * 32768);
+    } else {
+        shelf_alpha_ = 0;
+        shelf_mix_ = 0;
+    }
+    shelf_state_[0] = shelf_state_[1] = 0;
+}
+
+void OutputDsp::Process(int16_t* data, size_t samples, int channels, int volume) {
+    channels = std::min(std::max(channels, 1), 2);
+    size_t frames = samples / channels;
+    if (frames == 0) {
+        return;
+    }
+    samples = frames * channels;
+    // 音量变化时才重新计算增益
+    if (volume != volume_) {
+        volume_ = volume;
+        volume_gain_ = volume < 0 ? 65536 : pcm::VolumeToGain(volume);
+    }
+    int32_t target = (int32_t)(((int64_t)volume_gain_ * profile_gain_) >> 16);
+    if (current_gain_ < 0) {
+        current_gain_ = target;
+    }
+
+    // 增益为 1、没有 EQ、限幅器没有在压缩，这一帧也没有超过阈值时原样输出
+    if (current_gain_ == 65536 && target == 65536 && shelf_mix_ == 0 && limiter_gain_ == 32768 &&
+        PeakOf(data, samples) <= limiter_threshold_) {
+        return;
+    }
+
+    buffer_.resize(samples);
+    int32_t* work = buffer_.data();
+    if (current_gain_ != target) {
+        // 增益在这一帧内从旧值线性过渡到新值，避免音量跳变的咔哒声
+        int32_t gain = current_gain_;
+        int32_t step = (target - current_gain_) / (int32_t)frames;
+        for (size_t f = 0; f < frames; f++, gain += step) {
+            for (int c = 0; c < channels; c++) {
+                work[f * channels + c] = (int32_t)(((int64_t)data[f * channels + c] * gain) >> 16);
+            }
+        }
+        current_gain_ = target;
+    } else if (target <= 65536) {
+        // 增益不超过 1.0 时 int16 * gain 不会溢出 int32
+        size_t i = 0;
+        for (; i + 4 <= samples; i += 4) {
+            work[i] = (data[i] * target) >> 16;
+            work[i + 1] = (data[i + 1] * target) >> 16;
+            work[i + 2] = (data[i + 2] * target) >> 16;
+            work[i + 3] = (data[i + 3] * target) >> 16;
+        }
+        for (; i < samples; i++) {
+            work[i] = (data[i] * target) >> 16;
+        }
+    } else {
+        for (size_t i = 0; i < samples; i++) {
+            work[i] = (int32_t)(((int64_t)data[i] * target) >> 16);
+        }
+    }
+
+    if (shelf_mix_ != 0) {
+        ApplyShelf(work, frames, channels);
+    }
+    ApplyLimiter(work, data, frames, channels);
+}
+
+// 低频搁架：y = x + (G - 1) * lowpass(x)，G < 1 时衰减转折频率以下的部分
+void OutputDsp::ApplyShelf(int32_t* data, size_t frames, int channels) {
+    for (int c = 0; c < channels; c++) {
+        int32_t state = shelf_state_[c];
+        for (size_t f = 0; f < frames; f++) {
+            int32_t& x = data[f * channels + c];
+            state += (int32_t)(((int64_t)(x * 16 - state) * shelf_alpha_) >> 15);
+            x += (int32_t)(((int64_t)(state / 16) * shelf_mix_) >> 15);
+        }
+        shelf_state_[c] = state;
+    }
+}
+
+// 按这一帧的峰值算出需要的增益：需要压缩时在起音时间内降下来，之后按释放速度慢慢恢复，最后饱和到 int16
+void OutputDsp::ApplyLimiter(const int32_t* src, int16_t* dst, size_t frames, int channels) {
+    size_t samples = frames * channels;
+    int32_t peak = 0;
+    for (size_t i = 0; i < samples; i++) {
+        peak = std::max(peak, std::abs(src[i]));
+    }
+    int32_t target = 32768;
+    if (peak > limiter_threshold_) {
+        target = (int32_t)((int64_t)limiter_threshold_ * 32768 / peak);
+    }
+
+    int32_t gain = limiter_gain_;
+    int32_t end_gain;
+    size_t ramp_frames;
+    if (target < gain) {
+        end_gain = target;
+        ramp_frames = std::min<size_t>(frames, limiter_attack_frames_);
+    } else {
+        end_gain = (int32_t)std::min<int64_t>(target, gain + (int64_t)limiter_release_step_ * frames);
+        ramp_frames = frames;
+    }
+
+    if (gain == 32768 && end_gain == 32768) {
+        size_t i = 0;
+        for (; i + 4 <= samples; i += 4) {
+            dst[i] = SaturateInt16(src[i]);
+            dst[i + 1] = SaturateInt16(src[i + 1]);
+            dst[i + 2] = SaturateInt16(src[i + 2]);
+            dst[i + 3] = SaturateInt16(src[i + 3]);
+        }
+        for (; i < samples; i++) {
+            dst[i] = SaturateInt16(src[i]);
+        }
+        return;
+    }
+
+    int32_t step = (end_gain - gain) / (int32_t)ramp_frames;
+    size_t f = 0;
+    for (; f < ramp_frames; f++, gain += step) {
+        for (int c = 0; c < channels; c++) {
+            size_t i = f * channels + c;
+            dst[i] = SaturateInt16((int32_t)(((int64_t)src[i] * gain) >> 15));
+        }
+    }
+    gain = end_gain;
+    for (size_t i = f * channels; i < samples; i++) {
+        dst[i] = SaturateInt16((int32_t)(((int64_t)src[i] * gain) >> 15));
+    }
+    limiter_gain_ = gain;
+}
@@ -0,0 +1,49 @@
+#ifndef _OUTPUT_DSP_H
+#define _OUTPUT_DSP_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// 板子按扬声器设置的输出处理参数
+struct OutputDspProfile {
+    // 固定增益，小喇叭可以提高响度，峰值由限幅器压住，范围 -20 ~ +12 dB
+    int gain_db = 0;
+    // 限幅阈值，0 为只在满幅时限幅
+    int limiter_dbfs = -1;
+    // 低频搁架的转折频率，0 为不使用；小喇叭放不出的低频衰减后，限幅器可以给中高频留出更多余量
+    int bass_shelf_hz = 0;
+    int bass_shelf_db = 0;
+};
+
+// 所有 codec 共用的输出处理：平滑的增益过渡、低频搁架 EQ、软限幅，每帧在 Write 之前原地处理一次
+// 定点实现，各级都不起作用时只扫描一遍峰值。调用方保证 SetProfile 和 Process 不会并发
+class OutputDsp {
+public:
+    void SetProfile(const OutputDspProfile& profile, int sample_rate);
+    // volume 为 0-100 的软件音量，codec 有硬件音量时传 -1；增益变化在一帧之内线性过渡
+    void Process(int16_t* data, size_t samples, int channels, int volume);
+
+private:
+    // Q16
+    int32_t profile_gain_ = 65536;
+    int32_t current_gain_ = -1;
+    int volume_ = -1;
+    int32_t volume_gain_ = 65536;
+    // 一阶低通的系数和 (G - 1)，Q15
+    int32_t shelf_alpha_ = 0;
+    int32_t shelf_mix_ = 0;
+    // 每个通道的低通状态，Q4
+    int32_t shelf_state_[2] = {};
+    int32_t limiter_threshold_ = INT16_MAX;
+    // 限幅增益，Q15；起音在 limiter_attack_frames_ 个采样帧内完成，释放每个采样帧恢复 limiter_release_step_
+    int32_t limiter_gain_ = 32768;
+    int limiter_attack_frames_ = 16;
+    int32_t limiter_release_step_ = 1;
+    std::vector<int32_t> buffer_;
+
+    void ApplyShelf(int32_t* data, size_t frames, int channels);
+    void ApplyLimiter(const int32_t* src, int16_t* dst, size_t frames, int channels);
+};
+
+#endif // _OUTPUT_DSP_H
@@ -0,0 +1,137 @@
+#include "pcm_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace pcm {
+
+static inline int16_t SaturateInt16(int32_t value) {
+    return (int16_t)std::min<int32_t>(std::max<int32_t>(value, INT16_MIN), INT16_MAX);
+}
+
+static inline int32_t SaturateInt32(int64_t value) {
+    return (int32_t)std::min<int64_t>(std::max<int64_t>(value, INT32_MIN), INT32_MAX);
+}
+
+int32_t VolumeToGain(int volume) {
+    volume = std::min(std::max(volume, 0), 100);
+    return (int32_t)(pow(double(volume) / 100.0, 2) * 65536);
+}
+
+void Int32ToInt16(const int32_t* src, int16_t* dst, size_t samples, int shift) {
+    size_t i = 0;
+    for (; i + 4 <= samples; i += 4) {
+        int32_t a = src[i] >> shift;
+        int32_t b = src[i + 1] >> shift;
+        int32_t c = src[i + 2] >> shift;
+        int32_t d = src[i + 3] >> shift;
+        dst[i] = SaturateInt16(a);
+        dst[i + 1] = SaturateInt16(b);
+        dst[i + 2] = SaturateInt16(c);
+        dst[i + 3] = SaturateInt16(d);
+    }
+    for (; i < samples; i++) {
+        dst[i] = SaturateInt16(src[i] >> shift);
+    }
+}
+
+void Int16ToInt32(const int16_t* src, int32_t* dst, size_t samples, int32_t gain) {
+    size_t i = 0;
+    if (gain <= 65536 && gain >= 0) {
+        // 增益不超过 1.0 时 int16 * gain 不会溢出 int32，不需要 64 位乘法
+        for (; i + 4 <= samples; i += 4) {
+            dst[i] = src[i] * gain;
+            dst[i + 1] = src[i + 1] * gain;
+            dst[i + 2] = src[i + 2] * gain;
+            dst[i + 3] = src[i + 3] * gain;
+        }
+        for (; i < samples; i++) {
+            dst[i] = src[i] * gain;
+        }
+        return;
+    }
+    for (; i < samples; i++) {
+        dst[i] = SaturateInt32(int64_t(src[i]) * gain);
+    }
+}
+
+void ApplyGain(int16_t* data, size_t samples, int32_t gain) {
+    if (gain == 65536) {
+        return;
+    }
+    size_t i = 0;
+    if (gain <= 65536 && gain >= 0) {
+        for (; i + 4 <= samples; i += 4) {
+            data[i] = (data[i] * gain) >> 16;
+            data[i + 1] = (data[i + 1] * gain) >> 16;
+            data[i + 2] = (data[i + 2] * gain) >> 16;
+            data[i + 3] = (data[i + 3] * gain) >> 16;
+        }
+    }
+    for (; i < samples; i++) {
+        data[i] = SaturateInt16((int64_t(data[i]) * gain) >> 16);
+    }
+}
+
+void Deinterleave(const int16_t* src, int16_t* left, int16_t* right, size_t frames) {
+    // 按 32 位一次读取一对样本
+    auto pairs = reinterpret_cast<const uint32_t*>(src);
+    for (size_t i = 0; i < frames; i++) {
+        uint32_t pair = pairs[i];
+        left[i] = (int16_t)(pair & 0xFFFF);
+        right[i] = (int16_t)(pair >> 16);
+    }
+}
+
+void Interleave(const int16_t* left, const int16_t* right, int16_t* dst, size_t frames) {
+    auto pairs = reinterpret_cast<uint32_t*>(dst);
+    for (size_t i = 0; i < frames; i++) {
+        pairs[i] = (uint16_t)left[i] | ((uint32_t)(uint16_t)right[i] << 16);
+    }
+}
+
+void AnalyzeLevel(const int16_t* data, size_t frames, int stride, LevelStats& stats) {
+    stats = LevelStats();
+    if (frames == 0) {
+        return;
+    }
+    // 平方和分四路累加，打断相邻样本之间的依赖；满幅样本的平方接近 2^30，累加用 64 位
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    int32_t peak = 0;
+    uint32_t clipped = 0;
+    uint32_t crossings = 0;
+    int32_t previous = data[0];
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        int32_t a = data[i * stride];
+        int32_t b = data[(i + 1) * stride];
+        int32_t c = data[(i + 2) * stride];
+        int32_t d = data[(i + 3) * stride];
+        s0 += a * a;
+        s1 += b * b;
+        s2 += c * c;
+        s3 += d * d;
+        // 用最小值和最大值求绝对值的峰值，-32768 按 32768 计
+        int32_t lo = std::min(std::min(a, b), std::min(c, d));
+        int32_t hi = std::max(std::max(a, b), std::max(c, d));
+        peak = std::max(peak, std::max(hi, -lo));
+        clipped += (a >= INT16_MAX || a <= INT16_MIN) + (b >= INT16_MAX || b <= INT16_MIN) +
+            (c >= INT16_MAX || c <= INT16_MIN) + (d >= INT16_MAX || d <= INT16_MIN);
+        crossings += ((previous ^ a) < 0) + ((a ^ b) < 0) + ((b ^ c) < 0) + ((c ^ d) < 0);
+        previous = d;
+    }
+    for (; i < frames; i++) {
+        int32_t a = data[i * stride];
+        s0 += a * a;
+        peak = std::max(peak, std::max(a, -a));
+        clipped += a >= INT16_MAX || a <= INT16_MIN;
+        crossings += (previous ^ a) < 0;
+        previous = a;
+    }
+    stats.sum_squares = s0 + s1 + s2 + s3;
+    stats.peak = peak;
+    stats.clipped = clipped;
+    stats.zero_crossings = crossings;
+}
+
+} // namespace pcm
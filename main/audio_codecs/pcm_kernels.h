@@ -0,0 +1,42 @@
+#ifndef _PCM_KERNELS_H
+#define _PCM_KERNELS_H
+
+#include <cstdint>
+#include <cstddef>
+
+// PCM 格式转换与增益处理
+// 循环按 4 个样本展开，饱和运算写成 min/max 形式，便于编译成 Xtensa 的 MIN/MAX/CLAMPS 指令
+namespace pcm {
+
+// 音量 0-100 转换为 Q16 增益，按平方曲线映射
+int32_t VolumeToGain(int volume);
+
+// int32 样本右移 shift 位并饱和到 int16
+void Int32ToInt16(const int32_t* src, int16_t* dst, size_t samples, int shift);
+
+// int16 样本乘以 Q16 增益后作为 int32 输出（高 16 位有效）
+void Int16ToInt32(const int16_t* src, int32_t* dst, size_t samples, int32_t gain);
+
+// 原地对 int16 样本应用 Q16 增益并饱和
+void ApplyGain(int16_t* data, size_t samples, int32_t gain);
+
+// 双声道交织数据拆分为两个单声道
+void Deinterleave(const int16_t* src, int16_t* left, int16_t* right, size_t frames);
+
+// 两个单声道合并为交织的双声道数据
+void Interleave(const int16_t* left, const int16_t* right, int16_t* dst, size_t frames);
+
+// 一帧的电平统计
+struct LevelStats {
+    uint64_t sum_squares = 0;
+    int32_t peak = 0;              // 绝对值的最大值
+    uint32_t clipped = 0;          // 达到满幅（±32767/-32768）的样本数
+    uint32_t zero_crossings = 0;   // 相邻样本符号变化的次数
+};
+
+// 一次遍历算出平方和、峰值、削波和过零次数，stride 为交织数据的声道数，只统计第一路
+void AnalyzeLevel(const int16_t* data, size_t frames, int stride, LevelStats& stats);
+
+} // namespace pcm
+
+#endif // _PCM_KERNELS_H
@@ -0,0 +1,48 @@
+#include "audio_frame_ring.h"
+
+AudioFrameRing::AudioFrameRing(size_t slots, size_t max_samples) : max_samples_(max_samples) {
+    size_t count = 2;
+    while (count < slots) {
+        count <<= 1;
+    }
+    frames_.resize(count);
+    for (auto& frame : frames_) {
+        frame.samples.reserve(max_samples_);
+    }
+}
+
+AudioFrameRing::Frame* AudioFrameRing::Back() {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) >= frames_.size()) {
+        overflows_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    return &frames_[head & (frames_.size() - 1)];
+}
+
+void AudioFrameRing::Commit() {
+    head_.fetch_add(1, std::memory_order_release);
+}
+
+AudioFrameRing::Frame* AudioFrameRing::Front() {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    return &frames_[tail & (frames_.size() - 1)];
+}
+
+void AudioFrameRing::Pop() {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    auto& frame = frames_[tail & (frames_.size() - 1)];
+    frame.samples.clear();
+    // 编码器接口按右值接收 PCM，如果容量被拿走就重新预留，生产者写入时不再分配
+    if (frame.samples.capacity() < max_samples_) {
+        frame.samples.reserve(max_samples_);
+    }
+    tail_.store(tail + 1, std::memory_order_release);
+}
+
+size_t AudioFrameRing::size() const {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+}
@@ -0,0 +1,50 @@
+#ifndef AUDIO_FRAME_RING_H
+#define AUDIO_FRAME_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 单生产者/单消费者的 PCM 帧环形队列，槽位在构造时一次分配，入队出队不加锁也不分配内存
+// 生产者用 Back() 取得下一个空槽，直接往里拼接采样，整帧后 Commit()；消费者用 Front() 读取，处理完 Pop()
+// 队列满时 Back() 返回 nullptr 并计入 overflows()
+class AudioFrameRing {
+public:
+    struct Frame {
+        std::vector<int16_t> samples;
+        uint32_t timestamp = 0;
+        uint32_t trace_us = 0;
+        int frame_duration = 0;
+        bool onset = false;         // 一段语音的第一帧，编码前重置编码器
+        bool testing = false;       // 音频测试模式的帧，编码结果进入测试队列
+    };
+
+    // slots 向上取整到 2 的幂，每个槽位预留 max_samples 个采样
+    AudioFrameRing(size_t slots, size_t max_samples);
+
+    AudioFrameRing(const AudioFrameRing&) = delete;
+    AudioFrameRing& operator=(const AudioFrameRing&) = delete;
+
+    // 以下两个方法只能在生产者线程调用
+    Frame* Back();
+    void Commit();
+
+    // 以下两个方法只能在消费者线程调用
+    Frame* Front();
+    void Pop();
+
+    size_t size() const;
+    bool empty() const { return size() == 0; }
+    size_t max_samples() const { return max_samples_; }
+    uint32_t overflows() const { return overflows_.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<Frame> frames_;
+    size_t max_samples_;
+    std::atomic<uint32_t> head_{0};
+    std::atomic<uint32_t> tail_{0};
+    std::atomic<uint32_t> overflows_{0};
+};
+
+#endif // AUDIO_FRAME_RING_H
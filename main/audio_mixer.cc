@@ -0,0 +1,111 @@
+#include "audio_mixer.h"
+
+#include <esp_log.h>
+#include <algorithm>
+
+#define TAG "AudioMixer"
+
+// 每个源最多缓存的帧数，解码一次最多多出一帧
+#define AUDIO_MIXER_FIFO_FRAMES 4
+
+void AudioMixer::Configure(size_t frame_samples) {
+    frame_samples_ = frame_samples;
+    for (auto& source : sources_) {
+        source.fifo.assign(frame_samples * AUDIO_MIXER_FIFO_FRAMES, 0);
+        source.read_pos = 0;
+        source.buffered = 0;
+    }
+    accumulator_.assign(frame_samples, 0);
+}
+
+void AudioMixer::SetGain(AudioMixerSource source, int32_t gain) {
+    sources_[source].gain = gain;
+}
+
+void AudioMixer::SetDucked(AudioMixerSource source, bool ducked) {
+    sources_[source].ducked = ducked;
+}
+
+void AudioMixer::RequestClear(AudioMixerSource source) {
+    sources_[source].clear_pending = true;
+}
+
+void AudioMixer::ApplyPendingClear(Source& source) {
+    if (source.clear_pending.exchange(false)) {
+        source.read_pos = 0;
+        source.buffered = 0;
+    }
+}
+
+void AudioMixer::Write(AudioMixerSource source_id, const int16_t* pcm, size_t samples) {
+    auto& source = sources_[source_id];
+    ApplyPendingClear(source);
+    size_t capacity = source.fifo.size();
+    size_t buffered = source.buffered;
+    if (buffered + samples > capacity) {
+        ESP_LOGW(TAG, "Source %d overflow, drop %u samples", source_id, (unsigned)(buffered + samples - capacity));
+        samples = capacity - buffered;
+    }
+    size_t write_pos = (source.read_pos + buffered) % capacity;
+    for (size_t i = 0; i < samples; i++) {
+        source.fifo[write_pos] = pcm[i];
+        write_pos = write_pos + 1 == capacity ? 0 : write_pos + 1;
+    }
+    source.buffered = buffered + samples;
+}
+
+bool AudioMixer::Mix(std::vector<int16_t>& output) {
+    size_t samples = 0;
+    bool other_source_active = false;
+    for (auto& source : sources_) {
+        ApplyPendingClear(source);
+        samples = std::max(samples, std::min<size_t>(source.buffered, frame_samples_));
+        if (!source.ducked && source.buffered > 0) {
+            other_source_active = true;
+        }
+    }
+    if (samples == 0) {
+        return false;
+    }
+
+    std::fill(accumulator_.begin(), accumulator_.begin() + samples, 0);
+    for (auto& source : sources_) {
+        int32_t target = source.gain;
+        if (source.ducked && other_source_active) {
+            target = int32_t((int64_t(source.gain) * AUDIO_MIXER_DUCK_GAIN) >> 16);
+        }
+        size_t available = std::min<size_t>(source.buffered, samples);
+        if (available == 0) {
+            // 没有数据时直接跳到目标增益，下次出声时不会有斜坡
+            source.current_gain = target;
+            continue;
+        }
+
+        int32_t gain = source.current_gain;
+        int32_t step = (target - gain) / AUDIO_MIXER_RAMP_SAMPLES;
+        if (step == 0 && target != gain) {
+            step = target > gain ? 1 : -1;
+        }
+        size_t capacity = source.fifo.size();
+        size_t read_pos = source.read_pos;
+        for (size_t i = 0; i < available; i++) {
+            if (gain != target) {
+                gain += step;
+                if ((step > 0 && gain > target) || (step < 0 && gain < target)) {
+                    gain = target;
+                }
+            }
+            accumulator_[i] += (int64_t(source.fifo[read_pos]) * gain) >> 16;
+            read_pos = read_pos + 1 == capacity ? 0 : read_pos + 1;
+        }
+        source.current_gain = gain;
+        source.read_pos = read_pos;
+        source.buffered = source.buffered - available;
+    }
+
+    output.resize(samples);
+    for (size_t i = 0; i < samples; i++) {
+        output[i] = (int16_t)std::min<int32_t>(std::max<int32_t>(accumulator_[i], INT16_MIN), INT16_MAX);
+    }
+    return true;
+}
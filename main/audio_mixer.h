@@ -0,0 +1,56 @@
+#ifndef AUDIO_MIXER_H
+#define AUDIO_MIXER_H
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+enum AudioMixerSource {
+    kAudioSourceTts,
+    kAudioSourcePrompt,
+    kAudioSourceCount
+};
+
+// 闪避时被压低的源的增益 (Q16)，以及增益变化的斜坡长度
+#define AUDIO_MIXER_DUCK_GAIN (65536 * 3 / 10)
+#define AUDIO_MIXER_RAMP_SAMPLES 256
+
+// 输出混音器
+// 每个源有一个输出采样率的 PCM FIFO，Mix 时按各自增益在 int32 中累加再饱和到 int16
+// 被设置为可闪避的源在其它源有数据时平滑地压低音量
+// Write / Mix 只在解码通道中调用，Buffered 和 RequestClear 可以在其它任务中调用
+class AudioMixer {
+public:
+    void Configure(size_t frame_samples);
+    void SetGain(AudioMixerSource source, int32_t gain);
+    void SetDucked(AudioMixerSource source, bool ducked);
+
+    size_t frame_samples() const { return frame_samples_; }
+    size_t Buffered(AudioMixerSource source) const { return sources_[source].buffered; }
+    bool IsActive(AudioMixerSource source) const { return sources_[source].buffered > 0; }
+
+    void RequestClear(AudioMixerSource source);
+    void Write(AudioMixerSource source, const int16_t* pcm, size_t samples);
+    // 输出最多一帧，返回 false 表示所有源都没有数据
+    bool Mix(std::vector<int16_t>& output);
+
+private:
+    struct Source {
+        std::vector<int16_t> fifo;
+        size_t read_pos = 0;
+        std::atomic<size_t> buffered{0};
+        int32_t gain = 65536;
+        int32_t current_gain = 65536;
+        bool ducked = false;
+        std::atomic<bool> clear_pending{false};
+    };
+
+    size_t frame_samples_ = 0;
+    Source sources_[kAudioSourceCount];
+    std::vector<int32_t> accumulator_;
+
+    void ApplyPendingClear(Source& source);
+};
+
+#endif // AUDIO_MIXER_H
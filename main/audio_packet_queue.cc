@@ -0,0 +1,168 @@
+#include "audio_packet_queue.h"
+#include "heap_accounting.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <cstring>
+
+#define TAG "AudioPacketQueue"
+
+static inline size_t AlignRecord(size_t size) {
+    return (size + 3) & ~size_t(3);
+}
+
+AudioPacketQueue::AudioPacketQueue(size_t max_packets, size_t capacity_bytes) : max_packets_{max_packets} {
+    capacity_ = 64;
+    while (capacity_ < capacity_bytes) {
+        capacity_ <<= 1;
+    }
+
+#if CONFIG_AUDIO_PACKET_BUFFER_IN_PSRAM
+    buffer_ = (uint8_t*)HeapAccounting::MallocPreferSpiram(kHeapTagAudio, capacity_);
+#else
+    buffer_ = (uint8_t*)HeapAccounting::Malloc(kHeapTagAudio, capacity_, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+#endif
+    if (buffer_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %u bytes for audio packet queue", capacity_);
+        capacity_ = 0;
+    }
+}
+
+AudioPacketQueue::~AudioPacketQueue() {
+    if (buffer_ != nullptr) {
+        HeapAccounting::Free(kHeapTagAudio, buffer_);
+    }
+}
+
+bool AudioPacketQueue::Push(const AudioStreamPacket& packet) {
+    return Push(packet.sample_rate, packet.frame_duration, packet.timestamp, packet.payload.data(), packet.payload.size(),
+        packet.trace_us, packet.fec);
+}
+
+bool AudioPacketQueue::Push(int sample_rate, int frame_duration, uint32_t timestamp, const uint8_t* payload, size_t size,
+        uint32_t trace_us, bool fec) {
+    size_t record_size = AlignRecord(sizeof(Record) + size);
+    if (size >= kWrapMarker || record_size > capacity_ / 2) {
+        ESP_LOGW(TAG, "Audio packet too large: %u bytes", size);
+        return false;
+    }
+
+    if (pushed_.load(std::memory_order_relaxed) - popped_.load(std::memory_order_acquire) >= max_packets_) {
+        return false;
+    }
+
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    uint32_t tail = tail_.load(std::memory_order_acquire);
+    size_t offset = head & (capacity_ - 1);
+    size_t contiguous = capacity_ - offset;
+    // 尾部剩余空间放不下整条记录时，跳到缓冲区开头
+    size_t padding = contiguous < record_size ? contiguous : 0;
+    if (capacity_ - (head - tail) < padding + record_size) {
+        return false;
+    }
+    if (padding > 0) {
+        if (padding >= sizeof(Record)) {
+            reinterpret_cast<Record*>(buffer_ + offset)->payload_size = kWrapMarker;
+        }
+        head += padding;
+        offset = 0;
+    }
+
+    auto record = reinterpret_cast<Record*>(buffer_ + offset);
+    record->sample_rate = sample_rate;
+    record->timestamp = timestamp;
+    record->frame_duration = frame_duration | (fec ? kFecFlag : 0);
+    record->payload_size = size;
+#if CONFIG_AUDIO_PIPELINE_TRACE
+    record->trace_us = trace_us;
+    record->push_us = AudioTrace::Now();
+#endif
+    if (size > 0) {
+        memcpy(record + 1, payload, size);
+    }
+
+    head_.store(head + record_size, std::memory_order_release);
+    pushed_.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+AudioPacketQueue::Record* AudioPacketQueue::Front(uint32_t& tail) {
+    uint32_t head = head_.load(std::memory_order_acquire);
+    if (tail == head) {
+        return nullptr;
+    }
+    size_t offset = tail & (capacity_ - 1);
+    size_t contiguous = capacity_ - offset;
+    if (contiguous < sizeof(Record) || reinterpret_cast<Record*>(buffer_ + offset)->payload_size == kWrapMarker) {
+        tail += contiguous;
+        offset = 0;
+    }
+    return reinterpret_cast<Record*>(buffer_ + offset);
+}
+
+bool AudioPacketQueue::Pop(AudioStreamPacket& packet) {
+    ApplyPendingClear();
+
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    auto record = Front(tail);
+    if (record == nullptr) {
+        return false;
+    }
+
+    packet.sample_rate = record->sample_rate;
+    packet.frame_duration = record->frame_duration & ~kFecFlag;
+    packet.fec = (record->frame_duration & kFecFlag) != 0;
+    packet.timestamp = record->timestamp;
+#if CONFIG_AUDIO_PIPELINE_TRACE
+    packet.trace_us = record->trace_us;
+    if (trace_stage_ != kAudioTraceStageCount) {
+        AudioTrace::Record(trace_stage_, record->push_us);
+    }
+#endif
+    auto payload = reinterpret_cast<const uint8_t*>(record + 1);
+    packet.payload.assign(payload, payload + record->payload_size);
+
+    tail += AlignRecord(sizeof(Record) + record->payload_size);
+    tail_.store(tail, std::memory_order_release);
+    popped_.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+void AudioPacketQueue::Clear() {
+    clear_count_.store(pushed_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    clear_head_.store(head_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    clear_pending_.store(true, std::memory_order_release);
+}
+
+void AudioPacketQueue::ApplyPendingClear() {
+    if (!clear_pending_.exchange(false, std::memory_order_acq_rel)) {
+        return;
+    }
+
+    // 逐条跳过 Clear() 时刻之前入队的记录，保证计数和读位置一致
+    uint32_t clear_head = clear_head_.load(std::memory_order_relaxed);
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    uint32_t dropped = 0;
+    while (static_cast<int32_t>(clear_head - tail) > 0) {
+        auto record = Front(tail);
+        if (record == nullptr) {
+            break;
+        }
+        tail += AlignRecord(sizeof(Record) + record->payload_size);
+        dropped++;
+    }
+    tail_.store(tail, std::memory_order_release);
+    popped_.fetch_add(dropped, std::memory_order_release);
+}
+
+size_t AudioPacketQueue::size() const {
+    uint32_t pushed = pushed_.load(std::memory_order_acquire);
+    uint32_t popped = popped_.load(std::memory_order_acquire);
+    if (clear_pending_.load(std::memory_order_acquire)) {
+        uint32_t cleared = clear_count_.load(std::memory_order_relaxed);
+        if (static_cast<int32_t>(cleared - popped) > 0) {
+            popped = cleared;
+        }
+    }
+    return pushed - popped;
+}
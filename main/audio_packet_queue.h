@@ -0,0 +1,75 @@
+#ifndef AUDIO_PACKET_QUEUE_H
+#define AUDIO_PACKET_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "protocol.h"
+#include "audio_trace.h"
+
+// 单生产者/单消费者的音频包环形队列
+// 包头和负载内联存放在一块预分配的内存中，入队出队都不会触发堆分配
+// Push() 只能在生产者线程调用，Pop()/Drop() 只能在消费者线程调用
+// Clear() 可以在生产者一侧调用，实际的丢弃由消费者在下一次 Pop() 时完成
+class AudioPacketQueue {
+public:
+    // capacity_bytes 会向上取整到 2 的幂
+    AudioPacketQueue(size_t max_packets, size_t capacity_bytes);
+    ~AudioPacketQueue();
+
+    AudioPacketQueue(const AudioPacketQueue&) = delete;
+    AudioPacketQueue& operator=(const AudioPacketQueue&) = delete;
+
+    bool Push(const AudioStreamPacket& packet);
+    bool Push(int sample_rate, int frame_duration, uint32_t timestamp, const uint8_t* payload, size_t size,
+        uint32_t trace_us = 0, bool fec = false);
+    // 出队到 packet，packet.payload 的容量会被复用
+    bool Pop(AudioStreamPacket& packet);
+    void Clear();
+
+    size_t size() const;
+    bool empty() const { return size() == 0; }
+    bool full() const { return size() >= max_packets_; }
+    size_t max_packets() const { return max_packets_; }
+    // 帧长变化时按时长调整包数上限，字节容量不变
+    void SetMaxPackets(size_t max_packets) { max_packets_ = max_packets; }
+    size_t capacity_bytes() const { return capacity_; }
+    // 出队时把排队时间记到这个追踪阶段
+    void SetTraceStage(AudioTraceStage stage) { trace_stage_ = stage; }
+
+private:
+    // 每条记录 4 字节对齐，payload_size 为 kWrapMarker 表示跳到缓冲区开头
+    struct Record {
+        uint32_t sample_rate;
+        uint32_t timestamp;
+        uint16_t frame_duration;
+        uint16_t payload_size;
+#if CONFIG_AUDIO_PIPELINE_TRACE
+        uint32_t trace_us;
+        uint32_t push_us;
+#endif
+    };
+    static constexpr uint16_t kWrapMarker = 0xFFFF;
+    // frame_duration 的最高位表示 AudioStreamPacket::fec
+    static constexpr uint16_t kFecFlag = 0x8000;
+
+    uint8_t* buffer_ = nullptr;
+    size_t capacity_ = 0;
+    std::atomic<size_t> max_packets_{0};
+    AudioTraceStage trace_stage_ = kAudioTraceStageCount;
+
+    std::atomic<uint32_t> head_{0};     // 生产者写入位置（字节，单调递增）
+    std::atomic<uint32_t> tail_{0};     // 消费者读取位置（字节，单调递增）
+    std::atomic<uint32_t> pushed_{0};
+    std::atomic<uint32_t> popped_{0};
+
+    std::atomic<bool> clear_pending_{false};
+    std::atomic<uint32_t> clear_head_{0};
+    std::atomic<uint32_t> clear_count_{0};
+
+    Record* Front(uint32_t& tail);
+    void ApplyPendingClear();
+};
+
+#endif // AUDIO_PACKET_QUEUE_H
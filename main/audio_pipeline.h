@@ -0,0 +1,23 @@
+#ifndef AUDIO_PIPELINE_H
+#define AUDIO_PIPELINE_H
+
+// 编译期已知的板级音频参数，由 CMake 从板级 config.h 中读取后定义
+// 音频管线按这些参数实例化，不需要的重采样和声道拆分在编译期去掉，每帧不再判断
+// 运行时 codec 的实际参数与这里不一致时（例如板子运行时检测 codec 型号）退回通用路径
+#if CONFIG_AUDIO_PIPELINE_SPECIALIZED && defined(BOARD_AUDIO_INPUT_SAMPLE_RATE) \
+    && defined(BOARD_AUDIO_OUTPUT_SAMPLE_RATE) && defined(BOARD_AUDIO_INPUT_REFERENCE)
+#define AUDIO_PIPELINE_SPECIALIZED 1
+
+struct BoardAudioPipeline {
+    static constexpr int kInputSampleRate = BOARD_AUDIO_INPUT_SAMPLE_RATE;
+    static constexpr int kOutputSampleRate = BOARD_AUDIO_OUTPUT_SAMPLE_RATE;
+    // 有回采通道时输入为交错的麦克风和参考信号
+    static constexpr int kInputChannels = BOARD_AUDIO_INPUT_REFERENCE ? 2 : 1;
+    // 提示音固定为 16kHz
+    static constexpr bool kPromptResample = kOutputSampleRate != 16000;
+};
+#else
+#define AUDIO_PIPELINE_SPECIALIZED 0
+#endif
+
+#endif // AUDIO_PIPELINE_H
@@ -0,0 +1,142 @@
+#include "aec_calibration.h"
+#include "settings.h"
+#include "task_stack.h"
+
+#include <esp_log.h>
+#include <cmath>
+#include <cstdlib>
+
+#define TAG "AecCalibration"
+
+#define AEC_CALIBRATION_SAMPLE_RATE 16000
+
+bool AecCalibration::Load(AecCalibration& calibration) {
+    Settings settings("aec", false);
+    calibration.delay_samples = settings.GetInt("delay", -1);
+    calibration.gain_x100 = settings.GetInt("gain_x100", 0);
+    calibration.correlation_x100 = settings.GetInt("corr_x100", 0);
+    return calibration.delay_samples >= 0;
+}
+
+void AecCalibration::Save() const {
+    Settings settings("aec", true);
+    settings.SetInt("delay", delay_samples);
+    settings.SetInt("gain_x100", gain_x100);
+    settings.SetInt("corr_x100", correlation_x100);
+}
+
+void ReferenceAligner::Configure(const std::string& input_format, int delay_samples) {
+    auto reference = input_format.find('R');
+    channels_ = input_format.size();
+    reference_index_ = reference == std::string::npos ? -1 : reference;
+    pending_delay_ = reference == std::string::npos ? 0 : delay_samples;
+}
+
+void ReferenceAligner::Process(std::vector<int16_t>& data) {
+    int pending = pending_delay_.exchange(-1);
+    if (pending >= 0) {
+        delay_samples_ = pending;
+        history_.assign(delay_samples_, 0);
+        position_ = 0;
+    }
+    if (delay_samples_ <= 0 || reference_index_ < 0) {
+        return;
+    }
+    // history_ 是回采通道最近 delay_samples_ 个样本的环形缓冲，输出最老的一个
+    int channels = channels_;
+    for (size_t i = reference_index_; i < data.size(); i += channels) {
+        int16_t delayed = history_[position_];
+        history_[position_] = data[i];
+        data[i] = delayed;
+        if (++position_ == history_.size()) {
+            position_ = 0;
+        }
+    }
+}
+
+bool AecCalibrator::Start(const std::string& input_format, Callback callback) {
+    auto reference_index = input_format.find('R');
+    auto mic_index = input_format.find('M');
+    if (reference_index == std::string::npos || mic_index == std::string::npos) {
+        ESP_LOGE(TAG, "Input format %s has no reference channel", input_format.c_str());
+        return false;
+    }
+    if (active_) {
+        return false;
+    }
+    channels_ = input_format.size();
+    mic_index_ = mic_index;
+    reference_index_ = reference_index;
+    size_t samples = AEC_CALIBRATION_SAMPLE_RATE * AEC_CALIBRATION_RECORD_MS / 1000;
+    mic_.clear();
+    mic_.reserve(samples);
+    reference_.clear();
+    reference_.reserve(samples);
+    callback_ = std::move(callback);
+    active_ = true;
+    return true;
+}
+
+void AecCalibrator::Feed(std::span<const int16_t> data) {
+    if (!active_ || mic_.size() == mic_.capacity()) {
+        return;
+    }
+    for (size_t i = 0; i + channels_ <= data.size() && mic_.size() < mic_.capacity(); i += channels_) {
+        mic_.push_back(data[i + mic_index_]);
+        reference_.push_back(data[i + reference_index_]);
+    }
+    if (mic_.size() == mic_.capacity()) {
+        // 互相关约 2400 万次乘加，放到低优先级任务中计算
+        TaskStack::Create("aec_calibrate", 4096, 1, kTaskStackPsram, [this]() {
+            Analyze();
+        });
+    }
+}
+
+void AecCalibrator::Analyze() {
+    int max_lag = AEC_CALIBRATION_SAMPLE_RATE * AEC_CALIBRATION_MAX_DELAY_MS / 1000;
+    int length = mic_.size() - max_lag;
+    AecCalibration calibration;
+    bool ok = false;
+    if (length > 0) {
+        int64_t reference_energy = 0;
+        for (int n = 0; n < length; n++) {
+            reference_energy += (int32_t)reference_[n] * reference_[n];
+        }
+        int64_t best = 0;
+        int best_lag = 0;
+        for (int lag = 0; lag <= max_lag; lag++) {
+            int64_t sum = 0;
+            const int16_t* m = mic_.data() + lag;
+            for (int n = 0; n < length; n++) {
+                sum += (int32_t)reference_[n] * m[n];
+            }
+            if (std::llabs(sum) > std::llabs(best)) {
+                best = sum;
+                best_lag = lag;
+            }
+        }
+        int64_t mic_energy = 0;
+        for (int n = 0; n < length; n++) {
+            int32_t value = mic_[n + best_lag];
+            mic_energy += value * value;
+        }
+        if (reference_energy > 0 && mic_energy > 0) {
+            double correlation = std::fabs((double)best) / std::sqrt((double)reference_energy * (double)mic_energy);
+            calibration.delay_samples = best_lag;
+            calibration.gain_x100 = std::lround(std::fabs((double)best) / reference_energy * 100);
+            calibration.correlation_x100 = std::lround(correlation * 100);
+            ok = calibration.correlation_x100 >= AEC_CALIBRATION_MIN_CORRELATION;
+        }
+    }
+    ESP_LOGI(TAG, "Delay %d samples (%d ms), gain %d%%, correlation %d%%%s", calibration.delay_samples,
+        calibration.delay_samples * 1000 / AEC_CALIBRATION_SAMPLE_RATE, calibration.gain_x100,
+        calibration.correlation_x100, ok ? "" : ", no echo detected");
+    if (ok) {
+        calibration.Save();
+    }
+    active_ = false;
+    if (callback_) {
+        callback_(ok, calibration);
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef AEC_CALIBRATION_H
+#define AEC_CALIBRATION_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <vector>
+
+// 搜索的最大扬声器到麦克风延迟
+#define AEC_CALIBRATION_MAX_DELAY_MS 64
+// 录制时长，覆盖测试音和回声拖尾
+#define AEC_CALIBRATION_RECORD_MS 1500
+// 归一化互相关的峰值低于这个值（x100）认为没有测到回声
+#define AEC_CALIBRATION_MIN_CORRELATION 30
+
+// 校准结果，保存在 NVS 的 aec 命名空间中
+struct AecCalibration {
+    int delay_samples = 0;      // 16kHz 下回采通道领先麦克风的样本数
+    int gain_x100 = 0;          // 回声路径在峰值处的增益
+    int correlation_x100 = 0;
+
+    static bool Load(AecCalibration& calibration);
+    void Save() const;
+};
+
+// 把 16kHz 交错输入中的回采通道延后 delay_samples，和麦克风里的回声对齐，AEC 的自适应滤波器一开始就落在回声上
+// Process 只在采集任务中调用，Configure 可以在其他任务中调用，新的延迟在下一次 Process 时生效
+class ReferenceAligner {
+public:
+    // input_format 是 AudioCodec::GetInputFormat()，没有回采通道或延迟为 0 时不处理
+    void Configure(const std::string& input_format, int delay_samples);
+    void Process(std::vector<int16_t>& data);
+    int delay_samples() const { return delay_samples_; }
+
+private:
+    std::atomic<int> channels_{1};
+    std::atomic<int> reference_index_{-1};
+    std::atomic<int> pending_delay_{-1};
+    int delay_samples_ = 0;
+    std::vector<int16_t> history_;
+    size_t position_ = 0;
+};
+
+// 空闲时播放一段已知的提示音，同时录下麦克风和回采通道，按互相关的峰值测出延迟和增益
+// Feed 在采集任务中调用，录满后在后台任务中计算，完成回调也在后台任务中调用
+class AecCalibrator {
+public:
+    using Callback = std::function<void(bool ok, const AecCalibration& calibration)>;
+
+    bool Start(const std::string& input_format, Callback callback);
+    void Feed(std::span<const int16_t> data);
+    bool active() const { return active_; }
+
+private:
+    std::atomic<bool> active_{false};
+    int channels_ = 1;
+    int mic_index_ = 0;
+    int reference_index_ = -1;
+    std::vector<int16_t> mic_;
+    std::vector<int16_t> reference_;
+    Callback callback_;
+
+    void Analyze();
+};
+
+#endif // AEC_CALIBRATION_H
@@ -1,33 +1,59 @@
 #include "afe_audio_processor.h"
+#include "sr_models.h"
+#include "audio_trace.h"
+#include "metrics.h"
+#include "task_manifest.h"
+
 #include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
 
 #define PROCESSOR_RUNNING 0x01
+#define PROCESSOR_RELEASE 0x02
 
 #define TAG "AfeAudioProcessor"
 
-AfeAudioProcessor::AfeAudioProcessor()
-    : afe_data_(nullptr) {
+static MetricGauge metric_cpu_percent("afe.voice_cpu_percent");
+
+#ifdef CONFIG_USE_DEVICE_AEC
+#define DEVICE_AEC_DEFAULT true
+#else
+#define DEVICE_AEC_DEFAULT false
+#endif
+
+AfeAudioProcessor::AfeAudioProcessor(AfeFrontEnd* front_end)
+    : afe_data_(nullptr), front_end_(front_end), device_aec_enabled_(DEVICE_AEC_DEFAULT), cpu_meter_(metric_cpu_percent) {
     event_group_ = xEventGroupCreate();
 }
 
 void AfeAudioProcessor::Initialize(AudioCodec* codec) {
     codec_ = codec;
-    int ref_num = codec_->input_reference() ? 1 : 0;
-
-    std::string input_format;
-    for (int i = 0; i < codec_->input_channels() - ref_num; i++) {
-        input_format.push_back('M');
-    }
-    for (int i = 0; i < ref_num; i++) {
-        input_format.push_back('R');
+    if (front_end_ != nullptr) {
+        front_end_->Initialize(codec);
+        front_end_->OnResult(kAfeConsumerVoice, [this](const afe_fetch_result_t* res) {
+            ProcessResult(res);
+        });
+        return;
     }
+}
 
-    srmodel_list_t *models = esp_srmodel_init("model");
-    char* ns_model_name = esp_srmodel_filter(models, ESP_NSNET_PREFIX, NULL);
-    char* vad_model_name = esp_srmodel_filter(models, ESP_VADN_PREFIX, NULL);
+// 调用者需要持有 afe_mutex_
+bool AfeAudioProcessor::CreateAfe() {
+    auto start_time = esp_timer_get_time();
+    // 模型名指向共享的模型列表，AFE 存在期间一直持有引用
+    models_ = SrModels::Acquire();
+    char* ns_model_name = models_ ? esp_srmodel_filter(models_, ESP_NSNET_PREFIX, NULL) : nullptr;
+    char* vad_model_name = models_ ? esp_srmodel_filter(models_, ESP_VADN_PREFIX, NULL) : nullptr;
     
-    afe_config_t* afe_config = afe_config_init(input_format.c_str(), NULL, AFE_TYPE_VC, AFE_MODE_HIGH_PERF);
-    afe_config->aec_mode = AEC_MODE_VOIP_HIGH_PERF;
+    afe_config_t* afe_config = CreateAfeConfig(codec_, NULL, AFE_TYPE_VC);
+    if (afe_config == nullptr) {
+        ESP_LOGE(TAG, "Failed to create AFE config");
+        if (models_ != nullptr) {
+            SrModels::Release();
+            models_ = nullptr;
+        }
+        return false;
+    }
     afe_config->vad_mode = VAD_MODE_0;
     afe_config->vad_min_noise_ms = 100;
     if (vad_model_name != nullptr) {
@@ -38,14 +64,13 @@ void AfeAudioProcessor::Initialize(AudioCodec* codec) {
         afe_config->ns_init = true;
         afe_config->ns_model_name = ns_model_name;
         afe_config->afe_ns_mode = AFE_NS_MODE_NET;
+        ns_initialized_ = true;
     } else {
+        ns_initialized_ = false;
         afe_config->ns_init = false;
     }
 
-    afe_config->afe_perferred_core = 1;
-    afe_config->afe_perferred_priority = 1;
     afe_config->agc_init = false;
-    afe_config->memory_alloc_mode = AFE_MEMORY_ALLOC_MORE_PSRAM;
 
 #ifdef CONFIG_USE_DEVICE_AEC
     afe_config->aec_init = true;
@@ -57,51 +82,126 @@ void AfeAudioProcessor::Initialize(AudioCodec* codec) {
 
     afe_iface_ = esp_afe_handle_from_config(afe_config);
     afe_data_ = afe_iface_->create_from_config(afe_config);
-    
-    xTaskCreate([](void* arg) {
-        auto this_ = (AfeAudioProcessor*)arg;
-        this_->AudioProcessorTask();
-        vTaskDelete(NULL);
-    }, "audio_communication", 4096, this, 3, NULL);
+    afe_config_free(afe_config);
+    if (afe_data_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to create AFE");
+        if (models_ != nullptr) {
+            SrModels::Release();
+            models_ = nullptr;
+        }
+        return false;
+    }
+    if (device_aec_enabled_ != DEVICE_AEC_DEFAULT) {
+        ApplyDeviceAec();
+    }
+    if (reduced_processing_) {
+        ApplyReducedProcessing();
+    }
+    ESP_LOGI(TAG, "AFE created in %ld ms, free PSRAM: %u KB", (long)((esp_timer_get_time() - start_time) / 1000),
+        heap_caps_get_free_size(MALLOC_CAP_SPIRAM) / 1024);
+
+    if (task_handle_ == nullptr) {
+        auto& spec = TaskManifest::GetInstance().Get(kTaskAudioProcessor);
+        xTaskCreatePinnedToCore([](void* arg) {
+            auto this_ = (AfeAudioProcessor*)arg;
+            this_->AudioProcessorTask();
+            vTaskDelete(NULL);
+        }, spec.name, spec.stack_size, this, spec.priority, &task_handle_, spec.core);
+    }
+    return true;
+}
+
+// 调用者需要持有 afe_mutex_
+void AfeAudioProcessor::DestroyAfe() {
+    if (afe_data_ == nullptr) {
+        return;
+    }
+    afe_iface_->destroy(afe_data_);
+    afe_data_ = nullptr;
+    is_speaking_ = false;
+    if (models_ != nullptr) {
+        SrModels::Release();
+        models_ = nullptr;
+    }
+    ESP_LOGI(TAG, "AFE released, free PSRAM: %u KB", heap_caps_get_free_size(MALLOC_CAP_SPIRAM) / 1024);
 }
 
 AfeAudioProcessor::~AfeAudioProcessor() {
-    if (afe_data_ != nullptr) {
-        afe_iface_->destroy(afe_data_);
+    {
+        std::lock_guard<std::mutex> lock(afe_mutex_);
+        DestroyAfe();
     }
     vEventGroupDelete(event_group_);
 }
 
 size_t AfeAudioProcessor::GetFeedSize() {
+    if (front_end_ != nullptr) {
+        return front_end_->GetFeedSize();
+    }
+    std::lock_guard<std::mutex> lock(afe_mutex_);
     if (afe_data_ == nullptr) {
         return 0;
     }
     return afe_iface_->get_feed_chunksize(afe_data_) * codec_->input_channels();
 }
 
-void AfeAudioProcessor::Feed(const std::vector<int16_t>& data) {
+void AfeAudioProcessor::Feed(std::span<const int16_t> data) {
+    if (front_end_ != nullptr) {
+        front_end_->Feed(data);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(afe_mutex_);
     if (afe_data_ == nullptr) {
         return;
     }
+    int64_t feed_start = esp_timer_get_time();
     afe_iface_->feed(afe_data_, data.data());
+    cpu_meter_.OnFeed(esp_timer_get_time() - feed_start);
 }
 
 void AfeAudioProcessor::Start() {
+    if (front_end_ != nullptr) {
+        is_speaking_ = false;
+        front_end_->Enable(kAfeConsumerVoice, true);
+        return;
+    }
+    // 持有锁设置运行标志，处理任务检查标志后才会释放 AFE
+    std::lock_guard<std::mutex> lock(afe_mutex_);
+    if (afe_data_ == nullptr && !CreateAfe()) {
+        return;
+    }
+    xEventGroupClearBits(event_group_, PROCESSOR_RELEASE);
     xEventGroupSetBits(event_group_, PROCESSOR_RUNNING);
 }
 
 void AfeAudioProcessor::Stop() {
+    if (front_end_ != nullptr) {
+        front_end_->Enable(kAfeConsumerVoice, false);
+        return;
+    }
     xEventGroupClearBits(event_group_, PROCESSOR_RUNNING);
-    if (afe_data_ != nullptr) {
-        afe_iface_->reset_buffer(afe_data_);
+    std::lock_guard<std::mutex> lock(afe_mutex_);
+    if (afe_data_ == nullptr) {
+        return;
+    }
+    afe_iface_->reset_buffer(afe_data_);
+
+#if CONFIG_AUDIO_PROCESSOR_RELEASE_FREE_KB > 0
+    // 处理任务可能还在 fetch，由它在退出 fetch 后释放
+    if (heap_caps_get_free_size(MALLOC_CAP_SPIRAM) < CONFIG_AUDIO_PROCESSOR_RELEASE_FREE_KB * 1024) {
+        xEventGroupSetBits(event_group_, PROCESSOR_RELEASE);
     }
+#endif
 }
 
 bool AfeAudioProcessor::IsRunning() {
+    if (front_end_ != nullptr) {
+        return front_end_->IsEnabled(kAfeConsumerVoice);
+    }
     return xEventGroupGetBits(event_group_) & PROCESSOR_RUNNING;
 }
 
-void AfeAudioProcessor::OnOutput(std::function<void(std::vector<int16_t>&& data)> callback) {
+void AfeAudioProcessor::OnOutput(std::function<void(std::span<const int16_t> data)> callback) {
     output_callback_ = callback;
 }
 
@@ -110,15 +210,25 @@ void AfeAudioProcessor::OnVadStateChange(std::function<void(bool speaking)> call
 }
 
 void AfeAudioProcessor::AudioProcessorTask() {
-    auto fetch_size = afe_iface_->get_fetch_chunksize(afe_data_);
-    auto feed_size = afe_iface_->get_feed_chunksize(afe_data_);
     ESP_LOGI(TAG, "Audio communication task started, feed size: %d fetch size: %d",
-        feed_size, fetch_size);
+        afe_iface_->get_feed_chunksize(afe_data_), afe_iface_->get_fetch_chunksize(afe_data_));
 
     while (true) {
-        xEventGroupWaitBits(event_group_, PROCESSOR_RUNNING, pdFALSE, pdTRUE, portMAX_DELAY);
+        auto bits = xEventGroupWaitBits(event_group_, PROCESSOR_RUNNING | PROCESSOR_RELEASE, pdFALSE, pdFALSE, portMAX_DELAY);
+        if ((bits & PROCESSOR_RUNNING) == 0) {
+            // 只有本任务调用 fetch，在这里释放不会和 fetch 冲突
+            std::lock_guard<std::mutex> lock(afe_mutex_);
+            if ((xEventGroupGetBits(event_group_) & PROCESSOR_RUNNING) == 0) {
+                DestroyAfe();
+            }
+            xEventGroupClearBits(event_group_, PROCESSOR_RELEASE);
+            continue;
+        }
 
-        auto res = afe_iface_->fetch_with_delay(afe_data_, portMAX_DELAY);
+        // 停止后不再有新数据，fetch 需要超时返回才能响应释放请求
+        // 包含等待足够的输入数据的时间
+        uint32_t fetch_start_us = AudioTrace::Now();
+        auto res = afe_iface_->fetch_with_delay(afe_data_, pdMS_TO_TICKS(100));
         if ((xEventGroupGetBits(event_group_) & PROCESSOR_RUNNING) == 0) {
             continue;
         }
@@ -128,26 +238,76 @@ void AfeAudioProcessor::AudioProcessorTask() {
             }
             continue;
         }
+        AudioTrace::Record(kAudioTraceAfeFetch, fetch_start_us);
+        cpu_meter_.OnFetch();
+        ProcessResult(res);
+    }
+}
 
-        // VAD state change
-        if (vad_state_change_callback_) {
-            if (res->vad_state == VAD_SPEECH && !is_speaking_) {
-                is_speaking_ = true;
-                vad_state_change_callback_(true);
-            } else if (res->vad_state == VAD_SILENCE && is_speaking_) {
-                is_speaking_ = false;
-                vad_state_change_callback_(false);
-            }
+void AfeAudioProcessor::ProcessResult(const afe_fetch_result_t* res) {
+    // VAD state change
+    if (vad_state_change_callback_) {
+        if (res->vad_state == VAD_SPEECH && !is_speaking_) {
+            is_speaking_ = true;
+            vad_state_change_callback_(true);
+        } else if (res->vad_state == VAD_SILENCE && is_speaking_) {
+            is_speaking_ = false;
+            vad_state_change_callback_(false);
         }
+    }
 
-        if (output_callback_) {
-            output_callback_(std::vector<int16_t>(res->data, res->data + res->data_size / sizeof(int16_t)));
-        }
+    if (output_callback_) {
+        // 直接借出 AFE 的输出缓冲区，下一次 fetch 之前有效
+        output_callback_(std::span<const int16_t>(res->data, res->data_size / sizeof(int16_t)));
     }
 }
 
 void AfeAudioProcessor::EnableDeviceAec(bool enable) {
-    if (enable) {
+    if (front_end_ != nullptr) {
+        // 共用前端有回采时 AEC 一直打开
+        if (enable && !codec_->input_reference()) {
+            ESP_LOGE(TAG, "Device AEC is not supported");
+        }
+        return;
+    }
+    std::lock_guard<std::mutex> lock(afe_mutex_);
+    device_aec_enabled_ = enable;
+    if (afe_data_ != nullptr) {
+        ApplyDeviceAec();
+    }
+}
+
+void AfeAudioProcessor::SetReducedProcessing(bool reduced) {
+    if (front_end_ != nullptr) {
+        // 共用前端的处理由唤醒词一侧决定
+        return;
+    }
+    std::lock_guard<std::mutex> lock(afe_mutex_);
+    if (reduced_processing_ == reduced) {
+        return;
+    }
+    reduced_processing_ = reduced;
+    if (afe_data_ != nullptr) {
+        ApplyReducedProcessing();
+    }
+}
+
+// 调用者需要持有 afe_mutex_
+void AfeAudioProcessor::ApplyReducedProcessing() {
+    if (!ns_initialized_) {
+        return;
+    }
+    if (reduced_processing_) {
+        afe_iface_->disable_ns(afe_data_);
+    } else {
+        afe_iface_->enable_ns(afe_data_);
+    }
+    ESP_LOGI(TAG, "Noise suppression %s", reduced_processing_ ? "disabled" : "enabled");
+}
+
+// 调用者需要持有 afe_mutex_
+void AfeAudioProcessor::ApplyDeviceAec() {
+    if (device_aec_enabled_) {
 #if CONFIG_USE_DEVICE_AEC
         afe_iface_->disable_vad(afe_data_);
         afe_iface_->enable_aec(afe_data_);
@@ -8,36 +8,57 @@
 
 #include <string>
 #include <vector>
+#include <span>
 #include <functional>
+#include <mutex>
 
 #include "audio_processor.h"
 #include "audio_codec.h"
+#include "afe_front_end.h"
+#include "afe_config.h"
 
+// AFE 实例（NS/VAD 网络）在第一次 Start 时创建，内存不足时在 Stop 后释放
+// 传入 front_end 时不创建自己的 AFE，使用与唤醒词共用的前端输出
 class AfeAudioProcessor : public AudioProcessor {
 public:
-    AfeAudioProcessor();
+    explicit AfeAudioProcessor(AfeFrontEnd* front_end = nullptr);
     ~AfeAudioProcessor();
 
     void Initialize(AudioCodec* codec) override;
-    void Feed(const std::vector<int16_t>& data) override;
+    void Feed(std::span<const int16_t> data) override;
     void Start() override;
     void Stop() override;
     bool IsRunning() override;
-    void OnOutput(std::function<void(std::vector<int16_t>&& data)> callback) override;
+    void OnOutput(std::function<void(std::span<const int16_t> data)> callback) override;
     void OnVadStateChange(std::function<void(bool speaking)> callback) override;
     size_t GetFeedSize() override;
     void EnableDeviceAec(bool enable) override;
+    void SetReducedProcessing(bool reduced) override;
 
 private:
     EventGroupHandle_t event_group_ = nullptr;
+    // 保护 afe_data_ 的创建和释放
+    std::mutex afe_mutex_;
     esp_afe_sr_iface_t* afe_iface_ = nullptr;
     esp_afe_sr_data_t* afe_data_ = nullptr;
-    std::function<void(std::vector<int16_t>&& data)> output_callback_;
+    srmodel_list_t* models_ = nullptr;
+    TaskHandle_t task_handle_ = nullptr;
+    std::function<void(std::span<const int16_t> data)> output_callback_;
     std::function<void(bool speaking)> vad_state_change_callback_;
     AudioCodec* codec_ = nullptr;
+    AfeFrontEnd* front_end_ = nullptr;
+    bool device_aec_enabled_ = false;
+    bool ns_initialized_ = false;
+    bool reduced_processing_ = false;
     bool is_speaking_ = false;
+    AfeCpuMeter cpu_meter_;
 
+    bool CreateAfe();
+    void DestroyAfe();
+    void ApplyDeviceAec();
+    void ApplyReducedProcessing();
     void AudioProcessorTask();
+    void ProcessResult(const afe_fetch_result_t* res);
 };
 
-#endif 
\ No newline at end of file
+#endif 
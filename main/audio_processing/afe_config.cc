@@ -0,0 +1,70 @@
+#include "afe_config.h"
+#include "board.h"
+#include "memory_placement.h"
+#include "performance_profile.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define TAG "AfeConfig"
+
+#define AFE_CPU_WINDOW_US (10 * 1000 * 1000)
+// AFE_MEMORY_ALLOC_MORE_INTERNAL 比 MORE_PSRAM 多占用的内部 RAM 估计值
+#define AFE_INTERNAL_EXTRA_BYTES (48 * 1024)
+
+afe_config_t* CreateAfeConfig(AudioCodec* codec, srmodel_list_t* models, afe_type_t type) {
+    auto profile = Board::GetInstance().GetAfeProfile();
+    int low_cost_override = PerformanceProfile::GetInstance().Get(kPerfAfeLowCost, -1);
+    if (low_cost_override >= 0) {
+        profile.mode = low_cost_override ? kAfeProfileLowCost : kAfeProfileHighPerf;
+    }
+    auto input_format = codec->GetInputFormat();
+    bool low_cost = profile.mode == kAfeProfileLowCost;
+    afe_config_t* afe_config = afe_config_init(input_format.c_str(), models, type,
+        low_cost ? AFE_MODE_LOW_COST : AFE_MODE_HIGH_PERF);
+    if (afe_config == nullptr) {
+        return nullptr;
+    }
+    if (type == AFE_TYPE_VC) {
+        afe_config->aec_mode = low_cost ? AEC_MODE_VOIP_LOW_COST : AEC_MODE_VOIP_HIGH_PERF;
+    } else {
+        afe_config->aec_mode = low_cost ? AEC_MODE_SR_LOW_COST : AEC_MODE_SR_HIGH_PERF;
+    }
+    afe_config->se_init = profile.multi_mic_enhancement && afe_config->pcm_config.mic_num > 1;
+    afe_config->afe_perferred_core = profile.preferred_core;
+    afe_config->afe_perferred_priority = profile.preferred_priority;
+    // PSRAM 争用严重时界面刷新会拖慢 AFE，内部 RAM 够用时改用内部 RAM
+    bool internal = profile.prefer_internal_memory ||
+        MemoryPlacement::GetInstance().PreferInternal(kMemoryUseAudio, AFE_INTERNAL_EXTRA_BYTES);
+    afe_config->memory_alloc_mode = internal ? AFE_MEMORY_ALLOC_MORE_INTERNAL : AFE_MEMORY_ALLOC_MORE_PSRAM;
+    ESP_LOGI(TAG, "AFE profile %s, input %s, core %d, %s memory%s", profile.name(), input_format.c_str(),
+        profile.preferred_core, internal ? "internal" : "PSRAM",
+        afe_config->se_init ? ", multi-mic enhancement" : "");
+    return afe_config;
+}
+
+void AfeCpuMeter::OnFetch() {
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    int64_t now = esp_timer_get_time();
+    // 运行时间计数器以 esp_timer 的微秒为单位
+    uint32_t runtime = ulTaskGetRunTimeCounter(xTaskGetCurrentTaskHandle());
+    if (window_start_us_ == 0) {
+        window_start_us_ = now;
+        window_start_runtime_ = runtime;
+        feed_us_ = 0;
+        return;
+    }
+    int64_t elapsed = now - window_start_us_;
+    if (elapsed < AFE_CPU_WINDOW_US) {
+        return;
+    }
+    uint64_t busy = (uint64_t)(runtime - window_start_runtime_) + feed_us_.exchange(0, std::memory_order_relaxed);
+    int percent = busy * 100 / elapsed;
+    gauge_.Set(percent);
+    ESP_LOGD(TAG, "AFE CPU %d%% of one core", percent);
+    window_start_us_ = now;
+    window_start_runtime_ = runtime;
+#endif
+}
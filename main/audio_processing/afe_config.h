@@ -0,0 +1,35 @@
+#ifndef AFE_CONFIG_H
+#define AFE_CONFIG_H
+
+#include <esp_afe_sr_models.h>
+
+#include <atomic>
+#include <cstdint>
+
+#include "audio_codec.h"
+#include "afe_profile.h"
+#include "metrics.h"
+
+// 按板子的 AfeProfile 和 codec 的输入通道布局创建 AFE 配置，AEC 模式按 type 和档位选择
+// 调用方在此基础上设置 NS、VAD 等各自的选项，用完后 afe_config_free
+afe_config_t* CreateAfeConfig(AudioCodec* codec, srmodel_list_t* models, afe_type_t type);
+
+// 统计 AFE 的 CPU 占用：feed 在采集任务中同步计算（含 AEC），按耗时累计；fetch 任务按 FreeRTOS 运行时间累计
+// 每 10 秒把两者之和占单核的百分比写入 gauge，不同档位的开销可以直接对比
+class AfeCpuMeter {
+public:
+    explicit AfeCpuMeter(MetricGauge& gauge) : gauge_(gauge) {}
+
+    // 采集任务中每次 feed 之后调用
+    void OnFeed(uint32_t duration_us) { feed_us_.fetch_add(duration_us, std::memory_order_relaxed); }
+    // fetch 任务中每取到一块结果调用
+    void OnFetch();
+
+private:
+    MetricGauge& gauge_;
+    std::atomic<uint32_t> feed_us_{0};
+    int64_t window_start_us_ = 0;
+    uint32_t window_start_runtime_ = 0;
+};
+
+#endif // AFE_CONFIG_H
@@ -0,0 +1,157 @@
+#include "afe_front_end.h"
+#include "sr_models.h"
+#include "audio_trace.h"
+#include "metrics.h"
+#include "task_manifest.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <freertos/task.h>
+#include <string>
+
+#define TAG "AfeFrontEnd"
+
+static MetricGauge metric_cpu_percent("afe.shared_cpu_percent");
+
+#define CONSUMER_BIT(consumer) (1 << (consumer))
+#define CONSUMER_ALL ((1 << kAfeConsumerCount) - 1)
+
+AfeFrontEnd::AfeFrontEnd() : cpu_meter_(metric_cpu_percent) {
+    event_group_ = xEventGroupCreate();
+}
+
+AfeFrontEnd::~AfeFrontEnd() {
+    if (afe_data_ != nullptr) {
+        afe_iface_->destroy(afe_data_);
+    }
+    if (models_ != nullptr) {
+        SrModels::Release();
+    }
+    vEventGroupDelete(event_group_);
+}
+
+bool AfeFrontEnd::Initialize(AudioCodec* codec) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (codec_ != nullptr) {
+        return afe_data_ != nullptr;
+    }
+    codec_ = codec;
+    auto start_time = esp_timer_get_time();
+    models_ = SrModels::Acquire();
+    if (models_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to load models");
+        return false;
+    }
+
+    // SR 类型带 WakeNet，输出的音频同时给通话使用
+    // 有回采时 AEC 一直打开，说话时的唤醒词检测也需要它，AEC 用识别模式
+    afe_config_t* afe_config = CreateAfeConfig(codec_, models_, AFE_TYPE_SR);
+    if (afe_config == nullptr) {
+        ESP_LOGE(TAG, "Failed to create AFE config");
+        return false;
+    }
+    afe_config->aec_init = codec_->input_reference();
+    afe_config->vad_init = true;
+    afe_config->vad_mode = VAD_MODE_0;
+    afe_config->vad_min_noise_ms = 100;
+    char* vad_model_name = esp_srmodel_filter(models_, ESP_VADN_PREFIX, NULL);
+    if (vad_model_name != nullptr) {
+        afe_config->vad_model_name = vad_model_name;
+    }
+    char* ns_model_name = esp_srmodel_filter(models_, ESP_NSNET_PREFIX, NULL);
+    if (ns_model_name != nullptr) {
+        afe_config->ns_init = true;
+        afe_config->ns_model_name = ns_model_name;
+        afe_config->afe_ns_mode = AFE_NS_MODE_NET;
+    }
+    afe_config->agc_init = false;
+
+    afe_iface_ = esp_afe_handle_from_config(afe_config);
+    afe_data_ = afe_iface_->create_from_config(afe_config);
+    afe_config_free(afe_config);
+    if (afe_data_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to create AFE");
+        return false;
+    }
+    ESP_LOGI(TAG, "Shared AFE created in %ld ms, free PSRAM: %u KB", (long)((esp_timer_get_time() - start_time) / 1000),
+        heap_caps_get_free_size(MALLOC_CAP_SPIRAM) / 1024);
+
+#if CONFIG_WAKE_WORD_PREROLL_ENCODE_CONTINUOUS
+    // 唤醒词的 Opus 编码在回调里执行，需要较大的栈
+    const uint32_t stack_size = 4096 * 8;
+#elif CONFIG_WAKE_WORD_VERIFY
+    // 唤醒词的第二级确认在回调里运行
+    const uint32_t stack_size = 4096 * 2;
+#else
+    const uint32_t stack_size = 4096;
+#endif
+    auto& spec = TaskManifest::GetInstance().Get(kTaskAudioFrontEnd);
+    xTaskCreatePinnedToCore([](void* arg) {
+        auto this_ = (AfeFrontEnd*)arg;
+        this_->FetchTask();
+        vTaskDelete(NULL);
+    }, spec.name, stack_size, this, spec.priority, nullptr, spec.core);
+    return true;
+}
+
+size_t AfeFrontEnd::GetFeedSize() {
+    if (afe_data_ == nullptr) {
+        return 0;
+    }
+    return afe_iface_->get_feed_chunksize(afe_data_) * codec_->input_channels();
+}
+
+void AfeFrontEnd::Feed(std::span<const int16_t> data) {
+    if (afe_data_ == nullptr || (xEventGroupGetBits(event_group_) & CONSUMER_ALL) == 0) {
+        return;
+    }
+    int64_t feed_start = esp_timer_get_time();
+    afe_iface_->feed(afe_data_, data.data());
+    cpu_meter_.OnFeed(esp_timer_get_time() - feed_start);
+}
+
+void AfeFrontEnd::Enable(AfeConsumer consumer, bool enable) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (enable) {
+        xEventGroupSetBits(event_group_, CONSUMER_BIT(consumer));
+        return;
+    }
+    auto bits = xEventGroupClearBits(event_group_, CONSUMER_BIT(consumer));
+    // 最后一个使用方停止时才清空缓冲区，下次开始不会拿到旧的音频
+    if ((bits & CONSUMER_ALL & ~CONSUMER_BIT(consumer)) == 0 && afe_data_ != nullptr) {
+        afe_iface_->reset_buffer(afe_data_);
+    }
+}
+
+bool AfeFrontEnd::IsEnabled(AfeConsumer consumer) {
+    return xEventGroupGetBits(event_group_) & CONSUMER_BIT(consumer);
+}
+
+void AfeFrontEnd::OnResult(AfeConsumer consumer, std::function<void(const afe_fetch_result_t* res)> callback) {
+    callbacks_[consumer] = callback;
+}
+
+void AfeFrontEnd::FetchTask() {
+    ESP_LOGI(TAG, "Front end task started, feed size: %d fetch size: %d",
+        afe_iface_->get_feed_chunksize(afe_data_), afe_iface_->get_fetch_chunksize(afe_data_));
+
+    while (true) {
+        xEventGroupWaitBits(event_group_, CONSUMER_ALL, pdFALSE, pdFALSE, portMAX_DELAY);
+        // 所有使用方都停止后不再有新数据，fetch 需要超时返回
+        uint32_t fetch_start_us = AudioTrace::Now();
+        auto res = afe_iface_->fetch_with_delay(afe_data_, pdMS_TO_TICKS(100));
+        if (res == nullptr || res->ret_value == ESP_FAIL) {
+            continue;
+        }
+        AudioTrace::Record(kAudioTraceAfeFetch, fetch_start_us);
+        cpu_meter_.OnFetch();
+
+        auto bits = xEventGroupGetBits(event_group_);
+        for (int i = 0; i < kAfeConsumerCount; i++) {
+            if ((bits & CONSUMER_BIT(i)) && callbacks_[i]) {
+                callbacks_[i](res);
+            }
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef AFE_FRONT_END_H
+#define AFE_FRONT_END_H
+
+#include <esp_afe_sr_models.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+
+#include <span>
+#include <mutex>
+#include <functional>
+
+#include "audio_codec.h"
+#include "afe_config.h"
+
+// 使用前端输出的一方
+enum AfeConsumer {
+    kAfeConsumerWakeWord,
+    kAfeConsumerVoice,
+    kAfeConsumerCount
+};
+
+// 唤醒词和语音通话共用的 AFE 实例（CONFIG_USE_SHARED_AFE）
+// 一次喂入、一套 AEC/NS/VAD，同一个 fetch 任务把每块结果分给启用的使用方
+// 只要还有一方在用就不重置缓冲区，聆听和说话状态切换时前端保持运行，切换后紧接着的语音不会丢
+class AfeFrontEnd {
+public:
+    AfeFrontEnd();
+    ~AfeFrontEnd();
+
+    // 两个使用方都会调用，只有第一次创建 AFE
+    bool Initialize(AudioCodec* codec);
+    void Feed(std::span<const int16_t> data);
+    // 交错后的采样数，AFE 创建失败时为 0
+    size_t GetFeedSize();
+    void Enable(AfeConsumer consumer, bool enable);
+    bool IsEnabled(AfeConsumer consumer);
+    // 回调在 fetch 任务中执行，res 只在回调期间有效
+    void OnResult(AfeConsumer consumer, std::function<void(const afe_fetch_result_t* res)> callback);
+    // 模型列表由前端持有引用，生命周期与前端相同
+    srmodel_list_t* models() const { return models_; }
+
+private:
+    std::mutex mutex_;
+    EventGroupHandle_t event_group_ = nullptr;
+    esp_afe_sr_iface_t* afe_iface_ = nullptr;
+    esp_afe_sr_data_t* afe_data_ = nullptr;
+    srmodel_list_t* models_ = nullptr;
+    AudioCodec* codec_ = nullptr;
+    std::function<void(const afe_fetch_result_t* res)> callbacks_[kAfeConsumerCount];
+    AfeCpuMeter cpu_meter_;
+
+    void FetchTask();
+};
+
+#endif // AFE_FRONT_END_H
@@ -0,0 +1,39 @@
+#ifndef AFE_PROFILE_H
+#define AFE_PROFILE_H
+
+// AFE 的性能档位，低功耗档位 AEC 和 BSS 使用简化算法，识别率略低但 CPU 占用明显更少
+enum AfeProfileMode {
+    kAfeProfileLowCost,
+    kAfeProfileHighPerf,
+};
+
+// 创建 AFE 时使用的配置，默认值来自 Kconfig，板子可以重写 Board::GetAfeProfile 按实测的 CPU 和识别率调整
+// 不依赖 esp-sr 的头文件，没有 AFE 的板子也可以包含
+struct AfeProfile {
+    AfeProfileMode mode = kAfeProfileHighPerf;
+    // AFE 内部任务（多麦克风的 BSS 等）运行的核和优先级
+    int preferred_core = 1;
+    int preferred_priority = 1;
+    // 优先使用内部 RAM，速度更快但占用宝贵的内部内存
+    bool prefer_internal_memory = false;
+    // 有多个麦克风时启用语音增强（BSS 盲源分离和波束选择），单麦克风时无效
+    bool multi_mic_enhancement = true;
+
+    const char* name() const { return mode == kAfeProfileLowCost ? "low_cost" : "high_perf"; }
+
+    static AfeProfile Default() {
+        AfeProfile profile;
+#if CONFIG_AFE_PROFILE_LOW_COST
+        profile.mode = kAfeProfileLowCost;
+#endif
+#ifdef CONFIG_AFE_PREFERRED_CORE
+        profile.preferred_core = CONFIG_AFE_PREFERRED_CORE;
+#endif
+#if CONFIG_AFE_PREFER_INTERNAL_MEMORY
+        profile.prefer_internal_memory = true;
+#endif
+        return profile;
+    }
+};
+
+#endif // AFE_PROFILE_H
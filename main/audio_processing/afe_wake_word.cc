@@ -1,19 +1,37 @@
 #include "afe_wake_word.h"
 #include "application.h"
+#include "sr_models.h"
+#include "heap_accounting.h"
+#include "metrics.h"
+#include "task_manifest.h"
+#include "signal_levels.h"
+#include "pcm_kernels.h"
 
 #include <esp_log.h>
 #include <model_path.h>
 #include <arpa/inet.h>
 #include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
 
 #define DETECTION_RUNNING_EVENT 1
 
 #define TAG "AfeWakeWord"
 
-AfeWakeWord::AfeWakeWord()
-    : afe_data_(nullptr),
-      wake_word_pcm_(),
-      wake_word_opus_() {
+static MetricGauge metric_cpu_percent("afe.wake_cpu_percent");
+
+#if CONFIG_WAKE_WORD_ENERGY_GATE
+// 低于这个均方值（约 -60 dBFS）的输入不会打开门控，避免在很安静的环境中被底噪触发
+#define GATE_MIN_ENERGY 1000.0f
+
+static MetricCounter metric_gate_opens("wake_word.gate_opens");
+static MetricCounter metric_gate_chunks("wake_word.gate_chunks");
+static MetricCounter metric_gate_open_chunks("wake_word.gate_open_chunks");
+#endif
+
+AfeWakeWord::AfeWakeWord(AfeFrontEnd* front_end)
+    : afe_data_(nullptr), front_end_(front_end), cpu_meter_(metric_cpu_percent) {
 
     event_group_ = xEventGroupCreate();
 }
@@ -22,25 +40,39 @@ AfeWakeWord::~AfeWakeWord() {
     if (afe_data_ != nullptr) {
         afe_iface_->destroy(afe_data_);
     }
+    if (models_ != nullptr) {
+        SrModels::Release();
+    }
 
+#if !CONFIG_WAKE_WORD_PREROLL_ENCODE_CONTINUOUS
     if (wake_word_encode_task_stack_ != nullptr) {
-        heap_caps_free(wake_word_encode_task_stack_);
+        HeapAccounting::Free(kHeapTagAudio, wake_word_encode_task_stack_);
+    }
+    if (wake_word_pcm_ != nullptr) {
+        HeapAccounting::Free(kHeapTagAudio, wake_word_pcm_);
     }
+#endif
 
     vEventGroupDelete(event_group_);
 }
 
 void AfeWakeWord::Initialize(AudioCodec* codec) {
     codec_ = codec;
-    int ref_num = codec_->input_reference() ? 1 : 0;
 
-    srmodel_list_t *models = esp_srmodel_init("model");
-    if (models == nullptr || models->num == -1) {
+    // 模型名指向共享的模型列表，一直持有引用
+    srmodel_list_t *models = SrModels::Acquire();
+    if (front_end_ != nullptr) {
+        front_end_->Initialize(codec);
+        front_end_->OnResult(kAfeConsumerWakeWord, [this](const afe_fetch_result_t* res) {
+            ProcessResult(res);
+        });
+    }
+    if (models == nullptr) {
         ESP_LOGE(TAG, "Failed to initialize wakenet model");
         return;
     }
+    models_ = models;
     for (int i = 0; i < models->num; i++) {
-        ESP_LOGI(TAG, "Model %d: %s", i, models->model_name[i]);
         if (strstr(models->model_name[i], ESP_WN_PREFIX) != NULL) {
             wakenet_model_ = models->model_name[i];
             auto words = esp_srmodel_get_wake_words(models, wakenet_model_);
@@ -53,28 +85,62 @@ void AfeWakeWord::Initialize(AudioCodec* codec) {
         }
     }
 
-    std::string input_format;
-    for (int i = 0; i < codec_->input_channels() - ref_num; i++) {
-        input_format.push_back('M');
+    if (front_end_ == nullptr) {
+        afe_config_t* afe_config = CreateAfeConfig(codec_, models, AFE_TYPE_SR);
+        if (afe_config == nullptr) {
+            ESP_LOGE(TAG, "Failed to create AFE config");
+            return;
+        }
+        afe_config->aec_init = codec_->input_reference();
+
+        afe_iface_ = esp_afe_handle_from_config(afe_config);
+        afe_data_ = afe_iface_->create_from_config(afe_config);
+    }
+
+#if CONFIG_WAKE_WORD_PREROLL_ENCODE_CONTINUOUS
+    encoder_ = std::make_unique<OpusEncoderWrapper>(16000, 1, OPUS_FRAME_DURATION_MS);
+    encoder_->SetComplexity(0); // 0 is the fastest
+    encode_frame_.reserve(16000 * OPUS_FRAME_DURATION_MS / 1000);
+    opus_slots_.resize(WAKE_WORD_PREROLL_MS / OPUS_FRAME_DURATION_MS);
+    // Opus 编码需要较大的栈
+    const uint32_t detection_stack_size = 4096 * 8;
+#else
+    wake_word_pcm_ = (int16_t*)HeapAccounting::MallocPreferSpiram(kHeapTagAudio, WAKE_WORD_PREROLL_SAMPLES * sizeof(int16_t));
+    if (wake_word_pcm_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate wake word buffer");
+    }
+#if CONFIG_WAKE_WORD_VERIFY
+    if (wakenet_model_ != nullptr) {
+        verifier_.Initialize(wakenet_model_, CONFIG_WAKE_WORD_VERIFY_THRESHOLD);
     }
-    for (int i = 0; i < ref_num; i++) {
-        input_format.push_back('R');
+    // 第二级 WakeNet 在检测回调里运行
+    const uint32_t detection_stack_size = 4096 * 2;
+#else
+    const uint32_t detection_stack_size = 4096;
+#endif
+#endif
+    if (front_end_ != nullptr) {
+        // 检测结果由共用前端的任务回调
+        return;
     }
-    afe_config_t* afe_config = afe_config_init(input_format.c_str(), models, AFE_TYPE_SR, AFE_MODE_HIGH_PERF);
-    afe_config->aec_init = codec_->input_reference();
-    afe_config->aec_mode = AEC_MODE_SR_HIGH_PERF;
-    afe_config->afe_perferred_core = 1;
-    afe_config->afe_perferred_priority = 1;
-    afe_config->memory_alloc_mode = AFE_MEMORY_ALLOC_MORE_PSRAM;
-    
-    afe_iface_ = esp_afe_handle_from_config(afe_config);
-    afe_data_ = afe_iface_->create_from_config(afe_config);
 
-    xTaskCreate([](void* arg) {
+#if CONFIG_WAKE_WORD_ENERGY_GATE
+    if (afe_data_ != nullptr) {
+        int chunk_samples = afe_iface_->get_feed_chunksize(afe_data_);
+        gate_chunk_size_ = chunk_samples * codec_->input_channels();
+        gate_ring_chunks_ = std::max(1, WAKE_WORD_GATE_PREROLL_MS * 16 / chunk_samples);
+        gate_ring_.resize(gate_chunk_size_ * gate_ring_chunks_);
+        ESP_LOGI(TAG, "Energy gate enabled, threshold %d dB, preroll %u chunks",
+            CONFIG_WAKE_WORD_GATE_THRESHOLD_DB, (unsigned)gate_ring_chunks_);
+    }
+#endif
+
+    auto& spec = TaskManifest::GetInstance().Get(kTaskWakeWordDetect);
+    xTaskCreatePinnedToCore([](void* arg) {
         auto this_ = (AfeWakeWord*)arg;
         this_->AudioDetectionTask();
         vTaskDelete(NULL);
-    }, "audio_detection", 4096, this, 3, nullptr);
+    }, spec.name, detection_stack_size, this, spec.priority, nullptr, spec.core);
 }
 
 void AfeWakeWord::OnWakeWordDetected(std::function<void(const std::string& wake_word)> callback) {
@@ -82,10 +148,36 @@ void AfeWakeWord::OnWakeWordDetected(std::function<void(const std::string& wake_
 }
 
 void AfeWakeWord::StartDetection() {
+    if (front_end_ != nullptr) {
+#if CONFIG_WAKE_WORD_PREROLL_ENCODE_CONTINUOUS
+        std::lock_guard<std::mutex> lock(wake_word_mutex_);
+        opus_count_ = 0;
+        opus_read_remaining_ = 0;
+        encoder_reset_pending_ = true;
+#endif
+        front_end_->Enable(kAfeConsumerWakeWord, true);
+        return;
+    }
+#if CONFIG_WAKE_WORD_PREROLL_ENCODE_CONTINUOUS
+    {
+        // 中间有一段时间没有编码，丢弃旧的数据，由检测任务重置编码器
+        std::lock_guard<std::mutex> lock(wake_word_mutex_);
+        opus_count_ = 0;
+        opus_read_remaining_ = 0;
+        encoder_reset_pending_ = true;
+    }
+#endif
+#if CONFIG_WAKE_WORD_ENERGY_GATE
+    gate_reset_pending_ = true;
+#endif
     xEventGroupSetBits(event_group_, DETECTION_RUNNING_EVENT);
 }
 
 void AfeWakeWord::StopDetection() {
+    if (front_end_ != nullptr) {
+        front_end_->Enable(kAfeConsumerWakeWord, false);
+        return;
+    }
     xEventGroupClearBits(event_group_, DETECTION_RUNNING_EVENT);
     if (afe_data_ != nullptr) {
         afe_iface_->reset_buffer(afe_data_);
@@ -93,17 +185,105 @@ void AfeWakeWord::StopDetection() {
 }
 
 bool AfeWakeWord::IsDetectionRunning() {
+    if (front_end_ != nullptr) {
+        return front_end_->IsEnabled(kAfeConsumerWakeWord);
+    }
     return xEventGroupGetBits(event_group_) & DETECTION_RUNNING_EVENT;
 }
 
-void AfeWakeWord::Feed(const std::vector<int16_t>& data) {
+void AfeWakeWord::Feed(std::span<const int16_t> data) {
+    if (front_end_ != nullptr) {
+        front_end_->Feed(data);
+        return;
+    }
     if (afe_data_ == nullptr) {
         return;
     }
+#if CONFIG_WAKE_WORD_ENERGY_GATE
+    if (!EnergyGate(data)) {
+        return;
+    }
+#endif
+    int64_t feed_start = esp_timer_get_time();
     afe_iface_->feed(afe_data_, data.data());
+    cpu_meter_.OnFeed(esp_timer_get_time() - feed_start);
 }
 
+#if CONFIG_WAKE_WORD_ENERGY_GATE
+// 返回 true 表示这一块需要送进 AFE；门控刚打开时先把缓存的输入送进去
+bool AfeWakeWord::EnergyGate(std::span<const int16_t> data) {
+    if (data.size() != gate_chunk_size_) {
+        return true;
+    }
+    if (gate_reset_pending_.exchange(false)) {
+        gate_open_ = false;
+        gate_count_ = 0;
+    }
+
+    // 只看第一路麦克风，采集时已经算过这一块的电平；块大小对不上时（例如测试输入）自己算
+    int channels = codec_->input_channels();
+    size_t frames = data.size() / channels;
+    auto level = SignalLevels::GetInstance().Get(kSignalCapture);
+    float energy;
+    if (level.sequence != 0 && level.samples == frames) {
+        energy = level.energy;
+    } else {
+        pcm::LevelStats stats;
+        pcm::AnalyzeLevel(data.data(), frames, channels, stats);
+        energy = (float)stats.sum_squares / frames;
+    }
+
+    static const float ratio = powf(10.0f, CONFIG_WAKE_WORD_GATE_THRESHOLD_DB / 10.0f);
+    bool loud = energy > std::max(noise_floor_ * ratio, GATE_MIN_ENERGY);
+    // 底噪快降慢升，持续的噪声（风扇等）最终会被当作底噪，门控重新关闭
+    if (noise_floor_ == 0 || energy < noise_floor_) {
+        noise_floor_ += (energy - noise_floor_) / 8;
+    } else {
+        noise_floor_ += (energy - noise_floor_) / 512;
+    }
+
+    metric_gate_chunks.Add();
+    int hold_chunks = WAKE_WORD_GATE_HOLD_MS * 16 / frames;
+    if (gate_open_) {
+        if (loud) {
+            gate_hold_ = hold_chunks;
+        } else if (--gate_hold_ <= 0) {
+            gate_open_ = false;
+            ESP_LOGD(TAG, "Energy gate closed");
+        }
+        if (gate_open_) {
+            metric_gate_open_chunks.Add();
+            return true;
+        }
+    } else if (loud) {
+        gate_open_ = true;
+        gate_hold_ = hold_chunks;
+        metric_gate_opens.Add();
+        metric_gate_open_chunks.Add();
+        ESP_LOGD(TAG, "Energy gate opened, energy %.0f floor %.0f", energy, noise_floor_);
+        // 从最旧的一块开始补送
+        size_t index = (gate_write_index_ + gate_ring_chunks_ - gate_count_) % gate_ring_chunks_;
+        for (size_t i = 0; i < gate_count_; i++) {
+            afe_iface_->feed(afe_data_, gate_ring_.data() + index * gate_chunk_size_);
+            index = (index + 1) % gate_ring_chunks_;
+        }
+        gate_count_ = 0;
+        return true;
+    }
+
+    memcpy(gate_ring_.data() + gate_write_index_ * gate_chunk_size_, data.data(), gate_chunk_size_ * sizeof(int16_t));
+    gate_write_index_ = (gate_write_index_ + 1) % gate_ring_chunks_;
+    if (gate_count_ < gate_ring_chunks_) {
+        gate_count_++;
+    }
+    return false;
+}
+#endif
+
 size_t AfeWakeWord::GetFeedSize() {
+    if (front_end_ != nullptr) {
+        return front_end_->GetFeedSize();
+    }
     if (afe_data_ == nullptr) {
         return 0;
     }
@@ -123,62 +303,155 @@ void AfeWakeWord::AudioDetectionTask() {
         if (res == nullptr || res->ret_value == ESP_FAIL) {
             continue;;
         }
+        cpu_meter_.OnFetch();
+        ProcessResult(res);
+    }
+}
 
-        // Store the wake word data for voice recognition, like who is speaking
-        StoreWakeWordData(res->data, res->data_size / sizeof(int16_t));
+void AfeWakeWord::ProcessResult(const afe_fetch_result_t* res) {
+    // Store the wake word data for voice recognition, like who is speaking
+    StoreWakeWordData(res->data, res->data_size / sizeof(int16_t));
 
-        if (res->wakeup_state == WAKENET_DETECTED) {
-            StopDetection();
-            last_detected_wake_word_ = wake_words_[res->wakenet_model_index - 1];
+    if (res->wakeup_state == WAKENET_DETECTED) {
+#if CONFIG_WAKE_WORD_VERIFY
+        // 确认不通过时继续检测，不通知上层，也就不会打开音频通道
+        size_t start = (pcm_write_pos_ + WAKE_WORD_PREROLL_SAMPLES - pcm_samples_) % WAKE_WORD_PREROLL_SAMPLES;
+        if (wake_word_pcm_ != nullptr && !verifier_.Verify(wake_word_pcm_, WAKE_WORD_PREROLL_SAMPLES, start,
+                pcm_samples_, res->wakenet_model_index)) {
+            return;
+        }
+#endif
+        StopDetection();
+        last_detected_wake_word_ = wake_words_[res->wakenet_model_index - 1];
 
-            if (wake_word_detected_callback_) {
-                wake_word_detected_callback_(last_detected_wake_word_);
-            }
+        if (wake_word_detected_callback_) {
+            wake_word_detected_callback_(last_detected_wake_word_);
+        }
+    }
+}
+
+#if CONFIG_WAKE_WORD_PREROLL_ENCODE_CONTINUOUS
+void AfeWakeWord::StoreWakeWordData(const int16_t* data, size_t samples) {
+    if (encoder_reset_pending_) {
+        encoder_reset_pending_ = false;
+        encoder_->ResetState();
+        encode_frame_.clear();
+    }
+
+    size_t frame_samples = 16000 * OPUS_FRAME_DURATION_MS / 1000;
+    while (samples > 0) {
+        size_t n = std::min(samples, frame_samples - encode_frame_.size());
+        encode_frame_.insert(encode_frame_.end(), data, data + n);
+        data += n;
+        samples -= n;
+        if (encode_frame_.size() < frame_samples) {
+            break;
         }
+
+        encoder_->Encode(std::move(encode_frame_), [this](std::vector<uint8_t>&& opus) {
+            // 覆盖最旧的槽位，复用它的容量
+            std::lock_guard<std::mutex> lock(wake_word_mutex_);
+            opus_slots_[opus_write_index_].assign(opus.begin(), opus.end());
+            opus_write_index_ = (opus_write_index_ + 1) % opus_slots_.size();
+            if (opus_count_ < opus_slots_.size()) {
+                opus_count_++;
+            }
+        });
+        encode_frame_ = std::vector<int16_t>();
+        encode_frame_.reserve(frame_samples);
     }
 }
 
+void AfeWakeWord::EncodeWakeWordData() {
+    // 数据已经编码好，只需要从最旧的包开始读
+    std::lock_guard<std::mutex> lock(wake_word_mutex_);
+    opus_read_index_ = (opus_write_index_ + opus_slots_.size() - opus_count_) % opus_slots_.size();
+    opus_read_remaining_ = opus_count_;
+    opus_count_ = 0;
+    ESP_LOGI(TAG, "Wake word opus %u packets ready", (unsigned)opus_read_remaining_);
+}
+
+bool AfeWakeWord::GetWakeWordOpus(std::vector<uint8_t>& opus) {
+    std::lock_guard<std::mutex> lock(wake_word_mutex_);
+    if (opus_read_remaining_ == 0) {
+        opus.clear();
+        return false;
+    }
+    auto& slot = opus_slots_[opus_read_index_];
+    opus.assign(slot.begin(), slot.end());
+    opus_read_index_ = (opus_read_index_ + 1) % opus_slots_.size();
+    opus_read_remaining_--;
+    return true;
+}
+#else
 void AfeWakeWord::StoreWakeWordData(const int16_t* data, size_t samples) {
-    // store audio data to wake_word_pcm_
-    wake_word_pcm_.emplace_back(std::vector<int16_t>(data, data + samples));
-    // keep about 2 seconds of data, detect duration is 30ms (sample_rate == 16000, chunksize == 512)
-    while (wake_word_pcm_.size() > 2000 / 30) {
-        wake_word_pcm_.pop_front();
+    if (wake_word_pcm_ == nullptr) {
+        return;
+    }
+    // 写入环形缓冲区，保留最近 WAKE_WORD_PREROLL_MS 的数据
+    while (samples > 0) {
+        size_t n = std::min(samples, WAKE_WORD_PREROLL_SAMPLES - pcm_write_pos_);
+        memcpy(wake_word_pcm_ + pcm_write_pos_, data, n * sizeof(int16_t));
+        data += n;
+        samples -= n;
+        pcm_write_pos_ = (pcm_write_pos_ + n) % WAKE_WORD_PREROLL_SAMPLES;
+        pcm_samples_ = std::min<size_t>(pcm_samples_ + n, WAKE_WORD_PREROLL_SAMPLES);
     }
 }
 
 void AfeWakeWord::EncodeWakeWordData() {
     wake_word_opus_.clear();
     if (wake_word_encode_task_stack_ == nullptr) {
-        wake_word_encode_task_stack_ = (StackType_t*)heap_caps_malloc(4096 * 8, MALLOC_CAP_SPIRAM);
+        wake_word_encode_task_stack_ = (StackType_t*)HeapAccounting::Malloc(kHeapTagAudio, 4096 * 8, MALLOC_CAP_SPIRAM);
     }
-    wake_word_encode_task_ = xTaskCreateStatic([](void* arg) {
+    auto& spec = TaskManifest::GetInstance().Get(kTaskWakeWordEncode);
+    wake_word_encode_task_ = xTaskCreateStaticPinnedToCore([](void* arg) {
         auto this_ = (AfeWakeWord*)arg;
         {
             auto start_time = esp_timer_get_time();
             auto encoder = std::make_unique<OpusEncoderWrapper>(16000, 1, OPUS_FRAME_DURATION_MS);
             encoder->SetComplexity(0); // 0 is the fastest
 
+            // 从最旧的样本开始按帧读出环形缓冲区
+            size_t frame_samples = 16000 * OPUS_FRAME_DURATION_MS / 1000;
+            size_t read_pos = (this_->pcm_write_pos_ + WAKE_WORD_PREROLL_SAMPLES - this_->pcm_samples_) % WAKE_WORD_PREROLL_SAMPLES;
+            size_t remaining = this_->pcm_samples_;
             int packets = 0;
-            for (auto& pcm: this_->wake_word_pcm_) {
+            while (remaining > 0) {
+                std::vector<int16_t> pcm(std::min(remaining, frame_samples));
+                for (size_t i = 0; i < pcm.size(); i++) {
+                    pcm[i] = this_->wake_word_pcm_[read_pos];
+                    read_pos = (read_pos + 1) % WAKE_WORD_PREROLL_SAMPLES;
+                }
+                remaining -= pcm.size();
                 encoder->Encode(std::move(pcm), [this_](std::vector<uint8_t>&& opus) {
-                    std::lock_guard<std::mutex> lock(this_->wake_word_mutex_);
-                    this_->wake_word_opus_.emplace_back(std::move(opus));
-                    this_->wake_word_cv_.notify_all();
+                    {
+                        std::lock_guard<std::mutex> lock(this_->wake_word_mutex_);
+                        this_->wake_word_opus_.emplace_back(std::move(opus));
+                        this_->wake_word_cv_.notify_all();
+                    }
+                    if (this_->opus_encoded_callback_) {
+                        this_->opus_encoded_callback_();
+                    }
                 });
                 packets++;
             }
-            this_->wake_word_pcm_.clear();
+            this_->pcm_samples_ = 0;
 
             auto end_time = esp_timer_get_time();
             ESP_LOGI(TAG, "Encode wake word opus %d packets in %ld ms", packets, (long)((end_time - start_time) / 1000));
 
-            std::lock_guard<std::mutex> lock(this_->wake_word_mutex_);
-            this_->wake_word_opus_.push_back(std::vector<uint8_t>());
-            this_->wake_word_cv_.notify_all();
+            {
+                std::lock_guard<std::mutex> lock(this_->wake_word_mutex_);
+                this_->wake_word_opus_.push_back(std::vector<uint8_t>());
+                this_->wake_word_cv_.notify_all();
+            }
+            if (this_->opus_encoded_callback_) {
+                this_->opus_encoded_callback_();
+            }
         }
         vTaskDelete(NULL);
-    }, "encode_detect_packets", 4096 * 8, this, 2, wake_word_encode_task_stack_, &wake_word_encode_task_buffer_);
+    }, spec.name, 4096 * 8, this, spec.priority, wake_word_encode_task_stack_, &wake_word_encode_task_buffer_, spec.core);
 }
 
 bool AfeWakeWord::GetWakeWordOpus(std::vector<uint8_t>& opus) {
@@ -190,3 +463,15 @@ bool AfeWakeWord::GetWakeWordOpus(std::vector<uint8_t>& opus) {
     wake_word_opus_.pop_front();
     return !opus.empty();
 }
+
+WakeWordOpusState AfeWakeWord::TryGetWakeWordOpus(std::vector<uint8_t>& opus) {
+    std::lock_guard<std::mutex> lock(wake_word_mutex_);
+    if (wake_word_opus_.empty()) {
+        return kWakeWordOpusPending;
+    }
+    opus.swap(wake_word_opus_.front());
+    wake_word_opus_.pop_front();
+    // 空包表示编码结束
+    return opus.empty() ? kWakeWordOpusDone : kWakeWordOpusPacket;
+}
+#endif
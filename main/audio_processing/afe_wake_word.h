@@ -7,24 +7,46 @@
 
 #include <esp_afe_sr_models.h>
 #include <esp_nsn_models.h>
+#include <opus_encoder.h>
 
 #include <list>
 #include <string>
 #include <vector>
+#include <span>
 #include <functional>
 #include <mutex>
 #include <condition_variable>
+#include <memory>
+#include <atomic>
 
 #include "audio_codec.h"
 #include "wake_word.h"
+#include "memory_profile.h"
+#include "afe_front_end.h"
+#include "afe_config.h"
+#if CONFIG_WAKE_WORD_VERIFY
+#include "wake_word_verifier.h"
+#endif
+
+// 唤醒词前导音频时长，检测一次的时长为 30ms (sample_rate == 16000, chunksize == 512)
+#define WAKE_WORD_PREROLL_MS MEMORY_PROFILE_WAKE_WORD_PREROLL_MS
+#define WAKE_WORD_PREROLL_SAMPLES (16000 * WAKE_WORD_PREROLL_MS / 1000)
+
+#if CONFIG_WAKE_WORD_ENERGY_GATE
+// 能量门控关闭时缓存的输入时长，门控打开后先送进 AFE，避免丢掉唤醒词的开头
+#define WAKE_WORD_GATE_PREROLL_MS 320
+// 能量降到阈值以下后保持打开的时长，覆盖唤醒词音节之间的停顿
+#define WAKE_WORD_GATE_HOLD_MS 1500
+#endif
 
+// 传入 front_end 时不创建自己的 AFE 和检测任务，使用与通话共用的前端，此时不使用能量门控
 class AfeWakeWord : public WakeWord {
 public:
-    AfeWakeWord();
+    explicit AfeWakeWord(AfeFrontEnd* front_end = nullptr);
     ~AfeWakeWord();
 
     void Initialize(AudioCodec* codec);
-    void Feed(const std::vector<int16_t>& data);
+    void Feed(std::span<const int16_t> data);
     void OnWakeWordDetected(std::function<void(const std::string& wake_word)> callback);
     void StartDetection();
     void StopDetection();
@@ -32,28 +54,71 @@ public:
     size_t GetFeedSize();
     void EncodeWakeWordData();
     bool GetWakeWordOpus(std::vector<uint8_t>& opus);
+#if !CONFIG_WAKE_WORD_PREROLL_ENCODE_CONTINUOUS
+    WakeWordOpusState TryGetWakeWordOpus(std::vector<uint8_t>& opus) override;
+    void OnWakeWordOpusEncoded(std::function<void()> callback) override { opus_encoded_callback_ = callback; }
+#endif
     const std::string& GetLastDetectedWakeWord() const { return last_detected_wake_word_; }
 
 private:
     esp_afe_sr_iface_t* afe_iface_ = nullptr;
     esp_afe_sr_data_t* afe_data_ = nullptr;
+    srmodel_list_t* models_ = nullptr;
     char* wakenet_model_ = NULL;
     std::vector<std::string> wake_words_;
     EventGroupHandle_t event_group_;
     std::function<void(const std::string& wake_word)> wake_word_detected_callback_;
     AudioCodec* codec_ = nullptr;
+    AfeFrontEnd* front_end_ = nullptr;
     std::string last_detected_wake_word_;
+    AfeCpuMeter cpu_meter_;
 
+    std::mutex wake_word_mutex_;
+    std::condition_variable wake_word_cv_;
+#if CONFIG_WAKE_WORD_PREROLL_ENCODE_CONTINUOUS
+    // 检测期间持续编码，最近的 Opus 包保存在环形槽位中，检测到唤醒词后可以直接发送
+    std::unique_ptr<OpusEncoderWrapper> encoder_;
+    std::vector<int16_t> encode_frame_;
+    std::vector<std::vector<uint8_t>> opus_slots_;
+    size_t opus_write_index_ = 0;
+    size_t opus_count_ = 0;
+    size_t opus_read_index_ = 0;
+    size_t opus_read_remaining_ = 0;
+    bool encoder_reset_pending_ = false;
+#else
+    // 固定大小的 PCM 环形缓冲区，检测到唤醒词后再集中编码
     TaskHandle_t wake_word_encode_task_ = nullptr;
     StaticTask_t wake_word_encode_task_buffer_;
     StackType_t* wake_word_encode_task_stack_ = nullptr;
-    std::list<std::vector<int16_t>> wake_word_pcm_;
+    int16_t* wake_word_pcm_ = nullptr;
+    size_t pcm_write_pos_ = 0;
+    size_t pcm_samples_ = 0;
     std::list<std::vector<uint8_t>> wake_word_opus_;
-    std::mutex wake_word_mutex_;
-    std::condition_variable wake_word_cv_;
+    std::function<void()> opus_encoded_callback_;
+#endif
+#if CONFIG_WAKE_WORD_VERIFY
+    WakeWordVerifier verifier_;
+#endif
+
+#if CONFIG_WAKE_WORD_ENERGY_GATE
+    // 待机安静时不运行 AFE 和 WakeNet，只在 Feed 中计算麦克风能量
+    // 以下状态只在 Feed 所在的任务中访问
+    std::vector<int16_t> gate_ring_;
+    size_t gate_chunk_size_ = 0;
+    size_t gate_ring_chunks_ = 0;
+    size_t gate_write_index_ = 0;
+    size_t gate_count_ = 0;
+    bool gate_open_ = false;
+    int gate_hold_ = 0;
+    float noise_floor_ = 0;
+    std::atomic<bool> gate_reset_pending_{true};
+
+    bool EnergyGate(std::span<const int16_t> data);
+#endif
 
     void StoreWakeWordData(const int16_t* data, size_t size);
     void AudioDetectionTask();
+    void ProcessResult(const afe_fetch_result_t* res);
 };
 
 #endif
@@ -2,16 +2,60 @@
 #include "sdkconfig.h"
 
 #if CONFIG_USE_AUDIO_DEBUGGER
+#include "pcm_kernels.h"
+#include "async_log.h"
+
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <errno.h>
+#include <algorithm>
 #include <cstring>
 #include <string>
 #endif
 
 #define TAG "AudioDebugger"
 
+/*
+ * 数据报格式（小端）:
+ * |magic "XZDB" 4|version 1u|reserved 1u|record_count 2u|sequence 4u|records...
+ * 每条记录:
+ * |type 1u|channel 1u|length 2u|timestamp_us 4u|sequence 4u|sample_rate 4u|payload length|
+ * type 1 为 16 位 PCM，sequence 是该通道之前已发送的采样数，timestamp_us 是第一个采样的时间
+ * type 2 为事件，payload 是事件名，sequence 是事件序号，sample_rate 为 0
+ */
+#define AUDIO_DEBUG_MTU 1400
+#define AUDIO_DEBUG_VERSION 1
+#define AUDIO_DEBUG_RECORD_PCM 1
+#define AUDIO_DEBUG_RECORD_EVENT 2
+// 数据报最多攒这么久就发出，空闲时事件不会积压太久
+#define AUDIO_DEBUG_MAX_DELAY_US 40000
+
+#if CONFIG_USE_AUDIO_DEBUGGER
+namespace {
+
+struct __attribute__((packed)) DatagramHeader {
+    char magic[4];
+    uint8_t version;
+    uint8_t reserved;
+    uint16_t record_count;
+    uint32_t sequence;
+};
+
+struct __attribute__((packed)) RecordHeader {
+    uint8_t type;
+    uint8_t channel;
+    uint16_t length;
+    uint32_t timestamp_us;
+    uint32_t sequence;
+    uint32_t sample_rate;
+};
+
+constexpr size_t kMaxPayload = (AUDIO_DEBUG_MTU - sizeof(DatagramHeader) - sizeof(RecordHeader)) & ~size_t(1);
+
+} // namespace
+#endif
 
 AudioDebugger::AudioDebugger() {
 #if CONFIG_USE_AUDIO_DEBUGGER
@@ -39,30 +83,121 @@ AudioDebugger::AudioDebugger() {
     } else {
         ESP_LOGW(TAG, "Failed to create UDP socket: %d", errno);
     }
+    datagram_.reserve(AUDIO_DEBUG_MTU);
 #endif
 }
 
 AudioDebugger::~AudioDebugger() {
 #if CONFIG_USE_AUDIO_DEBUGGER
     if (udp_sockfd_ >= 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        SendDatagram();
         close(udp_sockfd_);
         ESP_LOGI(TAG, "Closed UDP socket");
     }
 #endif
 }
 
-void AudioDebugger::Feed(const std::vector<int16_t>& data) {
+void AudioDebugger::Feed(std::span<const int16_t> data, int channels, int sample_rate) {
 #if CONFIG_USE_AUDIO_DEBUGGER
-    if (udp_sockfd_ >= 0) {
-        ssize_t sent = sendto(udp_sockfd_, data.data(), data.size() * sizeof(int16_t), 0,
-                             (struct sockaddr*)&udp_server_addr_, sizeof(udp_server_addr_));
-        if (sent < 0) {
-            ESP_LOGW(TAG, "Failed to send audio data to %s: %d", CONFIG_AUDIO_DEBUG_UDP_SERVER, errno);
-        } else {
-            ESP_LOGD(TAG, "Sent %d bytes audio data to %s", sent, CONFIG_AUDIO_DEBUG_UDP_SERVER);
-        }
+    if (udp_sockfd_ < 0) {
+        return;
+    }
+    uint32_t now = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (channels != 2) {
+        WritePcm(kAudioDebugMic, data.data(), data.size(), sample_rate, now);
+        return;
+    }
+    size_t frames = data.size() / 2;
+    mic_buffer_.resize(frames);
+    reference_buffer_.resize(frames);
+    pcm::Deinterleave(data.data(), mic_buffer_.data(), reference_buffer_.data(), frames);
+    WritePcm(kAudioDebugMic, mic_buffer_.data(), frames, sample_rate, now);
+    WritePcm(kAudioDebugReference, reference_buffer_.data(), frames, sample_rate, now);
+#endif
+}
+
+void AudioDebugger::Write(AudioDebugChannel channel, std::span<const int16_t> pcm, int sample_rate) {
+#if CONFIG_USE_AUDIO_DEBUGGER
+    if (udp_sockfd_ < 0 || channel >= kAudioDebugEvents) {
+        return;
+    }
+    uint32_t now = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(mutex_);
+    WritePcm(channel, pcm.data(), pcm.size(), sample_rate, now);
+#endif
+}
+
+void AudioDebugger::Event(const char* name) {
+#if CONFIG_USE_AUDIO_DEBUGGER
+    if (udp_sockfd_ < 0) {
+        return;
     }
+    uint32_t now = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(mutex_);
+    Append(AUDIO_DEBUG_RECORD_EVENT, kAudioDebugEvents, now, events_sent_++, 0, name, strnlen(name, 63));
 #endif
 }
 
- 
\ No newline at end of file
+// 调用者需要持有 mutex_，now 是最后一个采样的时间
+void AudioDebugger::WritePcm(AudioDebugChannel channel, const int16_t* pcm, size_t samples, int sample_rate, uint32_t now) {
+#if CONFIG_USE_AUDIO_DEBUGGER
+    if (sample_rate <= 0) {
+        return;
+    }
+    size_t offset = 0;
+    while (offset < samples) {
+        size_t count = std::min(samples - offset, kMaxPayload / sizeof(int16_t));
+        uint32_t timestamp = now - (uint64_t)(samples - offset) * 1000000 / sample_rate;
+        Append(AUDIO_DEBUG_RECORD_PCM, channel, timestamp, samples_sent_[channel], sample_rate,
+            pcm + offset, count * sizeof(int16_t));
+        samples_sent_[channel] += count;
+        offset += count;
+    }
+#endif
+}
+
+// 调用者需要持有 mutex_
+void AudioDebugger::Append(uint8_t type, AudioDebugChannel channel, uint32_t timestamp_us, uint32_t sequence,
+        uint32_t sample_rate, const void* payload, size_t size) {
+#if CONFIG_USE_AUDIO_DEBUGGER
+    if (!datagram_.empty() && datagram_.size() + sizeof(RecordHeader) + size > AUDIO_DEBUG_MTU) {
+        SendDatagram();
+    }
+    if (datagram_.empty()) {
+        DatagramHeader header = {{'X', 'Z', 'D', 'B'}, AUDIO_DEBUG_VERSION, 0, 0, datagram_sequence_++};
+        auto bytes = reinterpret_cast<const uint8_t*>(&header);
+        datagram_.insert(datagram_.end(), bytes, bytes + sizeof(header));
+        datagram_start_us_ = esp_timer_get_time();
+    }
+
+    RecordHeader record = {type, channel, (uint16_t)size, timestamp_us, sequence, sample_rate};
+    auto bytes = reinterpret_cast<const uint8_t*>(&record);
+    datagram_.insert(datagram_.end(), bytes, bytes + sizeof(record));
+    bytes = reinterpret_cast<const uint8_t*>(payload);
+    datagram_.insert(datagram_.end(), bytes, bytes + size);
+    reinterpret_cast<DatagramHeader*>(datagram_.data())->record_count++;
+
+    if ((uint32_t)esp_timer_get_time() - datagram_start_us_ >= AUDIO_DEBUG_MAX_DELAY_US) {
+        SendDatagram();
+    }
+#endif
+}
+
+// 调用者需要持有 mutex_
+void AudioDebugger::SendDatagram() {
+#if CONFIG_USE_AUDIO_DEBUGGER
+    if (datagram_.empty()) {
+        return;
+    }
+    ssize_t sent = sendto(udp_sockfd_, datagram_.data(), datagram_.size(), 0,
+                         (struct sockaddr*)&udp_server_addr_, sizeof(udp_server_addr_));
+    if (sent < 0) {
+        LOGW_LIMITED(TAG, 1000, "Failed to send debug data to %s: %d", CONFIG_AUDIO_DEBUG_UDP_SERVER, errno);
+    } else {
+        LOGD_LIMITED(TAG, 1000, "Sent %d bytes debug data to %s", sent, CONFIG_AUDIO_DEBUG_UDP_SERVER);
+    }
+    datagram_.clear();
+#endif
+}
@@ -2,21 +2,54 @@
 #define AUDIO_DEBUGGER_H
 
 #include <vector>
+#include <span>
+#include <mutex>
 #include <cstdint>
 
 #include <sys/socket.h>
 #include <netinet/in.h>
 
+// 调试数据流中的通道，scripts/audio_debug_server.py 按通道拆成多轨 WAV
+enum AudioDebugChannel : uint8_t {
+    kAudioDebugMic,
+    kAudioDebugReference,
+    kAudioDebugAfeOutput,
+    kAudioDebugTts,
+    kAudioDebugPlayback,    // 混音后送给 codec 的输出
+    kAudioDebugEvents,
+};
+
+// 通过 UDP 把音频和时间事件发送到 CONFIG_AUDIO_DEBUG_UDP_SERVER，离线对齐分析 AEC 和延迟
+// 每条记录带类型、通道、时间戳和序号，多条记录合并成不超过 MTU 的数据报，格式见 audio_debugger.cc
+// 可以在任何任务中调用，CONFIG_USE_AUDIO_DEBUGGER 关闭时所有调用都是空操作
 class AudioDebugger {
 public:
     AudioDebugger();
     ~AudioDebugger();
 
-    void Feed(const std::vector<int16_t>& data);
+    // 麦克风输入，双声道时是交错的麦克风和参考信号
+    void Feed(std::span<const int16_t> data, int channels = 1, int sample_rate = 16000);
+    void Write(AudioDebugChannel channel, std::span<const int16_t> pcm, int sample_rate);
+    // name 最长 63 字节
+    void Event(const char* name);
 
 private:
     int udp_sockfd_ = -1;
     struct sockaddr_in udp_server_addr_;
+
+    std::mutex mutex_;
+    std::vector<uint8_t> datagram_;
+    uint32_t datagram_sequence_ = 0;
+    uint32_t datagram_start_us_ = 0;
+    uint32_t samples_sent_[kAudioDebugEvents] = {};
+    uint32_t events_sent_ = 0;
+    std::vector<int16_t> mic_buffer_;
+    std::vector<int16_t> reference_buffer_;
+
+    void WritePcm(AudioDebugChannel channel, const int16_t* pcm, size_t samples, int sample_rate, uint32_t now);
+    void Append(uint8_t type, AudioDebugChannel channel, uint32_t timestamp_us, uint32_t sequence,
+        uint32_t sample_rate, const void* payload, size_t size);
+    void SendDatagram();
 };
 
-#endif 
\ No newline at end of file
+#endif
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <vector>
+#include <span>
 #include <functional>
 
 #include "audio_codec.h"
@@ -12,14 +13,17 @@ public:
     virtual ~AudioProcessor() = default;
     
     virtual void Initialize(AudioCodec* codec) = 0;
-    virtual void Feed(const std::vector<int16_t>& data) = 0;
+    virtual void Feed(std::span<const int16_t> data) = 0;
     virtual void Start() = 0;
     virtual void Stop() = 0;
     virtual bool IsRunning() = 0;
-    virtual void OnOutput(std::function<void(std::vector<int16_t>&& data)> callback) = 0;
+    // data 指向处理器内部的输出缓冲区，只在回调期间有效，需要保留时由调用方复制
+    virtual void OnOutput(std::function<void(std::span<const int16_t> data)> callback) = 0;
     virtual void OnVadStateChange(std::function<void(bool speaking)> callback) = 0;
     virtual size_t GetFeedSize() = 0;
     virtual void EnableDeviceAec(bool enable) = 0;
+    // 过热或 CPU 紧张时关闭开销大的处理（例如神经网络降噪），恢复时重新打开
+    virtual void SetReducedProcessing(bool reduced) {}
 };
 
 #endif
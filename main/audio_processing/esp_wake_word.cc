@@ -1,56 +1,195 @@
 #include "esp_wake_word.h"
 #include "application.h"
+#include "sr_models.h"
+#include "task_stack.h"
+#include "metrics.h"
 
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <model_path.h>
 #include <arpa/inet.h>
+#include <cstring>
 #include <sstream>
+#if CONFIG_USE_ESP_WAKE_WORD_COMMANDS
+#include <esp_mn_models.h>
+#include <esp_mn_speech_commands.h>
+#endif
 
 #define DETECTION_RUNNING_EVENT 1
 
 #define TAG "EspWakeWord"
 
+// 检测任务落后太多，环形队列满了丢掉的帧
+static MetricCounter metric_dropped("wake_word.dropped_frames");
+static MetricCounter metric_commands("wake_word.commands");
+static MetricHistogram metric_detect_us("wake_word.detect_us", METRIC_DURATION_US_BOUNDS);
+
+#if CONFIG_USE_ESP_WAKE_WORD_COMMANDS
+struct CommandPhrase {
+    LocalCommand command;
+    const char* phrase;
+};
+
+// 中文模型用拼音，英文模型用单词，同一个命令可以有多种说法
+static const CommandPhrase kChineseCommands[] = {
+    {kLocalCommandVolumeUp, "yin liang da yi dian"},
+    {kLocalCommandVolumeUp, "zeng da yin liang"},
+    {kLocalCommandVolumeDown, "yin liang xiao yi dian"},
+    {kLocalCommandVolumeDown, "jian xiao yin liang"},
+    {kLocalCommandStop, "ting zhi"},
+    {kLocalCommandStop, "bie shuo le"},
+};
+
+static const CommandPhrase kEnglishCommands[] = {
+    {kLocalCommandVolumeUp, "volume up"},
+    {kLocalCommandVolumeUp, "turn up the volume"},
+    {kLocalCommandVolumeDown, "volume down"},
+    {kLocalCommandVolumeDown, "turn down the volume"},
+    {kLocalCommandStop, "stop"},
+};
+#endif
+
 EspWakeWord::EspWakeWord() {
     event_group_ = xEventGroupCreate();
+    detection_done_ = xSemaphoreCreateBinary();
 }
 
 EspWakeWord::~EspWakeWord() {
-    if (wakenet_data_ != nullptr) {
-        wakenet_iface_->destroy(wakenet_data_);
-        esp_srmodel_deinit(wakenet_model_);
+    if (detection_task_ != nullptr) {
+        running_ = false;
+        xTaskNotifyGive(detection_task_);
+        xSemaphoreTake(detection_done_, portMAX_DELAY);
+    }
+    for (auto& detector : detectors_) {
+        detector.iface->destroy(detector.data);
+    }
+#if CONFIG_USE_ESP_WAKE_WORD_COMMANDS
+    if (multinet_data_ != nullptr) {
+        esp_mn_commands_free();
+        multinet_->destroy(multinet_data_);
+    }
+#endif
+    if (wakenet_model_ != nullptr) {
+        SrModels::Release();
     }
 
+    vSemaphoreDelete(detection_done_);
     vEventGroupDelete(event_group_);
 }
 
 void EspWakeWord::Initialize(AudioCodec* codec) {
     codec_ = codec;
 
-    wakenet_model_ = esp_srmodel_init("model");
-    if (wakenet_model_ == nullptr || wakenet_model_->num == -1) {
+    wakenet_model_ = SrModels::Acquire();
+    if (wakenet_model_ == nullptr) {
         ESP_LOGE(TAG, "Failed to initialize wakenet model");
         return;
     }
-    if(wakenet_model_->num > 1) {
-        ESP_LOGW(TAG, "More than one model found, using the first one");
-    } else if (wakenet_model_->num == 0) {
+    for (int i = 0; i < wakenet_model_->num; i++) {
+        char *model_name = wakenet_model_->model_name[i];
+        if (strstr(model_name, ESP_WN_PREFIX) == nullptr) {
+            continue;
+        }
+        auto iface = (esp_wn_iface_t*)esp_wn_handle_from_name(model_name);
+        auto data = iface->create(model_name, DET_MODE_95);
+        if (data == nullptr) {
+            ESP_LOGE(TAG, "Failed to create wake word model %s", model_name);
+            continue;
+        }
+        // 所有模型共用一次 Feed 的采样
+        size_t chunk_size = iface->get_samp_chunksize(data);
+        if (chunk_size_ != 0 && chunk_size != chunk_size_) {
+            ESP_LOGW(TAG, "Skip %s, chunksize %u differs from %u", model_name, chunk_size, chunk_size_);
+            iface->destroy(data);
+            continue;
+        }
+        chunk_size_ = chunk_size;
+        detectors_.push_back({iface, data});
+        ESP_LOGI(TAG, "Wake word(%s),freq: %d, chunksize: %d", model_name, iface->get_samp_rate(data), chunk_size);
+    }
+    if (detectors_.empty()) {
         ESP_LOGE(TAG, "No model found");
         return;
     }
-    char *model_name = wakenet_model_->model_name[0];
-    wakenet_iface_ = (esp_wn_iface_t*)esp_wn_handle_from_name(model_name);
-    wakenet_data_ = wakenet_iface_->create(model_name, DET_MODE_95);
+#if CONFIG_USE_ESP_WAKE_WORD_COMMANDS
+    InitializeCommands();
+#endif
+
+    ring_ = std::make_unique<AudioFrameRing>(ESP_WAKE_WORD_RING_FRAMES, chunk_size_);
+    running_ = true;
+    bool created = TaskStack::Create("wake_word", 4096 * 2, 2, kTaskStackInternal, [this]() {
+        DetectionTask();
+        xSemaphoreGive(detection_done_);
+    }, &detection_task_);
+    if (!created) {
+        ESP_LOGE(TAG, "Failed to start wake word detection task");
+        running_ = false;
+        detection_task_ = nullptr;
+    }
+}
+
+#if CONFIG_USE_ESP_WAKE_WORD_COMMANDS
+void EspWakeWord::InitializeCommands() {
+    char* model_name = esp_srmodel_filter(wakenet_model_, ESP_MN_PREFIX, NULL);
+    if (model_name == nullptr) {
+        ESP_LOGW(TAG, "No MultiNet model, local commands disabled");
+        return;
+    }
+    multinet_ = esp_mn_handle_from_name(model_name);
+    multinet_data_ = multinet_->create(model_name, 6000);
+    if (multinet_data_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to create command model %s", model_name);
+        return;
+    }
+
+    bool english = strcmp(multinet_->get_language(multinet_data_), ESP_MN_ENGLISH) == 0;
+    std::span<const CommandPhrase> phrases = english ? std::span<const CommandPhrase>(kEnglishCommands)
+        : std::span<const CommandPhrase>(kChineseCommands);
+    esp_mn_commands_alloc(multinet_, multinet_data_);
+    for (auto& item : phrases) {
+        esp_mn_commands_add(item.command, item.phrase);
+    }
+    esp_mn_commands_update();
 
-    int frequency = wakenet_iface_->get_samp_rate(wakenet_data_);
-    int audio_chunksize = wakenet_iface_->get_samp_chunksize(wakenet_data_);
-    ESP_LOGI(TAG, "Wake word(%s),freq: %d, chunksize: %d", model_name, frequency, audio_chunksize);
+    command_chunk_size_ = multinet_->get_samp_chunksize(multinet_data_);
+    command_buffer_.reserve(command_chunk_size_ + chunk_size_);
+    ESP_LOGI(TAG, "Commands(%s), %u phrases, chunksize: %u", model_name, phrases.size(), command_chunk_size_);
 }
 
+void EspWakeWord::DetectCommand(const std::vector<int16_t>& samples) {
+    command_buffer_.insert(command_buffer_.end(), samples.begin(), samples.end());
+    while (command_buffer_.size() >= command_chunk_size_) {
+        auto state = multinet_->detect(multinet_data_, command_buffer_.data());
+        command_buffer_.erase(command_buffer_.begin(), command_buffer_.begin() + command_chunk_size_);
+        if (state != ESP_MN_STATE_DETECTED) {
+            continue;
+        }
+        auto results = multinet_->get_results(multinet_data_);
+        if (results->num <= 0) {
+            continue;
+        }
+        auto command = static_cast<LocalCommand>(results->command_id[0]);
+        ESP_LOGI(TAG, "Command %d detected, prob %.2f", command, results->prob[0]);
+        metric_commands.Add();
+        multinet_->clean(multinet_data_);
+        command_buffer_.clear();
+        if (command_detected_callback_) {
+            command_detected_callback_(command);
+        }
+    }
+}
+#endif
+
 void EspWakeWord::OnWakeWordDetected(std::function<void(const std::string& wake_word)> callback) {
     wake_word_detected_callback_ = callback;
 }
 
+void EspWakeWord::OnCommandDetected(std::function<void(LocalCommand command)> callback) {
+    command_detected_callback_ = callback;
+}
+
 void EspWakeWord::StartDetection() {
+    reset_pending_ = true;
     xEventGroupSetBits(event_group_, DETECTION_RUNNING_EVENT);
 }
 
@@ -62,23 +201,71 @@ bool EspWakeWord::IsDetectionRunning() {
     return xEventGroupGetBits(event_group_) & DETECTION_RUNNING_EVENT;
 }
 
-void EspWakeWord::Feed(const std::vector<int16_t>& data) {
-    int res = wakenet_iface_->detect(wakenet_data_, (int16_t *)data.data());
-    if (res > 0) {
-        StopDetection();
-        last_detected_wake_word_ = wakenet_iface_->get_word_name(wakenet_data_, res);
+void EspWakeWord::Feed(std::span<const int16_t> data) {
+    if (!running_) {
+        return;
+    }
+    auto frame = ring_->Back();
+    if (frame == nullptr) {
+        metric_dropped.Add();
+        return;
+    }
+    // 模型只接受单声道，多声道输入取第一路
+    int channels = codec_->input_channels();
+    frame->samples.clear();
+    for (size_t i = 0; i < data.size(); i += channels) {
+        frame->samples.push_back(data[i]);
+    }
+    ring_->Commit();
+    xTaskNotifyGive(detection_task_);
+}
+
+void EspWakeWord::DetectionTask() {
+    while (running_) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (auto frame = ring_->Front()) {
+            // 停止检测之后队列里剩下的帧直接丢掉
+            if (IsDetectionRunning() && frame->samples.size() == chunk_size_) {
+                Detect(frame->samples);
+            }
+            ring_->Pop();
+        }
+    }
+}
 
-        if (wake_word_detected_callback_) {
-            wake_word_detected_callback_(last_detected_wake_word_);
+void EspWakeWord::Detect(const std::vector<int16_t>& samples) {
+#if CONFIG_USE_ESP_WAKE_WORD_COMMANDS
+    if (reset_pending_.exchange(false) && multinet_data_ != nullptr) {
+        multinet_->clean(multinet_data_);
+        command_buffer_.clear();
+    }
+#endif
+    int64_t start = esp_timer_get_time();
+    for (auto& detector : detectors_) {
+        int res = detector.iface->detect(detector.data, const_cast<int16_t*>(samples.data()));
+        if (res > 0) {
+            StopDetection();
+            last_detected_wake_word_ = detector.iface->get_word_name(detector.data, res);
+
+            if (wake_word_detected_callback_) {
+                wake_word_detected_callback_(last_detected_wake_word_);
+            }
+            return;
         }
     }
+#if CONFIG_USE_ESP_WAKE_WORD_COMMANDS
+    if (multinet_data_ != nullptr) {
+        DetectCommand(samples);
+    }
+#endif
+    metric_detect_us.Record(esp_timer_get_time() - start);
 }
 
 size_t EspWakeWord::GetFeedSize() {
-    if (wakenet_data_ == nullptr) {
+    if (detectors_.empty()) {
         return 0;
     }
-    return wakenet_iface_->get_samp_chunksize(wakenet_data_) * codec_->input_channels();
+    return chunk_size_ * codec_->input_channels();
 }
 
 void EspWakeWord::EncodeWakeWordData() {
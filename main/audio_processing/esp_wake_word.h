@@ -4,29 +4,40 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/event_groups.h>
+#include <freertos/semphr.h>
 
 #include <esp_wn_iface.h>
 #include <esp_wn_models.h>
+#include <esp_mn_iface.h>
 #include <model_path.h>
 
 #include <list>
 #include <string>
 #include <vector>
+#include <span>
 #include <functional>
-#include <mutex>
-#include <condition_variable>
+#include <memory>
+#include <atomic>
 
 #include "audio_codec.h"
+#include "audio_frame_ring.h"
 #include "wake_word.h"
 
+// 送入检测任务的环形队列长度，一帧 30ms，检测任务最多落后这么多帧
+#define ESP_WAKE_WORD_RING_FRAMES 16
+
+// 不使用 AFE 时的唤醒词检测，模型分区中的所有 WakeNet 模型都参与检测
+// Feed 只把单声道采样拷进环形队列，检测在低优先级任务中进行，采集循环不会被推理阻塞
+// 开启 CONFIG_USE_ESP_WAKE_WORD_COMMANDS 且模型分区有 MultiNet 模型时，同时识别几个本地命令词
 class EspWakeWord : public WakeWord {
 public:
     EspWakeWord();
     ~EspWakeWord();
 
     void Initialize(AudioCodec* codec);
-    void Feed(const std::vector<int16_t>& data);
+    void Feed(std::span<const int16_t> data);
     void OnWakeWordDetected(std::function<void(const std::string& wake_word)> callback);
+    void OnCommandDetected(std::function<void(LocalCommand command)> callback);
     void StartDetection();
     void StopDetection();
     bool IsDetectionRunning();
@@ -36,14 +47,39 @@ public:
     const std::string& GetLastDetectedWakeWord() const { return last_detected_wake_word_; }
 
 private:
-    esp_wn_iface_t *wakenet_iface_ = nullptr;
-    model_iface_data_t *wakenet_data_ = nullptr;
+    struct Detector {
+        esp_wn_iface_t* iface;
+        model_iface_data_t* data;
+    };
+
+    std::vector<Detector> detectors_;
     srmodel_list_t *wakenet_model_ = nullptr;
+    size_t chunk_size_ = 0;
     EventGroupHandle_t event_group_;
     AudioCodec* codec_ = nullptr;
 
+    std::unique_ptr<AudioFrameRing> ring_;
+    TaskHandle_t detection_task_ = nullptr;
+    SemaphoreHandle_t detection_done_ = nullptr;
+    std::atomic<bool> running_{false};
+    std::atomic<bool> reset_pending_{false};
+
+#if CONFIG_USE_ESP_WAKE_WORD_COMMANDS
+    esp_mn_iface_t* multinet_ = nullptr;
+    model_iface_data_t* multinet_data_ = nullptr;
+    size_t command_chunk_size_ = 0;
+    std::vector<int16_t> command_buffer_;
+
+    void InitializeCommands();
+    void DetectCommand(const std::vector<int16_t>& samples);
+#endif
+
     std::function<void(const std::string& wake_word)> wake_word_detected_callback_;
+    std::function<void(LocalCommand command)> command_detected_callback_;
     std::string last_detected_wake_word_;
+
+    void DetectionTask();
+    void Detect(const std::vector<int16_t>& samples);
 };
 
 #endif
@@ -7,12 +7,12 @@ void NoAudioProcessor::Initialize(AudioCodec* codec) {
     codec_ = codec;
 }
 
-void NoAudioProcessor::Feed(const std::vector<int16_t>& data) {
+void NoAudioProcessor::Feed(std::span<const int16_t> data) {
     if (!is_running_ || !output_callback_) {
         return;
     }
     // 直接将输入数据传递给输出回调
-    output_callback_(std::vector<int16_t>(data));
+    output_callback_(data);
 }
 
 void NoAudioProcessor::Start() {
@@ -27,7 +27,7 @@ bool NoAudioProcessor::IsRunning() {
     return is_running_;
 }
 
-void NoAudioProcessor::OnOutput(std::function<void(std::vector<int16_t>&& data)> callback) {
+void NoAudioProcessor::OnOutput(std::function<void(std::span<const int16_t> data)> callback) {
     output_callback_ = callback;
 }
 
@@ -2,6 +2,7 @@
 #define DUMMY_AUDIO_PROCESSOR_H
 
 #include <vector>
+#include <span>
 #include <functional>
 
 #include "audio_processor.h"
@@ -13,18 +14,18 @@ public:
     ~NoAudioProcessor() = default;
 
     void Initialize(AudioCodec* codec) override;
-    void Feed(const std::vector<int16_t>& data) override;
+    void Feed(std::span<const int16_t> data) override;
     void Start() override;
     void Stop() override;
     bool IsRunning() override;
-    void OnOutput(std::function<void(std::vector<int16_t>&& data)> callback) override;
+    void OnOutput(std::function<void(std::span<const int16_t> data)> callback) override;
     void OnVadStateChange(std::function<void(bool speaking)> callback) override;
     size_t GetFeedSize() override;
     void EnableDeviceAec(bool enable) override;
 
 private:
     AudioCodec* codec_ = nullptr;
-    std::function<void(std::vector<int16_t>&& data)> output_callback_;
+    std::function<void(std::span<const int16_t> data)> output_callback_;
     std::function<void(bool speaking)> vad_state_change_callback_;
     bool is_running_ = false;
 };
@@ -7,7 +7,7 @@ void NoWakeWord::Initialize(AudioCodec* codec) {
     codec_ = codec;
 }
 
-void NoWakeWord::Feed(const std::vector<int16_t>& data) {
+void NoWakeWord::Feed(std::span<const int16_t> data) {
     // Do nothing - no wake word processing
 }
 
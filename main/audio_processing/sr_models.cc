@@ -0,0 +1,39 @@
+#include "sr_models.h"
+
+#include <esp_log.h>
+#include <mutex>
+
+#define TAG "SrModels"
+
+namespace {
+std::mutex models_mutex;
+srmodel_list_t* models = nullptr;
+int references = 0;
+}
+
+srmodel_list_t* SrModels::Acquire() {
+    std::lock_guard<std::mutex> lock(models_mutex);
+    if (models == nullptr) {
+        models = esp_srmodel_init("model");
+        if (models == nullptr || models->num == -1) {
+            ESP_LOGE(TAG, "Failed to initialize models");
+            models = nullptr;
+            return nullptr;
+        }
+        for (int i = 0; i < models->num; i++) {
+            ESP_LOGI(TAG, "Model %d: %s", i, models->model_name[i]);
+        }
+    }
+    references++;
+    return models;
+}
+
+void SrModels::Release() {
+    std::lock_guard<std::mutex> lock(models_mutex);
+    if (references == 0 || --references > 0) {
+        return;
+    }
+    esp_srmodel_deinit(models);
+    models = nullptr;
+    ESP_LOGI(TAG, "Models released");
+}
@@ -0,0 +1,15 @@
+#ifndef SR_MODELS_H
+#define SR_MODELS_H
+
+#include <model_path.h>
+
+// 模型分区只解析一次，唤醒词和音频处理共用同一份模型列表
+// 模型名是列表内的指针，使用期间需要持有引用
+class SrModels {
+public:
+    // 返回 nullptr 表示模型分区不可用，不需要 Release
+    static srmodel_list_t* Acquire();
+    static void Release();
+};
+
+#endif // SR_MODELS_H
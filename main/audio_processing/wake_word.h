@@ -3,16 +3,35 @@
 
 #include <string>
 #include <vector>
+#include <span>
 #include <functional>
 
 #include "audio_codec.h"
 
+// 本地执行的离线命令，不经过服务器
+enum LocalCommand {
+    kLocalCommandVolumeUp = 1,
+    kLocalCommandVolumeDown,
+    kLocalCommandStop,
+    kLocalCommandVolumeSet,
+    kLocalCommandBrightnessUp,
+    kLocalCommandBrightnessDown,
+    kLocalCommandBrightnessSet,
+};
+
+// TryGetWakeWordOpus 的结果
+enum WakeWordOpusState {
+    kWakeWordOpusPacket,    // 取到一个包
+    kWakeWordOpusPending,   // 还在编码，等编码回调后再取
+    kWakeWordOpusDone,      // 已经取完
+};
+
 class WakeWord {
 public:
     virtual ~WakeWord() = default;
     
     virtual void Initialize(AudioCodec* codec) = 0;
-    virtual void Feed(const std::vector<int16_t>& data) = 0;
+    virtual void Feed(std::span<const int16_t> data) = 0;
     virtual void OnWakeWordDetected(std::function<void(const std::string& wake_word)> callback) = 0;
     virtual void StartDetection() = 0;
     virtual void StopDetection() = 0;
@@ -20,7 +39,14 @@ public:
     virtual size_t GetFeedSize() = 0;
     virtual void EncodeWakeWordData() = 0;
     virtual bool GetWakeWordOpus(std::vector<uint8_t>& opus) = 0;
+    // 不阻塞地取下一个唤醒词 Opus 包；后台编码的实现每编码出一个包调用一次 OnWakeWordOpusEncoded 的回调
+    virtual WakeWordOpusState TryGetWakeWordOpus(std::vector<uint8_t>& opus) {
+        return GetWakeWordOpus(opus) ? kWakeWordOpusPacket : kWakeWordOpusDone;
+    }
+    virtual void OnWakeWordOpusEncoded(std::function<void()> callback) {}
     virtual const std::string& GetLastDetectedWakeWord() const = 0;
+    // 不支持命令词的实现不会调用回调
+    virtual void OnCommandDetected(std::function<void(LocalCommand command)> callback) {}
 };
 
 #endif
@@ -0,0 +1,64 @@
+#include "wake_word_verifier.h"
+#include "metrics.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#define TAG "WakeWordVerifier"
+
+static MetricCounter metric_accepts("wake_word.verify_accepts");
+static MetricCounter metric_rejects("wake_word.verify_rejects");
+static MetricHistogram metric_verify_us("wake_word.verify_us", METRIC_DURATION_US_BOUNDS);
+
+WakeWordVerifier::~WakeWordVerifier() {
+    if (data_ != nullptr) {
+        iface_->destroy(data_);
+    }
+}
+
+bool WakeWordVerifier::Initialize(char* model_name, int threshold_percent) {
+    iface_ = (esp_wn_iface_t*)esp_wn_handle_from_name(model_name);
+    if (iface_ == nullptr) {
+        ESP_LOGE(TAG, "No wakenet interface for %s", model_name);
+        return false;
+    }
+    data_ = iface_->create(model_name, DET_MODE_95);
+    if (data_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to create wakenet %s", model_name);
+        return false;
+    }
+    int words = iface_->get_word_num(data_);
+    for (int i = 1; i <= words; i++) {
+        iface_->set_det_threshold(data_, threshold_percent / 100.0f, i);
+    }
+    chunk_.resize(iface_->get_samp_chunksize(data_));
+    ESP_LOGI(TAG, "Second stage %s, %d words, threshold %d%%", model_name, words, threshold_percent);
+    return true;
+}
+
+bool WakeWordVerifier::Verify(const int16_t* ring, size_t size, size_t start, size_t samples, int word_index) {
+    if (data_ == nullptr) {
+        return true;
+    }
+    int64_t start_time = esp_timer_get_time();
+    // 每次都从干净的状态开始，不受上一次确认的影响
+    iface_->clean(data_);
+    bool accepted = false;
+    size_t pos = start;
+    for (size_t remaining = samples; remaining >= chunk_.size() && !accepted; remaining -= chunk_.size()) {
+        for (auto& sample : chunk_) {
+            sample = ring[pos];
+            pos = pos + 1 == size ? 0 : pos + 1;
+        }
+        accepted = iface_->detect(data_, chunk_.data()) == word_index;
+    }
+    int64_t elapsed = esp_timer_get_time() - start_time;
+    metric_verify_us.Record(elapsed);
+    if (accepted) {
+        metric_accepts.Add();
+    } else {
+        metric_rejects.Add();
+    }
+    ESP_LOGI(TAG, "Word %d %s in %ld ms", word_index, accepted ? "confirmed" : "rejected", (long)(elapsed / 1000));
+    return accepted;
+}
@@ -0,0 +1,31 @@
+#ifndef WAKE_WORD_VERIFIER_H
+#define WAKE_WORD_VERIFIER_H
+
+#include <esp_wn_iface.h>
+#include <esp_wn_models.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 唤醒词的第二级确认：AFE 中的 WakeNet 触发后，用另一个阈值更高的 WakeNet 实例把前导音频重新检测一遍，
+// 同一个唤醒词再次触发才算唤醒。在打开音频通道之前完成，电视声音等误触发不会产生连接和服务器识别
+// 只在检测回调所在的任务中使用
+class WakeWordVerifier {
+public:
+    ~WakeWordVerifier();
+
+    // threshold_percent 为 WakeNet 的检测阈值（40~99），每个唤醒词都使用同一个阈值
+    bool Initialize(char* model_name, int threshold_percent);
+    // ring 是 size 个样本的环形缓冲区，从 start 开始的 samples 个样本是按时间顺序的 16kHz 单声道音频
+    // word_index 从 1 开始，与 AFE 结果中的 wakenet_model_index 一致
+    bool Verify(const int16_t* ring, size_t size, size_t start, size_t samples, int word_index);
+    bool initialized() const { return data_ != nullptr; }
+
+private:
+    esp_wn_iface_t* iface_ = nullptr;
+    model_iface_data_t* data_ = nullptr;
+    std::vector<int16_t> chunk_;
+};
+
+#endif // WAKE_WORD_VERIFIER_H
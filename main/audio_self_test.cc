@@ -0,0 +1,283 @@
+#include "audio_self_test.h"
+#include "application.h"
+#include "audio_codec.h"
+#include "opus_codec.h"
+#include "task_stack.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <cJSON.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#define TAG "AudioSelfTest"
+
+#define AUDIO_SELF_TEST_SAMPLE_RATE 16000
+// Opus 编码需要较大的栈，和音频基准测试一样
+#define AUDIO_SELF_TEST_STACK_SIZE (4096 * 8)
+// 扫频首尾的淡入淡出，避免爆音
+#define AUDIO_SELF_TEST_FADE_MS 10
+// 采集没有运行时最多等待这么久
+#define AUDIO_SELF_TEST_TIMEOUT_MS (AUDIO_SELF_TEST_RECORD_MS + 2000)
+
+bool AudioSelfTest::Start(AudioCodec* codec, PlayCallback play, Callback callback) {
+    if (active_) {
+        return false;
+    }
+    auto format = codec->GetInputFormat();
+    auto mic_index = format.find('M');
+    codec_ = codec;
+    channels_ = std::max<int>(format.size(), 1);
+    mic_index_ = mic_index == std::string::npos ? 0 : mic_index;
+    play_ = std::move(play);
+    callback_ = std::move(callback);
+    result_ = AudioSelfTestResult();
+    active_ = true;
+    if (!TaskStack::Create("audio_selftest", AUDIO_SELF_TEST_STACK_SIZE, 1, kTaskStackPsram, [this]() {
+            Run();
+        }, &task_)) {
+        ESP_LOGE(TAG, "Failed to create task");
+        active_ = false;
+        return false;
+    }
+    return true;
+}
+
+void AudioSelfTest::Feed(std::span<const int16_t> data) {
+    if (!recording_) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!recording_ || mic_.size() == mic_.capacity()) {
+        return;
+    }
+    for (size_t i = mic_index_; i < data.size() && mic_.size() < mic_.capacity(); i += channels_) {
+        mic_.push_back(data[i]);
+    }
+    if (mic_.size() == mic_.capacity()) {
+        xTaskNotifyGive(task_);
+    }
+}
+
+void AudioSelfTest::FeedProcessed(std::span<const int16_t> data) {
+    if (!recording_) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!recording_) {
+        return;
+    }
+    size_t count = std::min(data.size(), processed_.capacity() - processed_.size());
+    processed_.insert(processed_.end(), data.begin(), data.begin() + count);
+}
+
+void AudioSelfTest::Run() {
+    ESP_LOGI(TAG, "Audio self test started");
+    GenerateChirp();
+    std::vector<std::vector<uint8_t>> packets;
+    MeasureCodec(packets);
+
+    size_t samples = AUDIO_SELF_TEST_SAMPLE_RATE * AUDIO_SELF_TEST_RECORD_MS / 1000;
+    mic_.clear();
+    mic_.reserve(samples);
+    processed_.clear();
+    processed_.reserve(samples);
+    uint32_t input_overruns = codec_->input_overruns();
+    uint32_t output_underruns = codec_->output_underruns();
+
+    // 录制从第一包送入解码队列时开始，测到的延迟包括整条播放和采集链路
+    ulTaskNotifyTake(pdTRUE, 0);
+    recording_ = true;
+    play_(packets);
+    result_.recorded = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(AUDIO_SELF_TEST_TIMEOUT_MS)) > 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        recording_ = false;
+    }
+    result_.input_overruns = codec_->input_overruns() - input_overruns;
+    result_.output_underruns = codec_->output_underruns() - output_underruns;
+
+    if (result_.recorded) {
+        Analyze();
+    } else {
+        ESP_LOGE(TAG, "Capture did not run, got %u samples", mic_.size());
+    }
+    ESP_LOGI(TAG, "%s", result_.GetJson().c_str());
+
+    // 释放录音，结果留在 result_ 中
+    std::vector<int16_t>().swap(mic_);
+    std::vector<int16_t>().swap(processed_);
+    std::vector<int16_t>().swap(chirp_);
+    auto callback = std::move(callback_);
+    auto result = result_;
+    active_ = false;
+    if (callback) {
+        callback(result);
+    }
+}
+
+// 线性扫频，相位按瞬时频率积分
+void AudioSelfTest::GenerateChirp() {
+    int length = AUDIO_SELF_TEST_SAMPLE_RATE * AUDIO_SELF_TEST_CHIRP_MS / 1000;
+    int fade = AUDIO_SELF_TEST_SAMPLE_RATE * AUDIO_SELF_TEST_FADE_MS / 1000;
+    float duration = (float)length / AUDIO_SELF_TEST_SAMPLE_RATE;
+    float slope = (AUDIO_SELF_TEST_CHIRP_END_HZ - AUDIO_SELF_TEST_CHIRP_START_HZ) / duration;
+    chirp_.resize(length);
+    for (int i = 0; i < length; i++) {
+        float t = (float)i / AUDIO_SELF_TEST_SAMPLE_RATE;
+        float phase = 2 * M_PI * (AUDIO_SELF_TEST_CHIRP_START_HZ * t + slope * t * t / 2);
+        float envelope = 1.0f;
+        if (i < fade) {
+            envelope = 0.5f - 0.5f * cosf(M_PI * i / fade);
+        } else if (i >= length - fade) {
+            envelope = 0.5f - 0.5f * cosf(M_PI * (length - 1 - i) / fade);
+        }
+        chirp_[i] = (int16_t)(8000 * envelope * sinf(phase));
+    }
+}
+
+// 用和上行相同的参数逐帧编码扫频，再逐帧解码，记录每帧的耗时；编好的包用于播放
+void AudioSelfTest::MeasureCodec(std::vector<std::vector<uint8_t>>& packets) {
+    const size_t frame_samples = AUDIO_SELF_TEST_SAMPLE_RATE * OPUS_FRAME_DURATION_MS / 1000;
+    int frames = chirp_.size() / frame_samples;
+    OpusStreamEncoder encoder(AUDIO_SELF_TEST_SAMPLE_RATE, 1, OPUS_FRAME_DURATION_MS);
+    int64_t total_us = 0;
+    for (int i = 0; i < frames; i++) {
+        auto begin = chirp_.begin() + i * frame_samples;
+        std::vector<int16_t> pcm(begin, begin + frame_samples);
+        std::vector<uint8_t> opus;
+        int64_t start = esp_timer_get_time();
+        bool ok = encoder.Encode(std::move(pcm), opus);
+        int us = esp_timer_get_time() - start;
+        if (!ok) {
+            ESP_LOGE(TAG, "Failed to encode frame %d", i);
+            continue;
+        }
+        total_us += us;
+        result_.encode_us_max = std::max(result_.encode_us_max, us);
+        packets.push_back(std::move(opus));
+    }
+    if (packets.empty()) {
+        return;
+    }
+    result_.encode_us_avg = total_us / packets.size();
+
+    OpusStreamDecoder decoder(AUDIO_SELF_TEST_SAMPLE_RATE, 1, OPUS_FRAME_DURATION_MS);
+    std::vector<int16_t> pcm;
+    total_us = 0;
+    for (auto& packet : packets) {
+        auto copy = packet;
+        int64_t start = esp_timer_get_time();
+        decoder.Decode(std::move(copy), pcm);
+        int us = esp_timer_get_time() - start;
+        total_us += us;
+        result_.decode_us_max = std::max(result_.decode_us_max, us);
+    }
+    result_.decode_us_avg = total_us / packets.size();
+}
+
+void AudioSelfTest::Analyze() {
+    int length = chirp_.size();
+    int max_lag = std::min(AUDIO_SELF_TEST_SAMPLE_RATE * AUDIO_SELF_TEST_MAX_LATENCY_MS / 1000, (int)mic_.size() - length);
+    if (max_lag < 0) {
+        return;
+    }
+
+    // 和 AEC 校准一样按归一化互相关找峰值，约 3700 万次乘加
+    int64_t chirp_energy = 0;
+    for (int n = 0; n < length; n++) {
+        chirp_energy += (int32_t)chirp_[n] * chirp_[n];
+    }
+    int64_t best = 0;
+    int best_lag = 0;
+    for (int lag = 0; lag <= max_lag; lag++) {
+        int64_t sum = 0;
+        const int16_t* m = mic_.data() + lag;
+        for (int n = 0; n < length; n++) {
+            sum += (int32_t)chirp_[n] * m[n];
+        }
+        if (std::llabs(sum) > std::llabs(best)) {
+            best = sum;
+            best_lag = lag;
+        }
+    }
+    int64_t echo_energy = 0;
+    for (int n = 0; n < length; n++) {
+        int32_t value = mic_[best_lag + n];
+        echo_energy += value * value;
+    }
+    if (chirp_energy == 0 || echo_energy == 0) {
+        return;
+    }
+    double correlation = std::fabs((double)best) / std::sqrt((double)chirp_energy * (double)echo_energy);
+    result_.correlation_x100 = std::lround(correlation * 100);
+    result_.detected = result_.correlation_x100 >= AUDIO_SELF_TEST_MIN_CORRELATION;
+    result_.latency_ms = best_lag * 1000 / AUDIO_SELF_TEST_SAMPLE_RATE;
+    result_.echo_level_dbfs = std::lround(10 * std::log10((double)echo_energy / length / (32768.0 * 32768.0)));
+    if (!result_.detected) {
+        return;
+    }
+
+    // AFE 的输出比输入晚一个处理块，窗口包含扫频和回声拖尾，两边用同一段时间
+    size_t end = std::min(mic_.size(), processed_.size());
+    size_t begin = best_lag;
+    if (end < begin + length) {
+        return;
+    }
+    int64_t mic_energy = 0;
+    int64_t residual_energy = 0;
+    for (size_t n = begin; n < end; n++) {
+        mic_energy += (int32_t)mic_[n] * mic_[n];
+        residual_energy += (int32_t)processed_[n] * processed_[n];
+    }
+    result_.aec_measured = true;
+    result_.erle_db = std::lround(10 * std::log10((double)mic_energy / std::max<int64_t>(residual_energy, 1)));
+}
+
+std::string AudioSelfTestResult::GetJson() const {
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddBoolToObject(root, "recorded", recorded);
+    cJSON_AddBoolToObject(root, "detected", detected);
+    cJSON_AddNumberToObject(root, "latency_ms", latency_ms);
+    cJSON_AddNumberToObject(root, "correlation", correlation_x100 / 100.0);
+    cJSON_AddNumberToObject(root, "echo_level_dbfs", echo_level_dbfs);
+    cJSON* encode = cJSON_AddObjectToObject(root, "encode_us");
+    cJSON_AddNumberToObject(encode, "avg", encode_us_avg);
+    cJSON_AddNumberToObject(encode, "max", encode_us_max);
+    cJSON* decode = cJSON_AddObjectToObject(root, "decode_us");
+    cJSON_AddNumberToObject(decode, "avg", decode_us_avg);
+    cJSON_AddNumberToObject(decode, "max", decode_us_max);
+    cJSON_AddNumberToObject(root, "input_overruns", input_overruns);
+    cJSON_AddNumberToObject(root, "output_underruns", output_underruns);
+    if (aec_measured) {
+        cJSON_AddNumberToObject(root, "erle_db", erle_db);
+    } else {
+        cJSON_AddNullToObject(root, "erle_db");
+    }
+    char* json = cJSON_PrintUnformatted(root);
+    std::string result(json);
+    cJSON_free(json);
+    cJSON_Delete(root);
+    return result;
+}
+
+std::string AudioSelfTestResult::GetSummary() const {
+    char summary[128];
+    if (!recorded) {
+        snprintf(summary, sizeof(summary), "Self test: no capture\nXRUN %lu/%lu", input_overruns, output_underruns);
+    } else if (!detected) {
+        snprintf(summary, sizeof(summary), "Self test: chirp not heard (%d dBFS)\nXRUN %lu/%lu",
+            echo_level_dbfs, input_overruns, output_underruns);
+    } else {
+        char erle[16] = "-";
+        if (aec_measured) {
+            snprintf(erle, sizeof(erle), "%d dB", erle_db);
+        }
+        snprintf(summary, sizeof(summary), "Latency %d ms  ERLE %s\nEnc %d.%d ms  Dec %d.%d ms  XRUN %lu/%lu",
+            latency_ms, erle, encode_us_avg / 1000, encode_us_avg % 1000 / 100, decode_us_avg / 1000,
+            decode_us_avg % 1000 / 100, input_overruns, output_underruns);
+    }
+    return summary;
+}
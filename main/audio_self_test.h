@@ -0,0 +1,85 @@
+#ifndef AUDIO_SELF_TEST_H
+#define AUDIO_SELF_TEST_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+class AudioCodec;
+
+// 参考扫频的时长（必须是 Opus 帧长的整数倍）和频率范围，幅度约 -12dBFS
+#define AUDIO_SELF_TEST_CHIRP_MS 240
+#define AUDIO_SELF_TEST_CHIRP_START_HZ 300
+#define AUDIO_SELF_TEST_CHIRP_END_HZ 6000
+// 搜索的最大往返延迟，包括解码、播放缓冲、声学路径和采集缓冲
+#define AUDIO_SELF_TEST_MAX_LATENCY_MS 600
+// 从送出第一包开始录制的时长，覆盖最大延迟、扫频和回声拖尾
+#define AUDIO_SELF_TEST_RECORD_MS (AUDIO_SELF_TEST_MAX_LATENCY_MS + AUDIO_SELF_TEST_CHIRP_MS + 200)
+// 归一化互相关的峰值低于这个值（x100）认为麦克风没有采到扫频
+#define AUDIO_SELF_TEST_MIN_CORRELATION 30
+
+struct AudioSelfTestResult {
+    bool recorded = false;          // 录满了，false 表示采集没有运行
+    bool detected = false;          // 麦克风采到了扫频
+    int latency_ms = -1;            // 第一包送入解码队列到麦克风采到扫频的时间
+    int correlation_x100 = 0;
+    int echo_level_dbfs = 0;        // 采到的扫频的 RMS 电平
+    int encode_us_avg = 0;
+    int encode_us_max = 0;
+    int decode_us_avg = 0;
+    int decode_us_max = 0;
+    uint32_t input_overruns = 0;    // 测试期间 I2S 采集溢出和播放欠载的次数
+    uint32_t output_underruns = 0;
+    bool aec_measured = false;      // AFE 在运行时才测量
+    int erle_db = 0;                // AFE 输出相对麦克风的回声衰减
+
+    std::string GetJson() const;
+    // 显示在屏幕上的两行摘要
+    std::string GetSummary() const;
+};
+
+// 音频链路自检：播放一段已知的扫频，同时录下麦克风原始输入和 AFE 输出
+// 用互相关的峰值测出往返延迟，对比麦克风和 AFE 输出在回声段的能量得到 AEC 的回声衰减（ERLE），
+// 同时统计扫频的 Opus 编解码耗时和测试期间 codec 的 I2S 溢出/欠载次数
+// 生成、编解码和分析都在一个后台任务中进行；Feed 在采集任务中调用，FeedProcessed 在 AFE 输出回调中调用
+class AudioSelfTest {
+public:
+    using PlayCallback = std::function<void(const std::vector<std::vector<uint8_t>>& packets)>;
+    using Callback = std::function<void(const AudioSelfTestResult& result)>;
+
+    // play 在后台任务中调用，把编好的 16kHz 扫频包送入解码队列；callback 在测试结束后在后台任务中调用
+    bool Start(AudioCodec* codec, PlayCallback play, Callback callback);
+    // data 是 16kHz 交错的原始输入
+    void Feed(std::span<const int16_t> data);
+    void FeedProcessed(std::span<const int16_t> data);
+    bool active() const { return active_; }
+
+private:
+    std::atomic<bool> active_{false};
+    std::atomic<bool> recording_{false};
+    AudioCodec* codec_ = nullptr;
+    int channels_ = 1;
+    int mic_index_ = 0;
+    std::mutex mutex_;
+    std::vector<int16_t> chirp_;
+    std::vector<int16_t> mic_;
+    std::vector<int16_t> processed_;
+    TaskHandle_t task_ = nullptr;
+    PlayCallback play_;
+    Callback callback_;
+    AudioSelfTestResult result_;
+
+    void Run();
+    void GenerateChirp();
+    void MeasureCodec(std::vector<std::vector<uint8_t>>& packets);
+    void Analyze();
+};
+
+#endif // AUDIO_SELF_TEST_H
@@ -0,0 +1,38 @@
+#include "audio_trace.h"
+
+#if CONFIG_AUDIO_PIPELINE_TRACE
+#include "metrics.h"
+
+// 排队和端到端耗时的分桶，单位微秒
+#define AUDIO_TRACE_WAIT_US_BOUNDS {1000, 5000, 10000, 20000, 50000, 100000, 200000, 500000, 1000000}
+
+namespace {
+
+// 顺序与 AudioTraceStage 一致
+MetricHistogram histograms[kAudioTraceStageCount] = {
+    {"trace.up.i2s_read_us", METRIC_DURATION_US_BOUNDS},
+    {"trace.up.resample_us", METRIC_DURATION_US_BOUNDS},
+    {"trace.up.afe_feed_us", METRIC_DURATION_US_BOUNDS},
+    {"trace.up.afe_fetch_us", AUDIO_TRACE_WAIT_US_BOUNDS},
+    {"trace.up.encode_wait_us", AUDIO_TRACE_WAIT_US_BOUNDS},
+    {"trace.up.encode_us", METRIC_DURATION_US_BOUNDS},
+    {"trace.up.send_wait_us", AUDIO_TRACE_WAIT_US_BOUNDS},
+    {"trace.up.send_us", METRIC_DURATION_US_BOUNDS},
+    {"trace.up.total_us", AUDIO_TRACE_WAIT_US_BOUNDS},
+    {"trace.down.receive_us", METRIC_DURATION_US_BOUNDS},
+    {"trace.down.decode_wait_us", AUDIO_TRACE_WAIT_US_BOUNDS},
+    {"trace.down.decode_us", METRIC_DURATION_US_BOUNDS},
+    {"trace.down.resample_us", METRIC_DURATION_US_BOUNDS},
+    {"trace.down.i2s_write_us", AUDIO_TRACE_WAIT_US_BOUNDS},
+    {"trace.down.total_us", AUDIO_TRACE_WAIT_US_BOUNDS},
+};
+
+} // namespace
+
+void AudioTrace::Record(AudioTraceStage stage, uint32_t start_us) {
+    if (start_us == 0) {
+        return;
+    }
+    histograms[stage].Record(Now() - start_us);
+}
+#endif // CONFIG_AUDIO_PIPELINE_TRACE
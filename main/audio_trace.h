@@ -0,0 +1,64 @@
+#ifndef AUDIO_TRACE_H
+#define AUDIO_TRACE_H
+
+#include <cstdint>
+#include <esp_timer.h>
+
+enum AudioTraceStage {
+    // 上行
+    kAudioTraceI2sRead,
+    kAudioTraceInputResample,
+    kAudioTraceAfeFeed,
+    kAudioTraceAfeFetch,
+    kAudioTraceEncodeWait,
+    kAudioTraceEncode,
+    kAudioTraceSendWait,
+    kAudioTraceSend,
+    kAudioTraceUplink,          // AFE 输出到发送完成
+    // 下行
+    kAudioTraceReceive,
+    kAudioTraceDecodeWait,
+    kAudioTraceDecode,
+    kAudioTraceOutputResample,
+    kAudioTraceI2sWrite,
+    kAudioTraceDownlink,        // 收到数据包到写完 I2S
+    kAudioTraceStageCount
+};
+
+// 音频流水线逐帧耗时统计，用来调整音频任务的优先级和绑核
+// 各阶段的直方图登记为 trace.up.* / trace.down.* 指标，通过 self.system.get_metrics 查询
+// CONFIG_AUDIO_PIPELINE_TRACE 关闭时所有调用都是空操作，Now() 返回 0
+class AudioTrace {
+public:
+    static uint32_t Now() {
+#if CONFIG_AUDIO_PIPELINE_TRACE
+        // 0 表示没有记录起点
+        uint32_t now = esp_timer_get_time();
+        return now == 0 ? 1 : now;
+#else
+        return 0;
+#endif
+    }
+
+    // 记录从 start_us 到现在的耗时，start_us 为 0 时忽略
+#if CONFIG_AUDIO_PIPELINE_TRACE
+    static void Record(AudioTraceStage stage, uint32_t start_us);
+#else
+    static void Record(AudioTraceStage, uint32_t) {}
+#endif
+};
+
+// 记录所在作用域的耗时
+class AudioTraceScope {
+public:
+    explicit AudioTraceScope(AudioTraceStage stage) : stage_(stage), start_us_(AudioTrace::Now()) {}
+    ~AudioTraceScope() { AudioTrace::Record(stage_, start_us_); }
+    AudioTraceScope(const AudioTraceScope&) = delete;
+    AudioTraceScope& operator=(const AudioTraceScope&) = delete;
+
+private:
+    AudioTraceStage stage_;
+    uint32_t start_us_;
+};
+
+#endif // AUDIO_TRACE_H
@@ -1,4 +1,5 @@
 #include "background_task.h"
+#include "task_manifest.h"
 
 #include <esp_log.h>
 #include <esp_task_wdt.h>
@@ -6,65 +7,122 @@
 #define TAG "BackgroundTask"
 
 BackgroundTask::BackgroundTask(uint32_t stack_size) {
-    xTaskCreate([](void* arg) {
-        BackgroundTask* task = (BackgroundTask*)arg;
-        task->BackgroundTaskLoop();
-    }, "background_task", stack_size, this, 2, &background_task_handle_);
+    auto& spec = TaskManifest::GetInstance().Get(kTaskBackground);
+    // 单个 worker 还要负责解码，不绑定核心
+    StartWorker({spec.name, stack_size, spec.priority, tskNO_AFFINITY, BACKGROUND_LANE_ALL});
+}
+
+BackgroundTask::BackgroundTask(const std::vector<BackgroundWorkerConfig>& workers) {
+    for (auto& config : workers) {
+        StartWorker(config);
+    }
+    if (served_lanes_ != BACKGROUND_LANE_ALL) {
+        ESP_LOGE(TAG, "Some lanes are not served by any worker, lane mask: 0x%lx", served_lanes_);
+    }
 }
 
 BackgroundTask::~BackgroundTask() {
-    if (background_task_handle_ != nullptr) {
-        vTaskDelete(background_task_handle_);
+    for (auto worker : workers_) {
+        if (worker->handle != nullptr) {
+            vTaskDelete(worker->handle);
+        }
+        delete worker;
     }
 }
 
+void BackgroundTask::StartWorker(const BackgroundWorkerConfig& config) {
+    auto worker = new Worker{this, config.lane_mask};
+    workers_.push_back(worker);
+    served_lanes_ |= config.lane_mask;
+    xTaskCreatePinnedToCore([](void* arg) {
+        Worker* worker = (Worker*)arg;
+        worker->owner->BackgroundTaskLoop(worker);
+    }, config.name, config.stack_size, worker, config.priority, &worker->handle, config.core_id);
+}
+
 bool BackgroundTask::Schedule(std::function<void()> callback) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    if (waiting_for_completion_ > 0) {
-        return false;
+    return Schedule(kBackgroundLaneHousekeeping, std::move(callback)) == kBackgroundScheduleOk;
+}
+
+BackgroundScheduleResult BackgroundTask::Schedule(BackgroundTaskLane lane, std::function<void()> callback) {
+    std::lock_guard<ProfiledMutex> lock(mutex_);
+    auto& l = lanes_[lane];
+    if (l.waiting_for_completion > 0) {
+        return kBackgroundScheduleWaitingForCompletion;
     }
-    if (active_tasks_ >= 30) {
-        int free_sram = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
-        if (free_sram < 10000) {
-            ESP_LOGW(TAG, "active_tasks_ == %d, free_sram == %u", active_tasks_, free_sram);
-            return false;
-        }
+    if (l.pending >= l.max_pending) {
+        ESP_LOGW(TAG, "Lane %d is full, pending: %d", lane, l.pending);
+        return kBackgroundScheduleQueueFull;
     }
-    active_tasks_++;
-    background_tasks_.emplace_back([this, cb = std::move(callback)]() {
-        cb();
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            active_tasks_--;
-            if (background_tasks_.empty() && active_tasks_ == 0) {
-                condition_variable_.notify_all();
-            }
-        }
-    });
+    int free_sram = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    if (free_sram < 10000 && l.pending > 0) {
+        ESP_LOGW(TAG, "Lane %d pending: %d, free_sram == %u, largest block %u", lane, l.pending, free_sram,
+            heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL));
+        return kBackgroundScheduleLowMemory;
+    }
+    l.pending++;
+    l.tasks.emplace_back(std::move(callback));
     condition_variable_.notify_all();
-    return true;
+    return kBackgroundScheduleOk;
+}
+
+void BackgroundTask::SetLaneLimit(BackgroundTaskLane lane, int max_pending) {
+    std::lock_guard<ProfiledMutex> lock(mutex_);
+    lanes_[lane].max_pending = max_pending;
 }
 
 void BackgroundTask::WaitForCompletion() {
-    std::unique_lock<std::mutex> lock(mutex_);
-    waiting_for_completion_++;
+    std::unique_lock<ProfiledMutex> lock(mutex_);
+    for (auto& l : lanes_) {
+        l.waiting_for_completion++;
+    }
     condition_variable_.wait(lock, [this]() {
-        return background_tasks_.empty() && active_tasks_ == 0;
+        for (auto& l : lanes_) {
+            if (l.pending > 0) {
+                return false;
+            }
+        }
+        return true;
     });
-    waiting_for_completion_--;
+    for (auto& l : lanes_) {
+        l.waiting_for_completion--;
+    }
 }
 
-void BackgroundTask::BackgroundTaskLoop() {
-    ESP_LOGI(TAG, "background_task started");
+void BackgroundTask::WaitForCompletion(BackgroundTaskLane lane) {
+    std::unique_lock<ProfiledMutex> lock(mutex_);
+    auto& l = lanes_[lane];
+    l.waiting_for_completion++;
+    condition_variable_.wait(lock, [&l]() { return l.pending == 0; });
+    l.waiting_for_completion--;
+}
+
+void BackgroundTask::BackgroundTaskLoop(Worker* worker) {
+    ESP_LOGI(TAG, "%s started, lane mask: 0x%lx", pcTaskGetName(NULL), worker->lane_mask);
     while (true) {
-        std::unique_lock<std::mutex> lock(mutex_);
-        condition_variable_.wait(lock, [this]() { return !background_tasks_.empty(); });
-        
-        std::list<std::function<void()>> tasks = std::move(background_tasks_);
+        std::unique_lock<ProfiledMutex> lock(mutex_);
+        int lane = -1;
+        condition_variable_.wait(lock, [this, worker, &lane]() {
+            // 每次只取一个任务，优先处理高优先级通道
+            for (int i = 0; i < kBackgroundLaneCount; i++) {
+                if ((worker->lane_mask & BACKGROUND_LANE_BIT(i)) && !lanes_[i].tasks.empty()) {
+                    lane = i;
+                    return true;
+                }
+            }
+            return false;
+        });
+
+        auto task = std::move(lanes_[lane].tasks.front());
+        lanes_[lane].tasks.pop_front();
         lock.unlock();
 
-        for (auto& task : tasks) {
-            task();
+        task();
+        task = nullptr;
+
+        lock.lock();
+        if (--lanes_[lane].pending == 0) {
+            condition_variable_.notify_all();
         }
     }
 }
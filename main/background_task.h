@@ -5,26 +5,78 @@
 #include <freertos/task.h>
 #include <mutex>
 #include <list>
+#include <vector>
+#include <functional>
 #include <condition_variable>
 #include <atomic>
 
+#include "lock_profiler.h"
+
+#include "memory_profile.h"
+
+// 任务通道，数值越小优先级越高
+enum BackgroundTaskLane {
+    kBackgroundLaneDecode,
+    kBackgroundLaneUi,          // 状态切换时的界面和指示灯更新，按提交顺序执行
+    kBackgroundLaneHousekeeping,
+    kBackgroundLaneCount
+};
+
+#define BACKGROUND_LANE_BIT(lane) (1 << (lane))
+#define BACKGROUND_LANE_ALL ((1 << kBackgroundLaneCount) - 1)
+
+enum BackgroundScheduleResult {
+    kBackgroundScheduleOk,
+    kBackgroundScheduleWaitingForCompletion,
+    kBackgroundScheduleQueueFull,
+    kBackgroundScheduleLowMemory,
+};
+
+struct BackgroundWorkerConfig {
+    const char* name;
+    uint32_t stack_size;
+    UBaseType_t priority;
+    BaseType_t core_id;     // tskNO_AFFINITY 表示不绑定核心
+    uint32_t lane_mask;     // 该 worker 负责的通道
+};
+
 class BackgroundTask {
 public:
+    // 单个 worker 处理所有通道
     BackgroundTask(uint32_t stack_size = 4096 * 2);
+    BackgroundTask(const std::vector<BackgroundWorkerConfig>& workers);
     ~BackgroundTask();
 
+    // 兼容旧接口，任务放入 housekeeping 通道
     bool Schedule(std::function<void()> callback);
+    BackgroundScheduleResult Schedule(BackgroundTaskLane lane, std::function<void()> callback);
+    // 设置通道内排队加执行中的任务上限
+    void SetLaneLimit(BackgroundTaskLane lane, int max_pending);
     void WaitForCompletion();
+    void WaitForCompletion(BackgroundTaskLane lane);
 
 private:
-    std::mutex mutex_;
-    std::list<std::function<void()>> background_tasks_;
-    std::condition_variable condition_variable_;
-    TaskHandle_t background_task_handle_ = nullptr;
-    int active_tasks_ = 0;
-    int waiting_for_completion_ = 0;
-
-    void BackgroundTaskLoop();
+    struct Lane {
+        std::list<std::function<void()>> tasks;
+        int max_pending = MEMORY_PROFILE_BACKGROUND_MAX_PENDING;
+        int pending = 0;    // 排队中和执行中的任务数
+        int waiting_for_completion = 0;
+    };
+
+    struct Worker {
+        BackgroundTask* owner;
+        uint32_t lane_mask;
+        TaskHandle_t handle = nullptr;
+    };
+
+    ProfiledMutex mutex_{kLockBackgroundTask};
+    std::condition_variable_any condition_variable_;
+    Lane lanes_[kBackgroundLaneCount];
+    std::vector<Worker*> workers_;
+    uint32_t served_lanes_ = 0;
+
+    void StartWorker(const BackgroundWorkerConfig& config);
+    void BackgroundTaskLoop(Worker* worker);
 };
 
 #endif
@@ -67,7 +67,7 @@ private:
                 .dc_low_on_data = 0,
                 .disable_control_phase = 0,
             },
-            .scl_speed_hz = 400 * 1000,
+            .scl_speed_hz = OLED_I2C_SCL_SPEED_HZ,
         };
 
         ESP_ERROR_CHECK(esp_lcd_new_panel_io_i2c_v2(display_i2c_bus_, &io_config, &panel_io_));
@@ -163,6 +163,16 @@ private:
 #endif
     }
 
+    // 面包板常用 MAX98357 接小喇叭：衰减放不出来的低频，整体提高 3 dB，峰值交给限幅器
+    void InitializeAudioProfile() {
+        OutputDspProfile profile;
+        profile.gain_db = 3;
+        profile.limiter_dbfs = -1;
+        profile.bass_shelf_hz = 250;
+        profile.bass_shelf_db = -9;
+        GetAudioCodec()->SetOutputDspProfile(profile);
+    }
+
 public:
     CompactWifiBoard() :
         boot_button_(BOOT_BUTTON_GPIO),
@@ -173,6 +183,7 @@ public:
         InitializeSsd1306Display();
         InitializeButtons();
         InitializeIot();
+        InitializeAudioProfile();
     }
 
     virtual Led* GetLed() override {
@@ -14,9 +14,12 @@ namespace audio_wifi_config
     void ReceiveWifiCredentialsFromAudio(Application *app,
                                        WifiConfigurationAp *wifi_ap)
     {
-        const int kInputSampleRate = 16000;                                    // Input sampling rate
-        const float kDownsampleStep = static_cast<float>(kInputSampleRate) / static_cast<float>(kAudioSampleRate); // Downsampling step
+        const size_t kInputSampleRate = 16000;                                 // Input sampling rate
         std::vector<int16_t> audio_data;
+        // 16kHz 降到 6.4kHz：按采样率的比例累加相位，每跨过一次输入采样率取一个样本
+        int16_t downsampled_data[240];
+        uint8_t bits[8];
+        size_t downsample_phase = 0;
         AudioSignalProcessor signal_processor(kAudioSampleRate, kMarkFrequency, kSpaceFrequency, kBitRate, kWindowSize);
         AudioDataBuffer data_buffer;
 
@@ -36,37 +39,23 @@ namespace audio_wifi_config
                 continue;
             }
             
-            // Downsample the audio data
-            std::vector<float> downsampled_data;
-            size_t last_index = 0;
-
-            if (kDownsampleStep > 1.0f)
+            size_t downsampled_count = 0;
+            for (int16_t sample : audio_data)
             {
-                downsampled_data.reserve(audio_data.size() / static_cast<size_t>(kDownsampleStep));
-                for (size_t i = 0; i < audio_data.size(); ++i)
+                downsample_phase += kAudioSampleRate;
+                if (downsample_phase >= kInputSampleRate)
                 {
-                    size_t sample_index = static_cast<size_t>(i / kDownsampleStep);
-                    if ((sample_index + 1) > last_index)
+                    downsample_phase -= kInputSampleRate;
+                    if (downsampled_count < sizeof(downsampled_data) / sizeof(downsampled_data[0]))
                     {
-                        downsampled_data.push_back(static_cast<float>(audio_data[i]));
-                        last_index = sample_index + 1;
+                        downsampled_data[downsampled_count++] = sample;
                     }
                 }
             }
-            else
-            {
-                downsampled_data.reserve(audio_data.size());
-                for (int16_t sample : audio_data)
-                {
-                    downsampled_data.push_back(static_cast<float>(sample));
-                }
-            }
-            
-            // Process audio samples to get probability data
-            auto probabilities = signal_processor.ProcessAudioSamples(downsampled_data);
-            
-            // Feed probability data to the data buffer
-            if (data_buffer.ProcessProbabilityData(probabilities, 0.5f))
+
+            // Demodulate audio samples to bits and feed them to the data buffer
+            size_t bit_count = signal_processor.ProcessAudioSamples(downsampled_data, downsampled_count, bits, sizeof(bits));
+            if (data_buffer.ProcessBits(bits, bit_count))
             {
                 // If complete data was received, extract WiFi credentials
                 if (data_buffer.decoded_text.has_value())
@@ -113,66 +102,70 @@ namespace audio_wifi_config
     const std::vector<uint8_t> kDefaultEndTransmissionPattern = {
         0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 1, 0, 0};
 
-    // FrequencyDetector implementation
-    FrequencyDetector::FrequencyDetector(float frequency, size_t window_size)
-        : frequency_(frequency), window_size_(window_size)
+    // DualToneDetector implementation
+    DualToneDetector::DualToneDetector(float mark_frequency, float space_frequency, size_t window_size)
+        : window_size_(window_size),
+          mark_cos_(window_size), mark_sin_(window_size),
+          space_cos_(window_size), space_sin_(window_size)
     {
-        frequency_bin_ = std::floor(frequency_ * static_cast<float>(window_size_));
-        angular_frequency_ = 2.0f * M_PI * frequency_;
-        cos_coefficient_ = std::cos(angular_frequency_);
-        sin_coefficient_ = std::sin(angular_frequency_);
-        filter_coefficient_ = 2.0f * cos_coefficient_;
-
-        // Initialize state buffer
-        state_buffer_.push_back(0.0f);
-        state_buffer_.push_back(0.0f);
-    }
-
-    void FrequencyDetector::Reset()
-    {
-        state_buffer_.clear();
-        state_buffer_.push_back(0.0f);
-        state_buffer_.push_back(0.0f);
-    }
-
-    void FrequencyDetector::ProcessSample(float sample)
-    {
-        if (state_buffer_.size() < 2)
+        // Tables are computed once, the per-sample work is integer only
+        for (size_t n = 0; n < window_size_; ++n)
         {
-            return;
+            float mark_phase = 2.0f * M_PI * mark_frequency * n;
+            float space_phase = 2.0f * M_PI * space_frequency * n;
+            mark_cos_[n] = static_cast<int16_t>(std::lround(std::cos(mark_phase) * 16384.0f));
+            mark_sin_[n] = static_cast<int16_t>(std::lround(std::sin(mark_phase) * 16384.0f));
+            space_cos_[n] = static_cast<int16_t>(std::lround(std::cos(space_phase) * 16384.0f));
+            space_sin_[n] = static_cast<int16_t>(std::lround(std::sin(space_phase) * 16384.0f));
         }
-
-        float s_minus_2 = state_buffer_.front();  // S[-2]
-        state_buffer_.pop_front();
-        float s_minus_1 = state_buffer_.front();  // S[-1]
-        state_buffer_.pop_front();
-
-        float s_current = sample + filter_coefficient_ * s_minus_1 - s_minus_2;
-
-        state_buffer_.push_back(s_minus_1);  // Put S[-1] back
-        state_buffer_.push_back(s_current);  // Add new S[0]
     }
 
-    float FrequencyDetector::GetAmplitude() const
+    bool DualToneDetector::IsMark(const int16_t *ring, size_t head) const
     {
-        if (state_buffer_.size() < 2)
+        // Products are at most 2^29, shifted by 5 before accumulating so 64+ samples cannot overflow int32
+        int32_t mark_re = 0, mark_im = 0, space_re = 0, space_im = 0;
+        size_t n = 0;
+        // The window starts at the oldest sample: [head, size) then [0, head)
+        for (size_t segment = 0; segment < 2; ++segment)
         {
-            return 0.0f;
+            size_t begin = segment == 0 ? head : 0;
+            size_t end = segment == 0 ? window_size_ : head;
+            size_t i = begin;
+            // Unrolled by 4, the compiler keeps all accumulators in registers
+            for (; i + 4 <= end; i += 4, n += 4)
+            {
+                int32_t x0 = ring[i], x1 = ring[i + 1], x2 = ring[i + 2], x3 = ring[i + 3];
+                mark_re += (x0 * mark_cos_[n] + x1 * mark_cos_[n + 1]) >> 5;
+                mark_re += (x2 * mark_cos_[n + 2] + x3 * mark_cos_[n + 3]) >> 5;
+                mark_im += (x0 * mark_sin_[n] + x1 * mark_sin_[n + 1]) >> 5;
+                mark_im += (x2 * mark_sin_[n + 2] + x3 * mark_sin_[n + 3]) >> 5;
+                space_re += (x0 * space_cos_[n] + x1 * space_cos_[n + 1]) >> 5;
+                space_re += (x2 * space_cos_[n + 2] + x3 * space_cos_[n + 3]) >> 5;
+                space_im += (x0 * space_sin_[n] + x1 * space_sin_[n + 1]) >> 5;
+                space_im += (x2 * space_sin_[n + 2] + x3 * space_sin_[n + 3]) >> 5;
+            }
+            for (; i < end; ++i, ++n)
+            {
+                int32_t x = ring[i];
+                mark_re += (x * mark_cos_[n]) >> 5;
+                mark_im += (x * mark_sin_[n]) >> 5;
+                space_re += (x * space_cos_[n]) >> 5;
+                space_im += (x * space_sin_[n]) >> 5;
+            }
         }
 
-        float s_minus_1 = state_buffer_[1];                      // S[-1]
-        float s_minus_2 = state_buffer_[0];                      // S[-2]
-        float real_part = cos_coefficient_ * s_minus_1 - s_minus_2;  // Real part
-        float imaginary_part = sin_coefficient_ * s_minus_1;         // Imaginary part
-
-        return std::sqrt(real_part * real_part + imaginary_part * imaginary_part) / 
-               (static_cast<float>(window_size_) / 2.0f);
+        // Compare energies, no square root needed
+        int64_t mark_power = static_cast<int64_t>(mark_re) * mark_re + static_cast<int64_t>(mark_im) * mark_im;
+        int64_t space_power = static_cast<int64_t>(space_re) * space_re + static_cast<int64_t>(space_im) * space_im;
+        return mark_power > space_power;
     }
 
     // AudioSignalProcessor implementation
     AudioSignalProcessor::AudioSignalProcessor(size_t sample_rate, size_t mark_frequency, size_t space_frequency,
                                              size_t bit_rate, size_t window_size)
-        : input_buffer_size_(window_size), output_sample_count_(0)
+        : ring_(window_size), ring_head_(0), ring_count_(0), output_sample_count_(0),
+          detector_(static_cast<float>(mark_frequency) / static_cast<float>(sample_rate),
+                    static_cast<float>(space_frequency) / static_cast<float>(sample_rate), window_size)
     {
         if (sample_rate % bit_rate != 0)
         {
@@ -180,58 +173,33 @@ namespace audio_wifi_config
             ESP_LOGW(kLogTag, "Sample rate %zu is not divisible by bit rate %zu", sample_rate, bit_rate);
         }
 
-        float normalized_mark_freq = static_cast<float>(mark_frequency) / static_cast<float>(sample_rate);
-        float normalized_space_freq = static_cast<float>(space_frequency) / static_cast<float>(sample_rate);
-
-        mark_detector_ = std::make_unique<FrequencyDetector>(normalized_mark_freq, window_size);
-        space_detector_ = std::make_unique<FrequencyDetector>(normalized_space_freq, window_size);
-
         samples_per_bit_ = sample_rate / bit_rate;  // Number of samples per bit
     }
 
-    std::vector<float> AudioSignalProcessor::ProcessAudioSamples(const std::vector<float> &samples)
+    size_t AudioSignalProcessor::ProcessAudioSamples(const int16_t *samples, size_t count, uint8_t *bits, size_t max_bits)
     {
-        std::vector<float> result;
-
-        for (float sample : samples)
+        size_t bit_count = 0;
+        for (size_t i = 0; i < count; ++i)
         {
-            if (input_buffer_.size() < input_buffer_size_)
+            ring_[ring_head_] = samples[i];
+            ring_head_ = (ring_head_ + 1) % ring_.size();
+            if (ring_count_ < ring_.size())
             {
-                input_buffer_.push_back(sample);  // Just add, don't process yet
+                ring_count_++;  // Just add, don't process until the window is full
+                continue;
             }
-            else
-            {
-                // Input buffer is full, process the data
-                input_buffer_.pop_front();   // Remove oldest sample
-                input_buffer_.push_back(sample);  // Add new sample
-                output_sample_count_++;
 
-                if (output_sample_count_ >= samples_per_bit_)
+            output_sample_count_++;
+            if (output_sample_count_ >= samples_per_bit_)
+            {
+                if (bit_count < max_bits)
                 {
-                    // Process all samples in the window using Goertzel algorithm
-                    for (float window_sample : input_buffer_)
-                    {
-                        mark_detector_->ProcessSample(window_sample);
-                        space_detector_->ProcessSample(window_sample);
-                    }
-
-                    float mark_amplitude = mark_detector_->GetAmplitude();   // Mark amplitude
-                    float space_amplitude = space_detector_->GetAmplitude(); // Space amplitude
-
-                    // Avoid division by zero
-                    float mark_probability = mark_amplitude / 
-                                           (space_amplitude + mark_amplitude + std::numeric_limits<float>::epsilon());
-                    result.push_back(mark_probability);
-
-                    // Reset detector windows
-                    mark_detector_->Reset();
-                    space_detector_->Reset();
-                    output_sample_count_ = 0;  // Reset output counter
+                    bits[bit_count++] = detector_.IsMark(ring_.data(), ring_head_) ? 1 : 0;
                 }
+                output_sample_count_ = 0;  // Reset output counter
             }
         }
-
-        return result;
+        return bit_count;
     }
 
     // AudioDataBuffer implementation
@@ -276,11 +244,11 @@ namespace audio_wifi_config
         bit_buffer_.clear();
     }
 
-    bool AudioDataBuffer::ProcessProbabilityData(const std::vector<float> &probabilities, float threshold)
+    bool AudioDataBuffer::ProcessBits(const uint8_t *bits, size_t count)
     {
-        for (float probability : probabilities)
+        for (size_t i = 0; i < count; ++i)
         {
-            uint8_t bit = (probability > threshold) ? 1 : 0;
+            uint8_t bit = bits[i];
 
             if (identifier_buffer_.size() >= identifier_buffer_size_)
             {
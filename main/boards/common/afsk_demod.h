@@ -6,6 +6,7 @@
 #include <memory>
 #include <optional>
 #include <cmath>
+#include <cstdint>
 #include "wifi_configuration_ap.h"
 #include "application.h"
 
@@ -22,45 +23,35 @@ namespace audio_wifi_config
     void ReceiveWifiCredentialsFromAudio(Application *app, WifiConfigurationAp *wifi_ap);
 
     /**
-     * Goertzel algorithm implementation for single frequency detection
-     * Used to detect specific audio frequencies in the AFSK demodulation process
+     * Fixed-point detector for the Mark/Space frequency pair
+     * Correlates a block of samples with Q14 cos/sin tables of both tones in one pass,
+     * only 32-bit integer multiply-accumulate, so it runs on parts without an FPU (C3)
      */
-    class FrequencyDetector
+    class DualToneDetector
     {
     private:
-        float frequency_;              // Target frequency (normalized, i.e., f / fs)
-        size_t window_size_;           // Window size for analysis
-        float frequency_bin_;          // Frequency bin
-        float angular_frequency_;      // Angular frequency
-        float cos_coefficient_;        // cos(w)
-        float sin_coefficient_;        // sin(w)
-        float filter_coefficient_;     // 2 * cos(w)
-        std::deque<float> state_buffer_;  // Circular buffer for storing S[-1] and S[-2]
+        size_t window_size_;             // Window size for analysis
+        std::vector<int16_t> mark_cos_;  // Q14 cos/sin tables of the Mark tone
+        std::vector<int16_t> mark_sin_;
+        std::vector<int16_t> space_cos_; // Q14 cos/sin tables of the Space tone
+        std::vector<int16_t> space_sin_;
 
     public:
         /**
          * Constructor
-         * @param frequency Normalized frequency (f / fs)
+         * @param mark_frequency Normalized Mark frequency (f / fs)
+         * @param space_frequency Normalized Space frequency (f / fs)
          * @param window_size Window size for analysis
          */
-        FrequencyDetector(float frequency, size_t window_size);
+        DualToneDetector(float mark_frequency, float space_frequency, size_t window_size);
 
         /**
-         * Reset the detector state
+         * Compare the energy of both tones in a window stored in a ring buffer
+         * @param ring Ring buffer holding window_size samples
+         * @param head Index of the oldest sample in the ring
+         * @return true if the Mark tone is stronger
          */
-        void Reset();
-
-        /**
-         * Process one audio sample
-         * @param sample Input audio sample
-         */
-        void ProcessSample(float sample);
-
-        /**
-         * Calculate current amplitude
-         * @return Amplitude value
-         */
-        float GetAmplitude() const;
+        bool IsMark(const int16_t *ring, size_t head) const;
     };
 
     /**
@@ -70,12 +61,12 @@ namespace audio_wifi_config
     class AudioSignalProcessor
     {
     private:
-        std::deque<float> input_buffer_;             // Input sample buffer
-        size_t input_buffer_size_;                   // Input buffer size = window size
-        size_t output_sample_count_;                 // Output sample counter
-        size_t samples_per_bit_;                     // Samples per bit threshold
-        std::unique_ptr<FrequencyDetector> mark_detector_;   // Mark frequency detector
-        std::unique_ptr<FrequencyDetector> space_detector_;  // Space frequency detector
+        std::vector<int16_t> ring_;      // Ring buffer of the latest window_size samples
+        size_t ring_head_;               // Index of the oldest sample (next write position)
+        size_t ring_count_;              // Samples stored, up to window size
+        size_t output_sample_count_;     // Samples since the last decided bit
+        size_t samples_per_bit_;         // Samples per bit threshold
+        DualToneDetector detector_;
 
     public:
         /**
@@ -91,10 +82,13 @@ namespace audio_wifi_config
 
         /**
          * Process input audio samples
-         * @param samples Input audio sample vector
-         * @return Vector of Mark probability values (0.0 to 1.0)
+         * @param samples Input audio samples at sample_rate
+         * @param count Number of samples
+         * @param bits Output bits, one per bit period (1 = Mark)
+         * @param max_bits Capacity of bits
+         * @return Number of bits written
          */
-        std::vector<float> ProcessAudioSamples(const std::vector<float> &samples);
+        size_t ProcessAudioSamples(const int16_t *samples, size_t count, uint8_t *bits, size_t max_bits);
     };
 
     /**
@@ -142,12 +136,12 @@ namespace audio_wifi_config
                       const std::vector<uint8_t> &end_identifier, bool enable_checksum = false);
 
         /**
-         * Process probability data and attempt to decode
-         * @param probabilities Vector of Mark probabilities
-         * @param threshold Decision threshold for bit detection
+         * Process demodulated bits and attempt to decode
+         * @param bits Demodulated bits (1 = Mark)
+         * @param count Number of bits
          * @return true if complete data was successfully received and decoded
          */
-        bool ProcessProbabilityData(const std::vector<float> &probabilities, float threshold = 0.5f);
+        bool ProcessBits(const uint8_t *bits, size_t count);
 
         /**
          * Calculate checksum for ASCII text
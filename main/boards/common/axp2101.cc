@@ -6,7 +6,7 @@
 
 #define TAG "Axp2101"
 
-Axp2101::Axp2101(i2c_master_bus_handle_t i2c_bus, uint8_t addr) : I2cDevice(i2c_bus, addr) {
+Axp2101::Axp2101(i2c_master_bus_handle_t i2c_bus, uint8_t addr) : I2cDevice(i2c_bus, addr, kI2cPriorityBattery) {
 }
 
 int Axp2101::GetBatteryCurrentDirection() {
@@ -34,6 +34,35 @@ float Axp2101::GetTemperature() {
     return ReadReg(0xA5);
 }
 
+bool Axp2101::ReadBatteryState(BatteryState& state) {
+    // 0x00 状态 1，0x01 状态 2
+    uint8_t status[2];
+    ReadRegs(0x00, status, sizeof(status));
+    int direction = (status[1] & 0b01100000) >> 5;
+    state.charging = direction == 1;
+    state.discharging = direction == 2;
+    state.charging_done = (status[1] & 0b00000111) == 0b00000100;
+    state.external_power = (status[0] & 0b00100000) != 0;
+    state.level = ReadReg(0xA4);
+    return true;
+}
+
+void Axp2101::EnableChargeInterrupts() {
+    ClearInterrupts();
+    // 0x41: VBUS 插入/拔出、电池插入/拔出；0x42: 充满、开始充电
+    WriteReg(0x41, ReadReg(0x41) | 0b11110000);
+    WriteReg(0x42, ReadReg(0x42) | 0b00011000);
+}
+
+void Axp2101::ClearInterrupts() {
+    // 中断状态写 1 清除，写 0 的位不受影响，三个寄存器一次写回
+    uint8_t status[3];
+    ReadRegs(0x48, status, sizeof(status));
+    if (status[0] != 0 || status[1] != 0 || status[2] != 0) {
+        WriteRegs(0x48, status, sizeof(status));
+    }
+}
+
 void Axp2101::PowerOff() {
     uint8_t value = ReadReg(0x10);
     value = value | 0x01;
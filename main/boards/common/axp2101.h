@@ -2,6 +2,7 @@
 #define __AXP2101_H__
 
 #include "i2c_device.h"
+#include "battery_monitor.h"
 
 class Axp2101 : public I2cDevice {
 public:
@@ -12,6 +13,11 @@ public:
     int GetBatteryLevel();
     float GetTemperature();
     void PowerOff();
+    // 给 BatteryMonitor 用：读出状态和电量，共两次 I2C 传输
+    bool ReadBatteryState(BatteryState& state);
+    // IRQ 脚在 VBUS 插拔、电池插拔、开始充电和充满时拉低
+    void EnableChargeInterrupts();
+    void ClearInterrupts();
 
 private:
     int GetBatteryCurrentDirection();
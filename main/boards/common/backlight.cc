@@ -1,32 +1,23 @@
 #include "backlight.h"
 #include "settings.h"
+#include "timer_service.h"
 
 #include <esp_log.h>
 #include <driver/ledc.h>
+#include <cstdlib>
 
 #define TAG "Backlight"
 
 
 Backlight::Backlight() {
-    // 创建背光渐变定时器
-    const esp_timer_create_args_t timer_args = {
-        .callback = [](void* arg) {
-            auto self = static_cast<Backlight*>(arg);
-            self->OnTransitionTimer();
-        },
-        .arg = this,
-        .dispatch_method = ESP_TIMER_TASK,
-        .name = "backlight_timer",
-        .skip_unhandled_events = true,
-    };
-    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &transition_timer_));
+    // 创建背光渐变定时器，硬件不支持渐变时使用
+    transition_timer_ = TimerService::GetInstance().Create("backlight_timer", [this]() {
+        OnTransitionTimer();
+    });
 }
 
 Backlight::~Backlight() {
-    if (transition_timer_ != nullptr) {
-        esp_timer_stop(transition_timer_);
-        esp_timer_delete(transition_timer_);
-    }
+    TimerService::GetInstance().Stop(transition_timer_);
 }
 
 void Backlight::RestoreBrightness() {
@@ -60,16 +51,21 @@ void Backlight::SetBrightness(uint8_t brightness, bool permanent) {
     target_brightness_ = brightness;
     step_ = (target_brightness_ > brightness_) ? 1 : -1;
 
-    if (transition_timer_ != nullptr) {
+    // 和逐级渐变的速度一样，每级 5ms
+    int duration_ms = abs(target_brightness_ - brightness_) * 5;
+    if (FadeTo(brightness, duration_ms)) {
+        TimerService::GetInstance().Stop(transition_timer_);
+        brightness_ = brightness;
+    } else {
         // 启动定时器，每 5ms 更新一次
-        esp_timer_start_periodic(transition_timer_, 5 * 1000);
+        TimerService::GetInstance().StartPeriodic(transition_timer_, 5);
     }
     ESP_LOGI(TAG, "Set brightness to %d", brightness);
 }
 
 void Backlight::OnTransitionTimer() {
     if (brightness_ == target_brightness_) {
-        esp_timer_stop(transition_timer_);
+        TimerService::GetInstance().Stop(transition_timer_);
         return;
     }
 
@@ -77,7 +73,7 @@ void Backlight::OnTransitionTimer() {
     SetBrightnessImpl(brightness_);
 
     if (brightness_ == target_brightness_) {
-        esp_timer_stop(transition_timer_);
+        TimerService::GetInstance().Stop(transition_timer_);
     }
 }
 
@@ -106,12 +102,34 @@ PwmBacklight::PwmBacklight(gpio_num_t pin, bool output_invert) : Backlight() {
         }
     };
     ESP_ERROR_CHECK(ledc_channel_config(&backlight_channel));
+
+    // 由 LEDC 硬件完成渐变，不用软件定时器每 5ms 唤醒一次；别的模块已经安装过时直接使用
+    auto err = ledc_fade_func_install(0);
+    hardware_fade_ = (err == ESP_OK || err == ESP_ERR_INVALID_STATE);
+    if (!hardware_fade_) {
+        ESP_LOGW(TAG, "LEDC fade not available: %s", esp_err_to_name(err));
+    }
 }
 
 PwmBacklight::~PwmBacklight() {
     ledc_stop(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, 0);
 }
 
+bool PwmBacklight::FadeTo(uint8_t brightness, int duration_ms) {
+    if (!hardware_fade_) {
+        return false;
+    }
+#if SOC_LEDC_SUPPORT_FADE_STOP
+    // 上一次渐变还没完成时从当前占空比开始新的渐变
+    ledc_fade_stop(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0);
+#endif
+    uint32_t duty_cycle = (1023 * brightness) / 100;
+    if (ledc_set_fade_with_time(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, duty_cycle, duration_ms) != ESP_OK) {
+        return false;
+    }
+    return ledc_fade_start(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, LEDC_FADE_NO_WAIT) == ESP_OK;
+}
+
 void PwmBacklight::SetBrightnessImpl(uint8_t brightness) {
     // LEDC resolution set to 10bits, thus: 100% = 1023
     uint32_t duty_cycle = (1023 * brightness) / 100;
@@ -19,8 +19,10 @@ public:
 protected:
     void OnTransitionTimer();
     virtual void SetBrightnessImpl(uint8_t brightness) = 0;
+    // 硬件能自己完成渐变时返回 true，不再由定时器每 5ms 设置一次
+    virtual bool FadeTo(uint8_t brightness, int duration_ms) { return false; }
 
-    esp_timer_handle_t transition_timer_ = nullptr;
+    int transition_timer_ = -1;
     uint8_t brightness_ = 0;
     uint8_t target_brightness_ = 0;
     uint8_t step_ = 1;
@@ -33,4 +35,8 @@ public:
     ~PwmBacklight();
 
     void SetBrightnessImpl(uint8_t brightness) override;
+    bool FadeTo(uint8_t brightness, int duration_ms) override;
+
+private:
+    bool hardware_fade_ = false;
 };
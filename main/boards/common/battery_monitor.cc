@@ -0,0 +1,129 @@
+#include "battery_monitor.h"
+#include "metrics.h"
+#include "timer_service.h"
+
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/timers.h>
+
+#include <algorithm>
+#include <cmath>
+
+#define TAG "BatteryMonitor"
+
+static MetricCounter metric_samples("battery.samples");
+static MetricCounter metric_interrupts("battery.interrupts");
+static MetricGauge metric_level("battery.level");
+
+BatteryMonitor::BatteryMonitor(Sampler sampler, uint32_t interval_ms)
+    : sampler_(std::move(sampler)), interval_ms_(interval_ms) {
+    // 电量变化很慢，允许推迟四分之一个采样间隔，和别的定时器合并唤醒
+    timer_ = TimerService::GetInstance().Create("battery_monitor", [this]() {
+        Sample();
+    }, interval_ms_ / 4);
+}
+
+BatteryMonitor::~BatteryMonitor() {
+    if (interrupt_gpio_ != GPIO_NUM_NC) {
+        gpio_isr_handler_remove(interrupt_gpio_);
+    }
+    if (interrupt_timer_ != -1) {
+        TimerService::GetInstance().Stop(interrupt_timer_);
+    }
+    TimerService::GetInstance().Stop(timer_);
+}
+
+void BatteryMonitor::OnChanged(std::function<void(const BatteryState& state)> callback) {
+    callback_ = callback;
+}
+
+void BatteryMonitor::EnableInterrupt(gpio_num_t gpio, std::function<void()> acknowledge) {
+    acknowledge_ = acknowledge;
+    // 和定时采样在同一个任务中执行，两路采样不会并发访问 PMIC
+    interrupt_timer_ = TimerService::GetInstance().Create("battery_irq", [this]() {
+        if (acknowledge_) {
+            acknowledge_();
+        }
+        Sample();
+    });
+
+    gpio_config_t config = {
+        .pin_bit_mask = 1ULL << gpio,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_NEGEDGE,
+    };
+    ESP_ERROR_CHECK(gpio_config(&config));
+    // 其它模块可能已经安装过 ISR 服务
+    auto err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Failed to install GPIO ISR service: %s", esp_err_to_name(err));
+        return;
+    }
+    ESP_ERROR_CHECK(gpio_isr_handler_add(gpio, InterruptHandler, this));
+    interrupt_gpio_ = gpio;
+    ESP_LOGI(TAG, "PMIC interrupt enabled on GPIO %d", gpio);
+}
+
+void IRAM_ATTR BatteryMonitor::InterruptHandler(void* arg) {
+    // I2C 不能在中断中访问，交给 FreeRTOS 定时器任务启动定时器，在 timer_service 任务中采样
+    BaseType_t woken = pdFALSE;
+    xTimerPendFunctionCallFromISR([](void* arg, uint32_t) {
+        auto self = static_cast<BatteryMonitor*>(arg);
+        metric_interrupts.Add();
+        TimerService::GetInstance().StartOnce(self->interrupt_timer_, 0);
+    }, arg, 0, &woken);
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+void BatteryMonitor::Start() {
+    Sample();
+    TimerService::GetInstance().StartPeriodic(timer_, interval_ms_);
+}
+
+BatteryState BatteryMonitor::GetState() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return state_;
+}
+
+void BatteryMonitor::Sample() {
+    BatteryState state;
+    if (!sampler_(state)) {
+        return;
+    }
+    metric_samples.Add();
+
+    bool changed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        changed = !has_state_ || state.charging != state_.charging || state.discharging != state_.discharging
+            || state.charging_done != state_.charging_done || state.external_power != state_.external_power;
+        // 充电状态变化时电压会跳变，重新开始滤波；放电时电量不回升，充电时不下降
+        if (changed) {
+            filtered_level_ = state.level;
+        } else {
+            filtered_level_ += (state.level - filtered_level_) / 4;
+        }
+        int level = std::clamp((int)lroundf(filtered_level_), 0, 100);
+        if (!changed && state.discharging) {
+            level = std::min(level, state_.level);
+        } else if (!changed && state.charging) {
+            level = std::max(level, state_.level);
+        }
+        state.level = level;
+        state_ = state;
+        has_state_ = true;
+    }
+    metric_level.Set(state.level);
+
+    if (changed) {
+        ESP_LOGI(TAG, "Battery %d%%, charging: %d, discharging: %d, done: %d, external power: %d",
+            state.level, state.charging, state.discharging, state.charging_done, state.external_power);
+        if (callback_) {
+            callback_(state);
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef BATTERY_MONITOR_H
+#define BATTERY_MONITOR_H
+
+#include <driver/gpio.h>
+#include <esp_timer.h>
+
+#include <functional>
+#include <mutex>
+
+// 每次采样的间隔，充电状态的变化可以通过 PMIC 中断立即更新
+#define BATTERY_SAMPLE_INTERVAL_MS 5000
+
+struct BatteryState {
+    int level = 0;
+    bool charging = false;
+    bool discharging = false;
+    bool charging_done = false;
+    bool external_power = false;
+};
+
+// 电池/PMIC 采样服务
+// 定时在 timer_service 任务中读一次 PMIC，保存滤波后的电量；GetBatteryLevel 直接读缓存，不再访问 I2C
+class BatteryMonitor {
+public:
+    // sampler 一次读出所有需要的寄存器，失败时返回 false
+    using Sampler = std::function<bool(BatteryState& state)>;
+
+    explicit BatteryMonitor(Sampler sampler, uint32_t interval_ms = BATTERY_SAMPLE_INTERVAL_MS);
+    ~BatteryMonitor();
+
+    // 充电、放电、充满或外部电源状态变化时回调，第一次采样也会回调；在采样所在的任务中执行
+    void OnChanged(std::function<void(const BatteryState& state)> callback);
+    // PMIC 中断脚（低电平有效）触发时立即采样，acknowledge 用来清除 PMIC 的中断状态
+    void EnableInterrupt(gpio_num_t gpio, std::function<void()> acknowledge);
+    // 第一次采样在调用者的任务中完成，之后定时采样
+    void Start();
+    BatteryState GetState();
+
+private:
+    Sampler sampler_;
+    uint32_t interval_ms_;
+    std::function<void(const BatteryState& state)> callback_;
+    std::function<void()> acknowledge_;
+    int timer_ = -1;
+    int interrupt_timer_ = -1;
+    gpio_num_t interrupt_gpio_ = GPIO_NUM_NC;
+
+    std::mutex mutex_;
+    BatteryState state_;
+    bool has_state_ = false;
+    float filtered_level_ = 0;
+
+    void Sample();
+    static void IRAM_ATTR InterruptHandler(void* arg);
+};
+
+#endif // BATTERY_MONITOR_H
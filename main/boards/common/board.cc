@@ -1,17 +1,25 @@
 #include "board.h"
 #include "system_info.h"
 #include "settings.h"
+#include "boot_profiler.h"
+#if CONFIG_CRASH_RING
+#include "crash_ring.h"
+#endif
 #include "display/display.h"
+#include "audio_codec.h"
 #include "assets/lang_config.h"
 
 #include <esp_log.h>
 #include <esp_ota_ops.h>
 #include <esp_chip_info.h>
 #include <esp_random.h>
+#include <cJSON.h>
 
 #define TAG "Board"
 
 Board::Board() {
+    // 派生类的构造函数（屏幕、音频、外设初始化）在这之后执行，到 board_ready 结束
+    BootProfiler::GetInstance().Mark("board_init");
     Settings settings("board", true);
     uuid_ = settings.GetString("uuid");
     if (uuid_.empty()) {
@@ -66,49 +74,9 @@ Led* Board::GetLed() {
     return &led;
 }
 
-std::string Board::GetJson() {
-    /* 
-        {
-            "version": 2,
-            "flash_size": 4194304,
-            "psram_size": 0,
-            "minimum_free_heap_size": 123456,
-            "mac_address": "00:00:00:00:00:00",
-            "uuid": "00000000-0000-0000-0000-000000000000",
-            "chip_model_name": "esp32s3",
-            "chip_info": {
-                "model": 1,
-                "cores": 2,
-                "revision": 0,
-                "features": 0
-            },
-            "application": {
-                "name": "my-app",
-                "version": "1.0.0",
-                "compile_time": "2021-01-01T00:00:00Z"
-                "idf_version": "4.2-dev"
-                "elf_sha256": ""
-            },
-            "partition_table": [
-                "app": {
-                    "label": "app",
-                    "type": 1,
-                    "subtype": 2,
-                    "address": 0x10000,
-                    "size": 0x100000
-                }
-            ],
-            "ota": {
-                "label": "ota_0"
-            },
-            "board": {
-                ...
-            }
-        }
-    */
-    std::string json = R"({"version":2,"language":")" + std::string(Lang::CODE) + R"(",)";
-    json += R"("flash_size":)" + std::to_string(SystemInfo::GetFlashSize()) + R"(,)";
-    json += R"("minimum_free_heap_size":")" + std::to_string(SystemInfo::GetMinimumFreeHeapSize()) + R"(",)";
+// GetJson 中 flash 大小到 ota 这一段，以逗号结尾
+std::string Board::BuildStaticJson() {
+    std::string json = R"("flash_size":)" + std::to_string(SystemInfo::GetFlashSize()) + R"(,)";
     json += R"("mac_address":")" + SystemInfo::GetMacAddress() + R"(",)";
     json += R"("uuid":")" + uuid_ + R"(",)";
     json += R"("chip_model_name":")" + SystemInfo::GetChipModelName() + R"(",)";
@@ -151,12 +119,143 @@ std::string Board::GetJson() {
 
     json += R"("ota":{)";
     auto ota_partition = esp_ota_get_running_partition();
-    json += R"("label":")" + std::string(ota_partition->label) + R"(")";
+    json += R"("label":")" + std::string(ota_partition->label) + R"(",)";
+    // 支持的升级包格式，服务器据此决定是否下发 firmware.delta / firmware.compressed
+    json += R"("delta":true,"compression":["lzss"])";
     json += R"(},)";
 
+    return json;
+}
+
+std::string Board::GetJson() {
+    /* 
+        {
+            "version": 2,
+            "flash_size": 4194304,
+            "psram_size": 0,
+            "minimum_free_heap_size": 123456,
+            "mac_address": "00:00:00:00:00:00",
+            "uuid": "00000000-0000-0000-0000-000000000000",
+            "chip_model_name": "esp32s3",
+            "chip_info": {
+                "model": 1,
+                "cores": 2,
+                "revision": 0,
+                "features": 0
+            },
+            "application": {
+                "name": "my-app",
+                "version": "1.0.0",
+                "compile_time": "2021-01-01T00:00:00Z"
+                "idf_version": "4.2-dev"
+                "elf_sha256": ""
+            },
+            "partition_table": [
+                "app": {
+                    "label": "app",
+                    "type": 1,
+                    "subtype": 2,
+                    "address": 0x10000,
+                    "size": 0x100000
+                }
+            ],
+            "ota": {
+                "label": "ota_0",
+                "delta": true,
+                "compression": ["lzss"]
+            },
+            "boot": {
+                "app_main": 320,
+                "nvs_init": 335,
+                ...
+            },
+            "board": {
+                ...
+            }
+        }
+    */
+    // 芯片、固件和分区表启动后不会变化，第一次生成后缓存起来，之后只拼接会变化的字段
+    if (static_json_.empty()) {
+        static_json_ = BuildStaticJson();
+    }
+    std::string json = R"({"version":2,"language":")" + std::string(Lang::CODE) + R"(",)";
+    json += R"("minimum_free_heap_size":")" + std::to_string(SystemInfo::GetMinimumFreeHeapSize()) + R"(",)";
+    json += static_json_;
+
+    // 启动各节点的时间，用于比较不同版本和板子的冷启动耗时
+    json += R"("boot":)" + BootProfiler::GetInstance().GetJson() + R"(,)";
+#if CONFIG_CRASH_RING
+    // 上一次异常复位前的性能记录，服务器收到后清除
+    auto& last_reset = CrashRing::GetInstance().report();
+    if (!last_reset.empty()) {
+        json += R"("last_reset":)" + last_reset + R"(,)";
+    }
+#endif
+
     json += R"("board":)" + GetBoardJson();
 
     // Close the JSON object
     json += R"(})";
     return json;
-}
\ No newline at end of file
+}
+std::string Board::GetDeviceStatusJson() {
+    auto codec = GetAudioCodec();
+    auto backlight = GetBacklight();
+    auto display = GetDisplay();
+    int volume = codec != nullptr ? codec->output_volume() : -1;
+    int brightness = backlight != nullptr ? backlight->brightness() : -1;
+    std::string theme = display != nullptr ? display->GetTheme() : "";
+
+    {
+        std::lock_guard<std::mutex> lock(device_status_mutex_);
+        if (!device_status_json_.empty()) {
+            if (volume != device_status_volume_ || brightness != device_status_brightness_ || theme != device_status_theme_) {
+                PatchDeviceStatus(volume, brightness, theme);
+            }
+            return device_status_json_;
+        }
+    }
+    RefreshDeviceStatus();
+    std::lock_guard<std::mutex> lock(device_status_mutex_);
+    return device_status_json_;
+}
+
+void Board::RefreshDeviceStatus() {
+    // 读外设不持锁，查询仍然可以拿到旧的快照
+    auto json = BuildDeviceStatusJson();
+    auto codec = GetAudioCodec();
+    auto backlight = GetBacklight();
+    auto display = GetDisplay();
+    std::lock_guard<std::mutex> lock(device_status_mutex_);
+    device_status_json_ = std::move(json);
+    device_status_volume_ = codec != nullptr ? codec->output_volume() : -1;
+    device_status_brightness_ = backlight != nullptr ? backlight->brightness() : -1;
+    device_status_theme_ = display != nullptr ? display->GetTheme() : "";
+}
+
+// 只改快照中已有的字段，字段是否存在仍由 BuildDeviceStatusJson 决定
+void Board::PatchDeviceStatus(int volume, int brightness, const std::string& theme) {
+    auto root = cJSON_Parse(device_status_json_.c_str());
+    if (root == nullptr) {
+        return;
+    }
+    auto audio_speaker = cJSON_GetObjectItem(root, "audio_speaker");
+    if (cJSON_GetObjectItem(audio_speaker, "volume") != nullptr) {
+        cJSON_ReplaceItemInObject(audio_speaker, "volume", cJSON_CreateNumber(volume));
+    }
+    auto screen = cJSON_GetObjectItem(root, "screen");
+    if (cJSON_GetObjectItem(screen, "brightness") != nullptr) {
+        cJSON_ReplaceItemInObject(screen, "brightness", cJSON_CreateNumber(brightness));
+    }
+    if (cJSON_GetObjectItem(screen, "theme") != nullptr) {
+        cJSON_ReplaceItemInObject(screen, "theme", cJSON_CreateString(theme.c_str()));
+    }
+    auto json_str = cJSON_PrintUnformatted(root);
+    device_status_json_ = json_str;
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+
+    device_status_volume_ = volume;
+    device_status_brightness_ = brightness;
+    device_status_theme_ = theme;
+}
@@ -5,11 +5,13 @@
 #include <web_socket.h>
 #include <mqtt.h>
 #include <udp.h>
+#include <mutex>
 #include <string>
 
 #include "led/led.h"
 #include "backlight.h"
 #include "camera.h"
+#include "afe_profile.h"
 
 void* create_board();
 class AudioCodec;
@@ -19,6 +21,18 @@ private:
     Board(const Board&) = delete; // 禁用拷贝构造函数
     Board& operator=(const Board&) = delete; // 禁用赋值操作
 
+    // 设备状态快照和生成快照时的音量、亮度、主题
+    std::mutex device_status_mutex_;
+    std::string device_status_json_;
+    int device_status_volume_ = -1;
+    int device_status_brightness_ = -1;
+    std::string device_status_theme_;
+    // GetJson 中启动后不再变化的部分
+    std::string static_json_;
+
+    std::string BuildStaticJson();
+    void PatchDeviceStatus(int volume, int brightness, const std::string& theme);
+
 protected:
     Board();
     std::string GenerateUuid();
@@ -50,10 +64,25 @@ public:
     virtual bool GetBatteryLevel(int &level, bool& charging, bool& discharging);
     virtual std::string GetJson();
     virtual void SetPowerSaveMode(bool enabled) = 0;
+    // 有备用网络的板子切换网络（可能需要重启），返回 false 表示不支持
+    // allow_restart 为 false 时只做不需要重启的切换，不能切换返回 false
+    virtual bool SwitchToBackupNetwork(bool allow_restart = true) { return false; }
+    // 上行音频每次网络发送至少合并的帧数，单次发送开销大的网络（4G 模组的 AT 命令）可以调大
+    virtual int GetUplinkBatchFrames() { return 1; }
+    // 创建 AFE 时使用的档位，默认来自 Kconfig
+    virtual AfeProfile GetAfeProfile() { return AfeProfile::Default(); }
     virtual std::string GetBoardJson() = 0;
-    virtual std::string GetDeviceStatusJson() = 0;
+    // 读取完整的设备状态，可能要访问电量计、温度传感器和 4G 模组
+    virtual std::string BuildDeviceStatusJson() = 0;
+    // 返回缓存的设备状态快照，MCP 工具线程不用等外设读取；音量、亮度、主题在快照之后变化时就地修补
+    // 第一次调用时同步生成快照
+    std::string GetDeviceStatusJson();
+    // 重新生成快照，由时钟定时器在空闲时每 DEVICE_STATUS_REFRESH_SECONDS 秒调用一次
+    void RefreshDeviceStatus();
 };
 
+#define DEVICE_STATUS_REFRESH_SECONDS 10
+
 #define DECLARE_BOARD(BOARD_CLASS_NAME) \
 void* create_board() { \
     return new BOARD_CLASS_NAME(); \
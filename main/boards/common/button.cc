@@ -1,5 +1,7 @@
 #include "button.h"
 
+#include "input_events.h"
+
 #include <button_gpio.h>
 #include <esp_log.h>
 
@@ -33,9 +35,43 @@ Button::Button(gpio_num_t gpio_num, bool active_high, uint16_t long_press_time,
         .disable_pull = false
     };
     ESP_ERROR_CHECK(iot_button_new_gpio_device(&button_config, &gpio_config, &button_handle_));
+#if SOC_GPIO_SUPPORT_PIN_GLITCH_FILTER
+    // 硬件滤掉输入上的窄毛刺，机械抖动仍由 iot_button 的消抖处理
+    gpio_pin_glitch_filter_config_t filter_config = {
+        .clk_src = GLITCH_FILTER_CLK_SRC_DEFAULT,
+        .gpio_num = gpio_num,
+    };
+    if (gpio_new_pin_glitch_filter(&filter_config, &glitch_filter_) == ESP_OK) {
+        gpio_glitch_filter_enable(glitch_filter_);
+    }
+#endif
+}
+
+// 在主循环中调用（主循环启动前在驱动回调中调用）
+void Button::Dispatch(void* source, const InputEvent& event) {
+    Button* button = static_cast<Button*>(source);
+    std::function<void()>* callback = nullptr;
+    switch (event.type) {
+        case kInputPressDown: callback = &button->on_press_down_; break;
+        case kInputPressUp: callback = &button->on_press_up_; break;
+        case kInputLongPress: callback = &button->on_long_press_; break;
+        case kInputClick: callback = &button->on_click_; break;
+        case kInputDoubleClick: callback = &button->on_double_click_; break;
+        case kInputMultipleClick: callback = &button->on_multiple_click_; break;
+        default: break;
+    }
+    if (callback != nullptr && *callback) {
+        (*callback)();
+    }
 }
 
 Button::~Button() {
+#if SOC_GPIO_SUPPORT_PIN_GLITCH_FILTER
+    if (glitch_filter_ != nullptr) {
+        gpio_glitch_filter_disable(glitch_filter_);
+        gpio_del_glitch_filter(glitch_filter_);
+    }
+#endif
     if (button_handle_ != NULL) {
         iot_button_delete(button_handle_);
     }
@@ -47,10 +83,7 @@ void Button::OnPressDown(std::function<void()> callback) {
     }
     on_press_down_ = callback;
     iot_button_register_cb(button_handle_, BUTTON_PRESS_DOWN, nullptr, [](void* handle, void* usr_data) {
-        Button* button = static_cast<Button*>(usr_data);
-        if (button->on_press_down_) {
-            button->on_press_down_();
-        }
+        InputEvents::GetInstance().Post(usr_data, Dispatch, kInputPressDown);
     }, this);
 }
 
@@ -60,10 +93,7 @@ void Button::OnPressUp(std::function<void()> callback) {
     }
     on_press_up_ = callback;
     iot_button_register_cb(button_handle_, BUTTON_PRESS_UP, nullptr, [](void* handle, void* usr_data) {
-        Button* button = static_cast<Button*>(usr_data);
-        if (button->on_press_up_) {
-            button->on_press_up_();
-        }
+        InputEvents::GetInstance().Post(usr_data, Dispatch, kInputPressUp);
     }, this);
 }
 
@@ -73,10 +103,7 @@ void Button::OnLongPress(std::function<void()> callback) {
     }
     on_long_press_ = callback;
     iot_button_register_cb(button_handle_, BUTTON_LONG_PRESS_START, nullptr, [](void* handle, void* usr_data) {
-        Button* button = static_cast<Button*>(usr_data);
-        if (button->on_long_press_) {
-            button->on_long_press_();
-        }
+        InputEvents::GetInstance().Post(usr_data, Dispatch, kInputLongPress);
     }, this);
 }
 
@@ -86,10 +113,7 @@ void Button::OnClick(std::function<void()> callback) {
     }
     on_click_ = callback;
     iot_button_register_cb(button_handle_, BUTTON_SINGLE_CLICK, nullptr, [](void* handle, void* usr_data) {
-        Button* button = static_cast<Button*>(usr_data);
-        if (button->on_click_) {
-            button->on_click_();
-        }
+        InputEvents::GetInstance().Post(usr_data, Dispatch, kInputClick);
     }, this);
 }
 
@@ -99,10 +123,7 @@ void Button::OnDoubleClick(std::function<void()> callback) {
     }
     on_double_click_ = callback;
     iot_button_register_cb(button_handle_, BUTTON_DOUBLE_CLICK, nullptr, [](void* handle, void* usr_data) {
-        Button* button = static_cast<Button*>(usr_data);
-        if (button->on_double_click_) {
-            button->on_double_click_();
-        }
+        InputEvents::GetInstance().Post(usr_data, Dispatch, kInputDoubleClick);
     }, this);
 }
 
@@ -117,9 +138,6 @@ void Button::OnMultipleClick(std::function<void()> callback, uint8_t click_count
         }
     };
     iot_button_register_cb(button_handle_, BUTTON_MULTIPLE_CLICK, &event_args, [](void* handle, void* usr_data) {
-        Button* button = static_cast<Button*>(usr_data);
-        if (button->on_multiple_click_) {
-            button->on_multiple_click_();
-        }
+        InputEvents::GetInstance().Post(usr_data, Dispatch, kInputMultipleClick);
     }, this);
 }
\ No newline at end of file
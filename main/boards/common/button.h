@@ -8,6 +8,12 @@
 #include <button_gpio.h>
 #include <functional>
 
+#if SOC_GPIO_SUPPORT_PIN_GLITCH_FILTER
+#include <driver/gpio_filter.h>
+#endif
+
+struct InputEvent;
+
 class Button {
 public:
     Button(button_handle_t button_handle);
@@ -24,6 +30,9 @@ public:
 protected:
     gpio_num_t gpio_num_;
     button_handle_t button_handle_ = nullptr;
+#if SOC_GPIO_SUPPORT_PIN_GLITCH_FILTER
+    gpio_glitch_filter_handle_t glitch_filter_ = nullptr;
+#endif
 
     std::function<void()> on_press_down_;
     std::function<void()> on_press_up_;
@@ -31,6 +40,9 @@ protected:
     std::function<void()> on_click_;
     std::function<void()> on_double_click_;
     std::function<void()> on_multiple_click_;
+
+    // 驱动回调只把事件放进 InputEvents，由这里调用对应的回调
+    static void Dispatch(void* source, const InputEvent& event);
 };
 
 #if CONFIG_SOC_ADC_SUPPORTED
@@ -2,6 +2,10 @@
 #define CAMERA_H
 
 #include <string>
+#include <functional>
+
+// 识别结果的部分文本，服务器边返回边回调
+using ExplainPartialCallback = std::function<void(const std::string& text)>;
 
 class Camera {
 public:
@@ -9,7 +13,11 @@ public:
     virtual bool Capture() = 0;
     virtual bool SetHMirror(bool enabled) = 0;
     virtual bool SetVFlip(bool enabled) = 0;
-    virtual std::string Explain(const std::string& question) = 0;
+    virtual std::string Explain(const std::string& question, ExplainPartialCallback on_partial = nullptr) = 0;
+    // 对话进行中为 true，摄像头可以保持采集以便随时拍照
+    virtual void SetActive(bool active) {}
+    // 内存紧张时释放预览图，拍照时也不再生成预览
+    virtual void SetLowMemory(bool low_memory) {}
 };
 
 #endif // CAMERA_H
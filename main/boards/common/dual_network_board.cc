@@ -3,7 +3,9 @@
 #include "display.h"
 #include "assets/lang_config.h"
 #include "settings.h"
+#include "task_stack.h"
 #include <esp_log.h>
+#include <wifi_station.h>
 
 static const char *TAG = "DualNetworkBoard";
 
@@ -42,6 +44,59 @@ void DualNetworkBoard::InitializeCurrentBoard() {
     }
 }
 
+bool DualNetworkBoard::SwitchToBackupNetwork(bool allow_restart) {
+#if CONFIG_DUAL_NETWORK_HOT_STANDBY
+    if (IsStandbyReady()) {
+        // 原来的板卡留作待机，已经创建的连接对象仍然有效，由协议层关闭后重建
+        std::swap(current_board_, standby_board_);
+        network_type_ = StandbyType();
+        SaveNetworkTypeToSettings(network_type_);
+        standby_board_->SetPowerSaveMode(true);
+        ESP_LOGI(TAG, "Switched to %s without restart", network_type_ == NetworkType::ML307 ? "ML307" : "WiFi");
+        GetDisplay()->ShowNotification(network_type_ == NetworkType::ML307 ?
+            Lang::Strings::SWITCH_TO_4G_NETWORK : Lang::Strings::SWITCH_TO_WIFI_NETWORK);
+        return true;
+    }
+    ESP_LOGW(TAG, "Standby network is not ready");
+#endif
+    if (!allow_restart) {
+        return false;
+    }
+    SwitchNetworkType();
+    return true;
+}
+
+#if CONFIG_DUAL_NETWORK_HOT_STANDBY
+// 待机网络在后台任务中启动，不显示状态也不进入配网模式，注册不上就一直处于未就绪
+void DualNetworkBoard::StartStandbyBoard() {
+    if (StandbyType() == NetworkType::ML307) {
+        standby_board_ = std::make_unique<Ml307Board>(ml307_tx_pin_, ml307_rx_pin_, ml307_rx_buffer_size_);
+    } else {
+        standby_board_ = std::make_unique<WifiBoard>();
+    }
+    // 启动 Wi-Fi 会写 NVS，栈放在内部 SRAM
+    auto board = standby_board_.get();
+    bool ml307 = StandbyType() == NetworkType::ML307;
+    TaskStack::Create("standby_net", 4096, 2, kTaskStackInternal, [board, ml307]() {
+        if (ml307) {
+            static_cast<Ml307Board*>(board)->StartStandbyNetwork();
+        } else {
+            static_cast<WifiBoard*>(board)->StartStandbyNetwork();
+        }
+    });
+}
+
+bool DualNetworkBoard::IsStandbyReady() {
+    if (!standby_board_) {
+        return false;
+    }
+    if (StandbyType() == NetworkType::ML307) {
+        return static_cast<Ml307Board*>(standby_board_.get())->IsNetworkReady();
+    }
+    return WifiStation::GetInstance().IsConnected();
+}
+#endif
+
 void DualNetworkBoard::SwitchNetworkType() {
     auto display = GetDisplay();
     if (network_type_ == NetworkType::WIFI) {    
@@ -70,6 +125,9 @@ void DualNetworkBoard::StartNetwork() {
         display->SetStatus(Lang::Strings::DETECTING_MODULE);
     }
     current_board_->StartNetwork();
+#if CONFIG_DUAL_NETWORK_HOT_STANDBY
+    StartStandbyBoard();
+#endif
 }
 
 Http* DualNetworkBoard::CreateHttp() {
@@ -100,6 +158,6 @@ std::string DualNetworkBoard::GetBoardJson() {
     return current_board_->GetBoardJson();
 }
 
-std::string DualNetworkBoard::GetDeviceStatusJson() {
-    return current_board_->GetDeviceStatusJson();
+std::string DualNetworkBoard::BuildDeviceStatusJson() {
+    return current_board_->BuildDeviceStatusJson();
 }
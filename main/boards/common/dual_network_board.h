@@ -32,6 +32,14 @@ private:
 
     // 初始化当前网络类型对应的板卡
     void InitializeCurrentBoard();
+
+#if CONFIG_DUAL_NETWORK_HOT_STANDBY
+    // 另一种网络保持注册并处于低功耗待机，主网络变差时直接换过去，不需要重启
+    std::unique_ptr<Board> standby_board_;
+    NetworkType StandbyType() const { return network_type_ == NetworkType::ML307 ? NetworkType::WIFI : NetworkType::ML307; }
+    void StartStandbyBoard();
+    bool IsStandbyReady();
+#endif
  
 public:
     DualNetworkBoard(gpio_num_t ml307_tx_pin, gpio_num_t ml307_rx_pin, size_t ml307_rx_buffer_size = 4096, int32_t default_net_type = 1);
@@ -39,6 +47,7 @@ public:
  
     // 切换网络类型
     void SwitchNetworkType();
+    virtual bool SwitchToBackupNetwork(bool allow_restart = true) override;
     
     // 获取当前网络类型
     NetworkType GetNetworkType() const { return network_type_; }
@@ -55,8 +64,9 @@ public:
     virtual Udp* CreateUdp() override;
     virtual const char* GetNetworkStateIcon() override;
     virtual void SetPowerSaveMode(bool enabled) override;
+    virtual int GetUplinkBatchFrames() override { return current_board_->GetUplinkBatchFrames(); }
     virtual std::string GetBoardJson() override;
-    virtual std::string GetDeviceStatusJson() override;
+    virtual std::string BuildDeviceStatusJson() override;
 };
 
 #endif // DUAL_NETWORK_BOARD_H 
\ No newline at end of file
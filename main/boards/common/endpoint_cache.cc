@@ -0,0 +1,321 @@
+#include "endpoint_cache.h"
+#include "settings.h"
+#include "task_stack.h"
+#include "metrics.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <lwip/sockets.h>
+#include <lwip/netdb.h>
+#include <fcntl.h>
+#include <ctime>
+#include <algorithm>
+
+#define TAG "EndpointCache"
+
+// 早于这个时间说明还没有同步时钟
+#define ENDPOINT_CACHE_MIN_VALID_TIME 1700000000
+
+static MetricCounter metric_hits("endpoint.cache_hits");
+static MetricCounter metric_misses("endpoint.cache_misses");
+// 缓存的地址连不上，重新解析后再连
+static MetricCounter metric_stale_retries("endpoint.stale_retries");
+// 最终连上的不是第一个地址
+static MetricCounter metric_fallbacks("endpoint.fallbacks");
+static MetricHistogram metric_resolve_us("endpoint.resolve_us", METRIC_NETWORK_US_BOUNDS);
+static MetricHistogram metric_connect_us("endpoint.connect_us", METRIC_NETWORK_US_BOUNDS);
+
+std::string EndpointCache::HostOf(const std::string& url) {
+    size_t start = url.find("://");
+    start = start == std::string::npos ? 0 : start + 3;
+    size_t end = url.find_first_of(":/", start);
+    return url.substr(start, end == std::string::npos ? std::string::npos : end - start);
+}
+
+std::string EndpointCache::NvsKey(const std::string& host) {
+    // NVS 的 key 最长 15 个字符，用主机名的 FNV-1a 哈希
+    uint32_t hash = 2166136261u;
+    for (char c : host) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+    }
+    char key[12];
+    snprintf(key, sizeof(key), "h%08lx", static_cast<unsigned long>(hash));
+    return key;
+}
+
+bool EndpointCache::IsFresh(const Entry& entry) const {
+    int64_t now = time(nullptr);
+    return entry.resolved_time > 0 && now >= ENDPOINT_CACHE_MIN_VALID_TIME &&
+        now - entry.resolved_time < CONFIG_ENDPOINT_CACHE_TTL_SECONDS;
+}
+
+bool EndpointCache::Lookup(const std::string& host, Entry& entry) {
+#if CONFIG_ENDPOINT_CACHE
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(host);
+    if (it != entries_.end()) {
+        entry = it->second;
+        return true;
+    }
+    // 格式：解析时间|地址,地址
+    Settings settings("endpoints", false);
+    auto value = settings.GetString(NvsKey(host));
+    size_t sep = value.find('|');
+    if (sep == std::string::npos) {
+        return false;
+    }
+    Entry loaded;
+    loaded.resolved_time = strtoll(value.c_str(), nullptr, 10);
+    size_t pos = sep + 1;
+    while (pos < value.size() && loaded.addresses.size() < ENDPOINT_CACHE_MAX_ADDRESSES) {
+        size_t comma = value.find(',', pos);
+        auto text = value.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+        struct in_addr addr;
+        if (inet_aton(text.c_str(), &addr)) {
+            loaded.addresses.push_back(addr.s_addr);
+        }
+        if (comma == std::string::npos) {
+            break;
+        }
+        pos = comma + 1;
+    }
+    if (loaded.addresses.empty()) {
+        return false;
+    }
+    entries_[host] = loaded;
+    entry = loaded;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void EndpointCache::Store(const std::string& host, const Entry& entry) {
+#if CONFIG_ENDPOINT_CACHE
+    std::string value = std::to_string(entry.resolved_time) + "|";
+    for (size_t i = 0; i < entry.addresses.size(); i++) {
+        struct in_addr addr;
+        addr.s_addr = entry.addresses[i];
+        char text[INET_ADDRSTRLEN];
+        inet_ntoa_r(addr, text, sizeof(text));
+        if (i > 0) {
+            value += ",";
+        }
+        value += text;
+    }
+    bool changed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& cached = entries_[host];
+        changed = cached.addresses != entry.addresses;
+        cached = entry;
+    }
+    // 地址没变时十分钟内不重复写，由 Settings 合并提交
+    Settings settings("endpoints", true);
+    auto old = settings.GetString(NvsKey(host));
+    if (changed || old.empty() || entry.resolved_time - strtoll(old.c_str(), nullptr, 10) > 600) {
+        settings.SetString(NvsKey(host), value);
+    }
+#endif
+}
+
+bool EndpointCache::Resolve(const std::string& host, Entry& entry) {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    struct addrinfo* result = nullptr;
+    int64_t start = esp_timer_get_time();
+    int ret = getaddrinfo(host.c_str(), nullptr, &hints, &result);
+    metric_resolve_us.Record(esp_timer_get_time() - start);
+    if (ret != 0 || result == nullptr) {
+        ESP_LOGE(TAG, "Failed to resolve %s: %d", host.c_str(), ret);
+        return false;
+    }
+
+    entry.addresses.clear();
+    for (auto info = result; info != nullptr && entry.addresses.size() < ENDPOINT_CACHE_MAX_ADDRESSES; info = info->ai_next) {
+        auto address = reinterpret_cast<struct sockaddr_in*>(info->ai_addr)->sin_addr.s_addr;
+        if (std::find(entry.addresses.begin(), entry.addresses.end(), address) == entry.addresses.end()) {
+            entry.addresses.push_back(address);
+        }
+    }
+    freeaddrinfo(result);
+    if (entry.addresses.empty()) {
+        return false;
+    }
+    int64_t now = time(nullptr);
+    entry.resolved_time = now >= ENDPOINT_CACHE_MIN_VALID_TIME ? now : 0;
+    Store(host, entry);
+    return true;
+}
+
+void EndpointCache::RefreshInBackground(const std::string& host) {
+    TaskStack::Create("dns_refresh", 4096, 1, kTaskStackPsram, [this, host]() {
+        Entry entry;
+        Resolve(host, entry);
+    });
+}
+
+void EndpointCache::Prefetch(std::vector<std::string> hosts) {
+    TaskStack::Create("dns_prefetch", 4096, 1, kTaskStackPsram, [this, hosts = std::move(hosts)]() {
+        for (auto& host : hosts) {
+            Entry entry;
+            if (!host.empty() && Resolve(host, entry)) {
+                ESP_LOGI(TAG, "Prefetched %s (%u addresses)", host.c_str(), (unsigned)entry.addresses.size());
+            }
+        }
+    });
+}
+
+int EndpointCache::Connect(const std::string& host, int port, int type, std::function<void(int fd)> configure) {
+    struct in_addr literal;
+    Entry entry;
+    bool from_cache = false;
+    if (inet_aton(host.c_str(), &literal)) {
+        entry.addresses.push_back(literal.s_addr);
+    } else if (Lookup(host, entry)) {
+        from_cache = true;
+        metric_hits.Add();
+    } else {
+        metric_misses.Add();
+        if (!Resolve(host, entry)) {
+            return -1;
+        }
+    }
+
+    int64_t start = esp_timer_get_time();
+    int fd = -1;
+    if (type == SOCK_STREAM) {
+        fd = RaceConnect(entry.addresses, port, configure);
+        if (fd < 0 && from_cache) {
+            // 缓存的地址可能已经失效
+            metric_stale_retries.Add();
+            auto old_addresses = entry.addresses;
+            if (Resolve(host, entry) && entry.addresses != old_addresses) {
+                fd = RaceConnect(entry.addresses, port, configure);
+            }
+            from_cache = false;
+        }
+    } else {
+        // UDP 没有握手，直接使用第一个地址
+        fd = socket(AF_INET, type, 0);
+        if (fd >= 0) {
+            if (configure) {
+                configure(fd);
+            }
+            struct sockaddr_in addr = {};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(port);
+            addr.sin_addr.s_addr = entry.addresses[0];
+            if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+                ESP_LOGE(TAG, "Failed to connect UDP socket: %d", errno);
+                close(fd);
+                fd = -1;
+            }
+        }
+    }
+    if (fd < 0) {
+        ESP_LOGE(TAG, "Failed to connect to %s:%d", host.c_str(), port);
+        return -1;
+    }
+    metric_connect_us.Record(esp_timer_get_time() - start);
+    if (from_cache && !IsFresh(entry)) {
+        RefreshInBackground(host);
+    }
+    return fd;
+}
+
+int EndpointCache::RaceConnect(const std::vector<uint32_t>& addresses, int port, const std::function<void(int)>& configure) {
+    struct Attempt {
+        int fd;
+        size_t index;
+    };
+    std::vector<Attempt> attempts;
+    size_t next = 0;
+    int winner = -1;
+    size_t winner_index = 0;
+    int64_t now = esp_timer_get_time();
+    int64_t deadline = now + ENDPOINT_CONNECT_TIMEOUT_MS * 1000LL;
+    int64_t next_start = now;
+
+    while (winner < 0 && now < deadline) {
+        if (next < addresses.size() && now >= next_start) {
+            int fd = socket(AF_INET, SOCK_STREAM, 0);
+            if (fd >= 0) {
+                if (configure) {
+                    configure(fd);
+                }
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+                struct sockaddr_in addr = {};
+                addr.sin_family = AF_INET;
+                addr.sin_port = htons(port);
+                addr.sin_addr.s_addr = addresses[next];
+                int ret = connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+                if (ret == 0) {
+                    winner = fd;
+                    winner_index = next;
+                    break;
+                } else if (errno == EINPROGRESS) {
+                    attempts.push_back({fd, next});
+                } else {
+                    close(fd);
+                }
+            }
+            next++;
+            next_start = now + ENDPOINT_CONNECT_STAGGER_MS * 1000LL;
+        }
+        if (attempts.empty()) {
+            if (next >= addresses.size()) {
+                break;
+            }
+            // 前面的地址都已经失败，不用再等
+            next_start = now;
+            continue;
+        }
+
+        // 等到有连接完成，或者该发起下一个地址的连接
+        int64_t wait_until = next < addresses.size() ? std::min(next_start, deadline) : deadline;
+        int64_t wait_us = std::max<int64_t>(wait_until - esp_timer_get_time(), 0);
+        fd_set write_fds;
+        FD_ZERO(&write_fds);
+        int max_fd = -1;
+        for (auto& attempt : attempts) {
+            FD_SET(attempt.fd, &write_fds);
+            max_fd = std::max(max_fd, attempt.fd);
+        }
+        struct timeval timeout = {
+            .tv_sec = static_cast<time_t>(wait_us / 1000000),
+            .tv_usec = static_cast<suseconds_t>(wait_us % 1000000),
+        };
+        if (select(max_fd + 1, nullptr, &write_fds, nullptr, &timeout) > 0) {
+            for (auto it = attempts.begin(); it != attempts.end();) {
+                if (!FD_ISSET(it->fd, &write_fds)) {
+                    ++it;
+                    continue;
+                }
+                int error = 0;
+                socklen_t length = sizeof(error);
+                getsockopt(it->fd, SOL_SOCKET, SO_ERROR, &error, &length);
+                if (error == 0 && winner < 0) {
+                    winner = it->fd;
+                    winner_index = it->index;
+                } else {
+                    close(it->fd);
+                }
+                it = attempts.erase(it);
+            }
+        }
+        now = esp_timer_get_time();
+    }
+
+    for (auto& attempt : attempts) {
+        close(attempt.fd);
+    }
+    if (winner < 0) {
+        return -1;
+    }
+    fcntl(winner, F_SETFL, fcntl(winner, F_GETFL, 0) & ~O_NONBLOCK);
+    if (winner_index > 0) {
+        metric_fallbacks.Add();
+    }
+    return winner;
+}
@@ -0,0 +1,57 @@
+#ifndef ENDPOINT_CACHE_H
+#define ENDPOINT_CACHE_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 每个主机名最多缓存的 IPv4 地址数
+#define ENDPOINT_CACHE_MAX_ADDRESSES 4
+// 前一个地址还没连上时，隔这么久开始尝试下一个地址（RFC 8305 的 Connection Attempt Delay）
+#define ENDPOINT_CONNECT_STAGGER_MS 250
+#define ENDPOINT_CONNECT_TIMEOUT_MS 5000
+
+// 主机名到 IP 地址的缓存，保存在 NVS 中，重启后第一次连接不用等 DNS
+// 过期的地址仍然先拿来连接，连接成功后在后台重新解析；连不上时立即重新解析再试一次
+// 连接时按 happy-eyeballs 的方式每隔 ENDPOINT_CONNECT_STAGGER_MS 向下一个地址发起连接，使用最先连上的一个
+class EndpointCache {
+public:
+    static EndpointCache& GetInstance() {
+        static EndpointCache instance;
+        return instance;
+    }
+
+    // 创建 socket 并连接 host:port，configure 在 connect 之前调用，用来设置 socket 选项
+    // 返回阻塞模式的 fd，失败返回 -1
+    int Connect(const std::string& host, int port, int type, std::function<void(int fd)> configure = nullptr);
+
+    // 在后台解析这些主机名，刷新缓存，同时预热 lwIP 自己的 DNS 表，
+    // 内部自己解析的 HTTP、MQTT、TLS 连接也能少等一次 DNS
+    void Prefetch(std::vector<std::string> hosts);
+
+    // 从 URL 或 host:port 中取出主机名
+    static std::string HostOf(const std::string& url);
+
+private:
+    struct Entry {
+        std::vector<uint32_t> addresses;    // 网络字节序
+        int64_t resolved_time = 0;          // 解析时的 Unix 时间，时间还没同步时为 0，视为过期
+    };
+
+    std::mutex mutex_;
+    std::map<std::string, Entry> entries_;
+
+    EndpointCache() = default;
+    bool Lookup(const std::string& host, Entry& entry);
+    bool Resolve(const std::string& host, Entry& entry);
+    void Store(const std::string& host, const Entry& entry);
+    bool IsFresh(const Entry& entry) const;
+    void RefreshInBackground(const std::string& host);
+    static std::string NvsKey(const std::string& host);
+    static int RaceConnect(const std::vector<uint32_t>& addresses, int port, const std::function<void(int)>& configure);
+};
+
+#endif // ENDPOINT_CACHE_H
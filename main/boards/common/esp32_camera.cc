@@ -3,14 +3,173 @@
 #include "display.h"
 #include "board.h"
 #include "system_info.h"
+#include "stream_uploader.h"
+#include "buffered_http_writer.h"
+#include "application.h"
+#include "heap_accounting.h"
+#include "task_stack.h"
+#include "metrics.h"
+#include "memory_profile.h"
+#include "timer_service.h"
 
 #include <esp_log.h>
 #include <esp_heap_caps.h>
+#include <esp_pthread.h>
+#include <esp_timer.h>
 #include <img_converters.h>
 #include <cstring>
+#include <algorithm>
+#include <memory>
+#include <cJSON.h>
 
 #define TAG "Esp32Camera"
 
+// 编码输出攒满一块再交给上传端，块的数量决定编码可以领先上传多少，按板子的内存档位选择
+#define JPEG_CHUNK_SIZE 4096
+#define JPEG_CHUNK_COUNT MEMORY_PROFILE_JPEG_CHUNK_COUNT
+
+// 识别结果缓存的条数，以及画面哈希最多相差多少位仍算同一画面（噪声、曝光抖动只改变少数位）
+#define EXPLAIN_CACHE_ENTRIES 4
+#define EXPLAIN_CACHE_MAX_DISTANCE 5
+
+static MetricCounter metric_explain_cache_hits("camera.explain_cache_hits");
+static MetricCounter metric_explain_uploads("camera.explain_uploads");
+
+// 编码线程和上传之间的 JPEG 数据块，缓冲区一次分配、循环使用，不再为每块输出单独分配
+class JpegChunkPool {
+public:
+    ~JpegChunkPool() {
+        if (free_queue_ != nullptr) {
+            vQueueDelete(free_queue_);
+        }
+        if (filled_queue_ != nullptr) {
+            vQueueDelete(filled_queue_);
+        }
+        if (storage_ != nullptr) {
+            HeapAccounting::Free(kHeapTagCamera, storage_);
+        }
+    }
+
+    bool Initialize() {
+        storage_ = (uint8_t*)HeapAccounting::MallocPreferSpiram(kHeapTagCamera, JPEG_CHUNK_SIZE * JPEG_CHUNK_COUNT);
+        free_queue_ = xQueueCreate(JPEG_CHUNK_COUNT, sizeof(uint8_t*));
+        // 多一个位置放结束标记
+        filled_queue_ = xQueueCreate(JPEG_CHUNK_COUNT + 1, sizeof(JpegChunk));
+        if (storage_ == nullptr || free_queue_ == nullptr || filled_queue_ == nullptr) {
+            return false;
+        }
+        for (int i = 0; i < JPEG_CHUNK_COUNT; i++) {
+            uint8_t* buffer = storage_ + i * JPEG_CHUNK_SIZE;
+            xQueueSend(free_queue_, &buffer, 0);
+        }
+        return true;
+    }
+
+    // 编码线程调用，写满一块后交给上传端，没有空闲块时等待上传
+    void Write(const void* data, size_t len) {
+        auto bytes = (const uint8_t*)data;
+        while (len > 0) {
+            if (current_ == nullptr) {
+                xQueueReceive(free_queue_, &current_, portMAX_DELAY);
+                current_len_ = 0;
+            }
+            size_t n = std::min(len, JPEG_CHUNK_SIZE - current_len_);
+            memcpy(current_ + current_len_, bytes, n);
+            current_len_ += n;
+            bytes += n;
+            len -= n;
+            if (current_len_ == JPEG_CHUNK_SIZE) {
+                Flush();
+            }
+        }
+    }
+
+    // 编码结束，发送剩余的数据和结束标记
+    void Finish() {
+        if (current_ != nullptr) {
+            Flush();
+        }
+        JpegChunk end = {nullptr, 0};
+        xQueueSend(filled_queue_, &end, portMAX_DELAY);
+    }
+
+    // 上传端调用，返回 false 表示编码已经结束；用完后调用 Release 归还
+    bool Receive(JpegChunk& chunk) {
+        if (xQueueReceive(filled_queue_, &chunk, portMAX_DELAY) != pdPASS) {
+            return false;
+        }
+        return chunk.data != nullptr;
+    }
+
+    void Release(const JpegChunk& chunk) {
+        xQueueSend(free_queue_, &chunk.data, 0);
+    }
+
+    // 丢弃剩余的数据，编码线程才能结束
+    void Drain() {
+        JpegChunk chunk;
+        while (Receive(chunk)) {
+            Release(chunk);
+        }
+    }
+
+private:
+    uint8_t* storage_ = nullptr;
+    QueueHandle_t free_queue_ = nullptr;
+    QueueHandle_t filled_queue_ = nullptr;
+    uint8_t* current_ = nullptr;
+    size_t current_len_ = 0;
+
+    void Flush() {
+        JpegChunk chunk = {current_, current_len_};
+        xQueueSend(filled_queue_, &chunk, portMAX_DELAY);
+        current_ = nullptr;
+    }
+};
+
+// 按整数倍缩小 RGB565 图像，每个输出像素取 factor x factor 区域的平均值
+// 输出总是摄像头的大端字节序，swapped 表示输入已经交换成小端（预览原地交换过的帧）
+static void DownscaleRgb565(const uint8_t* src, int width, int height, int factor, bool swapped, uint8_t* dst) {
+    const int hi = swapped ? 1 : 0;
+    const int lo = swapped ? 0 : 1;
+    int out_width = width / factor;
+    int out_height = height / factor;
+    int area = factor * factor;
+    for (int y = 0; y < out_height; y++) {
+        for (int x = 0; x < out_width; x++) {
+            uint32_t r = 0, g = 0, b = 0;
+            for (int dy = 0; dy < factor; dy++) {
+                auto row = src + ((y * factor + dy) * width + x * factor) * 2;
+                for (int dx = 0; dx < factor; dx++) {
+                    uint16_t value = (row[dx * 2 + hi] << 8) | row[dx * 2 + lo];
+                    r += value >> 11;
+                    g += (value >> 5) & 0x3F;
+                    b += value & 0x1F;
+                }
+            }
+            uint16_t value = ((r / area) << 11) | ((g / area) << 5) | (b / area);
+            dst[0] = value >> 8;
+            dst[1] = value & 0xFF;
+            dst += 2;
+        }
+    }
+}
+
+// 摄像头输出大端 RGB565，两个像素一组按 32 位字交换字节，比逐像素 bswap16 少一半的内存访问
+static void SwapRgb565Bytes(const uint8_t* src, uint8_t* dst, size_t size) {
+    auto src_words = (const uint32_t*)src;
+    auto dst_words = (uint32_t*)dst;
+    size_t words = size / 4;
+    for (size_t i = 0; i < words; i++) {
+        uint32_t value = src_words[i];
+        dst_words[i] = ((value & 0x00FF00FF) << 8) | ((value >> 8) & 0x00FF00FF);
+    }
+    if (size & 2) {
+        auto index = words * 2;
+        ((uint16_t*)dst)[index] = __builtin_bswap16(((const uint16_t*)src)[index]);
+    }
+}
+
 Esp32Camera::Esp32Camera(const camera_config_t& config) {
     // camera init
     esp_err_t err = esp_camera_init(&config); // 配置上面定义的参数
@@ -60,22 +219,22 @@ Esp32Camera::Esp32Camera(const camera_config_t& config) {
 
     preview_image_.header.stride = preview_image_.header.w * 2;
     preview_image_.data_size = preview_image_.header.w * preview_image_.header.h * 2;
-    preview_image_.data = (uint8_t*)heap_caps_malloc(preview_image_.data_size, MALLOC_CAP_SPIRAM);
-    if (preview_image_.data == nullptr) {
-        ESP_LOGE(TAG, "Failed to allocate memory for preview image");
-        return;
-    }
 }
 
 Esp32Camera::~Esp32Camera() {
+#if !CONFIG_USE_WECHAT_MESSAGE_STYLE
+    {
+        std::lock_guard<std::mutex> lock(frame_mutex_);
+        DropPreview();
+    }
+    if (preview_timer_ >= 0) {
+        TimerService::GetInstance().Stop(preview_timer_);
+    }
+#endif
     if (fb_) {
         esp_camera_fb_return(fb_);
         fb_ = nullptr;
     }
-    if (preview_image_.data) {
-        heap_caps_free((void*)preview_image_.data);
-        preview_image_.data = nullptr;
-    }
     esp_camera_deinit();
 }
 
@@ -84,12 +243,93 @@ void Esp32Camera::SetExplainUrl(const std::string& url, const std::string& token
     explain_token_ = token;
 }
 
+void Esp32Camera::SetActive(bool active) {
+#if CONFIG_CAMERA_WARM_CAPTURE
+    std::lock_guard<std::mutex> lock(frame_mutex_);
+    active_ = active;
+    if (!active) {
+        // 预热任务空闲一段时间后自己退出
+        inactive_since_us_ = esp_timer_get_time();
+        return;
+    }
+    if (warm_task_ == nullptr) {
+        TaskStack::Create("camera_warm", 3072, 1, kTaskStackPsram, [this]() {
+            WarmLoop();
+        }, &warm_task_);
+    }
+#endif
+}
+
+#if CONFIG_CAMERA_WARM_CAPTURE
+void Esp32Camera::WarmLoop() {
+    ESP_LOGI(TAG, "Warm capture started");
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(frame_mutex_);
+            if (!active_ && esp_timer_get_time() - inactive_since_us_ >= CONFIG_CAMERA_WARM_IDLE_TIMEOUT_S * 1000000LL) {
+                warm_task_ = nullptr;
+                break;
+            }
+            // 拍照后 fb_ 被占用时跳过，Explain 结束后会归还
+            if (fb_ == nullptr) {
+                auto fb = esp_camera_fb_get();
+                if (fb != nullptr) {
+                    esp_camera_fb_return(fb);
+                }
+            }
+        }
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_CAMERA_WARM_INTERVAL_MS));
+    }
+    ESP_LOGI(TAG, "Warm capture stopped");
+}
+#endif
+
+#if !CONFIG_USE_WECHAT_MESSAGE_STYLE
+// 调用时持有 frame_mutex_，显示释放图片时回调清除 preview_borrowed_
+void Esp32Camera::DropPreview() {
+    if (!preview_borrowed_) {
+        return;
+    }
+    if (preview_timer_ >= 0) {
+        TimerService::GetInstance().Stop(preview_timer_);
+    }
+    auto display = Board::GetInstance().GetDisplay();
+    if (display != nullptr) {
+        display->AdoptPreviewImage(nullptr);
+    }
+    preview_borrowed_ = false;
+}
+
+void Esp32Camera::OnPreviewTimeout() {
+    std::lock_guard<std::mutex> lock(frame_mutex_);
+    DropPreview();
+    if (return_after_preview_ && fb_ != nullptr) {
+        esp_camera_fb_return(fb_);
+        fb_ = nullptr;
+        frame_swapped_ = false;
+    }
+    return_after_preview_ = false;
+}
+#endif
+
 bool Esp32Camera::Capture() {
     if (encoder_thread_.joinable()) {
         encoder_thread_.join();
     }
 
+    std::unique_lock<std::mutex> lock(frame_mutex_);
+#if !CONFIG_USE_WECHAT_MESSAGE_STYLE
+    // 上一张预览还在引用 fb_，先撤下再归还
+    DropPreview();
+    return_after_preview_ = false;
+    frame_swapped_ = false;
+#endif
+#if CONFIG_CAMERA_WARM_CAPTURE
+    // 预热中缓冲区里的画面不超过一个预热间隔，取一帧就够
+    int frames_to_get = (warm_task_ != nullptr && fb_ == nullptr) ? 1 : 2;
+#else
     int frames_to_get = 2;
+#endif
     // Try to get a stable frame
     for (int i = 0; i < frames_to_get; i++) {
         if (fb_ != nullptr) {
@@ -102,30 +342,73 @@ bool Esp32Camera::Capture() {
         }
     }
 
-    // 如果预览图片 buffer 为空，则跳过预览
+    // 如果预览图片尺寸不支持，则跳过预览
     // 但仍返回 true，因为此时图像可以上传至服务器
     if (preview_image_.data_size == 0) {
         ESP_LOGW(TAG, "Skip preview because of unsupported frame size");
         return true;
     }
-    if (preview_image_.data == nullptr) {
-        ESP_LOGE(TAG, "Preview image data is not initialized");
+    if (fb_->format != PIXFORMAT_RGB565 || fb_->len < preview_image_.data_size) {
+        ESP_LOGE(TAG, "Frame cannot be previewed: format=%d, len=%u", fb_->format, fb_->len);
         return true;
     }
-    // 显示预览图片
     auto display = Board::GetInstance().GetDisplay();
-    if (display != nullptr) {
-        auto src = (uint16_t*)fb_->buf;
-        auto dst = (uint16_t*)preview_image_.data;
-        size_t pixel_count = fb_->len / 2;
-        for (size_t i = 0; i < pixel_count; i++) {
-            // 交换每个16位字内的字节
-            dst[i] = __builtin_bswap16(src[i]);
-        }
-        display->SetPreviewImage(&preview_image_);
+    if (display == nullptr) {
+        return true;
+    }
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+    // 聊天记录里的图片比这一帧活得久，只能复制一份交给显示
+    if (low_memory_) {
+        ESP_LOGW(TAG, "Skip preview because of low memory");
+        return true;
     }
+    auto data = (uint8_t*)heap_caps_malloc(preview_image_.data_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (data == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate memory for preview image");
+        return true;
+    }
+    SwapRgb565Bytes(fb_->buf, data, preview_image_.data_size);
+    auto image = new PreviewImage{preview_image_, nullptr};
+    image->dsc.data = data;
+    display->AdoptPreviewImage(image);
+#else
+    // 原地交换字节后直接显示摄像头的缓冲区，不需要额外的内存，低内存时也能预览
+    SwapRgb565Bytes(fb_->buf, fb_->buf, preview_image_.data_size);
+    frame_swapped_ = true;
+    preview_borrowed_ = true;
+    auto image = new PreviewImage{preview_image_, [this]() {
+        preview_borrowed_ = false;
+    }};
+    image->dsc.data = fb_->buf;
+    display->AdoptPreviewImage(image);
+
+    auto& timer_service = TimerService::GetInstance();
+    if (preview_timer_ < 0) {
+        preview_timer_ = timer_service.Create("camera_preview", [this]() {
+            OnPreviewTimeout();
+        }, 1000);
+    }
+    timer_service.StartOnce(preview_timer_, CONFIG_CAMERA_PREVIEW_TIMEOUT_S * 1000);
+#endif
     return true;
 }
+
+void Esp32Camera::SetLowMemory(bool low_memory) {
+    if (low_memory_.exchange(low_memory) == low_memory || !low_memory) {
+        return;
+    }
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+    // 换成空图时显示释放持有的上一张预览
+    auto display = Board::GetInstance().GetDisplay();
+    if (display != nullptr) {
+        display->AdoptPreviewImage(nullptr);
+    }
+#else
+    // 预览显示的是摄像头的缓冲区，撤下后帧可以尽早归还
+    OnPreviewTimeout();
+#endif
+}
+
 bool Esp32Camera::SetHMirror(bool enabled) {
     sensor_t *s = esp_camera_sensor_get();
     if (s == nullptr) {
@@ -160,6 +443,93 @@ bool Esp32Camera::SetVFlip(bool enabled) {
     return true;
 }
 
+// 画面的差值哈希：缩小成 9x8 的亮度格，每行相邻两格比较得到 64 位
+// 只支持 RGB565 帧，JPEG 帧返回 false，不缓存；swapped 表示帧已经为预览交换成小端字节序
+static bool ComputeFrameHash(const camera_fb_t* fb, bool swapped, uint64_t& hash) {
+    const int hi = swapped ? 1 : 0;
+    const int lo = swapped ? 0 : 1;
+    if (fb->format != PIXFORMAT_RGB565 || fb->width < 9 || fb->height < 8) {
+        return false;
+    }
+    // 每格隔几个像素取样，整帧只读几万个像素
+    const int step = std::max(1, (int)fb->width / 160);
+    uint32_t cells[8][9];
+    for (int gy = 0; gy < 8; gy++) {
+        int y0 = gy * fb->height / 8, y1 = (gy + 1) * fb->height / 8;
+        for (int gx = 0; gx < 9; gx++) {
+            int x0 = gx * fb->width / 9, x1 = (gx + 1) * fb->width / 9;
+            uint32_t sum = 0, count = 0;
+            for (int y = y0; y < y1; y += step) {
+                const uint8_t* row = fb->buf + (y * fb->width) * 2;
+                for (int x = x0; x < x1; x += step) {
+                    uint16_t pixel = (row[x * 2 + hi] << 8) | row[x * 2 + lo];
+                    uint32_t r = (pixel >> 11) & 0x1F, g = (pixel >> 5) & 0x3F, b = pixel & 0x1F;
+                    sum += r * 2 * 77 + g * 150 + b * 2 * 29;
+                    count++;
+                }
+            }
+            cells[gy][gx] = count > 0 ? sum / count : 0;
+        }
+    }
+    hash = 0;
+    for (int gy = 0; gy < 8; gy++) {
+        for (int gx = 0; gx < 8; gx++) {
+            hash = (hash << 1) | (cells[gy][gx] > cells[gy][gx + 1] ? 1 : 0);
+        }
+    }
+    return true;
+}
+
+// 去掉末尾不完整的 UTF-8 字符，返回可以转发的长度，剩下的字节等下一次读取补齐
+static size_t CompleteUtf8Length(const std::string& text) {
+    size_t length = text.size();
+    for (size_t i = 1; i <= 4 && i <= length; i++) {
+        uint8_t c = text[length - i];
+        if ((c & 0xC0) == 0x80) {
+            continue;
+        }
+        size_t need = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+        return need > i ? length - i : length;
+    }
+    return length;
+}
+
+bool Esp32Camera::ExplainOverStream(const std::string& question, JpegChunkPool& pool, std::string& result) {
+    cJSON* metadata = cJSON_CreateObject();
+    cJSON_AddStringToObject(metadata, "question", question.c_str());
+    cJSON_AddStringToObject(metadata, "format", "jpeg");
+    cJSON_AddNumberToObject(metadata, "width", upload_width_);
+    cJSON_AddNumberToObject(metadata, "height", upload_height_);
+    auto json_str = cJSON_PrintUnformatted(metadata);
+    StreamUploader uploader("camera", json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(metadata);
+    if (!uploader.Open()) {
+        return false;
+    }
+
+    // 上传失败后仍然要取完数据，编码线程才能结束
+    bool ok = true;
+    size_t total_sent = 0;
+    JpegChunk chunk;
+    while (pool.Receive(chunk)) {
+        if (ok) {
+            ok = uploader.Write(chunk.data, chunk.len);
+            total_sent += chunk.len;
+        }
+        pool.Release(chunk);
+    }
+    encoder_thread_.join();
+
+    if (!ok || !uploader.Finish(result)) {
+        result = "{\"success\": false, \"message\": \"Failed to upload photo\"}";
+        return true;
+    }
+    ESP_LOGI(TAG, "Explain image size=%dx%d over session stream, compressed size=%d, question=%s\n%s",
+        upload_width_, upload_height_, total_sent, question.c_str(), result.c_str());
+    return true;
+}
+
 /**
  * @brief 将摄像头捕获的图像发送到远程服务器进行AI分析和解释
  * 
@@ -170,46 +540,106 @@ bool Esp32Camera::SetVFlip(bool enabled) {
  * 实现特点：
  * - 使用独立线程编码JPEG，与主线程分离
  * - 采用分块传输编码(chunked transfer encoding)优化内存使用
- * - 通过队列机制实现编码线程和发送线程的数据同步
+ * - 编码输出写入循环使用的数据块，通过队列交给发送线程
+ * - 全帧宽度超过 CONFIG_CAMERA_EXPLAIN_MAX_WIDTH 时先按整数倍缩小再编码
  * - 支持设备ID、客户端ID和认证令牌的HTTP头部配置
  * 
  * @param question 要向AI提出的关于图像的问题，将作为表单字段发送
+ * @param on_partial HTTP 上传时服务器返回的文本边读边回调，可以为空
  * @return std::string 服务器返回的JSON格式响应字符串
  *         成功时包含AI分析结果，失败时包含错误信息
  *         格式示例：{"success": true, "result": "分析结果"}
  *                  {"success": false, "message": "错误信息"}
  * 
+ * @note 会话支持数据流时优先通过已建立的连接上传，不再新建 HTTP 连接
  * @note 调用此函数前必须先调用SetExplainUrl()设置服务器URL
  * @note 函数会等待之前的编码线程完成后再开始新的处理
  * @warning 如果摄像头缓冲区为空或网络连接失败，将返回错误信息
  */
-std::string Esp32Camera::Explain(const std::string& question) {
-    if (explain_url_.empty()) {
+std::string Esp32Camera::ExplainFrame(const std::string& question, const ExplainPartialCallback& on_partial) {
+    auto protocol = Application::GetInstance().GetProtocol();
+    if (explain_url_.empty() && (protocol == nullptr || !protocol->streams_enabled())) {
         return "{\"success\": false, \"message\": \"Image explain URL or token is not set\"}";
     }
 
-    // 创建局部的 JPEG 队列, 40 entries is about to store 512 * 40 = 20480 bytes of JPEG data
-    QueueHandle_t jpeg_queue = xQueueCreate(40, sizeof(JpegChunk));
-    if (jpeg_queue == nullptr) {
-        ESP_LOGE(TAG, "Failed to create JPEG queue");
-        return "{\"success\": false, \"message\": \"Failed to create JPEG queue\"}";
+    JpegChunkPool pool;
+    if (!pool.Initialize()) {
+        ESP_LOGE(TAG, "Failed to create JPEG chunk pool");
+        return "{\"success\": false, \"message\": \"Failed to create JPEG chunk pool\"}";
+    }
+
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+    const bool swapped = false;
+#else
+    const bool swapped = frame_swapped_;
+#endif
+    // 上传前按整数倍缩小到不超过 CONFIG_CAMERA_EXPLAIN_MAX_WIDTH，图片越小编码和上传越快
+    uint8_t* image = fb_->buf;
+    size_t image_len = fb_->len;
+    upload_width_ = fb_->width;
+    upload_height_ = fb_->height;
+    uint8_t* scaled = nullptr;
+    int factor = 1;
+    while (fb_->format == PIXFORMAT_RGB565 && fb_->width / factor > CONFIG_CAMERA_EXPLAIN_MAX_WIDTH && factor < 8) {
+        factor *= 2;
+    }
+    if (factor > 1) {
+        upload_width_ = fb_->width / factor;
+        upload_height_ = fb_->height / factor;
+        image_len = upload_width_ * upload_height_ * 2;
+        scaled = (uint8_t*)HeapAccounting::MallocPreferSpiram(kHeapTagCamera, image_len);
+        if (scaled != nullptr) {
+            DownscaleRgb565(fb_->buf, fb_->width, fb_->height, factor, swapped, scaled);
+            image = scaled;
+        } else {
+            ESP_LOGW(TAG, "Failed to allocate the scaled image, upload the full frame");
+            image_len = fb_->len;
+            upload_width_ = fb_->width;
+            upload_height_ = fb_->height;
+        }
+    }
+    if (swapped && scaled == nullptr) {
+        // 预览还在显示交换过的帧，编码用换回大端的副本
+        scaled = (uint8_t*)HeapAccounting::MallocPreferSpiram(kHeapTagCamera, image_len);
+        if (scaled == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate memory for the upload image");
+            return "{\"success\": false, \"message\": \"Failed to allocate memory for the upload image\"}";
+        }
+        SwapRgb565Bytes(fb_->buf, scaled, image_len);
+        image = scaled;
     }
 
     // We spawn a thread to encode the image to JPEG
-    encoder_thread_ = std::thread([this, jpeg_queue]() {
-        frame2jpg_cb(fb_, 80, [](void* arg, size_t index, const void* data, size_t len) -> unsigned int {
-            auto jpeg_queue = (QueueHandle_t)arg;
-            JpegChunk chunk = {
-                .data = (uint8_t*)heap_caps_aligned_alloc(16, len, MALLOC_CAP_SPIRAM),
-                .len = len
-            };
-            memcpy(chunk.data, data, len);
-            xQueueSend(jpeg_queue, &chunk, portMAX_DELAY);
-            return len;
-        }, jpeg_queue);
+#if CONFIG_TASK_STACK_PSRAM
+    // 编码线程只做计算，栈放在 PSRAM 中；创建后恢复默认配置
+    esp_pthread_cfg_t default_cfg = esp_pthread_get_default_config();
+    esp_pthread_cfg_t encoder_cfg = default_cfg;
+    encoder_cfg.thread_name = "jpeg_encode";
+    encoder_cfg.stack_alloc_caps = MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+    esp_pthread_set_cfg(&encoder_cfg);
+#endif
+    encoder_thread_ = std::thread([this, &pool, image, image_len, scaled]() {
+        fmt2jpg_cb(image, image_len, upload_width_, upload_height_, fb_->format, CONFIG_CAMERA_EXPLAIN_JPEG_QUALITY,
+            [](void* arg, size_t index, const void* data, size_t len) -> unsigned int {
+                static_cast<JpegChunkPool*>(arg)->Write(data, len);
+                return len;
+            }, &pool);
+        if (scaled != nullptr) {
+            HeapAccounting::Free(kHeapTagCamera, scaled);
+        }
+        pool.Finish();
     });
+#if CONFIG_TASK_STACK_PSRAM
+    esp_pthread_set_cfg(&default_cfg);
+#endif
 
-    auto http = Board::GetInstance().CreateHttp();
+    std::string stream_result;
+    if (ExplainOverStream(question, pool, stream_result)) {
+        return stream_result;
+    }
+
+    // 析构时关闭，连接池可以收回连接
+    auto http = std::unique_ptr<Http>(Board::GetInstance().CreateHttp());
     // 构造multipart/form-data请求体
     std::string boundary = "----ESP32_CAMERA_BOUNDARY";
 
@@ -223,20 +653,14 @@ std::string Esp32Camera::Explain(const std::string& question) {
     http->SetHeader("Transfer-Encoding", "chunked");
     if (!http->Open("POST", explain_url_)) {
         ESP_LOGE(TAG, "Failed to connect to explain URL");
-        // Clear the queue
+        // 取完剩余的数据，编码线程才能结束
+        pool.Drain();
         encoder_thread_.join();
-        JpegChunk chunk;
-        while (xQueueReceive(jpeg_queue, &chunk, portMAX_DELAY) == pdPASS) {
-            if (chunk.data != nullptr) {
-                heap_caps_free(chunk.data);
-            } else {
-                break;
-            }
-        }
-        vQueueDelete(jpeg_queue);
         return "{\"success\": false, \"message\": \"Failed to connect to explain URL\"}";
     }
     
+    // 各部分合并成记录大小的块再发送
+    BufferedHttpWriter writer(http.get());
     {
         // 第一块：question字段
         std::string question_field;
@@ -244,7 +668,7 @@ std::string Esp32Camera::Explain(const std::string& question) {
         question_field += "Content-Disposition: form-data; name=\"question\"\r\n";
         question_field += "\r\n";
         question_field += question + "\r\n";
-        http->Write(question_field.c_str(), question_field.size());
+        writer.Write(question_field);
     }
     {
         // 第二块：文件字段头部
@@ -253,49 +677,136 @@ std::string Esp32Camera::Explain(const std::string& question) {
         file_header += "Content-Disposition: form-data; name=\"file\"; filename=\"camera.jpg\"\r\n";
         file_header += "Content-Type: image/jpeg\r\n";
         file_header += "\r\n";
-        http->Write(file_header.c_str(), file_header.size());
+        writer.Write(file_header);
     }
 
     // 第三块：JPEG数据
     size_t total_sent = 0;
-    while (true) {
-        JpegChunk chunk;
-        if (xQueueReceive(jpeg_queue, &chunk, portMAX_DELAY) != pdPASS) {
-            ESP_LOGE(TAG, "Failed to receive JPEG chunk");
-            break;
-        }
-        if (chunk.data == nullptr) {
-            break; // The last chunk
-        }
-        http->Write((const char*)chunk.data, chunk.len);
+    JpegChunk chunk;
+    while (pool.Receive(chunk)) {
+        writer.Write((const char*)chunk.data, chunk.len);
         total_sent += chunk.len;
-        heap_caps_free(chunk.data);
+        pool.Release(chunk);
     }
     // Wait for the encoder thread to finish
     encoder_thread_.join();
-    // 清理队列
-    vQueueDelete(jpeg_queue);
 
     {
         // 第四块：multipart尾部
         std::string multipart_footer;
         multipart_footer += "\r\n--" + boundary + "--\r\n";
-        http->Write(multipart_footer.c_str(), multipart_footer.size());
+        writer.Write(multipart_footer);
     }
     // 结束块
-    http->Write("", 0);
+    writer.Finish();
 
     if (http->GetStatusCode() != 200) {
         ESP_LOGE(TAG, "Failed to upload photo, status code: %d", http->GetStatusCode());
         return "{\"success\": false, \"message\": \"Failed to upload photo\"}";
     }
 
-    std::string result = http->ReadAll();
+    // 边读边把新到的文本交给调用方，不用等整个响应读完
+    std::string result;
+    size_t forwarded = 0;
+    char buffer[512];
+    while (true) {
+        int ret = http->Read(buffer, sizeof(buffer));
+        if (ret < 0) {
+            ESP_LOGE(TAG, "Failed to read explain response: %d", ret);
+            break;
+        }
+        if (ret == 0) {
+            break;
+        }
+        result.append(buffer, ret);
+        if (on_partial) {
+            size_t length = CompleteUtf8Length(result);
+            if (length > forwarded) {
+                on_partial(result.substr(forwarded, length - forwarded));
+                forwarded = length;
+            }
+        }
+    }
     http->Close();
 
     // Get remain task stack size
     size_t remain_stack_size = uxTaskGetStackHighWaterMark(nullptr);
     ESP_LOGI(TAG, "Explain image size=%dx%d, compressed size=%d, remain stack size=%d, question=%s\n%s",
-        fb_->width, fb_->height, total_sent, remain_stack_size, question.c_str(), result.c_str());
+        upload_width_, upload_height_, total_sent, remain_stack_size, question.c_str(), result.c_str());
+    return result;
+}
+
+#if CONFIG_CAMERA_EXPLAIN_CACHE_S > 0
+const Esp32Camera::ExplainCacheEntry* Esp32Camera::FindExplainCache(uint64_t frame_hash, const std::string& question) {
+    int64_t now = esp_timer_get_time();
+    for (auto it = explain_cache_.begin(); it != explain_cache_.end(); ++it) {
+        if (now - it->time_us > CONFIG_CAMERA_EXPLAIN_CACHE_S * 1000000LL) {
+            continue;
+        }
+        if (it->question == question && __builtin_popcountll(it->frame_hash ^ frame_hash) <= EXPLAIN_CACHE_MAX_DISTANCE) {
+            // 移到末尾，最久未用的排在前面
+            std::rotate(it, it + 1, explain_cache_.end());
+            return &explain_cache_.back();
+        }
+    }
+    return nullptr;
+}
+
+void Esp32Camera::StoreExplainCache(uint64_t frame_hash, const std::string& question, const std::string& result) {
+    // 只缓存成功的结果
+    cJSON* json = cJSON_Parse(result.c_str());
+    bool success = cJSON_IsTrue(cJSON_GetObjectItem(json, "success"));
+    cJSON_Delete(json);
+    if (!success) {
+        return;
+    }
+    if (explain_cache_.size() >= EXPLAIN_CACHE_ENTRIES) {
+        explain_cache_.erase(explain_cache_.begin());
+    }
+    explain_cache_.push_back({frame_hash, question, result, esp_timer_get_time()});
+}
+#endif
+
+std::string Esp32Camera::Explain(const std::string& question, ExplainPartialCallback on_partial) {
+    std::string result;
+#if CONFIG_CAMERA_EXPLAIN_CACHE_S > 0
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+    const bool swapped = false;
+#else
+    const bool swapped = frame_swapped_;
+#endif
+    uint64_t frame_hash = 0;
+    bool hashed = fb_ != nullptr && ComputeFrameHash(fb_, swapped, frame_hash);
+    auto cached = hashed ? FindExplainCache(frame_hash, question) : nullptr;
+    if (cached != nullptr) {
+        ESP_LOGI(TAG, "Explain result from cache, hash=%016llx, question=%s", frame_hash, question.c_str());
+        metric_explain_cache_hits.Add();
+        result = cached->result;
+    } else {
+        metric_explain_uploads.Add();
+        result = ExplainFrame(question, on_partial);
+        if (hashed) {
+            StoreExplainCache(frame_hash, question, result);
+        }
+    }
+#else
+    metric_explain_uploads.Add();
+    result = ExplainFrame(question, on_partial);
+#endif
+#if CONFIG_CAMERA_WARM_CAPTURE
+    // 上传完成后归还帧，预热任务继续刷新缓冲区；预览还在显示时等它撤下再归还
+    std::lock_guard<std::mutex> lock(frame_mutex_);
+#if !CONFIG_USE_WECHAT_MESSAGE_STYLE
+    if (preview_borrowed_) {
+        return_after_preview_ = true;
+        return result;
+    }
+    frame_swapped_ = false;
+#endif
+    if (fb_ != nullptr) {
+        esp_camera_fb_return(fb_);
+        fb_ = nullptr;
+    }
+#endif
     return result;
 }
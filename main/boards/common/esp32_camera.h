@@ -5,6 +5,9 @@
 #include <lvgl.h>
 #include <thread>
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <vector>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
@@ -16,6 +19,8 @@ struct JpegChunk {
     size_t len;
 };
 
+class JpegChunkPool;
+
 class Esp32Camera : public Camera {
 private:
     camera_fb_t* fb_ = nullptr;
@@ -23,6 +28,53 @@ private:
     std::string explain_url_;
     std::string explain_token_;
     std::thread encoder_thread_;
+    // 上传图片的尺寸，按 CONFIG_CAMERA_EXPLAIN_MAX_WIDTH 缩小后的
+    int upload_width_ = 0;
+    int upload_height_ = 0;
+    std::atomic<bool> low_memory_{false};
+    // frame_mutex_ 保护 fb_ 的取还、预览的撤下和预热任务的启停
+    std::mutex frame_mutex_;
+
+#if !CONFIG_USE_WECHAT_MESSAGE_STYLE
+    // 预览直接显示 fb_ 的缓冲区（原地交换成小端字节序），不再另外分配一整帧，
+    // 显示超过 CONFIG_CAMERA_PREVIEW_TIMEOUT_S 秒或下次拍照时撤下
+    // frame_swapped_ 表示 fb_ 已经是小端 RGB565，preview_borrowed_ 表示显示还在引用 fb_
+    bool frame_swapped_ = false;
+    std::atomic<bool> preview_borrowed_{false};
+    // 预热模式下识别完成时预览还在显示，帧在预览撤下后归还
+    bool return_after_preview_ = false;
+    int preview_timer_ = -1;
+
+    void DropPreview();
+    void OnPreviewTimeout();
+#endif
+
+#if CONFIG_CAMERA_WARM_CAPTURE
+    // 对话期间后台定期取帧并归还，驱动随即重新采集，拍照时缓冲区里就是最近的画面，不用再丢弃旧帧
+    TaskHandle_t warm_task_ = nullptr;
+    std::atomic<bool> active_{false};
+    int64_t inactive_since_us_ = 0;
+
+    void WarmLoop();
+#endif
+
+#if CONFIG_CAMERA_EXPLAIN_CACHE_S > 0
+    // 按画面哈希和问题缓存最近的识别结果，画面没有变化时重复提问不用再上传
+    struct ExplainCacheEntry {
+        uint64_t frame_hash;
+        std::string question;
+        std::string result;
+        int64_t time_us;
+    };
+    std::vector<ExplainCacheEntry> explain_cache_;
+
+    const ExplainCacheEntry* FindExplainCache(uint64_t frame_hash, const std::string& question);
+    void StoreExplainCache(uint64_t frame_hash, const std::string& question, const std::string& result);
+#endif
+
+    // 通过当前会话的数据流上传，返回 false 表示会话不支持，需要回退到 HTTP
+    bool ExplainOverStream(const std::string& question, JpegChunkPool& pool, std::string& result);
+    std::string ExplainFrame(const std::string& question, const ExplainPartialCallback& on_partial);
 
 public:
     Esp32Camera(const camera_config_t& config);
@@ -33,7 +85,9 @@ public:
     // 翻转控制函数
     virtual bool SetHMirror(bool enabled) override;
     virtual bool SetVFlip(bool enabled) override;
-    virtual std::string Explain(const std::string& question);
+    virtual std::string Explain(const std::string& question, ExplainPartialCallback on_partial);
+    virtual void SetActive(bool active) override;
+    virtual void SetLowMemory(bool low_memory) override;
 };
 
 #endif // ESP32_CAMERA_H
\ No newline at end of file
@@ -0,0 +1,68 @@
+#include "i2c_bus.h"
+#include "metrics.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#define TAG "I2cBus"
+
+static MetricCounter metric_busy_us("i2c.busy_us");
+static MetricCounter metric_transactions("i2c.transactions");
+static MetricCounter metric_contended("i2c.contended");
+// 各优先级等待总线的时间
+static MetricHistogram metric_wait_us[kI2cPriorityCount] = {
+    {"i2c.wait_us.audio", METRIC_DURATION_US_BOUNDS},
+    {"i2c.wait_us.touch", METRIC_DURATION_US_BOUNDS},
+    {"i2c.wait_us.normal", METRIC_DURATION_US_BOUNDS},
+    {"i2c.wait_us.battery", METRIC_DURATION_US_BOUNDS},
+};
+
+I2cBusScheduler::Bus& I2cBusScheduler::GetBus(void* bus) {
+    for (auto& item : buses_) {
+        if (item.handle == bus) {
+            return item;
+        }
+    }
+    buses_.push_back(Bus{bus});
+    return buses_.back();
+}
+
+bool I2cBusScheduler::HasHigherWaiter(const Bus& bus, I2cPriority priority) {
+    for (int i = 0; i < priority; i++) {
+        if (bus.waiting[i] > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void I2cBusScheduler::Acquire(void* bus, I2cPriority priority) {
+    int64_t start = esp_timer_get_time();
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto& item = GetBus(bus);
+    if (item.busy || HasHigherWaiter(item, priority)) {
+        metric_contended.Add();
+        item.waiting[priority]++;
+        cv_.wait(lock, [&]() {
+            // buses_ 只会增加，但 vector 扩容后引用会失效，每次重新查找
+            auto& current = GetBus(bus);
+            return !current.busy && !HasHigherWaiter(current, priority);
+        });
+        GetBus(bus).waiting[priority]--;
+    }
+    auto& current = GetBus(bus);
+    current.busy = true;
+    current.acquired_us = esp_timer_get_time();
+    metric_wait_us[priority].Record(current.acquired_us - start);
+}
+
+void I2cBusScheduler::Release(void* bus) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& item = GetBus(bus);
+        item.busy = false;
+        metric_busy_us.Add(esp_timer_get_time() - item.acquired_us);
+        metric_transactions.Add();
+    }
+    cv_.notify_all();
+}
@@ -0,0 +1,70 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <driver/i2c_master.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// 共用一条 I2C 总线的设备按优先级排队，数值越小越优先
+enum I2cPriority {
+    kI2cPriorityAudio,      // 音频 codec 控制（音量、开关通道）
+    kI2cPriorityTouch,      // 触摸屏
+    kI2cPriorityNormal,     // IO 扩展等
+    kI2cPriorityBattery,    // PMIC、充电芯片的轮询
+    kI2cPriorityCount
+};
+
+// I2C 总线调度：驱动自带的总线锁只保证互斥，不区分先后，轮询电量或触摸时调音量要排在后面
+// 总线空闲时直接占用；有多个任务等待时，释放后交给优先级最高的一类
+// 每次占用可以包含多个连续的寄存器读写，活动时间计入 i2c.busy_us，按采样窗口的增量除以窗口时长就是总线占用率
+class I2cBusScheduler {
+public:
+    static I2cBusScheduler& GetInstance() {
+        static I2cBusScheduler instance;
+        return instance;
+    }
+
+    void Acquire(void* bus, I2cPriority priority);
+    void Release(void* bus);
+
+private:
+    struct Bus {
+        void* handle;
+        bool busy = false;
+        int waiting[kI2cPriorityCount] = {};
+        int64_t acquired_us = 0;
+    };
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<Bus> buses_;
+
+    I2cBusScheduler() = default;
+    Bus& GetBus(void* bus);
+    static bool HasHigherWaiter(const Bus& bus, I2cPriority priority);
+};
+
+// 在作用域内按 priority 占用总线，bus 为 nullptr 时什么也不做
+class I2cBusLock {
+public:
+    I2cBusLock(void* bus, I2cPriority priority) : bus_(bus) {
+        if (bus_ != nullptr) {
+            I2cBusScheduler::GetInstance().Acquire(bus_, priority);
+        }
+    }
+    ~I2cBusLock() {
+        if (bus_ != nullptr) {
+            I2cBusScheduler::GetInstance().Release(bus_);
+        }
+    }
+    I2cBusLock(const I2cBusLock&) = delete;
+    I2cBusLock& operator=(const I2cBusLock&) = delete;
+
+private:
+    void* bus_;
+};
+
+#endif // I2C_BUS_H
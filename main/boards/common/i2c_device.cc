@@ -5,7 +5,8 @@
 #define TAG "I2cDevice"
 
 
-I2cDevice::I2cDevice(i2c_master_bus_handle_t i2c_bus, uint8_t addr) {
+I2cDevice::I2cDevice(i2c_master_bus_handle_t i2c_bus, uint8_t addr, I2cPriority priority)
+    : i2c_bus_(i2c_bus), priority_(priority) {
     i2c_device_config_t i2c_device_cfg = {
         .dev_addr_length = I2C_ADDR_BIT_LEN_7,
         .device_address = addr,
@@ -21,15 +22,27 @@ I2cDevice::I2cDevice(i2c_master_bus_handle_t i2c_bus, uint8_t addr) {
 
 void I2cDevice::WriteReg(uint8_t reg, uint8_t value) {
     uint8_t buffer[2] = {reg, value};
+    I2cBusLock lock(i2c_bus_, priority_);
     ESP_ERROR_CHECK(i2c_master_transmit(i2c_device_, buffer, 2, 100));
 }
 
 uint8_t I2cDevice::ReadReg(uint8_t reg) {
     uint8_t buffer[1];
+    I2cBusLock lock(i2c_bus_, priority_);
     ESP_ERROR_CHECK(i2c_master_transmit_receive(i2c_device_, &reg, 1, buffer, 1, 100));
     return buffer[0];
 }
 
 void I2cDevice::ReadRegs(uint8_t reg, uint8_t* buffer, size_t length) {
+    I2cBusLock lock(i2c_bus_, priority_);
     ESP_ERROR_CHECK(i2c_master_transmit_receive(i2c_device_, &reg, 1, buffer, length, 100));
+}
+
+void I2cDevice::WriteRegs(uint8_t reg, const uint8_t* data, size_t length) {
+    i2c_master_transmit_multi_buffer_info_t buffers[2] = {
+        {.write_buffer = &reg, .buffer_size = 1},
+        {.write_buffer = const_cast<uint8_t*>(data), .buffer_size = length},
+    };
+    I2cBusLock lock(i2c_bus_, priority_);
+    ESP_ERROR_CHECK(i2c_master_multi_buffer_transmit(i2c_device_, buffers, 2, 100));
 }
\ No newline at end of file
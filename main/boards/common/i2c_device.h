@@ -3,16 +3,22 @@
 
 #include <driver/i2c_master.h>
 
+#include "i2c_bus.h"
+
 class I2cDevice {
 public:
-    I2cDevice(i2c_master_bus_handle_t i2c_bus, uint8_t addr);
+    I2cDevice(i2c_master_bus_handle_t i2c_bus, uint8_t addr, I2cPriority priority = kI2cPriorityNormal);
 
 protected:
+    i2c_master_bus_handle_t i2c_bus_;
     i2c_master_dev_handle_t i2c_device_;
+    I2cPriority priority_;
 
     void WriteReg(uint8_t reg, uint8_t value);
     uint8_t ReadReg(uint8_t reg);
+    // 连续地址的多个寄存器在一次传输中读写（芯片需要支持地址自增）
     void ReadRegs(uint8_t reg, uint8_t* buffer, size_t length);
+    void WriteRegs(uint8_t reg, const uint8_t* data, size_t length);
 };
 
 #endif // I2C_DEVICE_H
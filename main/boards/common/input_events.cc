@@ -0,0 +1,85 @@
+#include "input_events.h"
+#include "application.h"
+#include "metrics.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#define TAG "InputEvents"
+
+static MetricCounter metric_events("input.events");
+static MetricCounter metric_coalesced("input.coalesced");
+static MetricCounter metric_dropped("input.dropped");
+static MetricCounter metric_batches("input.batches");
+// 从驱动回调到主循环分发的延迟
+static MetricHistogram metric_latency_us("input.latency_us", METRIC_DURATION_US_BOUNDS);
+
+void InputEvents::Post(void* source, InputDispatch dispatch, InputEventType type, int steps) {
+    InputEvent event = {source, dispatch, type, (int16_t)steps, esp_timer_get_time()};
+    metric_events.Add();
+
+    auto& app = Application::GetInstance();
+    if (!app.IsMainLoopRunning()) {
+        Deliver(event);
+        return;
+    }
+
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (type == kInputRotate && count_ > 0) {
+            // 还没分发的最后一个事件是同一个旋钮的转动，累加格数
+            auto& last = events_[(head_ + count_ - 1) % kCapacity];
+            if (last.type == kInputRotate && last.source == source) {
+                last.steps += steps;
+                metric_coalesced.Add();
+                return;
+            }
+        }
+        if (count_ == kCapacity) {
+            metric_dropped.Add();
+            ESP_LOGW(TAG, "Input queue full, drop event %d", type);
+            return;
+        }
+        events_[(head_ + count_) % kCapacity] = event;
+        count_++;
+        if (!drain_scheduled_) {
+            drain_scheduled_ = true;
+            schedule = true;
+        }
+    }
+    if (schedule) {
+        app.Schedule([this]() {
+            Drain();
+        });
+    }
+}
+
+void InputEvents::Drain() {
+    InputEvent batch[kCapacity];
+    int count;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        count = count_;
+        for (int i = 0; i < count; i++) {
+            batch[i] = events_[(head_ + i) % kCapacity];
+        }
+        head_ = (head_ + count) % kCapacity;
+        count_ = 0;
+        drain_scheduled_ = false;
+    }
+    metric_batches.Add();
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < count; i++) {
+        metric_latency_us.Record(now - batch[i].time_us);
+        Deliver(batch[i]);
+    }
+}
+
+void InputEvents::Deliver(const InputEvent& event) {
+    // 合并后正反转抵消的旋转没有必要分发
+    if (event.type == kInputRotate && event.steps == 0) {
+        return;
+    }
+    event.dispatch(event.source, event);
+}
@@ -0,0 +1,55 @@
+#ifndef INPUT_EVENTS_H
+#define INPUT_EVENTS_H
+
+#include <cstdint>
+#include <mutex>
+
+enum InputEventType : uint8_t {
+    kInputPressDown,
+    kInputPressUp,
+    kInputLongPress,
+    kInputClick,
+    kInputDoubleClick,
+    kInputMultipleClick,
+    kInputRotate,
+};
+
+struct InputEvent;
+using InputDispatch = void (*)(void* source, const InputEvent& event);
+
+struct InputEvent {
+    void* source;           // 产生事件的 Button 或 Knob
+    InputDispatch dispatch;
+    InputEventType type;
+    int16_t steps;          // 旋钮合并后的格数，正数为 KNOB_RIGHT 方向
+    int64_t time_us;        // 驱动回调的时间，合并的旋转事件取第一格的时间
+};
+
+// 按键和旋钮共用的事件队列
+// 驱动回调中只写入固定大小的环形缓冲区，不分配内存；主循环运行后每批事件只调度一次 Schedule，
+// 在主循环中按顺序调用各自的回调。连续的旋钮转动合并成一个带格数的事件
+// 主循环启动前（联网、配网、激活期间）直接在驱动回调中分发，保持原来的行为
+class InputEvents {
+public:
+    static InputEvents& GetInstance() {
+        static InputEvents instance;
+        return instance;
+    }
+
+    void Post(void* source, InputDispatch dispatch, InputEventType type, int steps = 0);
+
+private:
+    static constexpr int kCapacity = 32;
+
+    std::mutex mutex_;
+    InputEvent events_[kCapacity];
+    int head_ = 0;
+    int count_ = 0;
+    bool drain_scheduled_ = false;
+
+    InputEvents() = default;
+    void Drain();
+    static void Deliver(const InputEvent& event);
+};
+
+#endif // INPUT_EVENTS_H
@@ -1,4 +1,5 @@
 #include "knob.h"
+#include "input_events.h"
 
 static const char* TAG = "Knob";
 
@@ -38,15 +39,19 @@ Knob::~Knob() {
     }
 }
 
-void Knob::OnRotate(std::function<void(bool)> callback) {
+void Knob::OnRotate(std::function<void(int)> callback) {
     on_rotate_ = callback;
 }
 
 void Knob::knob_callback(void* arg, void* data) {
     Knob* knob = static_cast<Knob*>(data);
     knob_event_t event = iot_knob_get_event(arg);
-    
+    InputEvents::GetInstance().Post(knob, Dispatch, kInputRotate, event == KNOB_RIGHT ? 1 : -1);
+}
+
+void Knob::Dispatch(void* source, const InputEvent& event) {
+    Knob* knob = static_cast<Knob*>(source);
     if (knob->on_rotate_) {
-        knob->on_rotate_(event == KNOB_RIGHT);
+        knob->on_rotate_(event.steps);
     }
 }
\ No newline at end of file
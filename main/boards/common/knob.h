@@ -6,20 +6,24 @@
 #include <esp_log.h>
 #include <iot_knob.h>
 
+struct InputEvent;
+
 class Knob {
 public:
     Knob(gpio_num_t pin_a, gpio_num_t pin_b);
     ~Knob();
 
-    void OnRotate(std::function<void(bool)> callback);
+    // 快速转动时多格合并成一次回调，steps 为正表示 KNOB_RIGHT 方向
+    void OnRotate(std::function<void(int steps)> callback);
 
 private:
     static void knob_callback(void* arg, void* data);
+    static void Dispatch(void* source, const InputEvent& event);
 
     knob_handle_t knob_handle_;
     gpio_num_t pin_a_;
     gpio_num_t pin_b_;
-    std::function<void(bool)> on_rotate_;
+    std::function<void(int)> on_rotate_;
 };
 
 #endif // KNOB_H_
\ No newline at end of file
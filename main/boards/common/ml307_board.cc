@@ -3,6 +3,7 @@
 #include "application.h"
 #include "display.h"
 #include "font_awesome_symbols.h"
+#include "metrics.h"
 #include "assets/lang_config.h"
 
 #include <esp_log.h>
@@ -16,6 +17,9 @@
 
 static const char *TAG = "Ml307Board";
 
+// 查询信号强度是一次完整的 AT 命令往返，用来估计串口和模组的响应时间
+static MetricHistogram metric_at_rtt_us("ml307.at_rtt_us", METRIC_NETWORK_US_BOUNDS);
+
 Ml307Board::Ml307Board(gpio_num_t tx_pin, gpio_num_t rx_pin, size_t rx_buffer_size) : modem_(tx_pin, rx_pin, rx_buffer_size) {
 }
 
@@ -27,7 +31,7 @@ void Ml307Board::StartNetwork() {
     auto display = Board::GetInstance().GetDisplay();
     display->SetStatus(Lang::Strings::DETECTING_MODULE);
     modem_.SetDebug(false);
-    modem_.SetBaudRate(921600);
+    modem_.SetBaudRate(CONFIG_ML307_UART_BAUD_RATE);
 
     auto& application = Application::GetInstance();
     // If low power, the material ready event will be triggered by the modem because of a reset
@@ -42,6 +46,22 @@ void Ml307Board::StartNetwork() {
     WaitForNetworkReady();
 }
 
+void Ml307Board::StartStandbyNetwork() {
+    modem_.SetDebug(false);
+    modem_.SetBaudRate(CONFIG_ML307_UART_BAUD_RATE);
+    // 注册失败（没有 SIM 卡等）时隔一段时间重试，不打扰当前的主网络
+    while (true) {
+        int result = modem_.WaitForNetworkReady();
+        if (result != -1 && result != -2) {
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(30000));
+    }
+    ESP_LOGI(TAG, "ML307 standby registered, IMEI: %s", modem_.GetImei().c_str());
+    modem_.ResetConnections();
+    modem_.SetSleepMode(true, 30);
+}
+
 void Ml307Board::WaitForNetworkReady() {
     auto& application = Application::GetInstance();
     auto display = Board::GetInstance().GetDisplay();
@@ -94,7 +114,9 @@ const char* Ml307Board::GetNetworkStateIcon() {
     if (!modem_.network_ready()) {
         return FONT_AWESOME_SIGNAL_OFF;
     }
+    int64_t start = esp_timer_get_time();
     int csq = modem_.GetCsq();
+    metric_at_rtt_us.Record(esp_timer_get_time() - start);
     if (csq == -1) {
         return FONT_AWESOME_SIGNAL_OFF;
     } else if (csq >= 0 && csq <= 14) {
@@ -128,7 +150,7 @@ void Ml307Board::SetPowerSaveMode(bool enabled) {
     // TODO: Implement power save mode for ML307
 }
 
-std::string Ml307Board::GetDeviceStatusJson() {
+std::string Ml307Board::BuildDeviceStatusJson() {
     /*
      * 返回设备状态JSON
      * 
@@ -204,6 +226,9 @@ std::string Ml307Board::GetDeviceStatusJson() {
     }
     cJSON_AddItemToObject(root, "network", network);
 
+    // 运行时长和内存余量
+    cJSON_AddItemToObject(root, "system", Metrics::GetInstance().CreateSummaryJson());
+
     auto json_str = cJSON_PrintUnformatted(root);
     std::string json(json_str);
     cJSON_free(json_str);
@@ -14,14 +14,18 @@ public:
     Ml307Board(gpio_num_t tx_pin, gpio_num_t rx_pin, size_t rx_buffer_size = 4096);
     virtual std::string GetBoardType() override;
     virtual void StartNetwork() override;
+    // 作为双网络板子的待机网络启动：不显示状态和错误提示，注册后进入休眠
+    void StartStandbyNetwork();
+    bool IsNetworkReady() { return modem_.network_ready(); }
     virtual Http* CreateHttp() override;
     virtual WebSocket* CreateWebSocket() override;
     virtual Mqtt* CreateMqtt() override;
     virtual Udp* CreateUdp() override;
     virtual const char* GetNetworkStateIcon() override;
     virtual void SetPowerSaveMode(bool enabled) override;
+    virtual int GetUplinkBatchFrames() override { return CONFIG_ML307_UPLINK_BATCH_FRAMES; }
     virtual AudioCodec* GetAudioCodec() override { return nullptr; }
-    virtual std::string GetDeviceStatusJson() override;
+    virtual std::string BuildDeviceStatusJson() override;
 };
 
 #endif // ML307_BOARD_H
@@ -0,0 +1,199 @@
+#include "oscillator.h"
+
+#include <esp_log.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+static const char* TAG = "Oscillator";
+
+Oscillator::Oscillator(int trim) {
+    trim_ = trim;
+    diff_limit_ = 0;
+    is_attached_ = false;
+
+    period_ = 2000;
+    inc_ = 0;
+    SetT(period_);
+
+    amplitude_ = 45;
+    phase_ = 0;
+    phase0_ = 0;
+    offset_ = 0;
+    stop_ = false;
+    rev_ = false;
+
+    pos_ = 90;
+    previous_servo_command_us_ = 0;
+}
+
+Oscillator::~Oscillator() {
+    Detach();
+}
+
+void Oscillator::Attach(int pin, bool rev) {
+    if (is_attached_) {
+        Detach();
+    }
+
+    pin_ = pin;
+    rev_ = rev;
+
+    ledc_timer_config_t ledc_timer = {.speed_mode = LEDC_LOW_SPEED_MODE,
+                                      .duty_resolution = LEDC_TIMER_13_BIT,
+                                      .timer_num = LEDC_TIMER_1,
+                                      .freq_hz = 50,
+                                      .clk_cfg = LEDC_AUTO_CLK};
+    ESP_ERROR_CHECK(ledc_timer_config(&ledc_timer));
+
+    static int last_channel = 0;
+    last_channel = (last_channel + 1) % 7 + 1;
+    ledc_channel_ = (ledc_channel_t)last_channel;
+
+    ledc_channel_config_t ledc_channel = {.gpio_num = pin_,
+                                          .speed_mode = LEDC_LOW_SPEED_MODE,
+                                          .channel = ledc_channel_,
+                                          .intr_type = LEDC_INTR_DISABLE,
+                                          .timer_sel = LEDC_TIMER_1,
+                                          .duty = 0,
+                                          .hpoint = 0};
+    ESP_ERROR_CHECK(ledc_channel_config(&ledc_channel));
+
+    ledc_speed_mode_ = LEDC_LOW_SPEED_MODE;
+
+    previous_servo_command_us_ = esp_timer_get_time();
+
+    is_attached_ = true;
+}
+
+void Oscillator::Detach() {
+    if (!is_attached_)
+        return;
+
+    ESP_ERROR_CHECK(ledc_stop(ledc_speed_mode_, ledc_channel_, 0));
+
+    is_attached_ = false;
+}
+
+void Oscillator::SetT(unsigned int T) {
+    period_ = std::max(T, (unsigned int)OSCILLATOR_TICK_MS);
+    // 每个采样间隔前进的定点相位
+    inc_ = (uint32_t)(((uint64_t)OSCILLATOR_TICK_MS << 32) / period_);
+}
+
+void Oscillator::SetPh(double Ph) {
+    double turns = Ph / (2 * M_PI);
+    turns -= std::floor(turns);
+    phase0_ = (uint32_t)(turns * 4294967296.0);
+}
+
+void Oscillator::SetPosition(int position) {
+    Write(position);
+}
+
+void Oscillator::Tick() {
+    if (!stop_) {
+        int32_t sine = OscillatorEngine::GetInstance().Sine(phase_ + phase0_);
+        int pos = (((int32_t)amplitude_ * sine + (1 << 14)) >> 15) + offset_;
+        if (rev_)
+            pos = -pos;
+        Write(pos + 90);
+    }
+
+    phase_ += inc_;
+}
+
+void Oscillator::Write(int position) {
+    if (!is_attached_)
+        return;
+
+    int64_t now_us = esp_timer_get_time();
+    if (diff_limit_ > 0) {
+        int limit = std::max(
+            1, (int)((now_us - previous_servo_command_us_) * diff_limit_ / 1000000));
+        if (abs(position - pos_) > limit) {
+            pos_ += position < pos_ ? -limit : limit;
+        } else {
+            pos_ = position;
+        }
+    } else {
+        pos_ = position;
+    }
+    previous_servo_command_us_ = now_us;
+
+    int angle = pos_ + trim_;
+
+    angle = std::min(std::max(angle, 0), 180);
+
+    // 0~180 度对应 0.5~2.5ms 脉宽，13 位占空比，20ms 周期
+    uint32_t pulse_us = SERVO_MIN_PULSEWIDTH_US + angle * (SERVO_MAX_PULSEWIDTH_US - SERVO_MIN_PULSEWIDTH_US) / 180;
+    uint32_t duty = pulse_us * 8191 / SERVO_TIMEBASE_PERIOD;
+
+    ESP_ERROR_CHECK(ledc_set_duty(ledc_speed_mode_, ledc_channel_, duty));
+    ESP_ERROR_CHECK(ledc_update_duty(ledc_speed_mode_, ledc_channel_));
+}
+
+OscillatorEngine::OscillatorEngine() {
+    // 多存一项，插值时不用回绕
+    for (int i = 0; i <= (1 << kSineTableBits); i++) {
+        sine_table_[i] = (int16_t)std::lround(std::sin(2 * M_PI * i / (1 << kSineTableBits)) * 32767);
+    }
+
+    done_ = xSemaphoreCreateBinary();
+    esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+            static_cast<OscillatorEngine*>(arg)->OnTick();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "oscillator",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &timer_));
+}
+
+int32_t OscillatorEngine::Sine(uint32_t phase) const {
+    uint32_t index = phase >> (32 - kSineTableBits);
+    int32_t fraction = (phase >> (32 - kSineTableBits - 16)) & 0xFFFF;
+    int32_t a = sine_table_[index];
+    int32_t b = sine_table_[index + 1];
+    return a + (((b - a) * fraction) >> 16);
+}
+
+void OscillatorEngine::Run(Oscillator* const oscillators[], int count, uint32_t duration_ms) {
+    std::lock_guard<std::mutex> lock(run_mutex_);
+    uint32_t ticks = (duration_ms + OSCILLATOR_TICK_MS - 1) / OSCILLATOR_TICK_MS;
+    if (ticks == 0 || count <= 0) {
+        return;
+    }
+    if (count > OSCILLATOR_MAX_COUNT) {
+        ESP_LOGW(TAG, "Too many oscillators: %d", count);
+        count = OSCILLATOR_MAX_COUNT;
+    }
+    std::copy(oscillators, oscillators + count, oscillators_);
+    count_ = count;
+    remaining_ticks_ = ticks;
+
+    // 第一个采样马上输出，之后由定时器按固定间隔推进
+    xSemaphoreTake(done_, 0);
+    OnTick();
+    if (remaining_ticks_ > 0) {
+        ESP_ERROR_CHECK(esp_timer_start_periodic(timer_, OSCILLATOR_TICK_MS * 1000));
+        xSemaphoreTake(done_, portMAX_DELAY);
+    }
+    count_ = 0;
+}
+
+void OscillatorEngine::OnTick() {
+    if (remaining_ticks_ == 0) {
+        return;
+    }
+    for (int i = 0; i < count_; i++) {
+        oscillators_[i]->Tick();
+    }
+    if (--remaining_ticks_ == 0) {
+        esp_timer_stop(timer_);
+        xSemaphoreGive(done_);
+    }
+}
@@ -0,0 +1,120 @@
+#ifndef OSCILLATOR_H
+#define OSCILLATOR_H
+
+#include <driver/ledc.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include <cstdint>
+#include <mutex>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#ifndef DEG2RAD
+#define DEG2RAD(g) ((g) * M_PI) / 180
+#endif
+
+#define SERVO_MIN_PULSEWIDTH_US 500           // 最小脉宽（微秒）
+#define SERVO_MAX_PULSEWIDTH_US 2500          // 最大脉宽（微秒）
+#define SERVO_MIN_DEGREE -90                  // 最小角度
+#define SERVO_MAX_DEGREE 90                   // 最大角度
+#define SERVO_TIMEBASE_RESOLUTION_HZ 1000000  // 1MHz, 1us per tick
+#define SERVO_TIMEBASE_PERIOD 20000           // 20000 ticks, 20ms
+
+// 振荡器的采样间隔，和舵机 50Hz 的 PWM 周期一致，更快的更新舵机也收不到
+#define OSCILLATOR_TICK_MS 20
+#define OSCILLATOR_MAX_COUNT 8
+
+// Otto 和 Electron-Bot 共用的舵机振荡器
+// 相位用 32 位定点数表示（2^32 为一整圈），位置查正弦表得到，采样时不做浮点运算
+class Oscillator {
+public:
+    Oscillator(int trim = 0);
+    ~Oscillator();
+    void Attach(int pin, bool rev = false);
+    void Detach();
+
+    void SetA(unsigned int amplitude) { amplitude_ = amplitude; };
+    void SetO(int offset) { offset_ = offset; };
+    // 相位差以弧度给出，换算成定点相位
+    void SetPh(double Ph);
+    void SetT(unsigned int period);
+    void SetTrim(int trim) { trim_ = trim; };
+    void SetLimiter(int diff_limit) { diff_limit_ = diff_limit; };
+    void DisableLimiter() { diff_limit_ = 0; };
+    int GetTrim() { return trim_; };
+    void SetPosition(int position);
+    void Stop() { stop_ = true; };
+    void Play() { stop_ = false; };
+    void Reset() { phase_ = 0; };
+    // 前进一个采样间隔并输出位置，由 OscillatorEngine 的定时器调用
+    void Tick();
+    int GetPosition() { return pos_; }
+
+private:
+    void Write(int position);
+
+private:
+    bool is_attached_;
+
+    //-- Oscillators parameters
+    unsigned int amplitude_;  //-- Amplitude (degrees)
+    int offset_;              //-- Offset (degrees)
+    unsigned int period_;     //-- Period (miliseconds)
+    uint32_t phase0_;         //-- Phase (2^32 per turn)
+
+    //-- Internal variables
+    int pos_;          //-- Current servo pos
+    int pin_;          //-- Pin where the servo is connected
+    int trim_;         //-- Calibration offset
+    uint32_t phase_;   //-- Current phase (2^32 per turn)
+    uint32_t inc_;     //-- Increment of phase per tick
+
+    //-- Oscillation mode. If true, the servo is stopped
+    bool stop_;
+
+    //-- Reverse mode
+    bool rev_;
+
+    int diff_limit_;
+    int64_t previous_servo_command_us_;
+
+    ledc_channel_t ledc_channel_;
+    ledc_mode_t ledc_speed_mode_;
+};
+
+// 所有振荡器共用一个 esp_timer，每个采样间隔一次性更新全部舵机的 LEDC 通道
+// 同一组振荡器在同一次回调里前进，相位差保持不变；调用方在 Run 中阻塞等待，不再轮询和 vTaskDelay
+class OscillatorEngine {
+public:
+    static OscillatorEngine& GetInstance() {
+        static OscillatorEngine instance;
+        return instance;
+    }
+
+    // 让一组振荡器运行 duration_ms 毫秒，结束后返回
+    void Run(Oscillator* const oscillators[], int count, uint32_t duration_ms);
+
+    // Q15 正弦，phase 为 2^32 一整圈的定点相位
+    int32_t Sine(uint32_t phase) const;
+
+private:
+    // 256 段线性插值，比舵机的分辨率精细得多
+    static constexpr int kSineTableBits = 8;
+    int16_t sine_table_[(1 << kSineTableBits) + 1];
+
+    std::mutex run_mutex_;
+    esp_timer_handle_t timer_ = nullptr;
+    SemaphoreHandle_t done_ = nullptr;
+    Oscillator* oscillators_[OSCILLATOR_MAX_COUNT] = {};
+    int count_ = 0;
+    uint32_t remaining_ticks_ = 0;
+
+    OscillatorEngine();
+    void OnTick();
+};
+
+#endif  // OSCILLATOR_H
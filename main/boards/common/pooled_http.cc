@@ -0,0 +1,355 @@
+#include "pooled_http.h"
+#include "timer_service.h"
+#include "metrics.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_crt_bundle.h>
+#include <algorithm>
+#include <cctype>
+
+#define TAG "PooledHttp"
+
+#if CONFIG_HTTP_CONNECTION_POOL
+
+static MetricCounter metric_reused("http.pool_reused");
+static MetricCounter metric_resumed("http.pool_resumed");
+static MetricCounter metric_new("http.pool_new");
+
+static std::string ToLower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+    return text;
+}
+
+esp_http_client_handle_t HttpConnectionPool::Acquire(const std::string& origin, bool& connected) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::find_if(entries_.begin(), entries_.end(), [&origin](const Entry& entry) {
+        return entry.origin == origin;
+    });
+    if (it == entries_.end()) {
+        connected = false;
+        return nullptr;
+    }
+    auto client = it->client;
+    connected = it->connected;
+    entries_.erase(it);
+    return client;
+}
+
+void HttpConnectionPool::Release(const std::string& origin, esp_http_client_handle_t client, bool connected) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::find_if(entries_.begin(), entries_.end(), [&origin](const Entry& entry) {
+        return entry.origin == origin;
+    });
+    if (it != entries_.end()) {
+        // 同一个主机只留一个句柄，优先留下还连着的
+        if (it->connected || !connected) {
+            esp_http_client_cleanup(client);
+            return;
+        }
+        esp_http_client_cleanup(it->client);
+        entries_.erase(it);
+    }
+    entries_.push_back({origin, client, connected, esp_timer_get_time()});
+    if (entries_.size() > CONFIG_HTTP_POOL_MAX_HOSTS) {
+        auto oldest = std::min_element(entries_.begin(), entries_.end(), [](const Entry& a, const Entry& b) {
+            return a.idle_since_us < b.idle_since_us;
+        });
+        ESP_LOGI(TAG, "Release %s", oldest->origin.c_str());
+        esp_http_client_cleanup(oldest->client);
+        entries_.erase(oldest);
+    }
+    if (connected) {
+        ScheduleEviction();
+    }
+}
+
+void HttpConnectionPool::EvictIdle() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t now = esp_timer_get_time();
+    int64_t idle_us = CONFIG_HTTP_POOL_IDLE_SECONDS * 1000000LL;
+    bool pending = false;
+    for (auto& entry : entries_) {
+        if (!entry.connected) {
+            continue;
+        }
+        if (now - entry.idle_since_us >= idle_us) {
+            // 只断开连接，句柄里保存的 TLS 会话留给下次恢复
+            esp_http_client_close(entry.client);
+            entry.connected = false;
+            ESP_LOGI(TAG, "Closed idle connection to %s", entry.origin.c_str());
+        } else {
+            pending = true;
+        }
+    }
+    if (pending) {
+        ScheduleEviction();
+    }
+}
+
+void HttpConnectionPool::ScheduleEviction() {
+    auto& timer_service = TimerService::GetInstance();
+    if (timer_id_ < 0) {
+        timer_id_ = timer_service.Create("http_pool", [this]() {
+            EvictIdle();
+        }, 1000);
+    }
+    // 按最早空闲的连接计时，到期后 EvictIdle 再按剩下的连接重新计时
+    int64_t earliest = INT64_MAX;
+    for (auto& entry : entries_) {
+        if (entry.connected) {
+            earliest = std::min(earliest, entry.idle_since_us);
+        }
+    }
+    int64_t remaining_us = earliest + CONFIG_HTTP_POOL_IDLE_SECONDS * 1000000LL - esp_timer_get_time();
+    timer_service.StartOnce(timer_id_, std::max<int64_t>(remaining_us / 1000, 1));
+}
+
+PooledHttp::~PooledHttp() {
+    Close();
+}
+
+void PooledHttp::SetTimeout(int timeout_ms) {
+    timeout_ms_ = timeout_ms;
+}
+
+void PooledHttp::SetHeader(const std::string& key, const std::string& value) {
+    headers_[key] = value;
+}
+
+void PooledHttp::SetContent(std::string&& content) {
+    content_ = std::move(content);
+}
+
+std::string PooledHttp::OriginOf(const std::string& url) {
+    auto scheme_end = url.find("://");
+    auto host_start = scheme_end == std::string::npos ? 0 : scheme_end + 3;
+    auto path_start = url.find('/', host_start);
+    return url.substr(0, path_start);
+}
+
+esp_err_t PooledHttp::EventHandler(esp_http_client_event_t* event) {
+    auto self = static_cast<PooledHttp*>(event->user_data);
+    if (event->event_id == HTTP_EVENT_ON_HEADER && self != nullptr) {
+        self->response_headers_[ToLower(event->header_key)] = event->header_value;
+    }
+    return ESP_OK;
+}
+
+esp_http_client_handle_t PooledHttp::CreateClient(const std::string& url) {
+    esp_http_client_config_t config = {};
+    config.url = url.c_str();
+    config.timeout_ms = timeout_ms_;
+    config.crt_bundle_attach = esp_crt_bundle_attach;
+    config.event_handler = EventHandler;
+    config.user_data = this;
+    config.keep_alive_enable = true;
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    // 连接断开后重连时用票据恢复 TLS 会话
+    config.save_client_session = true;
+#endif
+    return esp_http_client_init(&config);
+}
+
+static esp_http_client_method_t MethodOf(const std::string& method) {
+    if (method == "POST") {
+        return HTTP_METHOD_POST;
+    } else if (method == "PUT") {
+        return HTTP_METHOD_PUT;
+    } else if (method == "DELETE") {
+        return HTTP_METHOD_DELETE;
+    } else if (method == "HEAD") {
+        return HTTP_METHOD_HEAD;
+    } else if (method == "PATCH") {
+        return HTTP_METHOD_PATCH;
+    }
+    return HTTP_METHOD_GET;
+}
+
+bool PooledHttp::SendRequest(const std::string& method, const std::string& url) {
+    response_headers_.clear();
+    headers_fetched_ = false;
+    status_code_ = -1;
+    content_length_ = 0;
+
+    esp_http_client_set_method(client_, MethodOf(method));
+    esp_http_client_set_timeout_ms(client_, timeout_ms_);
+    auto encoding = headers_.find("Transfer-Encoding");
+    chunked_ = encoding != headers_.end() && encoding->second == "chunked";
+    for (auto& [key, value] : headers_) {
+        // 分块传输的头由 esp_http_client_open 按写入长度添加
+        if (key != "Transfer-Encoding") {
+            esp_http_client_set_header(client_, key.c_str(), value.c_str());
+        }
+    }
+    if (esp_http_client_open(client_, chunked_ ? -1 : content_.size()) != ESP_OK) {
+        return false;
+    }
+    size_t written = 0;
+    while (written < content_.size()) {
+        int ret = esp_http_client_write(client_, content_.data() + written, content_.size() - written);
+        if (ret <= 0) {
+            return false;
+        }
+        written += ret;
+    }
+    // 请求体已经完整，马上读响应头，复用的连接已被服务器关闭时还能重新发送
+    return chunked_ || FetchHeaders();
+}
+
+bool PooledHttp::Open(const std::string& method, const std::string& url) {
+    Close();
+    origin_ = OriginOf(url);
+    bool connected = false;
+    client_ = HttpConnectionPool::GetInstance().Acquire(origin_, connected);
+    if (client_ != nullptr) {
+        esp_http_client_set_url(client_, url.c_str());
+        esp_http_client_set_user_data(client_, this);
+        (connected ? metric_reused : metric_resumed).Add();
+    } else {
+        client_ = CreateClient(url);
+        if (client_ == nullptr) {
+            ESP_LOGE(TAG, "Failed to create HTTP client");
+            return false;
+        }
+        metric_new.Add();
+    }
+
+    if (SendRequest(method, url)) {
+        return true;
+    }
+    if (connected) {
+        // 服务器先一步关闭了空闲连接，重新连接再发一次
+        ESP_LOGI(TAG, "Pooled connection to %s is stale, reconnecting", origin_.c_str());
+        esp_http_client_close(client_);
+        if (SendRequest(method, url)) {
+            return true;
+        }
+    }
+    ESP_LOGE(TAG, "Failed to open %s", url.c_str());
+    failed_ = true;
+    Close();
+    return false;
+}
+
+bool PooledHttp::FetchHeaders() {
+    if (headers_fetched_) {
+        return status_code_ > 0;
+    }
+    headers_fetched_ = true;
+    content_length_ = esp_http_client_fetch_headers(client_);
+    if (content_length_ < 0) {
+        failed_ = true;
+        return false;
+    }
+    status_code_ = esp_http_client_get_status_code(client_);
+    return status_code_ > 0;
+}
+
+void PooledHttp::Close() {
+    if (client_ == nullptr) {
+        return;
+    }
+    // 响应读完且服务器没有要求关闭时连接留在池中，否则只留下 TLS 会话
+    auto connection = response_headers_.find("connection");
+    bool keep_alive = !failed_ && status_code_ > 0 && esp_http_client_is_complete_data_received(client_) &&
+        (connection == response_headers_.end() || ToLower(connection->second) != "close");
+    if (!keep_alive) {
+        esp_http_client_close(client_);
+    }
+    // 请求头保存在句柄中，清掉后再给下一个请求用
+    for (auto& [key, value] : headers_) {
+        esp_http_client_delete_header(client_, key.c_str());
+    }
+    esp_http_client_delete_header(client_, "Content-Length");
+    esp_http_client_set_user_data(client_, nullptr);
+    HttpConnectionPool::GetInstance().Release(origin_, client_, keep_alive);
+
+    client_ = nullptr;
+    headers_.clear();
+    response_headers_.clear();
+    content_.clear();
+    chunked_ = false;
+    headers_fetched_ = false;
+    failed_ = false;
+    status_code_ = -1;
+    content_length_ = 0;
+}
+
+int PooledHttp::Write(const char* buffer, size_t buffer_size) {
+    if (client_ == nullptr || failed_) {
+        return -1;
+    }
+    auto write_all = [this](const char* data, size_t size) {
+        size_t written = 0;
+        while (written < size) {
+            int ret = esp_http_client_write(client_, data + written, size - written);
+            if (ret <= 0) {
+                return false;
+            }
+            written += ret;
+        }
+        return true;
+    };
+    bool ok;
+    if (!chunked_) {
+        ok = write_all(buffer, buffer_size);
+    } else if (buffer_size == 0) {
+        ok = write_all("0\r\n\r\n", 5);
+    } else {
+        char header[16];
+        int length = snprintf(header, sizeof(header), "%x\r\n", (unsigned)buffer_size);
+        ok = write_all(header, length) && write_all(buffer, buffer_size) && write_all("\r\n", 2);
+    }
+    if (!ok) {
+        failed_ = true;
+        return -1;
+    }
+    return buffer_size;
+}
+
+int PooledHttp::GetStatusCode() {
+    if (client_ == nullptr || !FetchHeaders()) {
+        return -1;
+    }
+    return status_code_;
+}
+
+std::string PooledHttp::GetResponseHeader(const std::string& key) const {
+    auto it = response_headers_.find(ToLower(key));
+    return it == response_headers_.end() ? std::string() : it->second;
+}
+
+size_t PooledHttp::GetBodyLength() {
+    if (client_ == nullptr || !FetchHeaders()) {
+        return 0;
+    }
+    // 分块响应没有长度
+    return content_length_ > 0 ? content_length_ : 0;
+}
+
+int PooledHttp::Read(char* buffer, size_t buffer_size) {
+    if (client_ == nullptr || !FetchHeaders()) {
+        return -1;
+    }
+    int ret = esp_http_client_read(client_, buffer, buffer_size);
+    if (ret < 0) {
+        failed_ = true;
+    }
+    return ret;
+}
+
+std::string PooledHttp::ReadAll() {
+    std::string body;
+    char buffer[512];
+    while (true) {
+        int ret = Read(buffer, sizeof(buffer));
+        if (ret <= 0) {
+            break;
+        }
+        body.append(buffer, ret);
+    }
+    return body;
+}
+
+#endif // CONFIG_HTTP_CONNECTION_POOL
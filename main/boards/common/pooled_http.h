@@ -0,0 +1,84 @@
+#ifndef POOLED_HTTP_H
+#define POOLED_HTTP_H
+
+#include <http.h>
+#include <esp_http_client.h>
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 按 scheme://host:port 保存用完的 esp_http_client 句柄，下一次请求同一个主机时直接复用
+// 连接保持 CONFIG_HTTP_POOL_IDLE_SECONDS 秒，超时后断开 socket 释放 TLS 的缓冲区，句柄本身留下来，
+// 重新连接时用保存的 TLS 会话票据恢复会话，省掉完整握手；超过 CONFIG_HTTP_POOL_MAX_HOSTS 个主机时释放最久没用的
+class HttpConnectionPool {
+public:
+    static HttpConnectionPool& GetInstance() {
+        static HttpConnectionPool instance;
+        return instance;
+    }
+
+    // 取出该主机的句柄，由调用方独占，没有时返回 nullptr；connected 表示连接还保持着
+    esp_http_client_handle_t Acquire(const std::string& origin, bool& connected);
+    // 放回用完的句柄，connected 为 false 时只保留会话
+    void Release(const std::string& origin, esp_http_client_handle_t client, bool connected);
+
+private:
+    struct Entry {
+        std::string origin;
+        esp_http_client_handle_t client;
+        bool connected;
+        int64_t idle_since_us;
+    };
+
+    std::mutex mutex_;
+    std::vector<Entry> entries_;
+    int timer_id_ = -1;
+
+    HttpConnectionPool() = default;
+    void EvictIdle();
+    void ScheduleEviction();
+};
+
+// Wi-Fi 板子的 Http 实现，和 EspHttp 一样基于 esp_http_client，但 Close 时把读完响应的连接放回 HttpConnectionPool
+// 启动时的版本检查和激活、连续几次拍照提问都发往同一个主机，不用每次重新 TCP 连接和 TLS 握手
+class PooledHttp : public Http {
+public:
+    PooledHttp() = default;
+    ~PooledHttp() override;
+
+    void SetTimeout(int timeout_ms) override;
+    void SetHeader(const std::string& key, const std::string& value) override;
+    void SetContent(std::string&& content) override;
+    bool Open(const std::string& method, const std::string& url) override;
+    void Close() override;
+    int Read(char* buffer, size_t buffer_size) override;
+    int Write(const char* buffer, size_t buffer_size) override;
+    int GetStatusCode() override;
+    std::string GetResponseHeader(const std::string& key) const override;
+    size_t GetBodyLength() override;
+    std::string ReadAll() override;
+
+private:
+    esp_http_client_handle_t client_ = nullptr;
+    std::string origin_;
+    int timeout_ms_ = 30000;
+    std::map<std::string, std::string> headers_;
+    std::map<std::string, std::string> response_headers_;
+    std::string content_;
+    bool chunked_ = false;
+    bool headers_fetched_ = false;
+    bool failed_ = false;
+    int status_code_ = -1;
+    int64_t content_length_ = 0;
+
+    esp_http_client_handle_t CreateClient(const std::string& url);
+    bool SendRequest(const std::string& method, const std::string& url);
+    bool FetchHeaders();
+    static std::string OriginOf(const std::string& url);
+    static esp_err_t EventHandler(esp_http_client_event_t* event);
+};
+
+#endif // POOLED_HTTP_H
@@ -1,39 +1,42 @@
 #include "power_save_timer.h"
 #include "application.h"
+#include "board.h"
+#include "display.h"
+#include "power_governor.h"
+#include "timer_service.h"
 
 #include <esp_log.h>
 
 #define TAG "PowerSaveTimer"
 
+// 唤醒后检查是否可以恢复界面的间隔，以及最多推迟多久
+#define POWER_SAVE_RESTORE_POLL_MS 50
+#define POWER_SAVE_RESTORE_MAX_MS 1500
 
 PowerSaveTimer::PowerSaveTimer(int cpu_max_freq, int seconds_to_sleep, int seconds_to_shutdown)
     : cpu_max_freq_(cpu_max_freq), seconds_to_sleep_(seconds_to_sleep), seconds_to_shutdown_(seconds_to_shutdown) {
-    esp_timer_create_args_t timer_args = {
-        .callback = [](void* arg) {
-            auto self = static_cast<PowerSaveTimer*>(arg);
-            self->PowerSaveCheck();
-        },
-        .arg = this,
-        .dispatch_method = ESP_TIMER_TASK,
-        .name = "power_save_timer",
-        .skip_unhandled_events = true,
-    };
-    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &power_save_timer_));
+    // 按秒计数，晚 200ms 检查不影响进入睡眠的时机
+    power_save_timer_ = TimerService::GetInstance().Create("power_save_timer", [this]() {
+        PowerSaveCheck();
+    }, 200);
+    restore_timer_ = TimerService::GetInstance().Create("power_save_restore", [this]() {
+        CheckRestoreUi();
+    });
 }
 
 PowerSaveTimer::~PowerSaveTimer() {
-    esp_timer_stop(power_save_timer_);
-    esp_timer_delete(power_save_timer_);
+    TimerService::GetInstance().Stop(power_save_timer_);
+    TimerService::GetInstance().Stop(restore_timer_);
 }
 
 void PowerSaveTimer::SetEnabled(bool enabled) {
     if (enabled && !enabled_) {
         ticks_ = 0;
         enabled_ = enabled;
-        ESP_ERROR_CHECK(esp_timer_start_periodic(power_save_timer_, 1000000));
+        TimerService::GetInstance().StartPeriodic(power_save_timer_, 1000);
         ESP_LOGI(TAG, "Power save timer enabled");
     } else if (!enabled && enabled_) {
-        ESP_ERROR_CHECK(esp_timer_stop(power_save_timer_));
+        TimerService::GetInstance().Stop(power_save_timer_);
         enabled_ = enabled;
         WakeUp();
         ESP_LOGI(TAG, "Power save timer disabled");
@@ -63,11 +66,19 @@ void PowerSaveTimer::PowerSaveCheck() {
     if (seconds_to_sleep_ != -1 && ticks_ >= seconds_to_sleep_) {
         if (!in_sleep_mode_) {
             in_sleep_mode_ = true;
+            if (restore_pending_) {
+                // 上一次唤醒的界面还没恢复，直接按睡眠处理
+                restore_pending_ = false;
+                TimerService::GetInstance().Stop(restore_timer_);
+            }
             if (on_enter_sleep_mode_) {
                 on_enter_sleep_mode_();
             }
+            // 回调里更新的界面画完后 LVGL 任务会暂停，提高 light sleep 的时间占比
+            Board::GetInstance().GetDisplay()->SetSleeping(true);
 
-            if (cpu_max_freq_ != -1) {
+            // 开启 PowerGovernor 时 DFS 和 light sleep 由它按设备状态管理
+            if (cpu_max_freq_ != -1 && !PowerGovernor::GetInstance().enabled()) {
                 esp_pm_config_t pm_config = {
                     .max_freq_mhz = cpu_max_freq_,
                     .min_freq_mhz = 40,
@@ -82,12 +93,16 @@ void PowerSaveTimer::PowerSaveCheck() {
     }
 }
 
+// 唤醒时先恢复 CPU 频率、关闭 light sleep，让唤醒词上传和握手马上开始；
+// 亮屏、背光渐变和界面重绘推迟到进入聆听（或者没有开始对话）之后，不和握手抢 CPU 和 SPI
 void PowerSaveTimer::WakeUp() {
     ticks_ = 0;
     if (in_sleep_mode_) {
         in_sleep_mode_ = false;
+        wake_us_ = esp_timer_get_time();
+        Application::GetInstance().OnSleepWake();
 
-        if (cpu_max_freq_ != -1) {
+        if (cpu_max_freq_ != -1 && !PowerGovernor::GetInstance().enabled()) {
             esp_pm_config_t pm_config = {
                 .max_freq_mhz = cpu_max_freq_,
                 .min_freq_mhz = cpu_max_freq_,
@@ -96,8 +111,30 @@ void PowerSaveTimer::WakeUp() {
             esp_pm_configure(&pm_config);
         }
 
-        if (on_exit_sleep_mode_) {
-            on_exit_sleep_mode_();
-        }
+        // 按键唤醒时 ToggleChatState 在 WakeUp 之后才调度，第一次检查稍后进行
+        restore_pending_ = true;
+        TimerService::GetInstance().StartPeriodic(restore_timer_, POWER_SAVE_RESTORE_POLL_MS);
+    }
+}
+
+void PowerSaveTimer::CheckRestoreUi() {
+    if (!restore_pending_) {
+        TimerService::GetInstance().Stop(restore_timer_);
+        return;
+    }
+    int elapsed_ms = (esp_timer_get_time() - wake_us_) / 1000;
+    if (Application::GetInstance().GetDeviceState() == kDeviceStateConnecting && elapsed_ms < POWER_SAVE_RESTORE_MAX_MS) {
+        return;
+    }
+    TimerService::GetInstance().Stop(restore_timer_);
+    RestoreUi();
+    ESP_LOGI(TAG, "Display restored %d ms after wake", elapsed_ms);
+}
+
+void PowerSaveTimer::RestoreUi() {
+    restore_pending_ = false;
+    Board::GetInstance().GetDisplay()->SetSleeping(false);
+    if (on_exit_sleep_mode_) {
+        on_exit_sleep_mode_();
     }
 }
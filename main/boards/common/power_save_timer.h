@@ -18,8 +18,14 @@ public:
 
 private:
     void PowerSaveCheck();
+    void CheckRestoreUi();
+    void RestoreUi();
 
-    esp_timer_handle_t power_save_timer_ = nullptr;
+    int power_save_timer_ = -1;
+    // 唤醒后延后恢复界面，等音频先跑起来
+    int restore_timer_ = -1;
+    int64_t wake_us_ = 0;
+    bool restore_pending_ = false;
     bool enabled_ = false;
     bool in_sleep_mode_ = false;
     int ticks_ = 0;
@@ -0,0 +1,145 @@
+#include "realtime_socket.h"
+#include "task_stack.h"
+#include "endpoint_cache.h"
+#include "metrics.h"
+
+#include <esp_log.h>
+#include <lwip/sockets.h>
+
+#define TAG "RealtimeSocket"
+
+// 和以太网帧对齐，服务器不会发更大的 UDP 包
+#define REALTIME_UDP_MAX_PACKET 1500
+
+static MetricCounter metric_udp_receive_errors("udp.receive_errors");
+
+void ConfigureRealtimeSocket(int fd, bool stream) {
+    if (stream) {
+        // 每帧音频都很小，不等前一帧的 ACK 再发
+        int nodelay = 1;
+        if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay)) != 0) {
+            ESP_LOGW(TAG, "Failed to set TCP_NODELAY: %d", errno);
+        }
+    }
+    int tos = CONFIG_REALTIME_AUDIO_DSCP << 2;
+    if (setsockopt(fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos)) != 0) {
+        ESP_LOGW(TAG, "Failed to set IP_TOS: %d", errno);
+    }
+}
+
+// 地址来自 EndpointCache，TCP 同时尝试多个地址
+static int ConnectSocket(const char* host, int port, int type) {
+    return EndpointCache::GetInstance().Connect(host, port, type, [type](int fd) {
+        ConfigureRealtimeSocket(fd, type == SOCK_STREAM);
+    });
+}
+
+RealtimeTcpTransport::~RealtimeTcpTransport() {
+    Disconnect();
+}
+
+bool RealtimeTcpTransport::Connect(const char* host, int port) {
+    Disconnect();
+    fd_ = ConnectSocket(host, port, SOCK_STREAM);
+    connected_ = fd_ >= 0;
+    return connected_;
+}
+
+void RealtimeTcpTransport::Disconnect() {
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+    connected_ = false;
+}
+
+int RealtimeTcpTransport::Send(const char* data, size_t length) {
+    size_t sent = 0;
+    while (sent < length) {
+        int ret = send(fd_, data + sent, length - sent, 0);
+        if (ret <= 0) {
+            ESP_LOGE(TAG, "Send failed: %d", errno);
+            connected_ = false;
+            return ret;
+        }
+        sent += ret;
+    }
+    return sent;
+}
+
+int RealtimeTcpTransport::Receive(char* buffer, size_t bufferSize) {
+    int ret = recv(fd_, buffer, bufferSize, 0);
+    if (ret <= 0) {
+        connected_ = false;
+    }
+    return ret;
+}
+
+RealtimeUdp::RealtimeUdp() {
+    receive_done_ = xSemaphoreCreateBinary();
+}
+
+RealtimeUdp::~RealtimeUdp() {
+    Disconnect();
+    vSemaphoreDelete(receive_done_);
+}
+
+bool RealtimeUdp::Connect(const std::string& host, int port) {
+    Disconnect();
+    fd_ = ConnectSocket(host.c_str(), port, SOCK_DGRAM);
+    if (fd_ < 0) {
+        return false;
+    }
+    connected_ = true;
+    bool created = TaskStack::Create("udp_receive", 4096, 1, kTaskStackPsram, [this]() {
+        ReceiveLoop();
+        xSemaphoreGive(receive_done_);
+    });
+    if (!created) {
+        ESP_LOGE(TAG, "Failed to start UDP receive task");
+        close(fd_);
+        fd_ = -1;
+        connected_ = false;
+    }
+    return connected_;
+}
+
+void RealtimeUdp::Disconnect() {
+    if (fd_ < 0) {
+        return;
+    }
+    connected_ = false;
+    // 让阻塞的 recv 返回，等接收任务退出后再关闭
+    shutdown(fd_, SHUT_RDWR);
+    xSemaphoreTake(receive_done_, portMAX_DELAY);
+    close(fd_);
+    fd_ = -1;
+}
+
+int RealtimeUdp::Send(const std::string& data) {
+    int ret = send(fd_, data.data(), data.size(), 0);
+    if (ret <= 0) {
+        ESP_LOGW(TAG, "Send failed: %d", errno);
+    }
+    return ret;
+}
+
+void RealtimeUdp::ReceiveLoop() {
+    std::string data;
+    data.reserve(REALTIME_UDP_MAX_PACKET);
+    while (connected_) {
+        data.resize(REALTIME_UDP_MAX_PACKET);
+        int ret = recv(fd_, &data[0], data.size(), 0);
+        if (ret < 0) {
+            if (connected_) {
+                metric_udp_receive_errors.Add();
+                ESP_LOGE(TAG, "Receive failed: %d", errno);
+            }
+            break;
+        }
+        data.resize(ret);
+        if (message_callback_) {
+            message_callback_(data);
+        }
+    }
+}
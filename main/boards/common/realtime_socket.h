@@ -0,0 +1,49 @@
+#ifndef REALTIME_SOCKET_H
+#define REALTIME_SOCKET_H
+
+#include <transport.h>
+#include <udp.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include <string>
+
+// 语音通道的 socket 选项：TCP 关闭 Nagle，UDP/TCP 都按 CONFIG_REALTIME_AUDIO_DSCP 标记 DSCP，
+// Wi-Fi 驱动按 IP 头的优先级把包放进 WMM 的语音/视频队列
+void ConfigureRealtimeSocket(int fd, bool stream);
+
+// 明文 WebSocket 使用的 TCP 传输层，和 TcpTransport 一样但建连后设置实时选项
+// TLS 传输层的 socket 在组件内部，无法设置
+class RealtimeTcpTransport : public Transport {
+public:
+    RealtimeTcpTransport() = default;
+    ~RealtimeTcpTransport() override;
+
+    bool Connect(const char* host, int port) override;
+    void Disconnect() override;
+    int Send(const char* data, size_t length) override;
+    int Receive(char* buffer, size_t bufferSize) override;
+
+private:
+    int fd_ = -1;
+};
+
+// MQTT+UDP 的音频通道，接收任务的栈可以放在 PSRAM，每个收包复用同一个缓冲区
+class RealtimeUdp : public Udp {
+public:
+    RealtimeUdp();
+    ~RealtimeUdp() override;
+
+    bool Connect(const std::string& host, int port) override;
+    void Disconnect() override;
+    int Send(const std::string& data) override;
+
+private:
+    int fd_ = -1;
+    SemaphoreHandle_t receive_done_ = nullptr;
+
+    void ReceiveLoop();
+};
+
+#endif // REALTIME_SOCKET_H
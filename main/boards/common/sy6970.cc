@@ -6,7 +6,7 @@
 
 #define TAG "Sy6970"
 
-Sy6970::Sy6970(i2c_master_bus_handle_t i2c_bus, uint8_t addr) : I2cDevice(i2c_bus, addr) {
+Sy6970::Sy6970(i2c_master_bus_handle_t i2c_bus, uint8_t addr) : I2cDevice(i2c_bus, addr, kI2cPriorityBattery) {
 }
 
 int Sy6970::GetChangingStatus() {
@@ -43,12 +43,10 @@ int Sy6970::GetChargeTargetVoltage() {
     return value * 16 + 3840;
 }
 
-int Sy6970::GetBatteryLevel() {
+static int VoltageToLevel(int battery_voltage, int charge_voltage_limit) {
     int level = 0;
     // 电池所能掉电的最低电压
     int battery_minimum_voltage = 3200;
-    int battery_voltage = GetBatteryVoltage();
-    int charge_voltage_limit = GetChargeTargetVoltage();
     // ESP_LOGI(TAG, "battery_voltage: %d, charge_voltage_limit: %d", battery_voltage, charge_voltage_limit);
     if (battery_voltage > battery_minimum_voltage && charge_voltage_limit > battery_minimum_voltage) {
         level = (((float) battery_voltage - (float) battery_minimum_voltage) / ((float) charge_voltage_limit - (float) battery_minimum_voltage)) * 100.0;
@@ -60,6 +58,28 @@ int Sy6970::GetBatteryLevel() {
     return level;
 }
 
+int Sy6970::GetBatteryLevel() {
+    return VoltageToLevel(GetBatteryVoltage(), GetChargeTargetVoltage());
+}
+
+bool Sy6970::ReadBatteryState(BatteryState& state) {
+    // 充电目标电压是配置值，只读一次
+    if (charge_target_voltage_ == 0) {
+        charge_target_voltage_ = GetChargeTargetVoltage();
+    }
+    uint8_t regs[4];
+    ReadRegs(0x0B, regs, sizeof(regs));
+    int charging_status = (regs[0] >> 3) & 0x03;
+    state.charging = charging_status != 0;
+    state.charging_done = charging_status == 3;
+    state.external_power = (regs[0] & 0x04) != 0;
+    state.discharging = !state.external_power;
+    uint8_t value = regs[3] & 0x7F;
+    int battery_voltage = value == 0 ? 0 : value * 20 + 2304;
+    state.level = VoltageToLevel(battery_voltage, charge_target_voltage_);
+    return true;
+}
+
 void Sy6970::PowerOff() {
     WriteReg(0x09, 0B01100100);
 }
@@ -2,6 +2,7 @@
 #define __SY6970_H__
 
 #include "i2c_device.h"
+#include "battery_monitor.h"
 
 class Sy6970 : public I2cDevice {
 public:
@@ -11,8 +12,12 @@ public:
     bool IsChargingDone();
     int GetBatteryLevel();
     void PowerOff();
+    // 给 BatteryMonitor 用：一次读出 0x0B-0x0E 的状态和电池电压
+    bool ReadBatteryState(BatteryState& state);
 
 private:
+    int charge_target_voltage_ = 0;
+
     int GetChangingStatus();
     int GetBatteryVoltage();
     int GetChargeTargetVoltage();
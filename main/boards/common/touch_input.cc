@@ -0,0 +1,141 @@
+#include "touch_input.h"
+#include "task_stack.h"
+#include "metrics.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_lvgl_port.h>
+
+#define TAG "TouchInput"
+
+static MetricCounter metric_interrupts("touch.interrupts");
+static MetricCounter metric_reads("touch.reads");
+// 同一次读取之前到达的多余中断
+static MetricCounter metric_coalesced("touch.coalesced");
+static MetricCounter metric_errors("touch.errors");
+// 从中断到 LVGL 读到这次采样
+static MetricHistogram metric_latency_us("touch.latency_us", METRIC_DURATION_US_BOUNDS);
+
+// 中断时间只在 ISR 中写，撕裂读取最多影响一次延迟统计
+static volatile int64_t last_interrupt_us = 0;
+
+TouchInput::TouchInput(gpio_num_t int_gpio, Reader reader) : int_gpio_(int_gpio), reader_(std::move(reader)) {
+    TaskStack::Create("touch_input", 3 * 1024, 5, kTaskStackInternal, [this]() {
+        Run();
+    }, &task_);
+
+    gpio_config_t config = {
+        .pin_bit_mask = (1ULL << int_gpio_),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_NEGEDGE,
+    };
+    ESP_ERROR_CHECK(gpio_config(&config));
+    // 其它驱动可能已经安装过中断服务
+    esp_err_t ret = gpio_install_isr_service(0);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Failed to install GPIO ISR service: %s", esp_err_to_name(ret));
+    }
+    ESP_ERROR_CHECK(gpio_isr_handler_add(int_gpio_, IsrHandler, this));
+    ESP_LOGI(TAG, "Touch input on GPIO %d", int_gpio_);
+}
+
+TouchInput::~TouchInput() {
+    gpio_isr_handler_remove(int_gpio_);
+    if (task_ != nullptr) {
+        TaskStack::Delete(task_);
+    }
+    if (indev_ != nullptr && lvgl_port_lock(0)) {
+        lv_indev_delete(indev_);
+        lvgl_port_unlock();
+    }
+}
+
+void TouchInput::OnSample(std::function<void(const TouchSample& sample)> callback) {
+    on_sample_ = std::move(callback);
+}
+
+lv_indev_t* TouchInput::AttachLvgl() {
+    if (!lvgl_port_lock(0)) {
+        return nullptr;
+    }
+    indev_ = lv_indev_create();
+    lv_indev_set_type(indev_, LV_INDEV_TYPE_POINTER);
+    lv_indev_set_read_cb(indev_, LvglRead);
+    lv_indev_set_user_data(indev_, this);
+    // 事件模式下 LVGL 的定时器不再轮询，由触摸任务在有新采样时触发读取
+    lv_indev_set_mode(indev_, LV_INDEV_MODE_EVENT);
+    lvgl_port_unlock();
+    return indev_;
+}
+
+TouchSample TouchInput::latest() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return latest_;
+}
+
+void IRAM_ATTR TouchInput::IsrHandler(void* arg) {
+    auto input = static_cast<TouchInput*>(arg);
+    if (input->task_ == nullptr) {
+        return;
+    }
+    last_interrupt_us = esp_timer_get_time();
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(input->task_, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+void TouchInput::LvglRead(lv_indev_t* indev, lv_indev_data_t* data) {
+    auto input = static_cast<TouchInput*>(lv_indev_get_user_data(indev));
+    auto sample = input->latest();
+    data->point.x = sample.x;
+    data->point.y = sample.y;
+    data->state = sample.pressed ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+}
+
+void TouchInput::Run() {
+    while (true) {
+        // 松开后一直等到下一次中断，空闲时不访问 I2C
+        uint32_t interrupts = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        metric_interrupts.Add(interrupts);
+        metric_coalesced.Add(interrupts - 1);
+
+        bool pressed = true;
+        while (pressed) {
+            TouchSample sample;
+            metric_reads.Add();
+            if (!reader_(sample)) {
+                // 读取失败按松开处理，避免 LVGL 停在按下状态
+                metric_errors.Add();
+                sample = latest();
+                sample.pressed = false;
+            }
+            sample.time_us = last_interrupt_us;
+            Deliver(sample);
+            pressed = sample.pressed;
+            if (pressed) {
+                // 按住期间每帧读一次，这一帧内到达的中断合并到下一次读取
+                vTaskDelay(pdMS_TO_TICKS(TOUCH_INPUT_FRAME_MS));
+                interrupts = ulTaskNotifyTake(pdTRUE, 0);
+                metric_interrupts.Add(interrupts);
+                metric_coalesced.Add(interrupts);
+            }
+        }
+    }
+}
+
+void TouchInput::Deliver(const TouchSample& sample) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        latest_ = sample;
+    }
+    if (on_sample_) {
+        on_sample_(sample);
+    }
+    if (indev_ != nullptr && lvgl_port_lock(TOUCH_INPUT_FRAME_MS)) {
+        lv_indev_read(indev_);
+        lvgl_port_unlock();
+        metric_latency_us.Record(esp_timer_get_time() - sample.time_us);
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef TOUCH_INPUT_H
+#define TOUCH_INPUT_H
+
+#include <driver/gpio.h>
+#include <esp_attr.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <lvgl.h>
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+// 按住期间最多每隔这么多毫秒读一次触摸芯片，同一帧内的多次中断和移动合并成一次读取
+#define TOUCH_INPUT_FRAME_MS 16
+
+struct TouchSample {
+    int16_t x = 0;
+    int16_t y = 0;
+    bool pressed = false;
+    int64_t time_us = 0;    // 触发这次读取的中断时间
+};
+
+// 中断驱动的触摸输入
+// 只在 INT 引脚触发后通过 I2C 读取触摸芯片，空闲时没有任何 I2C 访问和定时唤醒；按住期间按帧读取，直到松开
+// 读到的采样交给 OnSample 的回调（板子自己的点击判断），并以事件模式喂给 LVGL 的指针输入设备，
+// LVGL 的读回调只返回最近一次采样，不访问总线
+class TouchInput {
+public:
+    // reader 在触摸任务中调用，读取当前触摸点，失败返回 false
+    using Reader = std::function<bool(TouchSample& sample)>;
+
+    TouchInput(gpio_num_t int_gpio, Reader reader);
+    ~TouchInput();
+
+    TouchInput(const TouchInput&) = delete;
+    TouchInput& operator=(const TouchInput&) = delete;
+
+    // 每次读取后在触摸任务中调用
+    void OnSample(std::function<void(const TouchSample& sample)> callback);
+    // 创建 LVGL 指针输入设备，需要在显示初始化之后调用
+    lv_indev_t* AttachLvgl();
+
+    TouchSample latest();
+
+private:
+    gpio_num_t int_gpio_;
+    Reader reader_;
+    std::function<void(const TouchSample&)> on_sample_;
+    TaskHandle_t task_ = nullptr;
+    lv_indev_t* indev_ = nullptr;
+    std::mutex mutex_;
+    TouchSample latest_;
+
+    static void IRAM_ATTR IsrHandler(void* arg);
+    static void LvglRead(lv_indev_t* indev, lv_indev_data_t* data);
+    void Run();
+    void Deliver(const TouchSample& sample);
+};
+
+#endif // TOUCH_INPUT_H
@@ -5,6 +5,8 @@
 #include "system_info.h"
 #include "font_awesome_symbols.h"
 #include "settings.h"
+#include "metrics.h"
+#include "performance_profile.h"
 #include "assets/lang_config.h"
 
 #include <freertos/FreeRTOS.h>
@@ -16,14 +18,26 @@
 #include <tls_transport.h>
 #include <web_socket.h>
 #include <esp_log.h>
+#include <esp_wifi.h>
+#include <esp_timer.h>
+#include <algorithm>
 
 #include <wifi_station.h>
 #include <wifi_configuration_ap.h>
 #include <ssid_manager.h>
 #include "afsk_demod.h"
+#include "realtime_socket.h"
+#include "endpoint_cache.h"
+#include "wifi_fast_connect.h"
+#include "pooled_http.h"
 
 static const char *TAG = "WifiBoard";
 
+#if CONFIG_IDF_TARGET_ESP32P4
+// 查询 RSSI 是发给 Wi-Fi 协处理器的一次 RPC，耗时近似主机链路的往返时间
+static MetricHistogram metric_remote_rpc_us("wifi.remote_rpc_us", METRIC_NETWORK_US_BOUNDS);
+#endif
+
 WifiBoard::WifiBoard() {
     Settings settings("wifi", true);
     wifi_config_mode_ = settings.GetInt("force_ap") == 1;
@@ -103,6 +117,9 @@ void WifiBoard::StartNetwork() {
         notification += ssid;
         display->ShowNotification(notification.c_str(), 30000);
     });
+#if CONFIG_WIFI_FAST_CONNECT
+    WifiFastConnect::GetInstance().Install();
+#endif
     wifi_station.Start();
 
     // Try to connect to WiFi, if failed, launch the WiFi configuration AP
@@ -112,10 +129,45 @@ void WifiBoard::StartNetwork() {
         EnterWifiConfigMode();
         return;
     }
+
+#if CONFIG_ENDPOINT_CACHE
+    // OTA 检查和打开音频通道之前先把要连接的主机名解析好
+    Settings ota_settings("wifi", false);
+    Settings websocket_settings("websocket", false);
+    Settings mqtt_settings("mqtt", false);
+    auto ota_url = ota_settings.GetString("ota_url");
+    EndpointCache::GetInstance().Prefetch({
+        EndpointCache::HostOf(ota_url.empty() ? CONFIG_OTA_URL : ota_url),
+        EndpointCache::HostOf(websocket_settings.GetString("url")),
+        EndpointCache::HostOf(mqtt_settings.GetString("endpoint")),
+    });
+#endif
+}
+
+void WifiBoard::StartStandbyNetwork() {
+    if (SsidManager::GetInstance().GetSsidList().empty()) {
+        ESP_LOGI(TAG, "No WiFi configured, standby disabled");
+        return;
+    }
+    // WifiStation 断开后会自己重连，这里只等第一次连接用来设置省电
+    auto& wifi_station = WifiStation::GetInstance();
+#if CONFIG_WIFI_FAST_CONNECT
+    WifiFastConnect::GetInstance().Install();
+#endif
+    wifi_station.Start();
+    if (!wifi_station.WaitForConnected(60 * 1000)) {
+        ESP_LOGW(TAG, "Standby WiFi not connected yet");
+        return;
+    }
+    SetPowerSaveMode(true);
 }
 
 Http* WifiBoard::CreateHttp() {
+#if CONFIG_HTTP_CONNECTION_POOL
+    return new PooledHttp();
+#else
     return new EspHttp();
+#endif
 }
 
 WebSocket* WifiBoard::CreateWebSocket() {
@@ -124,7 +176,11 @@ WebSocket* WifiBoard::CreateWebSocket() {
     if (url.find("wss://") == 0) {
         return new WebSocket(new TlsTransport());
     } else {
+#if CONFIG_REALTIME_SOCKETS
+        return new WebSocket(new RealtimeTcpTransport());
+#else
         return new WebSocket(new TcpTransport());
+#endif
     }
     return nullptr;
 }
@@ -134,7 +190,11 @@ Mqtt* WifiBoard::CreateMqtt() {
 }
 
 Udp* WifiBoard::CreateUdp() {
+#if CONFIG_REALTIME_SOCKETS
+    return new RealtimeUdp();
+#else
     return new EspUdp();
+#endif
 }
 
 const char* WifiBoard::GetNetworkStateIcon() {
@@ -145,7 +205,13 @@ const char* WifiBoard::GetNetworkStateIcon() {
     if (!wifi_station.IsConnected()) {
         return FONT_AWESOME_WIFI_OFF;
     }
+#if CONFIG_IDF_TARGET_ESP32P4
+    int64_t start = esp_timer_get_time();
+    int8_t rssi = wifi_station.GetRssi();
+    metric_remote_rpc_us.Record(esp_timer_get_time() - start);
+#else
     int8_t rssi = wifi_station.GetRssi();
+#endif
     if (rssi >= -60) {
         return FONT_AWESOME_WIFI;
     } else if (rssi >= -70) {
@@ -172,11 +238,46 @@ std::string WifiBoard::GetBoardJson() {
     return board_json;
 }
 
+// 对话期间关闭省电，避免 DTIM 唤醒间隔给下行 TTS 带来约 100ms 的抖动；空闲时按配置进入 modem sleep
 void WifiBoard::SetPowerSaveMode(bool enabled) {
-    auto& wifi_station = WifiStation::GetInstance();
-    wifi_station.SetPowerSaveMode(enabled);
+    if (wifi_config_mode_ || !WifiStation::GetInstance().IsConnected()) {
+        return;
+    }
+    wifi_ps_type_t mode = WIFI_PS_NONE;
+    if (enabled) {
+#if CONFIG_WIFI_IDLE_PS_MAX_MODEM
+        mode = WIFI_PS_MAX_MODEM;
+        ApplyListenInterval();
+#else
+        mode = WIFI_PS_MIN_MODEM;
+#endif
+    }
+    esp_err_t ret = esp_wifi_set_ps(mode);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to set power save mode %d: %s", mode, esp_err_to_name(ret));
+        return;
+    }
+    ESP_LOGI(TAG, "Power save mode: %s", mode == WIFI_PS_NONE ? "none" : mode == WIFI_PS_MIN_MODEM ? "min modem" : "max modem");
 }
 
+#if CONFIG_WIFI_IDLE_PS_MAX_MODEM
+// 空闲时每 listen_interval 个 beacon 醒来一次，唤醒间隔不超过 MQTT 心跳间隔的 1/10，服务器的响应和推送不会等太久
+// AP 在下一次关联时才会用到新的间隔
+void WifiBoard::ApplyListenInterval() {
+    Settings settings("mqtt", false);
+    int keepalive_ms = PerformanceProfile::GetInstance().Get(kPerfKeepaliveSeconds, settings.GetInt("keepalive", 120)) * 1000;
+    int listen_interval = std::max(1, std::min(CONFIG_WIFI_IDLE_LISTEN_INTERVAL, keepalive_ms / 10 / 102));
+    wifi_config_t config = {};
+    if (esp_wifi_get_config(WIFI_IF_STA, &config) != ESP_OK || config.sta.listen_interval == listen_interval) {
+        return;
+    }
+    config.sta.listen_interval = listen_interval;
+    if (esp_wifi_set_config(WIFI_IF_STA, &config) == ESP_OK) {
+        ESP_LOGI(TAG, "Listen interval: %d beacons", listen_interval);
+    }
+}
+#endif
+
 void WifiBoard::ResetWifiConfiguration() {
     // Set a flag and reboot the device to enter the network configuration mode
     {
@@ -189,7 +290,7 @@ void WifiBoard::ResetWifiConfiguration() {
     esp_restart();
 }
 
-std::string WifiBoard::GetDeviceStatusJson() {
+std::string WifiBoard::BuildDeviceStatusJson() {
     /*
      * 返回设备状态JSON
      * 
@@ -273,6 +374,9 @@ std::string WifiBoard::GetDeviceStatusJson() {
         cJSON_AddItemToObject(root, "chip", chip);
     }
 
+    // 运行时长和内存余量
+    cJSON_AddItemToObject(root, "system", Metrics::GetInstance().CreateSummaryJson());
+
     auto json_str = cJSON_PrintUnformatted(root);
     std::string json(json_str);
     cJSON_free(json_str);
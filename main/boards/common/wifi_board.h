@@ -8,20 +8,28 @@ protected:
     bool wifi_config_mode_ = false;
     void EnterWifiConfigMode();
     virtual std::string GetBoardJson() override;
+#if CONFIG_WIFI_IDLE_PS_MAX_MODEM
+    void ApplyListenInterval();
+#endif
 
 public:
     WifiBoard();
     virtual std::string GetBoardType() override;
     virtual void StartNetwork() override;
+    // 作为双网络板子的待机网络启动：不显示状态，没有配置或连不上时不进入配网模式
+    void StartStandbyNetwork();
     virtual Http* CreateHttp() override;
     virtual WebSocket* CreateWebSocket() override;
     virtual Mqtt* CreateMqtt() override;
     virtual Udp* CreateUdp() override;
     virtual const char* GetNetworkStateIcon() override;
     virtual void SetPowerSaveMode(bool enabled) override;
+#if CONFIG_IDF_TARGET_ESP32P4
+    virtual int GetUplinkBatchFrames() override { return CONFIG_WIFI_REMOTE_UPLINK_BATCH_FRAMES; }
+#endif
     virtual void ResetWifiConfiguration();
     virtual AudioCodec* GetAudioCodec() override { return nullptr; }
-    virtual std::string GetDeviceStatusJson() override;
+    virtual std::string BuildDeviceStatusJson() override;
 };
 
 #endif // WIFI_BOARD_H
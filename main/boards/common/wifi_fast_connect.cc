@@ -0,0 +1,162 @@
+#include "wifi_fast_connect.h"
+#include "settings.h"
+#include "metrics.h"
+#if CONFIG_QUICK_BOOT
+#include "quick_boot.h"
+#endif
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_wifi.h>
+#include <ssid_manager.h>
+#include <cstring>
+
+#define TAG "WifiFastConnect"
+
+static MetricCounter metric_hits("wifi.fast_connect_hits");
+static MetricCounter metric_misses("wifi.fast_connect_misses");
+// 从 Wi-Fi 启动到第一次拿到 IP
+static MetricGauge metric_connect_ms("wifi.connect_ms");
+
+void WifiFastConnect::Install() {
+    if (wifi_handler_ != nullptr) {
+        return;
+    }
+    start_us_ = esp_timer_get_time();
+    has_record_ = Load();
+    // 比 WifiStation 先注册，同一个事件先调用这里的回调
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID,
+        &WifiFastConnect::EventHandler, this, &wifi_handler_));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP,
+        &WifiFastConnect::EventHandler, this, &ip_handler_));
+}
+
+bool WifiFastConnect::Load() {
+#if CONFIG_QUICK_BOOT
+    // 深度睡眠唤醒时 RTC 内存里的记录就是上次连上的 AP，不用读 NVS
+    QuickBoot::Network network;
+    if (QuickBoot::GetInstance().GetNetwork(network)) {
+        record_.ssid = network.ssid;
+        memcpy(record_.bssid, network.bssid, sizeof(record_.bssid));
+        record_.channel = network.channel;
+        record_.phy = network.phy;
+        return true;
+    }
+#endif
+    Settings settings("wifi_fast", false);
+    record_.ssid = settings.GetString("ssid");
+    auto bssid = settings.GetString("bssid");
+    record_.channel = settings.GetInt("channel");
+    record_.phy = settings.GetInt("phy");
+    if (record_.ssid.empty() || bssid.size() != 12 || record_.channel <= 0) {
+        return false;
+    }
+    for (int i = 0; i < 6; i++) {
+        record_.bssid[i] = strtoul(bssid.substr(i * 2, 2).c_str(), nullptr, 16);
+    }
+    return true;
+}
+
+void WifiFastConnect::Save() {
+    wifi_ap_record_t ap = {};
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
+        return;
+    }
+    Record record;
+    record.ssid = reinterpret_cast<const char*>(ap.ssid);
+    memcpy(record.bssid, ap.bssid, sizeof(record.bssid));
+    record.channel = ap.primary;
+    record.phy = (ap.phy_11b ? 1 : 0) | (ap.phy_11g ? 2 : 0) | (ap.phy_11n ? 4 : 0) | (ap.phy_11ax ? 8 : 0);
+#if CONFIG_QUICK_BOOT
+    QuickBoot::GetInstance().SetNetwork({record.ssid, {record.bssid[0], record.bssid[1], record.bssid[2],
+        record.bssid[3], record.bssid[4], record.bssid[5]}, record.channel, record.phy});
+#endif
+    if (record.ssid == record_.ssid && memcmp(record.bssid, record_.bssid, 6) == 0 &&
+        record.channel == record_.channel && record.phy == record_.phy) {
+        return;
+    }
+    record_ = record;
+
+    char bssid[13];
+    snprintf(bssid, sizeof(bssid), "%02x%02x%02x%02x%02x%02x", record.bssid[0], record.bssid[1],
+        record.bssid[2], record.bssid[3], record.bssid[4], record.bssid[5]);
+    Settings settings("wifi_fast", true);
+    settings.SetString("ssid", record.ssid);
+    settings.SetString("bssid", bssid);
+    settings.SetInt("channel", record.channel);
+    settings.SetInt("phy", record.phy);
+    ESP_LOGI(TAG, "Saved AP %s %s channel %d phy 0x%x", record.ssid.c_str(), bssid, record.channel, record.phy);
+}
+
+void WifiFastConnect::Attempt() {
+    // 密码以 SsidManager 为准，记录的 SSID 已被删除时不直连
+    std::string password;
+    bool found = false;
+    for (auto& item : SsidManager::GetInstance().GetSsidList()) {
+        if (item.ssid == record_.ssid) {
+            password = item.password;
+            found = true;
+            break;
+        }
+    }
+    if (!found) {
+        return;
+    }
+
+    wifi_config_t config = {};
+    strlcpy(reinterpret_cast<char*>(config.sta.ssid), record_.ssid.c_str(), sizeof(config.sta.ssid));
+    strlcpy(reinterpret_cast<char*>(config.sta.password), password.c_str(), sizeof(config.sta.password));
+    memcpy(config.sta.bssid, record_.bssid, sizeof(config.sta.bssid));
+    config.sta.bssid_set = true;
+    config.sta.channel = record_.channel;
+    config.sta.scan_method = WIFI_FAST_SCAN;
+    // 支持时协商 PMF 和 SAE H2E，WPA3 的 PMKSA 缓存由驱动在重连时复用
+    config.sta.pmf_cfg.capable = true;
+    config.sta.sae_pwe_h2e = WPA3_SAE_PWE_BOTH;
+    if (esp_wifi_set_config(WIFI_IF_STA, &config) != ESP_OK || esp_wifi_connect() != ESP_OK) {
+        ESP_LOGW(TAG, "Direct connect not started");
+        return;
+    }
+    attempting_ = true;
+    ESP_LOGI(TAG, "Direct connect to %s on channel %d (phy 0x%x)", record_.ssid.c_str(), record_.channel, record_.phy);
+}
+
+void WifiFastConnect::Fallback() {
+    // 去掉 BSSID 和信道，WifiStation 后续的重连在所有信道上按信号强度选 AP
+    wifi_config_t config = {};
+    if (esp_wifi_get_config(WIFI_IF_STA, &config) != ESP_OK) {
+        return;
+    }
+    config.sta.bssid_set = false;
+    config.sta.channel = 0;
+    config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+    config.sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL;
+    esp_wifi_set_config(WIFI_IF_STA, &config);
+}
+
+void WifiFastConnect::EventHandler(void* arg, esp_event_base_t base, int32_t id, void* data) {
+    auto self = static_cast<WifiFastConnect*>(arg);
+    if (base == WIFI_EVENT && id == WIFI_EVENT_STA_START) {
+        if (self->has_record_) {
+            self->Attempt();
+        }
+    } else if (base == WIFI_EVENT && id == WIFI_EVENT_STA_DISCONNECTED) {
+        if (self->attempting_) {
+            self->attempting_ = false;
+            self->has_record_ = false;
+            metric_misses.Add();
+            ESP_LOGW(TAG, "Direct connect failed, fall back to scanning");
+            self->Fallback();
+        }
+    } else if (base == IP_EVENT && id == IP_EVENT_STA_GOT_IP) {
+        if (self->attempting_) {
+            self->attempting_ = false;
+            metric_hits.Add();
+        }
+        if (self->start_us_ != 0) {
+            metric_connect_ms.Set((esp_timer_get_time() - self->start_us_) / 1000);
+            self->start_us_ = 0;
+        }
+        self->Save();
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef WIFI_FAST_CONNECT_H
+#define WIFI_FAST_CONNECT_H
+
+#include <esp_event.h>
+#include <cstdint>
+#include <string>
+
+// 开机时直接连接上次成功的 AP，跳过 WifiStation 的全信道扫描
+// 每次拿到 IP 后记下 SSID、BSSID、信道和 PHY 模式；下次 Wi-Fi 启动时在 WifiStation 扫描之前按记录直接连接，
+// 扫描请求会因为正在连接而被驱动拒绝。直连失败时把配置改回只带 SSID，WifiStation 的重连会在所有信道上查找，
+// 之后仍然回到原来的扫描流程
+class WifiFastConnect {
+public:
+    static WifiFastConnect& GetInstance() {
+        static WifiFastConnect instance;
+        return instance;
+    }
+
+    // 在 WifiStation::Start() 之前调用
+    void Install();
+
+private:
+    struct Record {
+        std::string ssid;
+        uint8_t bssid[6] = {};
+        int channel = 0;
+        int phy = 0;        // 位 0~3：11b/11g/11n/11ax
+    };
+
+    Record record_;
+    bool has_record_ = false;
+    bool attempting_ = false;
+    int64_t start_us_ = 0;
+    esp_event_handler_instance_t wifi_handler_ = nullptr;
+    esp_event_handler_instance_t ip_handler_ = nullptr;
+
+    WifiFastConnect() = default;
+    bool Load();
+    void Save();
+    void Attempt();
+    void Fallback();
+    static void EventHandler(void* arg, esp_event_base_t base, int32_t id, void* data);
+};
+
+#endif // WIFI_FAST_CONNECT_H
@@ -131,6 +131,20 @@ void Servo360::set_speed(int speed, int duration_ms) {
     set_speed_internal(speed);
 }
 
+void Servo360::apply_speed(int speed) {
+    if (!initialized_) {
+        return;
+    }
+    if (reverse_) speed = -speed;
+    if (speed > 100) speed = 100;
+    if (speed < -100) speed = -100;
+    if (speed == current_speed_) {
+        return;
+    }
+    current_speed_ = speed;
+    set_speed_internal(speed);
+}
+
 void Servo360::set_speed_internal(int speed) {
     uint32_t pulse_width_us;
     if (speed == 0) {
@@ -139,9 +153,9 @@ void Servo360::set_speed_internal(int speed) {
         pulse_width_us = pwm_range_.stop_pulse_width_us + (pwm_range_.max_fwd_pulse_width_us - pwm_range_.stop_pulse_width_us) * speed / 100;
     } else {
         pulse_width_us = pwm_range_.stop_pulse_width_us - (pwm_range_.stop_pulse_width_us - pwm_range_.max_rev_pulse_width_us) * (-speed) / 100;
-        ESP_LOGI(TAG, "set_speed_internal: 负速度分支, gpio=%d, speed=%d, pulse_width_us=%lu", gpio_, speed, pulse_width_us);
+        ESP_LOGD(TAG, "set_speed_internal: 负速度分支, gpio=%d, speed=%d, pulse_width_us=%lu", gpio_, speed, pulse_width_us);
     }
-    ESP_LOGI(TAG, "set_speed_internal: gpio=%d, speed=%d, pulse_width_us=%lu, oper_=%p, cmpr_=%p, gen_=%p", gpio_, speed, pulse_width_us, oper_, cmpr_, gen_);
+    ESP_LOGD(TAG, "set_speed_internal: gpio=%d, speed=%d, pulse_width_us=%lu, oper_=%p, cmpr_=%p, gen_=%p", gpio_, speed, pulse_width_us, oper_, cmpr_, gen_);
     esp_err_t err = mcpwm_comparator_set_compare_value(cmpr_, pulse_width_us);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "设置比较器值失败: gpio=%d, err=%d, pulse_width_us=%lu", gpio_, err, pulse_width_us);
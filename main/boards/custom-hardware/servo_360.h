@@ -15,6 +15,8 @@ public:
     ~Servo360();
     esp_err_t setup_pwm();
     void set_speed(int speed, int duration_ms = 0);
+    // 动作调度器每个 PWM 周期调用，不打印日志，也不忽略小的速度变化
+    void apply_speed(int speed);
     void stop();
     void run_for(int speed, int duration_ms);
     void quick_action(int speed, int duration_ms); // 快速响应动作
@@ -1,6 +1,7 @@
 #include "servo_360.h"
 #include "mcp_server.h"
 #include "servo_degree_mapper.h"
+#include "servo_motion.h"
 #include <cJSON.h>
 #include <string>
 #include <esp_log.h>
@@ -95,6 +96,9 @@ public:
         
         auto& mcp_server = McpServer::GetInstance();
 
+        // 所有动作交给调度任务按关键帧执行，工具调用立即返回
+        motion_ = new ServoMotion({left_servo_, right_servo_});
+
         // set
         mcp_server.AddTool("self.servo360.set",
             "控制舵机动作",
@@ -116,42 +120,7 @@ public:
                     return false;
                 }
                 ESP_LOGI(TAG, "Servo set: target=%s speed=%d duration=%d", target.c_str(), speed, duration);
-                
-                // 使用 run_for 方法，它会处理定时停止
-                if (target == "left") {
-                    left_servo_->run_for(speed, duration);
-                } else if (target == "right") {
-                    right_servo_->run_for(speed, duration);
-                } else if (target == "both") {
-                    // 并行执行双臂动作 - 为每个舵机创建独立任务
-                    xTaskCreate([](void* param) {
-                        auto* data = static_cast<std::tuple<Servo360*, int, int>*>(param);
-                        auto* servo = std::get<0>(*data);
-                        int speed = std::get<1>(*data);
-                        int duration = std::get<2>(*data);
-                        
-                        ESP_LOGI(TAG, "双臂并行任务启动: GPIO=%d, speed=%d, duration=%d", servo->get_gpio(), speed, duration);
-                        servo->run_for(speed, duration);
-                        ESP_LOGI(TAG, "双臂并行任务完成: GPIO=%d", servo->get_gpio());
-                        
-                        delete data;
-                        vTaskDelete(nullptr);
-                    }, "servo_left", 4096, new std::tuple<Servo360*, int, int>(left_servo_, speed, duration), 5, nullptr);
-                    
-                    xTaskCreate([](void* param) {
-                        auto* data = static_cast<std::tuple<Servo360*, int, int>*>(param);
-                        auto* servo = std::get<0>(*data);
-                        int speed = std::get<1>(*data);
-                        int duration = std::get<2>(*data);
-                        
-                        ESP_LOGI(TAG, "双臂并行任务启动: GPIO=%d, speed=%d, duration=%d", servo->get_gpio(), speed, duration);
-                        servo->run_for(speed, duration);
-                        ESP_LOGI(TAG, "双臂并行任务完成: GPIO=%d", servo->get_gpio());
-                        
-                        delete data;
-                        vTaskDelete(nullptr);
-                    }, "servo_right", 4096, new std::tuple<Servo360*, int, int>(right_servo_, speed, duration), 5, nullptr);
-                }
+                PlayTarget(target, ServoMotion::RunFor(speed, duration));
                 return true;
             });
 
@@ -176,16 +145,8 @@ public:
                     return false;
                 }
                 ESP_LOGI(TAG, "Servo quick_set: target=%s speed=%d duration=%d", target.c_str(), speed, duration);
-                
-                // 使用快速响应方法，非阻塞
-                if (target == "left") {
-                    left_servo_->quick_action(speed, duration);
-                } else if (target == "right") {
-                    right_servo_->quick_action(speed, duration);
-                } else if (target == "both") {
-                    left_servo_->quick_action(speed, duration);
-                    right_servo_->quick_action(speed, duration);
-                }
+                // 与 Servo360::quick_action 相同，转动 100ms 后停止
+                PlayTarget(target, {{(int16_t)speed, 100, 0}});
                 return true;
             });
 
@@ -212,43 +173,7 @@ public:
                     return false;
                 }
                 ESP_LOGI(TAG, "Servo wave: target=%s count=%d speed=%d duration=%d", target.c_str(), count, speed, duration);
-                
-                if (target == "left") {
-                    left_servo_->wave(speed, duration, count);
-                } else if (target == "right") {
-                    right_servo_->wave(speed, duration, count);
-                } else if (target == "both") {
-                    // 并行执行双臂挥手 - 为每个舵机创建独立任务
-                    xTaskCreate([](void* param) {
-                        auto* data = static_cast<std::tuple<Servo360*, int, int, int>*>(param);
-                        auto* servo = std::get<0>(*data);
-                        int speed = std::get<1>(*data);
-                        int duration = std::get<2>(*data);
-                        int count = std::get<3>(*data);
-                        
-                        ESP_LOGI(TAG, "双臂挥手并行任务启动: GPIO=%d, speed=%d, duration=%d, count=%d", servo->get_gpio(), speed, duration, count);
-                        servo->wave(speed, duration, count);
-                        ESP_LOGI(TAG, "双臂挥手并行任务完成: GPIO=%d", servo->get_gpio());
-                        
-                        delete data;
-                        vTaskDelete(nullptr);
-                    }, "servo_wave_left", 4096, new std::tuple<Servo360*, int, int, int>(left_servo_, speed, duration, count), 5, nullptr);
-                    
-                    xTaskCreate([](void* param) {
-                        auto* data = static_cast<std::tuple<Servo360*, int, int, int>*>(param);
-                        auto* servo = std::get<0>(*data);
-                        int speed = std::get<1>(*data);
-                        int duration = std::get<2>(*data);
-                        int count = std::get<3>(*data);
-                        
-                        ESP_LOGI(TAG, "双臂挥手并行任务启动: GPIO=%d, speed=%d, duration=%d, count=%d", servo->get_gpio(), speed, duration, count);
-                        servo->wave(speed, duration, count);
-                        ESP_LOGI(TAG, "双臂挥手并行任务完成: GPIO=%d", servo->get_gpio());
-                        
-                        delete data;
-                        vTaskDelete(nullptr);
-                    }, "servo_wave_right", 4096, new std::tuple<Servo360*, int, int, int>(right_servo_, speed, duration, count), 5, nullptr);
-                }
+                PlayTarget(target, ServoMotion::Wave(speed, duration, count));
                 return true;
             });
 
@@ -273,41 +198,7 @@ public:
                     return false;
                 }
                 ESP_LOGI(TAG, "Servo raise: target=%s speed=%d duration=%d", target.c_str(), speed, duration);
-                
-                if (target == "left") {
-                    left_servo_->raise_arm(speed, duration);
-                } else if (target == "right") {
-                    right_servo_->raise_arm(speed, duration);
-                } else if (target == "both") {
-                    // 并行执行双臂举手 - 为每个舵机创建独立任务
-                    xTaskCreate([](void* param) {
-                        auto* data = static_cast<std::tuple<Servo360*, int, int>*>(param);
-                        auto* servo = std::get<0>(*data);
-                        int speed = std::get<1>(*data);
-                        int duration = std::get<2>(*data);
-                        
-                        ESP_LOGI(TAG, "双臂举手并行任务启动: GPIO=%d, speed=%d, duration=%d", servo->get_gpio(), speed, duration);
-                        servo->raise_arm(speed, duration);
-                        ESP_LOGI(TAG, "双臂举手并行任务完成: GPIO=%d", servo->get_gpio());
-                        
-                        delete data;
-                        vTaskDelete(nullptr);
-                    }, "servo_raise_left", 4096, new std::tuple<Servo360*, int, int>(left_servo_, speed, duration), 5, nullptr);
-                    
-                    xTaskCreate([](void* param) {
-                        auto* data = static_cast<std::tuple<Servo360*, int, int>*>(param);
-                        auto* servo = std::get<0>(*data);
-                        int speed = std::get<1>(*data);
-                        int duration = std::get<2>(*data);
-                        
-                        ESP_LOGI(TAG, "双臂举手并行任务启动: GPIO=%d, speed=%d, duration=%d", servo->get_gpio(), speed, duration);
-                        servo->raise_arm(speed, duration);
-                        ESP_LOGI(TAG, "双臂举手并行任务完成: GPIO=%d", servo->get_gpio());
-                        
-                        delete data;
-                        vTaskDelete(nullptr);
-                    }, "servo_raise_right", 4096, new std::tuple<Servo360*, int, int>(right_servo_, speed, duration), 5, nullptr);
-                }
+                PlayTarget(target, ServoMotion::RunFor(speed, duration));
                 return true;
             });
 
@@ -332,41 +223,7 @@ public:
                     return false;
                 }
                 ESP_LOGI(TAG, "Servo salute: target=%s speed=%d duration=%d", target.c_str(), speed, duration);
-                
-                if (target == "left") {
-                    left_servo_->salute(speed, duration);
-                } else if (target == "right") {
-                    right_servo_->salute(speed, duration);
-                } else if (target == "both") {
-                    // 并行执行双臂敬礼 - 为每个舵机创建独立任务
-                    xTaskCreate([](void* param) {
-                        auto* data = static_cast<std::tuple<Servo360*, int, int>*>(param);
-                        auto* servo = std::get<0>(*data);
-                        int speed = std::get<1>(*data);
-                        int duration = std::get<2>(*data);
-                        
-                        ESP_LOGI(TAG, "双臂敬礼并行任务启动: GPIO=%d, speed=%d, duration=%d", servo->get_gpio(), speed, duration);
-                        servo->salute(speed, duration);
-                        ESP_LOGI(TAG, "双臂敬礼并行任务完成: GPIO=%d", servo->get_gpio());
-                        
-                        delete data;
-                        vTaskDelete(nullptr);
-                    }, "servo_salute_left", 4096, new std::tuple<Servo360*, int, int>(left_servo_, speed, duration), 5, nullptr);
-                    
-                    xTaskCreate([](void* param) {
-                        auto* data = static_cast<std::tuple<Servo360*, int, int>*>(param);
-                        auto* servo = std::get<0>(*data);
-                        int speed = std::get<1>(*data);
-                        int duration = std::get<2>(*data);
-                        
-                        ESP_LOGI(TAG, "双臂敬礼并行任务启动: GPIO=%d, speed=%d, duration=%d", servo->get_gpio(), speed, duration);
-                        servo->salute(speed, duration);
-                        ESP_LOGI(TAG, "双臂敬礼并行任务完成: GPIO=%d", servo->get_gpio());
-                        
-                        delete data;
-                        vTaskDelete(nullptr);
-                    }, "servo_salute_right", 4096, new std::tuple<Servo360*, int, int>(right_servo_, speed, duration), 5, nullptr);
-                }
+                PlayTarget(target, ServoMotion::RunFor(speed, duration));
                 return true;
             });
 
@@ -390,154 +247,19 @@ public:
                 ESP_LOGI(TAG, "Servo combo: action=%s speed=%d duration=%d", action.c_str(), speed, duration);
                 
                 if (action == "raise_wave" || action == "举手挥手" || action == "combo") {
-                    // 左手举手，右手挥手 - 并行执行
-                    xTaskCreate([](void* param) {
-                        auto* data = static_cast<std::tuple<Servo360*, int, int>*>(param);
-                        auto* servo = std::get<0>(*data);
-                        int speed = std::get<1>(*data);
-                        int duration = std::get<2>(*data);
-                        
-                        ESP_LOGI(TAG, "combo举手并行任务启动: GPIO=%d, speed=%d, duration=%d", servo->get_gpio(), speed, duration);
-                        servo->raise_arm(speed, duration);
-                        ESP_LOGI(TAG, "combo举手并行任务完成: GPIO=%d", servo->get_gpio());
-                        
-                        delete data;
-                        vTaskDelete(nullptr);
-                    }, "combo_raise", 4096, new std::tuple<Servo360*, int, int>(left_servo_, speed, duration), 5, nullptr);
-                    
-                    xTaskCreate([](void* param) {
-                        auto* data = static_cast<std::tuple<Servo360*, int, int, int>*>(param);
-                        auto* servo = std::get<0>(*data);
-                        int speed = std::get<1>(*data);
-                        int duration = std::get<2>(*data);
-                        int count = std::get<3>(*data);
-                        
-                        ESP_LOGI(TAG, "combo挥手并行任务启动: GPIO=%d, speed=%d, duration=%d, count=%d", servo->get_gpio(), speed, duration, count);
-                        servo->wave(speed, duration, count);
-                        ESP_LOGI(TAG, "combo挥手并行任务完成: GPIO=%d", servo->get_gpio());
-                        
-                        delete data;
-                        vTaskDelete(nullptr);
-                    }, "combo_wave", 4096, new std::tuple<Servo360*, int, int, int>(right_servo_, speed, duration/2, 2), 5, nullptr);
+                    // 左手举手，右手挥手
+                    motion_->Play(kLeftChannel, ServoMotion::RunFor(speed, duration));
+                    motion_->Play(kRightChannel, ServoMotion::Wave(speed, duration / 2, 2));
                 } else if (action == "wave_raise" || action == "挥手举手") {
-                    // 左手挥手，右手举手 - 并行执行
-                    xTaskCreate([](void* param) {
-                        auto* data = static_cast<std::tuple<Servo360*, int, int, int>*>(param);
-                        auto* servo = std::get<0>(*data);
-                        int speed = std::get<1>(*data);
-                        int duration = std::get<2>(*data);
-                        int count = std::get<3>(*data);
-                        
-                        ESP_LOGI(TAG, "combo挥手并行任务启动: GPIO=%d, speed=%d, duration=%d, count=%d", servo->get_gpio(), speed, duration, count);
-                        servo->wave(speed, duration, count);
-                        ESP_LOGI(TAG, "combo挥手并行任务完成: GPIO=%d", servo->get_gpio());
-                        
-                        delete data;
-                        vTaskDelete(nullptr);
-                    }, "combo_wave", 4096, new std::tuple<Servo360*, int, int, int>(left_servo_, speed, duration/2, 2), 5, nullptr);
-                    
-                    xTaskCreate([](void* param) {
-                        auto* data = static_cast<std::tuple<Servo360*, int, int>*>(param);
-                        auto* servo = std::get<0>(*data);
-                        int speed = std::get<1>(*data);
-                        int duration = std::get<2>(*data);
-                        
-                        ESP_LOGI(TAG, "combo举手并行任务启动: GPIO=%d, speed=%d, duration=%d", servo->get_gpio(), speed, duration);
-                        servo->raise_arm(speed, duration);
-                        ESP_LOGI(TAG, "combo举手并行任务完成: GPIO=%d", servo->get_gpio());
-                        
-                        delete data;
-                        vTaskDelete(nullptr);
-                    }, "combo_raise", 4096, new std::tuple<Servo360*, int, int>(right_servo_, speed, duration), 5, nullptr);
+                    // 左手挥手，右手举手
+                    motion_->Play(kLeftChannel, ServoMotion::Wave(speed, duration / 2, 2));
+                    motion_->Play(kRightChannel, ServoMotion::RunFor(speed, duration));
                 } else if (action == "wave" || action == "挥手") {
-                    // 双臂同时挥手 - 并行执行
-                    xTaskCreate([](void* param) {
-                        auto* data = static_cast<std::tuple<Servo360*, int, int, int>*>(param);
-                        auto* servo = std::get<0>(*data);
-                        int speed = std::get<1>(*data);
-                        int duration = std::get<2>(*data);
-                        int count = std::get<3>(*data);
-                        
-                        ESP_LOGI(TAG, "combo双臂挥手并行任务启动: GPIO=%d, speed=%d, duration=%d, count=%d", servo->get_gpio(), speed, duration, count);
-                        servo->wave(speed, duration, count);
-                        ESP_LOGI(TAG, "combo双臂挥手并行任务完成: GPIO=%d", servo->get_gpio());
-                        
-                        delete data;
-                        vTaskDelete(nullptr);
-                    }, "combo_wave_left", 4096, new std::tuple<Servo360*, int, int, int>(left_servo_, speed, duration/2, 2), 5, nullptr);
-                    
-                    xTaskCreate([](void* param) {
-                        auto* data = static_cast<std::tuple<Servo360*, int, int, int>*>(param);
-                        auto* servo = std::get<0>(*data);
-                        int speed = std::get<1>(*data);
-                        int duration = std::get<2>(*data);
-                        int count = std::get<3>(*data);
-                        
-                        ESP_LOGI(TAG, "combo双臂挥手并行任务启动: GPIO=%d, speed=%d, duration=%d, count=%d", servo->get_gpio(), speed, duration, count);
-                        servo->wave(speed, duration, count);
-                        ESP_LOGI(TAG, "combo双臂挥手并行任务完成: GPIO=%d", servo->get_gpio());
-                        
-                        delete data;
-                        vTaskDelete(nullptr);
-                    }, "combo_wave_right", 4096, new std::tuple<Servo360*, int, int, int>(right_servo_, speed, duration/2, 2), 5, nullptr);
-                } else if (action == "raise" || action == "举手") {
-                    // 双臂同时举手 - 并行执行
-                    xTaskCreate([](void* param) {
-                        auto* data = static_cast<std::tuple<Servo360*, int, int>*>(param);
-                        auto* servo = std::get<0>(*data);
-                        int speed = std::get<1>(*data);
-                        int duration = std::get<2>(*data);
-                        
-                        ESP_LOGI(TAG, "combo双臂举手并行任务启动: GPIO=%d, speed=%d, duration=%d", servo->get_gpio(), speed, duration);
-                        servo->raise_arm(speed, duration);
-                        ESP_LOGI(TAG, "combo双臂举手并行任务完成: GPIO=%d", servo->get_gpio());
-                        
-                        delete data;
-                        vTaskDelete(nullptr);
-                    }, "combo_raise_left", 4096, new std::tuple<Servo360*, int, int>(left_servo_, speed, duration), 5, nullptr);
-                    
-                    xTaskCreate([](void* param) {
-                        auto* data = static_cast<std::tuple<Servo360*, int, int>*>(param);
-                        auto* servo = std::get<0>(*data);
-                        int speed = std::get<1>(*data);
-                        int duration = std::get<2>(*data);
-                        
-                        ESP_LOGI(TAG, "combo双臂举手并行任务启动: GPIO=%d, speed=%d, duration=%d", servo->get_gpio(), speed, duration);
-                        servo->raise_arm(speed, duration);
-                        ESP_LOGI(TAG, "combo双臂举手并行任务完成: GPIO=%d", servo->get_gpio());
-                        
-                        delete data;
-                        vTaskDelete(nullptr);
-                    }, "combo_raise_right", 4096, new std::tuple<Servo360*, int, int>(right_servo_, speed, duration), 5, nullptr);
-                } else if (action == "salute" || action == "敬礼") {
-                    // 双臂同时敬礼 - 并行执行
-                    xTaskCreate([](void* param) {
-                        auto* data = static_cast<std::tuple<Servo360*, int, int>*>(param);
-                        auto* servo = std::get<0>(*data);
-                        int speed = std::get<1>(*data);
-                        int duration = std::get<2>(*data);
-                        
-                        ESP_LOGI(TAG, "combo双臂敬礼并行任务启动: GPIO=%d, speed=%d, duration=%d", servo->get_gpio(), speed, duration);
-                        servo->salute(speed, duration);
-                        ESP_LOGI(TAG, "combo双臂敬礼并行任务完成: GPIO=%d", servo->get_gpio());
-                        
-                        delete data;
-                        vTaskDelete(nullptr);
-                    }, "combo_salute_left", 4096, new std::tuple<Servo360*, int, int>(left_servo_, speed, duration), 5, nullptr);
-                    
-                    xTaskCreate([](void* param) {
-                        auto* data = static_cast<std::tuple<Servo360*, int, int>*>(param);
-                        auto* servo = std::get<0>(*data);
-                        int speed = std::get<1>(*data);
-                        int duration = std::get<2>(*data);
-                        
-                        ESP_LOGI(TAG, "combo双臂敬礼并行任务启动: GPIO=%d, speed=%d, duration=%d", servo->get_gpio(), speed, duration);
-                        servo->salute(speed, duration);
-                        ESP_LOGI(TAG, "combo双臂敬礼并行任务完成: GPIO=%d", servo->get_gpio());
-                        
-                        delete data;
-                        vTaskDelete(nullptr);
-                    }, "combo_salute_right", 4096, new std::tuple<Servo360*, int, int>(right_servo_, speed, duration), 5, nullptr);
+                    // 双臂同时挥手
+                    PlayTarget("both", ServoMotion::Wave(speed, duration / 2, 2));
+                } else if (action == "raise" || action == "举手" || action == "salute" || action == "敬礼") {
+                    // 双臂同时举手 / 敬礼
+                    PlayTarget("both", ServoMotion::RunFor(speed, duration));
                 } else {
                     ESP_LOGW(TAG, "未知组合动作: %s", action.c_str());
                     return false;
@@ -566,25 +288,29 @@ public:
                 
                 ESP_LOGI(TAG, "Servo alternate: action=%s count=%d speed=%d duration=%d", action.c_str(), count, speed, duration);
                 
+                // 一只手动作时另一只手用等待帧占位，两条轨道保持同步
+                ServoTrack left, right;
                 for (int i = 0; i < count; ++i) {
                     if (action == "wave" || action == "挥手") {
-                        // 交替挥手 - 使用 run_for 方法
-                        left_servo_->run_for(speed, duration);
-                        left_servo_->run_for(-speed, duration);
-                        
-                        right_servo_->run_for(speed, duration);
-                        right_servo_->run_for(-speed, duration);
+                        ServoTrack swing = ServoMotion::RunFor(speed, duration);
+                        ServoMotion::Append(swing, ServoMotion::RunFor(-speed, duration));
+                        ServoMotion::Append(left, swing);
+                        ServoMotion::Append(left, ServoMotion::Wait(duration * 2));
+                        ServoMotion::Append(right, ServoMotion::Wait(duration * 2));
+                        ServoMotion::Append(right, swing);
                     } else if (action == "raise" || action == "举手") {
-                        // 交替举手
-                        left_servo_->raise_arm(speed, duration);
-                        vTaskDelay(pdMS_TO_TICKS(duration));
-                        right_servo_->raise_arm(speed, duration);
-                        vTaskDelay(pdMS_TO_TICKS(duration));
+                        ServoMotion::Append(left, ServoMotion::RunFor(speed, duration));
+                        ServoMotion::Append(left, ServoMotion::Wait(duration * 3));
+                        ServoMotion::Append(right, ServoMotion::Wait(duration * 2));
+                        ServoMotion::Append(right, ServoMotion::RunFor(speed, duration));
+                        ServoMotion::Append(right, ServoMotion::Wait(duration));
                     } else {
                         ESP_LOGW(TAG, "未知交替动作: %s", action.c_str());
                         return false;
                     }
                 }
+                motion_->Play(kLeftChannel, left);
+                motion_->Play(kRightChannel, right);
                 return true;
             });
 
@@ -608,100 +334,19 @@ public:
                 ESP_LOGI(TAG, "Servo mirror: action=%s speed=%d duration=%d", action.c_str(), speed, duration);
                 
                 if (action == "wave" || action == "挥手") {
-                    // 镜像挥手（左右相反方向）- 并行执行
-                    xTaskCreate([](void* param) {
-                        auto* data = static_cast<std::tuple<Servo360*, int, int>*>(param);
-                        auto* servo = std::get<0>(*data);
-                        int speed = std::get<1>(*data);
-                        int duration = std::get<2>(*data);
-                        
-                        ESP_LOGI(TAG, "mirror挥手并行任务启动: GPIO=%d, speed=%d, duration=%d", servo->get_gpio(), speed, duration);
-                        // 执行3次来回动作
-                        for (int i = 0; i < 3; ++i) {
-                            servo->run_for(speed, duration);
-                            servo->run_for(-speed, duration);
-                        }
-                        ESP_LOGI(TAG, "mirror挥手并行任务完成: GPIO=%d", servo->get_gpio());
-                        
-                        delete data;
-                        vTaskDelete(nullptr);
-                    }, "mirror_wave_left", 4096, new std::tuple<Servo360*, int, int>(left_servo_, speed, duration), 5, nullptr);
-                    
-                    xTaskCreate([](void* param) {
-                        auto* data = static_cast<std::tuple<Servo360*, int, int>*>(param);
-                        auto* servo = std::get<0>(*data);
-                        int speed = std::get<1>(*data);
-                        int duration = std::get<2>(*data);
-                        
-                        ESP_LOGI(TAG, "mirror挥手并行任务启动: GPIO=%d, speed=%d, duration=%d", servo->get_gpio(), speed, duration);
-                        // 执行3次来回动作（相反方向）
-                        for (int i = 0; i < 3; ++i) {
-                            servo->run_for(-speed, duration);
-                            servo->run_for(speed, duration);
-                        }
-                        ESP_LOGI(TAG, "mirror挥手并行任务完成: GPIO=%d", servo->get_gpio());
-                        
-                        delete data;
-                        vTaskDelete(nullptr);
-                    }, "mirror_wave_right", 4096, new std::tuple<Servo360*, int, int>(right_servo_, speed, duration), 5, nullptr);
-                } else if (action == "raise" || action == "举手") {
-                    // 镜像举手（左右同时）- 并行执行
-                    xTaskCreate([](void* param) {
-                        auto* data = static_cast<std::tuple<Servo360*, int, int>*>(param);
-                        auto* servo = std::get<0>(*data);
-                        int speed = std::get<1>(*data);
-                        int duration = std::get<2>(*data);
-                        
-                        ESP_LOGI(TAG, "mirror举手并行任务启动: GPIO=%d, speed=%d, duration=%d", servo->get_gpio(), speed, duration);
-                        servo->raise_arm(speed, duration);
-                        ESP_LOGI(TAG, "mirror举手并行任务完成: GPIO=%d", servo->get_gpio());
-                        
-                        delete data;
-                        vTaskDelete(nullptr);
-                    }, "mirror_raise_left", 4096, new std::tuple<Servo360*, int, int>(left_servo_, speed, duration), 5, nullptr);
-                    
-                    xTaskCreate([](void* param) {
-                        auto* data = static_cast<std::tuple<Servo360*, int, int>*>(param);
-                        auto* servo = std::get<0>(*data);
-                        int speed = std::get<1>(*data);
-                        int duration = std::get<2>(*data);
-                        
-                        ESP_LOGI(TAG, "mirror举手并行任务启动: GPIO=%d, speed=%d, duration=%d", servo->get_gpio(), speed, duration);
-                        servo->raise_arm(speed, duration);
-                        ESP_LOGI(TAG, "mirror举手并行任务完成: GPIO=%d", servo->get_gpio());
-                        
-                        delete data;
-                        vTaskDelete(nullptr);
-                    }, "mirror_raise_right", 4096, new std::tuple<Servo360*, int, int>(right_servo_, speed, duration), 5, nullptr);
-                } else if (action == "salute" || action == "敬礼") {
-                    // 镜像敬礼（左右同时）- 并行执行
-                    xTaskCreate([](void* param) {
-                        auto* data = static_cast<std::tuple<Servo360*, int, int>*>(param);
-                        auto* servo = std::get<0>(*data);
-                        int speed = std::get<1>(*data);
-                        int duration = std::get<2>(*data);
-                        
-                        ESP_LOGI(TAG, "mirror敬礼并行任务启动: GPIO=%d, speed=%d, duration=%d", servo->get_gpio(), speed, duration);
-                        servo->salute(speed, duration);
-                        ESP_LOGI(TAG, "mirror敬礼并行任务完成: GPIO=%d", servo->get_gpio());
-                        
-                        delete data;
-                        vTaskDelete(nullptr);
-                    }, "mirror_salute_left", 4096, new std::tuple<Servo360*, int, int>(left_servo_, speed, duration), 5, nullptr);
-                    
-                    xTaskCreate([](void* param) {
-                        auto* data = static_cast<std::tuple<Servo360*, int, int>*>(param);
-                        auto* servo = std::get<0>(*data);
-                        int speed = std::get<1>(*data);
-                        int duration = std::get<2>(*data);
-                        
-                        ESP_LOGI(TAG, "mirror敬礼并行任务启动: GPIO=%d, speed=%d, duration=%d", servo->get_gpio(), speed, duration);
-                        servo->salute(speed, duration);
-                        ESP_LOGI(TAG, "mirror敬礼并行任务完成: GPIO=%d", servo->get_gpio());
-                        
-                        delete data;
-                        vTaskDelete(nullptr);
-                    }, "mirror_salute_right", 4096, new std::tuple<Servo360*, int, int>(right_servo_, speed, duration), 5, nullptr);
+                    // 镜像挥手（左右相反方向），来回 3 次
+                    ServoTrack left, right;
+                    for (int i = 0; i < 3; ++i) {
+                        ServoMotion::Append(left, ServoMotion::RunFor(speed, duration));
+                        ServoMotion::Append(left, ServoMotion::RunFor(-speed, duration));
+                        ServoMotion::Append(right, ServoMotion::RunFor(-speed, duration));
+                        ServoMotion::Append(right, ServoMotion::RunFor(speed, duration));
+                    }
+                    motion_->Play(kLeftChannel, left);
+                    motion_->Play(kRightChannel, right);
+                } else if (action == "raise" || action == "举手" || action == "salute" || action == "敬礼") {
+                    // 镜像举手 / 敬礼（左右同时）
+                    PlayTarget("both", ServoMotion::RunFor(speed, duration));
                 } else {
                     ESP_LOGW(TAG, "未知镜像动作: %s", action.c_str());
                     return false;
@@ -733,43 +378,7 @@ public:
                     return false;
                 }
                 ESP_LOGI(TAG, "Servo back_and_forth: target=%s speed=%d duration=%d count=%d", target.c_str(), speed, duration, count);
-                
-                if (target == "left") {
-                    left_servo_->back_and_forth(speed, duration, count);
-                } else if (target == "right") {
-                    right_servo_->back_and_forth(speed, duration, count);
-                } else if (target == "both") {
-                    // 并行执行双臂来回动作
-                    xTaskCreate([](void* param) {
-                        auto* data = static_cast<std::tuple<Servo360*, int, int, int>*>(param);
-                        auto* servo = std::get<0>(*data);
-                        int speed = std::get<1>(*data);
-                        int duration = std::get<2>(*data);
-                        int count = std::get<3>(*data);
-                        
-                        ESP_LOGI(TAG, "back_and_forth并行任务启动: GPIO=%d, speed=%d, duration=%d, count=%d", servo->get_gpio(), speed, duration, count);
-                        servo->back_and_forth(speed, duration, count);
-                        ESP_LOGI(TAG, "back_and_forth并行任务完成: GPIO=%d", servo->get_gpio());
-                        
-                        delete data;
-                        vTaskDelete(nullptr);
-                    }, "back_forth_left", 4096, new std::tuple<Servo360*, int, int, int>(left_servo_, speed, duration, count), 5, nullptr);
-                    
-                    xTaskCreate([](void* param) {
-                        auto* data = static_cast<std::tuple<Servo360*, int, int, int>*>(param);
-                        auto* servo = std::get<0>(*data);
-                        int speed = std::get<1>(*data);
-                        int duration = std::get<2>(*data);
-                        int count = std::get<3>(*data);
-                        
-                        ESP_LOGI(TAG, "back_and_forth并行任务启动: GPIO=%d, speed=%d, duration=%d, count=%d", servo->get_gpio(), speed, duration, count);
-                        servo->back_and_forth(speed, duration, count);
-                        ESP_LOGI(TAG, "back_and_forth并行任务完成: GPIO=%d", servo->get_gpio());
-                        
-                        delete data;
-                        vTaskDelete(nullptr);
-                    }, "back_forth_right", 4096, new std::tuple<Servo360*, int, int, int>(right_servo_, speed, duration, count), 5, nullptr);
-                }
+                PlayTarget(target, ServoMotion::BackAndForth(speed, duration, count));
                 return true;
             });
 
@@ -1259,6 +868,9 @@ public:
     }
     
     ~ServoMcpController() {
+        // 先停掉调度任务，它持有舵机指针
+        delete motion_;
+        motion_ = nullptr;
         // 清理舵机对象
         if (left_servo_) {
             delete left_servo_;
@@ -1278,10 +890,23 @@ public:
     }
     
 private:
+    static constexpr int kLeftChannel = 0;
+    static constexpr int kRightChannel = 1;
+
     mcpwm_timer_handle_t shared_timer_;
     Servo360* left_servo_;
     Servo360* right_servo_;
     bool initialized_;
+    ServoMotion* motion_ = nullptr;
+
+    void PlayTarget(const std::string& target, const ServoTrack& track) {
+        if (target == "left" || target == "both") {
+            motion_->Play(kLeftChannel, track);
+        }
+        if (target == "right" || target == "both") {
+            motion_->Play(kRightChannel, track);
+        }
+    }
 };
 
 // 在 board 初始化或 main 中实例化
@@ -0,0 +1,179 @@
+#include "servo_motion.h"
+#include <esp_log.h>
+#include <cstdlib>
+
+#undef TAG
+#define TAG "ServoMotion"
+
+static int clamp_run_speed(int speed) {
+    // 与 Servo360::run_for 相同：限制在 ±100，并保证最小启动速度
+    if (speed > 100) speed = 100;
+    if (speed < -100) speed = -100;
+    if (abs(speed) < 5) {
+        speed = (speed > 0) ? 5 : -5;
+    }
+    return speed;
+}
+
+ServoMotion::ServoMotion(const std::vector<Servo360*>& servos) {
+    for (auto servo : servos) {
+        channels_.push_back({servo});
+    }
+    xTaskCreate([](void* arg) {
+        static_cast<ServoMotion*>(arg)->MotionLoop();
+    }, "servo_motion", 3072, this, configMAX_PRIORITIES - 1, &task_);
+}
+
+ServoMotion::~ServoMotion() {
+    if (task_ != nullptr) {
+        vTaskDelete(task_);
+    }
+    for (auto& channel : channels_) {
+        channel.servo->apply_speed(0);
+    }
+}
+
+void ServoMotion::Play(int channel, const ServoTrack& track, bool preempt) {
+    if (channel < 0 || channel >= (int)channels_.size() || track.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& ch = channels_[channel];
+        size_t first = ch.frames.size();
+        if (preempt) {
+            ch.frames.clear();
+            ch.active = false;
+            first = 0;
+        }
+        ch.frames.insert(ch.frames.end(), track.begin(), track.end());
+        // 从运动中切换到新动作时平滑过渡，避免速度突变
+        if (preempt && ch.moving) {
+            auto& frame = ch.frames[first];
+            if (frame.ramp_ms < kBlendMs) {
+                frame.ramp_ms = kBlendMs;
+            }
+            if (frame.duration_ms < frame.ramp_ms) {
+                frame.duration_ms = frame.ramp_ms;
+            }
+        }
+    }
+    xTaskNotifyGive(task_);
+}
+
+void ServoMotion::Stop(int channel) {
+    Play(channel, {{0, kTickMs, 0}});
+}
+
+void ServoMotion::StopAll() {
+    for (int i = 0; i < (int)channels_.size(); i++) {
+        Stop(i);
+    }
+}
+
+ServoTrack ServoMotion::RunFor(int speed, int duration_ms) {
+    if (duration_ms <= 0) {
+        return {};
+    }
+    return {{(int16_t)clamp_run_speed(speed), (uint16_t)duration_ms, 0}};
+}
+
+ServoTrack ServoMotion::Wave(int speed, int duration_ms, int count) {
+    ServoTrack track;
+    if (speed == 0 || duration_ms <= 0 || count <= 0) {
+        return track;
+    }
+    for (int i = 0; i < count; i++) {
+        Append(track, RunFor(speed, duration_ms));
+        Append(track, Wait(100));
+        Append(track, RunFor(-speed, duration_ms));
+        Append(track, Wait(100));
+    }
+    return track;
+}
+
+ServoTrack ServoMotion::BackAndForth(int speed, int duration_ms, int count) {
+    ServoTrack track;
+    if (speed == 0 || duration_ms <= 0 || count <= 0) {
+        return track;
+    }
+    for (int i = 0; i < count; i++) {
+        track.push_back({(int16_t)speed, (uint16_t)duration_ms, 0});
+        track.push_back({(int16_t)-speed, (uint16_t)duration_ms, 0});
+    }
+    return track;
+}
+
+ServoTrack ServoMotion::Wait(int duration_ms) {
+    if (duration_ms <= 0) {
+        return {};
+    }
+    return {{0, (uint16_t)duration_ms, 0}};
+}
+
+void ServoMotion::Append(ServoTrack& track, const ServoTrack& more) {
+    track.insert(track.end(), more.begin(), more.end());
+}
+
+// 推进一个 PWM 周期，返回是否还有舵机需要继续驱动
+bool ServoMotion::Tick() {
+    bool busy = false;
+    for (auto& ch : channels_) {
+        if (!ch.active) {
+            if (ch.frames.empty()) {
+                // 动作结束后停下
+                if (ch.moving) {
+                    ch.speed_q8 = 0;
+                    ch.servo->apply_speed(0);
+                    ch.moving = false;
+                }
+                continue;
+            }
+            ch.current = ch.frames.front();
+            ch.frames.pop_front();
+            ch.start_q8 = ch.speed_q8;
+            ch.elapsed_ms = 0;
+            ch.active = true;
+        }
+
+        busy = true;
+        ch.elapsed_ms += kTickMs;
+        int32_t target_q8 = (int32_t)ch.current.speed << 8;
+        if (ch.elapsed_ms < ch.current.ramp_ms) {
+            ch.speed_q8 = ch.start_q8 + (target_q8 - ch.start_q8) * (int32_t)ch.elapsed_ms / ch.current.ramp_ms;
+        } else {
+            ch.speed_q8 = target_q8;
+        }
+        int speed = ch.speed_q8 / 256;
+        ch.servo->apply_speed(speed);
+        ch.moving = speed != 0;
+
+        if (ch.elapsed_ms >= ch.current.duration_ms) {
+            ch.active = false;
+        }
+    }
+    // 还有舵机没有停下时需要再推进一个周期
+    for (auto& ch : channels_) {
+        busy |= ch.moving || !ch.frames.empty();
+    }
+    return busy;
+}
+
+void ServoMotion::MotionLoop() {
+    ESP_LOGI(TAG, "Motion task started, %u servos", channels_.size());
+    TickType_t last_wake = xTaskGetTickCount();
+    while (true) {
+        bool busy;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            busy = Tick();
+        }
+        if (!busy) {
+            // 没有动作时不占用 CPU，等待 Play 唤醒
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            last_wake = xTaskGetTickCount();
+            continue;
+        }
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(kTickMs));
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "servo_360.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+// 一段动作：ramp_ms 内从上一段结束时的速度线性过渡到 speed，保持到 duration_ms 结束
+// speed 为 0 的关键帧用来等待，多个舵机的动作靠它对齐时间
+struct ServoKeyframe {
+    int16_t speed;
+    uint16_t duration_ms;
+    uint16_t ramp_ms;
+};
+
+using ServoTrack = std::vector<ServoKeyframe>;
+
+// 舵机动作调度器
+// 一个高优先级任务按 PWM 周期（20ms）推进所有舵机的关键帧队列，MCPWM 比较值在周期起点生效，
+// 任务的调度抖动不会反映到脉宽上。动作不再为每个舵机每次调用新建任务，也不阻塞 MCP 调用
+class ServoMotion {
+public:
+    static constexpr int kTickMs = 20;
+    // 打断正在运动的舵机时，新动作的第一段至少用这么长时间过渡
+    static constexpr int kBlendMs = 60;
+
+    explicit ServoMotion(const std::vector<Servo360*>& servos);
+    ~ServoMotion();
+
+    // preempt 为 true 时丢弃该舵机正在执行和排队的关键帧，从当前速度过渡到新动作；否则排在队尾
+    void Play(int channel, const ServoTrack& track, bool preempt = true);
+    void Stop(int channel);
+    void StopAll();
+
+    // 常用动作的关键帧，与 Servo360 对应的阻塞函数时序相同
+    static ServoTrack RunFor(int speed, int duration_ms);
+    static ServoTrack Wave(int speed, int duration_ms, int count);
+    static ServoTrack BackAndForth(int speed, int duration_ms, int count);
+    static ServoTrack Wait(int duration_ms);
+    static void Append(ServoTrack& track, const ServoTrack& more);
+
+private:
+    struct Channel {
+        Servo360* servo;
+        std::deque<ServoKeyframe> frames;
+        bool active = false;    // 正在执行 current
+        bool moving = false;    // 最后一次输出的速度不为 0
+        ServoKeyframe current = {};
+        int32_t start_q8 = 0;   // 本段起始速度，Q8 定点
+        int32_t speed_q8 = 0;   // 当前输出速度，Q8 定点
+        uint32_t elapsed_ms = 0;
+    };
+
+    std::mutex mutex_;
+    std::vector<Channel> channels_;
+    TaskHandle_t task_ = nullptr;
+
+    bool Tick();
+    void MotionLoop();
+};
@@ -15,6 +15,8 @@ K10AudioCodec::K10AudioCodec(void* i2c_master_handle, int input_sample_rate, int
     input_channels_ = input_reference_ ? 2 : 1; // 输入通道数
     input_sample_rate_ = input_sample_rate;
     output_sample_rate_ = output_sample_rate;
+    // 输出只用 I2S，音量由 AudioCodec 的输出处理调节
+    software_volume_ = true;
 
     CreateDuplexChannels(mclk, bclk, ws, dout, din);
 
@@ -202,18 +204,8 @@ int K10AudioCodec::Write(const int16_t* data, int samples) {
     if (output_enabled_) {
         std::vector<int32_t> buffer(samples * 2);  // Allocate buffer for 2x samples
 
-        // Apply volume adjustment (same as before)
-        int32_t volume_factor = pow(double(output_volume_) / 100.0, 2) * 65536;
         for (int i = 0; i < samples; i++) {
-            int64_t temp = int64_t(data[i]) * volume_factor;
-            if (temp > INT32_MAX) {
-            buffer[i * 2] = INT32_MAX;
-            } else if (temp < INT32_MIN) {
-            buffer[i * 2] = INT32_MIN;
-            } else {
-            buffer[i * 2] = static_cast<int32_t>(temp);
-            }
-
+            buffer[i * 2] = int32_t(data[i]) << 16;
             // Repeat each sample for slow playback (assuming mono audio)
             buffer[i * 2 + 1] = buffer[i * 2];
         }
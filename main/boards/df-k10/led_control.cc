@@ -23,102 +23,116 @@ LedStripControl::LedStripControl(CircularStrip* led_strip)
     brightness_level_ = settings.GetInt("brightness", 4);  // 默认等级4
     led_strip_->SetBrightness(LevelToBrightness(brightness_level_), 4);
 
-    auto& mcp_server = McpServer::GetInstance();
-    mcp_server.AddTool("self.led_strip.get_brightness",
-        "Get the brightness of the led strip (0-8)",
-        PropertyList(), [this](const PropertyList& properties) -> ReturnValue {
-            return brightness_level_;
-        });
-
-    mcp_server.AddTool("self.led_strip.set_brightness",
-        "Set the brightness of the led strip (0-8)",
-        PropertyList({
-            Property("level", kPropertyTypeInteger, 0, 8)
-        }), [this](const PropertyList& properties) -> ReturnValue {
-            int level = properties["level"].value<int>();
-            ESP_LOGI(TAG, "Set LedStrip brightness level to %d", level);
-            brightness_level_ = level;
-            led_strip_->SetBrightness(LevelToBrightness(brightness_level_), 4);
-
-            // 保存设置
-            Settings settings("led_strip", true);
-            settings.SetInt("brightness", brightness_level_);
-
-            return true;
-        });
+    AddTools();
+}
 
-    mcp_server.AddTool("self.led_strip.set_single_color", 
-        "Set the color of a single led.", 
-        PropertyList({
-            Property("index", kPropertyTypeInteger, 0, 2),
-            Property("red", kPropertyTypeInteger, 0, 255),
-            Property("green", kPropertyTypeInteger, 0, 255),
-            Property("blue", kPropertyTypeInteger, 0, 255)
-        }), [this](const PropertyList& properties) -> ReturnValue {
-            int index = properties["index"].value<int>();
-            int red = properties["red"].value<int>();
-            int green = properties["green"].value<int>();
-            int blue = properties["blue"].value<int>();
-            ESP_LOGI(TAG, "Set led strip single color %d to %d, %d, %d",
-                index, red, green, blue);
-            led_strip_->SetSingleColor(index, RGBToColor(red, green, blue));
-            return true;
-        });
+// 工具表是常量，名字、描述和参数定义都留在 flash 中
+void LedStripControl::AddTools() {
+    static const McpStaticProperty kLevelProperties[] = {
+        McpIntProperty("level", 0, 8),
+    };
+    static const McpStaticProperty kSingleColorProperties[] = {
+        McpIntProperty("index", 0, 2),
+        McpIntProperty("red", 0, 255),
+        McpIntProperty("green", 0, 255),
+        McpIntProperty("blue", 0, 255),
+    };
+    static const McpStaticProperty kColorProperties[] = {
+        McpIntProperty("red", 0, 255),
+        McpIntProperty("green", 0, 255),
+        McpIntProperty("blue", 0, 255),
+    };
+    static const McpStaticProperty kBlinkProperties[] = {
+        McpIntProperty("red", 0, 255),
+        McpIntProperty("green", 0, 255),
+        McpIntProperty("blue", 0, 255),
+        McpIntProperty("interval", 0, 1000),
+    };
+    static const McpStaticProperty kScrollProperties[] = {
+        McpIntProperty("red", 0, 255),
+        McpIntProperty("green", 0, 255),
+        McpIntProperty("blue", 0, 255),
+        McpIntProperty("length", 1, 7),
+        McpIntProperty("interval", 0, 1000),
+    };
 
-    mcp_server.AddTool("self.led_strip.set_all_color", 
-        "Set the color of all leds.", 
-        PropertyList({
-            Property("red", kPropertyTypeInteger, 0, 255),
-            Property("green", kPropertyTypeInteger, 0, 255),
-            Property("blue", kPropertyTypeInteger, 0, 255)
-        }), [this](const PropertyList& properties) -> ReturnValue {
-            int red = properties["red"].value<int>();
-            int green = properties["green"].value<int>();
-            int blue = properties["blue"].value<int>();
-            ESP_LOGI(TAG, "Set led strip all color to %d, %d, %d",
-                red, green, blue);
-            led_strip_->SetAllColor(RGBToColor(red, green, blue));
-            return true;
-        });
+    static const McpStaticTool kTools[] = {
+        {"self.led_strip.get_brightness",
+            "Get the brightness of the led strip (0-8)",
+            MCP_NO_PROPERTIES, [](void* context, const PropertyList& properties) -> ReturnValue {
+                auto self = static_cast<LedStripControl*>(context);
+                return self->brightness_level_;
+            }},
+        {"self.led_strip.set_brightness",
+            "Set the brightness of the led strip (0-8)",
+            MCP_STATIC_PROPERTIES(kLevelProperties), [](void* context, const PropertyList& properties) -> ReturnValue {
+                auto self = static_cast<LedStripControl*>(context);
+                int level = properties["level"].value<int>();
+                ESP_LOGI(TAG, "Set LedStrip brightness level to %d", level);
+                self->brightness_level_ = level;
+                self->led_strip_->SetBrightness(self->LevelToBrightness(self->brightness_level_), 4);
 
-    mcp_server.AddTool("self.led_strip.blink", 
-        "Blink the led strip. (闪烁)", 
-        PropertyList({
-            Property("red", kPropertyTypeInteger, 0, 255),
-            Property("green", kPropertyTypeInteger, 0, 255),
-            Property("blue", kPropertyTypeInteger, 0, 255),
-            Property("interval", kPropertyTypeInteger, 0, 1000)
-        }), [this](const PropertyList& properties) -> ReturnValue {
-            int red = properties["red"].value<int>();
-            int green = properties["green"].value<int>();
-            int blue = properties["blue"].value<int>();
-            int interval = properties["interval"].value<int>();
-            ESP_LOGI(TAG, "Blink led strip with color %d, %d, %d, interval %dms",
-                red, green, blue, interval);
-            led_strip_->Blink(RGBToColor(red, green, blue), interval);
-            return true;
-        });
+                // 保存设置
+                Settings settings("led_strip", true);
+                settings.SetInt("brightness", self->brightness_level_);
 
-    mcp_server.AddTool("self.led_strip.scroll", 
-        "Scroll the led strip. (跑马灯)", 
-        PropertyList({
-            Property("red", kPropertyTypeInteger, 0, 255),
-            Property("green", kPropertyTypeInteger, 0, 255),
-            Property("blue", kPropertyTypeInteger, 0, 255),
-            Property("length", kPropertyTypeInteger, 1, 7),
-            Property("interval", kPropertyTypeInteger, 0, 1000)
-        }), [this](const PropertyList& properties) -> ReturnValue {
-            int red = properties["red"].value<int>();
-            int green = properties["green"].value<int>();
-            int blue = properties["blue"].value<int>();
-            int interval = properties["interval"].value<int>();
-            int length = properties["length"].value<int>();
-            ESP_LOGI(TAG, "Scroll led strip with color %d, %d, %d, length %d, interval %dms",
-                red, green, blue, length, interval);
-            StripColor low = RGBToColor(4, 4, 4);
-            StripColor high = RGBToColor(red, green, blue);
-            led_strip_->Scroll(low, high, length, interval);
-            return true;
-        });
+                return true;
+            }},
+        {"self.led_strip.set_single_color",
+            "Set the color of a single led.",
+            MCP_STATIC_PROPERTIES(kSingleColorProperties), [](void* context, const PropertyList& properties) -> ReturnValue {
+                auto self = static_cast<LedStripControl*>(context);
+                int index = properties["index"].value<int>();
+                int red = properties["red"].value<int>();
+                int green = properties["green"].value<int>();
+                int blue = properties["blue"].value<int>();
+                ESP_LOGI(TAG, "Set led strip single color %d to %d, %d, %d",
+                    index, red, green, blue);
+                self->led_strip_->SetSingleColor(index, RGBToColor(red, green, blue));
+                return true;
+            }},
+        {"self.led_strip.set_all_color",
+            "Set the color of all leds.",
+            MCP_STATIC_PROPERTIES(kColorProperties), [](void* context, const PropertyList& properties) -> ReturnValue {
+                auto self = static_cast<LedStripControl*>(context);
+                int red = properties["red"].value<int>();
+                int green = properties["green"].value<int>();
+                int blue = properties["blue"].value<int>();
+                ESP_LOGI(TAG, "Set led strip all color to %d, %d, %d",
+                    red, green, blue);
+                self->led_strip_->SetAllColor(RGBToColor(red, green, blue));
+                return true;
+            }},
+        {"self.led_strip.blink",
+            "Blink the led strip. (闪烁)",
+            MCP_STATIC_PROPERTIES(kBlinkProperties), [](void* context, const PropertyList& properties) -> ReturnValue {
+                auto self = static_cast<LedStripControl*>(context);
+                int red = properties["red"].value<int>();
+                int green = properties["green"].value<int>();
+                int blue = properties["blue"].value<int>();
+                int interval = properties["interval"].value<int>();
+                ESP_LOGI(TAG, "Blink led strip with color %d, %d, %d, interval %dms",
+                    red, green, blue, interval);
+                self->led_strip_->Blink(RGBToColor(red, green, blue), interval);
+                return true;
+            }},
+        {"self.led_strip.scroll",
+            "Scroll the led strip. (跑马灯)",
+            MCP_STATIC_PROPERTIES(kScrollProperties), [](void* context, const PropertyList& properties) -> ReturnValue {
+                auto self = static_cast<LedStripControl*>(context);
+                int red = properties["red"].value<int>();
+                int green = properties["green"].value<int>();
+                int blue = properties["blue"].value<int>();
+                int interval = properties["interval"].value<int>();
+                int length = properties["length"].value<int>();
+                ESP_LOGI(TAG, "Scroll led strip with color %d, %d, %d, length %d, interval %dms",
+                    red, green, blue, length, interval);
+                StripColor low = RGBToColor(4, 4, 4);
+                StripColor high = RGBToColor(red, green, blue);
+                self->led_strip_->Scroll(low, high, length, interval);
+                return true;
+            }},
+    };
 
+    McpServer::GetInstance().AddStaticTools(kTools, sizeof(kTools) / sizeof(kTools[0]), this);
 }
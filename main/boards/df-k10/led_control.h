@@ -9,7 +9,8 @@ private:
     int brightness_level_;  // 亮度等级 (0-8)
 
     int LevelToBrightness(int level) const;  // 将等级转换为实际亮度值
-    StripColor RGBToColor(int red, int green, int blue);
+    static StripColor RGBToColor(int red, int green, int blue);
+    void AddTools();
 
 public:
     explicit LedStripControl(CircularStrip* led_strip);
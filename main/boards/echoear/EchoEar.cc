@@ -6,6 +6,7 @@
 #include "config.h"
 #include "iot/thing_manager.h"
 #include "backlight.h"
+#include "touch_input.h"
 
 #include <wifi_station.h>
 #include <esp_log.h>
@@ -225,7 +226,7 @@ gpio_num_t UART1_RX = UART1_RX_1;
 
 class Charge : public I2cDevice {
 public:
-    Charge(i2c_master_bus_handle_t i2c_bus, uint8_t addr) : I2cDevice(i2c_bus, addr) {
+    Charge(i2c_master_bus_handle_t i2c_bus, uint8_t addr) : I2cDevice(i2c_bus, addr, kI2cPriorityBattery) {
         read_buffer_ = new uint8_t[8];
     }
     ~Charge() {
@@ -259,7 +260,7 @@ public:
         int x = -1;
         int y = -1;
     };
-    Cst816s(i2c_master_bus_handle_t i2c_bus, uint8_t addr) : I2cDevice(i2c_bus, addr) {
+    Cst816s(i2c_master_bus_handle_t i2c_bus, uint8_t addr) : I2cDevice(i2c_bus, addr, kI2cPriorityTouch) {
         read_buffer_ = new uint8_t[6];
     }
 
@@ -282,14 +283,12 @@ private:
     uint8_t* read_buffer_ = nullptr;
     TouchPoint_t tp_;
 };
-static SemaphoreHandle_t touch_isr_mux = NULL;
-static bool touch_event_pending = false;
-static int64_t touch_event_time = 0;
 
 class EspS3Cat : public WifiBoard {
 private:
     i2c_master_bus_handle_t i2c_bus_;
     Cst816s* cst816s_;
+    TouchInput* touch_input_ = nullptr;
     Charge* charge_;
     Button boot_button_;
     LcdDisplay* display_;
@@ -407,41 +406,27 @@ private:
         }
     }
 
-    static void lvgl_port_touch_isr_cb(void* arg)
-    {
-        int64_t current_time = esp_timer_get_time() / 1000;
+    // 按下时触发一次，300ms 内的重复按下忽略
+    void HandleTouch(const TouchSample& sample) {
+        static bool was_touched = false;
         static int64_t last_touch_time = 0;
-
-        if (current_time - last_touch_time >= 300) {
-            touch_event_pending = true;
-            touch_event_time = current_time;
-            last_touch_time = current_time;
-
-            BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-            if (touch_isr_mux != NULL) {
-                xSemaphoreGiveFromISR(touch_isr_mux, &xHigherPriorityTaskWoken);
-                portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
-            }
+        if (!sample.pressed || was_touched) {
+            was_touched = sample.pressed;
+            return;
         }
-    }
+        was_touched = true;
+        int64_t current_time = sample.time_us / 1000;
+        if (current_time - last_touch_time < 300) {
+            return;
+        }
+        last_touch_time = current_time;
 
-    static void touch_event_task(void* arg) {
-        while (true) {
-            if (xSemaphoreTake(touch_isr_mux, portMAX_DELAY) == pdTRUE) {
-                if (touch_event_pending) {
-                    touch_event_pending = false;
-
-                    auto& board = (EspS3Cat&)Board::GetInstance();
-                    auto& app = Application::GetInstance();
-
-                    if (app.GetDeviceState() == kDeviceStateStarting && 
-                        !WifiStation::GetInstance().IsConnected()) {
-                        board.ResetWifiConfiguration();
-                    }
-                    app.ToggleChatState();
-                }
-            }
+        auto& app = Application::GetInstance();
+        if (app.GetDeviceState() == kDeviceStateStarting &&
+            !WifiStation::GetInstance().IsConnected()) {
+            ResetWifiConfiguration();
         }
+        app.ToggleChatState();
     }
 
     void InitializeCharge() {
@@ -452,23 +437,18 @@ private:
     void InitializeCst816sTouchPad() {
         cst816s_ = new Cst816s(i2c_bus_, 0x15);
 
-        touch_isr_mux = xSemaphoreCreateBinary();
-        if (touch_isr_mux == NULL) {
-            ESP_LOGE(TAG, "Failed to create touch semaphore");
-            return;
-        }
-
-        xTaskCreatePinnedToCore(touch_event_task, "touch_task", 4 * 1024, NULL, 5, NULL, 1);
-        
-        const gpio_config_t int_gpio_config = {
-            .pin_bit_mask = (1ULL << TP_PIN_NUM_INT),
-            .mode = GPIO_MODE_INPUT,
-            .intr_type = GPIO_INTR_NEGEDGE
-        };
-        gpio_config(&int_gpio_config);
-        gpio_install_isr_service(0);
-        gpio_intr_enable(TP_PIN_NUM_INT);
-        gpio_isr_handler_add(TP_PIN_NUM_INT, EspS3Cat::lvgl_port_touch_isr_cb, NULL);
+        // 中断触发后读取触摸点，按下的边沿才切换对话状态
+        touch_input_ = new TouchInput(TP_PIN_NUM_INT, [this](TouchSample& sample) {
+            cst816s_->UpdateTouchPoint();
+            auto& touch_point = cst816s_->GetTouchPoint();
+            sample.pressed = touch_point.num > 0;
+            sample.x = touch_point.x;
+            sample.y = touch_point.y;
+            return true;
+        });
+        touch_input_->OnSample([this](const TouchSample& sample) {
+            HandleTouch(sample);
+        });
     }
 
     void InitializeSpi() {
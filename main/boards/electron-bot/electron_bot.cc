@@ -13,7 +13,7 @@
 #include "config.h"
 #include "display/lcd_display.h"
 #include "driver/spi_master.h"
-#include "electron_emoji_display.h"
+#include "display/gif_emotion_display.h"
 #include "movements.h"
 #include "power_manager.h"
 #include "system_reset.h"
@@ -27,6 +27,52 @@ void InitializeElectronBotController();
 LV_FONT_DECLARE(font_puhui_20_4);
 LV_FONT_DECLARE(font_awesome_20_4);
 
+// Electron Bot表情GIF声明 - 使用与Otto相同的6个表情
+LV_IMAGE_DECLARE(staticstate);  // 静态状态/中性表情
+LV_IMAGE_DECLARE(sad);          // 悲伤
+LV_IMAGE_DECLARE(happy);        // 开心
+LV_IMAGE_DECLARE(scare);        // 惊吓/惊讶
+LV_IMAGE_DECLARE(buxue);        // 不学/困惑
+LV_IMAGE_DECLARE(anger);        // 愤怒
+
+// 表情映射表 - 将多种表情映射到现有6个GIF，第一项为默认表情
+static const GifEmotion kEmotions[] = {
+    // 中性/平静类表情 -> staticstate
+    {"neutral", &staticstate},
+    {"relaxed", &staticstate},
+    {"sleepy", &staticstate},
+
+    // 积极/开心类表情 -> happy
+    {"happy", &happy},
+    {"laughing", &happy},
+    {"funny", &happy},
+    {"loving", &happy},
+    {"confident", &happy},
+    {"winking", &happy},
+    {"cool", &happy},
+    {"delicious", &happy},
+    {"kissy", &happy},
+    {"silly", &happy},
+
+    // 悲伤类表情 -> sad
+    {"sad", &sad},
+    {"crying", &sad},
+
+    // 愤怒类表情 -> anger
+    {"angry", &anger},
+
+    // 惊讶类表情 -> scare
+    {"surprised", &scare},
+    {"shocked", &scare},
+
+    // 思考/困惑类表情 -> buxue
+    {"thinking", &buxue},
+    {"confused", &buxue},
+    {"embarrassed", &buxue},
+
+    {nullptr, nullptr}  // 结束标记
+};
+
 class ElectronBot : public WifiBoard {
 private:
     Display* display_;
@@ -71,14 +117,15 @@ private:
         ESP_ERROR_CHECK(esp_lcd_panel_mirror(panel_handle, true, false));
         ESP_ERROR_CHECK(esp_lcd_panel_disp_on_off(panel_handle, true));
 
-        display_ = new ElectronEmojiDisplay(io_handle, panel_handle, DISPLAY_WIDTH, DISPLAY_HEIGHT,
-                                            DISPLAY_OFFSET_X, DISPLAY_OFFSET_Y, DISPLAY_MIRROR_X,
-                                            DISPLAY_MIRROR_Y, DISPLAY_SWAP_XY,
-                                            {
-                                                .text_font = &font_puhui_20_4,
-                                                .icon_font = &font_awesome_20_4,
-                                                .emoji_font = font_emoji_64_init(),
-                                            });
+        display_ = new GifEmotionDisplay(io_handle, panel_handle, DISPLAY_WIDTH, DISPLAY_HEIGHT,
+                                         DISPLAY_OFFSET_X, DISPLAY_OFFSET_Y, DISPLAY_MIRROR_X,
+                                         DISPLAY_MIRROR_Y, DISPLAY_SWAP_XY,
+                                         {
+                                             .text_font = &font_puhui_20_4,
+                                             .icon_font = &font_awesome_20_4,
+                                             .emoji_font = font_emoji_64_init(),
+                                         },
+                                         kEmotions);
     }
 
     void InitializeButtons() {
@@ -157,17 +157,15 @@ void Otto::OscillateServos(int amplitude[SERVO_COUNT], int offset[SERVO_COUNT],
         }
     }
 
-    double ref = millis();
-    double end_time = period * cycle + ref;
-
-    while (millis() < end_time) {
-        for (int i = 0; i < SERVO_COUNT; i++) {
-            if (servo_pins_[i] != -1) {
-                servo_[i].Refresh();
-            }
+    // 所有舵机由 OscillatorEngine 在同一个定时器里推进，这里阻塞到振荡结束
+    Oscillator* oscillators[SERVO_COUNT];
+    int count = 0;
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        if (servo_pins_[i] != -1) {
+            oscillators[count++] = &servo_[i];
         }
-        vTaskDelay(5);
     }
+    OscillatorEngine::GetInstance().Run(oscillators, count, (uint32_t)(period * cycle));
     vTaskDelay(pdMS_TO_TICKS(10));
 }
 
@@ -173,10 +173,24 @@ public:
             AUDIO_CODEC_PA_PIN, 
             AUDIO_CODEC_ES8311_ADDR, 
             AUDIO_CODEC_ES7210_ADDR, 
-            AUDIO_INPUT_REFERENCE);
+            AUDIO_INPUT_REFERENCE,
+#if CONFIG_AFE_DUAL_MIC
+            2);
+#else
+            1);
+#endif
         return &audio_codec;
     }
 
+#if CONFIG_AFE_DUAL_MIC
+    // 双麦克风的 BSS 开销较大，AEC 和增强改用低功耗档位
+    virtual AfeProfile GetAfeProfile() override {
+        auto profile = AfeProfile::Default();
+        profile.mode = kAfeProfileLowCost;
+        return profile;
+    }
+#endif
+
     virtual Display* GetDisplay() override {
         return display_;
     }
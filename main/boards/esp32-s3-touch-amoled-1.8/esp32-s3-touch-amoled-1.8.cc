@@ -126,6 +126,7 @@ class WaveshareEsp32s3TouchAMOLED1inch8 : public WifiBoard {
 private:
     i2c_master_bus_handle_t codec_i2c_bus_;
     Pmic* pmic_ = nullptr;
+    BatteryMonitor* battery_monitor_ = nullptr;
     Button boot_button_;
     CustomLcdDisplay* display_;
     CustomBacklight* backlight_;
@@ -312,6 +313,13 @@ public:
         InitializeTouch();
         InitializeButtons();
         InitializeTools();
+        battery_monitor_ = new BatteryMonitor([this](BatteryState& state) {
+            return pmic_->ReadBatteryState(state);
+        });
+        battery_monitor_->OnChanged([this](const BatteryState& state) {
+            power_save_timer_->SetEnabled(state.discharging);
+        });
+        battery_monitor_->Start();
     }
 
     virtual AudioCodec* GetAudioCodec() override {
@@ -330,15 +338,10 @@ public:
     }
 
     virtual bool GetBatteryLevel(int &level, bool& charging, bool& discharging) override {
-        static bool last_discharging = false;
-        charging = pmic_->IsCharging();
-        discharging = pmic_->IsDischarging();
-        if (discharging != last_discharging) {
-            power_save_timer_->SetEnabled(discharging);
-            last_discharging = discharging;
-        }
-
-        level = pmic_->GetBatteryLevel();
+        auto state = battery_monitor_->GetState();
+        level = state.level;
+        charging = state.charging;
+        discharging = state.discharging;
         return true;
     }
 
@@ -111,6 +111,7 @@ class CustomBoard : public WifiBoard {
 private:
     Button boot_button_;
     Pmic* pmic_ = nullptr;
+    BatteryMonitor* battery_monitor_ = nullptr;
     i2c_master_bus_handle_t i2c_bus_;
     esp_io_expander_handle_t io_expander = NULL;
     LcdDisplay* display_;
@@ -313,6 +314,11 @@ private:
                                         .text_font = &font_puhui_16_4,
                                         .icon_font = &font_awesome_16_4,
                                         .emoji_font = font_emoji_32_init(),
+                                    },
+                                    {
+                                        // 480x320 的屏 20 行一块要分 16 次发送，双缓冲让渲染和 SPI 发送重叠
+                                        .buffer_lines = 32,
+                                        .double_buffer = true,
                                     });
     }
 
@@ -357,6 +363,13 @@ public:
         InitializeCamera();
         InitializeTools();
         GetBacklight()->RestoreBrightness();
+        battery_monitor_ = new BatteryMonitor([this](BatteryState& state) {
+            return pmic_->ReadBatteryState(state);
+        });
+        battery_monitor_->OnChanged([this](const BatteryState& state) {
+            power_save_timer_->SetEnabled(state.discharging);
+        });
+        battery_monitor_->Start();
     }
 
     virtual AudioCodec* GetAudioCodec() override {
@@ -375,15 +388,10 @@ public:
         return &backlight;
     }
     virtual bool GetBatteryLevel(int &level, bool& charging, bool& discharging) override {
-        static bool last_discharging = false;
-        charging = pmic_->IsCharging();
-        discharging = pmic_->IsDischarging();
-        if (discharging != last_discharging) {
-            power_save_timer_->SetEnabled(discharging);
-            last_discharging = discharging;
-        }
-
-        level = pmic_->GetBatteryLevel();
+        auto state = battery_monitor_->GetState();
+        level = state.level;
+        charging = state.charging;
+        discharging = state.discharging;
         return true;
     }
 
@@ -60,6 +60,7 @@ private:
     esp_lcd_panel_handle_t panel_ = nullptr;
     Display* display_ = nullptr;
     Pmic* pmic_ = nullptr;
+    BatteryMonitor* battery_monitor_ = nullptr;
     Button boot_button_;
     Button volume_up_button_;
     Button volume_down_button_;
@@ -116,7 +117,7 @@ private:
                 .dc_low_on_data = 0,
                 .disable_control_phase = 0,
             },
-            .scl_speed_hz = 400 * 1000,
+            .scl_speed_hz = OLED_I2C_SCL_SPEED_HZ,
         };
 
         ESP_ERROR_CHECK(esp_lcd_new_panel_io_i2c_v2(display_i2c_bus_, &io_config, &panel_io_));
@@ -251,6 +252,13 @@ public:
         InitializeButtons();
         InitializePowerSaveTimer();
         InitializeIot();
+        battery_monitor_ = new BatteryMonitor([this](BatteryState& state) {
+            return pmic_->ReadBatteryState(state);
+        });
+        battery_monitor_->OnChanged([this](const BatteryState& state) {
+            power_save_timer_->SetEnabled(state.discharging);
+        });
+        battery_monitor_->Start();
     }
 
     virtual Led* GetLed() override {
@@ -270,15 +278,10 @@ public:
     }
 
     virtual bool GetBatteryLevel(int &level, bool& charging, bool& discharging) override {
-        static bool last_discharging = false;
-        charging = pmic_->IsCharging();
-        discharging = pmic_->IsDischarging();
-        if (discharging != last_discharging) {
-            power_save_timer_->SetEnabled(discharging);
-            last_discharging = discharging;
-        }
-
-        level = pmic_->GetBatteryLevel();
+        auto state = battery_monitor_->GetState();
+        level = state.level;
+        charging = state.charging;
+        discharging = state.discharging;
         return true;
     }
 };
@@ -30,7 +30,7 @@ public:
         int y = -1;
     };
 
-    Cst816x(i2c_master_bus_handle_t i2c_bus, uint8_t addr) : I2cDevice(i2c_bus, addr) {
+    Cst816x(i2c_master_bus_handle_t i2c_bus, uint8_t addr) : I2cDevice(i2c_bus, addr, kI2cPriorityTouch) {
         uint8_t chip_id = ReadReg(0xA7);
         ESP_LOGI(TAG, "Get chip ID: 0x%02X", chip_id);
         read_buffer_ = new uint8_t[6];
@@ -74,6 +74,7 @@ private:
     i2c_master_bus_handle_t i2c_bus_;
     Cst816x *cst816d_;
     Pmic* pmic_;
+    BatteryMonitor* battery_monitor_ = nullptr;
     LcdDisplay *display_;
     Button boot_button_;
     Button key1_button_;
@@ -297,6 +298,17 @@ public:
         static IrFilterController irFilter(AP1511B_GPIO);
 #endif
         GetBacklight()->RestoreBrightness();
+        battery_monitor_ = new BatteryMonitor([this](BatteryState& state) {
+            if (!pmic_->ReadBatteryState(state)) {
+                return false;
+            }
+            state.discharging = !state.charging && state.external_power;
+            return true;
+        });
+        battery_monitor_->OnChanged([this](const BatteryState& state) {
+            power_save_timer_->SetEnabled(state.discharging);
+        });
+        battery_monitor_->Start();
     }
 
     virtual AudioCodec *GetAudioCodec() override {
@@ -318,16 +330,10 @@ public:
     }
 
     virtual bool GetBatteryLevel(int &level, bool& charging, bool& discharging) override {
-        static bool last_discharging = false;
-        charging = pmic_->IsCharging();
-        bool is_power_good = pmic_->IsPowerGood();
-        discharging = !charging && is_power_good;
-        if (discharging != last_discharging) {
-            power_save_timer_->SetEnabled(discharging);
-            last_discharging = discharging;
-        }
-
-        level = pmic_->GetBatteryLevel();
+        auto state = battery_monitor_->GetState();
+        level = state.level;
+        charging = state.charging;
+        discharging = state.discharging;
         return true;
     }
 
@@ -28,7 +28,7 @@ public:
         int y = -1;
     };
 
-    Cst2xxse(i2c_master_bus_handle_t i2c_bus, uint8_t addr) : I2cDevice(i2c_bus, addr) {
+    Cst2xxse(i2c_master_bus_handle_t i2c_bus, uint8_t addr) : I2cDevice(i2c_bus, addr, kI2cPriorityTouch) {
         uint8_t chip_id = ReadReg(0x06);
         ESP_LOGI(TAG, "Get cst2xxse chip ID: 0x%02X", chip_id);
         read_buffer_ = new uint8_t[6];
@@ -58,7 +58,7 @@ private:
 class Sy6970 : public I2cDevice {
 public:
 
-    Sy6970(i2c_master_bus_handle_t i2c_bus, uint8_t addr) : I2cDevice(i2c_bus, addr) {
+    Sy6970(i2c_master_bus_handle_t i2c_bus, uint8_t addr) : I2cDevice(i2c_bus, addr, kI2cPriorityBattery) {
         uint8_t chip_id = ReadReg(0x14);
         ESP_LOGI(TAG, "Get sy6970 chip ID: 0x%02X", (chip_id & 0B00111000));
 
@@ -7,6 +7,7 @@
 #include "i2c_device.h"
 #include "iot/thing_manager.h"
 #include "axp2101.h"
+#include "touch_input.h"
 
 #include <esp_log.h>
 #include <driver/i2c_master.h>
@@ -98,7 +99,7 @@ public:
         int y = -1;
     };
     
-    Ft6336(i2c_master_bus_handle_t i2c_bus, uint8_t addr) : I2cDevice(i2c_bus, addr) {
+    Ft6336(i2c_master_bus_handle_t i2c_bus, uint8_t addr) : I2cDevice(i2c_bus, addr, kI2cPriorityTouch) {
         uint8_t chip_id = ReadReg(0xA3);
         ESP_LOGI(TAG, "Get chip ID: 0x%02X", chip_id);
         read_buffer_ = new uint8_t[6];
@@ -129,11 +130,12 @@ class M5StackCoreS3Board : public WifiBoard {
 private:
     i2c_master_bus_handle_t i2c_bus_;
     Pmic* pmic_;
+    BatteryMonitor* battery_monitor_ = nullptr;
     Aw9523* aw9523_;
     Ft6336* ft6336_;
+    TouchInput* touch_input_ = nullptr;
     LcdDisplay* display_;
     Esp32Camera* camera_;
-    esp_timer_handle_t touchpad_timer_;
     PowerSaveTimer* power_save_timer_;
 
     void InitializePowerSaveTimer() {
@@ -206,21 +208,18 @@ private:
         vTaskDelay(pdMS_TO_TICKS(50));
     }
 
-    void PollTouchpad() {
+    void HandleTouch(const TouchSample& sample) {
         static bool was_touched = false;
         static int64_t touch_start_time = 0;
         const int64_t TOUCH_THRESHOLD_MS = 500;  // 触摸时长阈值，超过500ms视为长按
-        
-        ft6336_->UpdateTouchPoint();
-        auto& touch_point = ft6336_->GetTouchPoint();
-        
+
         // 检测触摸开始
-        if (touch_point.num > 0 && !was_touched) {
+        if (sample.pressed && !was_touched) {
             was_touched = true;
             touch_start_time = esp_timer_get_time() / 1000; // 转换为毫秒
         } 
         // 检测触摸释放
-        else if (touch_point.num == 0 && was_touched) {
+        else if (!sample.pressed && was_touched) {
             was_touched = false;
             int64_t touch_duration = (esp_timer_get_time() / 1000) - touch_start_time;
             
@@ -239,21 +238,20 @@ private:
     void InitializeFt6336TouchPad() {
         ESP_LOGI(TAG, "Init FT6336");
         ft6336_ = new Ft6336(i2c_bus_, 0x38);
-        
-        // 创建定时器，20ms 间隔
-        esp_timer_create_args_t timer_args = {
-            .callback = [](void* arg) {
-                M5StackCoreS3Board* board = (M5StackCoreS3Board*)arg;
-                board->PollTouchpad();
-            },
-            .arg = this,
-            .dispatch_method = ESP_TIMER_TASK,
-            .name = "touchpad_timer",
-            .skip_unhandled_events = true,
-        };
-        
-        ESP_ERROR_CHECK(esp_timer_create(&timer_args, &touchpad_timer_));
-        ESP_ERROR_CHECK(esp_timer_start_periodic(touchpad_timer_, 20 * 1000));
+
+        // 只在 INT 触发后读取触摸点，不再每 20ms 轮询 I2C
+        touch_input_ = new TouchInput(TOUCH_INT_GPIO, [this](TouchSample& sample) {
+            ft6336_->UpdateTouchPoint();
+            auto& touch_point = ft6336_->GetTouchPoint();
+            sample.pressed = touch_point.num > 0;
+            sample.x = touch_point.x;
+            sample.y = touch_point.y;
+            return true;
+        });
+        touch_input_->OnSample([this](const TouchSample& sample) {
+            HandleTouch(sample);
+        });
+        touch_input_->AttachLvgl();
     }
 
     void InitializeSpi() {
@@ -363,6 +361,13 @@ public:
         InitializeIot();
         InitializeFt6336TouchPad();
         GetBacklight()->RestoreBrightness();
+        battery_monitor_ = new BatteryMonitor([this](BatteryState& state) {
+            return pmic_->ReadBatteryState(state);
+        });
+        battery_monitor_->OnChanged([this](const BatteryState& state) {
+            power_save_timer_->SetEnabled(state.discharging);
+        });
+        battery_monitor_->Start();
     }
 
     virtual AudioCodec* GetAudioCodec() override {
@@ -389,15 +394,10 @@ public:
     }
 
     virtual bool GetBatteryLevel(int &level, bool& charging, bool& discharging) override {
-        static bool last_discharging = false;
-        charging = pmic_->IsCharging();
-        discharging = pmic_->IsDischarging();
-        if (discharging != last_discharging) {
-            power_save_timer_->SetEnabled(discharging);
-            last_discharging = discharging;
-        }
-
-        level = pmic_->GetBatteryLevel();
+        auto state = battery_monitor_->GetState();
+        level = state.level;
+        charging = state.charging;
+        discharging = state.discharging;
         return true;
     }
 
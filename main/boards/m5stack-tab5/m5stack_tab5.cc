@@ -229,7 +229,7 @@ private:
                                                  .dpi_clk_src        = MIPI_DSI_DPI_CLK_SRC_DEFAULT,
                                                  .dpi_clock_freq_mhz = 60,
                                                  .pixel_format       = LCD_COLOR_PIXEL_FORMAT_RGB565,
-                                                 .num_fbs            = 2,
+                                                 .num_fbs            = MIPI_DPI_FRAME_BUFFERS,
                                                  .video_timing =
                                                      {
                                                          .h_size            = DISPLAY_WIDTH,
@@ -242,7 +242,7 @@ private:
                                                          .vsync_front_porch = 20,
                                                      },
                                                  .flags = {
-                                                     .use_dma2d = false,
+                                                     .use_dma2d = true,
                                                  }};
 
         ili9881c_vendor_config_t vendor_config = {
@@ -4,15 +4,19 @@
 #include "board.h"
 #include "system_info.h"
 #include "config.h"
+#include "buffered_http_writer.h"
 
 #include <esp_log.h>
 #include <esp_heap_caps.h>
 #include <img_converters.h>
 #include <cstring>
+#include <cJSON.h>
 
 #define TAG "SscmaCamera"
 
 #define IMG_JPEG_BUF_SIZE   48 * 1024
+// 模组推理一次通常几百毫秒，超时算失败
+#define SSCMA_DETECT_TIMEOUT_MS 3000
 
 SscmaCamera::SscmaCamera(esp_io_expander_handle_t io_exp_handle) {
     sscma_client_io_spi_config_t spi_io_config = {0};
@@ -44,6 +48,7 @@ SscmaCamera::SscmaCamera(esp_io_expander_handle_t io_exp_handle) {
     sscma_client_new(sscma_client_io_handle_, &sscma_client_config, &sscma_client_handle_);
 
     sscma_data_queue_ = xQueueCreate(1, sizeof(SscmaData));
+    sscma_detect_queue_ = xQueueCreate(1, sizeof(SscmaDetection));
 
     sscma_client_callback_t callback = {0};
 
@@ -70,6 +75,20 @@ SscmaCamera::SscmaCamera(esp_io_expander_handle_t io_exp_handle) {
             xQueueSend(self->sscma_data_queue_, &data, 0);
             // 注意：img 的释放由接收方负责
         }
+
+        if (self->detect_pending_) {
+            SscmaDetection detection = {};
+            sscma_utils_fetch_boxes_from_reply(reply, &detection.boxes, &detection.num_boxes);
+            sscma_utils_fetch_classes_from_reply(reply, &detection.classes, &detection.num_classes);
+            // 只保留最新一次的结果
+            SscmaDetection dummy;
+            while (xQueueReceive(self->sscma_detect_queue_, &dummy, 0) == pdPASS) {
+                FreeDetection(dummy);
+            }
+            if (xQueueSend(self->sscma_detect_queue_, &detection, 0) != pdPASS) {
+                FreeDetection(detection);
+            }
+        }
     };
     callback.on_connect = [](sscma_client_handle_t client, const sscma_client_reply_t *reply, void *user_ctx) {
         ESP_LOGI(TAG, "SSCMA client connected");
@@ -100,6 +119,16 @@ SscmaCamera::SscmaCamera(esp_io_expander_handle_t io_exp_handle) {
             info->id ? info->id : "NULL", 
             info->name ? info->name : "NULL");
     }
+    // 检测结果里只有类别编号，名字从模型信息中取
+    sscma_client_model_t *model;
+    if (sscma_client_get_model(sscma_client_handle_, &model, true) == ESP_OK) {
+        for (int i = 0; i < SSCMA_CLIENT_MODEL_MAX_CLASSES && model->classes[i] != nullptr; i++) {
+            class_names_.push_back(model->classes[i]);
+        }
+        ESP_LOGI(TAG, "Model: %s, %d classes", model->name ? model->name : "NULL", (int)class_names_.size());
+    }
+    AddTools();
+
     // 初始化JPEG数据的内存
     jpeg_data_.len = 0;
     jpeg_data_.buf = (uint8_t*)heap_caps_malloc(IMG_JPEG_BUF_SIZE, MALLOC_CAP_SPIRAM);;
@@ -160,6 +189,13 @@ SscmaCamera::~SscmaCamera() {
     if (sscma_data_queue_) {
         vQueueDelete(sscma_data_queue_);
     }
+    if (sscma_detect_queue_) {
+        SscmaDetection detection;
+        while (xQueueReceive(sscma_detect_queue_, &detection, 0) == pdPASS) {
+            FreeDetection(detection);
+        }
+        vQueueDelete(sscma_detect_queue_);
+    }
     if (jpeg_data_.buf) {
         heap_caps_free(jpeg_data_.buf);
         jpeg_data_.buf = nullptr;
@@ -219,6 +255,12 @@ bool SscmaCamera::Capture() {
     }
     heap_caps_free(data.img);
 
+    // 没有屏幕就不需要预览，跳过解码
+    auto display = Board::GetInstance().GetDisplay();
+    if (display == nullptr) {
+        return true;
+    }
+
     //DECODE JPEG
     if (!jpeg_dec_ || !jpeg_io_ || !jpeg_out_ || !preview_image_.data) {
         return true;
@@ -242,12 +284,100 @@ bool SscmaCamera::Capture() {
     }
 
     // 显示预览图片
-    auto display = Board::GetInstance().GetDisplay();
-    if (display != nullptr) {
-        display->SetPreviewImage(&preview_image_);
-    }
+    display->SetPreviewImage(&preview_image_);
     return true;
 }
+
+void SscmaCamera::FreeDetection(SscmaDetection& detection) {
+    if (detection.boxes) {
+        free(detection.boxes);
+        detection.boxes = nullptr;
+    }
+    if (detection.classes) {
+        free(detection.classes);
+        detection.classes = nullptr;
+    }
+}
+
+std::string SscmaCamera::Detect() {
+    if (sscma_client_handle_ == nullptr || sscma_detect_queue_ == nullptr) {
+        return "{\"success\": false, \"message\": \"SSCMA client is not initialized\"}";
+    }
+
+    // 清掉上次超时后才到达的结果
+    SscmaDetection detection;
+    while (xQueueReceive(sscma_detect_queue_, &detection, 0) == pdPASS) {
+        FreeDetection(detection);
+    }
+
+    // 只要推理结果，不让模组附带图片
+    detect_pending_ = true;
+    if (sscma_client_invoke(sscma_client_handle_, 1, false, false) != ESP_OK) {
+        detect_pending_ = false;
+        ESP_LOGE(TAG, "Failed to invoke SSCMA model");
+        return "{\"success\": false, \"message\": \"Failed to invoke model\"}";
+    }
+    bool received = xQueueReceive(sscma_detect_queue_, &detection, pdMS_TO_TICKS(SSCMA_DETECT_TIMEOUT_MS)) == pdPASS;
+    detect_pending_ = false;
+    if (!received) {
+        ESP_LOGE(TAG, "Timeout waiting for SSCMA detection result");
+        return "{\"success\": false, \"message\": \"Detection timeout\"}";
+    }
+
+    auto label = [this](int target) -> std::string {
+        if (target >= 0 && target < (int)class_names_.size()) {
+            return class_names_[target];
+        }
+        return std::to_string(target);
+    };
+
+    cJSON* json = cJSON_CreateObject();
+    cJSON_AddBoolToObject(json, "success", true);
+    cJSON* boxes = cJSON_AddArrayToObject(json, "boxes");
+    for (int i = 0; i < detection.num_boxes; i++) {
+        const auto& box = detection.boxes[i];
+        cJSON* item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "label", label(box.target).c_str());
+        cJSON_AddNumberToObject(item, "score", box.score);
+        cJSON_AddNumberToObject(item, "x", box.x);
+        cJSON_AddNumberToObject(item, "y", box.y);
+        cJSON_AddNumberToObject(item, "w", box.w);
+        cJSON_AddNumberToObject(item, "h", box.h);
+        cJSON_AddItemToArray(boxes, item);
+    }
+    cJSON* classes = cJSON_AddArrayToObject(json, "classes");
+    for (int i = 0; i < detection.num_classes; i++) {
+        const auto& cls = detection.classes[i];
+        cJSON* item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "label", label(cls.target).c_str());
+        cJSON_AddNumberToObject(item, "score", cls.score);
+        cJSON_AddItemToArray(classes, item);
+    }
+    ESP_LOGI(TAG, "Detect: %d boxes, %d classes", detection.num_boxes, detection.num_classes);
+    FreeDetection(detection);
+
+    auto str = cJSON_PrintUnformatted(json);
+    std::string result(str);
+    cJSON_free(str);
+    cJSON_Delete(json);
+    return result;
+}
+
+void SscmaCamera::AddTools() {
+    static const McpStaticTool kTools[] = {
+        {"self.camera.detect",
+            "Run the object detection model on the camera module and return what it sees, without uploading a photo. "
+            "Much faster than `self.camera.take_photo`, use it for quick checks like whether someone is there.\n"
+            "Return:\n"
+            "  A JSON object with `boxes` (label, score 0-100, x/y center and w/h in pixels of the 640x480 frame) "
+            "and `classes` (label, score) detected by the model.",
+            MCP_NO_PROPERTIES, [](void* context, const PropertyList& properties) -> ReturnValue {
+                auto self = static_cast<SscmaCamera*>(context);
+                return self->Detect();
+            }},
+    };
+    McpServer::GetInstance().AddStaticTools(kTools, sizeof(kTools) / sizeof(kTools[0]), this);
+}
 bool SscmaCamera::SetHMirror(bool enabled) {
     return false;
 }
@@ -273,7 +403,7 @@ bool SscmaCamera::SetVFlip(bool enabled) {
  * @note 函数会等待之前的编码线程完成后再开始新的处理
  * @warning 如果摄像头缓冲区为空或网络连接失败，将返回错误信息
  */
-std::string SscmaCamera::Explain(const std::string& question) {
+std::string SscmaCamera::Explain(const std::string& question, ExplainPartialCallback on_partial) {
     if (explain_url_.empty()) {
         return "{\"success\": false, \"message\": \"Image explain URL or token is not set\"}";
     }
@@ -313,20 +443,22 @@ std::string SscmaCamera::Explain(const std::string& question) {
         return "{\"success\": false, \"message\": \"Failed to connect to explain URL\"}";
     }
     
+    // 各部分合并成记录大小的块再发送
+    BufferedHttpWriter writer(http);
     // 第一块：question字段
-    http->Write(question_field.c_str(), question_field.size());
+    writer.Write(question_field);
     
     // 第二块：文件字段头部
-    http->Write(file_header.c_str(), file_header.size());
+    writer.Write(file_header);
     
     // 第三块：JPEG数据
-    http->Write((const char*)jpeg_data_.buf, jpeg_data_.len);
+    writer.Write((const char*)jpeg_data_.buf, jpeg_data_.len);
 
     // 第四块：multipart尾部
-    http->Write(multipart_footer.c_str(), multipart_footer.size());
+    writer.Write(multipart_footer);
     
     // 结束块
-    http->Write("", 0);
+    writer.Finish();
 
     if (http->GetStatusCode() != 200) {
         ESP_LOGE(TAG, "Failed to upload photo, status code: %d", http->GetStatusCode());
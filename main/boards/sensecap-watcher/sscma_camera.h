@@ -4,6 +4,9 @@
 #include <lvgl.h>
 #include <thread>
 #include <memory>
+#include <atomic>
+#include <vector>
+#include <string>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
@@ -18,6 +21,14 @@ struct SscmaData {
     uint8_t* img;
     size_t len;
 };
+// 模组上运行的模型返回的检测结果，数组由 sscma_utils 分配，接收方释放
+struct SscmaDetection {
+    sscma_client_box_t* boxes;
+    int num_boxes;
+    sscma_client_class_t* classes;
+    int num_classes;
+};
+
 struct JpegData {
     uint8_t* buf;
     size_t len;
@@ -35,6 +46,14 @@ private:
     jpeg_dec_handle_t *jpeg_dec_;
     jpeg_dec_io_t *jpeg_io_;
     jpeg_dec_header_info_t *jpeg_out_;
+    // 检测结果只在 Detect 等待时投递，平时的推理结果直接丢弃
+    QueueHandle_t sscma_detect_queue_ = nullptr;
+    std::atomic<bool> detect_pending_{false};
+    std::vector<std::string> class_names_;
+
+    void AddTools();
+    static void FreeDetection(SscmaDetection& detection);
+
 public:
     SscmaCamera(esp_io_expander_handle_t io_exp_handle);
     ~SscmaCamera();
@@ -44,7 +63,9 @@ public:
     // 翻转控制函数
     virtual bool SetHMirror(bool enabled) override;
     virtual bool SetVFlip(bool enabled) override;
-    virtual std::string Explain(const std::string& question);
+    virtual std::string Explain(const std::string& question, ExplainPartialCallback on_partial);
+    // 用模组上的模型推理一次，返回检测框和分类的 JSON，不传图片也不解码 JPEG
+    std::string Detect();
 };
 
 #endif // ESP32_CAMERA_H
@@ -122,7 +122,7 @@ private:
             .dpi_clk_src = MIPI_DSI_DPI_CLK_SRC_DEFAULT,
             .dpi_clock_freq_mhz = 80,
             .pixel_format = LCD_COLOR_PIXEL_FORMAT_RGB565,
-            .num_fbs = 1,
+            .num_fbs = MIPI_DPI_FRAME_BUFFERS,
             .video_timing = {
                 .h_size = 800,
                 .v_size = 1280,
@@ -79,7 +79,7 @@ private:
             .dpi_clk_src = MIPI_DSI_DPI_CLK_SRC_DEFAULT,
             .dpi_clock_freq_mhz = 46,
             .pixel_format = LCD_COLOR_PIXEL_FORMAT_RGB565,
-            .num_fbs = 1,
+            .num_fbs = MIPI_DPI_FRAME_BUFFERS,
             .video_timing = {
                 .h_size = DISPLAY_WIDTH,
                 .v_size = DISPLAY_HEIGHT,
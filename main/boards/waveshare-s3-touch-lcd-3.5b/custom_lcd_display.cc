@@ -1,8 +1,10 @@
 #include "custom_lcd_display.h"
 
 #include "lcd_display.h"
+#include "task_manifest.h"
 
 #include <vector>
+#include <algorithm>
 #include <font_awesome_symbols.h>
 #include <esp_log.h>
 #include <esp_err.h>
@@ -178,7 +180,7 @@ void CustomLcdDisplay::lvgl_port_flush_callback(lv_display_t *drv, const lv_area
             case LV_DISPLAY_ROTATION_90:
                 for (int y = 0; y < height; y++) {
                     for (int x = 0; x < trans_width; x++) {
-                        *(to + x * height + (height - y - 1)) = *(from + y * width + x_start_tmp + x);
+                        *(to + x * height + (height - y - 1)) = *(from + y * width + (x_start_tmp - x_start) + x);
                     }
                 }
                 x_draw_start = ver_res - y_end - 1;
@@ -189,7 +191,7 @@ void CustomLcdDisplay::lvgl_port_flush_callback(lv_display_t *drv, const lv_area
             case LV_DISPLAY_ROTATION_270:
                 for (int y = 0; y < height; y++) {
                     for (int x = 0; x < trans_width; x++) {
-                        *(to + (trans_width - x - 1) * height + y) = *(from + y * width + x_start_tmp + x);
+                        *(to + (trans_width - x - 1) * height + y) = *(from + y * width + (x_start_tmp - x_start) + x);
                     }
                 }
                 x_draw_start = y_start;
@@ -200,7 +202,7 @@ void CustomLcdDisplay::lvgl_port_flush_callback(lv_display_t *drv, const lv_area
             case LV_DISPLAY_ROTATION_180:
                 for (int y = 0; y < trans_height; y++) {
                     for (int x = 0; x < width; x++) {
-                        *(to + (trans_height - y - 1)*width + (width - x - 1)) = *(from + y_start_tmp * width + y * (width) + x);
+                        *(to + (trans_height - y - 1)*width + (width - x - 1)) = *(from + (y_start_tmp - y_start) * width + y * (width) + x);
                     }
                 }
                 x_draw_start = hor_res - x_end - 1;
@@ -211,7 +213,7 @@ void CustomLcdDisplay::lvgl_port_flush_callback(lv_display_t *drv, const lv_area
             case LV_DISPLAY_ROTATION_0:
                 for (int y = 0; y < trans_height; y++) {
                     for (int x = 0; x < width; x++) {
-                        *(to + y * (width) + x) = *(from + y_start_tmp * width + y * (width) + x);
+                        *(to + y * (width) + x) = *(from + (y_start_tmp - y_start) * width + y * (width) + x);
                     }
                 }
                 x_draw_start = x_start;
@@ -253,7 +255,7 @@ void CustomLcdDisplay::lvgl_port_flush_callback(lv_display_t *drv, const lv_area
 
 CustomLcdDisplay::CustomLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
                            int width, int height, int offset_x, int offset_y, bool mirror_x, bool mirror_y, bool swap_xy,
-                           DisplayFonts fonts)
+                           DisplayFonts fonts, LcdBufferProfile profile)
     : LcdDisplay(panel_io, panel, fonts, width, height) {
     //     width_ = width;
     // height_ = height;
@@ -273,7 +275,9 @@ CustomLcdDisplay::CustomLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_p
 
     ESP_LOGI(TAG, "Initialize LVGL port");
     lvgl_port_cfg_t port_cfg = ESP_LVGL_PORT_INIT_CONFIG();
-    port_cfg.task_priority = 1;
+    auto& lvgl_spec = TaskManifest::GetInstance().Get(kTaskLvgl);
+    port_cfg.task_priority = lvgl_spec.priority;
+    port_cfg.task_affinity = lvgl_spec.core;
     port_cfg.timer_period_ms = 50;
     lvgl_port_init(&port_cfg);
     trans_done_sem = xSemaphoreCreateCounting(1, 0);
@@ -311,15 +315,23 @@ CustomLcdDisplay::CustomLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_p
     lv_display_set_flush_cb(display_, lvgl_port_flush_callback);
 #else
 
-    uint32_t buffer_size = 0;
-    lv_color_t *buf1 = NULL;
+    // 发送经过 trans_buf 中转和旋转，绘制缓冲区可以放在 PSRAM；行数小于屏幕高度时只渲染脏区域
+    int buffer_lines = std::min(profile.buffer_lines, height_);
+    auto render_mode = buffer_lines >= height_ ? LV_DISPLAY_RENDER_MODE_FULL : LV_DISPLAY_RENDER_MODE_PARTIAL;
+    uint32_t caps = profile.spiram ? MALLOC_CAP_SPIRAM : (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    ESP_LOGI(TAG, "Draw buffer %d lines x%d in %s", buffer_lines, profile.double_buffer ? 2 : 1,
+        profile.spiram ? "PSRAM" : "internal RAM");
     lvgl_port_lock(0);
     uint8_t color_bytes = lv_color_format_get_size(LV_COLOR_FORMAT_RGB565);
     display_ = lv_display_create(width_, height_);
     lv_display_set_flush_cb(display_, lvgl_port_flush_callback);
-    buffer_size = width_ * height_;
-    buf1 = (lv_color_t *)heap_caps_aligned_alloc(1, buffer_size * color_bytes, MALLOC_CAP_SPIRAM);
-    lv_display_set_buffers(display_, buf1, NULL, buffer_size * color_bytes, LV_DISPLAY_RENDER_MODE_FULL);
+    uint32_t buffer_size = width_ * buffer_lines;
+    auto buf1 = (lv_color_t *)heap_caps_aligned_alloc(4, buffer_size * color_bytes, caps);
+    lv_color_t *buf2 = NULL;
+    if (profile.double_buffer) {
+        buf2 = (lv_color_t *)heap_caps_aligned_alloc(4, buffer_size * color_bytes, caps);
+    }
+    lv_display_set_buffers(display_, buf1, buf2, buffer_size * color_bytes, render_mode);
     lv_display_set_driver_data(display_, panel_);
     lvgl_port_unlock();
 
@@ -0,0 +1,54 @@
+#include "boot_profiler.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <algorithm>
+#include <cstring>
+
+#define TAG "BootProfiler"
+
+void BootProfiler::Mark(const char* name) {
+    int64_t now = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int i = 0; i < count_; i++) {
+        if (strcmp(marks_[i].name, name) == 0) {
+            return;
+        }
+    }
+    if (count_ == kMaxMarks) {
+        return;
+    }
+    marks_[count_++] = {name, now};
+}
+
+// 不同任务中的节点可能乱序记录
+void BootProfiler::Sort() {
+    std::sort(marks_, marks_ + count_, [](const Milestone& a, const Milestone& b) {
+        return a.time_us < b.time_us;
+    });
+}
+
+void BootProfiler::LogReport() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Sort();
+    int64_t last = 0;
+    for (int i = 0; i < count_; i++) {
+        ESP_LOGI(TAG, "%-16s %6lldms  +%lldms", marks_[i].name, marks_[i].time_us / 1000, (marks_[i].time_us - last) / 1000);
+        last = marks_[i].time_us;
+    }
+}
+
+std::string BootProfiler::GetJson() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Sort();
+    std::string json = "{";
+    for (int i = 0; i < count_; i++) {
+        if (i > 0) {
+            json += ",";
+        }
+        json += "\"" + std::string(marks_[i].name) + "\":" + std::to_string(marks_[i].time_us / 1000);
+    }
+    json += "}";
+    return json;
+}
@@ -0,0 +1,39 @@
+#ifndef BOOT_PROFILER_H
+#define BOOT_PROFILER_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// 启动耗时记录：在各个启动节点调用 Mark，时间为 esp_timer_get_time()，从芯片复位开始计
+// 名字需要是字符串常量，同名节点只记录第一次
+class BootProfiler {
+public:
+    static BootProfiler& GetInstance() {
+        static BootProfiler instance;
+        return instance;
+    }
+
+    void Mark(const char* name);
+    // 按时间排序打印每个节点和与上一个节点的间隔
+    void LogReport();
+    // {"app_main":120,"nvs_init":135,...}，单位毫秒
+    std::string GetJson();
+
+private:
+    static constexpr int kMaxMarks = 24;
+
+    struct Milestone {
+        const char* name;
+        int64_t time_us;
+    };
+
+    std::mutex mutex_;
+    Milestone marks_[kMaxMarks];
+    int count_ = 0;
+
+    BootProfiler() = default;
+    void Sort();
+};
+
+#endif // BOOT_PROFILER_H
@@ -0,0 +1,77 @@
+#include "buffered_http_writer.h"
+#include "metrics.h"
+
+#include <esp_log.h>
+#include <algorithm>
+
+#define TAG "BufferedHttpWriter"
+
+static MetricCounter metric_writes("http.buffered_writes");
+static MetricCounter metric_flushes("http.buffer_flushes");
+
+BufferedHttpWriter::BufferedHttpWriter(Http* http, size_t capacity) : http_(http), capacity_(capacity) {
+    buffer_.reserve(capacity_);
+}
+
+BufferedHttpWriter::~BufferedHttpWriter() {
+    if (!buffer_.empty()) {
+        ESP_LOGW(TAG, "%u bytes dropped without Finish", (unsigned)buffer_.size());
+    }
+}
+
+bool BufferedHttpWriter::WriteThrough(const char* data, size_t size) {
+    if (failed_) {
+        return false;
+    }
+    metric_flushes.Add();
+    if (http_->Write(data, size) < 0) {
+        ESP_LOGE(TAG, "Write of %u bytes failed", (unsigned)size);
+        failed_ = true;
+        return false;
+    }
+    bytes_written_ += size;
+    return true;
+}
+
+bool BufferedHttpWriter::Write(const char* data, size_t size) {
+    metric_writes.Add();
+    if (capacity_ == 0) {
+        return size == 0 || WriteThrough(data, size);
+    }
+    while (size > 0) {
+        // 缓冲区为空且剩余数据不少于一整块时不用拷贝
+        if (buffer_.empty() && size >= capacity_) {
+            if (!WriteThrough(data, capacity_)) {
+                return false;
+            }
+            data += capacity_;
+            size -= capacity_;
+            continue;
+        }
+        size_t n = std::min(size, capacity_ - buffer_.size());
+        buffer_.append(data, n);
+        data += n;
+        size -= n;
+        if (buffer_.size() == capacity_ && !Flush()) {
+            return false;
+        }
+    }
+    return !failed_;
+}
+
+bool BufferedHttpWriter::Flush() {
+    if (buffer_.empty()) {
+        return !failed_;
+    }
+    bool ok = WriteThrough(buffer_.data(), buffer_.size());
+    buffer_.clear();
+    return ok;
+}
+
+bool BufferedHttpWriter::Finish() {
+    if (!Flush()) {
+        return false;
+    }
+    // 分块传输的结束块
+    return http_->Write("", 0) >= 0;
+}
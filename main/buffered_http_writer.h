@@ -0,0 +1,37 @@
+#ifndef BUFFERED_HTTP_WRITER_H
+#define BUFFERED_HTTP_WRITER_H
+
+#include <http.h>
+
+#include <cstddef>
+#include <string>
+
+// 合并对 Http::Write 的小块写入，攒满 capacity 字节再写一次
+// 分块传输时每次 Write 都是一个 chunk 头加一个 TLS 记录，ML307 上还要多一条 AT 命令，
+// 上传时先写进这里，按记录大小成块发送
+// capacity 为 0 时直接透传
+class BufferedHttpWriter {
+public:
+    explicit BufferedHttpWriter(Http* http, size_t capacity = CONFIG_HTTP_WRITE_BUFFER_SIZE);
+    ~BufferedHttpWriter();
+
+    bool Write(const char* data, size_t size);
+    bool Write(const std::string& data) { return Write(data.data(), data.size()); }
+    // 立即发出缓存的数据，例如后面要等待较长时间才有新数据时
+    bool Flush();
+    // 发出剩余的数据并写入结束块
+    bool Finish();
+
+    size_t bytes_written() const { return bytes_written_; }
+
+private:
+    Http* http_;
+    size_t capacity_;
+    std::string buffer_;
+    size_t bytes_written_ = 0;
+    bool failed_ = false;
+
+    bool WriteThrough(const char* data, size_t size);
+};
+
+#endif // BUFFERED_HTTP_WRITER_H
@@ -0,0 +1,189 @@
+#include "crash_ring.h"
+#include "metrics.h"
+
+#include <esp_attr.h>
+#include <esp_log.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <cJSON.h>
+#include <cstring>
+
+#define TAG "CrashRing"
+
+#define CRASH_RING_MAGIC 0x43524e47
+
+enum CrashRingEventKind : uint8_t {
+    kCrashRingState = 1,
+    kCrashRingSchedule = 2,
+};
+
+struct CrashRingSample {
+    uint32_t uptime_ms;
+    uint32_t internal_free;
+    uint32_t internal_largest;
+    uint32_t psram_free;
+    uint16_t send_queue;
+    uint16_t decode_queue;
+    uint8_t top_task_cpu;
+    char top_task[CRASH_RING_LABEL_SIZE - 1];
+};
+
+struct CrashRingEvent {
+    uint32_t uptime_ms;
+    uint32_t caller;
+    uint8_t kind;
+    char label[CRASH_RING_LABEL_SIZE - 1];
+};
+
+struct CrashRingData {
+    uint32_t magic;
+    uint32_t sample_next;
+    uint32_t sample_count;
+    uint32_t event_next;
+    uint32_t event_count;
+    CrashRingSample samples[CRASH_RING_SAMPLES];
+    CrashRingEvent events[CRASH_RING_EVENTS];
+};
+
+// 上电时内容是随机的，靠 magic 和下标范围判断是否有效
+static RTC_NOINIT_ATTR CrashRingData ring;
+
+static bool RingValid() {
+    return ring.magic == CRASH_RING_MAGIC && ring.sample_next < CRASH_RING_SAMPLES &&
+        ring.sample_count <= CRASH_RING_SAMPLES && ring.event_next < CRASH_RING_EVENTS &&
+        ring.event_count <= CRASH_RING_EVENTS;
+}
+
+static uint32_t UptimeMs() {
+    return esp_timer_get_time() / 1000;
+}
+
+static const char* ResetReasonName(int reason) {
+    switch (reason) {
+        case ESP_RST_PANIC: return "panic";
+        case ESP_RST_INT_WDT: return "int_wdt";
+        case ESP_RST_TASK_WDT: return "task_wdt";
+        case ESP_RST_WDT: return "wdt";
+        case ESP_RST_BROWNOUT: return "brownout";
+        default: return "other";
+    }
+}
+
+static void CopyLabel(char* dest, size_t size, const char* src) {
+    strncpy(dest, src, size - 1);
+    dest[size - 1] = '\0';
+}
+
+void CrashRing::Initialize() {
+    int reason = esp_reset_reason();
+    // 正常重启（OTA、用户重启）和深度睡眠唤醒不上报
+    bool abnormal = reason != ESP_RST_POWERON && reason != ESP_RST_SW && reason != ESP_RST_DEEPSLEEP &&
+        reason != ESP_RST_EXT && reason != ESP_RST_USB;
+    if (abnormal && RingValid() && ring.sample_count > 0) {
+        BuildReport(reason);
+        ESP_LOGW(TAG, "Recorded %u seconds before %s reset", (unsigned)ring.sample_count, ResetReasonName(reason));
+    }
+    memset(&ring, 0, sizeof(ring));
+    ring.magic = CRASH_RING_MAGIC;
+}
+
+void CrashRing::Sample(uint32_t send_queue, uint32_t decode_queue) {
+    if (ring.magic != CRASH_RING_MAGIC) {
+        return;
+    }
+    auto& sample = ring.samples[ring.sample_next];
+    sample.uptime_ms = UptimeMs();
+    sample.internal_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    sample.internal_largest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    sample.psram_free = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    sample.send_queue = send_queue;
+    sample.decode_queue = decode_queue;
+    char name[16] = {};
+    uint8_t cpu = 0;
+    Metrics::GetInstance().GetTopTask(name, sizeof(name), cpu);
+    CopyLabel(sample.top_task, sizeof(sample.top_task), name);
+    sample.top_task_cpu = cpu;
+    ring.sample_next = (ring.sample_next + 1) % CRASH_RING_SAMPLES;
+    if (ring.sample_count < CRASH_RING_SAMPLES) {
+        ring.sample_count++;
+    }
+}
+
+// 状态切换和回调都在主循环中记录，不需要加锁
+void CrashRing::RecordState(const char* state) {
+    if (ring.magic != CRASH_RING_MAGIC) {
+        return;
+    }
+    auto& event = ring.events[ring.event_next];
+    event.uptime_ms = UptimeMs();
+    event.kind = kCrashRingState;
+    event.caller = 0;
+    CopyLabel(event.label, sizeof(event.label), state);
+    ring.event_next = (ring.event_next + 1) % CRASH_RING_EVENTS;
+    if (ring.event_count < CRASH_RING_EVENTS) {
+        ring.event_count++;
+    }
+}
+
+void CrashRing::RecordSchedule(const void* caller) {
+    if (ring.magic != CRASH_RING_MAGIC) {
+        return;
+    }
+    auto& event = ring.events[ring.event_next];
+    event.uptime_ms = UptimeMs();
+    event.kind = kCrashRingSchedule;
+    event.caller = reinterpret_cast<uintptr_t>(caller);
+    event.label[0] = '\0';
+    ring.event_next = (ring.event_next + 1) % CRASH_RING_EVENTS;
+    if (ring.event_count < CRASH_RING_EVENTS) {
+        ring.event_count++;
+    }
+}
+
+void CrashRing::BuildReport(int reset_reason) {
+    auto root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "reason", ResetReasonName(reset_reason));
+
+    // 从最旧的一条开始，标签不一定以 0 结尾
+    auto samples = cJSON_CreateArray();
+    for (uint32_t i = 0; i < ring.sample_count; i++) {
+        auto& sample = ring.samples[(ring.sample_next + CRASH_RING_SAMPLES - ring.sample_count + i) % CRASH_RING_SAMPLES];
+        auto item = cJSON_CreateObject();
+        cJSON_AddNumberToObject(item, "t", sample.uptime_ms);
+        cJSON_AddNumberToObject(item, "free", sample.internal_free);
+        cJSON_AddNumberToObject(item, "largest", sample.internal_largest);
+        cJSON_AddNumberToObject(item, "psram", sample.psram_free);
+        cJSON_AddNumberToObject(item, "send_q", sample.send_queue);
+        cJSON_AddNumberToObject(item, "decode_q", sample.decode_queue);
+        std::string task(sample.top_task, strnlen(sample.top_task, sizeof(sample.top_task)));
+        if (!task.empty()) {
+            cJSON_AddStringToObject(item, "task", task.c_str());
+            cJSON_AddNumberToObject(item, "cpu", sample.top_task_cpu);
+        }
+        cJSON_AddItemToArray(samples, item);
+    }
+    cJSON_AddItemToObject(root, "samples", samples);
+
+    auto events = cJSON_CreateArray();
+    for (uint32_t i = 0; i < ring.event_count; i++) {
+        auto& event = ring.events[(ring.event_next + CRASH_RING_EVENTS - ring.event_count + i) % CRASH_RING_EVENTS];
+        auto item = cJSON_CreateObject();
+        cJSON_AddNumberToObject(item, "t", event.uptime_ms);
+        if (event.kind == kCrashRingState) {
+            std::string state(event.label, strnlen(event.label, sizeof(event.label)));
+            cJSON_AddStringToObject(item, "state", state.c_str());
+        } else {
+            char caller[12];
+            snprintf(caller, sizeof(caller), "0x%08lx", (unsigned long)event.caller);
+            cJSON_AddStringToObject(item, "schedule", caller);
+        }
+        cJSON_AddItemToArray(events, item);
+    }
+    cJSON_AddItemToObject(root, "events", events);
+
+    char* json = cJSON_PrintUnformatted(root);
+    report_ = json;
+    cJSON_free(json);
+    cJSON_Delete(root);
+}
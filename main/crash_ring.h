@@ -0,0 +1,41 @@
+#ifndef CRASH_RING_H
+#define CRASH_RING_H
+
+#include <cstdint>
+#include <string>
+
+#define CRASH_RING_SAMPLES CONFIG_CRASH_RING_SECONDS
+#define CRASH_RING_EVENTS 32
+#define CRASH_RING_LABEL_SIZE 12
+
+// 放在 RTC 的不初始化内存中的性能记录环，看门狗、panic 等异常复位后仍然保留
+// 每秒一条采样（堆、队列深度、最忙的任务），另有最近的状态切换和主循环执行的回调地址
+// 复位后 Initialize 把上一次的记录整理成 JSON，随下一次 Ota::CheckVersion 的 POST 上报，上报成功后清除
+// 回调地址可以用同一固件的 ELF（elf_sha256 在同一份 JSON 中）通过 addr2line 还原
+class CrashRing {
+public:
+    static CrashRing& GetInstance() {
+        static CrashRing instance;
+        return instance;
+    }
+
+    // 启动时尽早调用一次
+    void Initialize();
+    // 时钟定时器每秒调用
+    void Sample(uint32_t send_queue, uint32_t decode_queue);
+    void RecordState(const char* state);
+    // 主循环执行回调前调用，只做几次内存写入
+    void RecordSchedule(const void* caller);
+
+    // 上一次异常复位的记录，没有时为空
+    const std::string& report() const { return report_; }
+    void ClearReport() { report_.clear(); }
+
+private:
+    std::string report_;
+
+    CrashRing() = default;
+    void BuildReport(int reset_reason);
+};
+
+#endif // CRASH_RING_H
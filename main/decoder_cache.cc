@@ -0,0 +1,57 @@
+#include "decoder_cache.h"
+#include "metrics.h"
+
+#include <esp_log.h>
+
+#define TAG "DecoderCache"
+
+static MetricCounter metric_hits("decoder_cache.hits");
+static MetricCounter metric_misses("decoder_cache.misses");
+
+DecoderCache::Entry& DecoderCache::Get(int sample_rate, int frame_duration) {
+    if (current_ != nullptr && current_->decoder->sample_rate() == sample_rate &&
+        current_->decoder->duration_ms() == frame_duration) {
+        return *current_;
+    }
+
+    Entry* found = nullptr;
+    for (auto& entry : entries_) {
+        if (entry.decoder != nullptr && entry.decoder->sample_rate() == sample_rate &&
+            entry.decoder->duration_ms() == frame_duration) {
+            found = &entry;
+            break;
+        }
+    }
+
+    if (found != nullptr) {
+        metric_hits.Add();
+        // 上次用完时可能停在一段语音中间
+        found->decoder->ResetState();
+        if (found->resampler) {
+            found->resampler->Reset();
+        }
+    } else {
+        metric_misses.Add();
+        // 优先用空槽位，否则替换最久没用的
+        found = &entries_[0];
+        for (auto& entry : entries_) {
+            if (entry.decoder == nullptr) {
+                found = &entry;
+                break;
+            }
+            if (entry.last_used < found->last_used) {
+                found = &entry;
+            }
+        }
+        found->decoder = std::make_unique<OpusStreamDecoder>(sample_rate, 1, frame_duration);
+        found->resampler.reset();
+        if (sample_rate != output_sample_rate_) {
+            ESP_LOGI(TAG, "Resampling audio from %d to %d", sample_rate, output_sample_rate_);
+            found->resampler = std::make_unique<AudioResampler>();
+            found->resampler->Configure(sample_rate, output_sample_rate_);
+        }
+    }
+    found->last_used = ++clock_;
+    current_ = found;
+    return *found;
+}
@@ -0,0 +1,38 @@
+#ifndef DECODER_CACHE_H
+#define DECODER_CACHE_H
+
+#include "opus_codec.h"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+
+#include "audio_resampler.h"
+
+// 同时保留的解码参数组合数，常见的是服务器 TTS（24kHz/60ms）和 16kHz 的会话
+#define DECODER_CACHE_SLOTS 3
+
+// 按 (采样率, 帧长) 缓存 TTS 解码器和对应的输出重采样器
+// 参数切换时取出已有的实例并重置状态，不再销毁重建，也不重新设计重采样滤波器
+// 槽位用完时替换最久没用的一个；只在解码所在的任务中使用，不加锁
+class DecoderCache {
+public:
+    struct Entry {
+        std::unique_ptr<OpusStreamDecoder> decoder;
+        std::unique_ptr<AudioResampler> resampler;  // 采样率等于输出采样率时为 nullptr
+        uint32_t last_used = 0;
+    };
+
+    void Configure(int output_sample_rate) { output_sample_rate_ = output_sample_rate; }
+
+    // 返回对应参数的实例，和上一次返回的不同时会先重置解码器和重采样器的状态
+    Entry& Get(int sample_rate, int frame_duration);
+
+private:
+    std::array<Entry, DECODER_CACHE_SLOTS> entries_;
+    Entry* current_ = nullptr;
+    int output_sample_rate_ = 0;
+    uint32_t clock_ = 0;
+};
+
+#endif // DECODER_CACHE_H
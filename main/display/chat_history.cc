@@ -0,0 +1,124 @@
+#include "chat_history.h"
+
+#include <esp_heap_caps.h>
+#include <algorithm>
+#include <cstring>
+
+// 最多保存的记录数，序号位置表也放在 PSRAM 中
+#define CHAT_HISTORY_MAX_RECORDS 1024
+// 单条记录的文本上限，服务器的一句话远小于这个长度
+#define CHAT_HISTORY_MAX_TEXT 1024
+
+#define CHAT_RECORD_CONTINUATION 0x01
+
+ChatHistory::ChatHistory(size_t capacity) {
+    buffer_ = (uint8_t*)heap_caps_malloc(capacity, MALLOC_CAP_SPIRAM);
+    offsets_ = (uint32_t*)heap_caps_malloc(CHAT_HISTORY_MAX_RECORDS * sizeof(uint32_t), MALLOC_CAP_SPIRAM);
+    if (buffer_ == nullptr || offsets_ == nullptr) {
+        heap_caps_free(buffer_);
+        heap_caps_free(offsets_);
+        buffer_ = nullptr;
+        offsets_ = nullptr;
+        return;
+    }
+    capacity_ = capacity;
+}
+
+ChatHistory::~ChatHistory() {
+    heap_caps_free(buffer_);
+    heap_caps_free(offsets_);
+}
+
+// 存活的数据从最旧记录的位置开始，沿环到 tail_ 结束
+bool ChatHistory::Overlaps(size_t position, size_t size) const {
+    if (count() == 0) {
+        return false;
+    }
+    size_t oldest = offsets_[begin_ % CHAT_HISTORY_MAX_RECORDS];
+    if (oldest < tail_) {
+        return position < tail_ && position + size > oldest;
+    }
+    return position + size > oldest || position < tail_;
+}
+
+uint32_t ChatHistory::Append(uint8_t type, bool continuation, const char* text) {
+    if (!valid()) {
+        return end_;
+    }
+    size_t length = std::min<size_t>(strlen(text), std::min<size_t>(CHAT_HISTORY_MAX_TEXT, capacity_ / 2));
+    size_t size = (sizeof(Header) + length + 3) & ~size_t(3);
+    if (count() == 0) {
+        tail_ = 0;
+    }
+    // 到环末尾放不下时从头开始写，和新记录重叠的最旧记录被淘汰
+    size_t position = tail_ + size <= capacity_ ? tail_ : 0;
+    while (count() > 0 && (count() >= CHAT_HISTORY_MAX_RECORDS || Overlaps(position, size))) {
+        begin_++;
+    }
+
+    Header header = {static_cast<uint16_t>(length), type, static_cast<uint8_t>(continuation ? CHAT_RECORD_CONTINUATION : 0)};
+    memcpy(buffer_ + position, &header, sizeof(header));
+    memcpy(buffer_ + position + sizeof(header), text, length);
+    offsets_[end_ % CHAT_HISTORY_MAX_RECORDS] = position;
+    tail_ = position + size;
+    return end_++;
+}
+
+void ChatHistory::ReplaceLast(const char* text) {
+    if (count() == 0) {
+        return;
+    }
+    // 最后一条记录就在 tail_ 之前，去掉后重新写入
+    auto last = HeaderAt(end_ - 1);
+    uint8_t type = last->type;
+    bool continuation = last->flags & CHAT_RECORD_CONTINUATION;
+    end_--;
+    tail_ = offsets_[end_ % CHAT_HISTORY_MAX_RECORDS];
+    Append(type, continuation, text);
+}
+
+const ChatHistory::Header* ChatHistory::HeaderAt(uint32_t seq) const {
+    return reinterpret_cast<const Header*>(buffer_ + offsets_[seq % CHAT_HISTORY_MAX_RECORDS]);
+}
+
+bool ChatHistory::Get(uint32_t seq, Record& record) const {
+    if (seq < begin_ || seq >= end_) {
+        return false;
+    }
+    auto header = HeaderAt(seq);
+    record.type = header->type;
+    record.continuation = header->flags & CHAT_RECORD_CONTINUATION;
+    record.text.assign(reinterpret_cast<const char*>(header + 1), header->length);
+    return true;
+}
+
+// 气泡的第一条记录已经被淘汰时，最旧的一条当作第一条
+uint32_t ChatHistory::HeadOf(uint32_t seq) const {
+    while (seq > begin_ && (HeaderAt(seq)->flags & CHAT_RECORD_CONTINUATION)) {
+        seq--;
+    }
+    return seq;
+}
+
+bool ChatHistory::Previous(uint32_t head, uint32_t& previous) const {
+    if (head <= begin_ || head > end_) {
+        return false;
+    }
+    previous = HeadOf(head - 1);
+    return true;
+}
+
+bool ChatHistory::Next(uint32_t head, uint32_t& next) const {
+    // 这个气泡已经被淘汰，最旧的一条就是下一个气泡
+    if (head < begin_) {
+        next = begin_;
+        return begin_ < end_;
+    }
+    for (uint32_t seq = head + 1; seq < end_; seq++) {
+        if (!(HeaderAt(seq)->flags & CHAT_RECORD_CONTINUATION)) {
+            next = seq;
+            return true;
+        }
+    }
+    return false;
+}
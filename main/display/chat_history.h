@@ -0,0 +1,58 @@
+#ifndef CHAT_HISTORY_H
+#define CHAT_HISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 聊天记录的紧凑存储：PSRAM 中的字节环，每条记录是 4 字节头加文本，写不下时淘汰最旧的记录
+// 序号单调递增，begin() 到 end() 之间的记录可以按序号读取；同一轮回复中追加的句子标记为 continuation，
+// 和前面的记录属于同一个气泡。只在 LVGL 任务（持有显示锁）中使用，不加锁
+class ChatHistory {
+public:
+    struct Record {
+        uint8_t type = 0;
+        bool continuation = false;
+        std::string text;
+    };
+
+    // capacity 为字节环大小，PSRAM 不足时 valid() 为 false
+    explicit ChatHistory(size_t capacity);
+    ~ChatHistory();
+    ChatHistory(const ChatHistory&) = delete;
+    ChatHistory& operator=(const ChatHistory&) = delete;
+
+    bool valid() const { return buffer_ != nullptr; }
+    uint32_t Append(uint8_t type, bool continuation, const char* text);
+    // 替换最后一条记录的文本（折叠的系统消息），序号不变
+    void ReplaceLast(const char* text);
+    bool Get(uint32_t seq, Record& record) const;
+    // seq 所在气泡的第一条记录，和前一个、后一个气泡的第一条记录；没有时返回 false
+    uint32_t HeadOf(uint32_t seq) const;
+    bool Previous(uint32_t head, uint32_t& previous) const;
+    bool Next(uint32_t head, uint32_t& next) const;
+
+    uint32_t begin() const { return begin_; }
+    uint32_t end() const { return end_; }
+
+private:
+    struct Header {
+        uint16_t length;
+        uint8_t type;
+        uint8_t flags;
+    };
+
+    uint8_t* buffer_ = nullptr;
+    size_t capacity_ = 0;
+    // 每条记录在字节环中的位置，按序号取模
+    uint32_t* offsets_ = nullptr;
+    uint32_t begin_ = 0;
+    uint32_t end_ = 0;
+    size_t tail_ = 0;
+
+    size_t count() const { return end_ - begin_; }
+    const Header* HeaderAt(uint32_t seq) const;
+    bool Overlaps(size_t position, size_t size) const;
+};
+
+#endif // CHAT_HISTORY_H
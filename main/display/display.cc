@@ -1,5 +1,6 @@
 #include <esp_log.h>
 #include <esp_err.h>
+#include <esp_heap_caps.h>
 #include <string>
 #include <cstdlib>
 #include <cstring>
@@ -8,27 +9,21 @@
 #include "board.h"
 #include "application.h"
 #include "font_awesome_symbols.h"
+#include "emotions.h"
 #include "audio_codec.h"
 #include "settings.h"
+#include "timer_service.h"
 #include "assets/lang_config.h"
 
 #define TAG "Display"
 
 Display::Display() {
-    // Notification timer
-    esp_timer_create_args_t notification_timer_args = {
-        .callback = [](void *arg) {
-            Display *display = static_cast<Display*>(arg);
-            DisplayLockGuard lock(display);
-            lv_obj_add_flag(display->notification_label_, LV_OBJ_FLAG_HIDDEN);
-            lv_obj_clear_flag(display->status_label_, LV_OBJ_FLAG_HIDDEN);
-        },
-        .arg = this,
-        .dispatch_method = ESP_TIMER_TASK,
-        .name = "notification_timer",
-        .skip_unhandled_events = false,
-    };
-    ESP_ERROR_CHECK(esp_timer_create(&notification_timer_args, &notification_timer_));
+    // Notification timer，提示消失晚 100ms 不影响观感，可以和别的定时器合并唤醒
+    notification_timer_ = TimerService::GetInstance().Create("notification_timer", [this]() {
+        DisplayLockGuard lock(this);
+        lv_obj_add_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
+        lv_obj_clear_flag(status_label_, LV_OBJ_FLAG_HIDDEN);
+    }, 100);
 
     // Create a power management lock
     auto ret = esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "display_update", &pm_lock_);
@@ -40,10 +35,7 @@ Display::Display() {
 }
 
 Display::~Display() {
-    if (notification_timer_ != nullptr) {
-        esp_timer_stop(notification_timer_);
-        esp_timer_delete(notification_timer_);
-    }
+    TimerService::GetInstance().Stop(notification_timer_);
 
     if (network_label_ != nullptr) {
         lv_obj_del(network_label_);
@@ -66,9 +58,30 @@ void Display::SetStatus(const char* status) {
     if (status_label_ == nullptr) {
         return;
     }
-    lv_label_set_text(status_label_, status);
-    lv_obj_clear_flag(status_label_, LV_OBJ_FLAG_HIDDEN);
-    lv_obj_add_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
+    // 空闲时钟每次都会设置相同的文本，只有分钟变化时才需要重新布局和刷屏
+    SetLabelText(status_label_, status);
+    SetHidden(status_label_, false);
+    SetHidden(notification_label_, true);
+}
+
+bool Display::SetLabelText(lv_obj_t* label, const char* text) {
+    const char* current = lv_label_get_text(label);
+    if (current != nullptr && strcmp(current, text) == 0) {
+        return false;
+    }
+    lv_label_set_text(label, text);
+    return true;
+}
+
+void Display::SetHidden(lv_obj_t* obj, bool hidden) {
+    if (obj == nullptr || lv_obj_has_flag(obj, LV_OBJ_FLAG_HIDDEN) == hidden) {
+        return;
+    }
+    if (hidden) {
+        lv_obj_add_flag(obj, LV_OBJ_FLAG_HIDDEN);
+    } else {
+        lv_obj_clear_flag(obj, LV_OBJ_FLAG_HIDDEN);
+    }
 }
 
 void Display::ShowNotification(const std::string &notification, int duration_ms) {
@@ -84,8 +97,7 @@ void Display::ShowNotification(const char* notification, int duration_ms) {
     lv_obj_clear_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
     lv_obj_add_flag(status_label_, LV_OBJ_FLAG_HIDDEN);
 
-    esp_timer_stop(notification_timer_);
-    ESP_ERROR_CHECK(esp_timer_start_once(notification_timer_, duration_ms * 1000));
+    TimerService::GetInstance().StartOnce(notification_timer_, duration_ms);
 }
 
 void Display::UpdateStatusBar(bool update_all) {
@@ -108,12 +120,15 @@ void Display::UpdateStatusBar(bool update_all) {
         }
     }
 
-    esp_pm_lock_acquire(pm_lock_);
     // 更新电池图标
+    // APB 锁只在读取外设（电量计、4G 模组）期间持有，界面更新不需要
     int battery_level;
     bool charging, discharging;
     const char* icon = nullptr;
-    if (board.GetBatteryLevel(battery_level, charging, discharging)) {
+    esp_pm_lock_acquire(pm_lock_);
+    bool has_battery = board.GetBatteryLevel(battery_level, charging, discharging);
+    esp_pm_lock_release(pm_lock_);
+    if (has_battery) {
         if (charging) {
             icon = FONT_AWESOME_BATTERY_CHARGING;
         } else {
@@ -162,7 +177,9 @@ void Display::UpdateStatusBar(bool update_all) {
             kDeviceStateActivating,
         };
         if (std::find(allowed_states.begin(), allowed_states.end(), device_state) != allowed_states.end()) {
+            esp_pm_lock_acquire(pm_lock_);
             icon = board.GetNetworkStateIcon();
+            esp_pm_lock_release(pm_lock_);
             if (network_label_ != nullptr && icon != nullptr && network_icon_ != icon) {
                 DisplayLockGuard lock(this);
                 network_icon_ = icon;
@@ -170,57 +187,16 @@ void Display::UpdateStatusBar(bool update_all) {
             }
         }
     }
-
-    esp_pm_lock_release(pm_lock_);
 }
 
 
 void Display::SetEmotion(const char* emotion) {
-    struct Emotion {
-        const char* icon;
-        const char* text;
-    };
-
-    static const std::vector<Emotion> emotions = {
-        {FONT_AWESOME_EMOJI_NEUTRAL, "neutral"},
-        {FONT_AWESOME_EMOJI_HAPPY, "happy"},
-        {FONT_AWESOME_EMOJI_LAUGHING, "laughing"},
-        {FONT_AWESOME_EMOJI_FUNNY, "funny"},
-        {FONT_AWESOME_EMOJI_SAD, "sad"},
-        {FONT_AWESOME_EMOJI_ANGRY, "angry"},
-        {FONT_AWESOME_EMOJI_CRYING, "crying"},
-        {FONT_AWESOME_EMOJI_LOVING, "loving"},
-        {FONT_AWESOME_EMOJI_EMBARRASSED, "embarrassed"},
-        {FONT_AWESOME_EMOJI_SURPRISED, "surprised"},
-        {FONT_AWESOME_EMOJI_SHOCKED, "shocked"},
-        {FONT_AWESOME_EMOJI_THINKING, "thinking"},
-        {FONT_AWESOME_EMOJI_WINKING, "winking"},
-        {FONT_AWESOME_EMOJI_COOL, "cool"},
-        {FONT_AWESOME_EMOJI_RELAXED, "relaxed"},
-        {FONT_AWESOME_EMOJI_DELICIOUS, "delicious"},
-        {FONT_AWESOME_EMOJI_KISSY, "kissy"},
-        {FONT_AWESOME_EMOJI_CONFIDENT, "confident"},
-        {FONT_AWESOME_EMOJI_SLEEPY, "sleepy"},
-        {FONT_AWESOME_EMOJI_SILLY, "silly"},
-        {FONT_AWESOME_EMOJI_CONFUSED, "confused"}
-    };
-    
-    // 查找匹配的表情
-    std::string_view emotion_view(emotion);
-    auto it = std::find_if(emotions.begin(), emotions.end(),
-        [&emotion_view](const Emotion& e) { return e.text == emotion_view; });
-    
+    auto& info = GetEmotionInfo(FindEmotion(emotion));
     DisplayLockGuard lock(this);
     if (emotion_label_ == nullptr) {
         return;
     }
-
-    // 如果找到匹配的表情就显示对应图标，否则显示默认的neutral表情
-    if (it != emotions.end()) {
-        lv_label_set_text(emotion_label_, it->icon);
-    } else {
-        lv_label_set_text(emotion_label_, FONT_AWESOME_EMOJI_NEUTRAL);
-    }
+    SetLabelText(emotion_label_, info.icon);
 }
 
 void Display::SetIcon(const char* icon) {
@@ -235,6 +211,24 @@ void Display::SetPreviewImage(const lv_img_dsc_t* image) {
     // Do nothing
 }
 
+void Display::AdoptPreviewImage(PreviewImage* image) {
+    // 不保留图片的显示在 SetPreviewImage 返回后就可以释放
+    SetPreviewImage(image != nullptr ? &image->dsc : nullptr);
+    FreePreviewImage(image);
+}
+
+void Display::FreePreviewImage(PreviewImage* image) {
+    if (image == nullptr) {
+        return;
+    }
+    if (image->release) {
+        image->release();
+    } else {
+        heap_caps_free((void*)image->dsc.data);
+    }
+    delete image;
+}
+
 void Display::SetChatMessage(const char* role, const char* content) {
     DisplayLockGuard lock(this);
     if (chat_message_label_ == nullptr) {
@@ -6,14 +6,25 @@
 #include <esp_log.h>
 #include <esp_pm.h>
 
+#include <functional>
 #include <string>
 
+#include "stall_detector.h"
+#include "lock_profiler.h"
+
 struct DisplayFonts {
     const lv_font_t* text_font = nullptr;
     const lv_font_t* icon_font = nullptr;
     const lv_font_t* emoji_font = nullptr;
 };
 
+// 交给显示接管的预览图，显示不再引用时调用 release 归还数据，release 为空时用 heap_caps_free 释放 data
+// release 可能在持有显示锁时调用，不能再去获取其它锁
+struct PreviewImage {
+    lv_img_dsc_t dsc;
+    std::function<void()> release;
+};
+
 class Display {
 public:
     Display();
@@ -24,11 +35,22 @@ public:
     virtual void ShowNotification(const std::string &notification, int duration_ms = 3000);
     virtual void SetEmotion(const char* emotion);
     virtual void SetChatMessage(const char* role, const char* content);
+    // 把同一轮回复的下一句接在当前消息后面；只显示最新一句的界面直接替换，开销本来就只和这一句有关
+    virtual void AppendChatMessage(const char* role, const char* content) { SetChatMessage(role, content); }
     virtual void SetIcon(const char* icon);
     virtual void SetPreviewImage(const lv_img_dsc_t* image);
+    // 接管 new 分配的预览图，省去一次整帧拷贝，不再使用时由显示释放；nullptr 表示不再显示当前的预览
+    virtual void AdoptPreviewImage(PreviewImage* image);
     virtual void SetTheme(const std::string& theme_name);
     virtual std::string GetTheme() { return current_theme_name_; }
     virtual void UpdateStatusBar(bool update_all = false);
+    // 对话中提高刷新频率；空闲或省电模式下没有界面更新时暂停 LVGL 任务
+    virtual void SetRefreshActive(bool active) {}
+    virtual void SetSleeping(bool sleeping) {}
+    // 过热时降低刷新频率
+    virtual void SetThrottled(bool throttled) {}
+    // 内存紧张时释放可以重建的缓存
+    virtual void SetLowMemory(bool low_memory) {}
 
     inline int width() const { return width_; }
     inline int height() const { return height_; }
@@ -55,7 +77,12 @@ protected:
     bool muted_ = false;
     std::string current_theme_name_;
 
-    esp_timer_handle_t notification_timer_ = nullptr;
+    int notification_timer_ = -1;
+
+    // 内容或状态没有变化时不调用 LVGL，避免无效的重新布局和刷屏，需要在持有显示锁时调用
+    static bool SetLabelText(lv_obj_t* label, const char* text);
+    static void FreePreviewImage(PreviewImage* image);
+    static void SetHidden(lv_obj_t* obj, bool hidden);
 
     friend class DisplayLockGuard;
     virtual bool Lock(int timeout_ms = 0) = 0;
@@ -66,11 +93,30 @@ protected:
 class DisplayLockGuard {
 public:
     DisplayLockGuard(Display *display) : display_(display) {
+#if CONFIG_STALL_DETECTOR || CONFIG_LOCK_PROFILER
+        int64_t start = esp_timer_get_time();
+#endif
+#if CONFIG_LOCK_PROFILER
+        TaskHandle_t holder;
+        const void* holder_site;
+        LockProfiler::BeginWait(kLockDisplay, holder, holder_site);
+#endif
         if (!display_->Lock(30000)) {
             ESP_LOGE("Display", "Failed to lock display");
         }
+#if CONFIG_LOCK_PROFILER
+        uint32_t wait_us = esp_timer_get_time() - start;
+        if (wait_us >= LOCK_PROFILER_CONTENDED_US) {
+            LockProfiler::OnContended(kLockDisplay, __builtin_return_address(0), wait_us, holder, holder_site);
+        }
+        LockProfiler::OnAcquired(kLockDisplay, __builtin_return_address(0));
+#endif
+#if CONFIG_STALL_DETECTOR
+        StallDetector::Record(kStallLoopDisplay, "DisplayLockGuard", __builtin_return_address(0), esp_timer_get_time() - start);
+#endif
     }
     ~DisplayLockGuard() {
+        LockProfiler::OnReleased(kLockDisplay);
         display_->Unlock();
     }
 
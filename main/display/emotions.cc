@@ -0,0 +1,66 @@
+#include "emotions.h"
+#include "font_awesome_symbols.h"
+
+#include <cstring>
+
+static const EmotionInfo kEmotions[kEmotionCount] = {
+    {"neutral", "😶", FONT_AWESOME_EMOJI_NEUTRAL},
+    {"happy", "🙂", FONT_AWESOME_EMOJI_HAPPY},
+    {"laughing", "😆", FONT_AWESOME_EMOJI_LAUGHING},
+    {"funny", "😂", FONT_AWESOME_EMOJI_FUNNY},
+    {"sad", "😔", FONT_AWESOME_EMOJI_SAD},
+    {"angry", "😠", FONT_AWESOME_EMOJI_ANGRY},
+    {"crying", "😭", FONT_AWESOME_EMOJI_CRYING},
+    {"loving", "😍", FONT_AWESOME_EMOJI_LOVING},
+    {"embarrassed", "😳", FONT_AWESOME_EMOJI_EMBARRASSED},
+    {"surprised", "😯", FONT_AWESOME_EMOJI_SURPRISED},
+    {"shocked", "😱", FONT_AWESOME_EMOJI_SHOCKED},
+    {"thinking", "🤔", FONT_AWESOME_EMOJI_THINKING},
+    {"winking", "😉", FONT_AWESOME_EMOJI_WINKING},
+    {"cool", "😎", FONT_AWESOME_EMOJI_COOL},
+    {"relaxed", "😌", FONT_AWESOME_EMOJI_RELAXED},
+    {"delicious", "🤤", FONT_AWESOME_EMOJI_DELICIOUS},
+    {"kissy", "😘", FONT_AWESOME_EMOJI_KISSY},
+    {"confident", "😏", FONT_AWESOME_EMOJI_CONFIDENT},
+    {"sleepy", "😴", FONT_AWESOME_EMOJI_SLEEPY},
+    {"silly", "😜", FONT_AWESOME_EMOJI_SILLY},
+    {"confused", "🙄", FONT_AWESOME_EMOJI_CONFUSED},
+};
+
+Emotion FindEmotion(const char* name) {
+    if (name == nullptr) {
+        return kEmotionNeutral;
+    }
+    // 两个名字的哈希相同时编译报重复的 case
+    Emotion emotion;
+    switch (EmotionHash(name)) {
+        case EmotionHash("neutral"): emotion = kEmotionNeutral; break;
+        case EmotionHash("happy"): emotion = kEmotionHappy; break;
+        case EmotionHash("laughing"): emotion = kEmotionLaughing; break;
+        case EmotionHash("funny"): emotion = kEmotionFunny; break;
+        case EmotionHash("sad"): emotion = kEmotionSad; break;
+        case EmotionHash("angry"): emotion = kEmotionAngry; break;
+        case EmotionHash("crying"): emotion = kEmotionCrying; break;
+        case EmotionHash("loving"): emotion = kEmotionLoving; break;
+        case EmotionHash("embarrassed"): emotion = kEmotionEmbarrassed; break;
+        case EmotionHash("surprised"): emotion = kEmotionSurprised; break;
+        case EmotionHash("shocked"): emotion = kEmotionShocked; break;
+        case EmotionHash("thinking"): emotion = kEmotionThinking; break;
+        case EmotionHash("winking"): emotion = kEmotionWinking; break;
+        case EmotionHash("cool"): emotion = kEmotionCool; break;
+        case EmotionHash("relaxed"): emotion = kEmotionRelaxed; break;
+        case EmotionHash("delicious"): emotion = kEmotionDelicious; break;
+        case EmotionHash("kissy"): emotion = kEmotionKissy; break;
+        case EmotionHash("confident"): emotion = kEmotionConfident; break;
+        case EmotionHash("sleepy"): emotion = kEmotionSleepy; break;
+        case EmotionHash("silly"): emotion = kEmotionSilly; break;
+        case EmotionHash("confused"): emotion = kEmotionConfused; break;
+        default: return kEmotionNeutral;
+    }
+    // 未知的名字碰巧和某个表情哈希相同时按未知处理
+    return strcmp(kEmotions[emotion].name, name) == 0 ? emotion : kEmotionNeutral;
+}
+
+const EmotionInfo& GetEmotionInfo(Emotion emotion) {
+    return kEmotions[emotion < kEmotionCount ? emotion : kEmotionNeutral];
+}
@@ -0,0 +1,51 @@
+#ifndef EMOTIONS_H
+#define EMOTIONS_H
+
+#include <cstdint>
+
+// 服务器下发的表情，顺序和 GetEmotionInfo 的表一致
+enum Emotion : uint8_t {
+    kEmotionNeutral,
+    kEmotionHappy,
+    kEmotionLaughing,
+    kEmotionFunny,
+    kEmotionSad,
+    kEmotionAngry,
+    kEmotionCrying,
+    kEmotionLoving,
+    kEmotionEmbarrassed,
+    kEmotionSurprised,
+    kEmotionShocked,
+    kEmotionThinking,
+    kEmotionWinking,
+    kEmotionCool,
+    kEmotionRelaxed,
+    kEmotionDelicious,
+    kEmotionKissy,
+    kEmotionConfident,
+    kEmotionSleepy,
+    kEmotionSilly,
+    kEmotionConfused,
+    kEmotionCount
+};
+
+struct EmotionInfo {
+    const char* name;
+    const char* emoji;  // emoji 字体中的字符
+    const char* icon;   // Font Awesome 中的表情图标
+};
+
+// 名字的 FNV-1a 哈希，case 标签在编译时计算
+constexpr uint32_t EmotionHash(const char* name) {
+    uint32_t hash = 2166136261u;
+    while (*name != '\0') {
+        hash = (hash ^ (uint8_t)*name++) * 16777619u;
+    }
+    return hash;
+}
+
+// 按哈希跳转查找，不再逐个比较名字；没有匹配的表情返回 kEmotionNeutral
+Emotion FindEmotion(const char* name);
+const EmotionInfo& GetEmotionInfo(Emotion emotion);
+
+#endif // EMOTIONS_H
@@ -1,70 +1,31 @@
-#include "otto_emoji_display.h"
+#include "gif_emotion_display.h"
 
+#if LV_USE_GIF
 #include <esp_log.h>
 
-#include <algorithm>
 #include <cstring>
 #include <string>
 
-#include "display/lcd_display.h"
 #include "font_awesome_symbols.h"
 
-#define TAG "OttoEmojiDisplay"
-
-// 表情映射表 - 将原版21种表情映射到现有6个GIF
-const OttoEmojiDisplay::EmotionMap OttoEmojiDisplay::emotion_maps_[] = {
-    // 中性/平静类表情 -> staticstate
-    {"neutral", &staticstate},
-    {"relaxed", &staticstate},
-    {"sleepy", &staticstate},
-
-    // 积极/开心类表情 -> happy
-    {"happy", &happy},
-    {"laughing", &happy},
-    {"funny", &happy},
-    {"loving", &happy},
-    {"confident", &happy},
-    {"winking", &happy},
-    {"cool", &happy},
-    {"delicious", &happy},
-    {"kissy", &happy},
-    {"silly", &happy},
-
-    // 悲伤类表情 -> sad
-    {"sad", &sad},
-    {"crying", &sad},
-
-    // 愤怒类表情 -> anger
-    {"angry", &anger},
-
-    // 惊讶类表情 -> scare
-    {"surprised", &scare},
-    {"shocked", &scare},
-
-    // 思考/困惑类表情 -> buxue
-    {"thinking", &buxue},
-    {"confused", &buxue},
-    {"embarrassed", &buxue},
-
-    {nullptr, nullptr}  // 结束标记
-};
-
-OttoEmojiDisplay::OttoEmojiDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
-                                   int width, int height, int offset_x, int offset_y, bool mirror_x,
-                                   bool mirror_y, bool swap_xy, DisplayFonts fonts)
+#define TAG "GifEmotionDisplay"
+
+GifEmotionDisplay::GifEmotionDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
+                                     int width, int height, int offset_x, int offset_y, bool mirror_x,
+                                     bool mirror_y, bool swap_xy, DisplayFonts fonts,
+                                     const GifEmotion* emotions, GifFrameBudget budget)
     : SpiLcdDisplay(panel_io, panel, width, height, offset_x, offset_y, mirror_x, mirror_y, swap_xy,
                     fonts),
-      emotion_gif_(nullptr) {
+      emotions_(emotions), budget_(budget) {
     SetupGifContainer();
-};
+}
 
-void OttoEmojiDisplay::SetupGifContainer() {
+void GifEmotionDisplay::SetupGifContainer() {
     DisplayLockGuard lock(this);
 
     if (emotion_label_) {
         lv_obj_del(emotion_label_);
     }
-
     if (chat_message_label_) {
         lv_obj_del(chat_message_label_);
     }
@@ -92,7 +53,7 @@ void OttoEmojiDisplay::SetupGifContainer() {
     lv_obj_set_style_border_width(emotion_gif_, 0, 0);
     lv_obj_set_style_bg_opa(emotion_gif_, LV_OPA_TRANSP, 0);
     lv_obj_center(emotion_gif_);
-    lv_gif_set_src(emotion_gif_, &staticstate);
+    SetGif(emotions_[0].gif);
 
     chat_message_label_ = lv_label_create(content_);
     lv_label_set_text(chat_message_label_, "");
@@ -111,26 +72,54 @@ void OttoEmojiDisplay::SetupGifContainer() {
     LcdDisplay::SetTheme("dark");
 }
 
-void OttoEmojiDisplay::SetEmotion(const char* emotion) {
+void GifEmotionDisplay::SetGif(const lv_image_dsc_t* gif) {
+    // 相同的动画继续播放，不重新打开和解码第一帧
+    if (gif == current_gif_) {
+        return;
+    }
+    current_gif_ = gif;
+    lv_gif_set_src(emotion_gif_, gif);
+    ApplyFrameBudget();
+}
+
+// lv_gif 的定时器每个周期最多前进一帧，定时器周期就是动画的最小帧间隔
+void GifEmotionDisplay::ApplyFrameBudget() {
+    auto gif = reinterpret_cast<lv_gif_t*>(emotion_gif_);
+    if (gif == nullptr || gif->timer == nullptr) {
+        return;
+    }
+    lv_timer_set_period(gif->timer, audio_busy_ ? budget_.busy_frame_ms : budget_.frame_ms);
+}
+
+void GifEmotionDisplay::SetRefreshActive(bool active) {
+#if CONFIG_DISPLAY_ADAPTIVE_REFRESH
+    SpiLcdDisplay::SetRefreshActive(active);
+#endif
+    DisplayLockGuard lock(this);
+    audio_busy_ = active;
+    ApplyFrameBudget();
+}
+
+void GifEmotionDisplay::SetEmotion(const char* emotion) {
     if (!emotion || !emotion_gif_) {
         return;
     }
 
     DisplayLockGuard lock(this);
 
-    for (const auto& map : emotion_maps_) {
-        if (map.name && strcmp(map.name, emotion) == 0) {
-            lv_gif_set_src(emotion_gif_, map.gif);
+    for (auto map = emotions_; map->name != nullptr; map++) {
+        if (strcmp(map->name, emotion) == 0) {
+            SetGif(map->gif);
             ESP_LOGI(TAG, "设置表情: %s", emotion);
             return;
         }
     }
 
-    lv_gif_set_src(emotion_gif_, &staticstate);
+    SetGif(emotions_[0].gif);
     ESP_LOGI(TAG, "未知表情'%s'，使用默认", emotion);
 }
 
-void OttoEmojiDisplay::SetChatMessage(const char* role, const char* content) {
+void GifEmotionDisplay::SetChatMessage(const char* role, const char* content) {
     DisplayLockGuard lock(this);
     if (chat_message_label_ == nullptr) {
         return;
@@ -147,7 +136,7 @@ void OttoEmojiDisplay::SetChatMessage(const char* role, const char* content) {
     ESP_LOGI(TAG, "设置聊天消息 [%s]: %s", role, content);
 }
 
-void OttoEmojiDisplay::SetIcon(const char* icon) {
+void GifEmotionDisplay::SetIcon(const char* icon) {
     if (!icon) {
         return;
     }
@@ -169,3 +158,4 @@ void OttoEmojiDisplay::SetIcon(const char* icon) {
         ESP_LOGI(TAG, "设置图标: %s", icon);
     }
 }
+#endif // LV_USE_GIF
@@ -0,0 +1,48 @@
+#ifndef GIF_EMOTION_DISPLAY_H
+#define GIF_EMOTION_DISPLAY_H
+
+#include "lcd_display.h"
+
+#if LV_USE_GIF
+#include <libs/gif/lv_gif.h>
+
+// 表情名到 GIF 的映射，以 {nullptr, nullptr} 结尾，第一项作为未知表情的默认动画
+struct GifEmotion {
+    const char* name;
+    const lv_image_dsc_t* gif;
+};
+
+// 动画帧间隔，按板子的 CPU 余量设置
+// 对话中 Opus 编解码和 LVGL 争用 CPU，动画放慢到 busy_frame_ms，GIF 帧是增量编码，只能放慢不能跳帧
+struct GifFrameBudget {
+    int frame_ms = 30;
+    int busy_frame_ms = 80;
+};
+
+// GIF 表情屏幕：整个内容区显示表情动画，底部叠加一行聊天消息
+class GifEmotionDisplay : public SpiLcdDisplay {
+public:
+    GifEmotionDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
+                      int width, int height, int offset_x, int offset_y, bool mirror_x,
+                      bool mirror_y, bool swap_xy, DisplayFonts fonts,
+                      const GifEmotion* emotions, GifFrameBudget budget = {});
+
+    virtual void SetEmotion(const char* emotion) override;
+    virtual void SetChatMessage(const char* role, const char* content) override;
+    virtual void SetIcon(const char* icon) override;
+    virtual void SetRefreshActive(bool active) override;
+
+private:
+    const GifEmotion* emotions_;
+    GifFrameBudget budget_;
+    lv_obj_t* emotion_gif_ = nullptr;
+    const lv_image_dsc_t* current_gif_ = nullptr;
+    bool audio_busy_ = false;
+
+    void SetupGifContainer();
+    void SetGif(const lv_image_dsc_t* gif);
+    void ApplyFrameBudget();
+};
+
+#endif // LV_USE_GIF
+#endif // GIF_EMOTION_DISPLAY_H
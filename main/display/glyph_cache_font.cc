@@ -0,0 +1,112 @@
+#include "glyph_cache_font.h"
+#include "heap_accounting.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <cstring>
+
+#define TAG "GlyphCache"
+
+GlyphCacheFont::GlyphCacheFont(const lv_font_t* base, size_t budget_bytes) : base_(base), budget_(budget_bytes) {
+    font_ = *base;
+    font_.get_glyph_dsc = GetGlyphDsc;
+    font_.get_glyph_bitmap = GetGlyphBitmap;
+    font_.user_data = this;
+    ESP_LOGI(TAG, "Glyph cache enabled, budget %u KB", budget_ / 1024);
+}
+
+GlyphCacheFont::~GlyphCacheFont() {
+    for (auto& entry : lru_) {
+        HeapAccounting::Free(kHeapTagDisplay, entry.data);
+    }
+}
+
+bool GlyphCacheFont::GetGlyphDsc(const lv_font_t* font, lv_font_glyph_dsc_t* dsc, uint32_t letter, uint32_t letter_next) {
+    auto self = static_cast<const GlyphCacheFont*>(font->user_data);
+    return self->base_->get_glyph_dsc(self->base_, dsc, letter, letter_next);
+}
+
+const void* GlyphCacheFont::GetGlyphBitmap(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf) {
+    auto self = static_cast<GlyphCacheFont*>(dsc->resolved_font->user_data);
+    return self->GetBitmap(dsc, draw_buf);
+}
+
+const void* GlyphCacheFont::GetBitmap(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf) {
+    uint32_t glyph_index = dsc->gid.index;
+    if (draw_buf != nullptr) {
+        auto it = index_.find(glyph_index);
+        if (it != index_.end()) {
+            auto& entry = *it->second;
+            // 绘制缓冲区已按字形大小调整过，步长不一致时按未命中处理
+            if (entry.stride == draw_buf->header.stride && entry.size <= draw_buf->data_size) {
+                memcpy(draw_buf->data, entry.data, entry.size);
+                lru_.splice(lru_.begin(), lru_, it->second);
+                hits_++;
+                return draw_buf;
+            }
+        }
+    }
+
+    // 原字体从 resolved_font 取字体数据
+    dsc->resolved_font = base_;
+    const void* bitmap = base_->get_glyph_bitmap(dsc, draw_buf);
+    dsc->resolved_font = &font_;
+    misses_++;
+
+    // 只缓存解码到绘制缓冲区的字形，直接指向字体数据的位图没有解码开销
+    if (bitmap != nullptr && bitmap == draw_buf) {
+        uint32_t size = draw_buf->header.stride * dsc->box_h;
+        if (size > 0 && size <= draw_buf->data_size) {
+            Insert(glyph_index, draw_buf, size);
+        }
+    }
+    return bitmap;
+}
+
+void GlyphCacheFont::Insert(uint32_t glyph_index, const lv_draw_buf_t* draw_buf, uint32_t size) {
+    if (suspended_ || size > budget_ / 4) {
+        return;
+    }
+    auto it = index_.find(glyph_index);
+    if (it != index_.end()) {
+        used_ -= it->second->size;
+        HeapAccounting::Free(kHeapTagDisplay, it->second->data);
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+    while (used_ + size > budget_ && !lru_.empty()) {
+        EvictOne();
+    }
+
+    auto data = (uint8_t*)HeapAccounting::Malloc(kHeapTagDisplay, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (data == nullptr) {
+        return;
+    }
+    memcpy(data, draw_buf->data, size);
+    lru_.push_front({glyph_index, draw_buf->header.stride, size, data});
+    index_[glyph_index] = lru_.begin();
+    used_ += size;
+}
+
+void GlyphCacheFont::EvictOne() {
+    auto& entry = lru_.back();
+    used_ -= entry.size;
+    HeapAccounting::Free(kHeapTagDisplay, entry.data);
+    index_.erase(entry.glyph_index);
+    lru_.pop_back();
+}
+
+void GlyphCacheFont::SetSuspended(bool suspended) {
+    suspended_ = suspended;
+    if (suspended) {
+        while (!lru_.empty()) {
+            EvictOne();
+        }
+    }
+}
+
+void GlyphCacheFont::LogStats() const {
+    uint32_t total = hits_ + misses_;
+    ESP_LOGI(TAG, "Glyphs: %u cached, %u/%u KB, hit rate %lu%% (%lu/%lu)", lru_.size(), used_ / 1024, budget_ / 1024,
+        total > 0 ? hits_ * 100 / total : 0, hits_, total);
+}
@@ -0,0 +1,57 @@
+#ifndef GLYPH_CACHE_FONT_H
+#define GLYPH_CACHE_FONT_H
+
+#include <lvgl.h>
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+
+// 带字形缓存的字体
+// 包装一个 lv_font_fmt_txt 字体，解码（解压、转换为 A8）后的字形位图按 LRU 缓存在 PSRAM 中，
+// 屏幕刷新时重复出现的汉字不必每次从 flash 中重新解码。只在 LVGL 渲染任务中使用，不加锁
+class GlyphCacheFont {
+public:
+    GlyphCacheFont(const lv_font_t* base, size_t budget_bytes);
+    ~GlyphCacheFont();
+    GlyphCacheFont(const GlyphCacheFont&) = delete;
+    GlyphCacheFont& operator=(const GlyphCacheFont&) = delete;
+
+    // 交给 LVGL 使用的字体，行高、基线和 fallback 与原字体相同
+    const lv_font_t* font() const { return &font_; }
+
+    uint32_t hits() const { return hits_; }
+    uint32_t misses() const { return misses_; }
+    size_t used() const { return used_; }
+    void LogStats() const;
+    // 内存紧张时清空缓存并停止缓存新字形，恢复后重新按需缓存
+    void SetSuspended(bool suspended);
+
+private:
+    struct Entry {
+        uint32_t glyph_index;
+        uint32_t stride;
+        uint32_t size;
+        uint8_t* data;
+    };
+
+    const lv_font_t* base_;
+    lv_font_t font_;
+    size_t budget_;
+    size_t used_ = 0;
+    bool suspended_ = false;
+    uint32_t hits_ = 0;
+    uint32_t misses_ = 0;
+    // 链表头部是最近使用的字形
+    std::list<Entry> lru_;
+    std::unordered_map<uint32_t, std::list<Entry>::iterator> index_;
+
+    const void* GetBitmap(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf);
+    void Insert(uint32_t glyph_index, const lv_draw_buf_t* draw_buf, uint32_t size);
+    void EvictOne();
+
+    static bool GetGlyphDsc(const lv_font_t* font, lv_font_glyph_dsc_t* dsc, uint32_t letter, uint32_t letter_next);
+    static const void* GetGlyphBitmap(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf);
+};
+
+#endif // GLYPH_CACHE_FONT_H
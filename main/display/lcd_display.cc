@@ -7,11 +7,18 @@
 #include <esp_err.h>
 #include <esp_lvgl_port.h>
 #include <esp_heap_caps.h>
+#include <esp_timer.h>
 #include "assets/lang_config.h"
 #include <cstring>
 #include "settings.h"
+#include "memory_placement.h"
+#include "task_manifest.h"
+#include "performance_profile.h"
 
 #include "board.h"
+#if CONFIG_USE_ASSETS_PARTITION
+#include "assets_partition.h"
+#endif
 
 #define TAG "LcdDisplay"
 
@@ -72,6 +79,14 @@ LcdDisplay::LcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_
     width_ = width;
     height_ = height;
 
+#if CONFIG_DISPLAY_GLYPH_CACHE
+    // 正文字体的字形解码后缓存在 PSRAM 中，图标字体字形少，不需要缓存
+    if (fonts_.text_font != nullptr && heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0) {
+        text_font_cache_ = std::make_unique<GlyphCacheFont>(fonts_.text_font, CONFIG_DISPLAY_GLYPH_CACHE_SIZE * 1024);
+        fonts_.text_font = text_font_cache_->font();
+    }
+#endif
+
     // Load theme from settings
     Settings settings("display", false);
     current_theme_name_ = settings.GetString("theme", "light");
@@ -84,10 +99,24 @@ LcdDisplay::LcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_
     }
 }
 
+// PSRAM 争用严重时，内部 DMA 内存够用就把绘制缓冲区放回内部 RAM，直接从绘制缓冲区发送
+static void ApplyPlacement(LcdBufferProfile& profile, int width, int height) {
+    if (!profile.spiram || profile.direct_mode) {
+        return;
+    }
+    size_t bytes = (size_t)width * std::min(profile.buffer_lines, height) * 2 * (profile.double_buffer ? 2 : 1);
+    if (MemoryPlacement::GetInstance().PreferInternal(kMemoryUseLcd, bytes)) {
+        ESP_LOGI(TAG, "PSRAM contended, draw buffer moved to DMA RAM (%u bytes)", (unsigned)bytes);
+        profile.spiram = false;
+        profile.trans_lines = 0;
+    }
+}
+
 SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
                            int width, int height, int offset_x, int offset_y, bool mirror_x, bool mirror_y, bool swap_xy,
-                           DisplayFonts fonts)
+                           DisplayFonts fonts, LcdBufferProfile profile)
     : LcdDisplay(panel_io, panel, fonts, width, height) {
+    ApplyPlacement(profile, width_, height_);
 
     // draw white
     std::vector<uint16_t> buffer(width_, 0xFFFF);
@@ -104,18 +133,22 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
 
     ESP_LOGI(TAG, "Initialize LVGL port");
     lvgl_port_cfg_t port_cfg = ESP_LVGL_PORT_INIT_CONFIG();
-    port_cfg.task_priority = 1;
+    auto& lvgl_spec = TaskManifest::GetInstance().Get(kTaskLvgl);
+    port_cfg.task_priority = lvgl_spec.priority;
+    port_cfg.task_affinity = lvgl_spec.core;
     port_cfg.timer_period_ms = 50;
     lvgl_port_init(&port_cfg);
 
-    ESP_LOGI(TAG, "Adding LCD display");
+    int buffer_lines = std::min(profile.buffer_lines, height_);
+    ESP_LOGI(TAG, "Adding LCD display, draw buffer %d lines x%d in %s, trans %d lines", buffer_lines,
+        profile.double_buffer ? 2 : 1, profile.spiram ? "PSRAM" : "DMA RAM", profile.trans_lines);
     const lvgl_port_display_cfg_t display_cfg = {
         .io_handle = panel_io_,
         .panel_handle = panel_,
         .control_handle = nullptr,
-        .buffer_size = static_cast<uint32_t>(width_ * 20),
-        .double_buffer = false,
-        .trans_size = 0,
+        .buffer_size = static_cast<uint32_t>(width_ * buffer_lines),
+        .double_buffer = profile.double_buffer,
+        .trans_size = static_cast<uint32_t>(width_ * profile.trans_lines),
         .hres = static_cast<uint32_t>(width_),
         .vres = static_cast<uint32_t>(height_),
         .monochrome = false,
@@ -126,8 +159,8 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         },
         .color_format = LV_COLOR_FORMAT_RGB565,
         .flags = {
-            .buff_dma = 1,
-            .buff_spiram = 0,
+            .buff_dma = !profile.spiram,
+            .buff_spiram = profile.spiram,
             .sw_rotate = 0,
             .swap_bytes = 1,
             .full_refresh = 0,
@@ -166,7 +199,9 @@ RgbLcdDisplay::RgbLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
 
     ESP_LOGI(TAG, "Initialize LVGL port");
     lvgl_port_cfg_t port_cfg = ESP_LVGL_PORT_INIT_CONFIG();
-    port_cfg.task_priority = 1;
+    auto& lvgl_spec = TaskManifest::GetInstance().Get(kTaskLvgl);
+    port_cfg.task_priority = lvgl_spec.priority;
+    port_cfg.task_affinity = lvgl_spec.core;
     port_cfg.timer_period_ms = 50;
     lvgl_port_init(&port_cfg);
 
@@ -214,7 +249,7 @@ RgbLcdDisplay::RgbLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
 MipiLcdDisplay::MipiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
                             int width, int height,  int offset_x, int offset_y,
                             bool mirror_x, bool mirror_y, bool swap_xy,
-                            DisplayFonts fonts)
+                            DisplayFonts fonts, LcdBufferProfile profile)
     : LcdDisplay(panel_io, panel, fonts, width, height) {
 
     // Set the display to on
@@ -226,15 +261,28 @@ MipiLcdDisplay::MipiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel
 
     ESP_LOGI(TAG, "Initialize LVGL port");
     lvgl_port_cfg_t port_cfg = ESP_LVGL_PORT_INIT_CONFIG();
+    auto& lvgl_spec = TaskManifest::GetInstance().Get(kTaskLvgl);
+    port_cfg.task_priority = lvgl_spec.priority;
+    port_cfg.task_affinity = lvgl_spec.core;
     lvgl_port_init(&port_cfg);
 
-    ESP_LOGI(TAG, "Adding LCD display");
+    ApplyPlacement(profile, width_, height_);
+    // 直通模式下 LVGL 的两块缓冲区就是 DPI 面板的帧缓冲区，面板必须按 MIPI_DPI_FRAME_BUFFERS 创建
+    bool direct = profile.direct_mode && MIPI_DPI_FRAME_BUFFERS > 1 && !swap_xy;
+    int buffer_lines = direct ? height_ : std::min(profile.buffer_lines, height_);
+    if (direct) {
+        ESP_LOGI(TAG, "Adding LCD display, direct mode with %d frame buffers", MIPI_DPI_FRAME_BUFFERS);
+    } else {
+        ESP_LOGI(TAG, "Adding LCD display, draw buffer %d lines x%d in %s", buffer_lines,
+            profile.double_buffer ? 2 : 1, profile.spiram ? "PSRAM" : "DMA RAM");
+    }
     const lvgl_port_display_cfg_t disp_cfg = {
             .io_handle = panel_io,
             .panel_handle = panel,
             .control_handle = nullptr,
-            .buffer_size = static_cast<uint32_t>(width_ * 50),
-            .double_buffer = false,
+            .buffer_size = static_cast<uint32_t>(width_ * buffer_lines),
+            .double_buffer = direct || profile.double_buffer,
+            .trans_size = direct ? 0 : static_cast<uint32_t>(width_ * profile.trans_lines),
             .hres = static_cast<uint32_t>(width_),
             .vres = static_cast<uint32_t>(height_),
             .monochrome = false,
@@ -245,15 +293,17 @@ MipiLcdDisplay::MipiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel
             .mirror_y = mirror_y,
         },
         .flags = {
-            .buff_dma = true,
-            .buff_spiram =false,
+            .buff_dma = !direct && !profile.spiram,
+            .buff_spiram = !direct && profile.spiram,
             .sw_rotate = false,
+            .direct_mode = direct,
         },
     };
 
+    // avoid_tearing 时 lvgl_port 直接使用面板的帧缓冲区，每次刷新结束后切换扫描输出的缓冲区
     const lvgl_port_display_dsi_cfg_t dpi_cfg = {
         .flags = {
-            .avoid_tearing = false,
+            .avoid_tearing = direct,
         }
     };
     display_ = lvgl_port_add_disp_dsi(&disp_cfg, &dpi_cfg);
@@ -270,6 +320,12 @@ MipiLcdDisplay::MipiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel
 }
 
 LcdDisplay::~LcdDisplay() {
+#if CONFIG_DISPLAY_ADAPTIVE_REFRESH
+    if (refresh_timer_ != nullptr) {
+        esp_timer_stop(refresh_timer_);
+        esp_timer_delete(refresh_timer_);
+    }
+#endif
     // 然后再清理 LVGL 对象
     if (content_ != nullptr) {
         lv_obj_del(content_);
@@ -283,6 +339,19 @@ LcdDisplay::~LcdDisplay() {
     if (container_ != nullptr) {
         lv_obj_del(container_);
     }
+#if !CONFIG_USE_WECHAT_MESSAGE_STYLE
+    FreePreviewImage(adopted_preview_);
+#endif
+    if (theme_styles_ready_) {
+        lv_obj_remove_style(lv_screen_active(), &theme_styles_.surface, 0);
+        lv_style_reset(&theme_styles_.surface);
+        lv_style_reset(&theme_styles_.content);
+        lv_style_reset(&theme_styles_.text);
+        lv_style_reset(&theme_styles_.low_battery);
+        lv_style_reset(&theme_styles_.user_bubble);
+        lv_style_reset(&theme_styles_.assistant_bubble);
+        lv_style_reset(&theme_styles_.system_bubble);
+    }
     if (display_ != nullptr) {
         lv_display_delete(display_);
     }
@@ -295,22 +364,284 @@ LcdDisplay::~LcdDisplay() {
     }
 }
 
+// 统计每秒实际渲染的帧数、每帧渲染耗时和等待 DMA 发送完成的时间，每 5 秒打印一次
+void LcdDisplay::StartPerfMonitor() {
+#if CONFIG_DISPLAY_PERF_MONITOR
+    if (display_ == nullptr) {
+        return;
+    }
+    perf_ = PerfStats();
+    perf_.window_start_us = esp_timer_get_time();
+    lv_display_add_event_cb(display_, OnPerfEvent, LV_EVENT_REFR_START, this);
+    lv_display_add_event_cb(display_, OnPerfEvent, LV_EVENT_RENDER_START, this);
+    lv_display_add_event_cb(display_, OnPerfEvent, LV_EVENT_REFR_READY, this);
+    lv_display_add_event_cb(display_, OnPerfEvent, LV_EVENT_FLUSH_WAIT_START, this);
+    lv_display_add_event_cb(display_, OnPerfEvent, LV_EVENT_FLUSH_WAIT_FINISH, this);
+#endif
+}
+
+#if CONFIG_DISPLAY_PERF_MONITOR
+void LcdDisplay::OnPerfEvent(lv_event_t* e) {
+    auto self = static_cast<LcdDisplay*>(lv_event_get_user_data(e));
+    auto& perf = self->perf_;
+    int64_t now = esp_timer_get_time();
+    switch (lv_event_get_code(e)) {
+    case LV_EVENT_REFR_START:
+        perf.refr_start_us = now;
+        perf.rendered = false;
+        break;
+    case LV_EVENT_RENDER_START:
+        perf.rendered = true;
+        break;
+    case LV_EVENT_FLUSH_WAIT_START:
+        perf.flush_wait_start_us = now;
+        break;
+    case LV_EVENT_FLUSH_WAIT_FINISH:
+        perf.flush_wait_us += now - perf.flush_wait_start_us;
+        break;
+    case LV_EVENT_REFR_READY: {
+        // 没有脏区域的刷新周期不算一帧
+        if (perf.rendered) {
+            int64_t render_us = now - perf.refr_start_us;
+            perf.frames++;
+            perf.render_us += render_us;
+            perf.render_max_us = std::max(perf.render_max_us, render_us);
+        }
+        int64_t elapsed_us = now - perf.window_start_us;
+        if (elapsed_us >= 5000000) {
+            if (perf.frames > 0) {
+                ESP_LOGI(TAG, "LVGL %.1f fps, frame %lld ms avg / %lld ms max, flush wait %lld ms avg",
+                    perf.frames * 1000000.0f / elapsed_us, perf.render_us / perf.frames / 1000,
+                    perf.render_max_us / 1000, perf.flush_wait_us / perf.frames / 1000);
+#if CONFIG_DISPLAY_GLYPH_CACHE
+                if (self->text_font_cache_) {
+                    self->text_font_cache_->LogStats();
+                }
+#endif
+            }
+            perf = PerfStats();
+            perf.window_start_us = now;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+#endif
+
 bool LcdDisplay::Lock(int timeout_ms) {
     return lvgl_port_lock(timeout_ms);
 }
 
 void LcdDisplay::Unlock() {
+#if CONFIG_DISPLAY_ADAPTIVE_REFRESH
+    // 界面有更新，暂停中的 LVGL 任务需要恢复才能渲染
+    last_activity_us_ = esp_timer_get_time();
+    if (lvgl_suspended_.exchange(false)) {
+        lvgl_port_resume();
+    }
+#endif
     lvgl_port_unlock();
 }
 
+void LcdDisplay::InitializeRefreshControl() {
+#if CONFIG_DISPLAY_ADAPTIVE_REFRESH
+    if (display_ == nullptr) {
+        return;
+    }
+    // esp_lvgl_port 按 timer_period_ms 递增 tick，改用 esp_timer 计时，刷新周期不受 tick 粒度限制
+    lv_tick_set_cb([]() -> uint32_t {
+        return esp_timer_get_time() / 1000;
+    });
+    lv_display_add_event_cb(display_, OnRenderReady, LV_EVENT_RENDER_READY, this);
+    last_activity_us_ = esp_timer_get_time();
+    ApplyRefreshPeriod();
+
+    esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+            static_cast<LcdDisplay*>(arg)->CheckRefreshSuspend();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "display_refresh",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &refresh_timer_));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(refresh_timer_, 1000000));
+#endif
+}
+
+#if CONFIG_DISPLAY_ADAPTIVE_REFRESH
+// 刷新周期，对话中聊天内容会滚动
+#define REFRESH_PERIOD_ACTIVE_MS 20
+#define REFRESH_PERIOD_SLEEP_MS 100
+// 过热降档时的最短刷新间隔
+#define REFRESH_PERIOD_THROTTLED_MS 66
+// 没有渲染和界面更新超过这个时间后暂停 LVGL 任务
+#define REFRESH_SUSPEND_IDLE_MS 3000
+#define REFRESH_SUSPEND_SLEEP_MS 1000
+
+void LcdDisplay::OnRenderReady(lv_event_t* e) {
+    auto self = static_cast<LcdDisplay*>(lv_event_get_user_data(e));
+    self->last_activity_us_ = esp_timer_get_time();
+}
+
+void LcdDisplay::SetRefreshActive(bool active) {
+    if (refresh_active_.exchange(active) != active) {
+        DisplayLockGuard lock(this);
+        ApplyRefreshPeriod();
+    }
+}
+
+void LcdDisplay::SetSleeping(bool sleeping) {
+    if (sleeping_.exchange(sleeping) != sleeping) {
+        DisplayLockGuard lock(this);
+        ApplyRefreshPeriod();
+    }
+}
+
+void LcdDisplay::SetThrottled(bool throttled) {
+    if (throttled_.exchange(throttled) != throttled) {
+        DisplayLockGuard lock(this);
+        ApplyRefreshPeriod();
+    }
+}
+
+// 调用方持有 LVGL 锁
+void LcdDisplay::ApplyRefreshPeriod() {
+    if (display_ == nullptr) {
+        return;
+    }
+    auto refr_timer = lv_display_get_refr_timer(display_);
+    if (refr_timer == nullptr) {
+        return;
+    }
+    uint32_t period = LV_DEF_REFR_PERIOD;
+    if (sleeping_) {
+        period = REFRESH_PERIOD_SLEEP_MS;
+    } else if (refresh_active_) {
+        period = PerformanceProfile::GetInstance().Get(kPerfDisplayRefreshMs, REFRESH_PERIOD_ACTIVE_MS);
+    }
+    if (throttled_ && period < REFRESH_PERIOD_THROTTLED_MS) {
+        period = REFRESH_PERIOD_THROTTLED_MS;
+    }
+    lv_timer_set_period(refr_timer, period);
+}
+
+void LcdDisplay::CheckRefreshSuspend() {
+    if (refresh_active_ || lvgl_suspended_) {
+        return;
+    }
+    int64_t idle_ms = (esp_timer_get_time() - last_activity_us_) / 1000;
+    if (idle_ms < (sleeping_ ? REFRESH_SUSPEND_SLEEP_MS : REFRESH_SUSPEND_IDLE_MS)) {
+        return;
+    }
+    // 持有锁时没有其它任务能修改界面，之后的界面更新在 Unlock 中恢复
+    if (!lvgl_port_lock(0)) {
+        return;
+    }
+    // 有触摸输入的屏幕暂停后无法响应触摸，不暂停
+    if (lv_indev_get_next(nullptr) == nullptr) {
+        lvgl_port_stop();
+        lvgl_suspended_ = true;
+        ESP_LOGD(TAG, "LVGL suspended after %lld ms idle", idle_ms);
+    }
+    lvgl_port_unlock();
+}
+#endif
+
+#if CONFIG_DISPLAY_GLYPH_CACHE
+// 字形缓存只在 LVGL 任务中访问，持有 LVGL 锁时可以安全清空；之后的字形直接从字体数据解码
+void LcdDisplay::SetLowMemory(bool low_memory) {
+    DisplayLockGuard lock(this);
+    low_memory_ = low_memory;
+    if (text_font_cache_ != nullptr) {
+        text_font_cache_->SetSuspended(low_memory);
+    }
+}
+#endif
+
+// 所有控件引用同一组主题样式，切换主题只需要改样式的值再通知 LVGL 刷新一次
+void LcdDisplay::InitializeThemeStyles() {
+    if (theme_styles_ready_) {
+        return;
+    }
+    lv_style_init(&theme_styles_.surface);
+    lv_style_init(&theme_styles_.content);
+    lv_style_init(&theme_styles_.text);
+    lv_style_init(&theme_styles_.low_battery);
+    lv_style_init(&theme_styles_.user_bubble);
+    lv_style_init(&theme_styles_.assistant_bubble);
+    lv_style_init(&theme_styles_.system_bubble);
+    theme_styles_ready_ = true;
+    ApplyThemeStyles();
+}
+
+void LcdDisplay::ApplyThemeStyles() {
+    lv_style_set_bg_color(&theme_styles_.surface, current_theme_.background);
+    lv_style_set_text_color(&theme_styles_.surface, current_theme_.text);
+    lv_style_set_border_color(&theme_styles_.surface, current_theme_.border);
+
+    lv_style_set_bg_color(&theme_styles_.content, current_theme_.chat_background);
+    lv_style_set_border_color(&theme_styles_.content, current_theme_.border);
+
+    lv_style_set_text_color(&theme_styles_.text, current_theme_.text);
+
+    lv_style_set_bg_color(&theme_styles_.low_battery, current_theme_.low_battery);
+
+    lv_style_set_bg_color(&theme_styles_.user_bubble, current_theme_.user_bubble);
+    lv_style_set_border_color(&theme_styles_.user_bubble, current_theme_.border);
+    lv_style_set_text_color(&theme_styles_.user_bubble, current_theme_.text);
+
+    lv_style_set_bg_color(&theme_styles_.assistant_bubble, current_theme_.assistant_bubble);
+    lv_style_set_border_color(&theme_styles_.assistant_bubble, current_theme_.border);
+    lv_style_set_text_color(&theme_styles_.assistant_bubble, current_theme_.text);
+
+    lv_style_set_bg_color(&theme_styles_.system_bubble, current_theme_.system_bubble);
+    lv_style_set_border_color(&theme_styles_.system_bubble, current_theme_.border);
+    lv_style_set_text_color(&theme_styles_.system_bubble, current_theme_.system_text);
+}
+
+#if CONFIG_USE_ASSETS_PARTITION
+// 二进制字体要在 LVGL 初始化之后加载，所以放在 SetupUI 中而不是构造函数
+void LcdDisplay::LoadAssetFonts() {
+    auto& assets = AssetsPartition::GetInstance();
+    auto text_font = assets.GetFont("text_font.bin", nullptr);
+    if (text_font != nullptr) {
+        fonts_.text_font = text_font;
+#if CONFIG_DISPLAY_GLYPH_CACHE
+        if (heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0) {
+            text_font_cache_ = std::make_unique<GlyphCacheFont>(text_font, CONFIG_DISPLAY_GLYPH_CACHE_SIZE * 1024);
+            text_font_cache_->SetSuspended(low_memory_);
+            fonts_.text_font = text_font_cache_->font();
+        }
+#endif
+    }
+    fonts_.icon_font = assets.GetFont("icon_font.bin", fonts_.icon_font);
+}
+#endif
+
 #if CONFIG_USE_WECHAT_MESSAGE_STYLE
+#if CONFIG_IDF_TARGET_ESP32P4
+#define  MAX_MESSAGES 40
+#else
+#define  MAX_MESSAGES 20
+#endif
+
 void LcdDisplay::SetupUI() {
     DisplayLockGuard lock(this);
+#if CONFIG_USE_ASSETS_PARTITION
+    LoadAssetFonts();
+#endif
+    StartPerfMonitor();
+    InitializeRefreshControl();
+    InitializeThemeStyles();
+    InitializeUiQueue();
 
     auto screen = lv_screen_active();
     lv_obj_set_style_text_font(screen, fonts_.text_font, 0);
-    lv_obj_set_style_text_color(screen, current_theme_.text, 0);
-    lv_obj_set_style_bg_color(screen, current_theme_.background, 0);
+    lv_obj_add_style(screen, &theme_styles_.surface, 0);
 
     /* Container */
     container_ = lv_obj_create(screen);
@@ -319,15 +650,13 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_style_pad_all(container_, 0, 0);
     lv_obj_set_style_border_width(container_, 0, 0);
     lv_obj_set_style_pad_row(container_, 0, 0);
-    lv_obj_set_style_bg_color(container_, current_theme_.background, 0);
-    lv_obj_set_style_border_color(container_, current_theme_.border, 0);
+    lv_obj_add_style(container_, &theme_styles_.surface, 0);
 
     /* Status bar */
     status_bar_ = lv_obj_create(container_);
     lv_obj_set_size(status_bar_, LV_HOR_RES, LV_SIZE_CONTENT);
     lv_obj_set_style_radius(status_bar_, 0, 0);
-    lv_obj_set_style_bg_color(status_bar_, current_theme_.background, 0);
-    lv_obj_set_style_text_color(status_bar_, current_theme_.text, 0);
+    lv_obj_add_style(status_bar_, &theme_styles_.surface, 0);
     
     /* Content - Chat area */
     content_ = lv_obj_create(container_);
@@ -335,8 +664,7 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_width(content_, LV_HOR_RES);
     lv_obj_set_flex_grow(content_, 1);
     lv_obj_set_style_pad_all(content_, 10, 0);
-    lv_obj_set_style_bg_color(content_, current_theme_.chat_background, 0); // Background for chat area
-    lv_obj_set_style_border_color(content_, current_theme_.border, 0); // Border color for chat area
+    lv_obj_add_style(content_, &theme_styles_.content, 0);
 
     // Enable scrolling for chat content
     lv_obj_set_scrollbar_mode(content_, LV_SCROLLBAR_MODE_OFF);
@@ -350,6 +678,16 @@ void LcdDisplay::SetupUI() {
     // We'll create chat messages dynamically in SetChatMessage
     chat_message_label_ = nullptr;
 
+#if CONFIG_CHAT_HISTORY_SIZE_KB > 0
+    chat_history_ = std::make_unique<ChatHistory>(CONFIG_CHAT_HISTORY_SIZE_KB * 1024);
+    if (chat_history_->valid()) {
+        lv_obj_add_event_cb(content_, OnChatScroll, LV_EVENT_SCROLL_END, this);
+    } else {
+        ESP_LOGW(TAG, "No PSRAM for chat history, keep the latest %d messages only", MAX_MESSAGES);
+        chat_history_.reset();
+    }
+#endif
+
     /* Status bar */
     lv_obj_set_flex_flow(status_bar_, LV_FLEX_FLOW_ROW);
     lv_obj_set_style_pad_all(status_bar_, 0, 0);
@@ -366,14 +704,19 @@ void LcdDisplay::SetupUI() {
     // 创建emotion_label_在状态栏最左侧
     emotion_label_ = lv_label_create(status_bar_);
     lv_obj_set_style_text_font(emotion_label_, &font_awesome_30_4, 0);
-    lv_obj_set_style_text_color(emotion_label_, current_theme_.text, 0);
+    lv_obj_add_style(emotion_label_, &theme_styles_.text, 0);
     lv_label_set_text(emotion_label_, FONT_AWESOME_AI_CHIP);
     lv_obj_set_style_margin_right(emotion_label_, 5, 0); // 添加右边距，与后面的元素分隔
 
+    // 图片字体的表情直接显示图片，和 emotion_label_ 占同一个位置，同时只显示一个
+    emotion_image_ = lv_image_create(status_bar_);
+    lv_obj_set_style_margin_right(emotion_image_, 5, 0);
+    lv_obj_add_flag(emotion_image_, LV_OBJ_FLAG_HIDDEN);
+
     notification_label_ = lv_label_create(status_bar_);
     lv_obj_set_flex_grow(notification_label_, 1);
     lv_obj_set_style_text_align(notification_label_, LV_TEXT_ALIGN_CENTER, 0);
-    lv_obj_set_style_text_color(notification_label_, current_theme_.text, 0);
+    lv_obj_add_style(notification_label_, &theme_styles_.text, 0);
     lv_label_set_text(notification_label_, "");
     lv_obj_add_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
 
@@ -381,31 +724,31 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_flex_grow(status_label_, 1);
     lv_label_set_long_mode(status_label_, LV_LABEL_LONG_SCROLL_CIRCULAR);
     lv_obj_set_style_text_align(status_label_, LV_TEXT_ALIGN_CENTER, 0);
-    lv_obj_set_style_text_color(status_label_, current_theme_.text, 0);
+    lv_obj_add_style(status_label_, &theme_styles_.text, 0);
     lv_label_set_text(status_label_, Lang::Strings::INITIALIZING);
     
     mute_label_ = lv_label_create(status_bar_);
     lv_label_set_text(mute_label_, "");
     lv_obj_set_style_text_font(mute_label_, fonts_.icon_font, 0);
-    lv_obj_set_style_text_color(mute_label_, current_theme_.text, 0);
+    lv_obj_add_style(mute_label_, &theme_styles_.text, 0);
 
     network_label_ = lv_label_create(status_bar_);
     lv_label_set_text(network_label_, "");
     lv_obj_set_style_text_font(network_label_, fonts_.icon_font, 0);
-    lv_obj_set_style_text_color(network_label_, current_theme_.text, 0);
+    lv_obj_add_style(network_label_, &theme_styles_.text, 0);
     lv_obj_set_style_margin_left(network_label_, 5, 0); // 添加左边距，与前面的元素分隔
 
     battery_label_ = lv_label_create(status_bar_);
     lv_label_set_text(battery_label_, "");
     lv_obj_set_style_text_font(battery_label_, fonts_.icon_font, 0);
-    lv_obj_set_style_text_color(battery_label_, current_theme_.text, 0);
+    lv_obj_add_style(battery_label_, &theme_styles_.text, 0);
     lv_obj_set_style_margin_left(battery_label_, 5, 0); // 添加左边距，与前面的元素分隔
 
     low_battery_popup_ = lv_obj_create(screen);
     lv_obj_set_scrollbar_mode(low_battery_popup_, LV_SCROLLBAR_MODE_OFF);
     lv_obj_set_size(low_battery_popup_, LV_HOR_RES * 0.9, fonts_.text_font->line_height * 2);
     lv_obj_align(low_battery_popup_, LV_ALIGN_BOTTOM_MID, 0, 0);
-    lv_obj_set_style_bg_color(low_battery_popup_, current_theme_.low_battery, 0);
+    lv_obj_add_style(low_battery_popup_, &theme_styles_.low_battery, 0);
     lv_obj_set_style_radius(low_battery_popup_, 10, 0);
     low_battery_label_ = lv_label_create(low_battery_popup_);
     lv_label_set_text(low_battery_label_, Lang::Strings::BATTERY_NEED_CHARGE);
@@ -413,303 +756,456 @@ void LcdDisplay::SetupUI() {
     lv_obj_center(low_battery_label_);
     lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
 }
-#if CONFIG_IDF_TARGET_ESP32P4
-#define  MAX_MESSAGES 40
-#else
-#define  MAX_MESSAGES 20
-#endif
-void LcdDisplay::SetChatMessage(const char* role, const char* content) {
-    DisplayLockGuard lock(this);
-    if (content_ == nullptr) {
-        return;
+// 聊天行：全宽透明容器 + 气泡 + 文本，对象只创建一次
+LcdDisplay::ChatRow& LcdDisplay::CreateChatRow() {
+    chat_rows_.reserve(MAX_MESSAGES);
+    ChatRow row;
+    row.container = lv_obj_create(content_);
+    lv_obj_set_width(row.container, LV_HOR_RES);
+    lv_obj_set_height(row.container, LV_SIZE_CONTENT);
+    lv_obj_set_style_bg_opa(row.container, LV_OPA_TRANSP, 0);
+    lv_obj_set_style_border_width(row.container, 0, 0);
+    lv_obj_set_style_pad_all(row.container, 0, 0);
+    lv_obj_set_scrollbar_mode(row.container, LV_SCROLLBAR_MODE_OFF);
+    lv_obj_set_user_data(row.container, reinterpret_cast<void*>(chat_rows_.size()));
+
+    row.bubble = lv_obj_create(row.container);
+    lv_obj_set_style_radius(row.bubble, 8, 0);
+    lv_obj_set_scrollbar_mode(row.bubble, LV_SCROLLBAR_MODE_OFF);
+    lv_obj_set_style_border_width(row.bubble, 1, 0);
+    lv_obj_add_style(row.bubble, ChatBubbleStyle(row.type), 0);
+    lv_obj_set_style_pad_all(row.bubble, 8, 0);
+
+    // 追加的句子排在第一个标签下面
+    lv_obj_set_flex_flow(row.bubble, LV_FLEX_FLOW_COLUMN);
+    lv_obj_set_style_pad_row(row.bubble, 0, 0);
+
+    row.label = lv_label_create(row.bubble);
+    lv_label_set_long_mode(row.label, LV_LABEL_LONG_WRAP);
+    lv_obj_set_style_text_font(row.label, fonts_.text_font, 0);
+
+    chat_rows_.push_back(row);
+    return chat_rows_.back();
+}
+
+// 新消息的行：达到上限后复用最上面的一行，回到最新消息时隐藏的空行优先使用
+LcdDisplay::ChatRow& LcdDisplay::AcquireChatRow() {
+    if (chat_rows_.size() < MAX_MESSAGES) {
+        auto& row = CreateChatRow();
+        chat_last_row_ = chat_rows_.size() - 1;
+        return row;
     }
-    
-    //避免出现空的消息框
-    if(strlen(content) == 0) return;
-    
-    // 检查消息数量是否超过限制
-    uint32_t child_count = lv_obj_get_child_cnt(content_);
-    if (child_count >= MAX_MESSAGES) {
-        // 删除最早的消息（第一个子对象）
-        lv_obj_t* first_child = lv_obj_get_child(content_, 0);
-        lv_obj_t* last_child = lv_obj_get_child(content_, child_count - 1);
-        if (first_child != nullptr) {
-            lv_obj_del(first_child);
+
+    ChatRow* row = nullptr;
+    for (auto& candidate : chat_rows_) {
+        if (lv_obj_has_flag(candidate.container, LV_OBJ_FLAG_HIDDEN)) {
+            row = &candidate;
+            break;
         }
-        // Scroll to the last message immediately
-        if (last_child != nullptr) {
-            lv_obj_scroll_to_view_recursive(last_child, LV_ANIM_OFF);
+    }
+    if (row == nullptr) {
+        row = ChatRowAt(0);
+    }
+    if (row->image != nullptr) {
+        // 删除图片时 LV_EVENT_DELETE 回调释放拷贝的图片数据
+        lv_obj_del(row->image);
+        row->image = nullptr;
+    }
+    for (size_t i = 0; i < row->segment_count; i++) {
+        lv_obj_add_flag(row->segments[i], LV_OBJ_FLAG_HIDDEN);
+    }
+    row->segment_count = 0;
+    row->seq = kChatNoRecord;
+    lv_obj_remove_flag(row->container, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_move_to_index(row->container, -1);
+    chat_last_row_ = row - chat_rows_.data();
+    return *row;
+}
+
+LcdDisplay::ChatRow* LcdDisplay::ChatRowAt(int index) {
+    auto container = lv_obj_get_child(content_, index);
+    if (container == nullptr) {
+        return nullptr;
+    }
+    return &chat_rows_[reinterpret_cast<uintptr_t>(lv_obj_get_user_data(container))];
+}
+
+bool LcdDisplay::IsChatRowVisible(const ChatRow& row) {
+    lv_area_t row_area;
+    lv_area_t view_area;
+    lv_obj_get_coords(row.container, &row_area);
+    lv_obj_get_coords(content_, &view_area);
+    return row_area.y2 >= view_area.y1 && row_area.y1 <= view_area.y2;
+}
+
+lv_style_t* LcdDisplay::ChatBubbleStyle(ChatBubbleType type) {
+    switch (type) {
+    case kChatBubbleUser:
+        return &theme_styles_.user_bubble;
+    case kChatBubbleSystem:
+        return &theme_styles_.system_bubble;
+    default:
+        return &theme_styles_.assistant_bubble;
+    }
+}
+
+// 只在行的类型变化时替换共享样式，颜色随主题样式一起更新
+void LcdDisplay::SetChatRowType(ChatRow& row, ChatBubbleType type) {
+    if (row.type == type) {
+        return;
+    }
+    lv_obj_remove_style(row.bubble, ChatBubbleStyle(row.type), 0);
+    lv_obj_add_style(row.bubble, ChatBubbleStyle(type), 0);
+    row.type = type;
+}
+
+// 一个气泡最多追加的句子数，超过后另起一个气泡，保持每个气泡的排版开销有上限
+#define CHAT_MAX_SEGMENTS 16
+// 每次滚动停止时最多换入的行数
+#define CHAT_LOAD_BATCH 4
+
+// 填写行的第一段文本，追加的句子清空
+void LcdDisplay::FillChatRow(ChatRow& row, ChatBubbleType type, const char* content) {
+    for (size_t i = 0; i < row.segment_count; i++) {
+        lv_obj_add_flag(row.segments[i], LV_OBJ_FLAG_HIDDEN);
+    }
+    row.segment_count = 0;
+
+    lv_label_set_text(row.label, content);
+    lv_obj_remove_flag(row.label, LV_OBJ_FLAG_HIDDEN);
+    FitChatLabel(row.label, content);
+    lv_obj_set_size(row.bubble, LV_SIZE_CONTENT, LV_SIZE_CONTENT);
+
+    SetChatRowType(row, type);
+
+    // 用户消息靠右，系统消息居中，助手消息靠左
+    if (type == kChatBubbleUser) {
+        lv_obj_align(row.bubble, LV_ALIGN_RIGHT_MID, -25, 0);
+    } else if (type == kChatBubbleSystem) {
+        lv_obj_align(row.bubble, LV_ALIGN_CENTER, 0, 0);
+    } else {
+        lv_obj_align(row.bubble, LV_ALIGN_LEFT_MID, 0, 0);
+    }
+}
+
+// 追加的句子各用一个标签，已经创建的标签随行复用
+lv_obj_t* LcdDisplay::AddChatSegment(ChatRow& row, const char* content) {
+    if (row.segment_count == row.segments.size()) {
+        auto label = lv_label_create(row.bubble);
+        lv_label_set_long_mode(label, LV_LABEL_LONG_WRAP);
+        lv_obj_set_style_text_font(label, fonts_.text_font, 0);
+        row.segments.push_back(label);
+    }
+    auto label = row.segments[row.segment_count++];
+    lv_label_set_text(label, content);
+    lv_obj_remove_flag(label, LV_OBJ_FLAG_HIDDEN);
+    FitChatLabel(label, content);
+    return label;
+}
+
+// 按聊天记录重新填写一行：head 是气泡的第一条记录，后面的 continuation 记录是追加的句子
+void LcdDisplay::BindChatRow(ChatRow& row, uint32_t head) {
+    if (row.image != nullptr) {
+        lv_obj_del(row.image);
+        row.image = nullptr;
+    }
+    ChatHistory::Record record;
+    if (!chat_history_->Get(head, record)) {
+        lv_obj_add_flag(row.container, LV_OBJ_FLAG_HIDDEN);
+        row.seq = kChatNoRecord;
+        return;
+    }
+    lv_obj_remove_flag(row.container, LV_OBJ_FLAG_HIDDEN);
+    FillChatRow(row, static_cast<ChatBubbleType>(record.type), record.text.c_str());
+    row.seq = head;
+    for (uint32_t seq = head + 1; row.segment_count < CHAT_MAX_SEGMENTS && chat_history_->Get(seq, record) &&
+        record.continuation; seq++) {
+        AddChatSegment(row, record.text.c_str());
+    }
+}
+
+// 回看历史时来了新消息：所有行重新绑定到最新的几条消息，多出的行隐藏。图片不在记录中，不再显示
+void LcdDisplay::ShowChatTail() {
+    std::vector<uint32_t> heads;
+    if (chat_history_->end() > chat_history_->begin()) {
+        uint32_t head = chat_history_->HeadOf(chat_history_->end() - 1);
+        heads.push_back(head);
+        while (heads.size() < chat_rows_.size() && chat_history_->Previous(head, head)) {
+            heads.push_back(head);
         }
     }
-    
-    // 折叠系统消息（如果是系统消息，检查最后一个消息是否也是系统消息）
-    if (strcmp(role, "system") == 0 && child_count > 0) {
-        // 获取最后一个消息容器
-        lv_obj_t* last_container = lv_obj_get_child(content_, child_count - 1);
-        if (last_container != nullptr && lv_obj_get_child_cnt(last_container) > 0) {
-            // 获取容器内的气泡
-            lv_obj_t* last_bubble = lv_obj_get_child(last_container, 0);
-            if (last_bubble != nullptr) {
-                // 检查气泡类型是否为系统消息
-                void* bubble_type_ptr = lv_obj_get_user_data(last_bubble);
-                if (bubble_type_ptr != nullptr && strcmp((const char*)bubble_type_ptr, "system") == 0) {
-                    // 如果最后一个消息也是系统消息，则删除它
-                    lv_obj_del(last_container);
-                }
+    for (size_t i = 0; i < chat_rows_.size(); i++) {
+        auto& row = chat_rows_[i];
+        if (i < heads.size()) {
+            BindChatRow(row, heads[heads.size() - 1 - i]);
+        } else {
+            if (row.image != nullptr) {
+                lv_obj_del(row.image);
+                row.image = nullptr;
             }
+            row.seq = kChatNoRecord;
+            lv_obj_add_flag(row.container, LV_OBJ_FLAG_HIDDEN);
         }
+        lv_obj_move_to_index(row.container, i);
     }
-    
-    // Create a message bubble
-    lv_obj_t* msg_bubble = lv_obj_create(content_);
-    lv_obj_set_style_radius(msg_bubble, 8, 0);
-    lv_obj_set_scrollbar_mode(msg_bubble, LV_SCROLLBAR_MODE_OFF);
-    lv_obj_set_style_border_width(msg_bubble, 1, 0);
-    lv_obj_set_style_border_color(msg_bubble, current_theme_.border, 0);
-    lv_obj_set_style_pad_all(msg_bubble, 8, 0);
-
-    // Create the message text
-    lv_obj_t* msg_text = lv_label_create(msg_bubble);
-    lv_label_set_text(msg_text, content);
-    
-    // 计算文本实际宽度
-    lv_coord_t text_width = lv_txt_get_width(content, strlen(content), fonts_.text_font, 0);
+    chat_last_row_ = static_cast<int>(heads.size()) - 1;
+    chat_following_ = true;
+}
 
-    // 计算气泡宽度
-    lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;  // 屏幕宽度的85%
-    lv_coord_t min_width = 20;  
-    lv_coord_t bubble_width;
-    
-    // 确保文本宽度不小于最小宽度
-    if (text_width < min_width) {
-        text_width = min_width;
+// 在顶部换入更早的消息：池满时复用最下面看不见的一行，再按新行的高度调整滚动位置，画面不跳动
+void LcdDisplay::LoadOlderChat() {
+    for (int i = 0; i < CHAT_LOAD_BATCH; i++) {
+        auto first = ChatRowAt(0);
+        uint32_t head;
+        if (first == nullptr || first->seq == kChatNoRecord || !chat_history_->Previous(first->seq, head)) {
+            return;
+        }
+        ChatRow* row;
+        if (chat_rows_.size() < MAX_MESSAGES) {
+            row = &CreateChatRow();
+        } else {
+            row = ChatRowAt(-1);
+            if (!lv_obj_has_flag(row->container, LV_OBJ_FLAG_HIDDEN) && IsChatRowVisible(*row)) {
+                return;
+            }
+            if (chat_last_row_ >= 0 && row == &chat_rows_[chat_last_row_]) {
+                chat_last_row_ = -1;
+                chat_following_ = false;
+            }
+        }
+        BindChatRow(*row, head);
+        lv_obj_move_to_index(row->container, 0);
+        lv_obj_update_layout(content_);
+        lv_coord_t height = lv_obj_get_height(row->container) + lv_obj_get_style_pad_row(content_, 0);
+        lv_obj_scroll_to_y(content_, lv_obj_get_scroll_y(content_) + height, LV_ANIM_OFF);
     }
+}
 
-    // 如果文本宽度小于最大宽度，使用文本宽度
-    if (text_width < max_width) {
-        bubble_width = text_width; 
-    } else {
-        bubble_width = max_width;
+// 在底部换入更新的消息，复用最上面看不见的一行；换到最新的消息时恢复跟随
+void LcdDisplay::LoadNewerChat() {
+    for (int i = 0; i < CHAT_LOAD_BATCH && !chat_following_; i++) {
+        auto last = ChatRowAt(-1);
+        uint32_t head;
+        if (last == nullptr || last->seq == kChatNoRecord || !chat_history_->Next(last->seq, head)) {
+            return;
+        }
+        auto row = ChatRowAt(0);
+        if (IsChatRowVisible(*row)) {
+            return;
+        }
+        lv_coord_t height = lv_obj_get_height(row->container) + lv_obj_get_style_pad_row(content_, 0);
+        BindChatRow(*row, head);
+        lv_obj_move_to_index(row->container, -1);
+        lv_obj_update_layout(content_);
+        lv_obj_scroll_to_y(content_, lv_obj_get_scroll_y(content_) - height, LV_ANIM_OFF);
+        if (head == chat_history_->HeadOf(chat_history_->end() - 1)) {
+            chat_last_row_ = row - chat_rows_.data();
+            chat_following_ = true;
+        }
     }
-    
-    // 设置消息文本的宽度
-    lv_obj_set_width(msg_text, bubble_width);  // 减去padding
-    lv_label_set_long_mode(msg_text, LV_LABEL_LONG_WRAP);
-    lv_obj_set_style_text_font(msg_text, fonts_.text_font, 0);
+}
 
-    // 设置气泡宽度
-    lv_obj_set_width(msg_bubble, bubble_width);
-    lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
+// 滚动停止时，离顶部或底部不到一屏就换入更早或更新的消息
+void LcdDisplay::OnChatScroll(lv_event_t* e) {
+    auto self = static_cast<LcdDisplay*>(lv_event_get_user_data(e));
+    lv_coord_t height = lv_obj_get_height(self->content_);
+    if (lv_obj_get_scroll_top(self->content_) < height) {
+        self->LoadOlderChat();
+    } else if (lv_obj_get_scroll_bottom(self->content_) < height) {
+        self->LoadNewerChat();
+    }
+}
 
-    // Set alignment and style based on message role
-    if (strcmp(role, "user") == 0) {
-        // User messages are right-aligned with green background
-        lv_obj_set_style_bg_color(msg_bubble, current_theme_.user_bubble, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, current_theme_.text, 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"user");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "assistant") == 0) {
-        // Assistant messages are left-aligned with white background
-        lv_obj_set_style_bg_color(msg_bubble, current_theme_.assistant_bubble, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, current_theme_.text, 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"assistant");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "system") == 0) {
-        // System messages are center-aligned with light gray background
-        lv_obj_set_style_bg_color(msg_bubble, current_theme_.system_bubble, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, current_theme_.system_text, 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"system");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
+void LcdDisplay::ApplyChatMessage(const char* role, const char* content) {
+    DisplayLockGuard lock(this);
+    if (content_ == nullptr) {
+        return;
     }
     
-    // Create a full-width container for user messages to ensure right alignment
+    //避免出现空的消息框
+    if(strlen(content) == 0) return;
+
+    ChatBubbleType type;
     if (strcmp(role, "user") == 0) {
-        // Create a full-width container
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // Make container transparent and borderless
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // Move the message bubble into this container
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // Right align the bubble in the container
-        lv_obj_align(msg_bubble, LV_ALIGN_RIGHT_MID, -25, 0);
-        
-        // Auto-scroll to this container
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
+        type = kChatBubbleUser;
+    } else if (strcmp(role, "assistant") == 0) {
+        type = kChatBubbleAssistant;
     } else if (strcmp(role, "system") == 0) {
-        // 为系统消息创建全宽容器以确保居中对齐
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // 使容器透明且无边框
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // 将消息气泡移入此容器
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // 将气泡居中对齐在容器中
-        lv_obj_align(msg_bubble, LV_ALIGN_CENTER, 0, 0);
-        
-        // 自动滚动底部
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
+        type = kChatBubbleSystem;
     } else {
-        // For assistant messages
-        // Left align assistant messages
-        lv_obj_align(msg_bubble, LV_ALIGN_LEFT_MID, 0, 0);
+        return;
+    }
 
-        // Auto-scroll to the message bubble
-        lv_obj_scroll_to_view_recursive(msg_bubble, LV_ANIM_ON);
+    if (chat_history_ && !chat_following_) {
+        ShowChatTail();
     }
-    
+
+    // 折叠系统消息：最后一行也是系统消息时直接替换它的文本
+    ChatRow* row = nullptr;
+    if (type == kChatBubbleSystem && chat_last_row_ >= 0 && chat_rows_[chat_last_row_].type == kChatBubbleSystem) {
+        row = &chat_rows_[chat_last_row_];
+        if (chat_history_ && row->seq != kChatNoRecord && row->seq + 1 == chat_history_->end()) {
+            chat_history_->ReplaceLast(content);
+        }
+    } else {
+        row = &AcquireChatRow();
+        if (chat_history_) {
+            row->seq = chat_history_->Append(type, false, content);
+        }
+    }
+    // 折叠的系统消息可能带着上一次追加的句子
+    FillChatRow(*row, type, content);
+
+    // Auto-scroll to this row
+    lv_obj_scroll_to_view_recursive(row->container, LV_ANIM_ON);
+
     // Store reference to the latest message label
-    chat_message_label_ = msg_text;
+    chat_message_label_ = row->label;
 }
 
-void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
-    DisplayLockGuard lock(this);
-    if (content_ == nullptr) {
-        return;
-    }
-    
-    if (img_dsc != nullptr) {
-        // Create a message bubble for image preview
-        lv_obj_t* img_bubble = lv_obj_create(content_);
-        lv_obj_set_style_radius(img_bubble, 8, 0);
-        lv_obj_set_scrollbar_mode(img_bubble, LV_SCROLLBAR_MODE_OFF);
-        lv_obj_set_style_border_width(img_bubble, 1, 0);
-        lv_obj_set_style_border_color(img_bubble, current_theme_.border, 0);
-        lv_obj_set_style_pad_all(img_bubble, 8, 0);
-        
-        // Set image bubble background color (similar to system message)
-        lv_obj_set_style_bg_color(img_bubble, current_theme_.assistant_bubble, 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(img_bubble, (void*)"image");
-        
-        // Create the image object inside the bubble
-        lv_obj_t* preview_image = lv_image_create(img_bubble);
-        
-        // Copy the image descriptor and data to avoid source data changes
-        lv_img_dsc_t* copied_img_dsc = (lv_img_dsc_t*)heap_caps_malloc(sizeof(lv_img_dsc_t), MALLOC_CAP_8BIT);
-        if (copied_img_dsc == nullptr) {
-            ESP_LOGE(TAG, "Failed to allocate memory for image descriptor");
-            lv_obj_del(img_bubble);
+// 标签宽度随文本，最宽为屏幕的 85%，气泡随标签大小
+lv_coord_t LcdDisplay::FitChatLabel(lv_obj_t* label, const char* content) {
+    lv_coord_t text_width = lv_txt_get_width(content, strlen(content), fonts_.text_font, 0);
+    lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;
+    lv_coord_t min_width = 20;
+    lv_coord_t width = std::min(std::max(text_width, min_width), max_width);
+    lv_obj_set_width(label, width);
+    return width;
+}
+
+// 只给新的一句创建或复用一个标签，前面的句子不重新排版；气泡变高时只有新增的区域需要重绘
+void LcdDisplay::ApplyChatAppend(const char* role, const char* content) {
+    {
+        DisplayLockGuard lock(this);
+        if (content_ == nullptr || strlen(content) == 0) {
             return;
         }
-        
-        // Copy the header
-        copied_img_dsc->header = img_dsc->header;
-        copied_img_dsc->data_size = img_dsc->data_size;
-        
-        // Copy the image data
-        uint8_t* copied_data = (uint8_t*)heap_caps_malloc(img_dsc->data_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-        if (copied_data == nullptr) {
-            // Fallback to internal RAM if SPIRAM allocation fails
-            copied_data = (uint8_t*)heap_caps_malloc(img_dsc->data_size, MALLOC_CAP_8BIT);
+        if (chat_history_ && !chat_following_) {
+            ShowChatTail();
         }
-        if (copied_data == nullptr) {
-            ESP_LOGE(TAG, "Failed to allocate memory for image data (size: %lu bytes)", img_dsc->data_size);
-            heap_caps_free(copied_img_dsc);
-            lv_obj_del(img_bubble);
+        ChatRow* row = chat_last_row_ >= 0 ? &chat_rows_[chat_last_row_] : nullptr;
+        bool same_role = row != nullptr && row->image == nullptr &&
+            ((strcmp(role, "assistant") == 0 && row->type == kChatBubbleAssistant) ||
+             (strcmp(role, "user") == 0 && row->type == kChatBubbleUser));
+        if (same_role && row->segment_count < CHAT_MAX_SEGMENTS) {
+            chat_message_label_ = AddChatSegment(*row, content);
+            if (chat_history_) {
+                chat_history_->Append(row->type, true, content);
+            }
+            lv_obj_scroll_to_view_recursive(row->container, LV_ANIM_ON);
             return;
         }
-        
-        memcpy(copied_data, img_dsc->data, img_dsc->data_size);
-        copied_img_dsc->data = copied_data;
-        
-        // Calculate appropriate size for the image
-        lv_coord_t max_width = LV_HOR_RES * 70 / 100;  // 70% of screen width
-        lv_coord_t max_height = LV_VER_RES * 50 / 100; // 50% of screen height
-        
-        // Calculate zoom factor to fit within maximum dimensions
-        lv_coord_t img_width = copied_img_dsc->header.w;
-        lv_coord_t img_height = copied_img_dsc->header.h;
-        
-        lv_coord_t zoom_w = (max_width * 256) / img_width;
-        lv_coord_t zoom_h = (max_height * 256) / img_height;
-        lv_coord_t zoom = (zoom_w < zoom_h) ? zoom_w : zoom_h;
-        
-        // Ensure zoom doesn't exceed 256 (100%)
-        if (zoom > 256) zoom = 256;
-        
-        // Set image properties
-        lv_image_set_src(preview_image, copied_img_dsc);
-        lv_image_set_scale(preview_image, zoom);
-        
-        // Add event handler to clean up copied data when image is deleted
-        lv_obj_add_event_cb(preview_image, [](lv_event_t* e) {
-            lv_img_dsc_t* copied_img_dsc = (lv_img_dsc_t*)lv_event_get_user_data(e);
-            if (copied_img_dsc != nullptr) {
-                heap_caps_free((void*)copied_img_dsc->data);
-                heap_caps_free(copied_img_dsc);
-            }
-        }, LV_EVENT_DELETE, (void*)copied_img_dsc);
-        
-        // Calculate actual scaled image dimensions
-        lv_coord_t scaled_width = (img_width * zoom) / 256;
-        lv_coord_t scaled_height = (img_height * zoom) / 256;
-        
-        // Set bubble size to be 16 pixels larger than the image (8 pixels on each side)
-        lv_obj_set_width(img_bubble, scaled_width + 16);
-        lv_obj_set_height(img_bubble, scaled_height + 16);
-        
-        // Don't grow in flex layout
-        lv_obj_set_style_flex_grow(img_bubble, 0, 0);
-        
-        // Center the image within the bubble
-        lv_obj_center(preview_image);
-        
-        // Left align the image bubble like assistant messages
-        lv_obj_align(img_bubble, LV_ALIGN_LEFT_MID, 0, 0);
-
-        // Auto-scroll to the image bubble
-        lv_obj_scroll_to_view_recursive(img_bubble, LV_ANIM_ON);
     }
+    ApplyChatMessage(role, content);
+}
+
+void LcdDisplay::AppendChatMessage(const char* role, const char* content) {
+#if CONFIG_DISPLAY_ASYNC_UPDATE
+    if (role != nullptr && content != nullptr) {
+        PostUiCommand({kUiChatAppend, role, content, 0});
+    }
+#else
+    ApplyChatAppend(role, content);
+#endif
+}
+
+void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
+    DisplayLockGuard lock(this);
+    if (content_ == nullptr || img_dsc == nullptr) {
+        return;
+    }
+
+    // Copy the image data to avoid source data changes
+    uint8_t* copied_data = (uint8_t*)heap_caps_malloc(img_dsc->data_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (copied_data == nullptr) {
+        // Fallback to internal RAM if SPIRAM allocation fails
+        copied_data = (uint8_t*)heap_caps_malloc(img_dsc->data_size, MALLOC_CAP_8BIT);
+    }
+    if (copied_data == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate memory for image data (size: %lu bytes)", img_dsc->data_size);
+        return;
+    }
+    
+    memcpy(copied_data, img_dsc->data, img_dsc->data_size);
+    auto image = new PreviewImage{*img_dsc, nullptr};
+    image->dsc.data = copied_data;
+    AdoptPreviewImage(image);
+}
+
+void LcdDisplay::AdoptPreviewImage(PreviewImage* image) {
+    DisplayLockGuard lock(this);
+    // 图片留在聊天记录里，随所在的行一起删除
+    if (content_ == nullptr || image == nullptr) {
+        FreePreviewImage(image);
+        return;
+    }
+    auto copied_img_dsc = &image->dsc;
+
+    if (chat_history_ && !chat_following_) {
+        ShowChatTail();
+    }
+    // 图片也占用一行，文本隐藏
+    auto& row = AcquireChatRow();
+    SetChatRowType(row, kChatBubbleImage);
+    lv_obj_add_flag(row.label, LV_OBJ_FLAG_HIDDEN);
+
+    // Create the image object inside the bubble
+    row.image = lv_image_create(row.bubble);
+    
+    // Calculate appropriate size for the image
+    lv_coord_t max_width = LV_HOR_RES * 70 / 100;  // 70% of screen width
+    lv_coord_t max_height = LV_VER_RES * 50 / 100; // 50% of screen height
+    
+    // Calculate zoom factor to fit within maximum dimensions
+    lv_coord_t img_width = copied_img_dsc->header.w;
+    lv_coord_t img_height = copied_img_dsc->header.h;
+    
+    lv_coord_t zoom_w = (max_width * 256) / img_width;
+    lv_coord_t zoom_h = (max_height * 256) / img_height;
+    lv_coord_t zoom = (zoom_w < zoom_h) ? zoom_w : zoom_h;
+    
+    // Ensure zoom doesn't exceed 256 (100%)
+    if (zoom > 256) zoom = 256;
+    
+    // Set image properties
+    lv_image_set_src(row.image, copied_img_dsc);
+    lv_image_set_scale(row.image, zoom);
+    
+    // Add event handler to clean up copied data when image is deleted
+    lv_obj_add_event_cb(row.image, [](lv_event_t* e) {
+        FreePreviewImage((PreviewImage*)lv_event_get_user_data(e));
+    }, LV_EVENT_DELETE, (void*)image);
+    
+    // Calculate actual scaled image dimensions
+    lv_coord_t scaled_width = (img_width * zoom) / 256;
+    lv_coord_t scaled_height = (img_height * zoom) / 256;
+    
+    // Set bubble size to be 16 pixels larger than the image (8 pixels on each side)
+    lv_obj_set_size(row.bubble, scaled_width + 16, scaled_height + 16);
+    
+    // Center the image within the bubble
+    lv_obj_center(row.image);
+    
+    // Left align the image bubble like assistant messages
+    lv_obj_align(row.bubble, LV_ALIGN_LEFT_MID, 0, 0);
+
+    // Auto-scroll to the image bubble
+    lv_obj_scroll_to_view_recursive(row.container, LV_ANIM_ON);
 }
 #else
 void LcdDisplay::SetupUI() {
     DisplayLockGuard lock(this);
+#if CONFIG_USE_ASSETS_PARTITION
+    LoadAssetFonts();
+#endif
+    StartPerfMonitor();
+    InitializeRefreshControl();
+    InitializeThemeStyles();
+    InitializeUiQueue();
 
     auto screen = lv_screen_active();
     lv_obj_set_style_text_font(screen, fonts_.text_font, 0);
-    lv_obj_set_style_text_color(screen, current_theme_.text, 0);
-    lv_obj_set_style_bg_color(screen, current_theme_.background, 0);
+    lv_obj_add_style(screen, &theme_styles_.surface, 0);
 
     /* Container */
     container_ = lv_obj_create(screen);
@@ -718,15 +1214,13 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_style_pad_all(container_, 0, 0);
     lv_obj_set_style_border_width(container_, 0, 0);
     lv_obj_set_style_pad_row(container_, 0, 0);
-    lv_obj_set_style_bg_color(container_, current_theme_.background, 0);
-    lv_obj_set_style_border_color(container_, current_theme_.border, 0);
+    lv_obj_add_style(container_, &theme_styles_.surface, 0);
 
     /* Status bar */
     status_bar_ = lv_obj_create(container_);
     lv_obj_set_size(status_bar_, LV_HOR_RES, fonts_.text_font->line_height);
     lv_obj_set_style_radius(status_bar_, 0, 0);
-    lv_obj_set_style_bg_color(status_bar_, current_theme_.background, 0);
-    lv_obj_set_style_text_color(status_bar_, current_theme_.text, 0);
+    lv_obj_add_style(status_bar_, &theme_styles_.surface, 0);
     
     /* Content */
     content_ = lv_obj_create(container_);
@@ -735,17 +1229,20 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_width(content_, LV_HOR_RES);
     lv_obj_set_flex_grow(content_, 1);
     lv_obj_set_style_pad_all(content_, 5, 0);
-    lv_obj_set_style_bg_color(content_, current_theme_.chat_background, 0);
-    lv_obj_set_style_border_color(content_, current_theme_.border, 0); // Border color for content
+    lv_obj_add_style(content_, &theme_styles_.content, 0);
 
     lv_obj_set_flex_flow(content_, LV_FLEX_FLOW_COLUMN); // 垂直布局（从上到下）
     lv_obj_set_flex_align(content_, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_SPACE_EVENLY); // 子对象居中对齐，等距分布
 
     emotion_label_ = lv_label_create(content_);
     lv_obj_set_style_text_font(emotion_label_, &font_awesome_30_4, 0);
-    lv_obj_set_style_text_color(emotion_label_, current_theme_.text, 0);
+    lv_obj_add_style(emotion_label_, &theme_styles_.text, 0);
     lv_label_set_text(emotion_label_, FONT_AWESOME_AI_CHIP);
 
+    // 图片字体的表情直接显示图片，和 emotion_label_ 占同一个位置，同时只显示一个
+    emotion_image_ = lv_image_create(content_);
+    lv_obj_add_flag(emotion_image_, LV_OBJ_FLAG_HIDDEN);
+
     preview_image_ = lv_image_create(content_);
     lv_obj_set_size(preview_image_, width_ * 0.5, height_ * 0.5);
     lv_obj_align(preview_image_, LV_ALIGN_CENTER, 0, 0);
@@ -756,7 +1253,7 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_width(chat_message_label_, LV_HOR_RES * 0.9); // 限制宽度为屏幕宽度的 90%
     lv_label_set_long_mode(chat_message_label_, LV_LABEL_LONG_WRAP); // 设置为自动换行模式
     lv_obj_set_style_text_align(chat_message_label_, LV_TEXT_ALIGN_CENTER, 0); // 设置文本居中对齐
-    lv_obj_set_style_text_color(chat_message_label_, current_theme_.text, 0);
+    lv_obj_add_style(chat_message_label_, &theme_styles_.text, 0);
 
     /* Status bar */
     lv_obj_set_flex_flow(status_bar_, LV_FLEX_FLOW_ROW);
@@ -769,12 +1266,12 @@ void LcdDisplay::SetupUI() {
     network_label_ = lv_label_create(status_bar_);
     lv_label_set_text(network_label_, "");
     lv_obj_set_style_text_font(network_label_, fonts_.icon_font, 0);
-    lv_obj_set_style_text_color(network_label_, current_theme_.text, 0);
+    lv_obj_add_style(network_label_, &theme_styles_.text, 0);
 
     notification_label_ = lv_label_create(status_bar_);
     lv_obj_set_flex_grow(notification_label_, 1);
     lv_obj_set_style_text_align(notification_label_, LV_TEXT_ALIGN_CENTER, 0);
-    lv_obj_set_style_text_color(notification_label_, current_theme_.text, 0);
+    lv_obj_add_style(notification_label_, &theme_styles_.text, 0);
     lv_label_set_text(notification_label_, "");
     lv_obj_add_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
 
@@ -782,23 +1279,23 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_flex_grow(status_label_, 1);
     lv_label_set_long_mode(status_label_, LV_LABEL_LONG_SCROLL_CIRCULAR);
     lv_obj_set_style_text_align(status_label_, LV_TEXT_ALIGN_CENTER, 0);
-    lv_obj_set_style_text_color(status_label_, current_theme_.text, 0);
+    lv_obj_add_style(status_label_, &theme_styles_.text, 0);
     lv_label_set_text(status_label_, Lang::Strings::INITIALIZING);
     mute_label_ = lv_label_create(status_bar_);
     lv_label_set_text(mute_label_, "");
     lv_obj_set_style_text_font(mute_label_, fonts_.icon_font, 0);
-    lv_obj_set_style_text_color(mute_label_, current_theme_.text, 0);
+    lv_obj_add_style(mute_label_, &theme_styles_.text, 0);
 
     battery_label_ = lv_label_create(status_bar_);
     lv_label_set_text(battery_label_, "");
     lv_obj_set_style_text_font(battery_label_, fonts_.icon_font, 0);
-    lv_obj_set_style_text_color(battery_label_, current_theme_.text, 0);
+    lv_obj_add_style(battery_label_, &theme_styles_.text, 0);
 
     low_battery_popup_ = lv_obj_create(screen);
     lv_obj_set_scrollbar_mode(low_battery_popup_, LV_SCROLLBAR_MODE_OFF);
     lv_obj_set_size(low_battery_popup_, LV_HOR_RES * 0.9, fonts_.text_font->line_height * 2);
     lv_obj_align(low_battery_popup_, LV_ALIGN_BOTTOM_MID, 0, 0);
-    lv_obj_set_style_bg_color(low_battery_popup_, current_theme_.low_battery, 0);
+    lv_obj_add_style(low_battery_popup_, &theme_styles_.low_battery, 0);
     lv_obj_set_style_radius(low_battery_popup_, 10, 0);
     low_battery_label_ = lv_label_create(low_battery_popup_);
     lv_label_set_text(low_battery_label_, Lang::Strings::BATTERY_NEED_CHARGE);
@@ -819,93 +1316,239 @@ void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
         // 设置图片源并显示预览图片
         lv_image_set_src(preview_image_, img_dsc);
         lv_obj_clear_flag(preview_image_, LV_OBJ_FLAG_HIDDEN);
-        // 隐藏emotion_label_
-        if (emotion_label_ != nullptr) {
-            lv_obj_add_flag(emotion_label_, LV_OBJ_FLAG_HIDDEN);
-        }
     } else {
-        // 隐藏预览图片并显示emotion_label_
+        // 隐藏预览图片，恢复之前的表情
         lv_obj_add_flag(preview_image_, LV_OBJ_FLAG_HIDDEN);
-        if (emotion_label_ != nullptr) {
-            lv_obj_clear_flag(emotion_label_, LV_OBJ_FLAG_HIDDEN);
-        }
     }
+    if (emotion_label_ != nullptr) {
+        ShowEmotionImage(emotion_image_shown_);
+    }
+}
+
+void LcdDisplay::AdoptPreviewImage(PreviewImage* image) {
+    DisplayLockGuard lock(this);
+    if (preview_image_ == nullptr) {
+        FreePreviewImage(image);
+        return;
+    }
+    // 图片控件直接引用数据，替换之后才能释放上一张
+    SetPreviewImage(image != nullptr ? &image->dsc : nullptr);
+    FreePreviewImage(adopted_preview_);
+    adopted_preview_ = image;
 }
 #endif
 
-void LcdDisplay::SetEmotion(const char* emotion) {
-    struct Emotion {
-        const char* icon;
-        const char* text;
-    };
+// emoji 字体是图片字体时取出字符对应的图片，之后切换表情只需要换图片控件的图片源
+// 普通的位图字体没有图片，返回 nullptr，仍然用标签显示
+const void* LcdDisplay::GetEmotionImage(Emotion emotion) {
+    if (emotion_images_resolved_ & (1u << emotion)) {
+        return emotion_images_[emotion];
+    }
+    emotion_images_resolved_ |= 1u << emotion;
+    if (fonts_.emoji_font == nullptr) {
+        return nullptr;
+    }
+    uint32_t index = 0;
+    uint32_t letter = lv_text_encoded_next(GetEmotionInfo(emotion).emoji, &index);
+    lv_font_glyph_dsc_t dsc = {};
+    if (lv_font_get_glyph_dsc(fonts_.emoji_font, &dsc, letter, 0) && dsc.format == LV_FONT_GLYPH_FORMAT_IMAGE) {
+        emotion_images_[emotion] = dsc.gid.src;
+    }
+    return emotion_images_[emotion];
+}
 
-    static const std::vector<Emotion> emotions = {
-        {"😶", "neutral"},
-        {"🙂", "happy"},
-        {"😆", "laughing"},
-        {"😂", "funny"},
-        {"😔", "sad"},
-        {"😠", "angry"},
-        {"😭", "crying"},
-        {"😍", "loving"},
-        {"😳", "embarrassed"},
-        {"😯", "surprised"},
-        {"😱", "shocked"},
-        {"🤔", "thinking"},
-        {"😉", "winking"},
-        {"😎", "cool"},
-        {"😌", "relaxed"},
-        {"🤤", "delicious"},
-        {"😘", "kissy"},
-        {"😏", "confident"},
-        {"😴", "sleepy"},
-        {"😜", "silly"},
-        {"🙄", "confused"}
-    };
-    
-    // 查找匹配的表情
-    std::string_view emotion_view(emotion);
-    auto it = std::find_if(emotions.begin(), emotions.end(),
-        [&emotion_view](const Emotion& e) { return e.text == emotion_view; });
+// 显示表情图片或者标签，另一个隐藏；预览图片显示时两个都隐藏
+void LcdDisplay::ShowEmotionImage(bool image) {
+    emotion_image_shown_ = image;
+    bool preview = false;
+#if !CONFIG_USE_WECHAT_MESSAGE_STYLE
+    preview = preview_image_ != nullptr && !lv_obj_has_flag(preview_image_, LV_OBJ_FLAG_HIDDEN);
+#endif
+    SetHidden(emotion_label_, preview || image);
+    if (emotion_image_ != nullptr) {
+        SetHidden(emotion_image_, preview || !image);
+    }
+}
+
+void LcdDisplay::ApplyEmotion(const char* emotion) {
+    auto id = FindEmotion(emotion);
 
     DisplayLockGuard lock(this);
     if (emotion_label_ == nullptr) {
         return;
     }
+#if !CONFIG_USE_WECHAT_MESSAGE_STYLE
+    // 表情替换拍照预览
+    if (preview_image_ != nullptr) {
+        SetHidden(preview_image_, true);
+    }
+#endif
+
+    // 同样大小的图片换源只重绘控件所在的区域，不需要重新排版
+    auto image = emotion_image_ != nullptr ? GetEmotionImage(id) : nullptr;
+    if (image != nullptr) {
+        if (lv_image_get_src(emotion_image_) != image) {
+            lv_image_set_src(emotion_image_, image);
+        }
+        ShowEmotionImage(true);
+        return;
+    }
 
     // 如果找到匹配的表情就显示对应图标，否则显示默认的neutral表情
-    lv_obj_set_style_text_font(emotion_label_, fonts_.emoji_font, 0);
-    if (it != emotions.end()) {
-        lv_label_set_text(emotion_label_, it->icon);
-    } else {
-        lv_label_set_text(emotion_label_, "😶");
+    if (lv_obj_get_style_text_font(emotion_label_, 0) != fonts_.emoji_font) {
+        lv_obj_set_style_text_font(emotion_label_, fonts_.emoji_font, 0);
     }
+    SetLabelText(emotion_label_, GetEmotionInfo(id).emoji);
+    ShowEmotionImage(false);
+}
 
+void LcdDisplay::ApplyIcon(const char* icon) {
+    DisplayLockGuard lock(this);
+    if (emotion_label_ == nullptr) {
+        return;
+    }
 #if !CONFIG_USE_WECHAT_MESSAGE_STYLE
-    // 显示emotion_label_，隐藏preview_image_
-    lv_obj_clear_flag(emotion_label_, LV_OBJ_FLAG_HIDDEN);
+    // 图标替换拍照预览
     if (preview_image_ != nullptr) {
-        lv_obj_add_flag(preview_image_, LV_OBJ_FLAG_HIDDEN);
+        SetHidden(preview_image_, true);
+    }
+#endif
+    if (lv_obj_get_style_text_font(emotion_label_, 0) != &font_awesome_30_4) {
+        lv_obj_set_style_text_font(emotion_label_, &font_awesome_30_4, 0);
     }
+    SetLabelText(emotion_label_, icon);
+    ShowEmotionImage(false);
+}
+
+void LcdDisplay::SetEmotion(const char* emotion) {
+#if CONFIG_DISPLAY_ASYNC_UPDATE
+    if (emotion != nullptr) {
+        PostUiCommand({kUiEmotion, {}, emotion, 0});
+    }
+#else
+    ApplyEmotion(emotion);
 #endif
 }
 
 void LcdDisplay::SetIcon(const char* icon) {
-    DisplayLockGuard lock(this);
-    if (emotion_label_ == nullptr) {
-        return;
+#if CONFIG_DISPLAY_ASYNC_UPDATE
+    if (icon != nullptr) {
+        PostUiCommand({kUiIcon, {}, icon, 0});
     }
-    lv_obj_set_style_text_font(emotion_label_, &font_awesome_30_4, 0);
-    lv_label_set_text(emotion_label_, icon);
+#else
+    ApplyIcon(icon);
+#endif
+}
+
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+void LcdDisplay::SetChatMessage(const char* role, const char* content) {
+#if CONFIG_DISPLAY_ASYNC_UPDATE
+    if (role != nullptr && content != nullptr) {
+        PostUiCommand({kUiChatMessage, role, content, 0});
+    }
+#else
+    ApplyChatMessage(role, content);
+#endif
+}
+#endif
+
+#if CONFIG_DISPLAY_ASYNC_UPDATE
+void LcdDisplay::SetStatus(const char* status) {
+    if (status != nullptr) {
+        PostUiCommand({kUiStatus, {}, status, 0});
+    }
+}
+
+void LcdDisplay::ShowNotification(const char* notification, int duration_ms) {
+    if (notification != nullptr) {
+        PostUiCommand({kUiNotification, {}, notification, duration_ms});
+    }
+}
 
 #if !CONFIG_USE_WECHAT_MESSAGE_STYLE
-    // 显示emotion_label_，隐藏preview_image_
-    lv_obj_clear_flag(emotion_label_, LV_OBJ_FLAG_HIDDEN);
-    if (preview_image_ != nullptr) {
-        lv_obj_add_flag(preview_image_, LV_OBJ_FLAG_HIDDEN);
+void LcdDisplay::SetChatMessage(const char* role, const char* content) {
+    if (role != nullptr && content != nullptr) {
+        PostUiCommand({kUiChatMessage, role, content, 0});
+    }
+}
+#endif
+
+// 调用方只在入队时短暂持有 ui_mutex_，不等待 LVGL 渲染
+// 状态、通知、表情和图标只有最后一次有效，入队时去掉同类的旧命令，保留各类命令之间的先后顺序
+void LcdDisplay::PostUiCommand(UiCommand&& command) {
+    {
+        std::lock_guard<std::mutex> lock(ui_mutex_);
+        if (command.type != kUiChatMessage && command.type != kUiChatAppend) {
+            for (auto it = ui_commands_.begin(); it != ui_commands_.end(); ++it) {
+                if (it->type == command.type) {
+                    ui_commands_.erase(it);
+                    break;
+                }
+            }
+        }
+        ui_commands_.push_back(std::move(command));
+    }
+#if CONFIG_DISPLAY_ADAPTIVE_REFRESH
+    // 暂停中的 LVGL 任务需要恢复才能处理命令
+    last_activity_us_ = esp_timer_get_time();
+    if (lvgl_suspended_.exchange(false)) {
+        lvgl_port_resume();
+    }
+#endif
+}
+
+void LcdDisplay::InitializeUiQueue() {
+    if (display_ != nullptr) {
+        lv_display_add_event_cb(display_, OnRefreshStart, LV_EVENT_REFR_START, this);
     }
+}
+
+// 每帧开始刷新前在 LVGL 任务中批量执行，已经持有 LVGL 锁
+void LcdDisplay::OnRefreshStart(lv_event_t* e) {
+    auto self = static_cast<LcdDisplay*>(lv_event_get_user_data(e));
+    std::deque<UiCommand> commands;
+    {
+        std::lock_guard<std::mutex> lock(self->ui_mutex_);
+        if (self->ui_commands_.empty()) {
+            return;
+        }
+        commands.swap(self->ui_commands_);
+    }
+    for (auto& command : commands) {
+        switch (command.type) {
+        case kUiStatus:
+            self->Display::SetStatus(command.text.c_str());
+            break;
+        case kUiNotification:
+            self->Display::ShowNotification(command.text.c_str(), command.duration_ms);
+            break;
+        case kUiEmotion:
+            self->ApplyEmotion(command.text.c_str());
+            break;
+        case kUiIcon:
+            self->ApplyIcon(command.text.c_str());
+            break;
+        case kUiChatMessage:
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+            self->ApplyChatMessage(command.role.c_str(), command.text.c_str());
+#else
+            self->Display::SetChatMessage(command.role.c_str(), command.text.c_str());
+#endif
+            break;
+        case kUiChatAppend:
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+            self->ApplyChatAppend(command.role.c_str(), command.text.c_str());
+#else
+            self->Display::SetChatMessage(command.role.c_str(), command.text.c_str());
 #endif
+            break;
+        }
+    }
 }
+#else
+void LcdDisplay::InitializeUiQueue() {
+}
+#endif
 
 void LcdDisplay::SetTheme(const std::string& theme_name) {
     DisplayLockGuard lock(this);
@@ -920,182 +1563,9 @@ void LcdDisplay::SetTheme(const std::string& theme_name) {
         return;
     }
     
-    // Get the active screen
-    lv_obj_t* screen = lv_screen_active();
-    
-    // Update the screen colors
-    lv_obj_set_style_bg_color(screen, current_theme_.background, 0);
-    lv_obj_set_style_text_color(screen, current_theme_.text, 0);
-    
-    // Update container colors
-    if (container_ != nullptr) {
-        lv_obj_set_style_bg_color(container_, current_theme_.background, 0);
-        lv_obj_set_style_border_color(container_, current_theme_.border, 0);
-    }
-    
-    // Update status bar colors
-    if (status_bar_ != nullptr) {
-        lv_obj_set_style_bg_color(status_bar_, current_theme_.background, 0);
-        lv_obj_set_style_text_color(status_bar_, current_theme_.text, 0);
-        
-        // Update status bar elements
-        if (network_label_ != nullptr) {
-            lv_obj_set_style_text_color(network_label_, current_theme_.text, 0);
-        }
-        if (status_label_ != nullptr) {
-            lv_obj_set_style_text_color(status_label_, current_theme_.text, 0);
-        }
-        if (notification_label_ != nullptr) {
-            lv_obj_set_style_text_color(notification_label_, current_theme_.text, 0);
-        }
-        if (mute_label_ != nullptr) {
-            lv_obj_set_style_text_color(mute_label_, current_theme_.text, 0);
-        }
-        if (battery_label_ != nullptr) {
-            lv_obj_set_style_text_color(battery_label_, current_theme_.text, 0);
-        }
-        if (emotion_label_ != nullptr) {
-            lv_obj_set_style_text_color(emotion_label_, current_theme_.text, 0);
-        }
-    }
-    
-    // Update content area colors
-    if (content_ != nullptr) {
-        lv_obj_set_style_bg_color(content_, current_theme_.chat_background, 0);
-        lv_obj_set_style_border_color(content_, current_theme_.border, 0);
-        
-        // If we have the chat message style, update all message bubbles
-#if CONFIG_USE_WECHAT_MESSAGE_STYLE
-        // Iterate through all children of content (message containers or bubbles)
-        uint32_t child_count = lv_obj_get_child_cnt(content_);
-        for (uint32_t i = 0; i < child_count; i++) {
-            lv_obj_t* obj = lv_obj_get_child(content_, i);
-            if (obj == nullptr) continue;
-            
-            lv_obj_t* bubble = nullptr;
-            
-            // 检查这个对象是容器还是气泡
-            // 如果是容器（用户或系统消息），则获取其子对象作为气泡
-            // 如果是气泡（助手消息），则直接使用
-            if (lv_obj_get_child_cnt(obj) > 0) {
-                // 可能是容器，检查它是否为用户或系统消息容器
-                // 用户和系统消息容器是透明的
-                lv_opa_t bg_opa = lv_obj_get_style_bg_opa(obj, 0);
-                if (bg_opa == LV_OPA_TRANSP) {
-                    // 这是用户或系统消息的容器
-                    bubble = lv_obj_get_child(obj, 0);
-                } else {
-                    // 这可能是助手消息的气泡自身
-                    bubble = obj;
-                }
-            } else {
-                // 没有子元素，可能是其他UI元素，跳过
-                continue;
-            }
-            
-            if (bubble == nullptr) continue;
-            
-            // 使用保存的用户数据来识别气泡类型
-            void* bubble_type_ptr = lv_obj_get_user_data(bubble);
-            if (bubble_type_ptr != nullptr) {
-                const char* bubble_type = static_cast<const char*>(bubble_type_ptr);
-                
-                // 根据气泡类型应用正确的颜色
-                if (strcmp(bubble_type, "user") == 0) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.user_bubble, 0);
-                } else if (strcmp(bubble_type, "assistant") == 0) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.assistant_bubble, 0); 
-                } else if (strcmp(bubble_type, "system") == 0) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.system_bubble, 0);
-                } else if (strcmp(bubble_type, "image") == 0) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.system_bubble, 0);
-                }
-                
-                // Update border color
-                lv_obj_set_style_border_color(bubble, current_theme_.border, 0);
-                
-                // Update text color for the message
-                if (lv_obj_get_child_cnt(bubble) > 0) {
-                    lv_obj_t* text = lv_obj_get_child(bubble, 0);
-                    if (text != nullptr) {
-                        // 根据气泡类型设置文本颜色
-                        if (strcmp(bubble_type, "system") == 0) {
-                            lv_obj_set_style_text_color(text, current_theme_.system_text, 0);
-                        } else {
-                            lv_obj_set_style_text_color(text, current_theme_.text, 0);
-                        }
-                    }
-                }
-            } else {
-                // 如果没有标记，回退到之前的逻辑（颜色比较）
-                // ...保留原有的回退逻辑...
-                lv_color_t bg_color = lv_obj_get_style_bg_color(bubble, 0);
-            
-                // 改进bubble类型检测逻辑，不仅使用颜色比较
-                bool is_user_bubble = false;
-                bool is_assistant_bubble = false;
-                bool is_system_bubble = false;
-            
-                // 检查用户bubble
-                if (lv_color_eq(bg_color, DARK_USER_BUBBLE_COLOR) || 
-                    lv_color_eq(bg_color, LIGHT_USER_BUBBLE_COLOR) ||
-                    lv_color_eq(bg_color, current_theme_.user_bubble)) {
-                    is_user_bubble = true;
-                }
-                // 检查系统bubble
-                else if (lv_color_eq(bg_color, DARK_SYSTEM_BUBBLE_COLOR) || 
-                         lv_color_eq(bg_color, LIGHT_SYSTEM_BUBBLE_COLOR) ||
-                         lv_color_eq(bg_color, current_theme_.system_bubble)) {
-                    is_system_bubble = true;
-                }
-                // 剩余的都当作助手bubble处理
-                else {
-                    is_assistant_bubble = true;
-                }
-            
-                // 根据bubble类型应用正确的颜色
-                if (is_user_bubble) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.user_bubble, 0);
-                } else if (is_assistant_bubble) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.assistant_bubble, 0);
-                } else if (is_system_bubble) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.system_bubble, 0);
-                }
-                
-                // Update border color
-                lv_obj_set_style_border_color(bubble, current_theme_.border, 0);
-                
-                // Update text color for the message
-                if (lv_obj_get_child_cnt(bubble) > 0) {
-                    lv_obj_t* text = lv_obj_get_child(bubble, 0);
-                    if (text != nullptr) {
-                        // 回退到颜色检测逻辑
-                        if (lv_color_eq(bg_color, current_theme_.system_bubble) ||
-                            lv_color_eq(bg_color, DARK_SYSTEM_BUBBLE_COLOR) || 
-                            lv_color_eq(bg_color, LIGHT_SYSTEM_BUBBLE_COLOR)) {
-                            lv_obj_set_style_text_color(text, current_theme_.system_text, 0);
-                        } else {
-                            lv_obj_set_style_text_color(text, current_theme_.text, 0);
-                        }
-                    }
-                }
-            }
-        }
-#else
-        // Simple UI mode - just update the main chat message
-        if (chat_message_label_ != nullptr) {
-            lv_obj_set_style_text_color(chat_message_label_, current_theme_.text, 0);
-        }
-        
-        if (emotion_label_ != nullptr) {
-            lv_obj_set_style_text_color(emotion_label_, current_theme_.text, 0);
-        }
-#endif
-    }
-    
-    // Update low battery popup
-    if (low_battery_popup_ != nullptr) {
-        lv_obj_set_style_bg_color(low_battery_popup_, current_theme_.low_battery, 0);
+    if (theme_styles_ready_) {
+        ApplyThemeStyles();
+        lv_obj_report_style_change(nullptr);
     }
 
     // No errors occurred. Save theme to settings
@@ -2,12 +2,21 @@
 #define LCD_DISPLAY_H
 
 #include "display.h"
+#include "glyph_cache_font.h"
+#include "chat_history.h"
+#include "memory_profile.h"
+#include "emotions.h"
 
 #include <esp_lcd_panel_io.h>
 #include <esp_lcd_panel_ops.h>
 #include <font_emoji.h>
 
 #include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 // Theme color structure
 struct ThemeColors {
@@ -22,6 +31,26 @@ struct ThemeColors {
     lv_color_t low_battery;
 };
 
+// LVGL 绘制缓冲区配置，由板子按屏幕接口和内存余量选择
+struct LcdBufferProfile {
+    // 每块绘制缓冲区的行数，不小于屏幕高度时整帧渲染，默认值按板子的内存档位选择
+    int buffer_lines = MEMORY_PROFILE_LCD_BUFFER_LINES;
+    // 双缓冲时渲染下一块和 DMA 发送上一块可以并行
+    bool double_buffer = false;
+    // 绘制缓冲区放在 PSRAM 中省下内部 RAM，需要配合 trans_lines 经内部 DMA 缓冲区中转
+    bool spiram = false;
+    // DMA 中转缓冲区行数，0 表示直接从绘制缓冲区发送
+    int trans_lines = 0;
+    // 只对 MIPI-DSI 有效：直接在 DPI 面板的整帧缓冲区中绘制并切换，忽略以上选项
+    bool direct_mode = false;
+};
+
+// MIPI-DSI 面板创建 DPI 面板时使用的帧缓冲区数量，直通模式需要两块
+#if CONFIG_LCD_MIPI_DIRECT_MODE
+#define MIPI_DPI_FRAME_BUFFERS 2
+#else
+#define MIPI_DPI_FRAME_BUFFERS 1
+#endif
 
 class LcdDisplay : public Display {
 protected:
@@ -34,14 +63,158 @@ protected:
     lv_obj_t* container_ = nullptr;
     lv_obj_t* side_bar_ = nullptr;
     lv_obj_t* preview_image_ = nullptr;
+    // emoji 字体是图片字体时显示表情的图片控件，emotion_image_shown_ 表示当前表情用图片显示
+    lv_obj_t* emotion_image_ = nullptr;
+    bool emotion_image_shown_ = false;
+    // 按表情编号缓存字体中的图片，第一次用到时查找
+    const void* emotion_images_[kEmotionCount] = {};
+    uint32_t emotion_images_resolved_ = 0;
 
     DisplayFonts fonts_;
     ThemeColors current_theme_;
+#if CONFIG_DISPLAY_GLYPH_CACHE
+    std::unique_ptr<GlyphCacheFont> text_font_cache_;
+    bool low_memory_ = false;
+#endif
+
+    // 按主题和角色共享的样式，控件只引用它们，不设置本地颜色
+    struct ThemeStyles {
+        lv_style_t surface;     // 屏幕、容器和状态栏
+        lv_style_t content;     // 内容区
+        lv_style_t text;        // 标签文字
+        lv_style_t low_battery;
+        lv_style_t user_bubble;
+        lv_style_t assistant_bubble;
+        lv_style_t system_bubble;
+    };
+    ThemeStyles theme_styles_;
+    bool theme_styles_ready_ = false;
+    void InitializeThemeStyles();
+    void ApplyThemeStyles();
+
+#if !CONFIG_USE_WECHAT_MESSAGE_STYLE
+    // 通过 AdoptPreviewImage 接管的图片，preview_image_ 正在引用它
+    PreviewImage* adopted_preview_ = nullptr;
+#endif
+
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+    enum ChatBubbleType : uint8_t {
+        kChatBubbleUser,
+        kChatBubbleAssistant,
+        kChatBubbleSystem,
+        kChatBubbleImage,
+    };
+    // 图片行和没有聊天记录时行的 seq
+    static constexpr uint32_t kChatNoRecord = UINT32_MAX;
+    // 聊天气泡对象池，行在 content_ 中的顺序就是消息的顺序，容器的 user data 是行在池中的下标
+    struct ChatRow {
+        lv_obj_t* container = nullptr;
+        lv_obj_t* bubble = nullptr;
+        lv_obj_t* label = nullptr;
+        lv_obj_t* image = nullptr;
+        // 追加的句子各用一个标签，只排版新的一句；标签随行复用，segment_count 之后的隐藏
+        std::vector<lv_obj_t*> segments;
+        size_t segment_count = 0;
+        ChatBubbleType type = kChatBubbleSystem;
+        // 行显示的气泡在聊天记录中的第一条记录
+        uint32_t seq = kChatNoRecord;
+    };
+    std::vector<ChatRow> chat_rows_;
+    // 最新消息所在的行，回看历史时它被换走后为 -1
+    int chat_last_row_ = -1;
+    // 全部聊天记录以文本形式存放在 PSRAM 中，界面上最多只有 MAX_MESSAGES 行；
+    // 滚动到边缘时把另一端看不见的行换成更早或更新的消息。没有 PSRAM 时为空，只保留最近的行
+    std::unique_ptr<ChatHistory> chat_history_;
+    // 最后一行是最新的消息，新消息直接接在后面；否则先回到最新的消息
+    bool chat_following_ = true;
+
+    ChatRow& CreateChatRow();
+    ChatRow& AcquireChatRow();
+    // 按 content_ 中的顺序取行，负数从末尾数
+    ChatRow* ChatRowAt(int index);
+    bool IsChatRowVisible(const ChatRow& row);
+    void FillChatRow(ChatRow& row, ChatBubbleType type, const char* content);
+    lv_obj_t* AddChatSegment(ChatRow& row, const char* content);
+    void BindChatRow(ChatRow& row, uint32_t head);
+    void ShowChatTail();
+    void LoadOlderChat();
+    void LoadNewerChat();
+    static void OnChatScroll(lv_event_t* e);
+    lv_style_t* ChatBubbleStyle(ChatBubbleType type);
+    void SetChatRowType(ChatRow& row, ChatBubbleType type);
+#endif
 
     void SetupUI();
+#if CONFIG_USE_ASSETS_PARTITION
+    // 资源分区中有 text_font.bin / icon_font.bin 时替换编译进固件的字体
+    void LoadAssetFonts();
+#endif
     virtual bool Lock(int timeout_ms = 0) override;
     virtual void Unlock() override;
 
+#if CONFIG_DISPLAY_PERF_MONITOR
+    // 刷新性能统计，只在 LVGL 任务中访问
+    struct PerfStats {
+        int64_t window_start_us = 0;
+        int64_t refr_start_us = 0;
+        int64_t flush_wait_start_us = 0;
+        bool rendered = false;
+        uint32_t frames = 0;
+        int64_t render_us = 0;
+        int64_t render_max_us = 0;
+        int64_t flush_wait_us = 0;
+    };
+    PerfStats perf_;
+    static void OnPerfEvent(lv_event_t* e);
+#endif
+    void StartPerfMonitor();
+
+#if CONFIG_DISPLAY_ADAPTIVE_REFRESH
+    esp_timer_handle_t refresh_timer_ = nullptr;
+    std::atomic<bool> refresh_active_{false};
+    std::atomic<bool> sleeping_{false};
+    std::atomic<bool> throttled_{false};
+    std::atomic<bool> lvgl_suspended_{false};
+    // 最近一次渲染或界面更新的时间
+    std::atomic<int64_t> last_activity_us_{0};
+    static void OnRenderReady(lv_event_t* e);
+    void ApplyRefreshPeriod();
+    void CheckRefreshSuspend();
+#endif
+    void InitializeRefreshControl();
+
+#if CONFIG_DISPLAY_ASYNC_UPDATE
+    // 界面更新命令，由 LVGL 任务在每帧刷新前批量执行
+    enum UiCommandType : uint8_t {
+        kUiStatus,
+        kUiNotification,
+        kUiEmotion,
+        kUiIcon,
+        kUiChatMessage,
+        kUiChatAppend,
+    };
+    struct UiCommand {
+        UiCommandType type;
+        std::string role;
+        std::string text;
+        int duration_ms;
+    };
+    std::mutex ui_mutex_;
+    std::deque<UiCommand> ui_commands_;
+    void PostUiCommand(UiCommand&& command);
+    static void OnRefreshStart(lv_event_t* e);
+#endif
+    void InitializeUiQueue();
+    void ApplyEmotion(const char* emotion);
+    const void* GetEmotionImage(Emotion emotion);
+    void ShowEmotionImage(bool image);
+    void ApplyIcon(const char* icon);
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+    void ApplyChatMessage(const char* role, const char* content);
+    void ApplyChatAppend(const char* role, const char* content);
+    lv_coord_t FitChatLabel(lv_obj_t* label, const char* content);
+#endif
+
 protected:
     // 添加protected构造函数
     LcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel, DisplayFonts fonts, int width, int height);
@@ -51,12 +224,29 @@ public:
     virtual void SetEmotion(const char* emotion) override;
     virtual void SetIcon(const char* icon) override;
     virtual void SetPreviewImage(const lv_img_dsc_t* img_dsc) override;
-#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+    virtual void AdoptPreviewImage(PreviewImage* image) override;
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE || CONFIG_DISPLAY_ASYNC_UPDATE
     virtual void SetChatMessage(const char* role, const char* content) override; 
 #endif  
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+    virtual void AppendChatMessage(const char* role, const char* content) override;
+#endif
+#if CONFIG_DISPLAY_ASYNC_UPDATE
+    using Display::ShowNotification;
+    virtual void SetStatus(const char* status) override;
+    virtual void ShowNotification(const char* notification, int duration_ms = 3000) override;
+#endif
 
     // Add theme switching function
     virtual void SetTheme(const std::string& theme_name) override;
+#if CONFIG_DISPLAY_GLYPH_CACHE
+    virtual void SetLowMemory(bool low_memory) override;
+#endif
+#if CONFIG_DISPLAY_ADAPTIVE_REFRESH
+    virtual void SetRefreshActive(bool active) override;
+    virtual void SetSleeping(bool sleeping) override;
+    virtual void SetThrottled(bool throttled) override;
+#endif
 };
 
 // RGB LCD显示器
@@ -74,7 +264,15 @@ public:
     MipiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
                    int width, int height, int offset_x, int offset_y,
                    bool mirror_x, bool mirror_y, bool swap_xy,
-                   DisplayFonts fonts);
+                   DisplayFonts fonts, LcdBufferProfile profile = DefaultProfile());
+
+    // 开启 LCD_MIPI_DIRECT_MODE 时使用直通模式，否则使用 50 行的绘制缓冲区
+    static LcdBufferProfile DefaultProfile() {
+        LcdBufferProfile profile;
+        profile.buffer_lines = 50;
+        profile.direct_mode = MIPI_DPI_FRAME_BUFFERS > 1;
+        return profile;
+    }
 };
 
 // // SPI LCD显示器
@@ -83,7 +281,7 @@ public:
     SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
                   int width, int height, int offset_x, int offset_y,
                   bool mirror_x, bool mirror_y, bool swap_xy,
-                  DisplayFonts fonts);
+                  DisplayFonts fonts, LcdBufferProfile profile = {});
 };
 
 // QSPI LCD显示器
@@ -1,8 +1,10 @@
 #include "oled_display.h"
 #include "font_awesome_symbols.h"
 #include "assets/lang_config.h"
+#include "task_manifest.h"
 
 #include <string>
+#include <cstring>
 #include <algorithm>
 
 #include <esp_log.h>
@@ -21,14 +23,21 @@ OledDisplay::OledDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handl
 
     ESP_LOGI(TAG, "Initialize LVGL");
     lvgl_port_cfg_t port_cfg = ESP_LVGL_PORT_INIT_CONFIG();
-    port_cfg.task_priority = 1;
+    auto& lvgl_spec = TaskManifest::GetInstance().Get(kTaskLvgl);
+    port_cfg.task_priority = lvgl_spec.priority;
+    port_cfg.task_affinity = lvgl_spec.core;
     port_cfg.timer_period_ms = 50;
     lvgl_port_init(&port_cfg);
 
     ESP_LOGI(TAG, "Adding OLED display");
+#if CONFIG_OLED_PAGE_DIFF
+    esp_lcd_panel_handle_t lvgl_panel = CreatePageDiffPanel(panel_);
+#else
+    esp_lcd_panel_handle_t lvgl_panel = panel_;
+#endif
     const lvgl_port_display_cfg_t display_cfg = {
         .io_handle = panel_io_,
-        .panel_handle = panel_,
+        .panel_handle = lvgl_panel,
         .control_handle = nullptr,
         .buffer_size = static_cast<uint32_t>(width_ * height_),
         .double_buffer = false,
@@ -86,6 +95,109 @@ OledDisplay::~OledDisplay() {
     lvgl_port_deinit();
 }
 
+#if CONFIG_OLED_PAGE_DIFF
+esp_lcd_panel_handle_t OledDisplay::CreatePageDiffPanel(esp_lcd_panel_handle_t target) {
+    auto& diff = page_diff_;
+    diff.base = {};
+    diff.target = target;
+    diff.owner = this;
+    diff.width = width_;
+    diff.swapped = false;
+    diff.shadow.assign(width_ * ((height_ + 7) / 8), 0);
+    diff.known.assign(diff.shadow.size(), 0);
+
+    // 除了 draw_bitmap 都直接转发，改变屏幕映射的操作让影子缓冲失效
+    diff.base.draw_bitmap = DrawChangedPages;
+    diff.base.reset = [](esp_lcd_panel_t* panel) {
+        auto diff = __containerof(panel, PageDiffPanel, base);
+        std::fill(diff->known.begin(), diff->known.end(), 0);
+        return esp_lcd_panel_reset(diff->target);
+    };
+    diff.base.init = [](esp_lcd_panel_t* panel) {
+        auto diff = __containerof(panel, PageDiffPanel, base);
+        std::fill(diff->known.begin(), diff->known.end(), 0);
+        return esp_lcd_panel_init(diff->target);
+    };
+    diff.base.mirror = [](esp_lcd_panel_t* panel, bool mirror_x, bool mirror_y) {
+        auto diff = __containerof(panel, PageDiffPanel, base);
+        std::fill(diff->known.begin(), diff->known.end(), 0);
+        return esp_lcd_panel_mirror(diff->target, mirror_x, mirror_y);
+    };
+    diff.base.swap_xy = [](esp_lcd_panel_t* panel, bool swap_axes) {
+        auto diff = __containerof(panel, PageDiffPanel, base);
+        std::fill(diff->known.begin(), diff->known.end(), 0);
+        diff->swapped = swap_axes;
+        return esp_lcd_panel_swap_xy(diff->target, swap_axes);
+    };
+    diff.base.set_gap = [](esp_lcd_panel_t* panel, int x_gap, int y_gap) {
+        auto diff = __containerof(panel, PageDiffPanel, base);
+        std::fill(diff->known.begin(), diff->known.end(), 0);
+        return esp_lcd_panel_set_gap(diff->target, x_gap, y_gap);
+    };
+    diff.base.invert_color = [](esp_lcd_panel_t* panel, bool invert) {
+        auto diff = __containerof(panel, PageDiffPanel, base);
+        return esp_lcd_panel_invert_color(diff->target, invert);
+    };
+    diff.base.disp_on_off = [](esp_lcd_panel_t* panel, bool on) {
+        auto diff = __containerof(panel, PageDiffPanel, base);
+        return esp_lcd_panel_disp_on_off(diff->target, on);
+    };
+    diff.base.disp_sleep = [](esp_lcd_panel_t* panel, bool sleep) {
+        auto diff = __containerof(panel, PageDiffPanel, base);
+        return esp_lcd_panel_disp_sleep(diff->target, sleep);
+    };
+    return &diff.base;
+}
+
+esp_err_t OledDisplay::DrawChangedPages(esp_lcd_panel_t* panel, int x_start, int y_start, int x_end, int y_end, const void* color_data) {
+    auto diff = __containerof(panel, PageDiffPanel, base);
+    int width = x_end - x_start;
+    // 不是整页对齐的区域或者交换了坐标轴时无法按页比较，直接转发
+    if (diff->swapped || (y_start % 8) != 0 || (y_end % 8) != 0 || x_start < 0 || x_end > diff->width || width <= 0) {
+        return esp_lcd_panel_draw_bitmap(diff->target, x_start, y_start, x_end, y_end, color_data);
+    }
+
+    auto data = static_cast<const uint8_t*>(color_data);
+    bool sent = false;
+    esp_err_t ret = ESP_OK;
+    for (int page = y_start / 8; page < y_end / 8; page++) {
+        const uint8_t* row = data + (page - y_start / 8) * width;
+        uint8_t* shadow = diff->shadow.data() + page * diff->width + x_start;
+        uint8_t* known = diff->known.data() + page * diff->width + x_start;
+
+        // 找出这一页中第一个和最后一个变化的列
+        int first = -1, last = -1;
+        for (int x = 0; x < width; x++) {
+            if (!known[x] || shadow[x] != row[x]) {
+                if (first < 0) {
+                    first = x;
+                }
+                last = x;
+            }
+        }
+        if (first < 0) {
+            continue;
+        }
+
+        ret = esp_lcd_panel_draw_bitmap(diff->target, x_start + first, page * 8, x_start + last + 1, page * 8 + 8, row + first);
+        if (ret != ESP_OK) {
+            std::fill(known + first, known + last + 1, 0);
+            break;
+        }
+        memcpy(shadow + first, row + first, last - first + 1);
+        std::fill(known + first, known + last + 1, 1);
+        sent = true;
+    }
+
+    // 没有发送任何数据时不会触发 on_color_trans_done，需要在这里通知 LVGL 刷新完成
+    if (!sent) {
+        auto display = diff->owner->display_ != nullptr ? diff->owner->display_ : lv_display_get_default();
+        lv_display_flush_ready(display);
+    }
+    return ret;
+}
+#endif
+
 bool OledDisplay::Lock(int timeout_ms) {
     return lvgl_port_lock(timeout_ms);
 }
@@ -5,6 +5,16 @@
 
 #include <esp_lcd_panel_io.h>
 #include <esp_lcd_panel_ops.h>
+#include <esp_lcd_panel_interface.h>
+
+#include <vector>
+
+// OLED 面板 I2C 时钟，开启 OLED_I2C_FAST_CLOCK 后使用 SSD1306 类芯片实测可用的 800kHz
+#if CONFIG_OLED_I2C_FAST_CLOCK
+#define OLED_I2C_SCL_SPEED_HZ (800 * 1000)
+#else
+#define OLED_I2C_SCL_SPEED_HZ (400 * 1000)
+#endif
 
 class OledDisplay : public Display {
 private:
@@ -20,6 +30,24 @@ private:
 
     DisplayFonts fonts_;
 
+#if CONFIG_OLED_PAGE_DIFF
+    // 面板代理：LVGL 端口按 SSD1306 的页格式（每字节纵向 8 像素）发送区域，
+    // 代理与影子帧缓冲逐页比较，只把变化的列区间写到屏幕
+    struct PageDiffPanel {
+        esp_lcd_panel_t base;
+        esp_lcd_panel_handle_t target;
+        OledDisplay* owner;
+        int width;
+        bool swapped;
+        std::vector<uint8_t> shadow;
+        // 影子帧缓冲中已经和屏幕一致的字节
+        std::vector<uint8_t> known;
+    };
+    PageDiffPanel page_diff_;
+    esp_lcd_panel_handle_t CreatePageDiffPanel(esp_lcd_panel_handle_t target);
+    static esp_err_t DrawChangedPages(esp_lcd_panel_t* panel, int x_start, int y_start, int x_end, int y_end, const void* color_data);
+#endif
+
     virtual bool Lock(int timeout_ms = 0) override;
     virtual void Unlock() override;
 
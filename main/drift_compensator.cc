@@ -0,0 +1,60 @@
+#include "drift_compensator.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+// 积分项的上限，石英晶振的偏差在几百 ppm 以内
+#define DRIFT_MAX_INTEGRAL_PPM 1000
+// 每毫秒误差对应的比例项
+#define DRIFT_PROPORTIONAL_PPM_PER_MS 20
+
+void DriftCompensator::Update(int queued_ms, int target_ms, int frame_duration) {
+    if (reset_pending_.exchange(false)) {
+        error_q4_ = 0;
+        integral_ppm_ = 0;
+        ppm_ = 0;
+        phase_ = 0;
+        has_last_ = false;
+    }
+    int32_t error_q4 = (queued_ms - target_ms) * 16;
+    error_q4_ += (error_q4 - error_q4_) / 16;
+    int32_t error_ms = error_q4_ / 16;
+    // 半帧以内的误差是出队的量化误差，不计入积分
+    if (std::abs(error_ms) * 2 > frame_duration) {
+        integral_ppm_ = std::clamp<int32_t>(integral_ppm_ + error_ms / 16, -DRIFT_MAX_INTEGRAL_PPM, DRIFT_MAX_INTEGRAL_PPM);
+    }
+    ppm_ = std::clamp<int32_t>(integral_ppm_ + error_ms * DRIFT_PROPORTIONAL_PPM_PER_MS, -DRIFT_MAX_PPM, DRIFT_MAX_PPM);
+}
+
+std::span<const int16_t> DriftCompensator::Process(std::span<const int16_t> input) {
+    if (input.empty()) {
+        return input;
+    }
+    if (!has_last_) {
+        last_ = input[0];
+        has_last_ = true;
+    }
+    if (ppm_ == 0 && phase_ == 0) {
+        last_ = input.back();
+        return input;
+    }
+
+    // 每个输出样本前进 step 个输入样本，ppm 为正时 step > 1，播放加快
+    uint32_t step = 65536 + static_cast<int32_t>(static_cast<int64_t>(ppm_) * 65536 / 1000000);
+    uint32_t end = static_cast<uint32_t>(input.size()) << 16;
+    output_.resize(static_cast<uint64_t>(input.size()) * 65536 / step + 2);
+    size_t count = 0;
+    uint32_t position = phase_;
+    // 位置 0 是 last_，位置 i 是 input[i - 1]
+    while (position < end && count < output_.size()) {
+        uint32_t index = position >> 16;
+        int32_t frac = position & 0xffff;
+        int32_t a = index == 0 ? last_ : input[index - 1];
+        int32_t b = input[index];
+        output_[count++] = static_cast<int16_t>(a + (((b - a) * frac) >> 16));
+        position += step;
+    }
+    phase_ = position - end;
+    last_ = input.back();
+    return {output_.data(), count};
+}
@@ -0,0 +1,37 @@
+#ifndef DRIFT_COMPENSATOR_H
+#define DRIFT_COMPENSATOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// 播放速度最多偏离这么多（百万分之一），0.5% 的音高变化听不出来
+#define DRIFT_MAX_PPM 5000
+
+// 补偿服务器发送速率和本地 I2S 时钟之间的偏差
+// 每解码一包用解码队列的深度更新一次速度：深度高于抖动缓冲的目标时略微加快，低于目标时略微放慢，
+// 比例项消化突发积压，积分项跟踪两边时钟的长期偏差；处理时用 Q16 相位的线性插值做分数倍重采样
+// 除 Reset 外只在播放任务中使用
+class DriftCompensator {
+public:
+    void Update(int queued_ms, int target_ms, int frame_duration);
+    // 返回处理后的 PCM，速度为 1 时直接返回输入
+    std::span<const int16_t> Process(std::span<const int16_t> input);
+    // 可以在其它任务中调用，下次 Update 时生效
+    void Reset() { reset_pending_ = true; }
+
+    int ppm() const { return ppm_; }
+
+private:
+    std::vector<int16_t> output_;
+    int32_t error_q4_ = 0;      // 平滑后的深度误差，1/16 ms
+    int32_t integral_ppm_ = 0;
+    int ppm_ = 0;
+    uint32_t phase_ = 0;        // 下一个输出样本相对 last_ 的位置，Q16
+    int16_t last_ = 0;
+    bool has_last_ = false;
+    std::atomic<bool> reset_pending_{false};
+};
+
+#endif // DRIFT_COMPENSATOR_H
@@ -0,0 +1,196 @@
+#include "encoder_controller.h"
+#include "metrics.h"
+
+#include <esp_log.h>
+#include <algorithm>
+
+#define TAG "EncoderController"
+
+static MetricCounter metric_queue_dropped("audio.uplink_queue_dropped");
+static MetricCounter metric_send_failed("audio.uplink_send_failed");
+static MetricGauge metric_remote_loss("audio.uplink_loss_percent");
+
+// 编码耗时占帧时长的千分比阈值
+#define CPU_LOAD_HIGH_PERMILLE 350
+#define CPU_LOAD_LOW_PERMILLE 150
+// 链路连续良好多少个窗口后恢复默认 DTX 设置
+#define LINK_RECOVER_WINDOWS 3
+// 发送队列占用超过这个百分比时立即降档
+#define QUEUE_THROTTLE_PERCENT 50
+// 一次发送阻塞超过帧长的这个百分比算作一次阻塞
+#define SEND_STALL_PERCENT 50
+// 上行丢包率达到这个百分比时打开带内 FEC，降到 0 时关闭
+#define FEC_ENABLE_LOSS_PERCENT 2
+// 告诉编码器的丢包率上限，再高时冗余占用的码率太多
+#define FEC_MAX_LOSS_PERCENT 30
+
+void EncoderController::Configure(int initial_complexity, int max_complexity, bool dtx) {
+    max_complexity_ = std::min(std::max(max_complexity, 0), 10);
+    min_complexity_ = 0;
+    complexity_ = std::min(std::max(initial_complexity, min_complexity_), MaxComplexity());
+    default_dtx_ = dtx;
+    dtx_ = dtx;
+    applied_complexity_ = -1;
+    applied_dtx_ = -1;
+    applied_loss_ = -1;
+    frames_ = 0;
+    encode_us_ = 0;
+    frame_us_ = 0;
+    good_windows_ = 0;
+}
+
+void EncoderController::Apply(OpusStreamEncoder& encoder) {
+    int complexity = complexity_;
+    if (complexity != applied_complexity_) {
+        encoder.SetComplexity(complexity);
+        applied_complexity_ = complexity;
+    }
+    int dtx = dtx_ ? 1 : 0;
+    if (dtx != applied_dtx_) {
+        encoder.SetDtx(dtx);
+        applied_dtx_ = dtx;
+    }
+    // 关闭 FEC 时丢包率记为 0，编码器不再为冗余预留码率
+    int loss = fec_ ? loss_percent_.load() : 0;
+    if (loss != applied_loss_) {
+        encoder.SetInbandFec(loss > 0);
+        encoder.SetPacketLossPercent(loss);
+        applied_loss_ = loss;
+    }
+}
+
+void EncoderController::Invalidate() {
+    applied_complexity_ = -1;
+    applied_dtx_ = -1;
+    applied_loss_ = -1;
+}
+
+void EncoderController::OnRemoteLoss(int loss_percent) {
+    loss_percent = std::min(std::max(loss_percent, 0), FEC_MAX_LOSS_PERCENT);
+    metric_remote_loss.Set(loss_percent);
+    loss_percent_ = loss_percent;
+    bool fec = fec_;
+    if (!fec && loss_percent >= FEC_ENABLE_LOSS_PERCENT) {
+        fec = true;
+    } else if (fec && loss_percent == 0) {
+        fec = false;
+    }
+    if (fec != fec_) {
+        ESP_LOGI(TAG, "Uplink loss %d%% -> in-band FEC %s", loss_percent, fec ? "on" : "off");
+        fec_ = fec;
+    }
+}
+
+void EncoderController::OnFrameEncoded(int64_t encode_us, int frame_duration_ms) {
+    encode_us_ += encode_us;
+    frame_us_ += int64_t(frame_duration_ms) * 1000;
+    if (++frames_ >= ENCODER_CONTROLLER_WINDOW_FRAMES) {
+        Evaluate();
+        frames_ = 0;
+        encode_us_ = 0;
+        frame_us_ = 0;
+    }
+}
+
+void EncoderController::OnSendQueueDepth(size_t queued, size_t max_packets) {
+    queue_capacity_ = max_packets;
+    uint32_t depth = max_queue_depth_;
+    while (queued > depth && !max_queue_depth_.compare_exchange_weak(depth, queued)) {
+    }
+    if (max_packets > 0 && queued * 100 >= max_packets * QUEUE_THROTTLE_PERCENT) {
+        Throttle("send queue");
+    }
+}
+
+void EncoderController::OnSendDuration(int64_t send_us, int frame_duration_ms) {
+    if (send_us * 100 < int64_t(frame_duration_ms) * 1000 * SEND_STALL_PERCENT) {
+        return;
+    }
+    stalled_sends_++;
+    total_stalled_++;
+    Throttle("send stall");
+}
+
+void EncoderController::OnPacketDropped() {
+    dropped_packets_++;
+    total_queue_dropped_++;
+    metric_queue_dropped.Add();
+}
+
+void EncoderController::OnSendFailed() {
+    total_send_dropped_++;
+    metric_send_failed.Add();
+}
+
+void EncoderController::LogDrops() {
+    uint32_t queue_dropped = total_queue_dropped_.exchange(0);
+    uint32_t send_dropped = total_send_dropped_.exchange(0);
+    if (queue_dropped > 0 || send_dropped > 0 || total_stalled_ > 0) {
+        ESP_LOGW(TAG, "Uplink dropped %lu packets (queue full %lu, channel closed %lu), %lu send stalls, throttled %lu times",
+            queue_dropped + send_dropped, queue_dropped, send_dropped, total_stalled_, total_throttled_);
+    }
+    total_stalled_ = 0;
+    total_throttled_ = 0;
+}
+
+void EncoderController::SetComplexityCap(int cap) {
+    cap = std::min(std::max(cap, 0), 10);
+    complexity_cap_ = cap;
+    // 下一帧编码前生效；编码任务的 Evaluate 也按新的上限计算
+    int complexity = complexity_;
+    if (complexity > cap) {
+        complexity_.compare_exchange_strong(complexity, std::max(cap, min_complexity_));
+    }
+}
+
+// 链路拥塞时立即打开 DTX 并降低 complexity，每个统计窗口最多一次
+void EncoderController::Throttle(const char* reason) {
+    congested_ = true;
+    if (throttled_.exchange(true)) {
+        return;
+    }
+    total_throttled_++;
+    int complexity = std::max(complexity_ - 2, min_complexity_);
+    if (complexity != complexity_ || !dtx_) {
+        ESP_LOGI(TAG, "Uplink backpressure (%s) -> complexity %d, dtx 1", reason, complexity);
+        complexity_ = complexity;
+        dtx_ = true;
+    }
+}
+
+void EncoderController::Evaluate() {
+    if (frame_us_ <= 0) {
+        return;
+    }
+    int load = encode_us_ * 1000 / frame_us_;
+    uint32_t depth = max_queue_depth_.exchange(0);
+    uint32_t dropped = dropped_packets_.exchange(0);
+    uint32_t stalled = stalled_sends_.exchange(0);
+    uint32_t capacity = queue_capacity_;
+    bool congested = dropped > 0 || stalled > 0 || (capacity > 0 && depth * 4 >= capacity);
+    congested_ = congested;
+    throttled_ = false;
+
+    int complexity = complexity_;
+    if (load > CPU_LOAD_HIGH_PERMILLE) {
+        complexity = std::max(complexity - 2, min_complexity_);
+    } else if (load < CPU_LOAD_LOW_PERMILLE && !congested) {
+        complexity = std::min(complexity + 1, MaxComplexity());
+    }
+    complexity = std::min(complexity, MaxComplexity());
+
+    bool dtx = dtx_;
+    if (congested) {
+        good_windows_ = 0;
+        dtx = true;
+    } else if (++good_windows_ >= LINK_RECOVER_WINDOWS) {
+        dtx = default_dtx_;
+    }
+
+    if (complexity != complexity_ || dtx != dtx_) {
+        ESP_LOGI(TAG, "Encoder load %d%%, queue depth %lu, dropped %lu -> complexity %d, dtx %d",
+            load / 10, depth, dropped, complexity, dtx);
+        complexity_ = complexity;
+        dtx_ = dtx;
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef ENCODER_CONTROLLER_H
+#define ENCODER_CONTROLLER_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+#include "opus_codec.h"
+
+// 每个统计窗口包含的帧数
+#define ENCODER_CONTROLLER_WINDOW_FRAMES 50
+
+// Opus 编码参数的运行时调节
+// 编码耗时占帧时长的比例反映音频任务的 CPU 余量，发送队列深度、发送阻塞时间和丢包反映链路质量
+// CPU 紧张时降低 complexity，空闲且链路良好时逐步提高；链路拥塞时打开 DTX 并停止提高 complexity
+// 发送队列超过一半或发送阻塞时不等统计窗口结束，立即降档，尽量在队列溢出之前减少上行数据
+// 服务器报告的上行丢包率超过阈值时打开带内 FEC，并把丢包率告诉编码器，丢包消失后关闭
+class EncoderController {
+public:
+    void Configure(int initial_complexity, int max_complexity, bool dtx);
+
+    // 以下两个方法只在编码任务中调用
+    void Apply(OpusStreamEncoder& encoder);
+    // 编码器重建后调用，下一次 Apply 重新设置全部参数
+    void Invalidate();
+    void OnFrameEncoded(int64_t encode_us, int frame_duration_ms);
+
+    // 主循环调用
+    void OnSendQueueDepth(size_t queued, size_t max_packets);
+    // 一次发送事件中阻塞在传输层的时间，TCP 发送缓冲区满时会明显变长
+    void OnSendDuration(int64_t send_us, int frame_duration_ms);
+    // 发送队列满时丢弃（任意任务）/ 通道断开后丢弃
+    void OnPacketDropped();
+    void OnSendFailed();
+    // 会话结束时打印并清零累计的丢包数
+    void LogDrops();
+    // complexity 的额外上限，过热降档时由主循环设置，跨会话保持
+    void SetComplexityCap(int cap);
+    // 服务器接收报告中的上行丢包率（百分比），主循环调用，跨会话保持
+    void OnRemoteLoss(int loss_percent);
+
+    bool congested() const { return congested_; }
+
+    int complexity() const { return complexity_; }
+    bool dtx() const { return dtx_; }
+    bool fec() const { return fec_; }
+
+private:
+    int min_complexity_ = 0;
+    int max_complexity_ = 0;
+    bool default_dtx_ = true;
+
+    std::atomic<int> complexity_{0};
+    std::atomic<int> complexity_cap_{10};
+    std::atomic<bool> dtx_{true};
+    std::atomic<int> loss_percent_{0};
+    std::atomic<bool> fec_{false};
+    int applied_complexity_ = -1;
+    int applied_dtx_ = -1;
+    int applied_loss_ = -1;
+
+    int frames_ = 0;
+    int64_t encode_us_ = 0;
+    int64_t frame_us_ = 0;
+    int good_windows_ = 0;
+
+    std::atomic<uint32_t> max_queue_depth_{0};
+    std::atomic<uint32_t> queue_capacity_{0};
+    std::atomic<uint32_t> dropped_packets_{0};
+    std::atomic<uint32_t> stalled_sends_{0};
+    std::atomic<bool> congested_{false};
+    // 本窗口内已经因为背压降过档
+    std::atomic<bool> throttled_{false};
+
+    // 会话内的累计值
+    std::atomic<uint32_t> total_queue_dropped_{0};
+    std::atomic<uint32_t> total_send_dropped_{0};
+    uint32_t total_stalled_ = 0;
+    uint32_t total_throttled_ = 0;
+
+    int MaxComplexity() const { return std::min<int>(max_complexity_, complexity_cap_); }
+    void Evaluate();
+    void Throttle(const char* reason);
+};
+
+#endif // ENCODER_CONTROLLER_H
@@ -0,0 +1,51 @@
+#include "endpoint_detector.h"
+
+#include <esp_log.h>
+
+#define TAG "EndpointDetector"
+
+EndpointDetector::EndpointDetector(int sample_rate, int min_speech_ms, int hangover_ms)
+    : sample_rate_(sample_rate), min_speech_ms_(min_speech_ms), hangover_ms_(hangover_ms) {
+}
+
+void EndpointDetector::Reset(bool enabled) {
+    pending_enabled_ = enabled;
+    triggered_ = false;
+    reset_pending_ = true;
+}
+
+void EndpointDetector::OnVadStateChange(bool speaking) {
+    speaking_ = speaking;
+    if (speaking) {
+        silence_ms_ = 0;
+    }
+}
+
+bool EndpointDetector::Process(size_t samples) {
+    if (reset_pending_.exchange(false)) {
+        enabled_ = pending_enabled_;
+        speaking_ = false;
+        speech_ms_ = 0;
+        silence_ms_ = 0;
+    }
+    if (!enabled_ || triggered_) {
+        return false;
+    }
+
+    int duration_ms = samples * 1000 / sample_rate_;
+    if (speaking_) {
+        speech_ms_ += duration_ms;
+        return false;
+    }
+    // 还没有说够一句话之前的静音不算结束，例如唤醒后的停顿
+    if (speech_ms_ < min_speech_ms_) {
+        return false;
+    }
+    silence_ms_ += duration_ms;
+    if (silence_ms_ < hangover_ms_) {
+        return false;
+    }
+    ESP_LOGI(TAG, "End of speech after %d ms speech, %d ms silence", speech_ms_, silence_ms_);
+    triggered_ = true;
+    return true;
+}
@@ -0,0 +1,37 @@
+#ifndef ENDPOINT_DETECTOR_H
+#define ENDPOINT_DETECTOR_H
+
+#include <atomic>
+#include <cstddef>
+
+// 设备端的说话结束检测，用于自动停止模式
+// 先检测到至少 min_speech_ms 的语音，之后 VAD 连续静音 hangover_ms 就判定一句话结束，每次 Reset 后只触发一次
+// 静音时长按处理过的采样数累计，不依赖系统时间；Process 和 OnVadStateChange 只在音频处理任务中调用
+class EndpointDetector {
+public:
+    EndpointDetector(int sample_rate, int min_speech_ms, int hangover_ms);
+
+    // 其它任务调用，下一次 Process 时生效
+    void Reset(bool enabled);
+
+    void OnVadStateChange(bool speaking);
+    // 返回 true 表示刚刚检测到说话结束
+    bool Process(size_t samples);
+    // 已经触发，之后的音频不需要再发送
+    bool triggered() const { return triggered_; }
+
+private:
+    int sample_rate_;
+    int min_speech_ms_;
+    int hangover_ms_;
+
+    std::atomic<bool> reset_pending_{false};
+    std::atomic<bool> pending_enabled_{false};
+    bool enabled_ = false;
+    bool speaking_ = false;
+    int speech_ms_ = 0;
+    int silence_ms_ = 0;
+    std::atomic<bool> triggered_{false};
+};
+
+#endif // ENDPOINT_DETECTOR_H
@@ -0,0 +1,54 @@
+#include "flash_guard.h"
+#include "metrics.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define TAG "FlashGuard"
+
+static MetricCounter metric_deferred("flash.deferred");
+static MetricCounter metric_forced("flash.forced");
+static MetricHistogram metric_stall_us[kFlashOpCount] = {
+    MetricHistogram("flash.settings_stall_us", METRIC_DURATION_US_BOUNDS),
+    MetricHistogram("flash.ota_stall_us", METRIC_DURATION_US_BOUNDS),
+};
+
+void FlashGuard::SetGapProbe(std::function<bool()> probe) {
+    probe_ = std::move(probe);
+}
+
+bool FlashGuard::IsGap() {
+    return !probe_ || probe_();
+}
+
+void FlashGuard::OnDeferred() {
+    metric_deferred.Add();
+}
+
+void FlashGuard::WaitForGap(int max_wait_ms) {
+    int waited_ms = 0;
+    while (!IsGap()) {
+        if (waited_ms == 0) {
+            metric_deferred.Add();
+        }
+        if (waited_ms >= max_wait_ms) {
+            metric_forced.Add();
+            return;
+        }
+        vTaskDelay(pdMS_TO_TICKS(20));
+        waited_ms += 20;
+    }
+}
+
+FlashGuard::Scope::Scope(FlashOp op, bool forced) : op_(op), start_us_(esp_timer_get_time()) {
+    if (forced) {
+        metric_forced.Add();
+        ESP_LOGW(TAG, "Flash write %d forced during audio", op);
+    }
+}
+
+FlashGuard::Scope::~Scope() {
+    metric_stall_us[op_].Record(esp_timer_get_time() - start_us_);
+}
@@ -0,0 +1,59 @@
+#ifndef FLASH_GUARD_H
+#define FLASH_GUARD_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+// 音频不在间隙时 Settings 提交最多推迟这么久，之后强制写入
+#define FLASH_GUARD_MAX_DEFER_MS 30000
+// OTA 写入任务每块最多等这么久
+#define FLASH_GUARD_OTA_MAX_WAIT_MS 400
+// 推迟后隔这么久再检查一次
+#define FLASH_GUARD_RETRY_MS 200
+// 播放 DMA 里至少还有这么多音频时，一次 NVS 提交造成的停顿不会欠载
+#define FLASH_GUARD_MIN_BUFFERED_MS 120
+
+enum FlashOp {
+    kFlashOpSettings,
+    kFlashOpOta,
+    kFlashOpCount
+};
+
+// 协调 Flash 擦写和音频
+// 擦写期间 cache 被关闭，不在 IRAM 里的代码（包括音频任务）都会停住；写入方在动手前询问 IsGap()，
+// 不在间隙时把写入排到后面。间隙由应用设置的探针判断：没有音频在进行，或播放 DMA 里缓冲的音频足够长
+// 每次擦写的耗时登记为 flash.*_stall_us，推迟和强制写入的次数登记为 flash.deferred / flash.forced
+class FlashGuard {
+public:
+    static FlashGuard& GetInstance() {
+        static FlashGuard instance;
+        return instance;
+    }
+
+    // 探针可能在 esp_timer 任务和 OTA 写入任务中调用，不能阻塞
+    void SetGapProbe(std::function<bool()> probe);
+    bool IsGap();
+    // 不在间隙时调用，用于统计
+    void OnDeferred();
+    // 在阻塞的写入任务中等到间隙，最多等 max_wait_ms
+    void WaitForGap(int max_wait_ms);
+
+    // 擦写的作用域，结束时记录停顿时长；forced 表示不在间隙时写入
+    class Scope {
+    public:
+        Scope(FlashOp op, bool forced = false);
+        ~Scope();
+
+    private:
+        FlashOp op_;
+        int64_t start_us_;
+    };
+
+private:
+    std::function<bool()> probe_;
+
+    FlashGuard() = default;
+};
+
+#endif // FLASH_GUARD_H
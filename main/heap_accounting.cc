@@ -0,0 +1,98 @@
+#include "heap_accounting.h"
+#include "metrics.h"
+
+#include <esp_heap_caps.h>
+#include <esp_log.h>
+
+#include <atomic>
+
+#define TAG "HeapAccounting"
+
+namespace {
+
+struct TagUsage {
+    std::atomic<int32_t> used{0};
+    std::atomic<int32_t> peak{0};
+    MetricGauge used_metric;
+    MetricGauge peak_metric;
+
+    TagUsage(const char* used_name, const char* peak_name) : used_metric(used_name), peak_metric(peak_name) {}
+};
+
+// 顺序与 HeapTag 一致
+TagUsage tag_usage[kHeapTagCount] = {
+    {"heap.tag.audio.used", "heap.tag.audio.peak"},
+    {"heap.tag.protocol.used", "heap.tag.protocol.peak"},
+    {"heap.tag.display.used", "heap.tag.display.peak"},
+    {"heap.tag.mcp.used", "heap.tag.mcp.peak"},
+    {"heap.tag.camera.used", "heap.tag.camera.peak"},
+    {"heap.tag.ota.used", "heap.tag.ota.peak"},
+};
+
+MetricCounter metric_alloc_failed("heap.alloc_failed");
+MetricGauge metric_alloc_failed_size("heap.alloc_failed.last_size");
+MetricGauge metric_alloc_failed_caps("heap.alloc_failed.last_caps");
+
+void Account(HeapTag tag, void* ptr, bool allocated) {
+    if (ptr == nullptr) {
+        return;
+    }
+    auto& usage = tag_usage[tag];
+    int32_t size = heap_caps_get_allocated_size(ptr);
+    if (!allocated) {
+        usage.used_metric.Set(usage.used.fetch_sub(size, std::memory_order_relaxed) - size);
+        return;
+    }
+    int32_t used = usage.used.fetch_add(size, std::memory_order_relaxed) + size;
+    usage.used_metric.Set(used);
+    int32_t peak = usage.peak.load(std::memory_order_relaxed);
+    while (used > peak && !usage.peak.compare_exchange_weak(peak, used, std::memory_order_relaxed)) {
+    }
+    if (used > peak) {
+        usage.peak_metric.Set(used);
+    }
+}
+
+// 可能在任何任务中、持有堆锁之外调用，只做计数和早期日志
+void OnAllocFailed(size_t size, uint32_t caps, const char* function_name) {
+    metric_alloc_failed.Add();
+    metric_alloc_failed_size.Set(size);
+    metric_alloc_failed_caps.Set(caps);
+    ESP_EARLY_LOGW(TAG, "%s failed: %u bytes, caps 0x%lx, free %u, largest block %u", function_name, size, caps,
+        heap_caps_get_free_size(caps), heap_caps_get_largest_free_block(caps));
+}
+
+} // namespace
+
+void HeapAccounting::Initialize() {
+    heap_caps_register_failed_alloc_callback(OnAllocFailed);
+}
+
+void* HeapAccounting::Malloc(HeapTag tag, size_t size, uint32_t caps) {
+    void* ptr = heap_caps_malloc(size, caps);
+    Account(tag, ptr, true);
+    return ptr;
+}
+
+void* HeapAccounting::MallocPreferSpiram(HeapTag tag, size_t size) {
+    void* ptr = nullptr;
+    if (heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0) {
+        ptr = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    }
+    if (ptr == nullptr) {
+        ptr = heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    Account(tag, ptr, true);
+    return ptr;
+}
+
+void* HeapAccounting::AlignedAlloc(HeapTag tag, size_t alignment, size_t size, uint32_t caps) {
+    void* ptr = heap_caps_aligned_alloc(alignment, size, caps);
+    Account(tag, ptr, true);
+    return ptr;
+}
+
+void HeapAccounting::Free(HeapTag tag, void* ptr) {
+    Account(tag, ptr, false);
+    heap_caps_free(ptr);
+}
@@ -0,0 +1,32 @@
+#ifndef HEAP_ACCOUNTING_H
+#define HEAP_ACCOUNTING_H
+
+#include <cstddef>
+#include <cstdint>
+
+// 分配所属的子系统
+enum HeapTag {
+    kHeapTagAudio,
+    kHeapTagProtocol,
+    kHeapTagDisplay,
+    kHeapTagMcp,
+    kHeapTagCamera,
+    kHeapTagOta,
+    kHeapTagCount
+};
+
+// 按子系统记账的 heap_caps 分配，每个子系统的当前用量和峰值作为 heap.tag.* 指标导出
+// 释放时必须传入分配时的标记；统计的是 heap_caps_get_allocated_size 返回的实际块大小
+class HeapAccounting {
+public:
+    // 启动时调用一次，登记分配失败回调
+    static void Initialize();
+
+    static void* Malloc(HeapTag tag, size_t size, uint32_t caps);
+    // 先用 PSRAM，没有 PSRAM 或不够时用内部 RAM
+    static void* MallocPreferSpiram(HeapTag tag, size_t size);
+    static void* AlignedAlloc(HeapTag tag, size_t alignment, size_t size, uint32_t caps);
+    static void Free(HeapTag tag, void* ptr);
+};
+
+#endif // HEAP_ACCOUNTING_H
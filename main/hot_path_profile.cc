@@ -0,0 +1,42 @@
+#include "hot_path_profile.h"
+#include "metrics.h"
+
+#include <esp_cpu.h>
+#include <xtensa_perfmon_access.h>
+#include <xtensa_perfmon_masks.h>
+
+#define CPI_X100_BOUNDS {100, 120, 150, 200, 300, 500, 1000}
+
+static MetricHistogram metric_cpi[kHotPathCount] = {
+    MetricHistogram("profile.input_resample_cpi_x100", CPI_X100_BOUNDS),
+    MetricHistogram("profile.encode_cpi_x100", CPI_X100_BOUNDS),
+    MetricHistogram("profile.decode_cpi_x100", CPI_X100_BOUNDS),
+};
+
+// 计数器 0 数周期，1 数指令，每个核第一次使用时配置
+static bool perfmon_ready[portNUM_PROCESSORS];
+
+static void EnsurePerfmon() {
+    int core = esp_cpu_get_core_id();
+    if (perfmon_ready[core]) {
+        return;
+    }
+    xtensa_perfmon_init(0, XTPERF_CNT_CYCLES, XTPERF_MASK_CYCLES, 0, -1);
+    xtensa_perfmon_init(1, XTPERF_CNT_INSN, XTPERF_MASK_INSN_ALL, 0, -1);
+    xtensa_perfmon_start();
+    perfmon_ready[core] = true;
+}
+
+HotPathScope::HotPathScope(HotPath path) : path_(path) {
+    EnsurePerfmon();
+    start_cycles_ = xtensa_perfmon_value(0);
+    start_instructions_ = xtensa_perfmon_value(1);
+}
+
+HotPathScope::~HotPathScope() {
+    uint32_t cycles = xtensa_perfmon_value(0) - start_cycles_;
+    uint32_t instructions = xtensa_perfmon_value(1) - start_instructions_;
+    if (instructions > 0) {
+        metric_cpi[path_].Record(static_cast<uint64_t>(cycles) * 100 / instructions);
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef HOT_PATH_PROFILE_H
+#define HOT_PATH_PROFILE_H
+
+#include <cstdint>
+
+enum HotPath {
+    kHotPathInputResample,
+    kHotPathEncode,
+    kHotPathDecode,
+    kHotPathCount
+};
+
+// 用 Xtensa 性能计数器统计一段热路径的 CPI（每条指令的周期数 x100），登记为 profile.*_cpi_x100 直方图
+// 代码在 IRAM 且 cache 命中时接近 100，从 Flash 取指 miss 越多越高
+// 计数器按核统计，作用域内发生任务切换时这一次的结果包含其它任务，只做统计对比用
+// CONFIG_AUDIO_HOT_PATH_PROFILE 关闭时是空操作
+class HotPathScope {
+public:
+#if CONFIG_AUDIO_HOT_PATH_PROFILE
+    explicit HotPathScope(HotPath path);
+    ~HotPathScope();
+
+private:
+    HotPath path_;
+    uint32_t start_cycles_;
+    uint32_t start_instructions_;
+#else
+    explicit HotPathScope(HotPath) {}
+#endif
+};
+
+#endif // HOT_PATH_PROFILE_H
@@ -0,0 +1,103 @@
+#ifndef INPLACE_FUNCTION_H
+#define INPLACE_FUNCTION_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// 只能移动的 void() 可调用对象，捕获不超过 Capacity 字节时存放在对象内部，不分配堆内存
+// 超过时退回到堆上分配，on_heap() 为 true，调用方可以据此统计
+template <size_t Capacity>
+class InplaceFunction {
+public:
+    InplaceFunction() = default;
+
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, InplaceFunction>>>
+    InplaceFunction(F&& callable) {
+        using T = std::decay_t<F>;
+        if constexpr (sizeof(T) <= Capacity && alignof(T) <= alignof(std::max_align_t)) {
+            new (storage_) T(std::forward<F>(callable));
+            ops_ = &InlineOps<T>::ops;
+        } else {
+            *reinterpret_cast<T**>(storage_) = new T(std::forward<F>(callable));
+            ops_ = &HeapOps<T>::ops;
+        }
+    }
+
+    InplaceFunction(InplaceFunction&& other) noexcept {
+        MoveFrom(other);
+    }
+
+    InplaceFunction& operator=(InplaceFunction&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            MoveFrom(other);
+        }
+        return *this;
+    }
+
+    InplaceFunction(const InplaceFunction&) = delete;
+    InplaceFunction& operator=(const InplaceFunction&) = delete;
+
+    ~InplaceFunction() {
+        Reset();
+    }
+
+    void operator()() {
+        ops_->invoke(storage_);
+    }
+
+    explicit operator bool() const { return ops_ != nullptr; }
+    bool on_heap() const { return ops_ != nullptr && ops_->on_heap; }
+
+    void Reset() {
+        if (ops_ != nullptr) {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+
+private:
+    struct Ops {
+        void (*invoke)(void* storage);
+        // 把 from 中的对象移动到 to，并销毁 from 中的对象
+        void (*move)(void* from, void* to);
+        void (*destroy)(void* storage);
+        bool on_heap;
+    };
+
+    template <typename T>
+    struct InlineOps {
+        static void Invoke(void* storage) { (*static_cast<T*>(storage))(); }
+        static void Move(void* from, void* to) {
+            new (to) T(std::move(*static_cast<T*>(from)));
+            static_cast<T*>(from)->~T();
+        }
+        static void Destroy(void* storage) { static_cast<T*>(storage)->~T(); }
+        static constexpr Ops ops = {Invoke, Move, Destroy, false};
+    };
+
+    template <typename T>
+    struct HeapOps {
+        static void Invoke(void* storage) { (**static_cast<T**>(storage))(); }
+        static void Move(void* from, void* to) { *static_cast<T**>(to) = *static_cast<T**>(from); }
+        static void Destroy(void* storage) { delete *static_cast<T**>(storage); }
+        static constexpr Ops ops = {Invoke, Move, Destroy, true};
+    };
+
+    static_assert(Capacity >= sizeof(void*), "capacity must hold a pointer");
+
+    alignas(std::max_align_t) unsigned char storage_[Capacity];
+    const Ops* ops_ = nullptr;
+
+    void MoveFrom(InplaceFunction& other) {
+        if (other.ops_ != nullptr) {
+            other.ops_->move(other.storage_, storage_);
+            ops_ = other.ops_;
+            other.ops_ = nullptr;
+        }
+    }
+};
+
+#endif // INPLACE_FUNCTION_H
@@ -52,40 +52,72 @@ std::string Thing::GetStateJson() {
     return json_str;
 }
 
+bool Thing::AppendStateDelta(std::string& json, bool full) {
+    dirty_ = false;
+    auto start = json.size();
+    json += "{\"name\":\"" + name_ + "\",\"state\":{";
+    if (properties_.AppendStateDelta(json, full) == 0 && !full) {
+        json.resize(start);
+        return false;
+    }
+    json += "}}";
+    return true;
+}
+
+void Thing::NotifyStateChanged() {
+    dirty_ = true;
+    auto& app = Application::GetInstance();
+    app.Schedule([&app]() {
+        app.UpdateIotStates(true);
+    });
+}
+
 void Thing::Invoke(const cJSON* command) {
     auto method_name = cJSON_GetObjectItem(command, "method");
     auto input_params = cJSON_GetObjectItem(command, "parameters");
+    if (!cJSON_IsString(method_name)) {
+        ESP_LOGE(TAG, "Missing method name for %s", name_.c_str());
+        return;
+    }
+    auto method = methods_.Find(method_name->valuestring);
+    if (method == nullptr) {
+        ESP_LOGE(TAG, "Method not found: %s", method_name->valuestring);
+        return;
+    }
 
-    try {
-        auto& method = methods_[method_name->valuestring];
-        for (auto& param : method.parameters()) {
-            auto input_param = cJSON_GetObjectItem(input_params, param.name().c_str());
-            if (param.required() && input_param == nullptr) {
-                throw std::runtime_error("Parameter " + param.name() + " is required");
+    // 参数直接写入方法的参数表，字符串从 cJSON 中拷贝一次
+    for (auto& param : method->parameters()) {
+        auto input_param = cJSON_GetObjectItem(input_params, param.name().c_str());
+        if (param.required() && input_param == nullptr) {
+            ESP_LOGE(TAG, "Parameter %s is required by %s", param.name().c_str(), method_name->valuestring);
+            return;
+        }
+        if (param.type() == kValueTypeNumber) {
+            if (cJSON_IsNumber(input_param)) {
+                param.set_number(input_param->valueint);
+            }
+        } else if (param.type() == kValueTypeString) {
+            if (cJSON_IsString(input_param)) {
+                param.set_string(input_param->valuestring);
+            } else if (cJSON_IsObject(input_param) || cJSON_IsArray(input_param)) {
+                // 对象和数组按 JSON 文本传给方法
+                char* value = cJSON_PrintUnformatted(input_param);
+                param.set_string(value);
+                cJSON_free(value);
             }
-            if (param.type() == kValueTypeNumber) {
-                if (cJSON_IsNumber(input_param)) {
-                    param.set_number(input_param->valueint);
-                }
-            } else if (param.type() == kValueTypeString) {
-                if (cJSON_IsString(input_param) || cJSON_IsObject(input_param) || cJSON_IsArray(input_param)) {
-                    std::string value_str = input_param->valuestring;
-                    param.set_string(value_str);
-                }
-            } else if (param.type() == kValueTypeBoolean) {
-                if (cJSON_IsBool(input_param)) {
-                    param.set_boolean(input_param->valueint == 1);
-                }
+        } else if (param.type() == kValueTypeBoolean) {
+            if (cJSON_IsBool(input_param)) {
+                param.set_boolean(input_param->valueint == 1);
             }
         }
-
-        Application::GetInstance().Schedule([&method]() {
-            method.Invoke();
-        });
-    } catch (const std::runtime_error& e) {
-        ESP_LOGE(TAG, "Method not found: %s", method_name->valuestring);
-        return;
     }
+
+    Application::GetInstance().Schedule([this, method]() {
+        method->Invoke();
+        // 方法就是属性的 setter，执行后立即上报变化
+        dirty_ = true;
+        Application::GetInstance().UpdateIotStates(true);
+    });
 }
 
 
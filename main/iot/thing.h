@@ -5,11 +5,52 @@
 #include <map>
 #include <functional>
 #include <vector>
+#include <unordered_map>
 #include <stdexcept>
+#include <cstdint>
 #include <cJSON.h>
 
 namespace iot {
 
+// 名字的 FNV-1a 哈希
+constexpr uint32_t NameHash(const char* name) {
+    uint32_t hash = 2166136261u;
+    while (*name != '\0') {
+        hash = (hash ^ (uint8_t)*name++) * 16777619u;
+    }
+    return hash;
+}
+
+// 按名字哈希索引下标，注册时建立，查找时不再逐个比较字符串，也不需要先构造 std::string
+// 哈希冲突时后注册的名字不进索引，查到的名字不一致时退回逐个比较
+class NameIndex {
+public:
+    void Add(const std::string& name, size_t position) {
+        index_.emplace(NameHash(name.c_str()), position);
+    }
+
+    // name_at(i) 返回第 i 项的名字，找不到时返回 -1
+    template<typename NameAt>
+    int Find(const char* name, size_t count, NameAt name_at) const {
+        auto it = index_.find(NameHash(name));
+        if (it == index_.end()) {
+            return -1;
+        }
+        if (name_at(it->second) == name) {
+            return it->second;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (name_at(i) == name) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+private:
+    std::unordered_map<uint32_t, size_t> index_;
+};
+
 enum ValueType {
     kValueTypeBoolean,
     kValueTypeNumber,
@@ -24,6 +65,11 @@ private:
     std::function<bool()> boolean_getter_;
     std::function<int()> number_getter_;
     std::function<std::string()> string_getter_;
+    // 上次上报的值，用于按属性计算增量
+    bool reported_ = false;
+    bool last_boolean_ = false;
+    int last_number_ = 0;
+    std::string last_string_;
 
 public:
     Property(const std::string& name, const std::string& description, std::function<bool()> getter) :
@@ -65,6 +111,40 @@ public:
         }
         return "null";
     }
+    // 读取当前值并和上次上报的值比较，有变化时更新并返回 true，不生成 JSON
+    bool Refresh() {
+        bool changed = !reported_;
+        if (type_ == kValueTypeBoolean) {
+            bool value = boolean_getter_();
+            changed |= value != last_boolean_;
+            last_boolean_ = value;
+        } else if (type_ == kValueTypeNumber) {
+            int value = number_getter_();
+            changed |= value != last_number_;
+            last_number_ = value;
+        } else if (type_ == kValueTypeString) {
+            std::string value = string_getter_();
+            if (value != last_string_) {
+                changed = true;
+                last_string_ = std::move(value);
+            }
+        }
+        reported_ = true;
+        return changed;
+    }
+
+    // 上次 Refresh 读到的值
+    void AppendReportedJson(std::string& json) const {
+        if (type_ == kValueTypeBoolean) {
+            json += last_boolean_ ? "true" : "false";
+        } else if (type_ == kValueTypeNumber) {
+            json += std::to_string(last_number_);
+        } else if (type_ == kValueTypeString) {
+            json += "\"" + last_string_ + "\"";
+        } else {
+            json += "null";
+        }
+    }
 };
 
 class PropertyList {
@@ -117,6 +197,20 @@ public:
         json_str += "}";
         return json_str;
     }
+    // 追加有变化的属性（full 为 true 时追加全部属性），返回追加的个数
+    int AppendStateDelta(std::string& json, bool full) {
+        int count = 0;
+        for (auto& property : properties_) {
+            if (!property.Refresh() && !full) {
+                continue;
+            }
+            json += count++ > 0 ? ",\"" : "\"";
+            json += property.name();
+            json += "\":";
+            property.AppendReportedJson(json);
+        }
+        return count;
+    }
 };
 
 class Parameter {
@@ -144,7 +238,8 @@ public:
 
     void set_boolean(bool value) { boolean_ = value; }
     void set_number(int value) { number_ = value; }
-    void set_string(const std::string& value) { string_ = value; }
+    // 复用上次调用的缓冲区
+    void set_string(const char* value) { string_.assign(value); }
 
     std::string GetDescriptorJson() {
         std::string json_str = "{";
@@ -164,21 +259,32 @@ public:
 class ParameterList {
 private:
     std::vector<Parameter> parameters_;
+    NameIndex index_;
 
 public:
     ParameterList() = default;
-    ParameterList(const std::vector<Parameter>& parameters) : parameters_(parameters) {}
+    ParameterList(const std::vector<Parameter>& parameters) : parameters_(parameters) {
+        for (size_t i = 0; i < parameters_.size(); i++) {
+            index_.Add(parameters_[i].name(), i);
+        }
+    }
     void AddParameter(const Parameter& parameter) {
         parameters_.push_back(parameter);
+        index_.Add(parameter.name(), parameters_.size() - 1);
     }
 
-    const Parameter& operator[](const std::string& name) const {
-        for (auto& parameter : parameters_) {
-            if (parameter.name() == name) {
-                return parameter;
-            }
+    // 方法回调中用字符串字面量取参数，不构造 std::string
+    const Parameter& operator[](const char* name) const {
+        int i = index_.Find(name, parameters_.size(), [this](size_t i) -> const std::string& {
+            return parameters_[i].name();
+        });
+        if (i < 0) {
+            throw std::runtime_error(std::string("Parameter not found: ") + name);
         }
-        throw std::runtime_error("Parameter not found: " + name);
+        return parameters_[i];
+    }
+    const Parameter& operator[](const std::string& name) const {
+        return (*this)[name.c_str()];
     }
 
     // iterator
@@ -229,22 +335,35 @@ public:
 class MethodList {
 private:
     std::vector<Method> methods_;
+    NameIndex index_;
 
 public:
     MethodList() = default;
-    MethodList(const std::vector<Method>& methods) : methods_(methods) {}
+    MethodList(const std::vector<Method>& methods) : methods_(methods) {
+        for (size_t i = 0; i < methods_.size(); i++) {
+            index_.Add(methods_[i].name(), i);
+        }
+    }
 
     void AddMethod(const std::string& name, const std::string& description, const ParameterList& parameters, std::function<void(const ParameterList&)> callback) {
         methods_.push_back(Method(name, description, parameters, callback));
+        index_.Add(name, methods_.size() - 1);
+    }
+
+    // 找不到时返回 nullptr
+    Method* Find(const char* name) {
+        int i = index_.Find(name, methods_.size(), [this](size_t i) -> const std::string& {
+            return methods_[i].name();
+        });
+        return i < 0 ? nullptr : &methods_[i];
     }
 
     Method& operator[](const std::string& name) {
-        for (auto& method : methods_) {
-            if (method.name() == name) {
-                return method;
-            }
+        auto method = Find(name.c_str());
+        if (method == nullptr) {
+            throw std::runtime_error("Method not found: " + name);
         }
-        throw std::runtime_error("Method not found: " + name);
+        return *method;
     }
 
     std::string GetDescriptorJson() {
@@ -268,11 +387,17 @@ public:
 
     virtual std::string GetDescriptorJson();
     virtual std::string GetStateJson();
+    // 追加状态，非 full 时只包含有变化的属性，没有变化时不追加并返回 false
+    virtual bool AppendStateDelta(std::string& json, bool full);
     virtual void Invoke(const cJSON* command);
 
     const std::string& name() const { return name_; }
     const std::string& description() const { return description_; }
 
+    // 属性在方法之外被修改时调用（如按键调节音量），尽快上报变化的属性
+    void NotifyStateChanged();
+    bool dirty() const { return dirty_; }
+
 protected:
     PropertyList properties_;
     MethodList methods_;
@@ -280,6 +405,7 @@ protected:
 private:
     std::string name_;
     std::string description_;
+    bool dirty_ = false;
 };
 
 
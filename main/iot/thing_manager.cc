@@ -1,6 +1,7 @@
 #include "thing_manager.h"
 
 #include <esp_log.h>
+#include <esp_rom_crc.h>
 
 #define TAG "ThingManager"
 
@@ -8,43 +9,52 @@ namespace iot {
 
 void ThingManager::AddThing(Thing* thing) {
     things_.push_back(thing);
+    thing_index_.Add(thing->name(), things_.size() - 1);
+    descriptors_json_.clear();
+    descriptors_hash_.clear();
 }
 
-std::string ThingManager::GetDescriptorsJson() {
-    std::string json_str = "[";
+const std::string& ThingManager::GetDescriptorsJson() {
+    if (!descriptors_json_.empty()) {
+        return descriptors_json_;
+    }
+    descriptors_json_ = "[";
     for (auto& thing : things_) {
-        json_str += thing->GetDescriptorJson() + ",";
+        descriptors_json_ += thing->GetDescriptorJson() + ",";
     }
-    if (json_str.back() == ',') {
-        json_str.pop_back();
+    if (descriptors_json_.back() == ',') {
+        descriptors_json_.pop_back();
     }
-    json_str += "]";
-    return json_str;
+    descriptors_json_ += "]";
+    return descriptors_json_;
 }
 
-bool ThingManager::GetStatesJson(std::string& json, bool delta) {
-    if (!delta) {
-        last_states_.clear();
+const std::string& ThingManager::GetDescriptorsHash() {
+    if (descriptors_hash_.empty()) {
+        auto& json = GetDescriptorsJson();
+        char hash[9];
+        snprintf(hash, sizeof(hash), "%08lx", (unsigned long)esp_rom_crc32_le(0, (const uint8_t*)json.data(), json.size()));
+        descriptors_hash_ = hash;
     }
+    return descriptors_hash_;
+}
+
+bool ThingManager::GetStatesJson(std::string& json, bool delta, bool dirty_only) {
+    // 每个属性缓存上次上报的值，只有变化的属性会生成 JSON
     bool changed = false;
     json = "[";
-    // 枚举thing，获取每个thing的state，如果发生变化，则更新，保存到last_states_
-    // 如果delta为true，则只返回变化的部分
     for (auto& thing : things_) {
-        std::string state = thing->GetStateJson();
-        if (delta) {
-            // 如果delta为true，则只返回变化的部分
-            auto it = last_states_.find(thing->name());
-            if (it != last_states_.end() && it->second == state) {
-                continue;
-            }
+        if (delta && dirty_only && !thing->dirty()) {
+            continue;
+        }
+        if (changed) {
+            json += ",";
+        }
+        if (thing->AppendStateDelta(json, !delta)) {
             changed = true;
-            last_states_[thing->name()] = state;
+        } else if (changed) {
+            json.pop_back();
         }
-        json += state + ",";
-    }
-    if (json.back() == ',') {
-        json.pop_back();
     }
     json += "]";
     return changed;
@@ -52,12 +62,18 @@ bool ThingManager::GetStatesJson(std::string& json, bool delta) {
 
 void ThingManager::Invoke(const cJSON* command) {
     auto name = cJSON_GetObjectItem(command, "name");
-    for (auto& thing : things_) {
-        if (thing->name() == name->valuestring) {
-            thing->Invoke(command);
-            return;
-        }
+    if (!cJSON_IsString(name)) {
+        ESP_LOGE(TAG, "Missing thing name");
+        return;
+    }
+    int i = thing_index_.Find(name->valuestring, things_.size(), [this](size_t i) -> const std::string& {
+        return things_[i]->name();
+    });
+    if (i < 0) {
+        ESP_LOGW(TAG, "Thing not found: %s", name->valuestring);
+        return;
     }
+    things_[i]->Invoke(command);
 }
 
 } // namespace iot
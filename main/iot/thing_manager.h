@@ -24,8 +24,13 @@ public:
 
     void AddThing(Thing* thing);
 
-    std::string GetDescriptorsJson();
-    bool GetStatesJson(std::string& json, bool delta = false);
+    // 描述只随固件变化，生成一次后缓存
+    const std::string& GetDescriptorsJson();
+    // 描述内容的 CRC32，服务器据此判断缓存的描述是否可用
+    const std::string& GetDescriptorsHash();
+    // delta 为 true 时只包含上次上报后有变化的属性
+    // dirty_only 为 true 时只检查 NotifyStateChanged 或方法调用标记过的 thing
+    bool GetStatesJson(std::string& json, bool delta = false, bool dirty_only = false);
     void Invoke(const cJSON* command);
 
 private:
@@ -33,7 +38,9 @@ private:
     ~ThingManager() = default;
 
     std::vector<Thing*> things_;
-    std::map<std::string, std::string> last_states_;
+    NameIndex thing_index_;
+    std::string descriptors_json_;
+    std::string descriptors_hash_;
 };
 
 
@@ -0,0 +1,237 @@
+#include "jitter_buffer.h"
+#include "audio_payload_pool.h"
+#include "async_log.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <algorithm>
+
+#define TAG "JitterBuffer"
+
+// 间隔太大时不再补 PLC 帧，直接从新包开始
+#define MAX_CONCEALED_PACKETS (JITTER_BUFFER_REORDER_WINDOW * 2)
+
+JitterBuffer::JitterBuffer(AudioPacketQueue& queue) : queue_(queue) {
+}
+
+JitterBuffer::~JitterBuffer() {
+    ReleaseHeld();
+}
+
+int JitterBuffer::target_ms() const {
+    // 至少缓冲一帧，抖动越大缓冲越深
+    int target = frame_duration_ + jitter_ms_ * 2;
+    return std::min(target, JITTER_BUFFER_MAX_TARGET_MS);
+}
+
+void JitterBuffer::Put(const AudioStreamPacketView& packet) {
+    received_packets_++;
+    if (packet.frame_duration > 0) {
+        frame_duration_ = packet.frame_duration;
+    }
+
+    // 没有 sequence 的传输（WebSocket）按到达顺序处理
+    if (packet.sequence == 0) {
+        UpdateJitter(arrival_index_++, packet.frame_duration);
+        Emit(packet);
+        return;
+    }
+
+    UpdateJitter(packet.sequence, packet.frame_duration);
+    if (!has_sequence_) {
+        has_sequence_ = true;
+        next_sequence_ = packet.sequence;
+    }
+
+    int32_t diff = static_cast<int32_t>(packet.sequence - next_sequence_);
+    if (diff < 0) {
+        // 已经做过 PLC 或重复的包
+        late_packets_++;
+        return;
+    }
+    if (diff > MAX_CONCEALED_PACKETS) {
+        ESP_LOGW(TAG, "Sequence jumped from %lu to %lu, resync", next_sequence_, packet.sequence);
+        ReleaseHeld();
+        next_sequence_ = packet.sequence;
+        diff = 0;
+    }
+    while (diff >= JITTER_BUFFER_REORDER_WINDOW) {
+        SkipOne(packet);
+        diff = static_cast<int32_t>(packet.sequence - next_sequence_);
+    }
+
+    if (diff == 0) {
+        Emit(packet);
+        next_sequence_++;
+        DrainHeld();
+        return;
+    }
+
+    reordered_packets_++;
+    Hold(packet);
+    // 窗口内的包都到了，缺的那一帧不再等
+    if (held_count_ >= JITTER_BUFFER_REORDER_WINDOW - 1) {
+        SkipOne(packet);
+        DrainHeld();
+    }
+}
+
+void JitterBuffer::Reset() {
+    ReleaseHeld();
+    has_sequence_ = false;
+    has_transit_ = false;
+    arrival_index_ = 0;
+    reset_pending_ = true;
+}
+
+bool JitterBuffer::ReadyToPlay() {
+    if (reset_pending_.exchange(false)) {
+        playing_ = false;
+        underrun_ = false;
+        wait_start_ms_ = 0;
+    }
+
+    size_t queued = queue_.size();
+    if (playing_) {
+        if (queued == 0) {
+            // 欠载，重新缓冲
+            playing_ = false;
+            underrun_ = true;
+            wait_start_ms_ = 0;
+            return false;
+        }
+        return true;
+    }
+
+    if (queued == 0) {
+        return false;
+    }
+    int64_t now = esp_timer_get_time() / 1000;
+    if (wait_start_ms_ == 0) {
+        wait_start_ms_ = now;
+    }
+    int target = target_ms();
+    // 缓冲够深，或者等待已超过目标时长（例如整句很短）就开始播放
+    if ((int)queued * frame_duration_ >= target || now - wait_start_ms_ >= target) {
+        playing_ = true;
+        underrun_ = false;
+    }
+    return playing_;
+}
+
+void JitterBuffer::UpdateJitter(uint32_t media_index, int frame_duration) {
+    if (frame_duration <= 0) {
+        return;
+    }
+    int64_t arrival_ms = esp_timer_get_time() / 1000;
+    int64_t transit = arrival_ms - int64_t(media_index) * frame_duration;
+    if (!has_transit_) {
+        has_transit_ = true;
+        last_transit_ms_ = transit;
+        return;
+    }
+    // 服务器通常比实时更快地下发，提前到达不算抖动
+    int64_t delay = std::max<int64_t>(transit - last_transit_ms_, 0);
+    last_transit_ms_ = transit;
+    int jitter = jitter_ms_;
+    jitter += (int(delay) - jitter) / 16;
+    jitter_ms_ = jitter;
+}
+
+void JitterBuffer::Emit(const AudioStreamPacketView& packet) {
+    if (!queue_.Push(packet.sample_rate, packet.frame_duration, packet.timestamp, packet.payload, packet.payload_size,
+            packet.trace_us)) {
+        overflow_packets_++;
+        LOGD_LIMITED(TAG, 1000, "Decode queue is full, drop packet");
+    }
+}
+
+void JitterBuffer::EmitHeld(HeldPacket& held) {
+    queue_.Push(held.sample_rate, held.frame_duration, held.timestamp, held.payload.data(), held.payload.size(),
+        held.trace_us);
+    held.valid = false;
+    held_count_--;
+}
+
+void JitterBuffer::EmitLost(int sample_rate, int frame_duration) {
+    // 空负载的包由解码器做丢包补偿
+    lost_packets_++;
+    queue_.Push(sample_rate, frame_duration, 0, nullptr, 0);
+}
+
+#if CONFIG_OPUS_INBAND_FEC
+void JitterBuffer::EmitFec(int sample_rate, int frame_duration, const uint8_t* next, size_t size) {
+    // 负载是丢失帧的下一包，解码器从其中的冗余恢复丢失的帧，下一包仍按原样再解码一次
+    lost_packets_++;
+    fec_packets_++;
+    queue_.Push(sample_rate, frame_duration, 0, next, size, 0, true);
+}
+#endif
+
+void JitterBuffer::Hold(const AudioStreamPacketView& packet) {
+    auto& held = held_[packet.sequence % JITTER_BUFFER_REORDER_WINDOW];
+    if (held.valid) {
+        if (held.sequence == packet.sequence) {
+            return;
+        }
+        held_count_--;
+    }
+    if (held.payload.capacity() < AUDIO_PAYLOAD_MAX_SIZE) {
+        held.payload = AudioPayloadPool::GetInstance().Acquire();
+    }
+    held.valid = true;
+    held.sequence = packet.sequence;
+    held.sample_rate = packet.sample_rate;
+    held.frame_duration = packet.frame_duration;
+    held.timestamp = packet.timestamp;
+    held.trace_us = packet.trace_us;
+    held.payload.assign(packet.payload, packet.payload + packet.payload_size);
+    held_count_++;
+}
+
+void JitterBuffer::SkipOne(const AudioStreamPacketView& current) {
+    auto& held = held_[next_sequence_ % JITTER_BUFFER_REORDER_WINDOW];
+    if (held.valid && held.sequence == next_sequence_) {
+        EmitHeld(held);
+        next_sequence_++;
+        return;
+    }
+#if CONFIG_OPUS_INBAND_FEC
+    // 只有紧跟在丢失帧后面的一包带有它的冗余
+    uint32_t next = next_sequence_ + 1;
+    auto& following = held_[next % JITTER_BUFFER_REORDER_WINDOW];
+    if (following.valid && following.sequence == next) {
+        EmitFec(current.sample_rate, current.frame_duration, following.payload.data(), following.payload.size());
+    } else if (current.sequence == next) {
+        EmitFec(current.sample_rate, current.frame_duration, current.payload, current.payload_size);
+    } else {
+        EmitLost(current.sample_rate, current.frame_duration);
+    }
+#else
+    EmitLost(current.sample_rate, current.frame_duration);
+#endif
+    next_sequence_++;
+}
+
+void JitterBuffer::DrainHeld() {
+    while (held_count_ > 0) {
+        auto& held = held_[next_sequence_ % JITTER_BUFFER_REORDER_WINDOW];
+        if (!held.valid || held.sequence != next_sequence_) {
+            break;
+        }
+        EmitHeld(held);
+        next_sequence_++;
+    }
+}
+
+void JitterBuffer::ReleaseHeld() {
+    auto& pool = AudioPayloadPool::GetInstance();
+    for (auto& held : held_) {
+        held.valid = false;
+        if (held.payload.capacity() > 0) {
+            pool.Release(std::move(held.payload));
+            held.payload = std::vector<uint8_t>();
+        }
+    }
+    held_count_ = 0;
+}
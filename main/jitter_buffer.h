@@ -0,0 +1,95 @@
+#ifndef JITTER_BUFFER_H
+#define JITTER_BUFFER_H
+
+#include <atomic>
+#include <array>
+#include <vector>
+#include <cstdint>
+
+#include "protocol.h"
+#include "audio_packet_queue.h"
+
+#define JITTER_BUFFER_REORDER_WINDOW 4
+#define JITTER_BUFFER_MAX_TARGET_MS 600
+
+// 下行音频的抖动缓冲
+// 生产者一侧（网络任务）按 sequence 重排乱序包，丢失的包以空负载写入解码队列，由解码器做 PLC
+// 开启 CONFIG_OPUS_INBAND_FEC 时，丢失帧的下一包已经到达就把它作为 FEC 包写入，由解码器从冗余恢复
+// 消费者一侧（音频任务）根据测得的到达抖动决定起播前需要缓冲的深度
+class JitterBuffer {
+public:
+    JitterBuffer(AudioPacketQueue& queue);
+    ~JitterBuffer();
+
+    // 生产者调用，需要和解码队列的其它生产者互斥
+    void Put(const AudioStreamPacketView& packet);
+    void Reset();
+
+    // 消费者调用，返回 false 表示还在缓冲，不要出队
+    bool ReadyToPlay();
+
+    int jitter_ms() const { return jitter_ms_; }
+    int target_ms() const;
+    uint32_t received_packets() const { return received_packets_; }
+    uint32_t lost_packets() const { return lost_packets_; }
+    // 丢失的包中用下一包的 FEC 恢复的
+    uint32_t fec_packets() const { return fec_packets_; }
+    uint32_t late_packets() const { return late_packets_; }
+    uint32_t reordered_packets() const { return reordered_packets_; }
+    // 解码队列满被丢掉的包
+    uint32_t overflow_packets() const { return overflow_packets_; }
+    // 播放中队列取空、正在重新缓冲，消费者调用
+    bool underrun() const { return underrun_; }
+
+private:
+    struct HeldPacket {
+        bool valid = false;
+        uint32_t sequence = 0;
+        int sample_rate = 0;
+        int frame_duration = 0;
+        uint32_t timestamp = 0;
+        uint32_t trace_us = 0;
+        std::vector<uint8_t> payload;
+    };
+
+    AudioPacketQueue& queue_;
+    std::array<HeldPacket, JITTER_BUFFER_REORDER_WINDOW> held_;
+    int held_count_ = 0;
+    bool has_sequence_ = false;
+    uint32_t next_sequence_ = 0;
+    uint32_t arrival_index_ = 0;
+
+    // 到达抖动估计（RFC 3550 的平滑方式，只统计迟到的部分）
+    bool has_transit_ = false;
+    int64_t last_transit_ms_ = 0;
+    int frame_duration_ = 60;
+    std::atomic<int> jitter_ms_{0};
+
+    // 消费者状态
+    std::atomic<bool> reset_pending_{false};
+    bool playing_ = false;
+    bool underrun_ = false;
+    int64_t wait_start_ms_ = 0;
+
+    std::atomic<uint32_t> received_packets_{0};
+    std::atomic<uint32_t> lost_packets_{0};
+    std::atomic<uint32_t> fec_packets_{0};
+    std::atomic<uint32_t> late_packets_{0};
+    std::atomic<uint32_t> reordered_packets_{0};
+    std::atomic<uint32_t> overflow_packets_{0};
+
+    void UpdateJitter(uint32_t media_index, int frame_duration);
+    void Emit(const AudioStreamPacketView& packet);
+    void EmitHeld(HeldPacket& held);
+    void EmitLost(int sample_rate, int frame_duration);
+#if CONFIG_OPUS_INBAND_FEC
+    void EmitFec(int sample_rate, int frame_duration, const uint8_t* next, size_t size);
+#endif
+    void Hold(const AudioStreamPacketView& packet);
+    // current 是正在放入的包，可能就是丢失帧的下一包
+    void SkipOne(const AudioStreamPacketView& current);
+    void DrainHeld();
+    void ReleaseHeld();
+};
+
+#endif // JITTER_BUFFER_H
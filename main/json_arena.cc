@@ -0,0 +1,143 @@
+#include "json_arena.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <algorithm>
+#include <cstdlib>
+
+#define TAG "JsonArena"
+
+static thread_local JsonArena* current_arena = nullptr;
+
+void JsonArena::InstallHooks() {
+    cJSON_Hooks hooks = {
+        .malloc_fn = Malloc,
+        .free_fn = Free,
+    };
+    cJSON_InitHooks(&hooks);
+}
+
+JsonArena::JsonArena(size_t block_size, HeapTag tag) : block_size_(block_size), tag_(tag) {
+    previous_ = current_arena;
+    current_arena = this;
+}
+
+JsonArena::JsonArena(void* buffer, size_t size, HeapTag tag) : JsonArena(JSON_ARENA_BLOCK_SIZE, tag) {
+    if (buffer == nullptr || size <= sizeof(Block)) {
+        return;
+    }
+    external_ = (Block*)buffer;
+    external_->next = nullptr;
+    external_->size = size - sizeof(Block);
+    external_->used = 0;
+    blocks_ = external_;
+    capacity_ = external_->size;
+}
+
+JsonArena::~JsonArena() {
+    current_arena = previous_;
+    while (blocks_ != nullptr) {
+        auto next = blocks_->next;
+        if (blocks_ != external_) {
+            HeapAccounting::Free(tag_, blocks_);
+        }
+        blocks_ = next;
+    }
+}
+
+cJSON* JsonArena::Parse(const char* data, size_t length) {
+    if (current_arena != this) {
+        ESP_LOGE(TAG, "Arena is not the innermost one of this task");
+        return nullptr;
+    }
+    // 解析出来的树通常比文本大，首块按文本长度预留，避免再申请新块
+    if (blocks_ == nullptr) {
+        block_size_ = std::max(block_size_, length * 2);
+    }
+    parsing_ = true;
+    cJSON* root = cJSON_ParseWithLength(data, length);
+    parsing_ = false;
+    return root;
+}
+
+char* JsonArena::Allocate(size_t size) {
+    size = (size + 7) & ~size_t(7);
+    if (blocks_ == nullptr || blocks_->used + size > blocks_->size) {
+        size_t block_size = std::max(block_size_, size);
+        auto block = (Block*)HeapAccounting::MallocPreferSpiram(tag_, sizeof(Block) + block_size);
+        if (block == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate %u bytes", block_size);
+            return nullptr;
+        }
+        block->next = blocks_;
+        block->size = block_size;
+        block->used = 0;
+        blocks_ = block;
+        capacity_ += block_size;
+    }
+    auto ptr = (char*)blocks_->data + blocks_->used;
+    blocks_->used += size;
+    used_ += size;
+    return ptr;
+}
+
+bool JsonArena::Owns(const void* ptr) const {
+    for (auto block = blocks_; block != nullptr; block = block->next) {
+        if (ptr >= block->data && ptr < block->data + block->size) {
+            return true;
+        }
+    }
+    return false;
+}
+
+JsonRxBuffers::JsonRxBuffers(size_t small_size, size_t large_size, HeapTag tag)
+    : small_size_(small_size), large_size_(large_size), tag_(tag) {
+}
+
+JsonRxBuffers::~JsonRxBuffers() {
+    if (small_ != nullptr) {
+        HeapAccounting::Free(tag_, small_);
+    }
+    if (large_ != nullptr) {
+        HeapAccounting::Free(tag_, large_);
+    }
+}
+
+void* JsonRxBuffers::Select(size_t length, size_t& size) {
+    // 与 JsonArena::Parse 一样按文本长度的两倍估计树的大小，估小了 arena 会再从堆上申请新块
+    size_t needed = length * 2;
+    // 第一次用到某一档时才分配，之后一直保留
+    if (needed <= small_size_) {
+        if (small_ == nullptr) {
+            small_ = HeapAccounting::Malloc(tag_, small_size_, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        }
+        size = small_size_;
+        return small_;
+    }
+    if (needed <= large_size_) {
+        if (large_ == nullptr) {
+            large_ = HeapAccounting::MallocPreferSpiram(tag_, large_size_);
+        }
+        size = large_size_;
+        return large_;
+    }
+    return nullptr;
+}
+
+void* JsonArena::Malloc(size_t size) {
+    auto arena = current_arena;
+    if (arena != nullptr && arena->parsing_) {
+        return arena->Allocate(size);
+    }
+    return malloc(size);
+}
+
+void JsonArena::Free(void* ptr) {
+    // 池中的内存随池一起释放
+    for (auto arena = current_arena; arena != nullptr; arena = arena->previous_) {
+        if (arena->Owns(ptr)) {
+            return;
+        }
+    }
+    free(ptr);
+}
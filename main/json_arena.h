@@ -0,0 +1,79 @@
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include <cJSON.h>
+#include <cstddef>
+#include <cstdint>
+
+#include "heap_accounting.h"
+
+#define JSON_ARENA_BLOCK_SIZE 2048
+
+// 按消息分配的 cJSON 内存池
+// Parse() 期间 cJSON 的节点和字符串都从池中顺序分配，析构时整块释放，不产生大量小块堆内存碎片
+// 池中的树不需要（也不能在池析构后）调用 cJSON_Delete，只能在创建它的任务中使用
+class JsonArena {
+public:
+    // 启动时调用一次，必须在其它任务使用 cJSON 之前
+    static void InstallHooks();
+
+    JsonArena(size_t block_size = JSON_ARENA_BLOCK_SIZE, HeapTag tag = kHeapTagProtocol);
+    // 以调用方预分配的缓冲区作为第一块（8 字节对齐），析构时不释放它；buffer 为 nullptr 时同上一个构造函数
+    JsonArena(void* buffer, size_t size, HeapTag tag = kHeapTagProtocol);
+    ~JsonArena();
+    JsonArena(const JsonArena&) = delete;
+    JsonArena& operator=(const JsonArena&) = delete;
+
+    cJSON* Parse(const char* data, size_t length);
+    // 分配接收缓冲区，调用方可以直接把 HTTP body 读进来再原地解析
+    char* Allocate(size_t size);
+
+    size_t used() const { return used_; }
+    size_t capacity() const { return capacity_; }
+
+private:
+    struct Block {
+        Block* next;
+        size_t size;
+        size_t used;
+        alignas(8) uint8_t data[];
+    };
+
+    Block* blocks_ = nullptr;
+    Block* external_ = nullptr;
+    size_t block_size_;
+    HeapTag tag_;
+    size_t used_ = 0;
+    size_t capacity_ = 0;
+    bool parsing_ = false;
+    // 同一任务中的池按创建顺序串成链表，释放时据此判断指针是否属于某个池
+    JsonArena* previous_ = nullptr;
+
+    bool Owns(const void* ptr) const;
+    static void* Malloc(size_t size);
+    static void Free(void* ptr);
+};
+
+// 接收任务专用的两档预分配缓冲区，配合 JsonArena(buffer, size) 使用
+// 每条消息的 JSON 树建在复用的缓冲区中，不再每条消息申请和释放一块大小不一的堆内存
+// 只能在一个任务中使用，同一时间只能有一个 arena 使用它
+class JsonRxBuffers {
+public:
+    // 小的一档放内部 RAM，大的一档优先放 PSRAM
+    JsonRxBuffers(size_t small_size, size_t large_size, HeapTag tag = kHeapTagProtocol);
+    ~JsonRxBuffers();
+    JsonRxBuffers(const JsonRxBuffers&) = delete;
+    JsonRxBuffers& operator=(const JsonRxBuffers&) = delete;
+
+    // 返回能容纳 length 字节文本解析结果的最小一档，都放不下或分配失败时返回 nullptr
+    void* Select(size_t length, size_t& size);
+
+private:
+    void* small_ = nullptr;
+    void* large_ = nullptr;
+    size_t small_size_;
+    size_t large_size_;
+    HeapTag tag_;
+};
+
+#endif // JSON_ARENA_H
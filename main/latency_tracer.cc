@@ -0,0 +1,122 @@
+#include "latency_tracer.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <cJSON.h>
+
+#define TAG "LatencyTracer"
+
+static const char* const METRIC_NAMES[] = {
+    "wake_to_open",
+    "wake_to_uplink",
+    "stt_to_tts",
+    "tts_to_downlink",
+    "downlink_to_pcm",
+    "stt_to_pcm",
+    "handshake",
+};
+
+uint32_t LatencyTracer::NowMs() {
+    // 0 表示未记录，所以时间戳至少为 1
+    uint32_t now = esp_timer_get_time() / 1000;
+    return now == 0 ? 1 : now;
+}
+
+void LatencyTracer::BeginSession() {
+    for (auto& histogram : histograms_) {
+        histogram = Histogram();
+    }
+}
+
+void LatencyTracer::BeginTurn() {
+    for (auto& mark : marks_) {
+        mark.store(0, std::memory_order_relaxed);
+    }
+}
+
+void LatencyTracer::Mark(LatencyEvent event) {
+    uint32_t expected = 0;
+    marks_[event].compare_exchange_strong(expected, NowMs(), std::memory_order_relaxed);
+}
+
+void LatencyTracer::Record(LatencyMetric metric, LatencyEvent from, LatencyEvent to) {
+    uint32_t start = marks_[from].load(std::memory_order_relaxed);
+    uint32_t end = marks_[to].load(std::memory_order_relaxed);
+    if (start == 0 || end == 0 || static_cast<int32_t>(end - start) < 0) {
+        return;
+    }
+
+    uint32_t duration = end - start;
+    auto& histogram = histograms_[metric];
+    int bucket = 0;
+    for (uint32_t bound = 50; bucket < LATENCY_HISTOGRAM_BUCKETS - 1 && duration >= bound; bound *= 2) {
+        bucket++;
+    }
+    histogram.buckets[bucket]++;
+    histogram.count++;
+    histogram.sum_ms += duration;
+    if (duration > histogram.max_ms) {
+        histogram.max_ms = duration;
+    }
+    ESP_LOGI(TAG, "%s: %lu ms", METRIC_NAMES[metric], duration);
+}
+
+bool LatencyTracer::EndTurn() {
+    uint32_t before = 0;
+    for (auto& histogram : histograms_) {
+        before += histogram.count;
+    }
+
+    Record(kLatencyWakeToOpen, kLatencyWakeWord, kLatencyChannelOpened);
+    Record(kLatencyWakeToUplink, kLatencyWakeWord, kLatencyFirstUplink);
+    Record(kLatencySttToTts, kLatencySttReceived, kLatencyTtsStart);
+    Record(kLatencyTtsToDownlink, kLatencyTtsStart, kLatencyFirstDownlink);
+    Record(kLatencyDownlinkToPcm, kLatencyFirstDownlink, kLatencyFirstPcm);
+    Record(kLatencySttToPcm, kLatencySttReceived, kLatencyFirstPcm);
+    Record(kLatencyHandshake, kLatencyConnectStart, kLatencyChannelOpened);
+    BeginTurn();
+
+    uint32_t after = 0;
+    for (auto& histogram : histograms_) {
+        after += histogram.count;
+    }
+    return after > before;
+}
+
+void LatencyTracer::LogSession() const {
+    for (int i = 0; i < kLatencyMetricCount; i++) {
+        auto& h = histograms_[i];
+        if (h.count == 0) {
+            continue;
+        }
+        ESP_LOGI(TAG, "%-16s n=%lu avg=%lu max=%lu [%lu %lu %lu %lu %lu %lu %lu %lu]", METRIC_NAMES[i],
+            h.count, h.sum_ms / h.count, h.max_ms,
+            h.buckets[0], h.buckets[1], h.buckets[2], h.buckets[3],
+            h.buckets[4], h.buckets[5], h.buckets[6], h.buckets[7]);
+    }
+}
+
+std::string LatencyTracer::GetSessionJson() const {
+    cJSON* root = cJSON_CreateObject();
+    for (int i = 0; i < kLatencyMetricCount; i++) {
+        auto& h = histograms_[i];
+        if (h.count == 0) {
+            continue;
+        }
+        cJSON* metric = cJSON_CreateObject();
+        cJSON_AddNumberToObject(metric, "count", h.count);
+        cJSON_AddNumberToObject(metric, "avg", h.sum_ms / h.count);
+        cJSON_AddNumberToObject(metric, "max", h.max_ms);
+        cJSON* buckets = cJSON_CreateArray();
+        for (int j = 0; j < LATENCY_HISTOGRAM_BUCKETS; j++) {
+            cJSON_AddItemToArray(buckets, cJSON_CreateNumber(h.buckets[j]));
+        }
+        cJSON_AddItemToObject(metric, "buckets", buckets);
+        cJSON_AddItemToObject(root, METRIC_NAMES[i], metric);
+    }
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
+}
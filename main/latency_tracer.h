@@ -0,0 +1,62 @@
+#ifndef LATENCY_TRACER_H
+#define LATENCY_TRACER_H
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+enum LatencyEvent {
+    kLatencyWakeWord,
+    kLatencyConnectStart,
+    kLatencyChannelOpened,
+    kLatencyFirstUplink,
+    kLatencySttReceived,
+    kLatencyTtsStart,
+    kLatencyFirstDownlink,
+    kLatencyFirstPcm,
+    kLatencyEventCount
+};
+
+enum LatencyMetric {
+    kLatencyWakeToOpen,
+    kLatencyWakeToUplink,
+    kLatencySttToTts,
+    kLatencyTtsToDownlink,
+    kLatencyDownlinkToPcm,
+    kLatencySttToPcm,
+    kLatencyHandshake,
+    kLatencyMetricCount
+};
+
+#define LATENCY_HISTOGRAM_BUCKETS 8
+
+// 语音交互端到端延迟统计
+// Mark() 只记录每一轮对话中第一次出现的时间点，开销是一次原子比较交换，可以在生产环境常开
+// 每轮结束时计算各阶段耗时并累加到会话直方图中（桶边界 50ms 起按 2 倍递增）
+class LatencyTracer {
+public:
+    void BeginSession();
+    void BeginTurn();
+    void Mark(LatencyEvent event);
+    // 结束当前轮次，返回是否有新的统计数据
+    bool EndTurn();
+
+    void LogSession() const;
+    std::string GetSessionJson() const;
+
+private:
+    struct Histogram {
+        uint32_t buckets[LATENCY_HISTOGRAM_BUCKETS] = {0};
+        uint32_t count = 0;
+        uint32_t sum_ms = 0;
+        uint32_t max_ms = 0;
+    };
+
+    std::atomic<uint32_t> marks_[kLatencyEventCount] = {};
+    Histogram histograms_[kLatencyMetricCount];
+
+    void Record(LatencyMetric metric, LatencyEvent from, LatencyEvent to);
+    static uint32_t NowMs();
+};
+
+#endif // LATENCY_TRACER_H
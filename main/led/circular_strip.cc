@@ -1,17 +1,14 @@
 #include "circular_strip.h"
 #include "application.h"
 #include <esp_log.h>
+#include <algorithm>
 
 #define TAG "CircularStrip"
 
-#define BLINK_INFINITE -1
-
 CircularStrip::CircularStrip(gpio_num_t gpio, uint8_t max_leds) : max_leds_(max_leds) {
     // If the gpio is not connected, you should use NoLed class
     assert(gpio != GPIO_NUM_NC);
 
-    colors_.resize(max_leds_);
-
     led_strip_config_t strip_config = {};
     strip_config.strip_gpio_num = gpio;
     strip_config.max_leds = max_leds_;
@@ -20,28 +17,35 @@ CircularStrip::CircularStrip(gpio_num_t gpio, uint8_t max_leds) : max_leds_(max_
 
     led_strip_rmt_config_t rmt_config = {};
     rmt_config.resolution_hz = 10 * 1000 * 1000; // 10MHz
-
-    ESP_ERROR_CHECK(led_strip_new_rmt_device(&strip_config, &rmt_config, &led_strip_));
+#if CONFIG_LED_STRIP_RMT_DMA
+    // 整帧由 DMA 发送，刷新时不用反复进中断填充 RMT 内存块
+    rmt_config.flags.with_dma = true;
+    rmt_config.mem_block_symbols = 1024;
+#endif
+
+    esp_err_t err = led_strip_new_rmt_device(&strip_config, &rmt_config, &led_strip_);
+#if CONFIG_LED_STRIP_RMT_DMA
+    if (err != ESP_OK) {
+        // DMA 通道被占用时退回普通模式
+        ESP_LOGW(TAG, "Failed to create LED strip with DMA: %s, fall back to RMT memory", esp_err_to_name(err));
+        rmt_config.flags.with_dma = false;
+        rmt_config.mem_block_symbols = 0;
+        err = led_strip_new_rmt_device(&strip_config, &rmt_config, &led_strip_);
+    }
+#endif
+    ESP_ERROR_CHECK(err);
     led_strip_clear(led_strip_);
 
-    esp_timer_create_args_t strip_timer_args = {
-        .callback = [](void *arg) {
-            auto strip = static_cast<CircularStrip*>(arg);
-            std::lock_guard<std::mutex> lock(strip->mutex_);
-            if (strip->strip_callback_ != nullptr) {
-                strip->strip_callback_();
-            }
-        },
-        .arg = this,
-        .dispatch_method = ESP_TIMER_TASK,
-        .name = "strip_timer",
-        .skip_unhandled_events = false,
-    };
-    ESP_ERROR_CHECK(esp_timer_create(&strip_timer_args, &strip_timer_));
+    channel_ = std::make_unique<LedChannel>(max_leds_, [this](const StripColor* pixels, int count) {
+        for (int i = 0; i < count; i++) {
+            led_strip_set_pixel(led_strip_, i, pixels[i].red, pixels[i].green, pixels[i].blue);
+        }
+        led_strip_refresh(led_strip_);
+    });
 }
 
 CircularStrip::~CircularStrip() {
-    esp_timer_stop(strip_timer_);
+    channel_.reset();
     if (led_strip_ != nullptr) {
         led_strip_del(led_strip_);
     }
@@ -49,131 +53,54 @@ CircularStrip::~CircularStrip() {
 
 
 void CircularStrip::SetAllColor(StripColor color) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(strip_timer_);
-    for (int i = 0; i < max_leds_; i++) {
-        colors_[i] = color;
-        led_strip_set_pixel(led_strip_, i, color.red, color.green, color.blue);
-    }
-    led_strip_refresh(led_strip_);
+    channel_->SetAll(color);
 }
 
 void CircularStrip::SetSingleColor(uint8_t index, StripColor color) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(strip_timer_);
-    colors_[index] = color;
-    led_strip_set_pixel(led_strip_, index, color.red, color.green, color.blue);
-    led_strip_refresh(led_strip_);
+    channel_->SetPixel(index, color);
 }
 
 void CircularStrip::Blink(StripColor color, int interval_ms) {
-    for (int i = 0; i < max_leds_; i++) {
-        colors_[i] = color;
-    }
-    StartStripTask(interval_ms, [this]() {
-        static bool on = true;
-        if (on) {
-            for (int i = 0; i < max_leds_; i++) {
-                led_strip_set_pixel(led_strip_, i, colors_[i].red, colors_[i].green, colors_[i].blue);
-            }
-            led_strip_refresh(led_strip_);
-        } else {
-            led_strip_clear(led_strip_);
-        }
-        on = !on;
-    });
+    LedProgram program;
+    program.frames = {
+        { color, 0, (uint16_t)interval_ms },
+        { StripColor(), 0, (uint16_t)interval_ms },
+    };
+    program.repeat = LED_PROGRAM_INFINITE;
+    channel_->Play(std::move(program));
 }
 
-void CircularStrip::FadeOut(int interval_ms) {
-    StartStripTask(interval_ms, [this]() {
-        bool all_off = true;
-        for (int i = 0; i < max_leds_; i++) {
-            colors_[i].red /= 2;
-            colors_[i].green /= 2;
-            colors_[i].blue /= 2;
-            if (colors_[i].red != 0 || colors_[i].green != 0 || colors_[i].blue != 0) {
-                all_off = false;
-            }
-            led_strip_set_pixel(led_strip_, i, colors_[i].red, colors_[i].green, colors_[i].blue);
-        }
-        if (all_off) {
-            led_strip_clear(led_strip_);
-            esp_timer_stop(strip_timer_);
-        } else {
-            led_strip_refresh(led_strip_);
-        }
-    });
+void CircularStrip::FadeOut(int duration_ms) {
+    // 从当前颜色渐变到熄灭
+    LedProgram program;
+    program.frames = {
+        { StripColor(), (uint16_t)duration_ms, 0 },
+    };
+    channel_->Play(std::move(program));
 }
 
 void CircularStrip::Breathe(StripColor low, StripColor high, int interval_ms) {
-    StartStripTask(interval_ms, [this, low, high]() {
-        static bool increase = true;
-        static StripColor color = low;
-        if (increase) {
-            if (color.red < high.red) {
-                color.red++;
-            }
-            if (color.green < high.green) {
-                color.green++;
-            }
-            if (color.blue < high.blue) {
-                color.blue++;
-            }
-            if (color.red == high.red && color.green == high.green && color.blue == high.blue) {
-                increase = false;
-            }
-        } else {
-            if (color.red > low.red) {
-                color.red--;
-            }
-            if (color.green > low.green) {
-                color.green--;
-            }
-            if (color.blue > low.blue) {
-                color.blue--;
-            }
-            if (color.red == low.red && color.green == low.green && color.blue == low.blue) {
-                increase = true;
-            }
-        }
-        for (int i = 0; i < max_leds_; i++) {
-            led_strip_set_pixel(led_strip_, i, color.red, color.green, color.blue);
-        }
-        led_strip_refresh(led_strip_);
-    });
+    // 原来每个间隔变化 1 级，一次渐变的时长按最大的颜色差计算
+    int steps = std::max({ high.red - low.red, high.green - low.green, high.blue - low.blue, 1 });
+    uint16_t fade_ms = std::min(steps * interval_ms, 60000);
+    LedProgram program;
+    program.frames = {
+        { high, fade_ms, 0 },
+        { low, fade_ms, 0 },
+    };
+    program.repeat = LED_PROGRAM_INFINITE;
+    channel_->Play(std::move(program));
 }
 
 void CircularStrip::Scroll(StripColor low, StripColor high, int length, int interval_ms) {
-    for (int i = 0; i < max_leds_; i++) {
-        colors_[i] = low;
-    }
-    StartStripTask(interval_ms, [this, low, high, length]() {
-        static int offset = 0;
-        for (int i = 0; i < max_leds_; i++) {
-            colors_[i] = low;
-        }
-        for (int j = 0; j < length; j++) {
-            int i = (offset + j) % max_leds_;
-            colors_[i] = high;
-        }
-        for (int i = 0; i < max_leds_; i++) {
-            led_strip_set_pixel(led_strip_, i, colors_[i].red, colors_[i].green, colors_[i].blue);
-        }
-        led_strip_refresh(led_strip_);
-        offset = (offset + 1) % max_leds_;
-    });
-}
-
-void CircularStrip::StartStripTask(int interval_ms, std::function<void()> cb) {
-    if (led_strip_ == nullptr) {
-        return;
-    }
-
-    std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(strip_timer_);
-    
-    strip_callback_ = cb;
-    esp_timer_start_periodic(strip_timer_, interval_ms * 1000);
+    LedProgram program;
+    program.frames = {
+        { high, 0, 0 },
+    };
+    program.scroll_length = length;
+    program.scroll_ms = interval_ms;
+    program.background = low;
+    channel_->Play(std::move(program));
 }
 
 void CircularStrip::SetBrightness(uint8_t default_brightness, uint8_t low_brightness) {
@@ -198,7 +125,7 @@ void CircularStrip::OnStateChanged() {
             break;
         }
         case kDeviceStateIdle:
-            FadeOut(50);
+            FadeOut(300);
             break;
         case kDeviceStateConnecting: {
             StripColor color = { low_brightness_, low_brightness_, default_brightness_ };
@@ -13,7 +13,7 @@
 #define UPGRADING_BRIGHTNESS 25
 #define ACTIVATING_BRIGHTNESS 35
 
-#define BLINK_INFINITE -1
+#define BLINK_INFINITE LED_PROGRAM_INFINITE
 
 // GPIO_LED
 #define LEDC_LS_TIMER          LEDC_TIMER_1
@@ -69,23 +69,17 @@ GpioLed::GpioLed(gpio_num_t gpio, int output_invert, ledc_timer_t timer_num, led
     };
     ledc_cb_register(ledc_channel_.speed_mode, ledc_channel_.channel, &ledc_callbacks, this);
 
-    esp_timer_create_args_t blink_timer_args = {
-        .callback = [](void *arg) {
-            auto led = static_cast<GpioLed*>(arg);
-            led->OnBlinkTimer();
-        },
-        .arg = this,
-        .dispatch_method = ESP_TIMER_TASK,
-        .name = "Blink Timer",
-        .skip_unhandled_events = false,
-    };
-    ESP_ERROR_CHECK(esp_timer_create(&blink_timer_args, &blink_timer_));
+    // 闪烁由 LedEffectEngine 驱动，呼吸仍用 LEDC 硬件渐变；通道里的颜色只用 red 表示亮度，255 对应 duty_
+    channel_ = std::make_unique<LedChannel>(1, [this](const StripColor* pixels, int count) {
+        ledc_set_duty(ledc_channel_.speed_mode, ledc_channel_.channel, pixels[0].red * duty_ / 255);
+        ledc_update_duty(ledc_channel_.speed_mode, ledc_channel_.channel);
+    });
 
     ledc_initialized_ = true;
 }
 
 GpioLed::~GpioLed() {
-    esp_timer_stop(blink_timer_);
+    channel_.reset();
     if (ledc_initialized_) {
         ledc_fade_stop(ledc_channel_.speed_mode, ledc_channel_.channel);
         ledc_fade_func_uninstall();
@@ -107,10 +101,8 @@ void GpioLed::TurnOn() {
     }
 
     std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(blink_timer_);
     ledc_fade_stop(ledc_channel_.speed_mode, ledc_channel_.channel);
-    ledc_set_duty(ledc_channel_.speed_mode, ledc_channel_.channel, duty_);
-    ledc_update_duty(ledc_channel_.speed_mode, ledc_channel_.channel);
+    channel_->SetAll({ 255, 255, 255 });
 }
 
 void GpioLed::TurnOff() {
@@ -119,10 +111,8 @@ void GpioLed::TurnOff() {
     }
 
     std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(blink_timer_);
     ledc_fade_stop(ledc_channel_.speed_mode, ledc_channel_.channel);
-    ledc_set_duty(ledc_channel_.speed_mode, ledc_channel_.channel, 0);
-    ledc_update_duty(ledc_channel_.speed_mode, ledc_channel_.channel);
+    channel_->SetAll(StripColor());
 }
 
 void GpioLed::BlinkOnce() {
@@ -143,27 +133,15 @@ void GpioLed::StartBlinkTask(int times, int interval_ms) {
     }
 
     std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(blink_timer_);
     ledc_fade_stop(ledc_channel_.speed_mode, ledc_channel_.channel);
 
-    blink_counter_ = times * 2;
-    blink_interval_ms_ = interval_ms;
-    esp_timer_start_periodic(blink_timer_, interval_ms * 1000);
-}
-
-void GpioLed::OnBlinkTimer() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    blink_counter_--;
-    if (blink_counter_ & 1) {
-        ledc_set_duty(ledc_channel_.speed_mode, ledc_channel_.channel, duty_);
-    } else {
-        ledc_set_duty(ledc_channel_.speed_mode, ledc_channel_.channel, 0);
-
-        if (blink_counter_ == 0) {
-            esp_timer_stop(blink_timer_);
-        }
-    }
-    ledc_update_duty(ledc_channel_.speed_mode, ledc_channel_.channel);
+    LedProgram program;
+    program.frames = {
+        { { 255, 255, 255 }, 0, (uint16_t)interval_ms },
+        { StripColor(), 0, (uint16_t)interval_ms },
+    };
+    program.repeat = times;
+    channel_->Play(std::move(program));
 }
 
 void GpioLed::StartFadeTask() {
@@ -172,7 +150,7 @@ void GpioLed::StartFadeTask() {
     }
 
     std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(blink_timer_);
+    channel_->Stop();
     ledc_fade_stop(ledc_channel_.speed_mode, ledc_channel_.channel);
     fade_up_ = true;
     ledc_set_fade_with_time(ledc_channel_.speed_mode,
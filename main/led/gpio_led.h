@@ -4,10 +4,11 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include "led.h"
+#include "led_effect.h"
 #include <driver/gpio.h>
 #include <driver/ledc.h>
-#include <esp_timer.h>
 #include <atomic>
+#include <memory>
 #include <mutex>
 
 class GpioLed : public Led {
@@ -24,17 +25,13 @@ class GpioLed : public Led {
 
  private:
     std::mutex mutex_;
-    TaskHandle_t blink_task_ = nullptr;
     ledc_channel_config_t ledc_channel_ = {0};
     bool ledc_initialized_ = false;
     uint32_t duty_ = 0;
-    int blink_counter_ = 0;
-    int blink_interval_ms_ = 0;
-    esp_timer_handle_t blink_timer_ = nullptr;
+    std::unique_ptr<LedChannel> channel_;
     bool fade_up_ = true;
 
     void StartBlinkTask(int times, int interval_ms);
-    void OnBlinkTimer();
 
     void BlinkOnce();
     void Blink(int times, int interval_ms);
@@ -0,0 +1,235 @@
+#include "led_effect.h"
+#include "task_manifest.h"
+#include "memory_pressure.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <algorithm>
+#include <cmath>
+
+#define TAG "LedEffect"
+
+// 有动画时的帧间隔，所有灯共用
+#define LED_EFFECT_TICK_MS 20
+
+LedChannel::LedChannel(int count, Output output) : count_(count), output_(output) {
+    from_.resize(count_);
+    pixels_[0].resize(count_);
+    pixels_[1].resize(count_);
+    LedEffectEngine::GetInstance().Register(this);
+}
+
+LedChannel::~LedChannel() {
+    LedEffectEngine::GetInstance().Unregister(this);
+}
+
+void LedChannel::StopLocked() {
+    // 从当前显示的颜色开始，新的程序可以从这里渐变
+    from_ = pixels_[front_];
+    running_ = false;
+    program_ = LedProgram();
+}
+
+void LedChannel::Stop() {
+    std::lock_guard<std::mutex> lock(LedEffectEngine::GetInstance().mutex_);
+    StopLocked();
+}
+
+void LedChannel::Play(LedProgram program) {
+    auto& engine = LedEffectEngine::GetInstance();
+    {
+        std::lock_guard<std::mutex> lock(engine.mutex_);
+        StopLocked();
+        force_output_ = true;
+        program_ = std::move(program);
+        int64_t now = esp_timer_get_time();
+        running_ = !program_.frames.empty();
+        frame_index_ = 0;
+        repeat_left_ = program_.repeat;
+        int total_ms = 0;
+        for (auto& frame : program_.frames) {
+            total_ms += frame.fade_ms + frame.hold_ms;
+        }
+        if (total_ms == 0) {
+            // 没有时长的程序只播放一次
+            repeat_left_ = 1;
+        }
+        frame_start_us_ = now;
+        scroll_last_us_ = now;
+        scroll_offset_ = 0;
+    }
+    engine.Wake();
+}
+
+void LedChannel::SetAll(StripColor color) {
+    auto& engine = LedEffectEngine::GetInstance();
+    {
+        std::lock_guard<std::mutex> lock(engine.mutex_);
+        StopLocked();
+        force_output_ = true;
+        std::fill(from_.begin(), from_.end(), color);
+    }
+    engine.Wake();
+}
+
+void LedChannel::SetPixel(int index, StripColor color) {
+    if (index < 0 || index >= count_) {
+        return;
+    }
+    auto& engine = LedEffectEngine::GetInstance();
+    {
+        std::lock_guard<std::mutex> lock(engine.mutex_);
+        StopLocked();
+        force_output_ = true;
+        from_[index] = color;
+    }
+    engine.Wake();
+}
+
+StripColor LedChannel::Target(int index, StripColor color) const {
+    if (program_.scroll_length > 0) {
+        int position = (index - scroll_offset_ + count_) % count_;
+        return position < program_.scroll_length ? color : program_.background;
+    }
+    return color;
+}
+
+bool LedChannel::Render(int64_t now_us) {
+    auto& engine = LedEffectEngine::GetInstance();
+    auto& frames = program_.frames;
+
+    // 跳过已经结束的关键帧
+    while (running_) {
+        auto& frame = frames[frame_index_];
+        int64_t duration = (frame.fade_ms + frame.hold_ms) * 1000LL;
+        if (now_us - frame_start_us_ < duration) {
+            break;
+        }
+        for (int i = 0; i < count_; i++) {
+            from_[i] = Target(i, frame.color);
+        }
+        frame_start_us_ += duration;
+        if (++frame_index_ < frames.size()) {
+            continue;
+        }
+        if (repeat_left_ != LED_PROGRAM_INFINITE && --repeat_left_ <= 0) {
+            // 停在最后一帧
+            running_ = false;
+            frame_index_ = frames.size() - 1;
+            break;
+        }
+        frame_index_ = 0;
+    }
+
+    bool scrolling = program_.scroll_length > 0 && program_.scroll_ms > 0 && !frames.empty();
+    if (scrolling && now_us - scroll_last_us_ >= program_.scroll_ms * 1000LL) {
+        scroll_offset_ = (scroll_offset_ + 1) % count_;
+        scroll_last_us_ = now_us;
+    }
+
+    auto& back = pixels_[front_ ^ 1];
+    if (running_) {
+        auto& frame = frames[frame_index_];
+        int64_t elapsed = now_us - frame_start_us_;
+        int t = 255;
+        if (frame.fade_ms > 0 && elapsed < frame.fade_ms * 1000LL) {
+            t = elapsed * 255 / (frame.fade_ms * 1000LL);
+        }
+        for (int i = 0; i < count_; i++) {
+            StripColor target = Target(i, frame.color);
+            back[i].red = engine.Blend(from_[i].red, target.red, t);
+            back[i].green = engine.Blend(from_[i].green, target.green, t);
+            back[i].blue = engine.Blend(from_[i].blue, target.blue, t);
+        }
+    } else if (scrolling) {
+        for (int i = 0; i < count_; i++) {
+            back[i] = Target(i, frames[frame_index_].color);
+        }
+    } else {
+        back = from_;
+    }
+
+    bool changed = false;
+    for (int i = 0; i < count_ && !changed; i++) {
+        auto& a = back[i];
+        auto& b = pixels_[front_][i];
+        changed = a.red != b.red || a.green != b.green || a.blue != b.blue;
+    }
+    if (changed || force_output_) {
+        output_(back.data(), count_);
+        front_ ^= 1;
+        force_output_ = false;
+    }
+    return running_ || scrolling;
+}
+
+LedEffectEngine::LedEffectEngine() : frame_interval_ms_(LED_EFFECT_TICK_MS) {
+    for (int i = 0; i < 256; i++) {
+        gamma_[i] = (uint8_t)std::lround(255.0 * std::pow(i / 255.0, 2.2));
+        inverse_gamma_[i] = (uint8_t)std::lround(255.0 * std::pow(i / 255.0, 1 / 2.2));
+    }
+    MemoryPressure::GetInstance().Subscribe(kMemoryStageLedEffects, [this](bool engaged) {
+        SetPaused(engaged);
+    });
+}
+
+void LedEffectEngine::SetFrameInterval(int interval_ms) {
+    frame_interval_ms_ = std::max(interval_ms, LED_EFFECT_TICK_MS);
+}
+
+void LedEffectEngine::SetPaused(bool paused) {
+    if (paused_.exchange(paused) != paused && !paused) {
+        Wake();
+    }
+}
+
+uint8_t LedEffectEngine::Blend(uint8_t from, uint8_t to, int t) const {
+    if (t <= 0 || from == to) {
+        return from;
+    }
+    if (t >= 255) {
+        return to;
+    }
+    int a = inverse_gamma_[from];
+    int b = inverse_gamma_[to];
+    return gamma_[a + (b - a) * t / 255];
+}
+
+void LedEffectEngine::Register(LedChannel* channel) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    channels_.push_back(channel);
+    if (task_ == nullptr) {
+        TaskManifest::GetInstance().Create(kTaskLedEffect, [this]() {
+            Loop();
+        }, &task_);
+    }
+}
+
+void LedEffectEngine::Unregister(LedChannel* channel) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    channels_.erase(std::remove(channels_.begin(), channels_.end(), channel), channels_.end());
+}
+
+void LedEffectEngine::Wake() {
+    if (task_ != nullptr) {
+        xTaskNotifyGive(task_);
+    }
+}
+
+void LedEffectEngine::Loop() {
+    while (true) {
+        bool animating = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            int64_t now = esp_timer_get_time();
+            for (auto channel : channels_) {
+                if (channel->Render(now)) {
+                    animating = true;
+                }
+            }
+        }
+        // 没有动画或暂停时一直等到有灯改变颜色
+        animating = animating && !paused_.load(std::memory_order_relaxed);
+        ulTaskNotifyTake(pdTRUE, animating ? pdMS_TO_TICKS(frame_interval_ms_.load(std::memory_order_relaxed)) : portMAX_DELAY);
+    }
+}
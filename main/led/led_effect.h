@@ -0,0 +1,110 @@
+#ifndef _LED_EFFECT_H_
+#define _LED_EFFECT_H_
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+struct StripColor {
+    uint8_t red = 0, green = 0, blue = 0;
+};
+
+// 灯效的一帧：从上一帧渐变到 color，然后保持
+struct LedKeyframe {
+    StripColor color;
+    uint16_t fade_ms = 0;   // 0 表示立即切换
+    uint16_t hold_ms = 0;
+};
+
+#define LED_PROGRAM_INFINITE -1
+
+// 灯效程序：顺序执行关键帧，repeat 是播放次数，LED_PROGRAM_INFINITE 表示循环
+// scroll_length 大于 0 时只有连续的 scroll_length 个灯显示关键帧颜色，其余显示 background，每 scroll_ms 前移一格
+struct LedProgram {
+    std::vector<LedKeyframe> frames;
+    int repeat = 1;
+    int scroll_length = 0;
+    int scroll_ms = 0;
+    StripColor background;
+};
+
+// 一组灯（单灯或灯带），由 LedEffectEngine 统一计算每一帧，颜色有变化时才调用 output 刷新硬件
+class LedChannel {
+public:
+    using Output = std::function<void(const StripColor* pixels, int count)>;
+
+    LedChannel(int count, Output output);
+    ~LedChannel();
+
+    // 开始程序或设置颜色后总会刷新一次硬件，硬件可能被别的途径改过（例如 LEDC 硬件渐变）
+    void Play(LedProgram program);
+    // 停止当前程序，直接设置颜色
+    void SetAll(StripColor color);
+    void SetPixel(int index, StripColor color);
+    // 停止当前程序，不再刷新硬件
+    void Stop();
+
+private:
+    friend class LedEffectEngine;
+
+    int count_;
+    Output output_;
+    LedProgram program_;
+    bool running_ = false;
+    size_t frame_index_ = 0;
+    int repeat_left_ = 0;
+    int64_t frame_start_us_ = 0;
+    int64_t scroll_last_us_ = 0;
+    int scroll_offset_ = 0;
+    // 当前关键帧开始时各灯的颜色
+    std::vector<StripColor> from_;
+    // 双缓冲：新的一帧算在后缓冲，和前缓冲相同时不刷新硬件
+    std::vector<StripColor> pixels_[2];
+    int front_ = 0;
+    bool force_output_ = false;
+
+    void StopLocked();
+    StripColor Target(int index, StripColor color) const;
+    // 计算并输出一帧，返回是否还有后续变化
+    bool Render(int64_t now_us);
+};
+
+// 所有灯共用一个低优先级任务计算帧，没有动画时任务一直阻塞
+// 原来每个灯效各自的 esp_timer 回调在高优先级的 esp_timer 任务中刷新 RMT，会推迟其他定时器和音频相关的回调
+class LedEffectEngine {
+public:
+    static LedEffectEngine& GetInstance() {
+        static LedEffectEngine instance;
+        return instance;
+    }
+
+    // 按 gamma 2.2 在感知亮度上插值，渐变看起来是匀速的；t 为 0-255
+    uint8_t Blend(uint8_t from, uint8_t to, int t) const;
+    // 动画的帧间隔，过热时调大以减少刷新次数；渐变和保持时间不变
+    void SetFrameInterval(int interval_ms);
+    // 暂停时颜色变化仍然立即输出，但动画停在当前帧，任务不再定时唤醒
+    void SetPaused(bool paused);
+
+private:
+    friend class LedChannel;
+
+    std::mutex mutex_;
+    std::vector<LedChannel*> channels_;
+    TaskHandle_t task_ = nullptr;
+    std::atomic<int> frame_interval_ms_;
+    std::atomic<bool> paused_{false};
+    uint8_t gamma_[256];
+    uint8_t inverse_gamma_[256];
+
+    LedEffectEngine();
+    void Register(LedChannel* channel);
+    void Unregister(LedChannel* channel);
+    void Wake();
+    void Loop();
+};
+
+#endif // _LED_EFFECT_H_
@@ -8,7 +8,7 @@
 #define HIGH_BRIGHTNESS 16
 #define LOW_BRIGHTNESS 2
 
-#define BLINK_INFINITE -1
+#define BLINK_INFINITE LED_PROGRAM_INFINITE
 
 
 SingleLed::SingleLed(gpio_num_t gpio) {
@@ -27,21 +27,14 @@ SingleLed::SingleLed(gpio_num_t gpio) {
     ESP_ERROR_CHECK(led_strip_new_rmt_device(&strip_config, &rmt_config, &led_strip_));
     led_strip_clear(led_strip_);
 
-    esp_timer_create_args_t blink_timer_args = {
-        .callback = [](void *arg) {
-            auto led = static_cast<SingleLed*>(arg);
-            led->OnBlinkTimer();
-        },
-        .arg = this,
-        .dispatch_method = ESP_TIMER_TASK,
-        .name = "blink_timer",
-        .skip_unhandled_events = false,
-    };
-    ESP_ERROR_CHECK(esp_timer_create(&blink_timer_args, &blink_timer_));
+    channel_ = std::make_unique<LedChannel>(1, [this](const StripColor* pixels, int count) {
+        led_strip_set_pixel(led_strip_, 0, pixels[0].red, pixels[0].green, pixels[0].blue);
+        led_strip_refresh(led_strip_);
+    });
 }
 
 SingleLed::~SingleLed() {
-    esp_timer_stop(blink_timer_);
+    channel_.reset();
     if (led_strip_ != nullptr) {
         led_strip_del(led_strip_);
     }
@@ -55,24 +48,11 @@ void SingleLed::SetColor(uint8_t r, uint8_t g, uint8_t b) {
 }
 
 void SingleLed::TurnOn() {
-    if (led_strip_ == nullptr) {
-        return;
-    }
-    
-    std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(blink_timer_);
-    led_strip_set_pixel(led_strip_, 0, r_, g_, b_);
-    led_strip_refresh(led_strip_);
+    channel_->SetAll({ r_, g_, b_ });
 }
 
 void SingleLed::TurnOff() {
-    if (led_strip_ == nullptr) {
-        return;
-    }
-
-    std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(blink_timer_);
-    led_strip_clear(led_strip_);
+    channel_->SetAll(StripColor());
 }
 
 void SingleLed::BlinkOnce() {
@@ -88,31 +68,13 @@ void SingleLed::StartContinuousBlink(int interval_ms) {
 }
 
 void SingleLed::StartBlinkTask(int times, int interval_ms) {
-    if (led_strip_ == nullptr) {
-        return;
-    }
-
-    std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(blink_timer_);
-    
-    blink_counter_ = times * 2;
-    blink_interval_ms_ = interval_ms;
-    esp_timer_start_periodic(blink_timer_, interval_ms * 1000);
-}
-
-void SingleLed::OnBlinkTimer() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    blink_counter_--;
-    if (blink_counter_ & 1) {
-        led_strip_set_pixel(led_strip_, 0, r_, g_, b_);
-        led_strip_refresh(led_strip_);
-    } else {
-        led_strip_clear(led_strip_);
-
-        if (blink_counter_ == 0) {
-            esp_timer_stop(blink_timer_);
-        }
-    }
+    LedProgram program;
+    program.frames = {
+        { { r_, g_, b_ }, 0, (uint16_t)interval_ms },
+        { StripColor(), 0, (uint16_t)interval_ms },
+    };
+    program.repeat = times;
+    channel_->Play(std::move(program));
 }
 
 
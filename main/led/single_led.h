@@ -2,11 +2,10 @@
 #define _SINGLE_LED_H_
 
 #include "led.h"
+#include "led_effect.h"
 #include <driver/gpio.h>
 #include <led_strip.h>
-#include <esp_timer.h>
-#include <atomic>
-#include <mutex>
+#include <memory>
 
 class SingleLed : public Led {
 public:
@@ -16,16 +15,11 @@ public:
     void OnStateChanged() override;
 
 private:
-    std::mutex mutex_;
-    TaskHandle_t blink_task_ = nullptr;
     led_strip_handle_t led_strip_ = nullptr;
     uint8_t r_ = 0, g_ = 0, b_ = 0;
-    int blink_counter_ = 0;
-    int blink_interval_ms_ = 0;
-    esp_timer_handle_t blink_timer_ = nullptr;
+    std::unique_ptr<LedChannel> channel_;
 
     void StartBlinkTask(int times, int interval_ms);
-    void OnBlinkTimer();
 
     void BlinkOnce();
     void Blink(int times, int interval_ms);
@@ -0,0 +1,105 @@
+#include "local_intent.h"
+
+#include <string>
+
+namespace {
+
+struct IntentRule {
+    LocalCommand command;
+    const char* keywords[8];
+};
+
+// 按顺序匹配，带目标值的规则在前
+const IntentRule kRules[] = {
+    {kLocalCommandVolumeSet, {"音量调到", "音量设为", "音量设置为", "音量调成", "volumeto", "setvolume", "setthevolume"}},
+    {kLocalCommandBrightnessSet, {"亮度调到", "亮度设为", "亮度设置为", "亮度调成", "brightnessto", "setbrightness", "setthebrightness"}},
+    {kLocalCommandVolumeUp, {"大声", "音量大", "调大音量", "音量调大", "音量加", "louder", "volumeup", "turnupthevolume"}},
+    {kLocalCommandVolumeDown, {"小声", "音量小", "调小音量", "音量调小", "音量减", "quieter", "volumedown", "turndownthevolume"}},
+    {kLocalCommandBrightnessUp, {"亮一点", "调亮", "亮度调高", "亮度高", "亮度加", "brighter", "brightnessup"}},
+    {kLocalCommandBrightnessDown, {"暗一点", "调暗", "亮度调低", "亮度低", "亮度减", "dimmer", "darker", "brightnessdown"}},
+    {kLocalCommandStop, {"停止", "别说了", "闭嘴", "安静", "不要说了", "stop", "shutup", "bequiet"}},
+};
+
+// 去掉空格和标点，英文转小写
+std::string Normalize(std::string_view text) {
+    static const char* kPunctuations[] = {"，", "。", "！", "？", "、", "～"};
+    std::string result;
+    result.reserve(text.size());
+    size_t i = 0;
+    while (i < text.size()) {
+        bool skipped = false;
+        for (auto punctuation : kPunctuations) {
+            std::string_view p(punctuation);
+            if (text.substr(i, p.size()) == p) {
+                i += p.size();
+                skipped = true;
+                break;
+            }
+        }
+        if (skipped) {
+            continue;
+        }
+        char c = text[i++];
+        if (c == ' ' || c == ',' || c == '.' || c == '!' || c == '?' || c == '\'') {
+            continue;
+        }
+        if (c >= 'A' && c <= 'Z') {
+            c = c - 'A' + 'a';
+        }
+        result += c;
+    }
+    return result;
+}
+
+// 取句子中的目标值：阿拉伯数字，或者最大/最小
+int ParseValue(const std::string& text) {
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] >= '0' && text[i] <= '9') {
+            int value = 0;
+            while (i < text.size() && text[i] >= '0' && text[i] <= '9' && value <= 100) {
+                value = value * 10 + (text[i++] - '0');
+            }
+            return value > 100 ? 100 : value;
+        }
+    }
+    if (text.find("最大") != std::string::npos || text.find("max") != std::string::npos) {
+        return 100;
+    }
+    if (text.find("最小") != std::string::npos || text.find("min") != std::string::npos) {
+        return 0;
+    }
+    return -1;
+}
+
+} // namespace
+
+bool LocalIntentMatcher::Match(std::string_view text, LocalIntent& intent) {
+    auto normalized = Normalize(text);
+    if (normalized.empty() || normalized.size() > LOCAL_INTENT_MAX_TEXT) {
+        return false;
+    }
+    if (normalized == "静音" || normalized == "mute") {
+        intent = {kLocalCommandVolumeSet, 0};
+        return true;
+    }
+    for (auto& rule : kRules) {
+        for (auto keyword : rule.keywords) {
+            if (keyword == nullptr) {
+                break;
+            }
+            if (normalized.find(keyword) == std::string::npos) {
+                continue;
+            }
+            intent = {rule.command, -1};
+            if (rule.command == kLocalCommandVolumeSet || rule.command == kLocalCommandBrightnessSet) {
+                intent.value = ParseValue(normalized);
+                if (intent.value < 0) {
+                    // 没说目标值，交给后面的规则或者服务器
+                    break;
+                }
+            }
+            return true;
+        }
+    }
+    return false;
+}
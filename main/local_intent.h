@@ -0,0 +1,23 @@
+#ifndef LOCAL_INTENT_H
+#define LOCAL_INTENT_H
+
+#include <string_view>
+
+#include "wake_word.h"
+
+// 超过这个长度（去掉标点和空格后的字节数，约 12 个汉字）的句子不在本地匹配，交给服务器
+#define LOCAL_INTENT_MAX_TEXT 36
+
+struct LocalIntent {
+    LocalCommand command;
+    int value = -1;     // “音量调到 50” 这样的目标值，0~100，没有时为 -1
+};
+
+// 在本地把音量、亮度、停止这类简单的短句识别成命令，收到 stt 结果后马上执行，不等 LLM 调用工具
+// 只做关键词匹配，匹配不上的句子照常由服务器处理
+class LocalIntentMatcher {
+public:
+    static bool Match(std::string_view text, LocalIntent& intent);
+};
+
+#endif // LOCAL_INTENT_H
@@ -0,0 +1,199 @@
+#include "lock_profiler.h"
+
+#if CONFIG_LOCK_PROFILER
+#include "metrics.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#define TAG "LockProfiler"
+
+// 记录等待位置的表，满了以后新的位置只计入 lock.*_contended
+#define LOCK_PROFILER_SITES 24
+// 每次报告打印的位置数
+#define LOCK_PROFILER_REPORT_TOP 5
+
+#define LOCK_WAIT_US_BOUNDS {10, 50, 100, 500, 1000, 5000, 10000, 50000, 100000}
+
+namespace {
+
+struct LockSlot {
+    const char* name;
+    MetricHistogram wait_us;
+    MetricHistogram hold_us;
+    MetricCounter contended;
+    // 当前持有者，只由持有锁的任务写入；其它任务读到的可能是刚释放的旧值，只用于报告
+    std::atomic<TaskHandle_t> holder{nullptr};
+    std::atomic<const void*> holder_site{nullptr};
+    int depth = 0;
+    uint32_t acquisitions = 0;
+    int64_t hold_start_us = 0;  // 0 表示这次持有不采样
+    // 采样到的最长持有
+    std::atomic<uint32_t> max_hold_us{0};
+    std::atomic<const void*> max_hold_site{nullptr};
+};
+
+// 顺序与 ProfiledLockId 一致
+LockSlot slots[kProfiledLockCount] = {
+    {"application", {"lock.application_wait_us", LOCK_WAIT_US_BOUNDS}, {"lock.application_hold_us", LOCK_WAIT_US_BOUNDS}, MetricCounter("lock.application_contended")},
+    {"display", {"lock.display_wait_us", LOCK_WAIT_US_BOUNDS}, {"lock.display_hold_us", LOCK_WAIT_US_BOUNDS}, MetricCounter("lock.display_contended")},
+    {"background", {"lock.background_wait_us", LOCK_WAIT_US_BOUNDS}, {"lock.background_hold_us", LOCK_WAIT_US_BOUNDS}, MetricCounter("lock.background_contended")},
+};
+
+struct WaitSite {
+    const void* site;
+    ProfiledLockId lock;
+    uint32_t count;
+    uint64_t total_wait_us;
+    uint32_t max_wait_us;
+    // 最长那次等待时的持有者
+    const void* holder_site;
+    char holder_task[configMAX_TASK_NAME_LEN];
+    char waiter_task[configMAX_TASK_NAME_LEN];
+};
+
+WaitSite sites[LOCK_PROFILER_SITES];
+size_t site_count = 0;
+portMUX_TYPE sites_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void CopyTaskName(char* dst, TaskHandle_t task) {
+    const char* name = task != nullptr ? pcTaskGetName(task) : "?";
+    strncpy(dst, name, configMAX_TASK_NAME_LEN - 1);
+    dst[configMAX_TASK_NAME_LEN - 1] = '\0';
+}
+
+} // namespace
+
+void LockProfiler::OnAcquired(ProfiledLockId lock, const void* site) {
+    auto& slot = slots[lock];
+    if (slot.depth++ > 0) {
+        return;
+    }
+    slot.holder.store(xTaskGetCurrentTaskHandle(), std::memory_order_relaxed);
+    slot.holder_site.store(site, std::memory_order_relaxed);
+    slot.hold_start_us = (++slot.acquisitions % CONFIG_LOCK_PROFILER_HOLD_SAMPLE) == 0 ? esp_timer_get_time() : 0;
+}
+
+void LockProfiler::OnReleased(ProfiledLockId lock) {
+    auto& slot = slots[lock];
+    if (--slot.depth > 0) {
+        return;
+    }
+    if (slot.hold_start_us != 0) {
+        uint32_t hold_us = esp_timer_get_time() - slot.hold_start_us;
+        slot.hold_us.Record(hold_us);
+        if (hold_us > slot.max_hold_us.load(std::memory_order_relaxed)) {
+            slot.max_hold_us.store(hold_us, std::memory_order_relaxed);
+            slot.max_hold_site.store(slot.holder_site.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+    }
+    slot.holder.store(nullptr, std::memory_order_relaxed);
+}
+
+void LockProfiler::BeginWait(ProfiledLockId lock, TaskHandle_t& holder, const void*& holder_site) {
+    auto& slot = slots[lock];
+    holder = slot.holder.load(std::memory_order_relaxed);
+    holder_site = slot.holder_site.load(std::memory_order_relaxed);
+}
+
+void LockProfiler::OnContended(ProfiledLockId lock, const void* site, uint32_t wait_us,
+    TaskHandle_t holder, const void* holder_site) {
+    auto& slot = slots[lock];
+    slot.contended.Add();
+    slot.wait_us.Record(wait_us);
+
+    // 任务名在临界区外取；这几把锁都由常驻任务持有，句柄不会失效
+    char holder_task[configMAX_TASK_NAME_LEN];
+    char waiter_task[configMAX_TASK_NAME_LEN];
+    CopyTaskName(holder_task, holder);
+    CopyTaskName(waiter_task, xTaskGetCurrentTaskHandle());
+
+    taskENTER_CRITICAL(&sites_lock);
+    WaitSite* entry = nullptr;
+    for (size_t i = 0; i < site_count; i++) {
+        if (sites[i].site == site && sites[i].lock == lock) {
+            entry = &sites[i];
+            break;
+        }
+    }
+    if (entry == nullptr && site_count < LOCK_PROFILER_SITES) {
+        entry = &sites[site_count++];
+        memset(entry, 0, sizeof(*entry));
+        entry->site = site;
+        entry->lock = lock;
+    }
+    if (entry != nullptr) {
+        entry->count++;
+        entry->total_wait_us += wait_us;
+        if (wait_us >= entry->max_wait_us) {
+            entry->max_wait_us = wait_us;
+            entry->holder_site = holder_site;
+            memcpy(entry->holder_task, holder_task, sizeof(holder_task));
+            memcpy(entry->waiter_task, waiter_task, sizeof(waiter_task));
+        }
+    }
+    taskEXIT_CRITICAL(&sites_lock);
+}
+
+void LockProfiler::Report() {
+    // 只在时钟定时器中调用，快照放在静态区，不占用调用任务的栈
+    static WaitSite snapshot[LOCK_PROFILER_SITES];
+    size_t count;
+    taskENTER_CRITICAL(&sites_lock);
+    count = site_count;
+    memcpy(snapshot, sites, count * sizeof(WaitSite));
+    site_count = 0;
+    taskEXIT_CRITICAL(&sites_lock);
+
+    for (auto& slot : slots) {
+        uint32_t max_hold_us = slot.max_hold_us.exchange(0, std::memory_order_relaxed);
+        if (max_hold_us >= 1000) {
+            ESP_LOGI(TAG, "%s lock longest sampled hold %lu us, Backtrace: %p",
+                slot.name, max_hold_us, slot.max_hold_site.load(std::memory_order_relaxed));
+        }
+    }
+    if (count == 0) {
+        return;
+    }
+    std::sort(snapshot, snapshot + count, [](const WaitSite& a, const WaitSite& b) {
+        return a.total_wait_us > b.total_wait_us;
+    });
+    for (size_t i = 0; i < std::min<size_t>(count, LOCK_PROFILER_REPORT_TOP); i++) {
+        auto& entry = snapshot[i];
+        ESP_LOGI(TAG, "%s lock: %s waited %lu times, total %llu us, max %lu us behind %s, Backtrace: %p %p",
+            slots[entry.lock].name, entry.waiter_task, entry.count, entry.total_wait_us, entry.max_wait_us,
+            entry.holder_task, entry.site, entry.holder_site);
+    }
+}
+
+void ProfiledMutex::lock() {
+    const void* site = __builtin_return_address(0);
+    if (!mutex_.try_lock()) {
+        TaskHandle_t holder;
+        const void* holder_site;
+        LockProfiler::BeginWait(id_, holder, holder_site);
+        int64_t start = esp_timer_get_time();
+        mutex_.lock();
+        LockProfiler::OnContended(id_, site, esp_timer_get_time() - start, holder, holder_site);
+    }
+    LockProfiler::OnAcquired(id_, site);
+}
+
+bool ProfiledMutex::try_lock() {
+    if (!mutex_.try_lock()) {
+        return false;
+    }
+    LockProfiler::OnAcquired(id_, __builtin_return_address(0));
+    return true;
+}
+
+void ProfiledMutex::unlock() {
+    LockProfiler::OnReleased(id_);
+    mutex_.unlock();
+}
+
+#endif // CONFIG_LOCK_PROFILER
@@ -0,0 +1,68 @@
+#ifndef LOCK_PROFILER_H
+#define LOCK_PROFILER_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <cstdint>
+#include <mutex>
+
+enum ProfiledLockId {
+    kLockApplication,       // Application::mutex_，主循环任务队列
+    kLockDisplay,           // DisplayLockGuard，LVGL 的锁
+    kLockBackgroundTask,    // BackgroundTask::mutex_，各通道的任务队列
+    kProfiledLockCount
+};
+
+// 锁竞争统计（CONFIG_LOCK_PROFILER）
+// 没有竞争时只多一次 try_lock 和计数；拿不到锁时记录等待时长、等待的代码位置和当时持有锁的任务及其代码位置，
+// 持有时长每 CONFIG_LOCK_PROFILER_HOLD_SAMPLE 次采样一次
+// 每把锁的等待/持有直方图和竞争次数登记为 lock.* 指标，Report 按累计等待时长打印竞争最多的位置后清零
+// 代码位置是返回地址，idf.py monitor 会解析成函数和行号
+// 显示锁没有 try_lock，等待超过 LOCK_PROFILER_CONTENDED_US 算一次竞争；LVGL 任务渲染时自己持有锁，持有者记为 ?
+#define LOCK_PROFILER_CONTENDED_US 50
+// Application 的时钟定时器每隔这么久调用一次 Report
+#define LOCK_PROFILER_REPORT_SECONDS 60
+
+class LockProfiler {
+public:
+#if CONFIG_LOCK_PROFILER
+    // 以下由拿到锁的任务调用，嵌套加锁（显示锁可重入）只统计最外层
+    static void OnAcquired(ProfiledLockId lock, const void* site);
+    static void OnReleased(ProfiledLockId lock);
+    // 等锁之前调用，记下当时的持有者；拿到锁之后调用 OnContended
+    static void BeginWait(ProfiledLockId lock, TaskHandle_t& holder, const void*& holder_site);
+    static void OnContended(ProfiledLockId lock, const void* site, uint32_t wait_us,
+        TaskHandle_t holder, const void* holder_site);
+    static void Report();
+#else
+    static void OnAcquired(ProfiledLockId, const void*) {}
+    static void OnReleased(ProfiledLockId) {}
+    static void Report() {}
+#endif
+};
+
+// 带竞争统计的 std::mutex，可以用于 std::lock_guard / std::unique_lock / std::condition_variable_any
+class ProfiledMutex {
+public:
+    explicit ProfiledMutex(ProfiledLockId id) : id_(id) {}
+    ProfiledMutex(const ProfiledMutex&) = delete;
+    ProfiledMutex& operator=(const ProfiledMutex&) = delete;
+
+#if CONFIG_LOCK_PROFILER
+    // 不内联，返回地址是加锁的位置
+    void lock() __attribute__((noinline));
+    bool try_lock() __attribute__((noinline));
+    void unlock();
+#else
+    void lock() { mutex_.lock(); }
+    bool try_lock() { return mutex_.try_lock(); }
+    void unlock() { mutex_.unlock(); }
+#endif
+
+private:
+    std::mutex mutex_;
+    ProfiledLockId id_;
+};
+
+#endif // LOCK_PROFILER_H
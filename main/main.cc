@@ -7,11 +7,38 @@
 
 #include "application.h"
 #include "system_info.h"
+#include "json_arena.h"
+#include "heap_accounting.h"
+#include "boot_profiler.h"
+#include "memory_placement.h"
+#include "async_log.h"
+#if CONFIG_CRASH_RING
+#include "crash_ring.h"
+#endif
+#if CONFIG_QUICK_BOOT
+#include "quick_boot.h"
+#endif
 
 #define TAG "main"
 
 extern "C" void app_main(void)
 {
+    BootProfiler::GetInstance().Mark("app_main");
+    // 之后的日志不再阻塞调用者
+    AsyncLog::Install();
+
+    // cJSON 的分配函数只能在其它任务启动前替换
+    JsonArena::InstallHooks();
+    HeapAccounting::Initialize();
+#if CONFIG_CRASH_RING
+    // 在新的采样覆盖之前取出上一次复位前的记录
+    CrashRing::GetInstance().Initialize();
+#endif
+#if CONFIG_QUICK_BOOT
+    // 判断复位原因，决定 RTC 内存中的上下文是否可用
+    QuickBoot::GetInstance().Initialize();
+#endif
+
     // Initialize the default event loop
     ESP_ERROR_CHECK(esp_event_loop_create_default());
 
@@ -23,6 +50,10 @@ extern "C" void app_main(void)
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    BootProfiler::GetInstance().Mark("nvs_init");
+
+    // 显示和 AFE 创建时按测得的 PSRAM 争用选择缓冲区位置
+    MemoryPlacement::GetInstance().Initialize();
 
     // Launch the application
     Application::GetInstance().Start();
@@ -8,17 +8,33 @@
 #include <esp_app_desc.h>
 #include <algorithm>
 #include <cstring>
-#include <esp_pthread.h>
+#include <esp_rom_crc.h>
+#include <esp_timer.h>
 
 #include "application.h"
 #include "display.h"
 #include "board.h"
+#include "boot_profiler.h"
+#include "metrics.h"
+#include "json_arena.h"
+#include "audio_benchmark.h"
 
 #define TAG "MCP"
 
 #define DEFAULT_TOOLCALL_STACK_SIZE 6144
+#define LARGE_TOOLCALL_STACK_SIZE 12288
+#define MAX_PENDING_TOOLCALLS 4
+// 本地执行命令后，服务器的 LLM 通常还会对同一句话调用一次同一个工具
+#define MCP_LOCAL_CALL_DEDUP_MS 5000
 
-McpServer::McpServer() {
+static MetricCounter metric_local_calls("mcp.local_calls");
+static MetricCounter metric_deduped_calls("mcp.deduped_calls");
+static MetricCounter metric_chunked_messages("mcp.chunked_messages");
+
+// 默认栈的 worker 可以并发两个调用，大栈的 worker 只保留一个
+// 大栈的 worker 主要用于拍照和图像识别，栈放在 PSRAM 中
+McpServer::McpServer()
+    : tool_executor_({{DEFAULT_TOOLCALL_STACK_SIZE, 2}, {LARGE_TOOLCALL_STACK_SIZE, 1, kTaskStackPsram}}, MAX_PENDING_TOOLCALLS) {
 }
 
 McpServer::~McpServer() {
@@ -45,6 +61,34 @@ void McpServer::AddCommonTools() {
             return board.GetDeviceStatusJson();
         });
 
+    AddTool("self.system.get_boot_profile",
+        "Get the boot time of each startup stage in milliseconds since reset. For diagnostics only.",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            return BootProfiler::GetInstance().GetJson();
+        });
+
+    AddTool("self.system.get_metrics",
+        "Get runtime metrics: counters, gauges (heap free/min/largest per capability, queue depths), "
+        "duration histograms in microseconds, CPU usage of the busiest tasks and the stack high-water mark "
+        "(least free bytes) of every task. For diagnostics only.",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            return Metrics::GetInstance().GetJson();
+        });
+
+    AddTool("self.system.profile",
+        "Profile the device for the given number of seconds and return the CPU usage of the busiest tasks, "
+        "the lowest free heap and largest free block per capability, the queue depth range and the percentiles "
+        "of the duration histograms (microseconds) recorded during that time. For diagnostics only.",
+        PropertyList({
+            Property("seconds", kPropertyTypeInteger, 5, 1, 30),
+            Property("top_tasks", kPropertyTypeInteger, 5, 1, 16)
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            return Metrics::GetInstance().Profile(properties["seconds"].value<int>(), properties["top_tasks"].value<int>());
+        });
+
     AddTool("self.audio_speaker.set_volume", 
         "Set the volume of the audio speaker. If the current volume is unknown, you must call `self.get_device_status` tool first and then call this tool.",
         PropertyList({
@@ -85,7 +129,7 @@ void McpServer::AddCommonTools() {
 
     auto camera = board.GetCamera();
     if (camera) {
-        AddTool("self.camera.take_photo",
+        AddAsyncTool("self.camera.take_photo",
             "Take a photo and explain it. Use this tool after the user asks you to see something.\n"
             "Args:\n"
             "  `question`: The question that you want to ask about the photo.\n"
@@ -94,42 +138,157 @@ void McpServer::AddCommonTools() {
             PropertyList({
                 Property("question", kPropertyTypeString)
             }),
-            [camera](const PropertyList& properties) -> ReturnValue {
+            [camera](const PropertyList& properties, McpToolCallPtr call) {
+                // 拍照和上传之间检查取消，被打断后不再上传
+                call->Progress(0, 2, "Capturing");
                 if (!camera->Capture()) {
-                    return "{\"success\": false, \"message\": \"Failed to capture photo\"}";
+                    call->Complete(std::string("{\"success\": false, \"message\": \"Failed to capture photo\"}"));
+                    return;
                 }
+                if (call->cancelled()) {
+                    call->Fail("Cancelled");
+                    return;
+                }
+                call->Progress(1, 2, "Explaining");
                 auto question = properties["question"].value<std::string>();
-                return camera->Explain(question);
+                // 识别结果边返回边通过进度通知转发
+                call->Complete(camera->Explain(question, [call](const std::string& text) {
+                    call->Progress(1, 2, text);
+                }));
             });
     }
 
+#if CONFIG_ENABLE_TRANSPORT_BENCHMARK
+    AddTool("self.transport_benchmark.start",
+        "Start a transport loopback benchmark. Only for firmware testing with the benchmark server, the server echoes the audio packets back.\n"
+        "Args:\n"
+        "  `frames_per_second`: Packets sent per second, 17 is real time for 60ms frames.\n"
+        "  `duration`: Benchmark duration in seconds.",
+        PropertyList({
+            Property("frames_per_second", kPropertyTypeInteger, 17, 1, 100),
+            Property("duration", kPropertyTypeInteger, 30, 5, 600)
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            auto frames_per_second = properties["frames_per_second"].value<int>();
+            auto duration = properties["duration"].value<int>();
+            auto& app = Application::GetInstance();
+            app.Schedule([&app, frames_per_second, duration]() {
+                app.StartTransportBenchmark(frames_per_second, duration);
+            });
+            return true;
+        });
+
+    AddTool("self.transport_benchmark.get_result",
+        "Get the result of the last transport benchmark: throughput, RTT, jitter, loss, heap high-water and CPU usage per task.",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            return Application::GetInstance().GetTransportBenchmarkResult();
+        });
+#endif
+
+#if CONFIG_SOUND_PARTITION_PLAYBACK
+    AddTool("self.audio_speaker.play_stored_audio",
+        "Play the long audio content (alarm, story, etc.) stored on the device from the given position. "
+        "Returns the total duration in milliseconds.",
+        PropertyList({
+            Property("start_seconds", kPropertyTypeInteger, 0, 0, 86400)
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            int duration = Application::GetInstance().PlayStoredSound(properties["start_seconds"].value<int>() * 1000);
+            if (duration < 0) {
+                throw std::runtime_error("No stored audio on this device");
+            }
+            return duration;
+        });
+#endif
+
+#if CONFIG_AUDIO_LOOPBACK_TEST
+    AddTool("self.audio_debug.loopback_test",
+        "Play a known sound through the speaker while recording through the audio front end, for the host loopback test script. "
+        "Only for firmware testing, the device must be idle.",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            Application::GetInstance().StartLoopbackTest();
+            return true;
+        });
+#endif
+
+#if CONFIG_AUDIO_SELF_TEST
+    AddAsyncTool("self.audio_self_test.run",
+        "Play a reference chirp and record it to check the audio chain. Returns the round-trip acoustic latency, "
+        "I2S capture overruns and playback underruns during the test, opus encode/decode time in microseconds and "
+        "the echo return loss enhancement of the audio front end (erle_db). `detected` is false when the microphone "
+        "did not hear the speaker. The device must be idle, the test takes about 2 seconds.",
+        PropertyList(),
+        [](const PropertyList& properties, McpToolCallPtr call) {
+            Application::GetInstance().StartAudioSelfTest([call](const std::string& json) {
+                call->Complete(json);
+            });
+        });
+#endif
+
+#if CONFIG_AEC_CALIBRATION
+    AddTool("self.audio_debug.calibrate_aec",
+        "Measure the speaker-to-microphone delay by playing a short sound, and save it to align the echo reference. "
+        "Run once per device in a quiet room, the device must be idle.",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            Application::GetInstance().CalibrateAec();
+            return true;
+        });
+#endif
+
+#if CONFIG_ENABLE_AUDIO_BENCHMARK
+    AddTool("self.audio_benchmark.run",
+        "Run the audio hot path micro benchmark (opus encode/decode, resampler, PCM conversion, AFE) and return CPU cycles per call. "
+        "Only for firmware testing, audio may stutter while it is running.",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            return AudioBenchmark::Run();
+        });
+#endif
+
     // Restore the original tools list to the end of the tools list
     tools_.insert(tools_.end(), original_tools.begin(), original_tools.end());
+    tools_pages_valid_ = false;
 }
 
 void McpServer::AddTool(McpTool* tool) {
     // Prevent adding duplicate tools
-    if (std::find_if(tools_.begin(), tools_.end(), [tool](const McpTool* t) { return t->name() == tool->name(); }) != tools_.end()) {
+    if (tool_index_.find(tool->name()) != tool_index_.end()) {
         ESP_LOGW(TAG, "Tool %s already added", tool->name().c_str());
         return;
     }
 
     ESP_LOGI(TAG, "Add tool: %s", tool->name().c_str());
     tools_.push_back(tool);
+    tool_index_[tool->name()] = tool;
+    tools_pages_valid_ = false;
 }
 
 void McpServer::AddTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback) {
     AddTool(new McpTool(name, description, properties, callback));
 }
 
-void McpServer::ParseMessage(const std::string& message) {
-    cJSON* json = cJSON_Parse(message.c_str());
+void McpServer::AddStaticTools(const McpStaticTool* tools, size_t count, void* context) {
+    for (size_t i = 0; i < count; i++) {
+        AddTool(new McpTool(&tools[i], context));
+    }
+}
+
+void McpServer::AddAsyncTool(const std::string& name, const std::string& description, const PropertyList& properties, McpAsyncToolCallback callback) {
+    AddTool(new McpTool(name, description, properties, callback));
+}
+
+void McpServer::ParseMessage(std::string_view message) {
+    // 工具参数会在 DoToolCall 中拷贝到 PropertyList，整棵树可以随 arena 一起释放
+    JsonArena arena(JSON_ARENA_BLOCK_SIZE, kHeapTagMcp);
+    cJSON* json = arena.Parse(message.data(), message.size());
     if (json == nullptr) {
-        ESP_LOGE(TAG, "Failed to parse MCP message: %s", message.c_str());
+        ESP_LOGE(TAG, "Failed to parse MCP message: %.*s", (int)message.size(), message.data());
         return;
     }
     ParseMessage(json);
-    cJSON_Delete(json);
 }
 
 void McpServer::ParseCapabilities(const cJSON* capabilities) {
@@ -152,6 +311,24 @@ void McpServer::ParseCapabilities(const cJSON* capabilities) {
 }
 
 void McpServer::ParseMessage(const cJSON* json) {
+    if (!cJSON_IsArray(json)) {
+        ParseRequest(json);
+        return;
+    }
+
+    // JSON-RPC 批量请求，逐个处理，回复在 FlushReplies 中合并
+    if (cJSON_GetArraySize(json) == 0) {
+        ESP_LOGE(TAG, "Empty batch request");
+        return;
+    }
+    batch_replies_ = true;
+    const cJSON* item = nullptr;
+    cJSON_ArrayForEach(item, json) {
+        ParseRequest(item);
+    }
+}
+
+void McpServer::ParseRequest(const cJSON* json) {
     // Check JSONRPC version
     auto version = cJSON_GetObjectItem(json, "jsonrpc");
     if (version == nullptr || !cJSON_IsString(version) || strcmp(version->valuestring, "2.0") != 0) {
@@ -168,6 +345,13 @@ void McpServer::ParseMessage(const cJSON* json) {
     
     auto method_str = std::string(method->valuestring);
     if (method_str.find("notifications") == 0) {
+        if (method_str == "notifications/cancelled") {
+            auto params = cJSON_GetObjectItem(json, "params");
+            auto request_id = cJSON_GetObjectItem(params, "requestId");
+            if (cJSON_IsNumber(request_id)) {
+                CancelToolCall(request_id->valueint);
+            }
+        }
         return;
     }
     
@@ -230,7 +414,17 @@ void McpServer::ParseMessage(const cJSON* json) {
             ReplyError(id_int, "Invalid stackSize");
             return;
         }
-        DoToolCall(id_int, std::string(tool_name->valuestring), tool_arguments, stack_size ? stack_size->valueint : DEFAULT_TOOLCALL_STACK_SIZE);
+        // 对方在 _meta.progressToken 中要求进度通知，原样带回
+        std::string progress_token;
+        auto meta = cJSON_GetObjectItem(params, "_meta");
+        auto token = cJSON_GetObjectItem(meta, "progressToken");
+        if (cJSON_IsString(token) || cJSON_IsNumber(token)) {
+            auto token_str = cJSON_PrintUnformatted(token);
+            progress_token = token_str;
+            cJSON_free(token_str);
+        }
+        DoToolCall(id_int, std::string(tool_name->valuestring), tool_arguments,
+            stack_size ? stack_size->valueint : DEFAULT_TOOLCALL_STACK_SIZE, progress_token);
     } else {
         ESP_LOGE(TAG, "Method not implemented: %s", method_str.c_str());
         ReplyError(id_int, "Method not implemented: " + method_str);
@@ -238,11 +432,13 @@ void McpServer::ParseMessage(const cJSON* json) {
 }
 
 void McpServer::ReplyResult(int id, const std::string& result) {
-    std::string payload = "{\"jsonrpc\":\"2.0\",\"id\":";
+    std::string payload;
+    payload.reserve(result.size() + 48);
+    payload = "{\"jsonrpc\":\"2.0\",\"id\":";
     payload += std::to_string(id) + ",\"result\":";
     payload += result;
     payload += "}";
-    Application::GetInstance().SendMcpMessage(payload);
+    QueueReply(payload);
 }
 
 void McpServer::ReplyError(int id, const std::string& message) {
@@ -251,117 +447,437 @@ void McpServer::ReplyError(int id, const std::string& message) {
     payload += ",\"error\":{\"message\":\"";
     payload += message;
     payload += "\"}}";
+    QueueReply(payload);
+}
+
+void McpServer::ReplyToolResult(int id, const ReturnValue& value) {
+    if (batch_replies_) {
+        ReplyResult(id, McpTool::FormatResult(value));
+        return;
+    }
+    // 与 FormatResult 的输出相同
+    McpMessageWriter writer;
+    writer.Write("{\"jsonrpc\":\"2.0\",\"id\":");
+    writer.Write(std::to_string(id));
+    writer.Write(",\"result\":{\"content\":[{\"type\":\"text\",\"text\":");
+    if (std::holds_alternative<std::string>(value)) {
+        writer.WriteString(std::get<std::string>(value));
+    } else if (std::holds_alternative<bool>(value)) {
+        writer.WriteString(std::get<bool>(value) ? "true" : "false");
+    } else {
+        writer.WriteString(std::to_string(std::get<int>(value)));
+    }
+    writer.Write("}],\"isError\":false}}");
+    writer.Finish();
+}
+
+// 回复可能来自主线程，也可能来自工具调用的 worker
+void McpServer::QueueReply(const std::string& reply) {
+    if (!batch_replies_) {
+        Application::GetInstance().SendMcpMessage(reply);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(reply_mutex_);
+    if (pending_reply_count_++ > 0) {
+        pending_replies_ += ",";
+    }
+    pending_replies_ += reply;
+    if (pending_reply_count_ == 1) {
+        Application::GetInstance().Schedule([this]() {
+            FlushReplies();
+        });
+    }
+}
+
+void McpServer::FlushReplies() {
+    std::string payload;
+    int count;
+    {
+        std::lock_guard<std::mutex> lock(reply_mutex_);
+        payload.swap(pending_replies_);
+        count = pending_reply_count_;
+        pending_reply_count_ = 0;
+    }
+    if (count == 0) {
+        return;
+    }
+    if (count > 1) {
+        payload = "[" + payload + "]";
+        ESP_LOGI(TAG, "Send %d replies in one batch", count);
+    }
     Application::GetInstance().SendMcpMessage(payload);
 }
 
-void McpServer::GetToolsList(int id, const std::string& cursor) {
+// 工具列表只在 AddTool 时变化，分页结果序列化一次后重复使用
+void McpServer::BuildToolsPages() {
     const int max_payload_size = 8000;
+    tools_pages_.clear();
+    tools_pages_valid_ = true;
+
+    std::string cursor;
     std::string json = "{\"tools\":[";
-    
-    bool found_cursor = cursor.empty();
-    auto it = tools_.begin();
-    std::string next_cursor = "";
-    
-    while (it != tools_.end()) {
-        // 如果我们还没有找到起始位置，继续搜索
-        if (!found_cursor) {
-            if ((*it)->name() == cursor) {
-                found_cursor = true;
-            } else {
-                ++it;
-                continue;
-            }
-        }
-        
+    for (auto it = tools_.begin(); it != tools_.end(); ++it) {
         // 添加tool前检查大小
         std::string tool_json = (*it)->to_json() + ",";
-        if (json.length() + tool_json.length() + 30 > max_payload_size) {
-            // 如果添加这个tool会超出大小限制，设置next_cursor并退出循环
-            next_cursor = (*it)->name();
-            break;
+        if (json.length() + tool_json.length() + 30 <= max_payload_size) {
+            json += tool_json;
+            continue;
+        }
+
+        const std::string& next_cursor = (*it)->name();
+        if (json.back() == '[') {
+            // 单个tool就超出大小限制，之后的页都无法返回
+            ESP_LOGE(TAG, "tools/list: Failed to add tool %s because of payload size limit", next_cursor.c_str());
+            tools_pages_.push_back({cursor, "Failed to add tool " + next_cursor + " because of payload size limit", true});
+            return;
         }
-        
-        json += tool_json;
-        ++it;
+        json.pop_back();
+        json += "],\"nextCursor\":\"" + next_cursor + "\"}";
+        tools_pages_.push_back({cursor, std::move(json), false});
+
+        cursor = next_cursor;
+        json = "{\"tools\":[" + tool_json;
     }
-    
+
     if (json.back() == ',') {
         json.pop_back();
     }
-    
-    if (json.back() == '[' && !tools_.empty()) {
-        // 如果没有添加任何tool，返回错误
-        ESP_LOGE(TAG, "tools/list: Failed to add tool %s because of payload size limit", next_cursor.c_str());
-        ReplyError(id, "Failed to add tool " + next_cursor + " because of payload size limit");
+    json += "]}";
+    tools_pages_.push_back({cursor, std::move(json), false});
+}
+
+std::string McpServer::GetToolsHash() {
+    if (!tools_pages_valid_) {
+        BuildToolsPages();
+    }
+    uint32_t crc = 0;
+    for (const auto& page : tools_pages_) {
+        crc = esp_rom_crc32_le(crc, (const uint8_t*)page.result.data(), page.result.size());
+    }
+    char hash[9];
+    snprintf(hash, sizeof(hash), "%08lx", (unsigned long)crc);
+    return hash;
+}
+
+void McpServer::GetToolsList(int id, const std::string& cursor) {
+#if CONFIG_MCP_CHUNKED_MESSAGES
+    // 可以分块发送时不再分页，所有工具在一条回复中边序列化边发送，单个工具的描述也不受大小限制
+    if (cursor.empty() && !batch_replies_ && Application::GetInstance().McpChunksEnabled()) {
+        McpMessageWriter writer;
+        writer.Write("{\"jsonrpc\":\"2.0\",\"id\":");
+        writer.Write(std::to_string(id));
+        writer.Write(",\"result\":{\"tools\":[");
+        for (auto it = tools_.begin(); it != tools_.end(); ++it) {
+            if (it != tools_.begin()) {
+                writer.Write(",");
+            }
+            writer.Write((*it)->to_json());
+        }
+        writer.Write("]}}");
+        writer.Finish();
         return;
     }
+#endif
 
-    if (next_cursor.empty()) {
-        json += "]}";
-    } else {
-        json += "],\"nextCursor\":\"" + next_cursor + "\"}";
+    if (!tools_pages_valid_) {
+        BuildToolsPages();
     }
-    
-    ReplyResult(id, json);
+
+    for (const auto& page : tools_pages_) {
+        if (page.cursor == cursor) {
+            if (page.error) {
+                ReplyError(id, page.result);
+            } else {
+                ReplyResult(id, page.result);
+            }
+            return;
+        }
+    }
+
+    ESP_LOGE(TAG, "tools/list: Unknown cursor: %s", cursor.c_str());
+    ReplyError(id, "Unknown cursor: " + cursor);
 }
 
-void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments, int stack_size) {
-    auto tool_iter = std::find_if(tools_.begin(), tools_.end(), 
-                                 [&tool_name](const McpTool* tool) { 
-                                     return tool->name() == tool_name; 
-                                 });
-    
-    if (tool_iter == tools_.end()) {
+bool McpServer::BindArguments(McpTool* tool, const cJSON* tool_arguments, PropertyList& arguments, std::string& error) {
+    bool has_arguments = cJSON_IsObject(tool_arguments);
+    for (auto& argument : arguments) {
+        auto value = has_arguments ? cJSON_GetObjectItem(tool_arguments, argument.name().c_str()) : nullptr;
+        auto bind = argument.Bind(value);
+        if (bind == kPropertyBindOk || (bind == kPropertyBindMissing && argument.has_default_value())) {
+            continue;
+        }
+
+        if (bind == kPropertyBindBelowMinimum) {
+            error = "Value is below minimum allowed: " + std::to_string(argument.min_value());
+        } else if (bind == kPropertyBindAboveMaximum) {
+            error = "Value exceeds maximum allowed: " + std::to_string(argument.max_value());
+        } else {
+            error = "Missing valid argument: " + argument.name();
+        }
+        return false;
+    }
+    return true;
+}
+
+bool McpServer::CallToolLocally(const std::string& tool_name, const cJSON* tool_arguments, const std::string& text) {
+    auto tool_iter = tool_index_.find(tool_name);
+    if (tool_iter == tool_index_.end() || tool_iter->second->is_async()) {
+        return false;
+    }
+    auto tool = tool_iter->second;
+    PropertyList arguments = tool->properties();
+    std::string error;
+    if (!BindArguments(tool, tool_arguments, arguments, error)) {
+        ESP_LOGE(TAG, "Local call %s: %s", tool_name.c_str(), error.c_str());
+        return false;
+    }
+    try {
+        tool->Invoke(arguments);
+    } catch (const std::exception& e) {
+        ESP_LOGE(TAG, "Local call %s: %s", tool_name.c_str(), e.what());
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(calls_mutex_);
+        local_calls_[tool_name] = esp_timer_get_time();
+    }
+    metric_local_calls.Add();
+    ESP_LOGI(TAG, "Local call %s", tool_name.c_str());
+
+    // 告诉服务器设备已经执行了哪个工具，以及触发它的那句话
+    cJSON* notification = cJSON_CreateObject();
+    cJSON_AddStringToObject(notification, "jsonrpc", "2.0");
+    cJSON_AddStringToObject(notification, "method", "notifications/tools/local_call");
+    cJSON* params = cJSON_AddObjectToObject(notification, "params");
+    cJSON_AddStringToObject(params, "name", tool_name.c_str());
+    cJSON_AddItemToObject(params, "arguments", tool_arguments ? cJSON_Duplicate(tool_arguments, true) : cJSON_CreateObject());
+    if (!text.empty()) {
+        cJSON_AddStringToObject(params, "text", text.c_str());
+    }
+    char* payload = cJSON_PrintUnformatted(notification);
+    QueueReply(payload);
+    cJSON_free(payload);
+    cJSON_Delete(notification);
+    return true;
+}
+
+void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments, int stack_size, const std::string& progress_token) {
+    auto tool_iter = tool_index_.find(tool_name);
+    if (tool_iter == tool_index_.end()) {
         ESP_LOGE(TAG, "tools/call: Unknown tool: %s", tool_name.c_str());
         ReplyError(id, "Unknown tool: " + tool_name);
         return;
     }
 
-    PropertyList arguments = (*tool_iter)->properties();
-    try {
-        for (auto& argument : arguments) {
-            bool found = false;
-            if (cJSON_IsObject(tool_arguments)) {
-                auto value = cJSON_GetObjectItem(tool_arguments, argument.name().c_str());
-                if (argument.type() == kPropertyTypeBoolean && cJSON_IsBool(value)) {
-                    argument.set_value<bool>(value->valueint == 1);
-                    found = true;
-                } else if (argument.type() == kPropertyTypeInteger && cJSON_IsNumber(value)) {
-                    argument.set_value<int>(value->valueint);
-                    found = true;
-                } else if (argument.type() == kPropertyTypeString && cJSON_IsString(value)) {
-                    argument.set_value<std::string>(value->valuestring);
-                    found = true;
-                }
-            }
-
-            if (!argument.has_default_value() && !found) {
-                ESP_LOGE(TAG, "tools/call: Missing valid argument: %s", argument.name().c_str());
-                ReplyError(id, "Missing valid argument: " + argument.name());
-                return;
-            }
+    auto tool = tool_iter->second;
+    {
+        std::lock_guard<std::mutex> lock(calls_mutex_);
+        auto local = local_calls_.find(tool_name);
+        if (local != local_calls_.end() && esp_timer_get_time() - local->second < MCP_LOCAL_CALL_DEDUP_MS * 1000LL) {
+            local_calls_.erase(local);
+            metric_deduped_calls.Add();
+            ESP_LOGI(TAG, "tools/call: %s already done locally", tool_name.c_str());
+            ReplyToolResult(id, std::string("Already done on the device"));
+            return;
         }
-    } catch (const std::exception& e) {
-        ESP_LOGE(TAG, "tools/call: %s", e.what());
-        ReplyError(id, e.what());
+    }
+
+    // 参数帧只生成一次，绑定后移交给 worker
+    PropertyList arguments = tool->properties();
+    std::string error;
+    if (!BindArguments(tool, tool_arguments, arguments, error)) {
+        ESP_LOGE(TAG, "tools/call: %s", error.c_str());
+        ReplyError(id, error);
         return;
     }
 
-    // Start a task to receive data with stack size
-    esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
-    cfg.thread_name = "tool_call";
-    cfg.stack_size = stack_size;
-    cfg.prio = 1;
-    esp_pthread_set_cfg(&cfg);
+    auto call = std::make_shared<McpToolCall>(id, progress_token);
+    {
+        std::lock_guard<std::mutex> lock(calls_mutex_);
+        active_calls_[id] = call;
+    }
 
-    // Use a thread to call the tool to avoid blocking the main thread
-    tool_call_thread_ = std::thread([this, id, tool_iter, arguments = std::move(arguments)]() {
+    // 在常驻的 worker 上执行，避免阻塞主线程
+    auto result = tool_executor_.Schedule(stack_size, [tool, call, arguments = std::move(arguments)]() {
+        if (call->cancelled()) {
+            call->Fail("Cancelled");
+            return;
+        }
         try {
-            ReplyResult(id, (*tool_iter)->Call(arguments));
+            if (tool->is_async()) {
+                tool->CallAsync(arguments, call);
+            } else {
+                call->Complete(tool->Invoke(arguments));
+            }
         } catch (const std::exception& e) {
             ESP_LOGE(TAG, "tools/call: %s", e.what());
-            ReplyError(id, e.what());
+            call->Fail(e.what());
         }
     });
-    tool_call_thread_.detach();
-}
\ No newline at end of file
+    if (result != kMcpToolScheduleOk) {
+        std::lock_guard<std::mutex> lock(calls_mutex_);
+        active_calls_.erase(id);
+    }
+    if (result == kMcpToolScheduleStackTooLarge) {
+        ESP_LOGE(TAG, "tools/call: stackSize %d too large", stack_size);
+        ReplyError(id, "stackSize too large, max " + std::to_string(LARGE_TOOLCALL_STACK_SIZE));
+    } else if (result != kMcpToolScheduleOk) {
+        ESP_LOGE(TAG, "tools/call: Too many tool calls in progress, reject %s", tool_name.c_str());
+        ReplyError(id, "Too many tool calls in progress");
+    }
+}
+
+void McpServer::CancelToolCall(int id) {
+    std::lock_guard<std::mutex> lock(calls_mutex_);
+    auto it = active_calls_.find(id);
+    if (it != active_calls_.end()) {
+        ESP_LOGI(TAG, "Cancel tool call %d", id);
+        it->second->Cancel();
+        active_calls_.erase(it);
+    }
+}
+
+void McpServer::CancelToolCalls() {
+    std::lock_guard<std::mutex> lock(calls_mutex_);
+    if (active_calls_.empty()) {
+        return;
+    }
+    ESP_LOGI(TAG, "Cancel %u tool calls", active_calls_.size());
+    for (auto& item : active_calls_) {
+        item.second->Cancel();
+    }
+    active_calls_.clear();
+}
+
+void McpToolCall::Progress(int progress, int total, const std::string& message) {
+    if (progress_token_.empty() || cancelled_ || finished_) {
+        return;
+    }
+    std::string payload = "{\"jsonrpc\":\"2.0\",\"method\":\"notifications/progress\",\"params\":{\"progressToken\":";
+    payload += progress_token_;
+    payload += ",\"progress\":" + std::to_string(progress);
+    payload += ",\"total\":" + std::to_string(total);
+    if (!message.empty()) {
+        // 消息可能是服务器返回的文本，需要转义
+        cJSON* escaped = cJSON_CreateString(message.c_str());
+        char* text = cJSON_PrintUnformatted(escaped);
+        payload += ",\"message\":";
+        payload += text;
+        cJSON_free(text);
+        cJSON_Delete(escaped);
+    }
+    payload += "}}";
+    McpServer::GetInstance().QueueReply(payload);
+}
+
+void McpToolCall::Complete(const ReturnValue& value) {
+    if (Finish()) {
+        McpServer::GetInstance().ReplyToolResult(id_, value);
+    }
+}
+
+void McpToolCall::Fail(const std::string& message) {
+    if (Finish()) {
+        McpServer::GetInstance().ReplyError(id_, message);
+    }
+}
+
+bool McpToolCall::Finish() {
+    if (finished_.exchange(true)) {
+        return false;
+    }
+    auto& server = McpServer::GetInstance();
+    {
+        std::lock_guard<std::mutex> lock(server.calls_mutex_);
+        auto it = server.active_calls_.find(id_);
+        if (it != server.active_calls_.end() && it->second.get() == this) {
+            server.active_calls_.erase(it);
+        }
+    }
+    // 被取消的调用对方不再等待结果
+    if (cancelled_) {
+        ESP_LOGI(TAG, "Tool call %d cancelled, drop the result", id_);
+        return false;
+    }
+    return true;
+}
+
+McpMessageWriter::McpMessageWriter() : chunked_(Application::GetInstance().McpChunksEnabled()) {
+    if (chunked_) {
+        buffer_.reserve(MCP_CHUNK_SIZE + 1);
+    }
+}
+
+void McpMessageWriter::Write(std::string_view text) {
+    if (!chunked_) {
+        buffer_.append(text);
+        return;
+    }
+    // 多攒一个字节再切分，才能知道切分点之后是不是 UTF-8 的后续字节
+    while (!text.empty()) {
+        size_t n = std::min(text.size(), MCP_CHUNK_SIZE + 1 - buffer_.size());
+        buffer_.append(text.substr(0, n));
+        text.remove_prefix(n);
+        if (buffer_.size() > MCP_CHUNK_SIZE) {
+            Flush(false);
+        }
+    }
+}
+
+void McpMessageWriter::WriteString(std::string_view text) {
+    Write("\"");
+    size_t start = 0;
+    char unicode[7];
+    for (size_t i = 0; i < text.size(); i++) {
+        uint8_t c = text[i];
+        const char* escape;
+        switch (c) {
+        case '"': escape = "\\\""; break;
+        case '\\': escape = "\\\\"; break;
+        case '\b': escape = "\\b"; break;
+        case '\f': escape = "\\f"; break;
+        case '\n': escape = "\\n"; break;
+        case '\r': escape = "\\r"; break;
+        case '\t': escape = "\\t"; break;
+        default:
+            if (c >= 0x20) {
+                continue;
+            }
+            snprintf(unicode, sizeof(unicode), "\\u%04x", c);
+            escape = unicode;
+            break;
+        }
+        Write(text.substr(start, i - start));
+        Write(escape);
+        start = i + 1;
+    }
+    Write(text.substr(start));
+    Write("\"");
+}
+
+void McpMessageWriter::Flush(bool last) {
+    static std::atomic<uint32_t> next_message_id{1};
+    if (index_ == 0) {
+        message_id_ = next_message_id++;
+        metric_chunked_messages.Add();
+    }
+    size_t cut = buffer_.size();
+    if (!last) {
+        cut = MCP_CHUNK_SIZE;
+        while (cut > 0 && ((uint8_t)buffer_[cut] & 0xC0) == 0x80) {
+            cut--;
+        }
+    }
+    Application::GetInstance().SendMcpChunk(message_id_, index_++, last, buffer_.substr(0, cut));
+    buffer_.erase(0, cut);
+}
+
+void McpMessageWriter::Finish() {
+    if (index_ == 0) {
+        Application::GetInstance().SendMcpMessage(buffer_);
+    } else {
+        Flush(true);
+    }
+    buffer_.clear();
+}
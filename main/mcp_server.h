@@ -3,15 +3,22 @@
 
 #include <string>
 #include <vector>
+#include <unordered_map>
 #include <map>
 #include <functional>
 #include <variant>
 #include <optional>
 #include <stdexcept>
 #include <thread>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <string_view>
 
 #include <cJSON.h>
 
+#include "mcp_tool_executor.h"
+
 // 添加类型别名
 using ReturnValue = std::variant<bool, int, std::string>;
 
@@ -21,6 +28,13 @@ enum PropertyType {
     kPropertyTypeString
 };
 
+enum PropertyBindResult {
+    kPropertyBindOk,
+    kPropertyBindMissing,       // 缺少参数或类型不匹配
+    kPropertyBindBelowMinimum,
+    kPropertyBindAboveMaximum,
+};
+
 class Property {
 private:
     std::string name_;
@@ -86,6 +100,42 @@ public:
         value_ = value;
     }
 
+    // tools/call 的参数绑定，越界时返回错误而不是抛异常
+    PropertyBindResult Bind(const cJSON* value) {
+        switch (type_) {
+        case kPropertyTypeBoolean:
+            if (!cJSON_IsBool(value)) {
+                return kPropertyBindMissing;
+            }
+            value_ = cJSON_IsTrue(value) ? true : false;
+            return kPropertyBindOk;
+        case kPropertyTypeInteger:
+            if (!cJSON_IsNumber(value)) {
+                return kPropertyBindMissing;
+            }
+            if (min_value_.has_value() && value->valueint < min_value_.value()) {
+                return kPropertyBindBelowMinimum;
+            }
+            if (max_value_.has_value() && value->valueint > max_value_.value()) {
+                return kPropertyBindAboveMaximum;
+            }
+            value_ = value->valueint;
+            return kPropertyBindOk;
+        case kPropertyTypeString:
+            if (!cJSON_IsString(value)) {
+                return kPropertyBindMissing;
+            }
+            // 默认值已经是字符串时复用它的缓冲区
+            if (auto str = std::get_if<std::string>(&value_)) {
+                str->assign(value->valuestring);
+            } else {
+                value_ = std::string(value->valuestring);
+            }
+            return kPropertyBindOk;
+        }
+        return kPropertyBindMissing;
+    }
+
     std::string to_json() const {
         cJSON *json = cJSON_CreateObject();
         
@@ -171,12 +221,92 @@ public:
     }
 };
 
+// 一次 tools/call，异步工具可以在任意线程通过它上报进度和结果
+class McpToolCall {
+private:
+    int id_;
+    std::string progress_token_;    // JSON 格式的 progressToken，为空表示对方不需要进度通知
+    std::atomic<bool> cancelled_{false};
+    std::atomic<bool> finished_{false};
+
+    // 认领这次调用的回复，已经回复过或已被取消时返回 false
+    bool Finish();
+
+public:
+    McpToolCall(int id, const std::string& progress_token) : id_(id), progress_token_(progress_token) {}
+
+    inline int id() const { return id_; }
+    // 对方取消、打断说话或开始新会话后为 true，工具应尽快停止并不再回复
+    inline bool cancelled() const { return cancelled_; }
+    inline void Cancel() { cancelled_ = true; }
+
+    // 发送 notifications/progress
+    void Progress(int progress, int total, const std::string& message = "");
+    // 只有第一次 Complete/Fail 有效，取消后不再回复
+    void Complete(const ReturnValue& value);
+    void Fail(const std::string& message);
+};
+
+using McpToolCallPtr = std::shared_ptr<McpToolCall>;
+using McpAsyncToolCallback = std::function<void(const PropertyList&, McpToolCallPtr)>;
+
+// 编译期定义的工具参数，字段含义与 Property 的构造函数相同
+struct McpStaticProperty {
+    const char* name;
+    PropertyType type;
+    bool has_default_value;
+    int default_value;              // 布尔和整数的默认值
+    const char* default_string;     // 字符串的默认值
+    bool has_range;
+    int min_value;
+    int max_value;
+};
+
+constexpr McpStaticProperty McpBoolProperty(const char* name) {
+    return {name, kPropertyTypeBoolean, false, 0, nullptr, false, 0, 0};
+}
+constexpr McpStaticProperty McpBoolProperty(const char* name, bool default_value) {
+    return {name, kPropertyTypeBoolean, true, default_value, nullptr, false, 0, 0};
+}
+constexpr McpStaticProperty McpIntProperty(const char* name) {
+    return {name, kPropertyTypeInteger, false, 0, nullptr, false, 0, 0};
+}
+constexpr McpStaticProperty McpIntProperty(const char* name, int min_value, int max_value) {
+    return {name, kPropertyTypeInteger, false, 0, nullptr, true, min_value, max_value};
+}
+constexpr McpStaticProperty McpIntProperty(const char* name, int default_value, int min_value, int max_value) {
+    return {name, kPropertyTypeInteger, true, default_value, nullptr, true, min_value, max_value};
+}
+constexpr McpStaticProperty McpStringProperty(const char* name) {
+    return {name, kPropertyTypeString, false, 0, nullptr, false, 0, 0};
+}
+constexpr McpStaticProperty McpStringProperty(const char* name, const char* default_value) {
+    return {name, kPropertyTypeString, true, 0, default_value, false, 0, 0};
+}
+
+// 编译期定义的工具，整张表是常量，名字、描述和参数定义都留在 flash 中
+// 回调是普通函数指针，context 为注册时传入的对象
+struct McpStaticTool {
+    const char* name;
+    const char* description;
+    const McpStaticProperty* properties;
+    size_t property_count;
+    ReturnValue (*callback)(void* context, const PropertyList& properties);
+};
+
+// 用于 McpStaticTool 的参数表，例如 MCP_STATIC_PROPERTIES(kLevelProperties)
+#define MCP_STATIC_PROPERTIES(array) array, sizeof(array) / sizeof((array)[0])
+#define MCP_NO_PROPERTIES nullptr, 0
+
 class McpTool {
 private:
     std::string name_;
     std::string description_;
     PropertyList properties_;
     std::function<ReturnValue(const PropertyList&)> callback_;
+    McpAsyncToolCallback async_callback_;
+    const McpStaticTool* static_tool_ = nullptr;
+    void* context_ = nullptr;
 
 public:
     McpTool(const std::string& name, 
@@ -188,21 +318,62 @@ public:
         properties_(properties), 
         callback_(callback) {}
 
+    // 异步工具：回调可以先返回，之后通过 McpToolCall 上报进度和结果
+    McpTool(const std::string& name,
+            const std::string& description,
+            const PropertyList& properties,
+            McpAsyncToolCallback async_callback)
+        : name_(name),
+        description_(description),
+        properties_(properties),
+        async_callback_(async_callback) {}
+
+    // 编译期定义的工具，描述和参数定义不复制到堆上
+    McpTool(const McpStaticTool* static_tool, void* context)
+        : name_(static_tool->name),
+        static_tool_(static_tool),
+        context_(context) {}
+
     inline const std::string& name() const { return name_; }
-    inline const std::string& description() const { return description_; }
-    inline const PropertyList& properties() const { return properties_; }
+    inline const char* description() const { return static_tool_ ? static_tool_->description : description_.c_str(); }
+    inline bool is_async() const { return async_callback_ != nullptr; }
+
+    // 本次调用的参数帧，编译期定义的工具在这里才生成 PropertyList
+    PropertyList properties() const {
+        if (static_tool_ == nullptr) {
+            return properties_;
+        }
+        PropertyList list;
+        for (size_t i = 0; i < static_tool_->property_count; i++) {
+            auto& p = static_tool_->properties[i];
+            if (p.type == kPropertyTypeInteger && p.has_range) {
+                list.AddProperty(p.has_default_value ? Property(p.name, p.type, p.default_value, p.min_value, p.max_value)
+                    : Property(p.name, p.type, p.min_value, p.max_value));
+            } else if (!p.has_default_value) {
+                list.AddProperty(Property(p.name, p.type));
+            } else if (p.type == kPropertyTypeBoolean) {
+                list.AddProperty(Property(p.name, p.type, p.default_value != 0));
+            } else if (p.type == kPropertyTypeInteger) {
+                list.AddProperty(Property(p.name, p.type, p.default_value));
+            } else {
+                list.AddProperty(Property(p.name, p.type, std::string(p.default_string)));
+            }
+        }
+        return list;
+    }
 
     std::string to_json() const {
-        std::vector<std::string> required = properties_.GetRequired();
+        PropertyList property_list = properties();
+        std::vector<std::string> required = property_list.GetRequired();
         
         cJSON *json = cJSON_CreateObject();
         cJSON_AddStringToObject(json, "name", name_.c_str());
-        cJSON_AddStringToObject(json, "description", description_.c_str());
+        cJSON_AddStringToObject(json, "description", description());
         
         cJSON *input_schema = cJSON_CreateObject();
         cJSON_AddStringToObject(input_schema, "type", "object");
         
-        cJSON *properties = cJSON_Parse(properties_.to_json().c_str());
+        cJSON *properties = cJSON_Parse(property_list.to_json().c_str());
         cJSON_AddItemToObject(input_schema, "properties", properties);
         
         if (!required.empty()) {
@@ -223,8 +394,22 @@ public:
         return result;
     }
 
+    ReturnValue Invoke(const PropertyList& properties) {
+        if (static_tool_ != nullptr) {
+            return static_tool_->callback(context_, properties);
+        }
+        return callback_(properties);
+    }
+
     std::string Call(const PropertyList& properties) {
-        ReturnValue return_value = callback_(properties);
+        return FormatResult(Invoke(properties));
+    }
+
+    void CallAsync(const PropertyList& properties, McpToolCallPtr call) {
+        async_callback_(properties, call);
+    }
+
+    static std::string FormatResult(const ReturnValue& return_value) {
         // 返回结果
         cJSON* result = cJSON_CreateObject();
         cJSON* content = cJSON_CreateArray();
@@ -249,6 +434,30 @@ public:
     }
 };
 
+// 边生成边发送一条 MCP 消息（CONFIG_MCP_CHUNKED_MESSAGES）
+// 缓冲区满 MCP_CHUNK_SIZE 字节就作为一块发出，不在内存中拼出整条消息；块在 UTF-8 字符边界切分
+// 服务器没有确认 mcp_chunks，或者整条消息没有超过一块时，Finish 按普通 MCP 消息发送
+// 工具描述和结果是逐段写入的，所以不能放在 QueueReply 的批量响应中
+#define MCP_CHUNK_SIZE 4096
+
+class McpMessageWriter {
+public:
+    McpMessageWriter();
+
+    void Write(std::string_view text);
+    // 写入 JSON 字符串的内容，加上引号并转义
+    void WriteString(std::string_view text);
+    void Finish();
+
+private:
+    std::string buffer_;
+    bool chunked_;
+    uint32_t message_id_ = 0;
+    uint32_t index_ = 0;
+
+    void Flush(bool last);
+};
+
 class McpServer {
 public:
     static McpServer& GetInstance() {
@@ -259,23 +468,64 @@ public:
     void AddCommonTools();
     void AddTool(McpTool* tool);
     void AddTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback);
+    // 注册一张编译期定义的工具表，tools 必须是静态存储期的常量
+    void AddStaticTools(const McpStaticTool* tools, size_t count, void* context);
+    void AddAsyncTool(const std::string& name, const std::string& description, const PropertyList& properties, McpAsyncToolCallback callback);
     void ParseMessage(const cJSON* json);
-    void ParseMessage(const std::string& message);
+    void ParseMessage(std::string_view message);
+    // 取消所有进行中的工具调用，打断说话或开始新会话时调用
+    void CancelToolCalls();
+    // 在调用者线程上直接执行一个同步工具，用于设备本地识别出的命令，执行后用 notifications/tools/local_call
+    // 告诉服务器；之后 MCP_LOCAL_CALL_DEDUP_MS 内服务器对同一工具的 tools/call 直接回复成功，不再重复执行
+    bool CallToolLocally(const std::string& tool_name, const cJSON* tool_arguments, const std::string& text);
+    // 全部工具描述的 CRC32，在 hello 中告诉服务器，描述没变时服务器可以跳过 tools/list
+    std::string GetToolsHash();
 
 private:
+    friend class McpToolCall;
+
     McpServer();
     ~McpServer();
 
     void ParseCapabilities(const cJSON* capabilities);
+    void ParseRequest(const cJSON* json);
 
     void ReplyResult(int id, const std::string& result);
     void ReplyError(int id, const std::string& message);
+    // 工具调用的结果，文本边转义边发送，不再先用 cJSON 生成整个 result
+    void ReplyToolResult(int id, const ReturnValue& value);
+    void QueueReply(const std::string& reply);
+    void FlushReplies();
 
     void GetToolsList(int id, const std::string& cursor);
-    void DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments, int stack_size);
+    bool BindArguments(McpTool* tool, const cJSON* tool_arguments, PropertyList& arguments, std::string& error);
+    void DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments, int stack_size, const std::string& progress_token);
+    void CancelToolCall(int id);
 
     std::vector<McpTool*> tools_;
-    std::thread tool_call_thread_;
+    // 按名字索引工具，tools/call 不再逐个比较字符串
+    std::unordered_map<std::string, McpTool*> tool_index_;
+    // 预先序列化的 tools/list 分页，AddTool 后失效，下次请求时重建
+    struct ToolsPage {
+        std::string cursor;     // 本页第一个工具的名字，第一页为空
+        std::string result;     // 序列化好的 result；error 为 true 时是错误信息
+        bool error;
+    };
+    std::vector<ToolsPage> tools_pages_;
+    bool tools_pages_valid_ = false;
+    McpToolExecutor tool_executor_;
+    std::mutex calls_mutex_;
+    std::map<int, McpToolCallPtr> active_calls_;
+    // 本地执行过的工具和执行时间
+    std::unordered_map<std::string, int64_t> local_calls_;
+
+    // 对方发过批量请求后，同一轮主循环内完成的回复合并成一个 JSON-RPC 批量响应发送
+    bool batch_replies_ = false;
+    std::mutex reply_mutex_;
+    std::string pending_replies_;
+    int pending_reply_count_ = 0;
+
+    void BuildToolsPages();
 };
 
 #endif // MCP_SERVER_H
@@ -0,0 +1,88 @@
+#include "mcp_tool_executor.h"
+#include "task_manifest.h"
+
+#include <esp_log.h>
+
+#define TAG "McpToolExecutor"
+
+McpToolExecutor::McpToolExecutor(const std::vector<McpToolStackClass>& classes, int max_pending)
+    : max_pending_(max_pending) {
+    classes_.reserve(classes.size());
+    for (auto& config : classes) {
+        classes_.push_back({this, config.stack_size, config.max_workers, config.placement});
+    }
+}
+
+McpToolExecutor::~McpToolExecutor() {
+    for (auto& stack_class : classes_) {
+        for (auto handle : stack_class.workers) {
+            TaskStack::Delete(handle);
+        }
+    }
+}
+
+void McpToolExecutor::StartWorker(StackClass& stack_class) {
+    TaskHandle_t handle = nullptr;
+    auto& spec = TaskManifest::GetInstance().Get(kTaskToolCall);
+    auto started = TaskStack::Create(spec.name, stack_class.stack_size, spec.priority, stack_class.placement, [&stack_class]() {
+        stack_class.owner->WorkerLoop(&stack_class);
+    }, &handle, spec.core);
+    if (!started) {
+        ESP_LOGE(TAG, "Failed to start worker, stack size: %lu", stack_class.stack_size);
+        return;
+    }
+    stack_class.workers.push_back(handle);
+    ESP_LOGI(TAG, "Worker %u started, stack size: %lu%s", stack_class.workers.size(), stack_class.stack_size,
+        stack_class.placement == kTaskStackPsram ? " (PSRAM)" : "");
+}
+
+McpToolScheduleResult McpToolExecutor::Schedule(uint32_t stack_size, std::function<void()> callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    StackClass* target = nullptr;
+    for (auto& stack_class : classes_) {
+        if (stack_class.stack_size >= stack_size) {
+            target = &stack_class;
+            break;
+        }
+    }
+    if (target == nullptr) {
+        ESP_LOGW(TAG, "Stack size %lu exceeds the largest worker", stack_size);
+        return kMcpToolScheduleStackTooLarge;
+    }
+    if (pending_ >= max_pending_) {
+        ESP_LOGW(TAG, "Queue is full, pending: %d", pending_);
+        return kMcpToolScheduleQueueFull;
+    }
+
+    // 空闲 worker 不够时再创建一个，创建失败就排队等已有的 worker
+    if (target->idle <= (int)target->tasks.size() && (int)target->workers.size() < target->max_workers) {
+        StartWorker(*target);
+    }
+    if (target->workers.empty()) {
+        return kMcpToolScheduleNoWorker;
+    }
+
+    pending_++;
+    target->tasks.emplace_back(std::move(callback));
+    condition_variable_.notify_all();
+    return kMcpToolScheduleOk;
+}
+
+void McpToolExecutor::WorkerLoop(StackClass* stack_class) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        stack_class->idle++;
+        condition_variable_.wait(lock, [stack_class]() { return !stack_class->tasks.empty(); });
+        stack_class->idle--;
+
+        auto task = std::move(stack_class->tasks.front());
+        stack_class->tasks.pop_front();
+        lock.unlock();
+
+        task();
+        task = nullptr;
+
+        lock.lock();
+        pending_--;
+    }
+}
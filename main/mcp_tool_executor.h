@@ -0,0 +1,61 @@
+#ifndef MCP_TOOL_EXECUTOR_H
+#define MCP_TOOL_EXECUTOR_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <mutex>
+#include <list>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+#include "task_stack.h"
+
+enum McpToolScheduleResult {
+    kMcpToolScheduleOk,
+    kMcpToolScheduleQueueFull,
+    kMcpToolScheduleStackTooLarge,
+    kMcpToolScheduleNoWorker,
+};
+
+struct McpToolStackClass {
+    uint32_t stack_size;
+    int max_workers;
+    TaskStackPlacement placement = kTaskStackInternal;
+};
+
+// MCP 工具调用执行器
+// worker 按栈大小分级，每级最多 max_workers 个，第一次需要时创建，之后常驻复用；
+// 排队加执行中的调用数有上限，超出直接拒绝，不再为每次调用新建线程
+class McpToolExecutor {
+public:
+    // classes 按栈大小升序排列
+    McpToolExecutor(const std::vector<McpToolStackClass>& classes, int max_pending);
+    ~McpToolExecutor();
+
+    // 在栈不小于 stack_size 的最小一级 worker 上执行
+    McpToolScheduleResult Schedule(uint32_t stack_size, std::function<void()> callback);
+
+private:
+    struct StackClass {
+        McpToolExecutor* owner;
+        uint32_t stack_size;
+        int max_workers;
+        TaskStackPlacement placement;
+        int idle = 0;
+        std::list<std::function<void()>> tasks;
+        std::vector<TaskHandle_t> workers;
+    };
+
+    std::mutex mutex_;
+    std::condition_variable condition_variable_;
+    // 构造后不再增删，worker 持有其中元素的指针
+    std::vector<StackClass> classes_;
+    int max_pending_;
+    int pending_ = 0;   // 排队中和执行中的调用数
+
+    void StartWorker(StackClass& stack_class);
+    void WorkerLoop(StackClass* stack_class);
+};
+
+#endif // MCP_TOOL_EXECUTOR_H
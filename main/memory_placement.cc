@@ -0,0 +1,127 @@
+#include "memory_placement.h"
+#include "settings.h"
+#include "metrics.h"
+#include "memory_profile.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <esp_app_desc.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#define TAG "MemoryPlacement"
+
+// 挪到内部 RAM 后最少还要剩下的空闲内部 RAM
+#define MEMORY_PLACEMENT_INTERNAL_RESERVE (48 * 1024)
+// 大于 PSRAM 的 cache，测量的是总线而不是 cache
+#define CONTENTION_BUFFER_SIZE (128 * 1024)
+// 另一个核每次搬运的大小，相当于 320x40 的 RGB565 绘制缓冲区
+#define CONTENTION_COPY_SIZE (25 * 1024)
+#define CONTENTION_ROUNDS 8
+
+static MetricGauge metric_contention("psram.contention_pct");
+
+void MemoryPlacement::Initialize() {
+#if CONFIG_SPIRAM
+    // 结果只和芯片、PSRAM 配置有关，同一个固件只测一次
+    auto version = esp_app_get_description()->version;
+    {
+        Settings settings("placement", false);
+        if (settings.GetString("version") == version) {
+            contention_percent_ = settings.GetInt("contention", -1);
+        }
+    }
+    if (contention_percent_ < 0) {
+        contention_percent_ = MeasureContention();
+        Settings settings("placement", true);
+        settings.SetString("version", version);
+        settings.SetInt("contention", contention_percent_);
+    }
+    metric_contention.Set(contention_percent_);
+    ESP_LOGI(TAG, "PSRAM contention %d%%, audio/LCD buffers prefer %s", contention_percent_,
+        contended() ? "internal RAM" : "PSRAM");
+#endif
+}
+
+// 按 cache line 的间隔读，每次都要访问总线
+static uint32_t ReadPsram(const uint8_t* buffer) {
+    uint32_t sum = 0;
+    for (int round = 0; round < CONTENTION_ROUNDS; round++) {
+        for (size_t i = 0; i < CONTENTION_BUFFER_SIZE; i += 32) {
+            sum += *reinterpret_cast<const volatile uint32_t*>(buffer + i);
+        }
+    }
+    return sum;
+}
+
+int MemoryPlacement::MeasureContention() {
+#if CONFIG_SPIRAM && !CONFIG_FREERTOS_UNICORE
+    auto buffer = (uint8_t*)heap_caps_malloc(CONTENTION_BUFFER_SIZE, MALLOC_CAP_SPIRAM);
+    auto copy = (uint8_t*)heap_caps_malloc(CONTENTION_COPY_SIZE * 2, MALLOC_CAP_SPIRAM);
+    if (buffer == nullptr || copy == nullptr) {
+        heap_caps_free(buffer);
+        heap_caps_free(copy);
+        return -1;
+    }
+    memset(buffer, 0x5A, CONTENTION_BUFFER_SIZE);
+    memset(copy, 0xA5, CONTENTION_COPY_SIZE * 2);
+
+    int64_t start = esp_timer_get_time();
+    ReadPsram(buffer);
+    int64_t idle_us = esp_timer_get_time() - start;
+
+    // 另一个核模仿 LVGL 渲染和刷屏，不停地在 PSRAM 中搬运
+    struct Contender {
+        uint8_t* copy;
+        std::atomic<bool> running{true};
+        SemaphoreHandle_t done = xSemaphoreCreateBinary();
+    } contender;
+    contender.copy = copy;
+    int core = xPortGetCoreID() == 0 ? 1 : 0;
+    BaseType_t created = xTaskCreatePinnedToCore([](void* arg) {
+        auto contender = static_cast<Contender*>(arg);
+        while (contender->running) {
+            memcpy(contender->copy + CONTENTION_COPY_SIZE, contender->copy, CONTENTION_COPY_SIZE);
+        }
+        xSemaphoreGive(contender->done);
+        vTaskDelete(NULL);
+    }, "psram_contend", 2048, &contender, uxTaskPriorityGet(NULL), nullptr, core);
+
+    int percent = -1;
+    if (created == pdPASS) {
+        vTaskDelay(1);
+        start = esp_timer_get_time();
+        ReadPsram(buffer);
+        int64_t contended_us = esp_timer_get_time() - start;
+        contender.running = false;
+        xSemaphoreTake(contender.done, portMAX_DELAY);
+        percent = idle_us > 0 ? std::max<int64_t>(0, (contended_us - idle_us) * 100 / idle_us) : 0;
+        ESP_LOGI(TAG, "PSRAM read %lld us idle, %lld us contended", idle_us, contended_us);
+    }
+    vSemaphoreDelete(contender.done);
+    heap_caps_free(buffer);
+    heap_caps_free(copy);
+    return percent;
+#else
+    return -1;
+#endif
+}
+
+bool MemoryPlacement::PreferInternal(MemoryUse use, size_t bytes) const {
+    if (!contended()) {
+        return false;
+    }
+    static const size_t budgets[kMemoryUseCount] = {
+        MEMORY_PROFILE_AUDIO_INTERNAL_KB * 1024,
+        MEMORY_PROFILE_LCD_INTERNAL_KB * 1024,
+    };
+    uint32_t caps = use == kMemoryUseLcd ? MALLOC_CAP_DMA : MALLOC_CAP_INTERNAL;
+    return bytes <= budgets[use] && heap_caps_get_free_size(caps) >= bytes + MEMORY_PLACEMENT_INTERNAL_RESERVE &&
+        heap_caps_get_largest_free_block(caps) >= bytes;
+}
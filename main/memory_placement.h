@@ -0,0 +1,49 @@
+#ifndef MEMORY_PLACEMENT_H
+#define MEMORY_PLACEMENT_H
+
+#include <cstddef>
+#include <cstdint>
+
+// 可以在内部 RAM 和 PSRAM 之间选择位置的缓冲区
+enum MemoryUse {
+    kMemoryUseAudio,    // AFE 等音频实时处理的缓冲区
+    kMemoryUseLcd,      // LVGL 绘制缓冲区
+    kMemoryUseCount
+};
+
+// 内部 RAM 和 PSRAM 的放置策略
+// LVGL、AFE、摄像头和 Opus 共用同一条 PSRAM 总线，整屏刷新时 AFE 访问 PSRAM 会被拖慢，严重时音频帧处理超时
+// 启动时测量一次 PSRAM 争用：另一个核持续搬运 PSRAM 时，本核读 PSRAM 的耗时增加的百分比，结果按固件版本缓存在 NVS
+// 争用超过 CONFIG_PSRAM_CONTENTION_THRESHOLD 时，把音频和绘制缓冲区挪到内部 RAM，
+// 每类最多挪 memory_profile 中的预算（MEMORY_PROFILE_AUDIO_INTERNAL_KB / MEMORY_PROFILE_LCD_INTERNAL_KB），
+// 并保证内部 RAM 留有 MEMORY_PLACEMENT_INTERNAL_RESERVE 的余量。摄像头帧缓冲区太大，始终在 PSRAM 中
+class MemoryPlacement {
+public:
+    static MemoryPlacement& GetInstance() {
+        static MemoryPlacement instance;
+        return instance;
+    }
+
+    // 在创建显示和 AFE 之前调用
+    void Initialize();
+    // 测量 PSRAM 争用，返回增加的耗时百分比，没有 PSRAM 或只有一个核时返回 -1
+    static int MeasureContention();
+    // 原本放在 PSRAM 中的 bytes 字节是否改放内部 RAM
+    bool PreferInternal(MemoryUse use, size_t bytes) const;
+
+    int contention_percent() const { return contention_percent_; }
+    bool contended() const {
+#if CONFIG_SPIRAM
+        return contention_percent_ >= CONFIG_PSRAM_CONTENTION_THRESHOLD;
+#else
+        return false;
+#endif
+    }
+
+private:
+    int contention_percent_ = -1;
+
+    MemoryPlacement() = default;
+};
+
+#endif // MEMORY_PLACEMENT_H
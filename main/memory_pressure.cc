@@ -0,0 +1,98 @@
+#include "memory_pressure.h"
+#include "metrics.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <algorithm>
+
+#define TAG "MemoryPressure"
+
+// 降一级前需要连续满足恢复条件的次数
+#define MEMORY_PRESSURE_RECOVER_CHECKS 5
+// 恢复时剩余量需要高于阈值多少 KB
+#define MEMORY_PRESSURE_HYSTERESIS_KB 8
+
+static MetricGauge metric_level("mem.pressure_level");
+static MetricCounter metric_transitions("mem.pressure_transitions");
+
+static const char* level_names[kMemoryPressureLevelCount] = {"normal", "low", "critical"};
+
+MemoryPressureLevel MemoryPressure::StageLevel(MemoryPressureStage stage) {
+    return stage < kMemoryStageGlyphCache ? kMemoryPressureLow : kMemoryPressureCritical;
+}
+
+void MemoryPressure::Subscribe(MemoryPressureStage stage, Callback callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (engaged(stage)) {
+        callback(true);
+    }
+    callbacks_[stage].push_back(std::move(callback));
+}
+
+MemoryPressureLevel MemoryPressure::TargetLevel(int free_kb, int margin_kb) const {
+#if CONFIG_MEMORY_PRESSURE_MONITOR
+    if (free_kb < CONFIG_MEMORY_PRESSURE_CRITICAL_KB + margin_kb) {
+        return kMemoryPressureCritical;
+    }
+    if (free_kb < CONFIG_MEMORY_PRESSURE_LOW_KB + margin_kb) {
+        return kMemoryPressureLow;
+    }
+#endif
+    return kMemoryPressureNormal;
+}
+
+bool MemoryPressure::Update() {
+    // 碎片化时最大块比总剩余量更早耗尽，按两者中较紧的一个判断
+    int free_kb = heap_caps_get_free_size(MALLOC_CAP_INTERNAL) / 1024;
+    int largest_kb = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL) / 1024;
+    int available_kb = std::min(free_kb, largest_kb * 2);
+
+    MemoryPressureLevel current = level_;
+    MemoryPressureLevel next = current;
+    MemoryPressureLevel target = TargetLevel(available_kb, 0);
+    if (target > current) {
+        next = target;
+        recover_count_ = 0;
+    } else if (TargetLevel(available_kb, MEMORY_PRESSURE_HYSTERESIS_KB) < current) {
+        if (++recover_count_ >= MEMORY_PRESSURE_RECOVER_CHECKS) {
+            next = static_cast<MemoryPressureLevel>(current - 1);
+            recover_count_ = 0;
+        }
+    } else {
+        recover_count_ = 0;
+    }
+    if (next == current) {
+        return false;
+    }
+
+    ESP_LOGW(TAG, "%s -> %s (free %d KB, largest block %d KB)", level_names[current], level_names[next],
+        free_kb, largest_kb);
+    metric_level.Set(next);
+    metric_transitions.Add();
+    Notify(current, next);
+    return true;
+}
+
+void MemoryPressure::Notify(MemoryPressureLevel from, MemoryPressureLevel to) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    level_ = to;
+    if (to > from) {
+        for (int stage = 0; stage < kMemoryStageCount; stage++) {
+            auto level = StageLevel(static_cast<MemoryPressureStage>(stage));
+            if (level > from && level <= to) {
+                for (auto& callback : callbacks_[stage]) {
+                    callback(true);
+                }
+            }
+        }
+    } else {
+        for (int stage = kMemoryStageCount - 1; stage >= 0; stage--) {
+            auto level = StageLevel(static_cast<MemoryPressureStage>(stage));
+            if (level > to && level <= from) {
+                for (auto& callback : callbacks_[stage]) {
+                    callback(false);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef MEMORY_PRESSURE_H
+#define MEMORY_PRESSURE_H
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+enum MemoryPressureLevel {
+    kMemoryPressureNormal,
+    kMemoryPressureLow,
+    kMemoryPressureCritical,
+    kMemoryPressureLevelCount
+};
+
+// 内存紧张时依次执行的降级措施，进入时按顺序，恢复时倒序
+enum MemoryPressureStage {
+    kMemoryStageAudioQueues,    // low：缩小解码和发送队列的包数上限
+    kMemoryStageCameraPreview,  // low：释放摄像头预览图，拍照不再生成预览
+    kMemoryStageGlyphCache,     // critical：清空字形缓存并停止缓存
+    kMemoryStageLedEffects,     // critical：暂停灯效动画
+    kMemoryStageCount
+};
+
+// 按内部 SRAM 的剩余量判断内存压力，等级变化时通知订阅的子系统逐级释放内存，而不是各自在分配失败时出错
+// 升级立即生效，可以直接跳到 critical；剩余量高于阈值加回差并连续几次满足时才降一级
+// 回调在调用 Update 的任务中执行，订阅方自己负责线程安全
+class MemoryPressure {
+public:
+    using Callback = std::function<void(bool engaged)>;
+
+    static MemoryPressure& GetInstance() {
+        static MemoryPressure instance;
+        return instance;
+    }
+
+    // 订阅某个降级措施，engaged 为 true 时释放内存，false 时恢复；订阅时已经处于降级的措施立即回调一次
+    void Subscribe(MemoryPressureStage stage, Callback callback);
+    // 由时钟定时器每秒调用一次（CONFIG_MEMORY_PRESSURE_MONITOR），等级变化时返回 true
+    bool Update();
+    MemoryPressureLevel level() const { return level_.load(std::memory_order_relaxed); }
+    bool engaged(MemoryPressureStage stage) const { return StageLevel(stage) <= level(); }
+
+private:
+    std::mutex mutex_;
+    std::vector<Callback> callbacks_[kMemoryStageCount];
+    std::atomic<MemoryPressureLevel> level_{kMemoryPressureNormal};
+    int recover_count_ = 0;
+
+    MemoryPressure() = default;
+    static MemoryPressureLevel StageLevel(MemoryPressureStage stage);
+    MemoryPressureLevel TargetLevel(int free_kb, int margin_kb) const;
+    void Notify(MemoryPressureLevel from, MemoryPressureLevel to);
+};
+
+#endif // MEMORY_PRESSURE_H
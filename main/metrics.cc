@@ -0,0 +1,531 @@
+#include "metrics.h"
+
+#include <esp_heap_caps.h>
+#include <esp_log.h>
+#include <esp_memory_utils.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <algorithm>
+#include <cstring>
+
+#define TAG "Metrics"
+
+// 任务栈剩余低于这个值时打印警告
+#define STACK_LOW_WATER_BYTES 512
+// Profile 期间采样堆和队列深度的间隔
+#define PROFILE_SAMPLE_MS 100
+
+std::atomic<Metric*> Metrics::head_{nullptr};
+
+static MetricGauge metric_cpu_load("cpu.load_pct");
+
+namespace {
+
+struct HeapMetrics {
+    uint32_t caps;
+    MetricGauge free;
+    MetricGauge minimum;
+    MetricGauge largest;
+    MetricGauge fragmentation;  // 1 - 最大空闲块 / 空闲总量，百分比
+};
+
+HeapMetrics heap_metrics[] = {
+    {MALLOC_CAP_INTERNAL, MetricGauge("heap.internal.free"), MetricGauge("heap.internal.min"), MetricGauge("heap.internal.largest"), MetricGauge("heap.internal.frag_pct")},
+    {MALLOC_CAP_SPIRAM, MetricGauge("heap.spiram.free"), MetricGauge("heap.spiram.min"), MetricGauge("heap.spiram.largest"), MetricGauge("heap.spiram.frag_pct")},
+    {MALLOC_CAP_DMA, MetricGauge("heap.dma.free"), MetricGauge("heap.dma.min"), MetricGauge("heap.dma.largest"), MetricGauge("heap.dma.frag_pct")},
+};
+
+} // namespace
+
+Metric::Metric(const char* name, MetricType type) : name_(name), type_(type) {
+    Metrics::Register(this);
+}
+
+MetricHistogram::MetricHistogram(const char* name, std::initializer_list<uint32_t> bounds)
+    : Metric(name, kMetricHistogram) {
+    for (auto bound : bounds) {
+        if (bound_count_ == kMaxBounds) {
+            break;
+        }
+        bounds_[bound_count_++] = bound;
+    }
+}
+
+void MetricHistogram::Record(uint32_t value) {
+    int bucket = 0;
+    while (bucket < bound_count_ && value > bounds_[bucket]) {
+        bucket++;
+    }
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    uint32_t current = max_.load(std::memory_order_relaxed);
+    while (value > current && !max_.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+uint32_t MetricHistogram::Percentile(int percent) const {
+    uint32_t total = count();
+    if (total == 0) {
+        return 0;
+    }
+    uint32_t target = (total * percent + 99) / 100;
+    uint32_t seen = 0;
+    for (int i = 0; i < bound_count_; i++) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= target) {
+            return bounds_[i];
+        }
+    }
+    // 落在最后一个桶，用最大值代替上界
+    return max();
+}
+
+void Metrics::Register(Metric* metric) {
+    Metric* head = head_.load(std::memory_order_relaxed);
+    do {
+        metric->next_ = head;
+    } while (!head_.compare_exchange_weak(head, metric, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void Metrics::SampleHeap() {
+    for (auto& heap : heap_metrics) {
+        size_t free_size = heap_caps_get_free_size(heap.caps);
+        size_t largest = heap_caps_get_largest_free_block(heap.caps);
+        heap.free.Set(free_size);
+        heap.minimum.Set(heap_caps_get_minimum_free_size(heap.caps));
+        heap.largest.Set(largest);
+        heap.fragmentation.Set(free_size > 0 ? 100 - (int32_t)((uint64_t)largest * 100 / free_size) : 0);
+    }
+}
+
+// 调用者需要持有 mutex_
+void Metrics::SampleTasks() {
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    UBaseType_t capacity = uxTaskGetNumberOfTasks() + 4;
+    auto tasks = (TaskStatus_t*)malloc(sizeof(TaskStatus_t) * capacity);
+    if (tasks == nullptr) {
+        return;
+    }
+    configRUN_TIME_COUNTER_TYPE total_runtime = 0;
+    UBaseType_t count = uxTaskGetSystemState(tasks, capacity, &total_runtime);
+
+    uint32_t elapsed = (total_runtime - last_total_runtime_) * CONFIG_FREERTOS_NUMBER_OF_CORES;
+    bool has_previous = last_total_runtime_ != 0 && elapsed > 0;
+    std::vector<std::pair<void*, uint32_t>> runtime;
+    runtime.reserve(count);
+    top_tasks_.clear();
+    uint64_t idle_runtime = 0;
+    std::vector<StackUsage> stacks;
+    stacks.reserve(count);
+    for (UBaseType_t i = 0; i < count; i++) {
+        auto& task = tasks[i];
+        runtime.emplace_back(task.xHandle, task.ulRunTimeCounter);
+
+        // ESP-IDF 中栈的单位是字节
+        StackUsage stack = {};
+        strncpy(stack.name, task.pcTaskName, sizeof(stack.name) - 1);
+        stack.free_bytes = task.usStackHighWaterMark;
+        stack.psram = esp_ptr_external_ram(task.pxStackBase);
+        if (stack.free_bytes < STACK_LOW_WATER_BYTES) {
+            // 只在比上次更少时打印
+            bool lower = true;
+            for (auto& previous : stacks_) {
+                if (strcmp(previous.name, stack.name) == 0) {
+                    lower = stack.free_bytes < previous.free_bytes;
+                    break;
+                }
+            }
+            if (lower) {
+                ESP_LOGW(TAG, "Task %s stack low water mark: %lu bytes", stack.name, stack.free_bytes);
+            }
+        }
+        stacks.push_back(stack);
+
+        if (!has_previous) {
+            continue;
+        }
+        // 上次采样之后创建的任务从 0 开始算
+        uint32_t previous = 0;
+        for (auto& item : task_runtime_) {
+            if (item.first == task.xHandle) {
+                previous = item.second;
+                break;
+            }
+        }
+        TaskUsage usage = {};
+        strncpy(usage.name, task.pcTaskName, sizeof(usage.name) - 1);
+#if CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+        usage.core = task.xCoreID == tskNO_AFFINITY ? 0xFF : task.xCoreID;
+#else
+        usage.core = 0xFF;
+#endif
+        usage.cpu_percent = std::min<uint64_t>(100, (uint64_t)(task.ulRunTimeCounter - previous) * 100 / elapsed);
+        // 每个核一个 IDLE 任务
+        if (strncmp(task.pcTaskName, "IDLE", 4) == 0) {
+            idle_runtime += task.ulRunTimeCounter - previous;
+        }
+        top_tasks_.push_back(usage);
+    }
+    free(tasks);
+
+    std::sort(top_tasks_.begin(), top_tasks_.end(), [](const TaskUsage& a, const TaskUsage& b) {
+        return a.cpu_percent > b.cpu_percent;
+    });
+    if (top_tasks_.size() > kTopTasks) {
+        top_tasks_.resize(kTopTasks);
+    }
+    std::sort(stacks.begin(), stacks.end(), [](const StackUsage& a, const StackUsage& b) {
+        return a.free_bytes < b.free_bytes;
+    });
+    stacks_.swap(stacks);
+    task_runtime_.swap(runtime);
+    last_total_runtime_ = total_runtime;
+    if (has_previous) {
+        int load = 100 - (int)std::min<uint64_t>(100, idle_runtime * 100 / elapsed);
+        cpu_load_percent_ = load;
+        metric_cpu_load.Set(load);
+    }
+#endif
+}
+
+void Metrics::Sample() {
+    SampleHeap();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    SampleTasks();
+
+    auto& snapshot = ring_[ring_next_];
+    snapshot.time_us = esp_timer_get_time();
+    for (Metric* metric = head_.load(std::memory_order_acquire); metric != nullptr; metric = metric->next_) {
+        if (metric->type_ == kMetricHistogram) {
+            continue;
+        }
+        if (metric->slot_ < 0) {
+            metric->slot_ = slot_count_++;
+        }
+    }
+    snapshot.values.resize(slot_count_);
+    for (Metric* metric = head_.load(std::memory_order_acquire); metric != nullptr; metric = metric->next_) {
+        if (metric->type_ == kMetricCounter) {
+            snapshot.values[metric->slot_] = static_cast<MetricCounter*>(metric)->value();
+        } else if (metric->type_ == kMetricGauge) {
+            snapshot.values[metric->slot_] = static_cast<MetricGauge*>(metric)->value();
+        }
+    }
+    ring_next_ = (ring_next_ + 1) % kRingSize;
+    ring_count_ = std::min(ring_count_ + 1, kRingSize);
+}
+
+const Metrics::Snapshot* Metrics::Oldest() const {
+    if (ring_count_ == 0) {
+        return nullptr;
+    }
+    return &ring_[(ring_next_ + kRingSize - ring_count_) % kRingSize];
+}
+
+const Metrics::Snapshot* Metrics::Newest() const {
+    if (ring_count_ == 0) {
+        return nullptr;
+    }
+    return &ring_[(ring_next_ + kRingSize - 1) % kRingSize];
+}
+
+std::string Metrics::GetJson() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto oldest = Oldest();
+    auto newest = Newest();
+
+    auto root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "uptime_s", esp_timer_get_time() / 1000000);
+    cJSON_AddNumberToObject(root, "window_s", oldest ? (newest->time_us - oldest->time_us) / 1000000 : 0);
+
+    auto counters = cJSON_CreateObject();
+    auto gauges = cJSON_CreateObject();
+    auto histograms = cJSON_CreateObject();
+    for (Metric* metric = head_.load(std::memory_order_acquire); metric != nullptr; metric = metric->next_) {
+        int slot = metric->slot_;
+        if (metric->type_ == kMetricCounter) {
+            auto counter = static_cast<MetricCounter*>(metric);
+            auto item = cJSON_CreateObject();
+            cJSON_AddNumberToObject(item, "total", counter->value());
+            // 快照里没有这个指标时说明是窗口开始后才登记的，从 0 算起
+            uint32_t start = (oldest && slot >= 0 && slot < (int)oldest->values.size()) ? (uint32_t)oldest->values[slot] : 0;
+            cJSON_AddNumberToObject(item, "window", (uint32_t)(counter->value() - start));
+            cJSON_AddItemToObject(counters, metric->name_, item);
+        } else if (metric->type_ == kMetricGauge) {
+            auto gauge = static_cast<MetricGauge*>(metric);
+            int32_t min_value = gauge->value(), max_value = gauge->value();
+            for (int i = 0; i < ring_count_ && slot >= 0; i++) {
+                auto& values = ring_[i].values;
+                if (slot < (int)values.size()) {
+                    min_value = std::min(min_value, values[slot]);
+                    max_value = std::max(max_value, values[slot]);
+                }
+            }
+            auto item = cJSON_CreateObject();
+            cJSON_AddNumberToObject(item, "value", gauge->value());
+            cJSON_AddNumberToObject(item, "min", min_value);
+            cJSON_AddNumberToObject(item, "max", max_value);
+            cJSON_AddItemToObject(gauges, metric->name_, item);
+        } else {
+            auto histogram = static_cast<MetricHistogram*>(metric);
+            auto item = cJSON_CreateObject();
+            cJSON_AddNumberToObject(item, "count", histogram->count());
+            cJSON_AddNumberToObject(item, "max", histogram->max());
+            cJSON_AddNumberToObject(item, "p50", histogram->Percentile(50));
+            cJSON_AddNumberToObject(item, "p95", histogram->Percentile(95));
+            auto bounds = cJSON_CreateArray();
+            auto buckets = cJSON_CreateArray();
+            for (int i = 0; i <= histogram->bound_count_; i++) {
+                if (i < histogram->bound_count_) {
+                    cJSON_AddItemToArray(bounds, cJSON_CreateNumber(histogram->bounds_[i]));
+                }
+                cJSON_AddItemToArray(buckets, cJSON_CreateNumber(histogram->buckets_[i].load(std::memory_order_relaxed)));
+            }
+            cJSON_AddItemToObject(item, "le", bounds);
+            cJSON_AddItemToObject(item, "buckets", buckets);
+            cJSON_AddItemToObject(histograms, metric->name_, item);
+        }
+    }
+    cJSON_AddItemToObject(root, "counters", counters);
+    cJSON_AddItemToObject(root, "gauges", gauges);
+    cJSON_AddItemToObject(root, "histograms", histograms);
+
+    auto tasks = cJSON_CreateArray();
+    for (auto& usage : top_tasks_) {
+        auto item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "name", usage.name);
+        if (usage.core != 0xFF) {
+            cJSON_AddNumberToObject(item, "core", usage.core);
+        }
+        cJSON_AddNumberToObject(item, "cpu", usage.cpu_percent);
+        cJSON_AddItemToArray(tasks, item);
+    }
+    cJSON_AddItemToObject(root, "tasks", tasks);
+
+    // 所有任务的栈剩余，从少到多
+    auto stacks = cJSON_CreateArray();
+    for (auto& stack : stacks_) {
+        auto item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "name", stack.name);
+        cJSON_AddNumberToObject(item, "free", stack.free_bytes);
+        if (stack.psram) {
+            cJSON_AddBoolToObject(item, "psram", true);
+        }
+        cJSON_AddItemToArray(stacks, item);
+    }
+    cJSON_AddItemToObject(root, "stacks", stacks);
+
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
+}
+
+uint32_t Metrics::WindowPercentile(const MetricHistogram* histogram, const uint32_t* buckets, uint32_t total, int percent) {
+    uint32_t target = (total * percent + 99) / 100;
+    uint32_t seen = 0;
+    for (int i = 0; i < histogram->bound_count_; i++) {
+        seen += buckets[i];
+        if (seen >= target) {
+            return histogram->bounds_[i];
+        }
+    }
+    // 最后一个桶没有上界，用历史最大值代替
+    return histogram->max();
+}
+
+std::string Metrics::Profile(int seconds, int top_tasks) {
+    struct HistogramStart {
+        MetricHistogram* histogram;
+        uint32_t buckets[MetricHistogram::kMaxBounds + 1];
+    };
+    struct GaugeRange {
+        MetricGauge* gauge;
+        int32_t min;
+        int32_t max;
+    };
+    struct HeapRange {
+        uint32_t min_free;
+        uint32_t min_largest;
+    };
+
+    std::vector<HistogramStart> histograms;
+    std::vector<GaugeRange> queues;
+    for (Metric* metric = head_.load(std::memory_order_acquire); metric != nullptr; metric = metric->next_) {
+        if (metric->type_ == kMetricHistogram) {
+            auto histogram = static_cast<MetricHistogram*>(metric);
+            HistogramStart start = {histogram, {}};
+            for (int i = 0; i <= histogram->bound_count_; i++) {
+                start.buckets[i] = histogram->buckets_[i].load(std::memory_order_relaxed);
+            }
+            histograms.push_back(start);
+        } else if (metric->type_ == kMetricGauge && strstr(metric->name_, "queue") != nullptr) {
+            auto gauge = static_cast<MetricGauge*>(metric);
+            queues.push_back({gauge, gauge->value(), gauge->value()});
+        }
+    }
+    constexpr size_t heap_count = sizeof(heap_metrics) / sizeof(heap_metrics[0]);
+    HeapRange heaps[heap_count];
+    for (size_t i = 0; i < heap_count; i++) {
+        heaps[i] = {UINT32_MAX, UINT32_MAX};
+    }
+
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    UBaseType_t start_capacity = uxTaskGetNumberOfTasks() + 4;
+    auto start_tasks = (TaskStatus_t*)malloc(sizeof(TaskStatus_t) * start_capacity);
+    configRUN_TIME_COUNTER_TYPE start_runtime = 0;
+    UBaseType_t start_count = 0;
+    if (start_tasks != nullptr) {
+        start_count = uxTaskGetSystemState(start_tasks, start_capacity, &start_runtime);
+    }
+#endif
+
+    int64_t start_us = esp_timer_get_time();
+    int64_t deadline = start_us + seconds * 1000000LL;
+    do {
+        for (size_t i = 0; i < heap_count; i++) {
+            heaps[i].min_free = std::min<uint32_t>(heaps[i].min_free, heap_caps_get_free_size(heap_metrics[i].caps));
+            heaps[i].min_largest = std::min<uint32_t>(heaps[i].min_largest, heap_caps_get_largest_free_block(heap_metrics[i].caps));
+        }
+        for (auto& queue : queues) {
+            int32_t value = queue.gauge->value();
+            queue.min = std::min(queue.min, value);
+            queue.max = std::max(queue.max, value);
+        }
+        vTaskDelay(pdMS_TO_TICKS(PROFILE_SAMPLE_MS));
+    } while (esp_timer_get_time() < deadline);
+
+    auto root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "window_ms", (esp_timer_get_time() - start_us) / 1000);
+
+    auto tasks = cJSON_CreateArray();
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    UBaseType_t end_capacity = uxTaskGetNumberOfTasks() + 4;
+    auto end_tasks = (TaskStatus_t*)malloc(sizeof(TaskStatus_t) * end_capacity);
+    if (start_tasks != nullptr && end_tasks != nullptr) {
+        configRUN_TIME_COUNTER_TYPE end_runtime = 0;
+        UBaseType_t end_count = uxTaskGetSystemState(end_tasks, end_capacity, &end_runtime);
+        uint32_t elapsed = (end_runtime - start_runtime) * CONFIG_FREERTOS_NUMBER_OF_CORES;
+        std::vector<TaskUsage> usages;
+        for (UBaseType_t i = 0; i < end_count && elapsed > 0; i++) {
+            auto& task = end_tasks[i];
+            // 窗口内新建的任务从 0 开始算
+            uint32_t previous = 0;
+            for (UBaseType_t j = 0; j < start_count; j++) {
+                if (start_tasks[j].xHandle == task.xHandle) {
+                    previous = start_tasks[j].ulRunTimeCounter;
+                    break;
+                }
+            }
+            TaskUsage usage = {};
+            strncpy(usage.name, task.pcTaskName, sizeof(usage.name) - 1);
+#if CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+            usage.core = task.xCoreID == tskNO_AFFINITY ? 0xFF : task.xCoreID;
+#else
+            usage.core = 0xFF;
+#endif
+            usage.cpu_percent = std::min<uint64_t>(100, (uint64_t)(task.ulRunTimeCounter - previous) * 100 / elapsed);
+            usages.push_back(usage);
+        }
+        std::sort(usages.begin(), usages.end(), [](const TaskUsage& a, const TaskUsage& b) {
+            return a.cpu_percent > b.cpu_percent;
+        });
+        for (int i = 0; i < (int)usages.size() && i < top_tasks; i++) {
+            auto item = cJSON_CreateObject();
+            cJSON_AddStringToObject(item, "name", usages[i].name);
+            if (usages[i].core != 0xFF) {
+                cJSON_AddNumberToObject(item, "core", usages[i].core);
+            }
+            cJSON_AddNumberToObject(item, "cpu", usages[i].cpu_percent);
+            cJSON_AddItemToArray(tasks, item);
+        }
+    }
+    free(start_tasks);
+    free(end_tasks);
+#endif
+    cJSON_AddItemToObject(root, "tasks", tasks);
+
+    static const char* heap_names[] = {"internal", "spiram", "dma"};
+    auto heap = cJSON_CreateObject();
+    for (size_t i = 0; i < heap_count; i++) {
+        if (heap_caps_get_total_size(heap_metrics[i].caps) == 0) {
+            continue;
+        }
+        auto item = cJSON_CreateObject();
+        cJSON_AddNumberToObject(item, "min_free", heaps[i].min_free);
+        cJSON_AddNumberToObject(item, "min_largest", heaps[i].min_largest);
+        cJSON_AddItemToObject(heap, heap_names[i], item);
+    }
+    cJSON_AddItemToObject(root, "heap", heap);
+
+    auto queue_json = cJSON_CreateObject();
+    for (auto& queue : queues) {
+        auto item = cJSON_CreateArray();
+        cJSON_AddItemToArray(item, cJSON_CreateNumber(queue.min));
+        cJSON_AddItemToArray(item, cJSON_CreateNumber(queue.max));
+        cJSON_AddItemToObject(queue_json, queue.gauge->name_, item);
+    }
+    cJSON_AddItemToObject(root, "queues", queue_json);
+
+    // 只列出窗口内有记录的直方图，分位数按桶上界估算
+    auto histogram_json = cJSON_CreateObject();
+    for (auto& start : histograms) {
+        auto histogram = start.histogram;
+        uint32_t buckets[MetricHistogram::kMaxBounds + 1];
+        uint32_t total = 0;
+        for (int i = 0; i <= histogram->bound_count_; i++) {
+            buckets[i] = histogram->buckets_[i].load(std::memory_order_relaxed) - start.buckets[i];
+            total += buckets[i];
+        }
+        if (total == 0) {
+            continue;
+        }
+        auto item = cJSON_CreateObject();
+        cJSON_AddNumberToObject(item, "count", total);
+        cJSON_AddNumberToObject(item, "p50", WindowPercentile(histogram, buckets, total, 50));
+        cJSON_AddNumberToObject(item, "p95", WindowPercentile(histogram, buckets, total, 95));
+        cJSON_AddNumberToObject(item, "p99", WindowPercentile(histogram, buckets, total, 99));
+        cJSON_AddItemToObject(histogram_json, histogram->name_, item);
+    }
+    cJSON_AddItemToObject(root, "histograms", histogram_json);
+
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
+}
+
+bool Metrics::GetTopTask(char* name, size_t size, uint8_t& cpu_percent) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (top_tasks_.empty()) {
+        return false;
+    }
+    strlcpy(name, top_tasks_[0].name, size);
+    cpu_percent = top_tasks_[0].cpu_percent;
+    return true;
+}
+
+cJSON* Metrics::CreateSummaryJson() {
+    auto system = cJSON_CreateObject();
+    cJSON_AddNumberToObject(system, "uptime_s", esp_timer_get_time() / 1000000);
+    cJSON_AddNumberToObject(system, "free_sram_kb", heap_caps_get_free_size(MALLOC_CAP_INTERNAL) / 1024);
+    cJSON_AddNumberToObject(system, "min_free_sram_kb", heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL) / 1024);
+    size_t psram = heap_caps_get_total_size(MALLOC_CAP_SPIRAM);
+    if (psram > 0) {
+        cJSON_AddNumberToObject(system, "free_psram_kb", heap_caps_get_free_size(MALLOC_CAP_SPIRAM) / 1024);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& usage : top_tasks_) {
+        if (strncmp(usage.name, "IDLE", 4) != 0) {
+            cJSON_AddStringToObject(system, "busiest_task", usage.name);
+            cJSON_AddNumberToObject(system, "busiest_task_cpu", usage.cpu_percent);
+            break;
+        }
+    }
+    return system;
+}
@@ -0,0 +1,155 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <cJSON.h>
+
+// 运行指标：计数器、瞬时值和固定分桶的直方图
+// 指标定义为静态变量，构造时登记到 Metrics；更新只有原子操作，可以在任何任务中调用
+// 名字需要是字符串常量，按 "模块.名字" 命名
+
+enum MetricType {
+    kMetricCounter,
+    kMetricGauge,
+    kMetricHistogram,
+};
+
+class Metric {
+public:
+    const char* name() const { return name_; }
+    MetricType type() const { return type_; }
+
+protected:
+    Metric(const char* name, MetricType type);
+
+private:
+    friend class Metrics;
+    const char* name_;
+    MetricType type_;
+    Metric* next_ = nullptr;
+    int slot_ = -1;     // 在采样快照中的位置，由 Metrics 分配
+};
+
+class MetricCounter : public Metric {
+public:
+    explicit MetricCounter(const char* name) : Metric(name, kMetricCounter) {}
+
+    void Add(uint32_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint32_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint32_t> value_{0};
+};
+
+class MetricGauge : public Metric {
+public:
+    explicit MetricGauge(const char* name) : Metric(name, kMetricGauge) {}
+
+    void Set(int32_t value) { value_.store(value, std::memory_order_relaxed); }
+    int32_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int32_t> value_{0};
+};
+
+// bounds 是递增的桶上界（包含），最后一个桶收集超过所有上界的值
+class MetricHistogram : public Metric {
+public:
+    static constexpr int kMaxBounds = 10;
+
+    MetricHistogram(const char* name, std::initializer_list<uint32_t> bounds);
+
+    void Record(uint32_t value);
+    uint32_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint32_t max() const { return max_.load(std::memory_order_relaxed); }
+    // 按分桶估算的分位数，返回所在桶的上界
+    uint32_t Percentile(int percent) const;
+
+private:
+    friend class Metrics;
+    int bound_count_ = 0;
+    uint32_t bounds_[kMaxBounds];
+    std::atomic<uint32_t> buckets_[kMaxBounds + 1] = {};
+    std::atomic<uint32_t> count_{0};
+    std::atomic<uint32_t> max_{0};
+};
+
+// 耗时直方图常用的分桶，单位微秒
+#define METRIC_DURATION_US_BOUNDS {250, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000}
+// 网络发送和模组命令的耗时分桶，单位微秒
+#define METRIC_NETWORK_US_BOUNDS {1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000}
+
+class Metrics {
+public:
+    static Metrics& GetInstance() {
+        static Metrics instance;
+        return instance;
+    }
+
+    // 由时钟定时器定期调用：更新堆和任务 CPU 指标，在采样环中保存计数器和瞬时值的快照
+    void Sample();
+    // 全部指标，计数器带最近采样窗口内的增量，瞬时值带窗口内的最小最大值
+    std::string GetJson();
+    // 放进设备状态 JSON 的简要信息
+    cJSON* CreateSummaryJson();
+    // 在调用者的任务中阻塞 seconds 秒，统计这段时间内各任务的 CPU 占用（前 top_tasks 个）、
+    // 各类堆和队列深度的最小最大值，以及直方图在这段时间内的分位数，返回紧凑的 JSON
+    std::string Profile(int seconds, int top_tasks);
+    // 最近一次采样窗口内所有核的平均 CPU 占用百分比，还没有采样时为 -1
+    int cpu_load_percent() const { return cpu_load_percent_.load(std::memory_order_relaxed); }
+    // 最近一次采样中 CPU 占用最高的任务，还没有采样时返回 false
+    bool GetTopTask(char* name, size_t size, uint8_t& cpu_percent);
+
+    static void Register(Metric* metric);
+
+private:
+    static constexpr int kRingSize = 30;
+    static constexpr int kTopTasks = 8;
+
+    struct Snapshot {
+        int64_t time_us = 0;
+        std::vector<int32_t> values;
+    };
+
+    struct TaskUsage {
+        char name[16];
+        uint8_t core;
+        uint8_t cpu_percent;
+    };
+
+    // 任务栈历史最少剩余字节数，用来调整各任务的栈大小
+    struct StackUsage {
+        char name[16];
+        uint32_t free_bytes;
+        bool psram;
+    };
+
+    static std::atomic<Metric*> head_;
+    std::atomic<int> cpu_load_percent_{-1};
+
+    std::mutex mutex_;
+    Snapshot ring_[kRingSize];
+    int ring_count_ = 0;
+    int ring_next_ = 0;
+    int slot_count_ = 0;
+    std::vector<TaskUsage> top_tasks_;
+    std::vector<StackUsage> stacks_;
+    // 上次采样时每个任务的运行时间，用来计算 CPU 占用
+    std::vector<std::pair<void*, uint32_t>> task_runtime_;
+    uint32_t last_total_runtime_ = 0;
+
+    Metrics() = default;
+    void SampleHeap();
+    void SampleTasks();
+    static uint32_t WindowPercentile(const MetricHistogram* histogram, const uint32_t* buckets, uint32_t total, int percent);
+    const Snapshot* Oldest() const;
+    const Snapshot* Newest() const;
+};
+
+#endif // METRICS_H
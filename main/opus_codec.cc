@@ -0,0 +1,118 @@
+#include "opus_codec.h"
+
+#include <esp_log.h>
+#include <opus.h>
+
+#define TAG "OpusCodec"
+
+// 一帧 Opus 的最大字节数，和 OpusEncoderWrapper 相同
+#define OPUS_MAX_PACKET_SIZE 1500
+
+OpusStreamEncoder::OpusStreamEncoder(int sample_rate, int channels, int duration_ms)
+    : sample_rate_(sample_rate), channels_(channels), duration_ms_(duration_ms), frame_size_(sample_rate / 1000 * duration_ms) {
+    int error;
+    encoder_ = opus_encoder_create(sample_rate, channels, OPUS_APPLICATION_VOIP, &error);
+    if (encoder_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to create audio encoder, error code: %d", error);
+        return;
+    }
+    // 和 OpusEncoderWrapper 的默认值一致：自动码率，DTX 打开，复杂度 0
+    opus_encoder_ctl(encoder_, OPUS_SET_BITRATE(OPUS_AUTO));
+    opus_encoder_ctl(encoder_, OPUS_SET_DTX(1));
+    opus_encoder_ctl(encoder_, OPUS_SET_COMPLEXITY(0));
+}
+
+OpusStreamEncoder::~OpusStreamEncoder() {
+    if (encoder_ != nullptr) {
+        opus_encoder_destroy(encoder_);
+    }
+}
+
+void OpusStreamEncoder::SetComplexity(int complexity) {
+    if (encoder_ != nullptr) {
+        opus_encoder_ctl(encoder_, OPUS_SET_COMPLEXITY(complexity));
+    }
+}
+
+void OpusStreamEncoder::SetDtx(bool enable) {
+    if (encoder_ != nullptr) {
+        opus_encoder_ctl(encoder_, OPUS_SET_DTX(enable ? 1 : 0));
+    }
+}
+
+void OpusStreamEncoder::SetInbandFec(bool enable) {
+    if (encoder_ != nullptr) {
+        opus_encoder_ctl(encoder_, OPUS_SET_INBAND_FEC(enable ? 1 : 0));
+    }
+}
+
+void OpusStreamEncoder::SetPacketLossPercent(int percent) {
+    if (encoder_ != nullptr) {
+        opus_encoder_ctl(encoder_, OPUS_SET_PACKET_LOSS_PERC(percent));
+    }
+}
+
+void OpusStreamEncoder::ResetState() {
+    if (encoder_ != nullptr) {
+        opus_encoder_ctl(encoder_, OPUS_RESET_STATE);
+    }
+}
+
+bool OpusStreamEncoder::Encode(std::vector<int16_t>&& pcm, std::vector<uint8_t>& opus) {
+    if (encoder_ == nullptr || (int)pcm.size() != frame_size_ * channels_) {
+        return false;
+    }
+    opus.resize(OPUS_MAX_PACKET_SIZE);
+    int ret = opus_encode(encoder_, pcm.data(), frame_size_, opus.data(), opus.size());
+    if (ret < 0) {
+        ESP_LOGE(TAG, "Failed to encode audio, error code: %d", ret);
+        opus.clear();
+        return false;
+    }
+    opus.resize(ret);
+    return true;
+}
+
+OpusStreamDecoder::OpusStreamDecoder(int sample_rate, int channels, int duration_ms)
+    : sample_rate_(sample_rate), channels_(channels), duration_ms_(duration_ms), frame_size_(sample_rate / 1000 * duration_ms) {
+    int error;
+    decoder_ = opus_decoder_create(sample_rate, channels, &error);
+    if (decoder_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to create audio decoder, error code: %d", error);
+    }
+}
+
+OpusStreamDecoder::~OpusStreamDecoder() {
+    if (decoder_ != nullptr) {
+        opus_decoder_destroy(decoder_);
+    }
+}
+
+bool OpusStreamDecoder::Decode(std::vector<uint8_t>&& opus, std::vector<int16_t>& pcm) {
+    return DecodeInto(opus.empty() ? nullptr : opus.data(), opus.size(), false, pcm);
+}
+
+bool OpusStreamDecoder::DecodeFec(const std::vector<uint8_t>& next, std::vector<int16_t>& pcm) {
+    return DecodeInto(next.empty() ? nullptr : next.data(), next.size(), true, pcm);
+}
+
+bool OpusStreamDecoder::DecodeInto(const uint8_t* data, size_t size, bool fec, std::vector<int16_t>& pcm) {
+    if (decoder_ == nullptr) {
+        return false;
+    }
+    pcm.resize(frame_size_ * channels_);
+    // FEC 和丢包补偿都必须按完整的帧长解码
+    int ret = opus_decode(decoder_, data, size, pcm.data(), frame_size_, fec ? 1 : 0);
+    if (ret < 0) {
+        ESP_LOGE(TAG, "Failed to decode audio, error code: %d", ret);
+        return false;
+    }
+    pcm.resize(ret * channels_);
+    return true;
+}
+
+void OpusStreamDecoder::ResetState() {
+    if (decoder_ != nullptr) {
+        opus_decoder_ctl(decoder_, OPUS_RESET_STATE);
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef OPUS_CODEC_H
+#define OPUS_CODEC_H
+
+#include <cstdint>
+#include <vector>
+
+struct OpusEncoder;
+struct OpusDecoder;
+
+// 直接使用 libopus 的编解码器，在 OpusEncoderWrapper/OpusDecoderWrapper 的基础上提供带内 FEC（LBRR）
+// 接口和原来的封装一致，只用于上行编码和 TTS 解码；只在一个任务中使用，不加锁
+
+class OpusStreamEncoder {
+public:
+    OpusStreamEncoder(int sample_rate, int channels, int duration_ms);
+    ~OpusStreamEncoder();
+
+    int sample_rate() const { return sample_rate_; }
+    int duration_ms() const { return duration_ms_; }
+
+    void SetComplexity(int complexity);
+    void SetDtx(bool enable);
+    // 打开后每一包里附带上一帧的低码率冗余，接收方丢了一包时可以从下一包恢复
+    void SetInbandFec(bool enable);
+    // 预期的丢包率，编码器据此分配冗余的码率
+    void SetPacketLossPercent(int percent);
+    void ResetState();
+    // pcm 必须正好是一帧
+    bool Encode(std::vector<int16_t>&& pcm, std::vector<uint8_t>& opus);
+
+private:
+    OpusEncoder* encoder_ = nullptr;
+    int sample_rate_;
+    int channels_;
+    int duration_ms_;
+    // 每个通道的采样数
+    int frame_size_;
+};
+
+class OpusStreamDecoder {
+public:
+    OpusStreamDecoder(int sample_rate, int channels, int duration_ms);
+    ~OpusStreamDecoder();
+
+    int sample_rate() const { return sample_rate_; }
+    int duration_ms() const { return duration_ms_; }
+
+    // 空负载做丢包补偿
+    bool Decode(std::vector<uint8_t>&& opus, std::vector<int16_t>& pcm);
+    // 用丢失帧的下一包里的冗余恢复丢失的那一帧，下一包没有冗余时 libopus 退化为丢包补偿
+    bool DecodeFec(const std::vector<uint8_t>& next, std::vector<int16_t>& pcm);
+    void ResetState();
+
+private:
+    OpusDecoder* decoder_ = nullptr;
+    int sample_rate_;
+    int channels_;
+    int duration_ms_;
+    // 每个通道的采样数
+    int frame_size_;
+
+    bool DecodeInto(const uint8_t* data, size_t size, bool fec, std::vector<int16_t>& pcm);
+};
+
+#endif // OPUS_CODEC_H
@@ -1,6 +1,15 @@
 #include "ota.h"
 #include "system_info.h"
 #include "settings.h"
+#include "json_arena.h"
+#include "heap_accounting.h"
+#include "ota_delta.h"
+#include "ota_lzss.h"
+#include "flash_guard.h"
+#include "performance_profile.h"
+#if CONFIG_CRASH_RING
+#include "crash_ring.h"
+#endif
 #include "assets/lang_config.h"
 
 #include <cJSON.h>
@@ -10,10 +19,18 @@
 #include <esp_app_format.h>
 #include <esp_efuse.h>
 #include <esp_efuse_table.h>
+#include <esp_heap_caps.h>
+#include <esp_rom_crc.h>
+#include <spi_flash_mmu.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
 #ifdef SOC_HMAC_SUPPORTED
 #include <esp_hmac.h>
 #endif
 
+#include <atomic>
 #include <cstring>
 #include <vector>
 #include <sstream>
@@ -67,6 +84,42 @@ Http* Ota::SetupHttp() {
     return http;
 }
 
+// 按 Content-Length 一次分配，chunked 响应没有长度时按块读取再扩容
+static const char* ReadBody(Http* http, JsonArena& arena, size_t& length) {
+    size_t capacity = http->GetBodyLength();
+    bool known_length = capacity > 0;
+    if (!known_length) {
+        capacity = 1024;
+    }
+    char* buffer = arena.Allocate(capacity);
+    length = 0;
+    while (buffer != nullptr) {
+        if (length == capacity) {
+            if (known_length) {
+                break;
+            }
+            // 旧缓冲区留在 arena 中，随 arena 一起释放
+            char* larger = arena.Allocate(capacity * 2);
+            if (larger == nullptr) {
+                return nullptr;
+            }
+            memcpy(larger, buffer, length);
+            buffer = larger;
+            capacity *= 2;
+        }
+        int ret = http->Read(buffer + length, capacity - length);
+        if (ret < 0) {
+            ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
+            return nullptr;
+        }
+        if (ret == 0) {
+            break;
+        }
+        length += ret;
+    }
+    return buffer;
+}
+
 /* 
  * Specification: https://ccnphfhqs21z.feishu.cn/wiki/FjW6wZmisimNBBkov6OcmfvknVd
  */
@@ -85,6 +138,19 @@ bool Ota::CheckVersion() {
     }
 
     auto http = std::unique_ptr<Http>(SetupHttp());
+#if CONFIG_USE_OTA_CONFIG_CACHE
+    // 服务器的响应没有变化时回复 304，设备直接使用缓存的响应
+    std::string cached_etag;
+    {
+        Settings settings("ota_cache");
+        if (!settings.GetString("body").empty()) {
+            cached_etag = settings.GetString("etag");
+        }
+    }
+    if (!cached_etag.empty()) {
+        http->SetHeader("If-None-Match", cached_etag);
+    }
+#endif
 
     std::string data = board.GetJson();
     std::string method = data.length() > 0 ? "POST" : "GET";
@@ -96,19 +162,83 @@ bool Ota::CheckVersion() {
     }
 
     auto status_code = http->GetStatusCode();
+#if CONFIG_CRASH_RING
+    if (status_code == 200 || status_code == 304) {
+        CrashRing::GetInstance().ClearReport();
+    }
+#endif
+#if CONFIG_USE_OTA_CONFIG_CACHE
+    if (status_code == 304 && !cached_etag.empty()) {
+        http->Close();
+        ESP_LOGI(TAG, "Check version response not modified");
+        return LoadCachedResponse();
+    }
+#endif
     if (status_code != 200) {
         ESP_LOGE(TAG, "Failed to check version, status code: %d", status_code);
         return false;
     }
 
-    data = http->ReadAll();
+    // body 直接读进 arena 再原地解析，不经过 std::string，整棵树在函数返回时一次释放
+    JsonArena arena(JSON_ARENA_BLOCK_SIZE, kHeapTagOta);
+    size_t length = 0;
+    const char* body = ReadBody(http.get(), arena, length);
+    std::string etag = http->GetResponseHeader("ETag");
     http->Close();
+    if (body == nullptr) {
+        ESP_LOGE(TAG, "Failed to read check version response");
+        return false;
+    }
+
+    if (!ParseResponse(arena, body, length, false)) {
+        return false;
+    }
+#if CONFIG_USE_OTA_CONFIG_CACHE
+    SaveCachedResponse(body, length, etag);
+#endif
+    return true;
+}
+
+// 缓存上次的响应，下次启动时先用缓存的配置连接服务器
+// NVS 字符串最长约 4000 字节，更长的响应不缓存
+void Ota::SaveCachedResponse(const char* body, size_t length, const std::string& etag) {
+    if (length >= 4000) {
+        return;
+    }
+    std::string value(body, length);
+    Settings settings("ota_cache", true);
+    if (settings.GetString("body") != value) {
+        settings.SetString("body", value);
+    }
+    if (settings.GetString("etag") != etag) {
+        settings.SetString("etag", etag);
+    }
+}
 
-    // Response: { "firmware": { "version": "1.0.0", "url": "http://" } }
+bool Ota::LoadCachedResponse() {
+    std::string body;
+    {
+        Settings settings("ota_cache");
+        body = settings.GetString("body");
+    }
+    if (body.empty()) {
+        return false;
+    }
+    current_version_ = esp_app_get_description()->version;
+    JsonArena arena(JSON_ARENA_BLOCK_SIZE, kHeapTagOta);
+    return ParseResponse(arena, body.data(), body.size(), true);
+}
+
+// cached 为 true 时是 NVS 中缓存的响应，其中的服务器时间已经过期，不再设置
+bool Ota::ParseResponse(JsonArena& arena, const char* body, size_t length, bool cached) {
+    // Response: { "firmware": { "version": "1.0.0", "url": "http://",
+    //     "delta": { "from": "0.9.0", "url": "http://" },
+    //     "compressed": { "type": "lzss", "window": 12, "lookahead": 5, "url": "http://" } } }
     // Parse the JSON response and check if the version is newer
     // If it is, set has_new_version_ to true and store the new version and URL
     
-    cJSON *root = cJSON_Parse(data.c_str());
+    cJSON *root = arena.Parse(body, length);
+    ESP_LOGD(TAG, "Check version response: %u bytes, arena %u/%u bytes", length, arena.used(), arena.capacity());
     if (root == NULL) {
         ESP_LOGE(TAG, "Failed to parse JSON response");
         return false;
@@ -180,9 +310,14 @@ bool Ota::CheckVersion() {
         ESP_LOGI(TAG, "No websocket section found!");
     }
 
+    // 没有 performance 段时恢复默认参数，实验结束后设备自动回到默认配置
+    PerformanceProfile::GetInstance().Update(cJSON_GetObjectItem(root, "performance"));
+
     has_server_time_ = false;
     cJSON *server_time = cJSON_GetObjectItem(root, "server_time");
-    if (cJSON_IsObject(server_time)) {
+    if (cached) {
+        // 缓存中的时间已经过期
+    } else if (cJSON_IsObject(server_time)) {
         cJSON *timestamp = cJSON_GetObjectItem(server_time, "timestamp");
         cJSON *timezone_offset = cJSON_GetObjectItem(server_time, "timezone_offset");
         
@@ -216,6 +351,31 @@ bool Ota::CheckVersion() {
         if (cJSON_IsString(url)) {
             firmware_url_ = url->valuestring;
         }
+        // 可选的压缩固件，参数见 ota_lzss.h
+        firmware_compressed_url_.clear();
+        cJSON *compressed = cJSON_GetObjectItem(firmware, "compressed");
+        if (cJSON_IsObject(compressed)) {
+            cJSON *compressed_url = cJSON_GetObjectItem(compressed, "url");
+            cJSON *type = cJSON_GetObjectItem(compressed, "type");
+            cJSON *window = cJSON_GetObjectItem(compressed, "window");
+            cJSON *lookahead = cJSON_GetObjectItem(compressed, "lookahead");
+            if (cJSON_IsString(compressed_url) && cJSON_IsString(type) && strcmp(type->valuestring, "lzss") == 0
+                && cJSON_IsNumber(window) && cJSON_IsNumber(lookahead)) {
+                firmware_compressed_url_ = compressed_url->valuestring;
+                compressed_window_bits_ = window->valueint;
+                compressed_lookahead_bits_ = lookahead->valueint;
+            }
+        }
+        // 可选的差分补丁，"from" 是补丁对应的源版本，与当前版本不同时忽略
+        firmware_delta_url_.clear();
+        cJSON *delta = cJSON_GetObjectItem(firmware, "delta");
+        if (cJSON_IsObject(delta)) {
+            cJSON *delta_url = cJSON_GetObjectItem(delta, "url");
+            cJSON *from = cJSON_GetObjectItem(delta, "from");
+            if (cJSON_IsString(delta_url) && (!cJSON_IsString(from) || current_version_ == from->valuestring)) {
+                firmware_delta_url_ = delta_url->valuestring;
+            }
+        }
 
         if (cJSON_IsString(version) && cJSON_IsString(url)) {
             // Check if the version is newer, for example, 0.1.0 is newer than 0.0.1
@@ -235,7 +395,6 @@ bool Ota::CheckVersion() {
         ESP_LOGW(TAG, "No firmware section found!");
     }
 
-    cJSON_Delete(root);
     return true;
 }
 
@@ -259,119 +418,673 @@ void Ota::MarkCurrentVersionValid() {
     }
 }
 
-void Ota::Upgrade(const std::string& firmware_url) {
+namespace {
+
+#define OTA_MAX_ATTEMPTS 5
+// 每写入这么多数据保存一次断点
+#define OTA_RESUME_SAVE_INTERVAL (64 * 1024)
+
+// 断点续传状态，保存在 NVS 的 ota_resume 中
+// url 和 address 用来确认是同一个固件包和同一个分区，offset 之前的数据已经写入 flash，crc 是这部分数据的 CRC32
+struct OtaResumeState {
+    uint32_t url_crc = 0;
+    uint32_t address = 0;
+    size_t size = 0;
+    size_t offset = 0;
+    uint32_t crc = 0;
+
+    void Load() {
+        Settings settings("ota_resume");
+        url_crc = (uint32_t)settings.GetInt("url");
+        address = (uint32_t)settings.GetInt("address");
+        size = settings.GetInt("size");
+        offset = settings.GetInt("offset");
+        crc = (uint32_t)settings.GetInt("crc");
+    }
+
+    void SaveImage() const {
+        Settings settings("ota_resume", true);
+        settings.SetInt("url", (int32_t)url_crc);
+        settings.SetInt("address", (int32_t)address);
+        settings.SetInt("size", size);
+        settings.SetInt("offset", offset);
+        settings.SetInt("crc", (int32_t)crc);
+    }
+
+    static void SaveProgress(size_t offset, uint32_t crc) {
+        Settings settings("ota_resume", true);
+        settings.SetInt("offset", offset);
+        settings.SetInt("crc", (int32_t)crc);
+    }
+
+    static void Clear() {
+        Settings settings("ota_resume", true);
+        settings.EraseAll();
+    }
+};
+
+// 下载和写 flash 流水线：当前任务填充缓冲区，ota_writer 任务写入分区
+// 有 PSRAM 时用 3 块 16KB 缓冲区，否则用 2 块 4KB 的内部 RAM
+// 按偏移写入，每块写入前先擦除对应的扇区，续传时从断点继续写
+class OtaWritePipeline {
+public:
+    struct Chunk {
+        uint8_t* data;
+        size_t size;    // 0 表示结束
+    };
+
+    ~OtaWritePipeline() {
+        if (free_queue_ != nullptr) {
+            vQueueDelete(free_queue_);
+        }
+        if (filled_queue_ != nullptr) {
+            vQueueDelete(filled_queue_);
+        }
+        if (done_ != nullptr) {
+            vSemaphoreDelete(done_);
+        }
+        for (auto buffer : buffers_) {
+            HeapAccounting::Free(kHeapTagOta, buffer);
+        }
+    }
+
+    bool Initialize(const esp_partition_t* partition) {
+        partition_ = partition;
+        buffer_size_ = 16 * 1024;
+        int count = 3;
+        if (heap_caps_get_free_size(MALLOC_CAP_SPIRAM) < buffer_size_ * count * 2) {
+            buffer_size_ = 4 * 1024;
+            count = 2;
+        }
+        free_queue_ = xQueueCreate(count, sizeof(uint8_t*));
+        filled_queue_ = xQueueCreate(count + 1, sizeof(Chunk));
+        done_ = xSemaphoreCreateBinary();
+        if (free_queue_ == nullptr || filled_queue_ == nullptr || done_ == nullptr) {
+            return false;
+        }
+        for (int i = 0; i < count; i++) {
+            auto buffer = (uint8_t*)HeapAccounting::MallocPreferSpiram(kHeapTagOta, buffer_size_);
+            if (buffer == nullptr) {
+                return false;
+            }
+            buffers_.push_back(buffer);
+            xQueueSend(free_queue_, &buffer, 0);
+        }
+        ESP_LOGI(TAG, "OTA pipeline: %d x %u bytes", count, buffer_size_);
+        return true;
+    }
+
+    size_t buffer_size() const { return buffer_size_; }
+    // 等待空闲缓冲区的时间，即网络快于 flash 的时间
+    int64_t writer_stall_us() const { return writer_stall_us_; }
+    // 写入任务等待数据的时间，即 flash 快于网络的时间
+    int64_t network_stall_us() const { return network_stall_us_; }
+    esp_err_t error() const { return error_; }
+
+    // 读回已写入的数据，和保存的 CRC 比较
+    bool Verify(size_t size, uint32_t expected_crc) {
+        uint8_t* buffer = AcquireBuffer();
+        uint32_t crc = 0;
+        bool ok = true;
+        for (size_t offset = 0; offset < size; offset += buffer_size_) {
+            size_t length = std::min(buffer_size_, size - offset);
+            if (esp_partition_read(partition_, offset, buffer, length) != ESP_OK) {
+                ok = false;
+                break;
+            }
+            crc = esp_rom_crc32_le(crc, buffer, length);
+        }
+        ReleaseBuffer(buffer);
+        writer_stall_us_ = 0;
+        return ok && crc == expected_crc;
+    }
+
+    // 从 offset 开始写入，crc 是 offset 之前数据的 CRC32
+    // save_progress 为 true 时定期把写入位置保存为断点
+    void Start(esp_ota_handle_t handle, size_t offset, uint32_t crc, bool save_progress, UBaseType_t priority) {
+        handle_ = handle;
+        save_progress_ = save_progress;
+        offset_ = offset;
+        saved_offset_ = offset;
+        crc_ = crc;
+        started_ = true;
+        xTaskCreate([](void* arg) {
+            auto self = static_cast<OtaWritePipeline*>(arg);
+            self->WriterLoop();
+            vTaskDelete(NULL);
+        }, "ota_writer", 4096, this, priority, nullptr);
+    }
+
+    uint8_t* AcquireBuffer() {
+        uint8_t* buffer = nullptr;
+        auto start = esp_timer_get_time();
+        xQueueReceive(free_queue_, &buffer, portMAX_DELAY);
+        writer_stall_us_ += esp_timer_get_time() - start;
+        return buffer;
+    }
+
+    // 归还没有提交的缓冲区，例如读取中途断开的那一块
+    void ReleaseBuffer(uint8_t* buffer) {
+        xQueueSend(free_queue_, &buffer, portMAX_DELAY);
+    }
+
+    void Submit(uint8_t* data, size_t size) {
+        Chunk chunk = {data, size};
+        xQueueSend(filled_queue_, &chunk, portMAX_DELAY);
+    }
+
+    // 写入排队的数据后结束写入任务，返回第一个写入错误
+    esp_err_t Finish() {
+        if (!started_) {
+            return error_;
+        }
+        Chunk end = {nullptr, 0};
+        xQueueSend(filled_queue_, &end, portMAX_DELAY);
+        xSemaphoreTake(done_, portMAX_DELAY);
+        started_ = false;
+        return error_;
+    }
+
+private:
+    const esp_partition_t* partition_ = nullptr;
+    std::vector<uint8_t*> buffers_;
+    size_t buffer_size_ = 0;
+    QueueHandle_t free_queue_ = nullptr;
+    QueueHandle_t filled_queue_ = nullptr;
+    SemaphoreHandle_t done_ = nullptr;
+    esp_ota_handle_t handle_ = 0;
+    bool started_ = false;
+    bool save_progress_ = false;
+    std::atomic<esp_err_t> error_{ESP_OK};
+    int64_t writer_stall_us_ = 0;
+    std::atomic<int64_t> network_stall_us_{0};
+    // 以下只在写入任务中访问
+    size_t offset_ = 0;
+    size_t saved_offset_ = 0;
+    uint32_t crc_ = 0;
+
+    esp_err_t Write(const uint8_t* data, size_t size) {
+        // 断点之后的扇区可能有上次写了一半的数据，写入前重新擦除
+        size_t erase_size = (size + SPI_FLASH_SEC_SIZE - 1) / SPI_FLASH_SEC_SIZE * SPI_FLASH_SEC_SIZE;
+        // 擦除比 NVS 提交慢得多，播放中先等音频间隙，网络缓冲区够用所以只短暂等待
+        FlashGuard::GetInstance().WaitForGap(FLASH_GUARD_OTA_MAX_WAIT_MS);
+        FlashGuard::Scope scope(kFlashOpOta);
+        auto err = esp_partition_erase_range(partition_, offset_, erase_size);
+        if (err != ESP_OK) {
+            return err;
+        }
+        return esp_ota_write_with_offset(handle_, data, size, offset_);
+    }
+
+    void WriterLoop() {
+        while (true) {
+            Chunk chunk;
+            auto start = esp_timer_get_time();
+            xQueueReceive(filled_queue_, &chunk, portMAX_DELAY);
+            network_stall_us_ += esp_timer_get_time() - start;
+            if (chunk.size == 0) {
+                break;
+            }
+            // 出错后继续回收缓冲区，下载循环看到错误后停止
+            if (error_ == ESP_OK) {
+                auto err = Write(chunk.data, chunk.size);
+                if (err != ESP_OK) {
+                    ESP_LOGE(TAG, "Failed to write OTA data at 0x%x: %s", offset_, esp_err_to_name(err));
+                    error_ = err;
+                } else {
+                    crc_ = esp_rom_crc32_le(crc_, chunk.data, chunk.size);
+                    offset_ += chunk.size;
+                    if (save_progress_ && offset_ - saved_offset_ >= OTA_RESUME_SAVE_INTERVAL) {
+                        OtaResumeState::SaveProgress(offset_, crc_);
+                        saved_offset_ = offset_;
+                    }
+                }
+            }
+            xQueueSend(free_queue_, &chunk.data, portMAX_DELAY);
+        }
+        xSemaphoreGive(done_);
+    }
+};
+
+} // namespace
+
+// 校验镜像并设置启动分区，reboot 为 true 时成功后重启，否则返回 true，下次启动时生效
+static bool CompleteUpgrade(esp_ota_handle_t update_handle, const esp_partition_t* update_partition, bool reboot) {
+    esp_err_t err = esp_ota_end(update_handle);
+    if (err != ESP_OK) {
+        if (err == ESP_ERR_OTA_VALIDATE_FAILED) {
+            ESP_LOGE(TAG, "Image validation failed, image is corrupted");
+        } else {
+            ESP_LOGE(TAG, "Failed to end OTA: %s", esp_err_to_name(err));
+        }
+        return false;
+    }
+
+    err = esp_ota_set_boot_partition(update_partition);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set boot partition: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    if (!reboot) {
+        ESP_LOGI(TAG, "Firmware upgrade downloaded, it will be applied on next reboot");
+        return true;
+    }
+    ESP_LOGI(TAG, "Firmware upgrade successful, rebooting in 3 seconds...");
+    vTaskDelay(pdMS_TO_TICKS(3000));
+    esp_restart();
+    return true;
+}
+
+bool Ota::Upgrade(const std::string& firmware_url) {
     ESP_LOGI(TAG, "Upgrading firmware from %s", firmware_url.c_str());
     esp_ota_handle_t update_handle = 0;
     auto update_partition = esp_ota_get_next_update_partition(NULL);
     if (update_partition == NULL) {
         ESP_LOGE(TAG, "Failed to get update partition");
-        return;
+        return false;
     }
 
     ESP_LOGI(TAG, "Writing to partition %s at offset 0x%lx", update_partition->label, update_partition->address);
-    bool image_header_checked = false;
-    std::string image_header;
+    bool ota_started = false;
 
-    auto http = std::unique_ptr<Http>(Board::GetInstance().CreateHttp());
-    if (!http->Open("GET", firmware_url)) {
-        ESP_LOGE(TAG, "Failed to open HTTP connection");
-        return;
+    OtaWritePipeline pipeline;
+    if (!pipeline.Initialize(update_partition)) {
+        ESP_LOGE(TAG, "Failed to allocate OTA buffers");
+        return false;
     }
 
-    if (http->GetStatusCode() != 200) {
-        ESP_LOGE(TAG, "Failed to get firmware, status code: %d", http->GetStatusCode());
-        return;
+    // 同一个固件包在同一个分区上有断点，先校验 flash 中已写入的数据
+    OtaResumeState resume;
+    resume.Load();
+    uint32_t url_crc = esp_rom_crc32_le(0, (const uint8_t*)firmware_url.data(), firmware_url.size());
+    if (resume.url_crc != url_crc || resume.address != update_partition->address || resume.offset >= resume.size) {
+        resume = OtaResumeState();
+    } else if (!pipeline.Verify(resume.offset, resume.crc)) {
+        ESP_LOGW(TAG, "Resume data at %u bytes does not match, downloading from start", resume.offset);
+        resume = OtaResumeState();
+    } else {
+        ESP_LOGI(TAG, "Resuming firmware download at %u/%u bytes", resume.offset, resume.size);
     }
+    resume.url_crc = url_crc;
+    resume.address = update_partition->address;
 
-    size_t content_length = http->GetBodyLength();
-    if (content_length == 0) {
-        ESP_LOGE(TAG, "Failed to get content length");
-        return;
-    }
+    auto start_ota = [&](size_t offset, uint32_t crc) -> bool {
+        if (esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle)) {
+            esp_ota_abort(update_handle);
+            ESP_LOGE(TAG, "Failed to begin OTA");
+            return false;
+        }
+        ota_started = true;
+        pipeline.Start(update_handle, offset, crc, true, writer_priority());
+        return true;
+    };
 
-    char buffer[512];
-    size_t total_read = 0, recent_read = 0;
-    auto last_calc_time = esp_timer_get_time();
-    while (true) {
-        int ret = http->Read(buffer, sizeof(buffer));
-        if (ret < 0) {
-            ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
-            return;
+    // 出错时先停止写入任务，再放弃本次升级，断点保留到下次重试
+    auto abort_upgrade = [&]() {
+        pipeline.Finish();
+        if (ota_started) {
+            esp_ota_abort(update_handle);
         }
+    };
 
-        // Calculate speed and progress every second
-        recent_read += ret;
-        total_read += ret;
-        if (esp_timer_get_time() - last_calc_time >= 1000000 || ret == 0) {
-            size_t progress = total_read * 100 / content_length;
-            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %uB/s", progress, total_read, content_length, recent_read);
-            if (upgrade_callback_) {
-                upgrade_callback_(progress, recent_read);
+    const size_t header_size = sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t);
+    // total_read 是已经提交写入的字节数，也是断开后续传的位置
+    size_t total_read = resume.offset, recent_read = 0;
+    size_t content_length = resume.size;
+    auto start_time = esp_timer_get_time();
+    auto last_calc_time = start_time;
+    bool eof = false;
+    for (int attempt = 1; !eof; attempt++) {
+        if (attempt > OTA_MAX_ATTEMPTS) {
+            ESP_LOGE(TAG, "Firmware download failed after %d attempts", OTA_MAX_ATTEMPTS);
+            abort_upgrade();
+            return false;
+        }
+        if (attempt > 1) {
+            ESP_LOGW(TAG, "Retrying firmware download at %u bytes (%d/%d)", total_read, attempt, OTA_MAX_ATTEMPTS);
+            vTaskDelay(pdMS_TO_TICKS(2000));
+        }
+
+        auto http = std::unique_ptr<Http>(Board::GetInstance().CreateHttp());
+        if (total_read > 0) {
+            http->SetHeader("Range", "bytes=" + std::to_string(total_read) + "-");
+        }
+        if (!http->Open("GET", firmware_url)) {
+            ESP_LOGE(TAG, "Failed to open HTTP connection");
+            continue;
+        }
+
+        int status_code = http->GetStatusCode();
+        size_t body_length = http->GetBodyLength();
+        if (total_read > 0 && status_code == 206) {
+            if (total_read + body_length != content_length) {
+                // 服务器上的固件包已经变了，断点作废
+                ESP_LOGE(TAG, "Firmware size changed: %u, expected %u", total_read + body_length, content_length);
+                abort_upgrade();
+                OtaResumeState::Clear();
+                return false;
             }
-            last_calc_time = esp_timer_get_time();
-            recent_read = 0;
+        } else if (status_code == 200) {
+            if (total_read > 0) {
+                if (ota_started) {
+                    ESP_LOGE(TAG, "Server does not support range requests");
+                    abort_upgrade();
+                    return false;
+                }
+                // 还没开始写入，不支持续传时从头下载
+                ESP_LOGW(TAG, "Server ignored range request, downloading from start");
+                total_read = 0;
+                resume = OtaResumeState();
+                resume.url_crc = url_crc;
+                resume.address = update_partition->address;
+            }
+            content_length = body_length;
+        } else {
+            ESP_LOGE(TAG, "Failed to get firmware, status code: %d", status_code);
+            abort_upgrade();
+            return false;
+        }
+        if (content_length == 0) {
+            ESP_LOGE(TAG, "Failed to get content length");
+            abort_upgrade();
+            return false;
         }
+        resume.size = content_length;
 
-        if (ret == 0) {
-            break;
+        // 从断点续传，固件头在上次已经检查过
+        if (!ota_started && total_read > 0) {
+            if (!start_ota(resume.offset, resume.crc)) {
+                return false;
+            }
         }
 
-        if (!image_header_checked) {
-            image_header.append(buffer, ret);
-            if (image_header.size() >= sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
+        bool read_failed = false;
+        bool paused = false;
+        while (!eof && !read_failed) {
+            // 后台下载时设备开始使用就断开连接，空闲后从断点继续
+            if (pause_callback_ && pause_callback_()) {
+                paused = true;
+                break;
+            }
+            // 一次填满一块缓冲区，写入任务同时写上一块
+            uint8_t* buffer = pipeline.AcquireBuffer();
+            size_t filled = 0;
+            while (filled < pipeline.buffer_size()) {
+                int ret = http->Read((char*)buffer + filled, pipeline.buffer_size() - filled);
+                if (ret < 0) {
+                    ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
+                    read_failed = true;
+                    break;
+                }
+                if (ret == 0 && total_read + filled < content_length) {
+                    ESP_LOGE(TAG, "Connection closed at %u/%u bytes", total_read + filled, content_length);
+                    read_failed = true;
+                    break;
+                }
+                filled += ret;
+                recent_read += ret;
+                eof = (ret == 0);
+
+                // Calculate speed and progress every second
+                if (esp_timer_get_time() - last_calc_time >= 1000000 || eof) {
+                    size_t progress = (total_read + filled) * 100 / content_length;
+                    ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %uB/s, stall: writer %lldms, network %lldms",
+                        progress, total_read + filled, content_length, recent_read,
+                        pipeline.writer_stall_us() / 1000, pipeline.network_stall_us() / 1000);
+                    if (upgrade_callback_) {
+                        upgrade_callback_(progress, recent_read);
+                    }
+                    last_calc_time = esp_timer_get_time();
+                    recent_read = 0;
+                }
+                if (eof) {
+                    break;
+                }
+            }
+
+            // 断开时丢弃不完整的一块，下次从这一块开头续传
+            if (read_failed || pipeline.error() != ESP_OK) {
+                pipeline.ReleaseBuffer(buffer);
+                break;
+            }
+
+            if (!ota_started && filled > 0) {
+                if (filled < header_size) {
+                    ESP_LOGE(TAG, "Firmware image is too small");
+                    pipeline.ReleaseBuffer(buffer);
+                    return false;
+                }
                 esp_app_desc_t new_app_info;
-                memcpy(&new_app_info, image_header.data() + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
+                memcpy(&new_app_info, buffer + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
                 ESP_LOGI(TAG, "New firmware version: %s", new_app_info.version);
 
                 auto current_version = esp_app_get_description()->version;
                 if (memcmp(new_app_info.version, current_version, sizeof(new_app_info.version)) == 0) {
                     ESP_LOGE(TAG, "Firmware version is the same, skipping upgrade");
-                    return;
+                    pipeline.ReleaseBuffer(buffer);
+                    return false;
                 }
 
-                if (esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle)) {
-                    esp_ota_abort(update_handle);
-                    ESP_LOGE(TAG, "Failed to begin OTA");
-                    return;
+                if (!start_ota(0, 0)) {
+                    pipeline.ReleaseBuffer(buffer);
+                    return false;
                 }
+                resume.SaveImage();
+            }
 
-                image_header_checked = true;
-                std::string().swap(image_header);
+            if (filled > 0) {
+                pipeline.Submit(buffer, filled);
+                total_read += filled;
+            } else {
+                pipeline.ReleaseBuffer(buffer);
             }
         }
-        auto err = esp_ota_write(update_handle, buffer, ret);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
-            esp_ota_abort(update_handle);
-            return;
+        http->Close();
+
+        if (pipeline.error() != ESP_OK) {
+            abort_upgrade();
+            return false;
+        }
+        if (paused) {
+            ESP_LOGI(TAG, "Firmware download paused at %u/%u bytes", total_read, content_length);
+            while (pause_callback_()) {
+                vTaskDelay(pdMS_TO_TICKS(1000));
+            }
+            ESP_LOGI(TAG, "Firmware download resumed");
+            // 暂停不算失败，不消耗重试次数
+            attempt = 0;
         }
     }
-    http->Close();
 
-    esp_err_t err = esp_ota_end(update_handle);
-    if (err != ESP_OK) {
-        if (err == ESP_ERR_OTA_VALIDATE_FAILED) {
-            ESP_LOGE(TAG, "Image validation failed, image is corrupted");
-        } else {
-            ESP_LOGE(TAG, "Failed to end OTA: %s", esp_err_to_name(err));
+    if (!ota_started || total_read != content_length) {
+        ESP_LOGE(TAG, "Incomplete firmware: %u/%u bytes", total_read, content_length);
+        abort_upgrade();
+        return false;
+    }
+    if (pipeline.Finish() != ESP_OK) {
+        esp_ota_abort(update_handle);
+        return false;
+    }
+    auto elapsed_ms = (esp_timer_get_time() - start_time) / 1000;
+    ESP_LOGI(TAG, "Downloaded %u bytes in %lldms (%lluB/s), stall: writer %lldms, network %lldms",
+        total_read - resume.offset, elapsed_ms, elapsed_ms > 0 ? (uint64_t)(total_read - resume.offset) * 1000 / elapsed_ms : 0,
+        pipeline.writer_stall_us() / 1000, pipeline.network_stall_us() / 1000);
+    // 无论镜像是否有效，这个断点都不再需要
+    OtaResumeState::Clear();
+
+    return CompleteUpgrade(update_handle, update_partition, !background_);
+}
+
+// 下载差分补丁或压缩包，由 decoder 还原成固件镜像后写入，失败时返回，由调用者改用完整固件
+bool Ota::UpgradeStream(const std::string& url, OtaStreamDecoder& decoder) {
+    ESP_LOGI(TAG, "Upgrading firmware from %s", url.c_str());
+    esp_ota_handle_t update_handle = 0;
+    auto update_partition = esp_ota_get_next_update_partition(NULL);
+    if (update_partition == NULL) {
+        ESP_LOGE(TAG, "Failed to get update partition");
+        return false;
+    }
+
+    OtaWritePipeline pipeline;
+    if (!pipeline.Initialize(update_partition)) {
+        ESP_LOGE(TAG, "Failed to allocate OTA buffers");
+        return false;
+    }
+    // 写入的是还原后的镜像，下载的偏移和镜像偏移对不上，不支持断点续传
+    OtaResumeState::Clear();
+
+    auto http = std::unique_ptr<Http>(Board::GetInstance().CreateHttp());
+    if (!http->Open("GET", url)) {
+        ESP_LOGE(TAG, "Failed to open HTTP connection");
+        return false;
+    }
+    if (http->GetStatusCode() != 200) {
+        ESP_LOGE(TAG, "Failed to get firmware, status code: %d", http->GetStatusCode());
+        return false;
+    }
+    size_t content_length = http->GetBodyLength();
+    if (content_length == 0) {
+        ESP_LOGE(TAG, "Failed to get content length");
+        return false;
+    }
+
+    // 还原出的镜像按缓冲区大小提交给写入任务，第一块提交前检查固件头
+    const size_t header_size = sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t);
+    bool ota_started = false;
+    uint8_t* buffer = nullptr;
+    size_t filled = 0;
+    auto submit = [&]() -> bool {
+        if (!ota_started) {
+            if (filled < header_size) {
+                ESP_LOGE(TAG, "Firmware image is too small");
+                return false;
+            }
+            esp_app_desc_t new_app_info;
+            memcpy(&new_app_info, buffer + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
+            ESP_LOGI(TAG, "New firmware version: %s", new_app_info.version);
+            if (memcmp(new_app_info.version, esp_app_get_description()->version, sizeof(new_app_info.version)) == 0) {
+                ESP_LOGE(TAG, "Firmware version is the same, skipping upgrade");
+                return false;
+            }
+            if (esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle)) {
+                esp_ota_abort(update_handle);
+                ESP_LOGE(TAG, "Failed to begin OTA");
+                return false;
+            }
+            ota_started = true;
+            pipeline.Start(update_handle, 0, 0, false, writer_priority());
+        }
+        pipeline.Submit(buffer, filled);
+        buffer = nullptr;
+        return pipeline.error() == ESP_OK;
+    };
+    decoder.SetOutput([&](const uint8_t* data, size_t size) -> bool {
+        while (size > 0) {
+            if (buffer == nullptr) {
+                buffer = pipeline.AcquireBuffer();
+                filled = 0;
+            }
+            size_t n = std::min(size, pipeline.buffer_size() - filled);
+            memcpy(buffer + filled, data, n);
+            filled += n;
+            data += n;
+            size -= n;
+            if (filled == pipeline.buffer_size() && !submit()) {
+                return false;
+            }
+        }
+        return true;
+    });
+
+    auto abort_upgrade = [&]() {
+        if (buffer != nullptr) {
+            pipeline.ReleaseBuffer(buffer);
+            buffer = nullptr;
+        }
+        pipeline.Finish();
+        if (ota_started) {
+            esp_ota_abort(update_handle);
+        }
+    };
+
+    auto read_buffer = std::make_unique<char[]>(1024);
+    size_t total_read = 0, recent_read = 0;
+    auto last_calc_time = esp_timer_get_time();
+    while (total_read < content_length) {
+        // 还原的镜像不能续传，后台下载时设备开始使用就放弃，空闲后重新下载
+        if (pause_callback_ && pause_callback_()) {
+            ESP_LOGI(TAG, "Download interrupted at %u/%u bytes", total_read, content_length);
+            abort_upgrade();
+            return false;
+        }
+        int ret = http->Read(read_buffer.get(), std::min<size_t>(1024, content_length - total_read));
+        if (ret <= 0) {
+            ESP_LOGE(TAG, "Download ended at %u/%u bytes", total_read, content_length);
+            abort_upgrade();
+            return false;
+        }
+        total_read += ret;
+        recent_read += ret;
+        if (!decoder.Feed((const uint8_t*)read_buffer.get(), ret)) {
+            abort_upgrade();
+            return false;
+        }
+
+        if (esp_timer_get_time() - last_calc_time >= 1000000 || total_read == content_length) {
+            size_t progress = total_read * 100 / content_length;
+            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), image %u bytes, Speed: %uB/s", progress, total_read, content_length,
+                decoder.written(), recent_read);
+            if (upgrade_callback_) {
+                upgrade_callback_(progress, recent_read);
+            }
+            last_calc_time = esp_timer_get_time();
+            recent_read = 0;
         }
-        return;
     }
+    http->Close();
 
-    err = esp_ota_set_boot_partition(update_partition);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to set boot partition: %s", esp_err_to_name(err));
-        return;
+    if (!decoder.Finish() || (buffer != nullptr && !submit()) || !ota_started) {
+        abort_upgrade();
+        return false;
+    }
+    if (pipeline.Finish() != ESP_OK) {
+        esp_ota_abort(update_handle);
+        return false;
     }
+    ESP_LOGI(TAG, "Restored image: %u bytes from %u bytes downloaded", decoder.written(), total_read);
+    return CompleteUpgrade(update_handle, update_partition, !background_);
+}
 
-    ESP_LOGI(TAG, "Firmware upgrade successful, rebooting in 3 seconds...");
-    vTaskDelay(pdMS_TO_TICKS(3000));
-    esp_restart();
+void Ota::SetBackgroundMode(std::function<bool()> pause_callback) {
+    background_ = true;
+    pause_callback_ = pause_callback;
 }
 
-void Ota::StartUpgrade(std::function<void(int progress, size_t speed)> callback) {
+bool Ota::StartUpgrade(std::function<void(int progress, size_t speed)> callback) {
     upgrade_callback_ = callback;
-    Upgrade(firmware_url_);
+    if (!firmware_delta_url_.empty()) {
+        OtaDeltaDecoder decoder(esp_ota_get_running_partition());
+        if (UpgradeStream(firmware_delta_url_, decoder)) {
+            return true;
+        }
+        // 被暂停打断时下次重新尝试差分升级，不改用更大的固件包
+        if (pause_callback_ && pause_callback_()) {
+            return false;
+        }
+        ESP_LOGW(TAG, "Delta upgrade failed, falling back");
+    }
+    if (!firmware_compressed_url_.empty()) {
+        OtaLzssDecoder decoder(compressed_window_bits_, compressed_lookahead_bits_);
+        if (decoder.valid() && UpgradeStream(firmware_compressed_url_, decoder)) {
+            return true;
+        }
+        if (pause_callback_ && pause_callback_()) {
+            return false;
+        }
+        ESP_LOGW(TAG, "Compressed upgrade failed, falling back");
+    }
+    return Upgrade(firmware_url_);
 }
 
 std::vector<int> Ota::ParseVersion(const std::string& version) {
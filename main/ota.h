@@ -6,6 +6,8 @@
 
 #include <esp_err.h>
 #include "board.h"
+#include "ota_stream_decoder.h"
+#include "json_arena.h"
 
 class Ota {
 public:
@@ -13,6 +15,8 @@ public:
     ~Ota();
 
     bool CheckVersion();
+    // 读取上次 CheckVersion 缓存的响应，没有缓存时返回 false
+    bool LoadCachedResponse();
     esp_err_t Activate();
     bool HasActivationChallenge() { return has_activation_challenge_; }
     bool HasNewVersion() { return has_new_version_; }
@@ -20,7 +24,10 @@ public:
     bool HasWebsocketConfig() { return has_websocket_config_; }
     bool HasActivationCode() { return has_activation_code_; }
     bool HasServerTime() { return has_server_time_; }
-    void StartUpgrade(std::function<void(int progress, size_t speed)> callback);
+    // 前台升级成功后重启，不返回；后台模式下成功时返回 true，新固件在下次重启时生效
+    bool StartUpgrade(std::function<void(int progress, size_t speed)> callback);
+    // 后台模式：下载和写入使用低优先级，pause_callback 返回 true 时暂停下载，完成后不重启
+    void SetBackgroundMode(std::function<bool()> pause_callback);
     void MarkCurrentVersionValid();
 
     const std::string& GetFirmwareVersion() const { return firmware_version_; }
@@ -42,15 +49,26 @@ private:
     std::string current_version_;
     std::string firmware_version_;
     std::string firmware_url_;
+    std::string firmware_delta_url_;
+    std::string firmware_compressed_url_;
+    int compressed_window_bits_ = 0;
+    int compressed_lookahead_bits_ = 0;
     std::string activation_challenge_;
     std::string serial_number_;
     int activation_timeout_ms_ = 30000;
 
-    void Upgrade(const std::string& firmware_url);
+    bool background_ = false;
+    std::function<bool()> pause_callback_;
+
+    bool Upgrade(const std::string& firmware_url);
+    bool UpgradeStream(const std::string& url, OtaStreamDecoder& decoder);
+    int writer_priority() const { return background_ ? 1 : 4; }
     std::function<void(int progress, size_t speed)> upgrade_callback_;
     std::vector<int> ParseVersion(const std::string& version);
     bool IsNewVersionAvailable(const std::string& currentVersion, const std::string& newVersion);
     std::string GetActivationPayload();
+    bool ParseResponse(JsonArena& arena, const char* body, size_t length, bool cached);
+    void SaveCachedResponse(const char* body, size_t length, const std::string& etag);
     Http* SetupHttp();
 };
 
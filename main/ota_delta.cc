@@ -0,0 +1,163 @@
+#include "ota_delta.h"
+
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+
+#include <algorithm>
+#include <cstring>
+
+#define TAG "OtaDelta"
+
+#define DELTA_OP_END 0x00
+#define DELTA_OP_COPY 0x01
+#define DELTA_OP_INSERT 0x02
+
+static uint32_t ReadU32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+OtaDeltaDecoder::OtaDeltaDecoder(const esp_partition_t* source) : source_(source) {
+}
+
+bool OtaDeltaDecoder::Finish() {
+    if (state_ != kStateDone) {
+        ESP_LOGE(TAG, "Patch is incomplete");
+        return false;
+    }
+    return true;
+}
+
+bool OtaDeltaDecoder::Feed(const uint8_t* data, size_t size) {
+    while (size > 0 && state_ != kStateDone) {
+        if (state_ == kStateInsert) {
+            size_t n = std::min(size, insert_remaining_);
+            if (!Emit(data, n)) {
+                return false;
+            }
+            data += n;
+            size -= n;
+            insert_remaining_ -= n;
+            if (insert_remaining_ == 0) {
+                state_ = kStateOpcode;
+            }
+            continue;
+        }
+
+        if (state_ == kStateOpcode) {
+            opcode_ = *data++;
+            size--;
+            pending_size_ = 0;
+            if (opcode_ == DELTA_OP_END) {
+                if (written_ != target_size_ || crc_ != target_crc_) {
+                    ESP_LOGE(TAG, "Target mismatch: %u/%u bytes, crc %08lx/%08lx", written_, target_size_,
+                        (unsigned long)crc_, (unsigned long)target_crc_);
+                    return false;
+                }
+                state_ = kStateDone;
+            } else if (opcode_ == DELTA_OP_COPY) {
+                pending_needed_ = 8;
+                state_ = kStateArguments;
+            } else if (opcode_ == DELTA_OP_INSERT) {
+                pending_needed_ = 4;
+                state_ = kStateArguments;
+            } else {
+                ESP_LOGE(TAG, "Invalid opcode: 0x%02x", opcode_);
+                return false;
+            }
+            continue;
+        }
+
+        // 头部和操作参数可能被分在两次 Feed 中
+        size_t n = std::min(size, pending_needed_ - pending_size_);
+        memcpy(pending_ + pending_size_, data, n);
+        pending_size_ += n;
+        data += n;
+        size -= n;
+        if (pending_size_ < pending_needed_) {
+            break;
+        }
+        if (state_ == kStateHeader) {
+            if (!ParseHeader()) {
+                return false;
+            }
+            state_ = kStateOpcode;
+        } else if (!RunOperation()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool OtaDeltaDecoder::ParseHeader() {
+    if (memcmp(pending_, "XZD1", 4) != 0) {
+        ESP_LOGE(TAG, "Invalid patch header");
+        return false;
+    }
+    source_size_ = ReadU32(pending_ + 4);
+    uint32_t source_crc = ReadU32(pending_ + 8);
+    target_size_ = ReadU32(pending_ + 12);
+    target_crc_ = ReadU32(pending_ + 16);
+    if (source_size_ > source_->size) {
+        ESP_LOGE(TAG, "Source size %u exceeds partition %s", source_size_, source_->label);
+        return false;
+    }
+
+    // 补丁只能用在生成时的那个固件上
+    uint8_t buffer[512];
+    uint32_t crc = 0;
+    for (size_t offset = 0; offset < source_size_; offset += sizeof(buffer)) {
+        size_t length = std::min(sizeof(buffer), source_size_ - offset);
+        if (esp_partition_read(source_, offset, buffer, length) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to read source partition");
+            return false;
+        }
+        crc = esp_rom_crc32_le(crc, buffer, length);
+    }
+    if (crc != source_crc) {
+        ESP_LOGW(TAG, "Patch does not match the running firmware");
+        return false;
+    }
+    ESP_LOGI(TAG, "Applying patch to %s: %u -> %u bytes", source_->label, source_size_, target_size_);
+    return true;
+}
+
+bool OtaDeltaDecoder::RunOperation() {
+    if (opcode_ == DELTA_OP_COPY) {
+        state_ = kStateOpcode;
+        return Copy(ReadU32(pending_), ReadU32(pending_ + 4));
+    }
+    insert_remaining_ = ReadU32(pending_);
+    if (written_ + insert_remaining_ > target_size_) {
+        ESP_LOGE(TAG, "Insert exceeds target size");
+        return false;
+    }
+    state_ = insert_remaining_ > 0 ? kStateInsert : kStateOpcode;
+    return true;
+}
+
+bool OtaDeltaDecoder::Copy(size_t offset, size_t length) {
+    if (offset + length > source_size_ || written_ + length > target_size_) {
+        ESP_LOGE(TAG, "Invalid copy: %u+%u", offset, length);
+        return false;
+    }
+    uint8_t buffer[512];
+    while (length > 0) {
+        size_t n = std::min(sizeof(buffer), length);
+        if (esp_partition_read(source_, offset, buffer, n) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to read source partition");
+            return false;
+        }
+        if (!Emit(buffer, n)) {
+            return false;
+        }
+        offset += n;
+        length -= n;
+    }
+    return true;
+}
+
+bool OtaDeltaDecoder::Emit(const uint8_t* data, size_t size) {
+    crc_ = esp_rom_crc32_le(crc_, data, size);
+    written_ += size;
+    return output_(data, size);
+}
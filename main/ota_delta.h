@@ -0,0 +1,53 @@
+#ifndef _OTA_DELTA_H
+#define _OTA_DELTA_H
+
+#include "ota_stream_decoder.h"
+
+#include <esp_partition.h>
+
+// 差分固件补丁解码器，补丁由 scripts/ota_delta.py 生成
+//
+// 格式（小端）:
+//   头部 20 字节: "XZD1", source_size, source_crc32, target_size, target_crc32
+//   之后是一串操作，每个操作以 1 字节类型开头:
+//     0x01 COPY   u32 source_offset, u32 length   从正在运行的分区复制
+//     0x02 INSERT u32 length, 后跟 length 字节      补丁中的新数据
+//     0x00 END
+//
+// 补丁头部的 source_crc32 与正在运行的分区不一致时 Feed 返回 false
+class OtaDeltaDecoder : public OtaStreamDecoder {
+public:
+    explicit OtaDeltaDecoder(const esp_partition_t* source);
+
+    virtual bool Feed(const uint8_t* data, size_t size) override;
+    virtual bool Finish() override;
+
+private:
+    enum State {
+        kStateHeader,
+        kStateOpcode,
+        kStateArguments,
+        kStateInsert,
+        kStateDone,
+    };
+
+    const esp_partition_t* source_;
+    State state_ = kStateHeader;
+    uint8_t pending_[20];
+    size_t pending_size_ = 0;
+    size_t pending_needed_ = 20;
+    uint8_t opcode_ = 0;
+    size_t insert_remaining_ = 0;
+
+    size_t source_size_ = 0;
+    size_t target_size_ = 0;
+    uint32_t target_crc_ = 0;
+    uint32_t crc_ = 0;
+
+    bool ParseHeader();
+    bool RunOperation();
+    bool Copy(size_t offset, size_t length);
+    bool Emit(const uint8_t* data, size_t size);
+};
+
+#endif // _OTA_DELTA_H
@@ -0,0 +1,77 @@
+#include "ota_lzss.h"
+
+#include <esp_log.h>
+
+#define TAG "OtaLzss"
+
+OtaLzssDecoder::OtaLzssDecoder(int window_bits, int lookahead_bits)
+    : window_bits_(window_bits), lookahead_bits_(lookahead_bits) {
+    if (window_bits < 4 || window_bits > 15 || lookahead_bits < 3 || lookahead_bits >= window_bits) {
+        ESP_LOGE(TAG, "Invalid parameters: window %d, lookahead %d", window_bits, lookahead_bits);
+        return;
+    }
+    window_.resize(1 << window_bits, 0);
+}
+
+bool OtaLzssDecoder::Feed(const uint8_t* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        bit_buffer_ = (bit_buffer_ << 8) | data[i];
+        bit_count_ += 8;
+
+        // 每个字节最多能完成一个字段，字段最长 15 位，累加器不会溢出
+        while (true) {
+            int need = state_ == kStateTag ? 1 : state_ == kStateLiteral ? 8
+                : state_ == kStateIndex ? window_bits_ : lookahead_bits_;
+            if (bit_count_ < need) {
+                break;
+            }
+            bit_count_ -= need;
+            uint32_t value = (bit_buffer_ >> bit_count_) & ((1u << need) - 1);
+
+            if (state_ == kStateTag) {
+                state_ = value ? kStateLiteral : kStateIndex;
+            } else if (state_ == kStateLiteral) {
+                if (!Put(value)) {
+                    return false;
+                }
+                state_ = kStateTag;
+            } else if (state_ == kStateIndex) {
+                index_ = value + 1;
+                state_ = kStateCount;
+            } else {
+                size_t mask = window_.size() - 1;
+                for (uint32_t n = 0; n <= value; n++) {
+                    if (!Put(window_[(head_ - index_) & mask])) {
+                        return false;
+                    }
+                }
+                state_ = kStateTag;
+            }
+        }
+    }
+    return Flush();
+}
+
+bool OtaLzssDecoder::Finish() {
+    return Flush();
+}
+
+bool OtaLzssDecoder::Put(uint8_t byte) {
+    window_[head_ & (window_.size() - 1)] = byte;
+    head_++;
+    out_[out_size_++] = byte;
+    if (out_size_ == sizeof(out_)) {
+        return Flush();
+    }
+    return true;
+}
+
+bool OtaLzssDecoder::Flush() {
+    if (out_size_ == 0) {
+        return true;
+    }
+    size_t size = out_size_;
+    out_size_ = 0;
+    written_ += size;
+    return output_(out_, size);
+}
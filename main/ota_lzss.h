@@ -0,0 +1,47 @@
+#ifndef _OTA_LZSS_H
+#define _OTA_LZSS_H
+
+#include "ota_stream_decoder.h"
+
+#include <vector>
+
+// 压缩固件解码器，压缩包由 scripts/ota_compress.py 生成
+//
+// LZSS 位流，高位在前，与 heatshrink 的编码相同:
+//   1 + 8 位字节                                     原样输出
+//   0 + window_bits 位 (距离-1) + lookahead_bits 位 (长度-1)   从已输出的数据中复制
+// 窗口初始为 0，最后不足一个完整编码的位是填充
+class OtaLzssDecoder : public OtaStreamDecoder {
+public:
+    OtaLzssDecoder(int window_bits, int lookahead_bits);
+
+    bool valid() const { return !window_.empty(); }
+
+    virtual bool Feed(const uint8_t* data, size_t size) override;
+    virtual bool Finish() override;
+
+private:
+    enum State {
+        kStateTag,
+        kStateLiteral,
+        kStateIndex,
+        kStateCount,
+    };
+
+    int window_bits_;
+    int lookahead_bits_;
+    std::vector<uint8_t> window_;
+    size_t head_ = 0;
+    State state_ = kStateTag;
+    uint32_t bit_buffer_ = 0;
+    int bit_count_ = 0;
+    size_t index_ = 0;
+
+    uint8_t out_[256];
+    size_t out_size_ = 0;
+
+    bool Put(uint8_t byte);
+    bool Flush();
+};
+
+#endif // _OTA_LZSS_H
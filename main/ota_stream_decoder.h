@@ -0,0 +1,30 @@
+#ifndef _OTA_STREAM_DECODER_H
+#define _OTA_STREAM_DECODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// 升级包解码器：边下载边把差分补丁、压缩包等还原成固件镜像
+// 下载的数据按任意大小分块输入，还原出的镜像按顺序交给 output 回调
+class OtaStreamDecoder {
+public:
+    using Output = std::function<bool(const uint8_t* data, size_t size)>;
+
+    virtual ~OtaStreamDecoder() = default;
+
+    void SetOutput(Output output) { output_ = output; }
+
+    // 返回 false 表示数据无效或者 output 失败
+    virtual bool Feed(const uint8_t* data, size_t size) = 0;
+    // 下载结束后调用，检查镜像是否完整
+    virtual bool Finish() = 0;
+
+    size_t written() const { return written_; }
+
+protected:
+    Output output_;
+    size_t written_ = 0;
+};
+
+#endif // _OTA_STREAM_DECODER_H
@@ -0,0 +1,93 @@
+#include "p3_file.h"
+#include "protocols/binary_frame.h"
+
+#include <cstring>
+
+static uint32_t ReadBe32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint16_t ReadBe16(const uint8_t* p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+bool P3File::IsIndexed(std::string_view data) {
+    return data.size() >= sizeof(P3FileHeader) && memcmp(data.data(), P3_FILE_MAGIC, 4) == 0;
+}
+
+bool P3File::Open(std::string_view data) {
+    data_ = data;
+    indexed_ = false;
+    sample_rate_ = 16000;
+    frame_duration_ = 60;
+    frame_count_ = 0;
+    size_ = 0;
+    offsets_ = nullptr;
+    frames_ = nullptr;
+
+    auto bytes = (const uint8_t*)data.data();
+    if (IsIndexed(data)) {
+        auto header = (const P3FileHeader*)bytes;
+        if (header->version != 2) {
+            return false;
+        }
+        uint32_t count = ReadBe32((const uint8_t*)&header->frame_count);
+        uint32_t data_offset = ReadBe32((const uint8_t*)&header->data_offset);
+        // 偏移表必须完整地放在文件头和第一帧之间
+        uint64_t table_end = sizeof(P3FileHeader) + ((uint64_t)count + 1) * sizeof(uint32_t);
+        if (table_end > data_offset || data_offset > data.size()) {
+            return false;
+        }
+        offsets_ = bytes + sizeof(P3FileHeader);
+        frames_ = bytes + data_offset;
+        frame_count_ = count;
+        uint32_t total = Offset(count);
+        if (total > data.size() - data_offset) {
+            return false;
+        }
+        sample_rate_ = (int)ReadBe32((const uint8_t*)&header->sample_rate);
+        frame_duration_ = ReadBe16((const uint8_t*)&header->frame_duration);
+        if (sample_rate_ <= 0 || frame_duration_ <= 0) {
+            return false;
+        }
+        size_ = data_offset + total;
+        indexed_ = true;
+        return true;
+    }
+
+    // v1 逐帧扫描统计帧数
+    size_t offset = 0;
+    while (offset + sizeof(BinaryProtocol3) <= data.size()) {
+        size_t payload_size = ReadBe16(bytes + offset + 2);
+        if (offset + sizeof(BinaryProtocol3) + payload_size > data.size()) {
+            break;
+        }
+        offset += sizeof(BinaryProtocol3) + payload_size;
+        frame_count_++;
+    }
+    size_ = offset;
+    return true;
+}
+
+uint32_t P3File::Offset(size_t index) const {
+    return ReadBe32(offsets_ + index * sizeof(uint32_t));
+}
+
+bool P3File::GetFrame(size_t index, const uint8_t*& payload, size_t& payload_size) const {
+    if (!indexed_ || index >= frame_count_) {
+        return false;
+    }
+    uint32_t start = Offset(index);
+    uint32_t end = Offset(index + 1);
+    if (end < start || end > Offset(frame_count_)) {
+        return false;
+    }
+    payload = frames_ + start;
+    payload_size = end - start;
+    return true;
+}
+
+size_t P3File::FrameAt(uint32_t ms) const {
+    size_t index = ms / frame_duration_;
+    return index < frame_count_ ? index : frame_count_;
+}
@@ -0,0 +1,58 @@
+#ifndef P3_FILE_H
+#define P3_FILE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+
+// p3 提示音文件的解析，只依赖标准库
+// v1：BinaryProtocol3 头加 Opus 数据的序列，只能从头逐帧扫描
+// v2：文件头记录采样率、帧长和帧数，后面是每帧的偏移表，可以 O(1) 定位任意一帧
+//   [P3FileHeader] [offsets[frame_count + 1]] [frame0][frame1]...
+//   偏移相对第一帧的起始位置，最后一项是数据的总长度，所有字段为网络字节序
+#define P3_FILE_MAGIC "P3V2"
+
+struct P3FileHeader {
+    char magic[4];              // "P3V2"
+    uint8_t version;            // 2
+    uint8_t reserved;
+    uint16_t frame_duration;    // 毫秒
+    uint32_t sample_rate;
+    uint32_t frame_count;
+    uint32_t data_offset;       // 第一帧相对文件开头的偏移
+} __attribute__((packed));
+
+class P3File {
+public:
+    // data 需要在 P3File 的生命周期内有效（flash 中的资源或映射的分区）
+    bool Open(std::string_view data);
+    // 只检查文件头，不扫描 v1 的帧
+    static bool IsIndexed(std::string_view data);
+
+    bool indexed() const { return indexed_; }
+    int sample_rate() const { return sample_rate_; }
+    int frame_duration() const { return frame_duration_; }
+    // v1 文件需要扫描一遍才能知道帧数
+    size_t frame_count() const { return frame_count_; }
+    uint32_t duration_ms() const { return (uint32_t)frame_count_ * frame_duration_; }
+    // 整个文件的长度，从分区映射时 data 可能比文件长
+    size_t size() const { return size_; }
+
+    // 只支持 v2
+    bool GetFrame(size_t index, const uint8_t*& payload, size_t& payload_size) const;
+    size_t FrameAt(uint32_t ms) const;
+
+private:
+    std::string_view data_;
+    bool indexed_ = false;
+    int sample_rate_ = 16000;
+    int frame_duration_ = 60;
+    size_t frame_count_ = 0;
+    size_t size_ = 0;
+    const uint8_t* offsets_ = nullptr;
+    const uint8_t* frames_ = nullptr;
+
+    uint32_t Offset(size_t index) const;
+};
+
+#endif // P3_FILE_H
@@ -0,0 +1,105 @@
+#include "performance_profile.h"
+#include "settings.h"
+#include "metrics.h"
+
+#include <esp_log.h>
+
+#include <algorithm>
+#include <cstring>
+
+#define TAG "PerformanceProfile"
+
+// 没有设置的参数
+#define PERF_UNSET -1
+
+static MetricGauge metric_profile_id("perf.profile_id");
+
+namespace {
+
+// NVS 的 key 不能超过 15 个字符，和 JSON 中的名字分开
+struct ParamSpec {
+    const char* name;
+    const char* key;
+    int min;
+    int max;
+};
+
+const ParamSpec kParams[kPerfParamCount] = {
+    {"opus_complexity", "opus_cx", 0, 10},
+    {"opus_max_complexity", "opus_max_cx", 0, 10},
+    {"audio_queue_ms", "queue_ms", 120, 10000},
+    {"display_refresh_ms", "refresh_ms", 10, 100},
+    {"afe_mode", "afe_low_cost", 0, 1},
+    {"keepalive", "keepalive", 30, 600},
+};
+
+} // namespace
+
+PerformanceProfile::PerformanceProfile() {
+    for (auto& value : values_) {
+        value = PERF_UNSET;
+    }
+#if CONFIG_REMOTE_PERFORMANCE_PROFILE
+    Settings settings("performance", false);
+    id_ = settings.GetInt("id", 0);
+    for (int i = 0; i < kPerfParamCount; i++) {
+        values_[i] = settings.GetInt(kParams[i].key, PERF_UNSET);
+    }
+    metric_profile_id.Set(id_);
+    if (id_ != 0) {
+        ESP_LOGI(TAG, "Performance profile %d", id_.load());
+    }
+#endif
+}
+
+bool PerformanceProfile::Update(const cJSON* section) {
+#if CONFIG_REMOTE_PERFORMANCE_PROFILE
+    Settings settings("performance", true);
+    bool changed = false;
+    auto store = [&](const char* key, std::atomic<int>& current, int value) {
+        if (current == value) {
+            return;
+        }
+        current = value;
+        if (value == PERF_UNSET) {
+            settings.EraseKey(key);
+        } else {
+            settings.SetInt(key, value);
+        }
+        changed = true;
+    };
+
+    auto id = cJSON_GetObjectItem(section, "id");
+    store("id", id_, cJSON_IsNumber(id) ? id->valueint : 0);
+    for (int i = 0; i < kPerfParamCount; i++) {
+        auto& spec = kParams[i];
+        int value = PERF_UNSET;
+        auto item = cJSON_GetObjectItem(section, spec.name);
+        if (i == kPerfAfeLowCost) {
+            // AFE 模式用名字下发："low_cost" 或 "high_perf"
+            if (cJSON_IsString(item)) {
+                value = strcmp(item->valuestring, "low_cost") == 0 ? 1 : 0;
+            }
+        } else if (cJSON_IsNumber(item)) {
+            value = std::clamp(item->valueint, spec.min, spec.max);
+            if (value != item->valueint) {
+                ESP_LOGW(TAG, "%s %d is out of range, clamped to %d", spec.name, item->valueint, value);
+            }
+        }
+        store(spec.key, values_[i], value);
+    }
+
+    if (changed) {
+        metric_profile_id.Set(id_);
+        ESP_LOGI(TAG, "Performance profile updated: %d", id_.load());
+    }
+    return changed;
+#else
+    return false;
+#endif
+}
+
+int PerformanceProfile::Get(PerformanceParam param, int default_value) const {
+    int value = values_[param].load(std::memory_order_relaxed);
+    return value == PERF_UNSET ? default_value : value;
+}
@@ -0,0 +1,44 @@
+#ifndef PERFORMANCE_PROFILE_H
+#define PERFORMANCE_PROFILE_H
+
+#include <atomic>
+
+#include <cJSON.h>
+
+// 可以由服务器调整的性能参数
+enum PerformanceParam {
+    kPerfOpusComplexity,     // 编码器初始 complexity
+    kPerfOpusMaxComplexity,  // 自适应编码允许的最高 complexity
+    kPerfAudioQueueMs,       // 上下行音频队列的时长，不超过编译时预分配的时长
+    kPerfDisplayRefreshMs,   // 对话中屏幕的刷新周期
+    kPerfAfeLowCost,         // 1 使用低功耗 AFE，0 使用高性能 AFE
+    kPerfKeepaliveSeconds,   // MQTT 心跳间隔
+    kPerfParamCount
+};
+
+// 服务器在 OTA 检查响应的 performance 段下发的调优参数（CONFIG_REMOTE_PERFORMANCE_PROFILE），用于在设备上对比不同参数的延迟和 CPU 占用
+// "performance": { "id": 12, "opus_complexity": 3, "display_refresh_ms": 33, "afe_mode": "low_cost" }
+// 参数保存在 Settings 的 performance 命名空间，超出安全范围的值被截断，没有下发的参数使用编译时的默认值
+// 各模块在自己配置时读取：队列长度下一次调整时生效，编码器和 AFE 在下次启动时生效，心跳在下次连接时生效
+// 当前生效的 profile id 通过 perf.profile_id 指标上报，没有 profile 时为 0
+class PerformanceProfile {
+public:
+    static PerformanceProfile& GetInstance() {
+        static PerformanceProfile instance;
+        return instance;
+    }
+
+    // 应用 OTA 响应中的 performance 段，section 为空时恢复默认值；参数有变化时返回 true
+    bool Update(const cJSON* section);
+    // 服务器设置了该参数时返回它，否则返回 default_value
+    int Get(PerformanceParam param, int default_value) const;
+    int id() const { return id_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int> id_{0};
+    std::atomic<int> values_[kPerfParamCount];
+
+    PerformanceProfile();
+};
+
+#endif // PERFORMANCE_PROFILE_H
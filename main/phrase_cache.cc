@@ -0,0 +1,100 @@
+#include "phrase_cache.h"
+#include "metrics.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <algorithm>
+
+#define TAG "PhraseCache"
+
+#define PHRASE_CACHE_BYTES (CONFIG_TTS_PHRASE_CACHE_SIZE_KB * 1024)
+// 单个句子最多占用一半容量，避免一句长回复把其他缓存全部挤掉
+#define PHRASE_CACHE_MAX_PHRASE_BYTES (PHRASE_CACHE_BYTES / 2)
+
+static MetricCounter metric_hits("phrase_cache.hits");
+static MetricCounter metric_misses("phrase_cache.misses");
+static MetricCounter metric_evictions("phrase_cache.evictions");
+static MetricGauge metric_bytes("phrase_cache.bytes");
+
+void PhraseCache::BeginRecord(std::string_view id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    recording_.reset();
+    if (id.empty() || id.size() > PHRASE_CACHE_MAX_ID) {
+        return;
+    }
+    recording_ = std::make_unique<Phrase>();
+    recording_->id = id;
+}
+
+void PhraseCache::Record(int sample_rate, int frame_duration, const uint8_t* payload, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!recording_) {
+        return;
+    }
+    auto& frames = recording_->frames;
+    if (recording_->sample_rate == 0) {
+        recording_->sample_rate = sample_rate;
+        recording_->frame_duration = frame_duration;
+    } else if (recording_->sample_rate != sample_rate || recording_->frame_duration != frame_duration) {
+        // 一句话中间换了格式，不缓存
+        recording_.reset();
+        return;
+    }
+    if (size > UINT16_MAX || frames.size() + size + 2 > PHRASE_CACHE_MAX_PHRASE_BYTES) {
+        ESP_LOGW(TAG, "Phrase %s too long to cache", recording_->id.c_str());
+        recording_.reset();
+        return;
+    }
+    frames.push_back(size >> 8);
+    frames.push_back(size & 0xFF);
+    frames.insert(frames.end(), payload, payload + size);
+}
+
+void PhraseCache::EndRecord(bool commit) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!recording_) {
+        return;
+    }
+    std::shared_ptr<Phrase> phrase = std::move(recording_);
+    if (!commit || phrase->frames.empty()) {
+        return;
+    }
+    phrase->frames.shrink_to_fit();
+    phrase->last_used = esp_timer_get_time();
+
+    auto it = std::find_if(phrases_.begin(), phrases_.end(), [&phrase](auto& item) {
+        return item->id == phrase->id;
+    });
+    if (it != phrases_.end()) {
+        total_bytes_ -= (*it)->frames.size();
+        phrases_.erase(it);
+    }
+    // 淘汰最久没用的，直到放得下
+    while (!phrases_.empty() && (phrases_.size() >= PHRASE_CACHE_MAX_ENTRIES ||
+            total_bytes_ + phrase->frames.size() > PHRASE_CACHE_BYTES)) {
+        auto oldest = std::min_element(phrases_.begin(), phrases_.end(), [](auto& a, auto& b) {
+            return a->last_used < b->last_used;
+        });
+        ESP_LOGI(TAG, "Evict %s", (*oldest)->id.c_str());
+        total_bytes_ -= (*oldest)->frames.size();
+        phrases_.erase(oldest);
+        metric_evictions.Add();
+    }
+    ESP_LOGI(TAG, "Cached %s (%u bytes)", phrase->id.c_str(), (unsigned)phrase->frames.size());
+    total_bytes_ += phrase->frames.size();
+    phrases_.push_back(std::move(phrase));
+    metric_bytes.Set(total_bytes_);
+}
+
+std::shared_ptr<const PhraseCache::Phrase> PhraseCache::Find(std::string_view id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& phrase : phrases_) {
+        if (phrase->id == id) {
+            phrase->last_used = esp_timer_get_time();
+            metric_hits.Add();
+            return phrase;
+        }
+    }
+    metric_misses.Add();
+    return nullptr;
+}
@@ -0,0 +1,46 @@
+#ifndef PHRASE_CACHE_H
+#define PHRASE_CACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 缓存 ID 的最大长度
+#define PHRASE_CACHE_MAX_ID 32
+#define PHRASE_CACHE_MAX_ENTRIES 16
+
+// 重复出现的 TTS 句子（问候语、没听清、错误提示等）的 Opus 帧缓存，保存在 PSRAM 中，按 LRU 淘汰
+// 服务器在 tts start 中带上 cache_id 时，把这一轮下发的音频录下来；之后服务器只发 play_cached 和同一个 ID，
+// 设备直接从缓存播放，不再走下行
+// Record 在网络任务中调用，Find 返回的 Phrase 可以交给播放任务
+class PhraseCache {
+public:
+    struct Phrase {
+        std::string id;
+        int sample_rate = 0;
+        int frame_duration = 0;
+        // 每帧为 [长度 BE16][Opus 数据]
+        std::vector<uint8_t> frames;
+        int64_t last_used = 0;
+    };
+
+    // 开始录制这一轮 TTS，已有同名缓存时替换
+    void BeginRecord(std::string_view id);
+    void Record(int sample_rate, int frame_duration, const uint8_t* payload, size_t size);
+    // 正常结束时保存，被打断时丢弃
+    void EndRecord(bool commit);
+
+    // 返回的 Phrase 在使用期间即使被淘汰也继续有效
+    std::shared_ptr<const Phrase> Find(std::string_view id);
+
+private:
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<Phrase>> phrases_;
+    std::unique_ptr<Phrase> recording_;
+    size_t total_bytes_ = 0;
+};
+
+#endif // PHRASE_CACHE_H
@@ -0,0 +1,53 @@
+#include "playback_monitor.h"
+#include "metrics.h"
+
+#include <cJSON.h>
+
+static MetricCounter metric_network_underruns("playback.network_underruns");
+static MetricCounter metric_cpu_underruns("playback.cpu_underruns");
+static MetricCounter metric_concealed_frames("playback.concealed_frames");
+static MetricCounter metric_overflows("playback.overflows");
+
+void PlaybackMonitor::OnNetworkUnderrun() {
+    network_underruns_++;
+    metric_network_underruns.Add();
+}
+
+void PlaybackMonitor::OnCpuUnderruns(uint32_t count) {
+    cpu_underruns_ += count;
+    metric_cpu_underruns.Add(count);
+}
+
+void PlaybackMonitor::OnConcealed() {
+    concealed_frames_++;
+    metric_concealed_frames.Add();
+}
+
+void PlaybackMonitor::OnOverflows(uint32_t count) {
+    overflows_ += count;
+    metric_overflows.Add(count);
+}
+
+bool PlaybackMonitor::HasEvents() const {
+    return network_underruns_ > 0 || cpu_underruns_ > 0 || concealed_frames_ > 0 || overflows_ > 0;
+}
+
+std::string PlaybackMonitor::GetSessionJson() const {
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "network_underruns", network_underruns_);
+    cJSON_AddNumberToObject(root, "cpu_underruns", cpu_underruns_);
+    cJSON_AddNumberToObject(root, "concealed_frames", concealed_frames_);
+    cJSON_AddNumberToObject(root, "overflows", overflows_);
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
+}
+
+void PlaybackMonitor::ResetSession() {
+    network_underruns_ = 0;
+    cpu_underruns_ = 0;
+    concealed_frames_ = 0;
+    overflows_ = 0;
+}
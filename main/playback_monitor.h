@@ -0,0 +1,34 @@
+#ifndef PLAYBACK_MONITOR_H
+#define PLAYBACK_MONITOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// 中途欠载时最多用 PLC 补这么多帧，之后静音等待重新缓冲
+#define PLAYBACK_CONCEAL_MAX_FRAMES 2
+
+// 按会话统计播放的欠载和溢出，区分原因：
+// - network：解码队列在一句话中间取空，之后又收到了数据
+// - cpu：解码队列里有数据，但 I2S DMA 还是播空了（解码或调度不及时）
+// - overflow：解码队列满，网络来的包被丢掉
+// 同时累加到全局的 playback.* 指标，会话结束时可以把本次会话的统计发给服务器
+class PlaybackMonitor {
+public:
+    void OnNetworkUnderrun();
+    void OnCpuUnderruns(uint32_t count);
+    void OnConcealed();
+    void OnOverflows(uint32_t count);
+
+    bool HasEvents() const;
+    std::string GetSessionJson() const;
+    void ResetSession();
+
+private:
+    std::atomic<uint32_t> network_underruns_{0};
+    std::atomic<uint32_t> cpu_underruns_{0};
+    std::atomic<uint32_t> concealed_frames_{0};
+    std::atomic<uint32_t> overflows_{0};
+};
+
+#endif // PLAYBACK_MONITOR_H
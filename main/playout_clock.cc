@@ -0,0 +1,83 @@
+#include "playout_clock.h"
+
+#include <esp_timer.h>
+
+void PlayoutClock::Configure(int dma_samples) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    dma_samples_ = dma_samples;
+}
+
+void PlayoutClock::Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    has_stream_ = false;
+    stream_end_us_ = 0;
+    anchor_count_ = 0;
+    anchor_head_ = 0;
+}
+
+void PlayoutClock::ResetCapture() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    captured_frames_ = 0;
+    capture_read_us_ = esp_timer_get_time();
+}
+
+void PlayoutClock::OnStreamWritten(uint32_t timestamp, size_t samples, int sample_rate) {
+    int64_t duration_us = int64_t(samples) * 1000000 / sample_rate;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (timestamp != 0) {
+        has_stream_ = true;
+        stream_end_us_ = int64_t(timestamp) * 1000 + duration_us;
+    } else if (has_stream_) {
+        // 补偿帧占用下行时间轴上丢失的那一段
+        stream_end_us_ += duration_us;
+    }
+}
+
+void PlayoutClock::OnOutput(size_t tts_buffered, size_t frame_samples, int sample_rate) {
+    if (tts_buffered == 0) {
+        return;
+    }
+    // 写 I2S 阻塞返回时 DMA 已经排满，这一帧排在最后，前面还有 dma_samples_ - frame_samples 个样本没播
+    int64_t now = esp_timer_get_time();
+    int64_t queued = dma_samples_ > (int)frame_samples ? dma_samples_ - frame_samples : 0;
+    size_t played = tts_buffered < frame_samples ? tts_buffered : frame_samples;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!has_stream_) {
+        return;
+    }
+    auto& anchor = anchors_[anchor_head_];
+    anchor.play_us = now + queued * 1000000 / sample_rate;
+    anchor.stream_us = stream_end_us_ - int64_t(tts_buffered) * 1000000 / sample_rate;
+    anchor.duration_us = int64_t(played) * 1000000 / sample_rate;
+    anchor_head_ = (anchor_head_ + 1) % PLAYOUT_CLOCK_ANCHORS;
+    if (anchor_count_ < PLAYOUT_CLOCK_ANCHORS) {
+        anchor_count_++;
+    }
+}
+
+void PlayoutClock::OnCaptureRead(size_t frames) {
+    int64_t now = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(mutex_);
+    captured_frames_ += frames;
+    capture_read_us_ = now;
+}
+
+uint32_t PlayoutClock::MapCapture(uint32_t capture_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // 读返回时最后一个样本刚采集完，往前推算这个位置的采集时间
+    int64_t captured_us = int64_t(captured_frames_) * 1000 / 16;
+    int64_t capture_us = capture_read_us_ - (captured_us - int64_t(capture_ms) * 1000);
+
+    // 从最新的记录往前找覆盖这个时间点的那一帧
+    for (size_t i = 0; i < anchor_count_; i++) {
+        auto& anchor = anchors_[(anchor_head_ + PLAYOUT_CLOCK_ANCHORS - 1 - i) % PLAYOUT_CLOCK_ANCHORS];
+        if (capture_us >= anchor.play_us && capture_us < anchor.play_us + anchor.duration_us) {
+            return (anchor.stream_us + capture_us - anchor.play_us) / 1000;
+        }
+        if (capture_us >= anchor.play_us + anchor.duration_us) {
+            break;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,55 @@
+#ifndef PLAYOUT_CLOCK_H
+#define PLAYOUT_CLOCK_H
+
+#include <mutex>
+#include <cstddef>
+#include <cstdint>
+
+#define PLAYOUT_CLOCK_ANCHORS 16
+
+// 服务端 AEC 用的播放时钟
+// 播放侧记录每一帧下行音频写入 I2S DMA 后实际开始播放的本地时间和它在下行时间轴上的位置，
+// 采集侧记录每次 I2S 读返回时的采集位置，两边换算后得到上行音频采集时正在播放的下行时间戳，精度到毫秒
+class PlayoutClock {
+public:
+    // dma_samples 是播放通道 DMA 缓冲的总样本数
+    void Configure(int dma_samples);
+
+    // 新的对话轮次，清除播放记录
+    void Reset();
+    // 音频处理器启动时调用，采集位置从 0 开始，和上行门控的时间轴一致
+    void ResetCapture();
+
+    // 解码通道调用：写入混音器的一段下行 PCM，timestamp 为 0 表示丢包补偿或服务器没有下发时间戳
+    void OnStreamWritten(uint32_t timestamp, size_t samples, int sample_rate);
+    // 解码通道调用：一帧混音结果写入 I2S 之后，tts_buffered 是混音前 TTS 源缓冲的样本数
+    void OnOutput(size_t tts_buffered, size_t frame_samples, int sample_rate);
+
+    // 采集任务调用：I2S 读返回了 frames 个 16kHz 样本
+    void OnCaptureRead(size_t frames);
+    // 把采集时间轴上的毫秒位置换算成下行时间戳，当时没有在播放下行音频则返回 0
+    uint32_t MapCapture(uint32_t capture_ms);
+
+private:
+    struct Anchor {
+        int64_t play_us;
+        int64_t stream_us;
+        int64_t duration_us;
+    };
+
+    std::mutex mutex_;
+    int dma_samples_ = 0;
+
+    // 播放侧
+    bool has_stream_ = false;
+    int64_t stream_end_us_ = 0;
+    Anchor anchors_[PLAYOUT_CLOCK_ANCHORS];
+    size_t anchor_count_ = 0;
+    size_t anchor_head_ = 0;
+
+    // 采集侧
+    uint64_t captured_frames_ = 0;
+    int64_t capture_read_us_ = 0;
+};
+
+#endif // PLAYOUT_CLOCK_H
@@ -0,0 +1,114 @@
+#include "pooled_text.h"
+#include "heap_accounting.h"
+#include "metrics.h"
+
+#include <esp_log.h>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#define TAG "PooledText"
+
+static MetricGauge metric_in_use("text_pool.in_use");
+static MetricCounter metric_misses("text_pool.misses");
+
+namespace {
+
+// 启动时一次性分配 POOLED_TEXT_COUNT 块缓冲区，之后只在空闲列表里取放
+class TextPool {
+public:
+    static TextPool& GetInstance() {
+        static TextPool instance;
+        return instance;
+    }
+
+    char* Acquire() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_buffers_.empty()) {
+            return nullptr;
+        }
+        char* buffer = free_buffers_.back();
+        free_buffers_.pop_back();
+        metric_in_use.Set(capacity_ - free_buffers_.size());
+        return buffer;
+    }
+
+    void Release(char* buffer) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_buffers_.push_back(buffer);
+        metric_in_use.Set(capacity_ - free_buffers_.size());
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<char*> free_buffers_;
+    size_t capacity_ = 0;
+
+    TextPool() {
+        char* block = static_cast<char*>(HeapAccounting::MallocPreferSpiram(kHeapTagProtocol,
+            POOLED_TEXT_SIZE * POOLED_TEXT_COUNT));
+        if (block == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate text pool");
+            return;
+        }
+        capacity_ = POOLED_TEXT_COUNT;
+        free_buffers_.reserve(capacity_);
+        for (size_t i = 0; i < capacity_; i++) {
+            free_buffers_.push_back(block + i * POOLED_TEXT_SIZE);
+        }
+    }
+};
+
+} // namespace
+
+PooledText::PooledText(std::string_view text) : size_(text.size()) {
+    if (size_ < POOLED_TEXT_SIZE) {
+        data_ = TextPool::GetInstance().Acquire();
+        pooled_ = data_ != nullptr;
+    }
+    if (data_ == nullptr) {
+        // 超长文本或池已用完，临时分配
+        metric_misses.Add();
+        data_ = new char[size_ + 1];
+    }
+    memcpy(data_, text.data(), size_);
+    data_[size_] = '\0';
+}
+
+PooledText::~PooledText() {
+    Release();
+}
+
+PooledText::PooledText(PooledText&& other) noexcept
+    : data_(other.data_), size_(other.size_), pooled_(other.pooled_) {
+    other.data_ = nullptr;
+    other.size_ = 0;
+    other.pooled_ = false;
+}
+
+PooledText& PooledText::operator=(PooledText&& other) noexcept {
+    if (this != &other) {
+        Release();
+        data_ = other.data_;
+        size_ = other.size_;
+        pooled_ = other.pooled_;
+        other.data_ = nullptr;
+        other.size_ = 0;
+        other.pooled_ = false;
+    }
+    return *this;
+}
+
+void PooledText::Release() {
+    if (data_ == nullptr) {
+        return;
+    }
+    if (pooled_) {
+        TextPool::GetInstance().Release(data_);
+    } else {
+        delete[] data_;
+    }
+    data_ = nullptr;
+    size_ = 0;
+    pooled_ = false;
+}
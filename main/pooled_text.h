@@ -0,0 +1,35 @@
+#ifndef POOLED_TEXT_H
+#define POOLED_TEXT_H
+
+#include <cstddef>
+#include <string_view>
+
+// 一句字幕或情绪等消息文本的副本，缓冲区来自启动时分配的固定大小的池，用完自动归还
+// 只能移动，可以直接捕获到 Schedule 的回调里；文本超过 POOLED_TEXT_SIZE 或池用完时临时分配
+#define POOLED_TEXT_SIZE 512
+#define POOLED_TEXT_COUNT 8
+
+class PooledText {
+public:
+    PooledText() = default;
+    explicit PooledText(std::string_view text);
+    ~PooledText();
+
+    PooledText(PooledText&& other) noexcept;
+    PooledText& operator=(PooledText&& other) noexcept;
+    PooledText(const PooledText&) = delete;
+    PooledText& operator=(const PooledText&) = delete;
+
+    const char* c_str() const { return data_ != nullptr ? data_ : ""; }
+    size_t size() const { return size_; }
+    std::string_view view() const { return std::string_view(c_str(), size_); }
+
+private:
+    char* data_ = nullptr;
+    size_t size_ = 0;
+    bool pooled_ = false;
+
+    void Release();
+};
+
+#endif // POOLED_TEXT_H
@@ -0,0 +1,105 @@
+#include "power_governor.h"
+#include "metrics.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#define TAG "PowerGovernor"
+
+static MetricGauge metric_active_s("power.active_s");
+static MetricGauge metric_idle_s("power.idle_s");
+static MetricCounter metric_boosts("power.boosts");
+static MetricGauge metric_boost_ms("power.boost_ms");
+
+void PowerGovernor::Initialize() {
+#if CONFIG_POWER_GOVERNOR
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_POWER_GOVERNOR_IDLE_FREQ_MHZ,
+        .light_sleep_enable = true,
+    };
+    esp_err_t ret = esp_pm_configure(&pm_config);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to configure power management: %s", esp_err_to_name(ret));
+        return;
+    }
+    ESP_ERROR_CHECK(esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "pm_active", &cpu_lock_));
+    ESP_ERROR_CHECK(esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "pm_no_sleep", &no_sleep_lock_));
+    ESP_ERROR_CHECK(esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "pm_boost", &boost_lock_));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    enabled_ = true;
+    profile_start_us_ = esp_timer_get_time();
+    ApplyProfile(profile_);
+    ESP_LOGI(TAG, "DFS %d-%d MHz, light sleep enabled", CONFIG_POWER_GOVERNOR_IDLE_FREQ_MHZ,
+        CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+#endif
+}
+
+// 调用者需要持有 mutex_
+void PowerGovernor::ApplyProfile(PowerProfile profile) {
+    if (profile == kPowerProfileActive) {
+        esp_pm_lock_acquire(cpu_lock_);
+        esp_pm_lock_acquire(no_sleep_lock_);
+    } else {
+        esp_pm_lock_release(no_sleep_lock_);
+        esp_pm_lock_release(cpu_lock_);
+    }
+}
+
+void PowerGovernor::SetProfile(PowerProfile profile) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (profile == profile_) {
+        return;
+    }
+    if (enabled()) {
+        int64_t now = esp_timer_get_time();
+        residency_us_[profile_] += now - profile_start_us_;
+        profile_start_us_ = now;
+        ApplyProfile(profile);
+    }
+    profile_ = profile;
+}
+
+void PowerGovernor::Boost() {
+    if (enabled()) {
+        esp_pm_lock_acquire(boost_lock_);
+    }
+}
+
+void PowerGovernor::Unboost(uint32_t boost_us) {
+    if (enabled()) {
+        esp_pm_lock_release(boost_lock_);
+        metric_boosts.Add();
+        boost_us_.fetch_add(boost_us, std::memory_order_relaxed);
+    }
+}
+
+void PowerGovernor::UpdateMetrics() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!enabled()) {
+        return;
+    }
+    int64_t residency[kPowerProfileCount];
+    for (int i = 0; i < kPowerProfileCount; i++) {
+        residency[i] = residency_us_[i];
+    }
+    residency[profile_] += esp_timer_get_time() - profile_start_us_;
+    metric_active_s.Set(residency[kPowerProfileActive] / 1000000);
+    metric_idle_s.Set(residency[kPowerProfileIdle] / 1000000);
+    metric_boost_ms.Set(boost_us_.load(std::memory_order_relaxed) / 1000);
+}
+
+PowerBoostGuard::PowerBoostGuard() {
+    auto& governor = PowerGovernor::GetInstance();
+    if (governor.enabled()) {
+        governor.Boost();
+        start_us_ = esp_timer_get_time();
+    }
+}
+
+PowerBoostGuard::~PowerBoostGuard() {
+    if (start_us_ != 0) {
+        PowerGovernor::GetInstance().Unboost(esp_timer_get_time() - start_us_);
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef POWER_GOVERNOR_H
+#define POWER_GOVERNOR_H
+
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+
+#include <esp_pm.h>
+
+enum PowerProfile {
+    kPowerProfileActive,    // 联网、聆听、说话等：CPU 最高频率，不进入 light sleep
+    kPowerProfileIdle,      // 待机唤醒词检测：降频并允许 light sleep
+    kPowerProfileCount
+};
+
+// 按设备状态调整 CPU 频率和 light sleep（CONFIG_POWER_GOVERNOR）
+// 启动时配置 DFS 并允许自动 light sleep，活动状态持有最高频率和禁止 light sleep 的锁；
+// 空闲时不持有锁，只在编解码、唤醒词计算期间用 PowerBoostGuard 临时升到最高频率
+// I2S、SPI 等驱动在传输期间会自己持有 APB 锁，不需要在外面再加锁
+class PowerGovernor {
+public:
+    static PowerGovernor& GetInstance() {
+        static PowerGovernor instance;
+        return instance;
+    }
+
+    void Initialize();
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+    // 由 Application::SetDeviceState 调用
+    void SetProfile(PowerProfile profile);
+    void Boost();
+    void Unboost(uint32_t boost_us);
+    // 更新各状态的驻留时间指标，由时钟定时器在采样前调用
+    void UpdateMetrics();
+
+private:
+    std::atomic<bool> enabled_{false};
+    std::atomic<uint64_t> boost_us_{0};
+    std::mutex mutex_;
+    PowerProfile profile_ = kPowerProfileActive;
+    int64_t profile_start_us_ = 0;
+    int64_t residency_us_[kPowerProfileCount] = {};
+    esp_pm_lock_handle_t cpu_lock_ = nullptr;
+    esp_pm_lock_handle_t no_sleep_lock_ = nullptr;
+    esp_pm_lock_handle_t boost_lock_ = nullptr;
+
+    PowerGovernor() = default;
+    void ApplyProfile(PowerProfile profile);
+};
+
+// 计算突发期间保持 CPU 最高频率，PowerGovernor 关闭时为空操作
+class PowerBoostGuard {
+public:
+    PowerBoostGuard();
+    ~PowerBoostGuard();
+    PowerBoostGuard(const PowerBoostGuard&) = delete;
+    PowerBoostGuard& operator=(const PowerBoostGuard&) = delete;
+
+private:
+    int64_t start_us_ = 0;
+};
+
+#endif // POWER_GOVERNOR_H
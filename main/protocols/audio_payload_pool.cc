@@ -0,0 +1,46 @@
+#include "audio_payload_pool.h"
+
+#include <esp_log.h>
+
+#define TAG "AudioPayloadPool"
+
+AudioPayloadPool::AudioPayloadPool() {
+    capacity_ = CONFIG_AUDIO_PAYLOAD_POOL_SIZE;
+    free_buffers_.reserve(capacity_);
+    for (size_t i = 0; i < capacity_; i++) {
+        std::vector<uint8_t> buffer;
+        buffer.reserve(AUDIO_PAYLOAD_MAX_SIZE);
+        free_buffers_.emplace_back(std::move(buffer));
+    }
+}
+
+std::vector<uint8_t> AudioPayloadPool::Acquire() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_buffers_.empty()) {
+        misses_++;
+        if ((misses_ & (misses_ - 1)) == 0) {
+            ESP_LOGW(TAG, "Pool exhausted, capacity: %u, misses: %u", capacity_, misses_);
+        }
+        std::vector<uint8_t> buffer;
+        buffer.reserve(AUDIO_PAYLOAD_MAX_SIZE);
+        return buffer;
+    }
+    auto buffer = std::move(free_buffers_.back());
+    free_buffers_.pop_back();
+    size_t in_use = capacity_ - free_buffers_.size();
+    if (in_use > high_water_) {
+        high_water_ = in_use;
+    }
+    return buffer;
+}
+
+void AudioPayloadPool::Release(std::vector<uint8_t>&& payload) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // 被移走或容量不足的缓冲区直接丢弃，池满时多出来的也丢弃
+    // 没能归还的缓冲区会由后续临时分配的缓冲区补上
+    if (payload.capacity() < AUDIO_PAYLOAD_MAX_SIZE || free_buffers_.size() >= capacity_) {
+        return;
+    }
+    payload.clear();
+    free_buffers_.emplace_back(std::move(payload));
+}
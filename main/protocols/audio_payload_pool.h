@@ -0,0 +1,43 @@
+#ifndef AUDIO_PAYLOAD_POOL_H
+#define AUDIO_PAYLOAD_POOL_H
+
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+// Opus 单帧最大约 1500 字节
+#define AUDIO_PAYLOAD_MAX_SIZE 1500
+
+// 音频包负载缓冲池，Acquire() 取出一个预留好容量的 vector，用完后 Release() 归还
+// 池里的缓冲区在启动时一次性分配，之后收发音频包不再反复 malloc/free
+class AudioPayloadPool {
+public:
+    static AudioPayloadPool& GetInstance() {
+        static AudioPayloadPool instance;
+        return instance;
+    }
+    // 删除拷贝构造函数和赋值运算符
+    AudioPayloadPool(const AudioPayloadPool&) = delete;
+    AudioPayloadPool& operator=(const AudioPayloadPool&) = delete;
+
+    std::vector<uint8_t> Acquire();
+    void Release(std::vector<uint8_t>&& payload);
+
+    size_t capacity() const { return capacity_; }
+    size_t in_use() const { return capacity_ - free_buffers_.size(); }
+    size_t high_water() const { return high_water_; }
+    size_t misses() const { return misses_; }
+
+private:
+    AudioPayloadPool();
+    ~AudioPayloadPool() = default;
+
+    std::mutex mutex_;
+    std::vector<std::vector<uint8_t>> free_buffers_;
+    size_t capacity_ = 0;
+    size_t high_water_ = 0;
+    size_t misses_ = 0;
+};
+
+#endif // AUDIO_PAYLOAD_POOL_H
@@ -0,0 +1,95 @@
+#include "binary_frame.h"
+
+static inline uint16_t ReadBe16(const uint8_t* p) {
+    return (p[0] << 8) | p[1];
+}
+
+static inline uint32_t ReadBe32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+bool ParseBinaryFrame(int version, const uint8_t* data, size_t length, BinaryFrame& frame) {
+    frame = BinaryFrame();
+    if (version == 2) {
+        if (length < sizeof(BinaryProtocol2)) {
+            return false;
+        }
+        uint32_t payload_size = ReadBe32(data + offsetof(BinaryProtocol2, payload_size));
+        if (payload_size > length - sizeof(BinaryProtocol2)) {
+            return false;
+        }
+        frame.type = ReadBe16(data + offsetof(BinaryProtocol2, type));
+        frame.timestamp = ReadBe32(data + offsetof(BinaryProtocol2, timestamp));
+        frame.payload = data + sizeof(BinaryProtocol2);
+        frame.payload_size = payload_size;
+        return true;
+    }
+    if (version == 3 || (version == 4 && length > 0 && data[0] == BINARY_PROTOCOL_TYPE_CONTROL)) {
+        if (length < sizeof(BinaryProtocol3)) {
+            return false;
+        }
+        uint16_t payload_size = ReadBe16(data + offsetof(BinaryProtocol3, payload_size));
+        if (payload_size > length - sizeof(BinaryProtocol3)) {
+            return false;
+        }
+        frame.type = data[0];
+        frame.payload = data + sizeof(BinaryProtocol3);
+        frame.payload_size = payload_size;
+        return true;
+    }
+    if (version == 4) {
+        if (length < sizeof(BinaryProtocol4)) {
+            return false;
+        }
+        frame.type = data[0];
+        frame.frame_count = data[offsetof(BinaryProtocol4, frame_count)];
+        frame.timestamp = ReadBe32(data + offsetof(BinaryProtocol4, timestamp));
+        frame.payload = data + sizeof(BinaryProtocol4);
+        frame.payload_size = length - sizeof(BinaryProtocol4);
+        return true;
+    }
+    if (version == 5) {
+        if (length < sizeof(BinaryProtocol5)) {
+            return false;
+        }
+        uint16_t payload_size = ReadBe16(data + offsetof(BinaryProtocol5, payload_size));
+        if (payload_size > length - sizeof(BinaryProtocol5)) {
+            return false;
+        }
+        frame.type = data[0];
+        frame.flags = data[offsetof(BinaryProtocol5, flags)];
+        frame.sequence = ReadBe32(data + offsetof(BinaryProtocol5, sequence));
+        frame.timestamp = ReadBe32(data + offsetof(BinaryProtocol5, timestamp));
+        frame.payload = data + sizeof(BinaryProtocol5);
+        frame.payload_size = payload_size;
+        return true;
+    }
+    frame.payload = data;
+    frame.payload_size = length;
+    return true;
+}
+
+BinaryBatchReader::BinaryBatchReader(const BinaryFrame& frame)
+    : position_(frame.payload), end_(frame.payload + frame.payload_size), remaining_(frame.frame_count) {
+}
+
+bool BinaryBatchReader::Next(const uint8_t*& payload, size_t& size) {
+    if (remaining_ <= 0) {
+        return false;
+    }
+    if (end_ - position_ < 2) {
+        truncated_ = true;
+        return false;
+    }
+    size_t frame_size = ReadBe16(position_);
+    position_ += 2;
+    if ((size_t)(end_ - position_) < frame_size) {
+        truncated_ = true;
+        return false;
+    }
+    payload = position_;
+    size = frame_size;
+    position_ += frame_size;
+    remaining_--;
+    return true;
+}
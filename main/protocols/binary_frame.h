@@ -0,0 +1,89 @@
+#ifndef BINARY_FRAME_H
+#define BINARY_FRAME_H
+
+#include <cstdint>
+#include <cstddef>
+
+// WebSocket 二进制帧的格式和解析
+// 这里只依赖标准库，不引用 ESP-IDF 的头文件，可以单独放到主机上编译做性能分析和模糊测试
+
+// 二进制包的 type 字段，协商 compact_control 后控制消息也走二进制帧
+#define BINARY_PROTOCOL_TYPE_OPUS 0
+#define BINARY_PROTOCOL_TYPE_JSON 1
+#define BINARY_PROTOCOL_TYPE_CONTROL 2
+#define BINARY_PROTOCOL_TYPE_STREAM 3
+
+struct BinaryProtocol2 {
+    uint16_t version;
+    uint16_t type;          // Message type (0: OPUS, 1: JSON, 2: CONTROL)
+    uint32_t reserved;      // Reserved for future use
+    uint32_t timestamp;     // Timestamp in milliseconds (used for server-side AEC)
+    uint32_t payload_size;  // Payload size in bytes
+    uint8_t payload[];      // Payload data
+} __attribute__((packed));
+
+struct BinaryProtocol3 {
+    uint8_t type;
+    uint8_t reserved;
+    uint16_t payload_size;
+    uint8_t payload[];
+} __attribute__((packed));
+
+// 多帧合并的二进制包，每帧前面带 2 字节长度（网络字节序）
+// [type][frame_count][reserved][timestamp] [len0][frame0] [len1][frame1] ...
+struct BinaryProtocol4 {
+    uint8_t type;
+    uint8_t frame_count;
+    uint16_t reserved;
+    uint32_t timestamp;     // 第一帧的时间戳，后续帧依次加 frame_duration
+    uint8_t payload[];
+} __attribute__((packed));
+
+// 带序号的二进制包，音频、控制和数据流共用同一个头，控制和数据流帧的 sequence 为 0
+// [type][flags][payload_size][sequence][timestamp] [payload]
+struct BinaryProtocol5 {
+    uint8_t type;
+    uint8_t flags;          // BINARY_FRAME_FLAG_*
+    uint16_t payload_size;
+    uint32_t sequence;      // 每个方向的音频帧从 1 开始连续递增，接收方据此重排和识别丢包
+    uint32_t timestamp;
+    uint8_t payload[];
+} __attribute__((packed));
+
+// 版本 5 音频帧的 flags
+#define BINARY_FRAME_FLAG_FEC 0x01      // 帧内带有上一帧的带内 FEC
+#define BINARY_FRAME_FLAG_DTX 0x02      // DTX 静音帧
+#define BINARY_FRAME_FLAG_END 0x04      // 一段话的结束，payload 可以为空
+
+// 解析后的帧头，payload 指向输入缓冲区
+struct BinaryFrame {
+    uint8_t type = BINARY_PROTOCOL_TYPE_OPUS;
+    uint32_t timestamp = 0;
+    uint32_t sequence = 0;  // 只有版本 5 的音频帧非 0
+    uint8_t flags = 0;
+    const uint8_t* payload = nullptr;
+    size_t payload_size = 0;
+    int frame_count = 0;    // 只有版本 4 的合并音频包大于 0，payload 是长度表和各帧数据
+};
+
+// 按协议版本解析收到的二进制消息，头不完整或长度字段越界时返回 false
+// 版本 1 是裸 Opus 数据；版本 4 的控制帧使用 BinaryProtocol3 的头
+bool ParseBinaryFrame(int version, const uint8_t* data, size_t length, BinaryFrame& frame);
+
+// 逐帧读出版本 4 合并包中的 Opus 帧，长度表越界时停止
+class BinaryBatchReader {
+public:
+    explicit BinaryBatchReader(const BinaryFrame& frame);
+
+    bool Next(const uint8_t*& payload, size_t& size);
+    // Next 在长度表越界时返回 false 后为 true
+    bool truncated() const { return truncated_; }
+
+private:
+    const uint8_t* position_;
+    const uint8_t* end_;
+    int remaining_;
+    bool truncated_ = false;
+};
+
+#endif // BINARY_FRAME_H
@@ -0,0 +1,199 @@
+#include "control_message.h"
+
+#include <esp_log.h>
+#include <cstring>
+
+#define TAG "ControlMessage"
+
+// 名字的哈希在编译期算好，解析时只比较整数
+static constexpr struct {
+    const char* name;
+    uint32_t hash;
+    ControlMessageType type;
+} TYPE_NAMES[] = {
+    {"tts", MessageHash("tts"), kControlTts},
+    {"stt", MessageHash("stt"), kControlStt},
+    {"llm", MessageHash("llm"), kControlLlm},
+    {"mcp", MessageHash("mcp"), kControlMcp},
+    {"system", MessageHash("system"), kControlSystem},
+    {"alert", MessageHash("alert"), kControlAlert},
+    {"listen", MessageHash("listen"), kControlListen},
+    {"abort", MessageHash("abort"), kControlAbort},
+};
+
+static constexpr struct {
+    const char* name;
+    uint32_t hash;
+    ControlState state;
+} STATE_NAMES[] = {
+    {"start", MessageHash("start"), kControlStateStart},
+    {"stop", MessageHash("stop"), kControlStateStop},
+    {"sentence_start", MessageHash("sentence_start"), kControlStateSentenceStart},
+    {"detect", MessageHash("detect"), kControlStateDetect},
+    {"play_cached", MessageHash("play_cached"), kControlStatePlayCached},
+};
+
+static const struct {
+    const char* name;
+    ControlField tag;
+} STRING_FIELDS[] = {
+    {"text", kControlFieldText},
+    {"emotion", kControlFieldEmotion},
+    {"command", kControlFieldCommand},
+    {"status", kControlFieldStatus},
+    {"message", kControlFieldMessage},
+    {"session_id", kControlFieldSessionId},
+    {"cache_id", kControlFieldCacheId},
+};
+
+bool ControlMessage::Has(ControlField tag) const {
+    for (int i = 0; i < field_count_; i++) {
+        if (fields_[i].tag == tag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string_view ControlMessage::Get(ControlField tag) const {
+    for (int i = 0; i < field_count_; i++) {
+        if (fields_[i].tag == tag) {
+            return std::string_view(fields_[i].data, fields_[i].size);
+        }
+    }
+    return std::string_view();
+}
+
+uint8_t ControlMessage::GetU8(ControlField tag, uint8_t default_value) const {
+    auto value = Get(tag);
+    return value.size() == 1 ? static_cast<uint8_t>(value[0]) : default_value;
+}
+
+void ControlMessage::AddField(ControlField tag, const char* data, size_t size) {
+    if (field_count_ >= CONTROL_MESSAGE_MAX_FIELDS || size > UINT16_MAX) {
+        return;
+    }
+    fields_[field_count_++] = {tag, data, static_cast<uint16_t>(size)};
+}
+
+void ControlMessage::AddEnumField(ControlField tag, uint8_t value) {
+    if (field_count_ >= CONTROL_MESSAGE_MAX_FIELDS) {
+        return;
+    }
+    enum_values_[field_count_] = value;
+    AddField(tag, reinterpret_cast<const char*>(&enum_values_[field_count_]), 1);
+}
+
+bool ControlMessage::Parse(const uint8_t* data, size_t size) {
+    type_ = kControlUnknown;
+    type_name_ = std::string_view();
+    type_hash_ = 0;
+    state_hash_ = 0;
+    json_ = nullptr;
+    field_count_ = 0;
+    if (size < CONTROL_MESSAGE_HEADER_SIZE || data[0] != CONTROL_MESSAGE_MAGIC) {
+        return false;
+    }
+
+    int count = data[2];
+    const uint8_t* p = data + CONTROL_MESSAGE_HEADER_SIZE;
+    const uint8_t* end = data + size;
+    for (int i = 0; i < count; i++) {
+        if (p + 3 > end) {
+            ESP_LOGW(TAG, "Truncated control message");
+            return false;
+        }
+        uint16_t len = (p[1] << 8) | p[2];
+        if (p + 3 + len > end) {
+            ESP_LOGW(TAG, "Invalid control field size: %u", len);
+            return false;
+        }
+        if (field_count_ < CONTROL_MESSAGE_MAX_FIELDS) {
+            fields_[field_count_++] = {static_cast<ControlField>(p[0]), reinterpret_cast<const char*>(p + 3), len};
+        }
+        p += 3 + len;
+    }
+    type_ = static_cast<ControlMessageType>(data[1]);
+    // 二进制消息用类型和状态对应的 JSON 名字的哈希，两种编码走同一张分发表
+    for (auto& item : TYPE_NAMES) {
+        if (item.type == type_) {
+            type_name_ = item.name;
+            type_hash_ = item.hash;
+            break;
+        }
+    }
+    ControlState value = state();
+    for (auto& item : STATE_NAMES) {
+        if (item.state == value) {
+            state_hash_ = item.hash;
+            break;
+        }
+    }
+    return true;
+}
+
+bool ControlMessage::FromJson(const cJSON* root) {
+    type_ = kControlUnknown;
+    type_name_ = std::string_view();
+    type_hash_ = 0;
+    state_hash_ = 0;
+    json_ = root;
+    field_count_ = 0;
+    auto type = cJSON_GetObjectItem(root, "type");
+    if (!cJSON_IsString(type)) {
+        return false;
+    }
+    type_name_ = type->valuestring;
+    type_hash_ = MessageHash(type_name_);
+    for (auto& item : TYPE_NAMES) {
+        if (item.hash == type_hash_) {
+            type_ = item.type;
+            break;
+        }
+    }
+
+    auto state = cJSON_GetObjectItem(root, "state");
+    if (cJSON_IsString(state)) {
+        state_hash_ = MessageHash(state->valuestring);
+        ControlState value = kControlStateNone;
+        for (auto& item : STATE_NAMES) {
+            if (item.hash == state_hash_) {
+                value = item.state;
+                break;
+            }
+        }
+        AddEnumField(kControlFieldState, value);
+    }
+    for (auto& item : STRING_FIELDS) {
+        auto field = cJSON_GetObjectItem(root, item.name);
+        if (cJSON_IsString(field)) {
+            AddField(item.tag, field->valuestring, strlen(field->valuestring));
+        }
+    }
+    return true;
+}
+
+ControlMessageWriter::ControlMessageWriter(std::string& buffer, ControlMessageType type) : buffer_(buffer) {
+    buffer_.clear();
+    buffer_.push_back(static_cast<char>(CONTROL_MESSAGE_MAGIC));
+    buffer_.push_back(static_cast<char>(type));
+    buffer_.push_back(0);
+}
+
+ControlMessageWriter& ControlMessageWriter::Add(ControlField tag, std::string_view value) {
+    if (value.size() > UINT16_MAX || static_cast<uint8_t>(buffer_[2]) == UINT8_MAX) {
+        ESP_LOGE(TAG, "Control field %d is too large", tag);
+        return *this;
+    }
+    buffer_.push_back(static_cast<char>(tag));
+    buffer_.push_back(static_cast<char>(value.size() >> 8));
+    buffer_.push_back(static_cast<char>(value.size() & 0xFF));
+    buffer_.append(value.data(), value.size());
+    buffer_[2] = static_cast<char>(static_cast<uint8_t>(buffer_[2]) + 1);
+    return *this;
+}
+
+ControlMessageWriter& ControlMessageWriter::AddU8(ControlField tag, uint8_t value) {
+    char byte = static_cast<char>(value);
+    return Add(tag, std::string_view(&byte, 1));
+}
@@ -0,0 +1,116 @@
+#ifndef CONTROL_MESSAGE_H
+#define CONTROL_MESSAGE_H
+
+#include <cJSON.h>
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+// 紧凑的二进制控制消息，和 JSON 文本消息一一对应，hello 中协商 compact_control 后使用
+// [magic][type][field_count] {[tag][len BE16][value]} ...
+#define CONTROL_MESSAGE_MAGIC 0xC7
+#define CONTROL_MESSAGE_HEADER_SIZE 3
+#define CONTROL_MESSAGE_MAX_FIELDS 8
+
+// 消息类型和状态名的 FNV-1a 哈希，可以在编译期计算，用作分发表和 switch 的键
+constexpr uint32_t MessageHash(std::string_view name) {
+    uint32_t hash = 2166136261u;
+    for (char c : name) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+    }
+    return hash;
+}
+
+enum ControlMessageType : uint8_t {
+    kControlUnknown = 0,
+    kControlTts = 1,
+    kControlStt = 2,
+    kControlLlm = 3,
+    kControlMcp = 4,
+    kControlSystem = 5,
+    kControlAlert = 6,
+    kControlListen = 7,
+    kControlAbort = 8,
+};
+
+enum ControlField : uint8_t {
+    kControlFieldState = 1,     // 1 字节 ControlState
+    kControlFieldText = 2,
+    kControlFieldEmotion = 3,
+    kControlFieldMode = 4,      // 1 字节 ListeningMode
+    kControlFieldReason = 5,    // 1 字节 AbortReason
+    kControlFieldPayload = 6,   // MCP 的 JSON-RPC 文本
+    kControlFieldCommand = 7,
+    kControlFieldStatus = 8,
+    kControlFieldMessage = 9,
+    kControlFieldSessionId = 10,
+    kControlFieldCacheId = 11,
+    kControlFieldChunk = 12,    // MCP 分块：message_id BE32、index BE16、last 1 字节
+};
+
+enum ControlState : uint8_t {
+    kControlStateNone = 0,
+    kControlStateStart = 1,
+    kControlStateStop = 2,
+    kControlStateSentenceStart = 3,
+    kControlStateDetect = 4,
+    kControlStatePlayCached = 5,
+};
+
+// 控制消息的只读视图，字段直接指向接收缓冲区（或 cJSON 节点），只在回调期间有效
+// 二进制字段不以 0 结尾，需要 C 字符串时自行拷贝
+class ControlMessage {
+public:
+    // 没有二进制编码的 JSON 消息类型（例如 iot 或板子自定义的类型）为 kControlUnknown，用 type_hash() 区分
+    ControlMessageType type() const { return type_; }
+    std::string_view type_name() const { return type_name_; }
+    uint32_t type_hash() const { return type_hash_; }
+    // 没有 state 字段时为 0
+    uint32_t state_hash() const { return state_hash_; }
+    // JSON 消息的原始节点，二进制消息为 nullptr
+    const cJSON* json() const { return json_; }
+
+    bool Has(ControlField tag) const;
+    std::string_view Get(ControlField tag) const;
+    uint8_t GetU8(ControlField tag, uint8_t default_value = 0) const;
+    ControlState state() const { return static_cast<ControlState>(GetU8(kControlFieldState)); }
+
+    // 解析二进制帧，格式错误返回 false
+    bool Parse(const uint8_t* data, size_t size);
+    // 把带 type 字段的 JSON 消息映射为同样的视图，没有 type 字段时返回 false
+    bool FromJson(const cJSON* root);
+
+private:
+    struct Field {
+        ControlField tag;
+        const char* data;
+        uint16_t size;
+    };
+
+    ControlMessageType type_ = kControlUnknown;
+    std::string_view type_name_;
+    uint32_t type_hash_ = 0;
+    uint32_t state_hash_ = 0;
+    const cJSON* json_ = nullptr;
+    Field fields_[CONTROL_MESSAGE_MAX_FIELDS];
+    int field_count_ = 0;
+    // JSON 中的枚举字段转换后的值，Field 指向这里
+    uint8_t enum_values_[CONTROL_MESSAGE_MAX_FIELDS];
+
+    void AddField(ControlField tag, const char* data, size_t size);
+    void AddEnumField(ControlField tag, uint8_t value);
+};
+
+// 编码控制消息，写入调用方提供的缓冲区以便复用
+class ControlMessageWriter {
+public:
+    ControlMessageWriter(std::string& buffer, ControlMessageType type);
+
+    ControlMessageWriter& Add(ControlField tag, std::string_view value);
+    ControlMessageWriter& AddU8(ControlField tag, uint8_t value);
+
+private:
+    std::string& buffer_;
+};
+
+#endif // CONTROL_MESSAGE_H
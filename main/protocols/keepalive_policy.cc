@@ -0,0 +1,97 @@
+#include "keepalive_policy.h"
+#include "settings.h"
+#include "metrics.h"
+
+#include <esp_log.h>
+#include <esp_wifi.h>
+#include <algorithm>
+
+#define TAG "KeepalivePolicy"
+
+static MetricGauge metric_interval("keepalive.interval_s");
+static MetricGauge metric_learned("keepalive.learned_s");
+static MetricCounter metric_probes("keepalive.probes");
+static MetricCounter metric_expired("keepalive.expired");
+
+std::string KeepalivePolicy::NetworkKey() {
+    // NAT 由路由器决定，同一个 SSID 下的 AP 通常在同一个网关后面
+    std::string network = "cell";
+    wifi_ap_record_t ap = {};
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+        network = reinterpret_cast<const char*>(ap.ssid);
+    }
+    // NVS 的 key 最长 15 个字符，用 FNV-1a 哈希
+    uint32_t hash = 2166136261u;
+    for (char c : network) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+    }
+    char key[10];
+    snprintf(key, sizeof(key), "%08lx", static_cast<unsigned long>(hash));
+    return key;
+}
+
+void KeepalivePolicy::Load() {
+    key_ = NetworkKey();
+    Settings settings("keepalive", false);
+    alive_ = settings.GetInt("a" + key_);
+    expired_ = settings.GetInt("e" + key_);
+    interval_ = std::clamp(alive_ > 0 ? alive_ : KEEPALIVE_INITIAL_SECONDS, KEEPALIVE_MIN_SECONDS, KEEPALIVE_MAX_SECONDS);
+    hold_ = 0;
+    backoff_ = 1;
+    ESP_LOGI(TAG, "Network %s: alive %d s, expired %d s, interval %d s", key_.c_str(), alive_, expired_, interval_);
+    UpdateMetrics();
+}
+
+void KeepalivePolicy::Save() {
+    Settings settings("keepalive", true);
+    settings.SetInt("a" + key_, alive_);
+    settings.SetInt("e" + key_, expired_);
+}
+
+void KeepalivePolicy::UpdateMetrics() const {
+    metric_interval.Set(interval_);
+    metric_learned.Set(alive_);
+}
+
+void KeepalivePolicy::OnAlive(int idle_seconds) {
+    metric_probes.Add();
+    bool changed = idle_seconds > alive_;
+    alive_ = std::max(alive_, idle_seconds);
+    if (expired_ > 0 && alive_ >= expired_) {
+        // 网关的超时变长了，之前的上限不再有效
+        expired_ = 0;
+        changed = true;
+    }
+    if (hold_ > 0) {
+        hold_--;
+    } else {
+        // 每次加长 1/4，不超过已知的上限
+        int next = interval_ + std::max(interval_ / 4, 5);
+        if (expired_ > 0) {
+            next = std::min(next, expired_ - KEEPALIVE_REPLY_TIMEOUT_SECONDS);
+        }
+        interval_ = std::clamp(std::max(next, interval_), KEEPALIVE_MIN_SECONDS, KEEPALIVE_MAX_SECONDS);
+        backoff_ = std::max(backoff_ / 2, 1);
+    }
+    if (changed) {
+        Save();
+    }
+    UpdateMetrics();
+}
+
+void KeepalivePolicy::OnExpired(int idle_seconds) {
+    metric_probes.Add();
+    metric_expired.Add();
+    expired_ = expired_ > 0 ? std::min(expired_, idle_seconds) : idle_seconds;
+    if (alive_ >= expired_) {
+        alive_ = 0;
+    }
+    // 回到确认存活的间隔，没有时从上限的一半开始
+    interval_ = std::clamp(alive_ > 0 ? alive_ : expired_ / 2, KEEPALIVE_MIN_SECONDS, KEEPALIVE_MAX_SECONDS);
+    hold_ = backoff_;
+    backoff_ = std::min(backoff_ * 2, KEEPALIVE_MAX_BACKOFF);
+    ESP_LOGW(TAG, "Connection expired after %d s idle, interval %d s, next probe after %d keepalives",
+        idle_seconds, interval_, hold_);
+    Save();
+    UpdateMetrics();
+}
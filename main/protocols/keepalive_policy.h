@@ -0,0 +1,45 @@
+#ifndef KEEPALIVE_POLICY_H
+#define KEEPALIVE_POLICY_H
+
+#include <string>
+
+#define KEEPALIVE_MIN_SECONDS 15
+// 服务器和设备端都有 120 秒的通道超时，保活间隔不能更长
+#define KEEPALIVE_MAX_SECONDS 110
+#define KEEPALIVE_INITIAL_SECONDS 30
+// 发出保活后等待服务器回复的时间
+#define KEEPALIVE_REPLY_TIMEOUT_SECONDS 5
+// 探测失败后，最多要连续成功这么多次才继续向上探测
+#define KEEPALIVE_MAX_BACKOFF 32
+
+// 按网络学习 NAT / 运营商网关回收空闲连接的时间，在不断线的前提下让保活间隔尽量长，减少射频唤醒
+// 每次保活都是一次探测：空闲 N 秒后收到回复说明映射还在，下一次间隔加长；没有回复说明已经过期，
+// 记下这个上限，回到确认存活的间隔，并按指数退避推迟下一次向上探测
+// 学到的结果按 Wi-Fi 的 SSID（蜂窝网络共用一项）保存在 NVS 中，只在主循环中访问
+class KeepalivePolicy {
+public:
+    // 打开通道时调用，加载当前网络的记录
+    void Load();
+    int interval_seconds() const { return interval_; }
+    // 已经遇到过连接被回收，interval_seconds() 是学到的上限
+    bool has_limit() const { return expired_ > 0; }
+
+    // 空闲 idle_seconds 后发出的保活收到了回复
+    void OnAlive(int idle_seconds);
+    // 空闲 idle_seconds 后发出的保活没有回复
+    void OnExpired(int idle_seconds);
+
+private:
+    std::string key_;
+    int alive_ = 0;         // 确认存活的最长空闲时间
+    int expired_ = 0;       // 确认过期的最短空闲时间，0 表示还没有遇到
+    int interval_ = KEEPALIVE_INITIAL_SECONDS;
+    int hold_ = 0;          // 还要成功多少次才继续向上探测
+    int backoff_ = 1;
+
+    void Save();
+    void UpdateMetrics() const;
+    static std::string NetworkKey();
+};
+
+#endif // KEEPALIVE_POLICY_H
@@ -0,0 +1,48 @@
+#include "message_dispatcher.h"
+
+#include <esp_log.h>
+#include <algorithm>
+
+#define TAG "MessageDispatcher"
+
+void MessageDispatcher::Register(uint32_t type_hash, MessageHandler handler) {
+    Register(type_hash, 0, std::move(handler));
+}
+
+void MessageDispatcher::Register(uint32_t type_hash, uint32_t state_hash, MessageHandler handler) {
+    uint64_t key = MakeKey(type_hash, state_hash);
+    auto it = std::lower_bound(entries_.begin(), entries_.end(), key, [](const Entry& entry, uint64_t value) {
+        return entry.key < value;
+    });
+    if (it != entries_.end() && it->key == key) {
+        ESP_LOGW(TAG, "Replace handler 0x%08lx/0x%08lx", (unsigned long)type_hash, (unsigned long)state_hash);
+        it->handler = std::move(handler);
+        return;
+    }
+    entries_.insert(it, {key, std::move(handler)});
+}
+
+const MessageDispatcher::Entry* MessageDispatcher::Find(uint64_t key) const {
+    auto it = std::lower_bound(entries_.begin(), entries_.end(), key, [](const Entry& entry, uint64_t value) {
+        return entry.key < value;
+    });
+    if (it != entries_.end() && it->key == key) {
+        return &*it;
+    }
+    return nullptr;
+}
+
+bool MessageDispatcher::Dispatch(const ControlMessage& message) const {
+    const Entry* entry = nullptr;
+    if (message.state_hash() != 0) {
+        entry = Find(MakeKey(message.type_hash(), message.state_hash()));
+    }
+    if (entry == nullptr) {
+        entry = Find(MakeKey(message.type_hash(), 0));
+    }
+    if (entry == nullptr) {
+        return false;
+    }
+    entry->handler(message);
+    return true;
+}
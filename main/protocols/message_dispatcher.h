@@ -0,0 +1,44 @@
+#ifndef MESSAGE_DISPATCHER_H
+#define MESSAGE_DISPATCHER_H
+
+#include <functional>
+#include <vector>
+#include <cstdint>
+
+#include "control_message.h"
+
+using MessageHandler = std::function<void(const ControlMessage& message)>;
+
+// 按消息类型（和状态）的哈希分发控制消息，JSON 和二进制编码共用
+// 先找同时匹配类型和状态的处理函数，找不到再找只注册了类型的
+// 注册只能在协议启动之前进行，之后分发时不加锁
+class MessageDispatcher {
+public:
+    // 同一个键重复注册时替换原来的处理函数
+    void Register(uint32_t type_hash, MessageHandler handler);
+    void Register(uint32_t type_hash, uint32_t state_hash, MessageHandler handler);
+    void Register(std::string_view type, MessageHandler handler) {
+        Register(MessageHash(type), std::move(handler));
+    }
+    void Register(std::string_view type, std::string_view state, MessageHandler handler) {
+        Register(MessageHash(type), MessageHash(state), std::move(handler));
+    }
+
+    // 没有匹配的处理函数时返回 false
+    bool Dispatch(const ControlMessage& message) const;
+
+private:
+    struct Entry {
+        uint64_t key;
+        MessageHandler handler;
+    };
+    // 按 key 排序，二分查找
+    std::vector<Entry> entries_;
+
+    static uint64_t MakeKey(uint32_t type_hash, uint32_t state_hash) {
+        return (static_cast<uint64_t>(type_hash) << 32) | state_hash;
+    }
+    const Entry* Find(uint64_t key) const;
+};
+
+#endif // MESSAGE_DISPATCHER_H
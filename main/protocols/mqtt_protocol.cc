@@ -1,17 +1,29 @@
 #include "mqtt_protocol.h"
+#include "audio_payload_pool.h"
 #include "board.h"
 #include "application.h"
 #include "settings.h"
+#include "json_arena.h"
+#include "audio_trace.h"
+#include "protocol_trace.h"
+#include "metrics.h"
+#include "async_log.h"
+#include "performance_profile.h"
 
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <ml307_mqtt.h>
 #include <ml307_udp.h>
 #include <cstring>
+#include <algorithm>
 #include <arpa/inet.h>
 #include "assets/lang_config.h"
 
 #define TAG "MQTT"
 
+// 每个 UDP 包的发送耗时，4G 模组上包含一次 AT 命令往返
+static MetricHistogram metric_udp_send_us("udp.send_us", METRIC_NETWORK_US_BOUNDS);
+
 MqttProtocol::MqttProtocol() {
     event_group_handle_ = xEventGroupCreate();
 }
@@ -21,6 +33,7 @@ MqttProtocol::~MqttProtocol() {
     if (udp_ != nullptr) {
         delete udp_;
     }
+    AudioPayloadPool::GetInstance().Release(std::move(udp_decrypt_buffer_));
     if (mqtt_ != nullptr) {
         delete mqtt_;
     }
@@ -42,7 +55,17 @@ bool MqttProtocol::StartMqttClient(bool report_error) {
     auto client_id = settings.GetString("client_id");
     auto username = settings.GetString("username");
     auto password = settings.GetString("password");
-    int keepalive_interval = settings.GetInt("keepalive", 120);
+    int keepalive_interval = PerformanceProfile::GetInstance().Get(kPerfKeepaliveSeconds, settings.GetInt("keepalive", 120));
+#if CONFIG_ADAPTIVE_KEEPALIVE
+    {
+        // 当前网络的网关回收空闲连接比服务器要求的保活间隔更快时，按学到的间隔发 PINGREQ
+        KeepalivePolicy policy;
+        policy.Load();
+        if (policy.has_limit()) {
+            keepalive_interval = std::min(keepalive_interval, policy.interval_seconds());
+        }
+    }
+#endif
     publish_topic_ = settings.GetString("publish_topic");
 
     if (endpoint.empty()) {
@@ -61,7 +84,16 @@ bool MqttProtocol::StartMqttClient(bool report_error) {
     });
 
     mqtt_->OnMessage([this](const std::string& topic, const std::string& payload) {
-        cJSON* root = cJSON_Parse(payload.c_str());
+        // JSON 消息总是以 '{' 开头，二进制控制消息以 CONTROL_MESSAGE_MAGIC 开头
+        if (!payload.empty() && (uint8_t)payload[0] == CONTROL_MESSAGE_MAGIC) {
+            ProtocolTrace::RecordControl((const uint8_t*)payload.data(), payload.size());
+            DispatchControl((const uint8_t*)payload.data(), payload.size());
+            last_incoming_time_ = std::chrono::steady_clock::now();
+            return;
+        }
+        ProtocolTrace::RecordText(payload.data(), payload.size());
+        JsonArena arena;
+        cJSON* root = arena.Parse(payload.data(), payload.size());
         if (root == nullptr) {
             ESP_LOGE(TAG, "Failed to parse json message %s", payload.c_str());
             return;
@@ -69,7 +101,6 @@ bool MqttProtocol::StartMqttClient(bool report_error) {
         cJSON* type = cJSON_GetObjectItem(root, "type");
         if (!cJSON_IsString(type)) {
             ESP_LOGE(TAG, "Message type is invalid");
-            cJSON_Delete(root);
             return;
         }
 
@@ -83,10 +114,9 @@ bool MqttProtocol::StartMqttClient(bool report_error) {
                     CloseAudioChannel();
                 });
             }
-        } else if (on_incoming_json_ != nullptr) {
-            on_incoming_json_(root);
+        } else {
+            DispatchJson(root);
         }
-        cJSON_Delete(root);
         last_incoming_time_ = std::chrono::steady_clock::now();
     });
 
@@ -110,10 +140,71 @@ bool MqttProtocol::StartMqttClient(bool report_error) {
     return true;
 }
 
+bool MqttProtocol::SupportsCompactControl() const {
+    return true;
+}
+
+bool MqttProtocol::SendControl(const std::string& frame) {
+    if (publish_topic_.empty() || !compact_control_) {
+        return false;
+    }
+#if CONFIG_MQTT_BATCH_MESSAGES
+    // 先发出合并中的 JSON 消息，保持和二进制消息的先后顺序
+    FlushBatch();
+#endif
+    if (!mqtt_->Publish(publish_topic_, frame)) {
+        ESP_LOGE(TAG, "Failed to publish control message, type: %d", (uint8_t)frame[1]);
+        SetError(Lang::Strings::SERVER_ERROR);
+        return false;
+    }
+    return true;
+}
+
+bool MqttProtocol::SupportsStreams() const {
+    return true;
+}
+
+bool MqttProtocol::SendStreamFrame(const uint8_t* data, size_t size) {
+    if (publish_topic_.empty() || !streams_enabled_) {
+        return false;
+    }
+#if CONFIG_MQTT_BATCH_MESSAGES
+    FlushBatch();
+#endif
+    // 和 JSON 消息共用 topic，用 magic 字节区分
+    std::string message;
+    message.reserve(1 + size);
+    message.push_back((char)PROTOCOL_STREAM_MAGIC);
+    message.append((const char*)data, size);
+    if (!mqtt_->Publish(publish_topic_, message)) {
+        ESP_LOGE(TAG, "Failed to publish stream data, size: %u", size);
+        SetError(Lang::Strings::SERVER_ERROR);
+        return false;
+    }
+    return true;
+}
+
 bool MqttProtocol::SendText(const std::string& text) {
     if (publish_topic_.empty()) {
         return false;
     }
+#if CONFIG_MQTT_BATCH_MESSAGES
+    if (batch_enabled_) {
+        // 第一条消息安排一次刷新，主循环执行完当前这一轮任务后一起发出
+        std::lock_guard<std::mutex> lock(batch_mutex_);
+        batch_.push_back(text);
+        if (batch_.size() == 1) {
+            Application::GetInstance().Schedule([this]() {
+                FlushBatch();
+            });
+        }
+        return true;
+    }
+#endif
+    return PublishText(text);
+}
+
+bool MqttProtocol::PublishText(const std::string& text) {
     if (!mqtt_->Publish(publish_topic_, text)) {
         ESP_LOGE(TAG, "Failed to publish message: %s", text.c_str());
         SetError(Lang::Strings::SERVER_ERROR);
@@ -122,30 +213,99 @@ bool MqttProtocol::SendText(const std::string& text) {
     return true;
 }
 
+#if CONFIG_MQTT_BATCH_MESSAGES
+// 多条消息放进 {"type":"batch","messages":[...]} 一次发出，服务器按顺序逐条处理；只有一条时原样发送
+void MqttProtocol::FlushBatch() {
+    std::vector<std::string> messages;
+    {
+        std::lock_guard<std::mutex> lock(batch_mutex_);
+        messages.swap(batch_);
+    }
+    if (messages.empty()) {
+        return;
+    }
+    if (messages.size() == 1) {
+        PublishText(messages[0]);
+        return;
+    }
+    size_t size = 40;
+    for (auto& message : messages) {
+        size += message.size() + 1;
+    }
+    std::string batch;
+    batch.reserve(size);
+    batch += "{\"type\":\"batch\",\"messages\":[";
+    for (size_t i = 0; i < messages.size(); i++) {
+        if (i > 0) {
+            batch += ',';
+        }
+        batch += messages[i];
+    }
+    batch += "]}";
+    ESP_LOGD(TAG, "Publish %u messages in one batch", messages.size());
+    PublishText(batch);
+}
+#endif
+
 bool MqttProtocol::SendAudio(const AudioStreamPacket& packet) {
     std::lock_guard<std::mutex> lock(channel_mutex_);
     if (udp_ == nullptr) {
         return false;
     }
 
-    std::string nonce(aes_nonce_);
-    *(uint16_t*)&nonce[2] = htons(packet.payload.size());
-    *(uint32_t*)&nonce[8] = htonl(packet.timestamp);
-    *(uint32_t*)&nonce[12] = htonl(++local_sequence_);
+    uint32_t sequence = ++local_sequence_;
+    if (!SendUdpPacket(MQTT_UDP_PACKET_AUDIO, 0, packet.timestamp, sequence, packet.payload.data(), packet.payload.size())) {
+        return false;
+    }
+    udp_stats_.sent++;
 
-    std::string encrypted;
-    encrypted.resize(aes_nonce_.size() + packet.payload.size());
-    memcpy(encrypted.data(), nonce.data(), nonce.size());
+    if (fec_encoder_.Add(sequence, packet.timestamp, packet.payload.data(), packet.payload.size())) {
+        // 校验包不占用音频包的序号
+        if (SendUdpPacket(MQTT_UDP_PACKET_PARITY, fec_encoder_.group(), fec_encoder_.timestamp(),
+                fec_encoder_.base_sequence(), fec_encoder_.data(), fec_encoder_.size())) {
+            udp_stats_.parity_sent++;
+        }
+    }
+    return true;
+}
 
+// 调用方持有 channel_mutex_
+// 包头直接写进预留好的发送缓冲区，负载加密后写在包头后面，每个包不再分配内存
+bool MqttProtocol::SendUdpPacket(uint8_t type, uint8_t flags, uint32_t timestamp, uint32_t sequence,
+    const uint8_t* payload, size_t size) {
+    udp_send_buffer_.resize(MQTT_UDP_NONCE_SIZE + size);
+    auto header = (uint8_t*)udp_send_buffer_.data();
+    memcpy(header, aes_nonce_.data(), MQTT_UDP_NONCE_SIZE);
+    header[0] = type;
+    header[1] = flags;
+    *(uint16_t*)&header[2] = htons(size);
+    *(uint32_t*)&header[8] = htonl(timestamp);
+    *(uint32_t*)&header[12] = htonl(sequence);
+
+    // CTR 计数器会被 mbedtls 原地递增，用栈上的副本
+    uint8_t counter[MQTT_UDP_NONCE_SIZE];
+    memcpy(counter, header, MQTT_UDP_NONCE_SIZE);
     size_t nc_off = 0;
     uint8_t stream_block[16] = {0};
-    if (mbedtls_aes_crypt_ctr(&aes_ctx_, packet.payload.size(), &nc_off, (uint8_t*)nonce.c_str(), stream_block,
-        (uint8_t*)packet.payload.data(), (uint8_t*)&encrypted[nonce.size()]) != 0) {
-        ESP_LOGE(TAG, "Failed to encrypt audio data");
+    if (mbedtls_aes_crypt_ctr(&aes_ctx_, size, &nc_off, counter, stream_block,
+        payload, header + MQTT_UDP_NONCE_SIZE) != 0) {
+        LOGE_LIMITED(TAG, 1000, "Failed to encrypt audio data");
         return false;
     }
 
-    return udp_->Send(encrypted) > 0;
+    int64_t start = esp_timer_get_time();
+    bool ok = udp_->Send(udp_send_buffer_) > 0;
+    metric_udp_send_us.Record(esp_timer_get_time() - start);
+    return ok;
+}
+
+void MqttProtocol::LogUdpStats() {
+    if (udp_stats_.sent == 0 && udp_stats_.received == 0) {
+        return;
+    }
+    ESP_LOGI(TAG, "UDP stats: sent %lu (+%lu parity), received %lu, lost %lu, late %lu, recovered %lu",
+        udp_stats_.sent, udp_stats_.parity_sent, udp_stats_.received, udp_stats_.lost,
+        udp_stats_.late, udp_stats_.recovered);
 }
 
 void MqttProtocol::CloseAudioChannel() {
@@ -154,7 +314,17 @@ void MqttProtocol::CloseAudioChannel() {
         if (udp_ != nullptr) {
             delete udp_;
             udp_ = nullptr;
+            LogUdpStats();
+        }
+        AudioPayloadPool::GetInstance().Release(std::move(udp_decrypt_buffer_));
+        udp_decrypt_buffer_ = std::vector<uint8_t>();
+#if CONFIG_MQTT_HELLO_RESUME
+        // 服务器一直没有确认恢复的会话，下次重新握手
+        if (resume_pending_) {
+            resume_pending_ = false;
+            resume_expire_us_ = 0;
         }
+#endif
     }
 
     std::string message = "{";
@@ -162,12 +332,27 @@ void MqttProtocol::CloseAudioChannel() {
     message += "\"type\":\"goodbye\"";
     message += "}";
     SendText(message);
+    // 音频通道关闭后 MQTT 仍然在线，通道外的消息回到 JSON，也不再合并
+    compact_control_ = false;
+    streams_enabled_ = false;
+    mcp_chunks_enabled_ = false;
+#if CONFIG_MQTT_BATCH_MESSAGES
+    FlushBatch();
+    batch_enabled_ = false;
+#endif
+    FailStreams();
 
     if (on_audio_channel_closed_ != nullptr) {
         on_audio_channel_closed_();
     }
 }
 
+#if CONFIG_MQTT_HELLO_RESUME
+bool MqttProtocol::CanResume() const {
+    return !resume_token_.empty() && esp_timer_get_time() < resume_expire_us_;
+}
+#endif
+
 bool MqttProtocol::OpenAudioChannel() {
     if (mqtt_ == nullptr || !mqtt_->IsConnected()) {
         ESP_LOGI(TAG, "MQTT is not connected, try to connect now");
@@ -177,101 +362,211 @@ bool MqttProtocol::OpenAudioChannel() {
     }
 
     error_occurred_ = false;
+    compact_control_ = false;
+    streams_enabled_ = false;
+    mcp_chunks_enabled_ = false;
+#if CONFIG_MQTT_BATCH_MESSAGES
+    batch_enabled_ = false;
+#endif
     session_id_ = "";
     xEventGroupClearBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT);
 
-    auto message = GetHelloMessage();
+    bool resume = false;
+#if CONFIG_MQTT_HELLO_RESUME
+    // 恢复上次的会话时 hello 只是通知服务器，UDP 马上用上次的参数打开，省掉一次等待 hello 的往返
+    resume = CanResume();
+    if (resume) {
+        session_id_ = resume_session_id_;
+        ESP_LOGI(TAG, "Resume session %s", session_id_.c_str());
+    }
+    {
+        std::lock_guard<std::mutex> lock(channel_mutex_);
+        resume_pending_ = resume;
+    }
+#endif
+
+    auto message = GetHelloMessage(resume);
     if (!SendText(message)) {
+#if CONFIG_MQTT_HELLO_RESUME
+        std::lock_guard<std::mutex> lock(channel_mutex_);
+        resume_pending_ = false;
+#endif
         return false;
     }
 
-    // 等待服务器响应
-    EventBits_t bits = xEventGroupWaitBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT, pdTRUE, pdFALSE, pdMS_TO_TICKS(10000));
-    if (!(bits & MQTT_PROTOCOL_SERVER_HELLO_EVENT)) {
-        ESP_LOGE(TAG, "Failed to receive server hello");
-        SetError(Lang::Strings::SERVER_TIMEOUT);
-        return false;
+    if (!resume) {
+        // 等待服务器响应
+        EventBits_t bits = xEventGroupWaitBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT, pdTRUE, pdFALSE, pdMS_TO_TICKS(10000));
+        if (!(bits & MQTT_PROTOCOL_SERVER_HELLO_EVENT)) {
+            ESP_LOGE(TAG, "Failed to receive server hello");
+            SetError(Lang::Strings::SERVER_TIMEOUT);
+            return false;
+        }
     }
 
-    std::lock_guard<std::mutex> lock(channel_mutex_);
+    {
+        std::lock_guard<std::mutex> lock(channel_mutex_);
+#if CONFIG_MQTT_HELLO_RESUME
+        if (resume) {
+            // 序号接着上次继续，同一个密钥下 CTR 计数器不会重复；上次没有凑满的校验组作废
+            fec_encoder_.Configure(fec_encoder_.group());
+        }
+#endif
+        if (udp_decrypt_buffer_.capacity() < AUDIO_PAYLOAD_MAX_SIZE) {
+            udp_decrypt_buffer_ = AudioPayloadPool::GetInstance().Acquire();
+        }
+        udp_send_buffer_.reserve(MQTT_UDP_NONCE_SIZE + AUDIO_PAYLOAD_MAX_SIZE);
+        if (fec_decoder_.enabled() && udp_parity_buffer_.capacity() < AUDIO_PAYLOAD_MAX_SIZE) {
+            udp_parity_buffer_.reserve(AUDIO_PAYLOAD_MAX_SIZE);
+        }
+        udp_stats_ = UdpStats();
+        fec_decoder_.Reset();
+        ConnectUdp();
+    }
+
+    if (on_audio_channel_opened_ != nullptr) {
+        on_audio_channel_opened_();
+    }
+    return true;
+}
+
+// 调用方持有 channel_mutex_
+void MqttProtocol::ConnectUdp() {
     if (udp_ != nullptr) {
         delete udp_;
     }
     udp_ = Board::GetInstance().CreateUdp();
     udp_->OnMessage([this](const std::string& data) {
-        /*
-         * UDP Encrypted OPUS Packet Format:
-         * |type 1u|flags 1u|payload_len 2u|ssrc 4u|timestamp 4u|sequence 4u|
-         * |payload payload_len|
-         */
-        if (data.size() < sizeof(aes_nonce_)) {
-            ESP_LOGE(TAG, "Invalid audio packet size: %u", data.size());
-            return;
-        }
-        if (data[0] != 0x01) {
-            ESP_LOGE(TAG, "Invalid audio packet type: %x", data[0]);
-            return;
-        }
-        uint32_t timestamp = ntohl(*(uint32_t*)&data[8]);
-        uint32_t sequence = ntohl(*(uint32_t*)&data[12]);
-        if (sequence < remote_sequence_) {
-            ESP_LOGW(TAG, "Received audio packet with old sequence: %lu, expected: %lu", sequence, remote_sequence_);
-            return;
-        }
-        if (sequence != remote_sequence_ + 1) {
-            ESP_LOGW(TAG, "Received audio packet with wrong sequence: %lu, expected: %lu", sequence, remote_sequence_ + 1);
-        }
+        OnUdpMessage(data);
+    });
+    udp_->Connect(udp_server_, udp_port_);
+}
 
-        size_t decrypted_size = data.size() - aes_nonce_.size();
-        size_t nc_off = 0;
-        uint8_t stream_block[16] = {0};
-        auto nonce = (uint8_t*)data.data();
-        auto encrypted = (uint8_t*)data.data() + aes_nonce_.size();
-        AudioStreamPacket packet;
-        packet.sample_rate = server_sample_rate_;
-        packet.frame_duration = server_frame_duration_;
-        packet.timestamp = timestamp;
-        packet.payload.resize(decrypted_size);
-        int ret = mbedtls_aes_crypt_ctr(&aes_ctx_, decrypted_size, &nc_off, nonce, stream_block, encrypted, (uint8_t*)packet.payload.data());
-        if (ret != 0) {
-            ESP_LOGE(TAG, "Failed to decrypt audio data, ret: %d", ret);
+void MqttProtocol::OnUdpMessage(const std::string& data) {
+    /*
+     * UDP Encrypted OPUS Packet Format:
+     * |type 1u|flags 1u|payload_len 2u|ssrc 4u|timestamp 4u|sequence 4u|
+     * |payload payload_len|
+     * type 0x02 为校验包，flags 为组大小，sequence 为组内第一个包的序号
+     */
+    uint32_t receive_us = AudioTrace::Now();
+    if (data.size() < MQTT_UDP_NONCE_SIZE) {
+        LOGE_LIMITED(TAG, 1000, "Invalid audio packet size: %u", data.size());
+        return;
+    }
+    uint8_t type = data[0];
+    if (type != MQTT_UDP_PACKET_AUDIO && type != MQTT_UDP_PACKET_PARITY) {
+        LOGE_LIMITED(TAG, 1000, "Invalid audio packet type: %x", type);
+        return;
+    }
+    uint32_t timestamp = ntohl(*(uint32_t*)&data[8]);
+    uint32_t sequence = ntohl(*(uint32_t*)&data[12]);
+
+    size_t decrypted_size = data.size() - MQTT_UDP_NONCE_SIZE;
+    if (decrypted_size > AUDIO_PAYLOAD_MAX_SIZE) {
+        LOGE_LIMITED(TAG, 1000, "Audio packet too large: %u", decrypted_size);
+        return;
+    }
+    size_t nc_off = 0;
+    uint8_t stream_block[16] = {0};
+    uint8_t counter[MQTT_UDP_NONCE_SIZE];
+    memcpy(counter, data.data(), MQTT_UDP_NONCE_SIZE);
+    auto encrypted = (const uint8_t*)data.data() + MQTT_UDP_NONCE_SIZE;
+    // 解密到通道打开时预留的缓冲区，回调只拿到它的引用
+    auto& output = type == MQTT_UDP_PACKET_AUDIO ? udp_decrypt_buffer_ : udp_parity_buffer_;
+    output.resize(decrypted_size);
+    int ret = mbedtls_aes_crypt_ctr(&aes_ctx_, decrypted_size, &nc_off, counter, stream_block, encrypted, output.data());
+    if (ret != 0) {
+        LOGE_LIMITED(TAG, 1000, "Failed to decrypt audio data, ret: %d", ret);
+        return;
+    }
+    last_incoming_time_ = std::chrono::steady_clock::now();
+
+    AudioStreamPacketView packet;
+    packet.trace_us = receive_us;
+    packet.sample_rate = server_sample_rate_;
+    packet.frame_duration = server_frame_duration_;
+    if (type == MQTT_UDP_PACKET_PARITY) {
+        const uint8_t* payload = nullptr;
+        size_t payload_size = 0;
+        uint32_t recovered_sequence = 0;
+        uint32_t recovered_timestamp = 0;
+        if (!fec_decoder_.Recover(sequence, data[1], timestamp, output.data(), output.size(),
+                recovered_sequence, recovered_timestamp, payload, payload_size)) {
             return;
         }
+        LOGD_LIMITED(TAG, 1000, "Recovered audio packet %lu", recovered_sequence);
+        udp_stats_.recovered++;
         if (on_incoming_audio_ != nullptr) {
-            on_incoming_audio_(std::move(packet));
+            packet.timestamp = recovered_timestamp;
+            packet.sequence = recovered_sequence;
+            packet.payload = payload;
+            packet.payload_size = payload_size;
+            ProtocolTrace::RecordAudio(packet);
+            on_incoming_audio_(packet);
+            AudioTrace::Record(kAudioTraceReceive, receive_us);
         }
-        remote_sequence_ = sequence;
-        last_incoming_time_ = std::chrono::steady_clock::now();
-    });
-
-    udp_->Connect(udp_server_, udp_port_);
+        return;
+    }
 
-    if (on_audio_channel_opened_ != nullptr) {
-        on_audio_channel_opened_();
+    // 乱序和迟到的包也交给上层，由抖动缓冲按序号重排或丢弃
+    udp_stats_.received++;
+    if (remote_sequence_ != 0 && sequence <= remote_sequence_) {
+        udp_stats_.late++;
+        if (udp_stats_.lost > 0) {
+            udp_stats_.lost--;
+        }
+    } else if (remote_sequence_ != 0 && sequence != remote_sequence_ + 1) {
+        udp_stats_.lost += sequence - remote_sequence_ - 1;
+        LOGD_LIMITED(TAG, 1000, "Received audio packet with wrong sequence: %lu, expected: %lu", sequence, remote_sequence_ + 1);
+    }
+    fec_decoder_.OnPacket(sequence, timestamp, output.data(), output.size());
+    if (on_incoming_audio_ != nullptr) {
+        packet.timestamp = timestamp;
+        packet.sequence = sequence;
+        packet.payload = output.data();
+        packet.payload_size = decrypted_size;
+        ProtocolTrace::RecordAudio(packet);
+        on_incoming_audio_(packet);
+        AudioTrace::Record(kAudioTraceReceive, receive_us);
+    }
+    if (sequence > remote_sequence_) {
+        remote_sequence_ = sequence;
     }
-    return true;
 }
 
-std::string MqttProtocol::GetHelloMessage() {
+std::string MqttProtocol::GetHelloMessage(bool resume) {
     // 发送 hello 消息申请 UDP 通道
     cJSON* root = cJSON_CreateObject();
     cJSON_AddStringToObject(root, "type", "hello");
     cJSON_AddNumberToObject(root, "version", 3);
     cJSON_AddStringToObject(root, "transport", "udp");
     cJSON* features = cJSON_CreateObject();
-#if CONFIG_USE_SERVER_AEC
-    cJSON_AddBoolToObject(features, "aec", true);
-#endif
-#if CONFIG_IOT_PROTOCOL_MCP
-    cJSON_AddBoolToObject(features, "mcp", true);
+    AddFeatures(features);
+#if CONFIG_MQTT_BATCH_MESSAGES
+    cJSON_AddBoolToObject(features, "batch", true);
 #endif
     cJSON_AddItemToObject(root, "features", features);
-    cJSON* audio_params = cJSON_CreateObject();
-    cJSON_AddStringToObject(audio_params, "format", "opus");
-    cJSON_AddNumberToObject(audio_params, "sample_rate", 16000);
-    cJSON_AddNumberToObject(audio_params, "channels", 1);
-    cJSON_AddNumberToObject(audio_params, "frame_duration", OPUS_FRAME_DURATION_MS);
-    cJSON_AddItemToObject(root, "audio_params", audio_params);
+    cJSON_AddItemToObject(root, "audio_params", CreateAudioParams());
+    cJSON* udp = cJSON_CreateObject();
+#if CONFIG_MQTT_UDP_FEC
+    // 申请 XOR 校验，服务器在 hello 的 udp 对象中回复 fec 才启用
+    cJSON* fec = cJSON_CreateObject();
+    cJSON_AddStringToObject(fec, "type", "xor");
+    cJSON_AddNumberToObject(fec, "group", CONFIG_MQTT_UDP_FEC_GROUP);
+    cJSON_AddItemToObject(udp, "fec", fec);
+#endif
+#if CONFIG_MQTT_HELLO_RESUME
+    // 设备已经按上次的参数发送音频，服务器用凭证找回 UDP 会话后仍然回复 hello
+    if (resume) {
+        cJSON_AddStringToObject(udp, "resume", resume_token_.c_str());
+    }
+#endif
+    if (cJSON_GetArraySize(udp) > 0) {
+        cJSON_AddItemToObject(root, "udp", udp);
+    } else {
+        cJSON_Delete(udp);
+    }
     auto json_str = cJSON_PrintUnformatted(root);
     std::string message(json_str);
     cJSON_free(json_str);
@@ -293,35 +588,86 @@ void MqttProtocol::ParseServerHello(const cJSON* root) {
     }
 
     // Get sample rate from hello message
-    auto audio_params = cJSON_GetObjectItem(root, "audio_params");
-    if (cJSON_IsObject(audio_params)) {
-        auto sample_rate = cJSON_GetObjectItem(audio_params, "sample_rate");
-        if (cJSON_IsNumber(sample_rate)) {
-            server_sample_rate_ = sample_rate->valueint;
-        }
-        auto frame_duration = cJSON_GetObjectItem(audio_params, "frame_duration");
-        if (cJSON_IsNumber(frame_duration)) {
-            server_frame_duration_ = frame_duration->valueint;
-        }
-    }
+    ParseAudioParams(cJSON_GetObjectItem(root, "audio_params"));
+    ParseFeatures(cJSON_GetObjectItem(root, "features"));
 
     auto udp = cJSON_GetObjectItem(root, "udp");
     if (!cJSON_IsObject(udp)) {
         ESP_LOGE(TAG, "UDP is not specified");
         return;
     }
-    udp_server_ = cJSON_GetObjectItem(udp, "server")->valuestring;
-    udp_port_ = cJSON_GetObjectItem(udp, "port")->valueint;
-    auto key = cJSON_GetObjectItem(udp, "key")->valuestring;
-    auto nonce = cJSON_GetObjectItem(udp, "nonce")->valuestring;
+#if CONFIG_MQTT_BATCH_MESSAGES
+    auto features = cJSON_GetObjectItem(root, "features");
+    batch_enabled_ = cJSON_IsTrue(cJSON_GetObjectItem(features, "batch"));
+#endif
+
+    std::string server = cJSON_GetObjectItem(udp, "server")->valuestring;
+    int port = cJSON_GetObjectItem(udp, "port")->valueint;
+    std::string key = cJSON_GetObjectItem(udp, "key")->valuestring;
+    auto nonce = DecodeHexString(cJSON_GetObjectItem(udp, "nonce")->valuestring);
 
     // auto encryption = cJSON_GetObjectItem(udp, "encryption")->valuestring;
     // ESP_LOGI(TAG, "UDP server: %s, port: %d, encryption: %s", udp_server_.c_str(), udp_port_, encryption);
-    aes_nonce_ = DecodeHexString(nonce);
-    mbedtls_aes_init(&aes_ctx_);
-    mbedtls_aes_setkey_enc(&aes_ctx_, (const unsigned char*)DecodeHexString(key).c_str(), 128);
-    local_sequence_ = 0;
-    remote_sequence_ = 0;
+    if (nonce.size() != MQTT_UDP_NONCE_SIZE) {
+        ESP_LOGE(TAG, "Invalid UDP nonce size: %u", nonce.size());
+        return;
+    }
+
+    // 恢复的通道已经在发送音频，和发送路径互斥地更新参数
+    std::lock_guard<std::mutex> lock(channel_mutex_);
+    bool resumed = false;
+#if CONFIG_MQTT_HELLO_RESUME
+    resumed = resume_pending_;
+    resume_pending_ = false;
+    auto resume = cJSON_GetObjectItem(udp, "resume");
+    auto token = cJSON_GetObjectItem(resume, "token");
+    auto ttl = cJSON_GetObjectItem(resume, "ttl");
+    if (cJSON_IsString(token) && cJSON_IsNumber(ttl) && ttl->valueint > 0) {
+        resume_token_ = token->valuestring;
+        resume_session_id_ = session_id_;
+        resume_expire_us_ = esp_timer_get_time() + (int64_t)ttl->valueint * 1000000;
+    } else {
+        resume_token_.clear();
+        resume_expire_us_ = 0;
+    }
+#endif
+    bool endpoint_changed = server != udp_server_ || port != udp_port_;
+    bool key_changed = key != udp_key_ || nonce != aes_nonce_;
+    udp_server_ = server;
+    udp_port_ = port;
+    if (!resumed || key_changed) {
+        udp_key_ = key;
+        aes_nonce_ = nonce;
+        mbedtls_aes_init(&aes_ctx_);
+        mbedtls_aes_setkey_enc(&aes_ctx_, (const unsigned char*)DecodeHexString(key).c_str(), 128);
+        local_sequence_ = 0;
+        remote_sequence_ = 0;
+    }
+    if (resumed && (endpoint_changed || key_changed)) {
+        // 服务器没有接受恢复，分配了新的 UDP 会话
+        ESP_LOGW(TAG, "Session resume rejected, switch to the new UDP session");
+        if (endpoint_changed) {
+            // MQTT 回调所在的任务里不能重建 UDP 连接，交给主循环
+            Application::GetInstance().Schedule([this]() {
+                std::lock_guard<std::mutex> lock(channel_mutex_);
+                if (udp_ != nullptr) {
+                    ConnectUdp();
+                }
+            });
+        }
+    }
+
+    int fec_group = 0;
+#if CONFIG_MQTT_UDP_FEC
+    auto fec = cJSON_GetObjectItem(udp, "fec");
+    if (cJSON_IsObject(fec)) {
+        auto group = cJSON_GetObjectItem(fec, "group");
+        fec_group = cJSON_IsNumber(group) ? group->valueint : CONFIG_MQTT_UDP_FEC_GROUP;
+        ESP_LOGI(TAG, "UDP XOR FEC enabled, group: %d", fec_group);
+    }
+#endif
+    fec_encoder_.Configure(fec_group);
+    fec_decoder_.Configure(fec_group);
     xEventGroupSetBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT);
 }
 
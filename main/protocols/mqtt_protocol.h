@@ -3,6 +3,7 @@
 
 
 #include "protocol.h"
+#include "udp_fec.h"
 #include <mqtt.h>
 #include <udp.h>
 #include <cJSON.h>
@@ -11,6 +12,7 @@
 #include <freertos/event_groups.h>
 
 #include <functional>
+#include <vector>
 #include <string>
 #include <map>
 #include <mutex>
@@ -20,6 +22,11 @@
 
 #define MQTT_PROTOCOL_SERVER_HELLO_EVENT (1 << 0)
 
+#define MQTT_UDP_PACKET_AUDIO 0x01
+#define MQTT_UDP_PACKET_PARITY 0x02
+// UDP 包头同时是 AES-CTR 的初始计数器
+#define MQTT_UDP_NONCE_SIZE 16
+
 class MqttProtocol : public Protocol {
 public:
     MqttProtocol();
@@ -41,17 +48,65 @@ private:
     Udp* udp_ = nullptr;
     mbedtls_aes_context aes_ctx_;
     std::string aes_nonce_;
+    std::vector<uint8_t> udp_decrypt_buffer_;
+    std::string udp_send_buffer_;
     std::string udp_server_;
     int udp_port_;
+    std::string udp_key_;
     uint32_t local_sequence_;
     uint32_t remote_sequence_;
 
+    // 服务器在 hello 中确认后启用 XOR 校验
+    UdpFecEncoder fec_encoder_;
+    UdpFecDecoder fec_decoder_;
+    std::vector<uint8_t> udp_parity_buffer_;
+
+    // UDP 音频统计，每次打开通道时清零，关闭时打印
+    struct UdpStats {
+        uint32_t sent = 0;
+        uint32_t parity_sent = 0;
+        uint32_t received = 0;
+        uint32_t lost = 0;
+        uint32_t late = 0;
+        uint32_t recovered = 0;
+    };
+    UdpStats udp_stats_;
+
+#if CONFIG_MQTT_BATCH_MESSAGES
+    // 服务器在 hello 中确认 batch 后，主循环同一轮中发出的 JSON 消息合并为一次 publish
+    std::mutex batch_mutex_;
+    std::vector<std::string> batch_;
+    bool batch_enabled_ = false;
+    void FlushBatch();
+#endif
+
+#if CONFIG_MQTT_HELLO_RESUME
+    // 服务器在 hello 中下发的恢复凭证，有效期内再次打开通道时直接使用上次的 UDP 参数，不等服务器的 hello
+    std::string resume_token_;
+    std::string resume_session_id_;
+    int64_t resume_expire_us_ = 0;
+    // 用上次的参数打开了通道，服务器的 hello 还没有到达
+    bool resume_pending_ = false;
+    bool CanResume() const;
+#endif
+
+    bool SendUdpPacket(uint8_t type, uint8_t flags, uint32_t timestamp, uint32_t sequence,
+        const uint8_t* payload, size_t size);
+    void OnUdpMessage(const std::string& data);
+    void LogUdpStats();
+    void ConnectUdp();
+
     bool StartMqttClient(bool report_error=false);
     void ParseServerHello(const cJSON* root);
     std::string DecodeHexString(const std::string& hex_string);
 
     bool SendText(const std::string& text) override;
-    std::string GetHelloMessage();
+    bool PublishText(const std::string& text);
+    bool SendControl(const std::string& frame) override;
+    bool SupportsCompactControl() const override;
+    bool SendStreamFrame(const uint8_t* data, size_t size) override;
+    bool SupportsStreams() const override;
+    std::string GetHelloMessage(bool resume);
 };
 
 
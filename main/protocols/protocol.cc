@@ -1,6 +1,14 @@
 #include "protocol.h"
+#include "board.h"
+#include "application.h"
+#include "audio_resampler.h"
+#include "audio_trace.h"
+#include "json_arena.h"
 
 #include <esp_log.h>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
 
 #define TAG "Protocol"
 
@@ -8,7 +16,11 @@ void Protocol::OnIncomingJson(std::function<void(const cJSON* root)> callback) {
     on_incoming_json_ = callback;
 }
 
-void Protocol::OnIncomingAudio(std::function<void(AudioStreamPacket&& packet)> callback) {
+void Protocol::OnIncomingControl(std::function<void(const ControlMessage& message)> callback) {
+    on_incoming_control_ = callback;
+}
+
+void Protocol::OnIncomingAudio(std::function<void(const AudioStreamPacketView& packet)> callback) {
     on_incoming_audio_ = callback;
 }
 
@@ -32,6 +44,13 @@ void Protocol::SetError(const std::string& message) {
 }
 
 void Protocol::SendAbortSpeaking(AbortReason reason) {
+    FlushAudio();
+    if (compact_control_) {
+        std::string frame;
+        ControlMessageWriter(frame, kControlAbort).AddU8(kControlFieldReason, reason);
+        SendControl(frame);
+        return;
+    }
     std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"abort\"";
     if (reason == kAbortReasonWakeWordDetected) {
         message += ",\"reason\":\"wake_word_detected\"";
@@ -41,12 +60,28 @@ void Protocol::SendAbortSpeaking(AbortReason reason) {
 }
 
 void Protocol::SendWakeWordDetected(const std::string& wake_word) {
+    if (compact_control_) {
+        std::string frame;
+        ControlMessageWriter(frame, kControlListen)
+            .AddU8(kControlFieldState, kControlStateDetect)
+            .Add(kControlFieldText, wake_word);
+        SendControl(frame);
+        return;
+    }
     std::string json = "{\"session_id\":\"" + session_id_ + 
                       "\",\"type\":\"listen\",\"state\":\"detect\",\"text\":\"" + wake_word + "\"}";
     SendText(json);
 }
 
 void Protocol::SendStartListening(ListeningMode mode) {
+    if (compact_control_) {
+        std::string frame;
+        ControlMessageWriter(frame, kControlListen)
+            .AddU8(kControlFieldState, kControlStateStart)
+            .AddU8(kControlFieldMode, mode);
+        SendControl(frame);
+        return;
+    }
     std::string message = "{\"session_id\":\"" + session_id_ + "\"";
     message += ",\"type\":\"listen\",\"state\":\"start\"";
     if (mode == kListeningModeRealtime) {
@@ -61,6 +96,14 @@ void Protocol::SendStartListening(ListeningMode mode) {
 }
 
 void Protocol::SendStopListening() {
+    // 缓存的音频要在停止消息之前发出
+    FlushAudio();
+    if (compact_control_) {
+        std::string frame;
+        ControlMessageWriter(frame, kControlListen).AddU8(kControlFieldState, kControlStateStop);
+        SendControl(frame);
+        return;
+    }
     std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"listen\",\"state\":\"stop\"}";
     SendText(message);
 }
@@ -116,10 +159,342 @@ void Protocol::SendIotStates(const std::string& states) {
 }
 
 void Protocol::SendMcpMessage(const std::string& payload) {
+    if (compact_control_) {
+        std::string frame;
+        frame.reserve(CONTROL_MESSAGE_HEADER_SIZE + 3 + payload.size());
+        ControlMessageWriter(frame, kControlMcp).Add(kControlFieldPayload, payload);
+        SendControl(frame);
+        return;
+    }
     std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"mcp\",\"payload\":" + payload + "}";
     SendText(message);
 }
 
+void Protocol::SendMcpChunk(uint32_t message_id, uint32_t index, bool last, const std::string& fragment) {
+    if (compact_control_) {
+        uint8_t chunk[7] = {
+            (uint8_t)(message_id >> 24), (uint8_t)(message_id >> 16), (uint8_t)(message_id >> 8), (uint8_t)message_id,
+            (uint8_t)(index >> 8), (uint8_t)index, (uint8_t)last,
+        };
+        std::string frame;
+        frame.reserve(CONTROL_MESSAGE_HEADER_SIZE + 3 + sizeof(chunk) + 3 + fragment.size());
+        ControlMessageWriter(frame, kControlMcp)
+            .Add(kControlFieldChunk, std::string_view((const char*)chunk, sizeof(chunk)))
+            .Add(kControlFieldPayload, fragment);
+        SendControl(frame);
+        return;
+    }
+    // JSON 消息中的块是字符串，接收方按 index 拼接原文后再解析
+    cJSON* text = cJSON_CreateStringReference(fragment.c_str());
+    char* escaped = cJSON_PrintUnformatted(text);
+    cJSON_Delete(text);
+    std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"mcp\",\"chunk\":{\"id\":" +
+        std::to_string(message_id) + ",\"index\":" + std::to_string(index) + ",\"last\":" + (last ? "true" : "false") +
+        "},\"fragment\":" + escaped + "}";
+    cJSON_free(escaped);
+    SendText(message);
+}
+
+cJSON* Protocol::CreateAudioParams() const {
+    cJSON* audio_params = cJSON_CreateObject();
+    cJSON_AddStringToObject(audio_params, "format", "opus");
+    cJSON_AddNumberToObject(audio_params, "sample_rate", 16000);
+    cJSON_AddNumberToObject(audio_params, "channels", 1);
+    cJSON_AddNumberToObject(audio_params, "frame_duration", uplink_frame_duration_);
+
+    // 优先使用 codec 的原生采样率，其次是整数倍关系的采样率（低于 codec 的优先）
+    static const int opus_sample_rates[] = {48000, 24000, 16000, 12000, 8000};
+    int codec_sample_rate = Board::GetInstance().GetAudioCodec()->output_sample_rate();
+    std::vector<int> rates;
+    for (int rate : opus_sample_rates) {
+        if (rate == codec_sample_rate) {
+            rates.push_back(rate);
+        }
+    }
+    for (int rate : opus_sample_rates) {
+        if (rate < codec_sample_rate && AudioResampler::IsIntegerRatio(rate, codec_sample_rate)) {
+            rates.push_back(rate);
+        }
+    }
+    for (auto it = std::rbegin(opus_sample_rates); it != std::rend(opus_sample_rates); ++it) {
+        if (*it > codec_sample_rate && AudioResampler::IsIntegerRatio(*it, codec_sample_rate)) {
+            rates.push_back(*it);
+        }
+    }
+    cJSON* output_sample_rates = cJSON_CreateArray();
+    for (int rate : rates) {
+        cJSON_AddItemToArray(output_sample_rates, cJSON_CreateNumber(rate));
+    }
+    cJSON_AddItemToObject(audio_params, "output_sample_rates", output_sample_rates);
+
+    // 解码器按下行包的帧长重建，上行编码器也可以按会话重建，支持这几种帧长
+    cJSON* frame_durations = cJSON_CreateArray();
+    for (int duration : {20, 40, 60}) {
+        cJSON_AddItemToArray(frame_durations, cJSON_CreateNumber(duration));
+    }
+    cJSON_AddItemToObject(audio_params, "frame_durations", frame_durations);
+    return audio_params;
+}
+
+void Protocol::ParseAudioParams(const cJSON* audio_params) {
+    if (!cJSON_IsObject(audio_params)) {
+        return;
+    }
+    auto sample_rate = cJSON_GetObjectItem(audio_params, "sample_rate");
+    if (cJSON_IsNumber(sample_rate)) {
+        server_sample_rate_ = sample_rate->valueint;
+    }
+    auto frame_duration = cJSON_GetObjectItem(audio_params, "frame_duration");
+    if (cJSON_IsNumber(frame_duration)) {
+        server_frame_duration_ = frame_duration->valueint;
+    }
+    // 服务器可以指定不同的上行帧长
+    auto uplink_frame_duration = cJSON_GetObjectItem(audio_params, "uplink_frame_duration");
+    if (cJSON_IsNumber(uplink_frame_duration)) {
+        int duration = uplink_frame_duration->valueint;
+        if (duration == 20 || duration == 40 || duration == 60) {
+            uplink_frame_duration_ = duration;
+        } else {
+            ESP_LOGW(TAG, "Unsupported uplink frame duration: %d", duration);
+        }
+    }
+}
+
+bool Protocol::FlushAudio(bool force) {
+    return true;
+}
+
+bool Protocol::SendControl(const std::string& frame) {
+    return false;
+}
+
+bool Protocol::SupportsCompactControl() const {
+    return false;
+}
+
+bool Protocol::SendStreamFrame(const uint8_t* data, size_t size) {
+    return false;
+}
+
+bool Protocol::SupportsStreams() const {
+    return false;
+}
+
+void Protocol::AddFeatures(cJSON* features) const {
+#if CONFIG_USE_SERVER_AEC
+    cJSON_AddBoolToObject(features, "aec", true);
+#endif
+#if CONFIG_IOT_PROTOCOL_MCP
+    cJSON_AddBoolToObject(features, "mcp", true);
+#endif
+#if CONFIG_USE_COMPACT_CONTROL_MESSAGE
+    if (SupportsCompactControl()) {
+        cJSON_AddBoolToObject(features, "compact_control", true);
+    }
+#endif
+#if CONFIG_USE_SESSION_STREAMS
+    if (SupportsStreams()) {
+        cJSON_AddBoolToObject(features, "streams", true);
+    }
+#endif
+#if CONFIG_TTS_PHRASE_CACHE
+    cJSON_AddBoolToObject(features, "tts_cache", true);
+#endif
+#if CONFIG_ADAPTIVE_KEEPALIVE
+    cJSON_AddBoolToObject(features, "keepalive", true);
+#endif
+#if CONFIG_OPUS_INBAND_FEC
+    cJSON_AddBoolToObject(features, "receiver_report", true);
+#endif
+#if CONFIG_MCP_CHUNKED_MESSAGES
+    cJSON_AddBoolToObject(features, "mcp_chunks", true);
+#endif
+#if CONFIG_USE_DESCRIPTOR_CACHE
+    if (!iot_descriptors_hash_.empty() || !mcp_tools_hash_.empty()) {
+        cJSON* descriptors = cJSON_CreateObject();
+        if (!iot_descriptors_hash_.empty()) {
+            cJSON_AddStringToObject(descriptors, "iot", iot_descriptors_hash_.c_str());
+        }
+        if (!mcp_tools_hash_.empty()) {
+            cJSON_AddStringToObject(descriptors, "mcp", mcp_tools_hash_.c_str());
+        }
+        cJSON_AddItemToObject(features, "descriptors", descriptors);
+    }
+#endif
+}
+
+void Protocol::ParseFeatures(const cJSON* features) {
+    compact_control_ = false;
+    streams_enabled_ = false;
+    iot_descriptors_cached_ = false;
+    receiver_report_enabled_ = false;
+    mcp_chunks_enabled_ = false;
+#if CONFIG_ADAPTIVE_KEEPALIVE
+    keepalive_enabled_ = false;
+    keepalive_pending_ = false;
+#endif
+    // 新会话中旧的数据流不再有效
+    FailStreams();
+    if (!cJSON_IsObject(features)) {
+        return;
+    }
+#if CONFIG_ADAPTIVE_KEEPALIVE
+    if (cJSON_IsTrue(cJSON_GetObjectItem(features, "keepalive"))) {
+        keepalive_enabled_ = true;
+        keepalive_.Load();
+    }
+#endif
+#if CONFIG_USE_COMPACT_CONTROL_MESSAGE
+    if (SupportsCompactControl() && cJSON_IsTrue(cJSON_GetObjectItem(features, "compact_control"))) {
+        compact_control_ = true;
+        ESP_LOGI(TAG, "Compact control messages enabled");
+    }
+#endif
+#if CONFIG_OPUS_INBAND_FEC
+    if (cJSON_IsTrue(cJSON_GetObjectItem(features, "receiver_report"))) {
+        receiver_report_enabled_ = true;
+    }
+#endif
+#if CONFIG_MCP_CHUNKED_MESSAGES
+    if (cJSON_IsTrue(cJSON_GetObjectItem(features, "mcp_chunks"))) {
+        mcp_chunks_enabled_ = true;
+    }
+#endif
+#if CONFIG_USE_SESSION_STREAMS
+    if (SupportsStreams() && cJSON_IsTrue(cJSON_GetObjectItem(features, "streams"))) {
+        streams_enabled_ = true;
+        ESP_LOGI(TAG, "Session streams enabled");
+    }
+#endif
+#if CONFIG_USE_DESCRIPTOR_CACHE
+    // 服务器按哈希找到了缓存的描述时回复 "descriptors":{"iot":true}
+    auto descriptors = cJSON_GetObjectItem(features, "descriptors");
+    if (cJSON_IsObject(descriptors) && cJSON_IsTrue(cJSON_GetObjectItem(descriptors, "iot"))) {
+        iot_descriptors_cached_ = true;
+        ESP_LOGI(TAG, "IoT descriptors cached by server");
+    }
+#endif
+}
+
+void Protocol::DispatchJson(const cJSON* root) {
+    auto type = cJSON_GetObjectItem(root, "type");
+    if (cJSON_IsString(type) && strcmp(type->valuestring, "stream") == 0) {
+        OnStreamMessage(root);
+        return;
+    }
+#if CONFIG_ADAPTIVE_KEEPALIVE
+    if (cJSON_IsString(type) && strcmp(type->valuestring, "pong") == 0) {
+        // 在主循环的 PollKeepalive 中处理
+        keepalive_replied_ = true;
+        return;
+    }
+#endif
+    if (on_incoming_control_ != nullptr) {
+        ControlMessage message;
+        if (message.FromJson(root)) {
+            on_incoming_control_(message);
+            return;
+        }
+    }
+    if (on_incoming_json_ != nullptr) {
+        on_incoming_json_(root);
+    }
+}
+
+void Protocol::DispatchControl(const uint8_t* data, size_t size) {
+    ControlMessage message;
+    if (!message.Parse(data, size)) {
+        ESP_LOGW(TAG, "Invalid control message, size: %u", size);
+        return;
+    }
+    if (on_incoming_control_ != nullptr) {
+        on_incoming_control_(message);
+    }
+}
+
+void Protocol::ReplayAudio(const AudioStreamPacketView& packet) {
+    if (on_incoming_audio_ == nullptr) {
+        return;
+    }
+    AudioStreamPacketView view = packet;
+    view.trace_us = AudioTrace::Now();
+    on_incoming_audio_(view);
+    AudioTrace::Record(kAudioTraceReceive, view.trace_us);
+}
+
+void Protocol::ReplayText(const char* data, size_t size) {
+    JsonArena arena;
+    auto root = arena.Parse(data, size);
+    auto type = cJSON_GetObjectItem(root, "type");
+    if (!cJSON_IsString(type)) {
+        return;
+    }
+    // hello 和 goodbye 由传输层处理，回放时只取 hello 中的下行音频参数
+    if (strcmp(type->valuestring, "hello") == 0) {
+        ParseAudioParams(cJSON_GetObjectItem(root, "audio_params"));
+    } else if (strcmp(type->valuestring, "goodbye") != 0) {
+        DispatchJson(root);
+    }
+}
+
+void Protocol::ReplayControl(const uint8_t* data, size_t size) {
+    DispatchControl(data, size);
+}
+
+void Protocol::SendLatencyReport(const std::string& stats) {
+    std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"latency\",\"stats\":" + stats + "}";
+    SendText(message);
+}
+
+void Protocol::SendPlaybackReport(const std::string& stats) {
+    std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"playback\",\"stats\":" + stats + "}";
+    SendText(message);
+}
+
+void Protocol::SendReceiverReport(uint32_t received, uint32_t lost, uint32_t recovered) {
+    char stats[96];
+    snprintf(stats, sizeof(stats), "\"received\":%lu,\"lost\":%lu,\"recovered\":%lu", received, lost, recovered);
+    std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"receiver_report\"," + stats + "}";
+    SendText(message);
+}
+
+void Protocol::SendTtsCacheMiss(const std::string& cache_id) {
+    std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"tts\",\"state\":\"cache_miss\",\"cache_id\":\"" +
+        cache_id + "\"}";
+    SendText(message);
+}
+
+#if CONFIG_ADAPTIVE_KEEPALIVE
+void Protocol::PollKeepalive() {
+    if (!keepalive_enabled_ || !IsAudioChannelOpened()) {
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (keepalive_pending_) {
+        if (keepalive_replied_.exchange(false)) {
+            keepalive_pending_ = false;
+            keepalive_.OnAlive(keepalive_idle_seconds_);
+        } else if (now - keepalive_sent_time_ >= std::chrono::seconds(KEEPALIVE_REPLY_TIMEOUT_SECONDS)) {
+            // 连接已经被中间的网关回收，关掉后下次唤醒重新连接
+            keepalive_pending_ = false;
+            keepalive_.OnExpired(keepalive_idle_seconds_);
+            CloseAudioChannel();
+        }
+        return;
+    }
+    int idle = std::chrono::duration_cast<std::chrono::seconds>(now - last_incoming_time_).count();
+    if (idle < keepalive_.interval_seconds()) {
+        return;
+    }
+    keepalive_replied_ = false;
+    if (SendText("{\"session_id\":\"" + session_id_ + "\",\"type\":\"ping\"}")) {
+        keepalive_pending_ = true;
+        keepalive_idle_seconds_ = idle;
+        keepalive_sent_time_ = now;
+    }
+}
+#endif
+
 bool Protocol::IsTimeout() const {
     const int kTimeoutSeconds = 120;
     auto now = std::chrono::steady_clock::now();
@@ -130,3 +505,131 @@ bool Protocol::IsTimeout() const {
     }
     return timeout;
 }
+
+int Protocol::OpenStream(const std::string& kind, const std::string& metadata) {
+    if (!streams_enabled_ || !IsAudioChannelOpened()) {
+        return -1;
+    }
+    int id;
+    {
+        std::lock_guard<std::mutex> lock(stream_mutex_);
+        id = next_stream_id_;
+        // stream id 占 2 字节，0 保留
+        next_stream_id_ = next_stream_id_ == UINT16_MAX ? 1 : next_stream_id_ + 1;
+        streams_[id] = StreamState();
+    }
+    std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"stream\",\"state\":\"open\",\"id\":" +
+        std::to_string(id) + ",\"kind\":\"" + kind + "\",\"metadata\":" + (metadata.empty() ? "{}" : metadata) + "}";
+    if (!SendText(message)) {
+        ReleaseStream(id);
+        return -1;
+    }
+    return id;
+}
+
+bool Protocol::SendStreamData(int id, const uint8_t* data, size_t size) {
+    stream_buffer_.resize(PROTOCOL_STREAM_HEADER_SIZE + size);
+    stream_buffer_[0] = id >> 8;
+    stream_buffer_[1] = id & 0xFF;
+    memcpy(stream_buffer_.data() + PROTOCOL_STREAM_HEADER_SIZE, data, size);
+    if (!SendStreamFrame(stream_buffer_.data(), stream_buffer_.size())) {
+        std::lock_guard<std::mutex> lock(stream_mutex_);
+        auto it = streams_.find(id);
+        if (it != streams_.end()) {
+            it->second.failed = true;
+        }
+        stream_cv_.notify_all();
+        return false;
+    }
+    return true;
+}
+
+void Protocol::CloseStream(int id, bool reset) {
+    std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"stream\",\"state\":\"" +
+        (reset ? "reset" : "end") + "\",\"id\":" + std::to_string(id) + "}";
+    SendText(message);
+}
+
+bool Protocol::WaitStreamCredit(int id, size_t size, int timeout_ms) {
+    std::unique_lock<std::mutex> lock(stream_mutex_);
+    auto it = streams_.find(id);
+    if (it == streams_.end()) {
+        return false;
+    }
+    auto& stream = it->second;
+    bool ready = stream_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&stream, size]() {
+        return stream.failed || stream.finished || stream.credit >= size;
+    });
+    if (!ready || stream.failed || stream.finished) {
+        return false;
+    }
+    stream.credit -= size;
+    return true;
+}
+
+bool Protocol::WaitStreamResult(int id, std::string& result, int timeout_ms) {
+    std::unique_lock<std::mutex> lock(stream_mutex_);
+    auto it = streams_.find(id);
+    if (it == streams_.end()) {
+        return false;
+    }
+    auto& stream = it->second;
+    stream_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&stream]() {
+        return stream.failed || stream.finished;
+    });
+    if (!stream.finished) {
+        return false;
+    }
+    result = std::move(stream.result);
+    return true;
+}
+
+void Protocol::ReleaseStream(int id) {
+    std::lock_guard<std::mutex> lock(stream_mutex_);
+    streams_.erase(id);
+}
+
+void Protocol::OnStreamMessage(const cJSON* root) {
+    auto id = cJSON_GetObjectItem(root, "id");
+    auto state = cJSON_GetObjectItem(root, "state");
+    if (!cJSON_IsNumber(id) || !cJSON_IsString(state)) {
+        ESP_LOGW(TAG, "Invalid stream message");
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(stream_mutex_);
+    auto it = streams_.find(id->valueint);
+    if (it == streams_.end()) {
+        return;
+    }
+    auto& stream = it->second;
+    if (strcmp(state->valuestring, "credit") == 0) {
+        auto bytes = cJSON_GetObjectItem(root, "bytes");
+        if (cJSON_IsNumber(bytes) && bytes->valueint > 0) {
+            stream.credit += bytes->valueint;
+        }
+    } else if (strcmp(state->valuestring, "result") == 0) {
+        auto payload = cJSON_GetObjectItem(root, "payload");
+        if (cJSON_IsString(payload)) {
+            stream.result = payload->valuestring;
+        } else if (payload != nullptr) {
+            auto json_str = cJSON_PrintUnformatted(payload);
+            stream.result = json_str;
+            cJSON_free(json_str);
+        }
+        stream.finished = true;
+    } else if (strcmp(state->valuestring, "reset") == 0) {
+        auto reason = cJSON_GetObjectItem(root, "reason");
+        ESP_LOGW(TAG, "Stream %d reset by server: %s", id->valueint, cJSON_IsString(reason) ? reason->valuestring : "");
+        stream.failed = true;
+    }
+    stream_cv_.notify_all();
+}
+
+void Protocol::FailStreams() {
+    std::lock_guard<std::mutex> lock(stream_mutex_);
+    for (auto& [id, stream] : streams_) {
+        stream.failed = true;
+    }
+    stream_cv_.notify_all();
+}
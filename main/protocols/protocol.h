@@ -6,29 +6,44 @@
 #include <functional>
 #include <chrono>
 #include <vector>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "control_message.h"
+#include "binary_frame.h"
+#if CONFIG_ADAPTIVE_KEEPALIVE
+#include "keepalive_policy.h"
+#endif
+
+// 会话内数据流：每帧负载前带 2 字节 stream id（网络字节序），MQTT 上再加一个 magic 字节
+#define PROTOCOL_STREAM_MAGIC 0xC8
+#define PROTOCOL_STREAM_HEADER_SIZE 2
+#define PROTOCOL_STREAM_MAX_FRAME 1024
+// 服务器授予更多额度之前允许发送的字节数
+#define PROTOCOL_STREAM_INITIAL_CREDIT 8192
 
 struct AudioStreamPacket {
     int sample_rate = 0;
     int frame_duration = 0;
     uint32_t timestamp = 0;
+    uint32_t trace_us = 0;  // 流水线追踪的起点，只在 CONFIG_AUDIO_PIPELINE_TRACE 打开时设置
+    // payload 是丢失帧的下一包，解码时取其中的带内 FEC 恢复丢失的帧
+    bool fec = false;
     std::vector<uint8_t> payload;
 };
 
-struct BinaryProtocol2 {
-    uint16_t version;
-    uint16_t type;          // Message type (0: OPUS, 1: JSON)
-    uint32_t reserved;      // Reserved for future use
-    uint32_t timestamp;     // Timestamp in milliseconds (used for server-side AEC)
-    uint32_t payload_size;  // Payload size in bytes
-    uint8_t payload[];      // Payload data
-} __attribute__((packed));
-
-struct BinaryProtocol3 {
-    uint8_t type;
-    uint8_t reserved;
-    uint16_t payload_size;
-    uint8_t payload[];
-} __attribute__((packed));
+// 指向传输层接收缓冲区的音频包，只在 OnIncomingAudio 回调期间有效
+struct AudioStreamPacketView {
+    int sample_rate = 0;
+    int frame_duration = 0;
+    uint32_t timestamp = 0;
+    uint32_t sequence = 0;  // 0 表示传输层没有序号
+    uint32_t trace_us = 0;  // 收到的时间，只在 CONFIG_AUDIO_PIPELINE_TRACE 打开时设置
+    const uint8_t* payload = nullptr;
+    size_t payload_size = 0;
+};
 
 enum AbortReason {
     kAbortReasonNone,
@@ -51,12 +66,44 @@ public:
     inline int server_frame_duration() const {
         return server_frame_duration_;
     }
+    inline int uplink_frame_duration() const {
+        return uplink_frame_duration_;
+    }
+    // 在打开音频通道前设置，随 hello 消息发给服务器
+    void SetUplinkFrameDuration(int frame_duration) {
+        uplink_frame_duration_ = frame_duration;
+    }
     inline const std::string& session_id() const {
         return session_id_;
     }
+    inline bool streams_enabled() const {
+        return streams_enabled_;
+    }
+    // 描述的哈希随 hello 发给服务器，服务器确认缓存可用时不必重新发送描述
+    void SetDescriptorHashes(const std::string& iot_hash, const std::string& mcp_hash) {
+        iot_descriptors_hash_ = iot_hash;
+        mcp_tools_hash_ = mcp_hash;
+    }
+    inline bool iot_descriptors_cached() const {
+        return iot_descriptors_cached_;
+    }
+    // 服务器在 hello 中确认后，双方定期发送接收报告，对方据此调整带内 FEC
+    inline bool receiver_report_enabled() const {
+        return receiver_report_enabled_;
+    }
+    // 服务器在 hello 中确认 mcp_chunks 后，大的 MCP 消息可以分块发送
+    inline bool mcp_chunks_enabled() const {
+        return mcp_chunks_enabled_;
+    }
+    // 上行编码器是否打开了带内 FEC，带 flags 的协议版本据此标记音频帧
+    void SetUplinkFec(bool enabled) {
+        uplink_fec_ = enabled;
+    }
 
-    void OnIncomingAudio(std::function<void(AudioStreamPacket&& packet)> callback);
+    void OnIncomingAudio(std::function<void(const AudioStreamPacketView& packet)> callback);
     void OnIncomingJson(std::function<void(const cJSON* root)> callback);
+    // 带 type 字段的 JSON 消息和二进制控制消息统一从这里回调，其余 JSON 消息仍走 OnIncomingJson
+    void OnIncomingControl(std::function<void(const ControlMessage& message)> callback);
     void OnAudioChannelOpened(std::function<void()> callback);
     void OnAudioChannelClosed(std::function<void()> callback);
     void OnNetworkError(std::function<void(const std::string& message)> callback);
@@ -66,6 +113,9 @@ public:
     virtual void CloseAudioChannel() = 0;
     virtual bool IsAudioChannelOpened() const = 0;
     virtual bool SendAudio(const AudioStreamPacket& packet) = 0;
+    // 支持合并发送的协议在 SendAudio 中只缓存，调用 FlushAudio 后才真正发出
+    // force 为 false 时协议可以继续缓存不足一批的帧，等下一次再发
+    virtual bool FlushAudio(bool force = true);
     virtual void SendWakeWordDetected(const std::string& wake_word);
     virtual void SendStartListening(ListeningMode mode);
     virtual void SendStopListening();
@@ -73,23 +123,108 @@ public:
     virtual void SendIotDescriptors(const std::string& descriptors);
     virtual void SendIotStates(const std::string& states);
     virtual void SendMcpMessage(const std::string& message);
+    // 一条 MCP 消息的第 index 块，同一条消息的块 message_id 相同，last 为 true 时接收方拼接后再解析
+    virtual void SendMcpChunk(uint32_t message_id, uint32_t index, bool last, const std::string& fragment);
+    virtual void SendLatencyReport(const std::string& stats);
+    // 播放欠载/溢出统计，服务器据此区分网络和设备性能造成的卡顿
+    virtual void SendPlaybackReport(const std::string& stats);
+    // play_cached 的 ID 不在缓存中，服务器需要重新下发音频
+    virtual void SendTtsCacheMiss(const std::string& cache_id);
+    // 上一次报告以来下行收到、丢失和用 FEC 恢复的包数
+    virtual void SendReceiverReport(uint32_t received, uint32_t lost, uint32_t recovered);
+
+#if CONFIG_ADAPTIVE_KEEPALIVE
+    // 服务器在 hello 中确认 keepalive 后，空闲的通道按学到的间隔发送 ping，服务器回复 pong
+    bool keepalive_enabled() const { return keepalive_enabled_; }
+    // 通道空闲时在主循环中每秒调用一次，保活没有回复时关闭通道
+    void PollKeepalive();
+#endif
+
+    // 在已认证的会话上复用的数据流（拍照上传等大块数据），服务器在 hello 中确认 streams 后可用
+    // 以下三个函数和其它 Send* 一样只能在主循环中调用
+    int OpenStream(const std::string& kind, const std::string& metadata);
+    bool SendStreamData(int id, const uint8_t* data, size_t size);
+    void CloseStream(int id, bool reset);
+    // 以下函数可以在任意任务中调用
+    // 等待并预留 size 字节的发送额度
+    bool WaitStreamCredit(int id, size_t size, int timeout_ms);
+    bool WaitStreamResult(int id, std::string& result, int timeout_ms);
+    void ReleaseStream(int id);
+
+    // 回放录制的下行消息（CONFIG_USE_PROTOCOL_TRACE），和从传输层收到的一样分发，可以在任意任务中调用
+    void ReplayAudio(const AudioStreamPacketView& packet);
+    void ReplayText(const char* data, size_t size);
+    void ReplayControl(const uint8_t* data, size_t size);
 
 protected:
     std::function<void(const cJSON* root)> on_incoming_json_;
-    std::function<void(AudioStreamPacket&& packet)> on_incoming_audio_;
+    std::function<void(const ControlMessage& message)> on_incoming_control_;
+    std::function<void(const AudioStreamPacketView& packet)> on_incoming_audio_;
     std::function<void()> on_audio_channel_opened_;
     std::function<void()> on_audio_channel_closed_;
     std::function<void(const std::string& message)> on_network_error_;
 
     int server_sample_rate_ = 24000;
     int server_frame_duration_ = 60;
+    int uplink_frame_duration_ = 60;
     bool error_occurred_ = false;
+    // 服务器在 hello 中确认后，上下行的控制消息改用二进制帧
+    bool compact_control_ = false;
+    bool streams_enabled_ = false;
+    bool iot_descriptors_cached_ = false;
+    bool receiver_report_enabled_ = false;
+    bool mcp_chunks_enabled_ = false;
+    bool uplink_fec_ = false;
+    std::string iot_descriptors_hash_;
+    std::string mcp_tools_hash_;
     std::string session_id_;
     std::chrono::time_point<std::chrono::steady_clock> last_incoming_time_;
+#if CONFIG_ADAPTIVE_KEEPALIVE
+    bool keepalive_enabled_ = false;
+    KeepalivePolicy keepalive_;
+    bool keepalive_pending_ = false;
+    std::atomic<bool> keepalive_replied_{false};
+    int keepalive_idle_seconds_ = 0;
+    std::chrono::time_point<std::chrono::steady_clock> keepalive_sent_time_;
+#endif
 
     virtual bool SendText(const std::string& text) = 0;
+    // 发送二进制控制帧，不支持的传输返回 false，此时不会协商 compact_control
+    virtual bool SendControl(const std::string& frame);
+    virtual bool SupportsCompactControl() const;
+    // 发送一帧数据流，负载已经带有 stream id
+    virtual bool SendStreamFrame(const uint8_t* data, size_t size);
+    virtual bool SupportsStreams() const;
     virtual void SetError(const std::string& message);
+    // hello 消息中的 audio_params，同时告知服务器设备端不需要重采样的下行采样率和支持的帧长
+    cJSON* CreateAudioParams() const;
+    // 解析服务器 hello 中的 audio_params
+    void ParseAudioParams(const cJSON* audio_params);
+    // hello 的 features 中添加 / 解析双方都支持的可选功能
+    void AddFeatures(cJSON* features) const;
+    void ParseFeatures(const cJSON* features);
+    // 传输层收到消息后调用，分发给 OnIncomingControl 或 OnIncomingJson
+    void DispatchJson(const cJSON* root);
+    void DispatchControl(const uint8_t* data, size_t size);
     virtual bool IsTimeout() const;
+    // 通道关闭或开始新会话时让等待中的数据流失败返回
+    void FailStreams();
+
+private:
+    struct StreamState {
+        size_t credit = PROTOCOL_STREAM_INITIAL_CREDIT;
+        bool finished = false;
+        bool failed = false;
+        std::string result;
+    };
+
+    std::mutex stream_mutex_;
+    std::condition_variable stream_cv_;
+    std::map<int, StreamState> streams_;
+    int next_stream_id_ = 1;
+    std::vector<uint8_t> stream_buffer_;
+
+    void OnStreamMessage(const cJSON* root);
 };
 
 #endif // PROTOCOL_H
@@ -0,0 +1,250 @@
+#include "protocol_trace.h"
+#include "application.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define TAG "ProtocolTrace"
+
+/*
+ * 数据报格式（小端），录制和回放相同:
+ * |magic "XZTR" 4|version 1u|type 1u|fragment 1u|fragment_count 1u|sequence 4u|timestamp_us 4u|body...|
+ * sequence 是消息序号，超过 MTU 的消息拆成多个分片，分片共用 sequence 和 timestamp_us
+ * type 1 音频的 body: |sample_rate 4u|frame_duration 2u|reserved 2u|timestamp 4u|packet_sequence 4u|payload|
+ * type 2 / 3 的 body 是原始消息
+ */
+
+namespace {
+
+struct __attribute__((packed)) TraceHeader {
+    char magic[4];
+    uint8_t version;
+    uint8_t type;
+    uint8_t fragment;
+    uint8_t fragment_count;
+    uint32_t sequence;
+    uint32_t timestamp_us;
+};
+
+struct __attribute__((packed)) TraceAudioHeader {
+    uint32_t sample_rate;
+    uint16_t frame_duration;
+    uint16_t reserved;
+    uint32_t timestamp;
+    uint32_t sequence;
+};
+
+constexpr size_t kMaxFragment = PROTOCOL_TRACE_MTU - sizeof(TraceHeader);
+
+bool ParseAddress(const std::string& address, struct sockaddr_in& addr) {
+    size_t colon_pos = address.find(':');
+    if (colon_pos == std::string::npos) {
+        return false;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(std::stoi(address.substr(colon_pos + 1)));
+    return inet_pton(AF_INET, address.substr(0, colon_pos).c_str(), &addr.sin_addr) == 1;
+}
+
+class TraceRecorder {
+public:
+    static TraceRecorder& GetInstance() {
+        static TraceRecorder instance;
+        return instance;
+    }
+
+    void Send(ProtocolTraceType type, const void* head, size_t head_size, const void* body, size_t body_size) {
+        if (sockfd_ < 0) {
+            return;
+        }
+        uint32_t now = esp_timer_get_time();
+        size_t total = head_size + body_size;
+        size_t fragment_count = (total + kMaxFragment - 1) / kMaxFragment;
+        if (fragment_count == 0 || fragment_count > UINT8_MAX) {
+            ESP_LOGW(TAG, "Message too large to trace: %u", total);
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        message_.resize(total);
+        if (head_size > 0) {
+            memcpy(message_.data(), head, head_size);
+        }
+        memcpy(message_.data() + head_size, body, body_size);
+
+        TraceHeader header;
+        memcpy(header.magic, "XZTR", 4);
+        header.version = PROTOCOL_TRACE_VERSION;
+        header.type = type;
+        header.fragment_count = fragment_count;
+        header.sequence = sequence_++;
+        header.timestamp_us = now;
+        for (size_t i = 0; i < fragment_count; i++) {
+            size_t offset = i * kMaxFragment;
+            size_t size = std::min(kMaxFragment, total - offset);
+            header.fragment = i;
+            datagram_.resize(sizeof(header) + size);
+            memcpy(datagram_.data(), &header, sizeof(header));
+            memcpy(datagram_.data() + sizeof(header), message_.data() + offset, size);
+            if (sendto(sockfd_, datagram_.data(), datagram_.size(), 0,
+                    (struct sockaddr*)&server_addr_, sizeof(server_addr_)) < 0) {
+                dropped_++;
+                if ((dropped_ & (dropped_ - 1)) == 0) {
+                    ESP_LOGW(TAG, "Failed to send trace, errno: %d, dropped: %lu", errno, dropped_);
+                }
+            }
+        }
+    }
+
+private:
+    int sockfd_ = -1;
+    struct sockaddr_in server_addr_;
+    std::mutex mutex_;
+    uint32_t sequence_ = 0;
+    uint32_t dropped_ = 0;
+    std::vector<uint8_t> message_;
+    std::vector<uint8_t> datagram_;
+
+    TraceRecorder() {
+        if (!ParseAddress(CONFIG_PROTOCOL_TRACE_SERVER, server_addr_)) {
+            ESP_LOGW(TAG, "Invalid server address: %s, should be IP:PORT", CONFIG_PROTOCOL_TRACE_SERVER);
+            return;
+        }
+        sockfd_ = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sockfd_ < 0) {
+            ESP_LOGW(TAG, "Failed to create UDP socket: %d", errno);
+            return;
+        }
+        datagram_.reserve(PROTOCOL_TRACE_MTU);
+        ESP_LOGI(TAG, "Recording downlink traffic to %s", CONFIG_PROTOCOL_TRACE_SERVER);
+    }
+};
+
+void Deliver(uint8_t type, const uint8_t* body, size_t size) {
+    auto protocol = Application::GetInstance().GetProtocol();
+    if (protocol == nullptr) {
+        return;
+    }
+    if (type == kProtocolTraceAudio) {
+        TraceAudioHeader header;
+        if (size < sizeof(header)) {
+            return;
+        }
+        memcpy(&header, body, sizeof(header));
+        AudioStreamPacketView packet;
+        packet.sample_rate = header.sample_rate;
+        packet.frame_duration = header.frame_duration;
+        packet.timestamp = header.timestamp;
+        packet.sequence = header.sequence;
+        packet.payload = body + sizeof(header);
+        packet.payload_size = size - sizeof(header);
+        protocol->ReplayAudio(packet);
+    } else if (type == kProtocolTraceText) {
+        protocol->ReplayText((const char*)body, size);
+    } else if (type == kProtocolTraceControl) {
+        protocol->ReplayControl(body, size);
+    }
+}
+
+void ReplayTask(void* arg) {
+    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(CONFIG_PROTOCOL_TRACE_REPLAY_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (sockfd < 0 || bind(sockfd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        ESP_LOGE(TAG, "Failed to listen on replay port %d, errno: %d", CONFIG_PROTOCOL_TRACE_REPLAY_PORT, errno);
+        if (sockfd >= 0) {
+            close(sockfd);
+        }
+        vTaskDelete(NULL);
+        return;
+    }
+    ESP_LOGI(TAG, "Waiting for replay on port %d", CONFIG_PROTOCOL_TRACE_REPLAY_PORT);
+
+    std::vector<uint8_t> datagram(PROTOCOL_TRACE_MTU);
+    std::vector<uint8_t> message;
+    uint32_t sequence = 0;
+    int next_fragment = -1;     // -1 表示没有在拼接的消息
+    uint32_t received = 0;
+    while (true) {
+        int len = recv(sockfd, datagram.data(), datagram.size(), 0);
+        if (len < (int)sizeof(TraceHeader)) {
+            continue;
+        }
+        TraceHeader header;
+        memcpy(&header, datagram.data(), sizeof(header));
+        if (memcmp(header.magic, "XZTR", 4) != 0 || header.version != PROTOCOL_TRACE_VERSION ||
+            header.fragment >= header.fragment_count) {
+            continue;
+        }
+        const uint8_t* body = datagram.data() + sizeof(header);
+        size_t body_size = len - sizeof(header);
+        if (header.fragment_count == 1) {
+            Deliver(header.type, body, body_size);
+        } else {
+            // 分片丢失或乱序时丢弃整条消息，和现场丢包一样处理
+            if (header.fragment == 0) {
+                message.clear();
+                sequence = header.sequence;
+                next_fragment = 0;
+            }
+            if (next_fragment != header.fragment || sequence != header.sequence) {
+                next_fragment = -1;
+                continue;
+            }
+            message.insert(message.end(), body, body + body_size);
+            next_fragment++;
+            if (next_fragment == header.fragment_count) {
+                Deliver(header.type, message.data(), message.size());
+                next_fragment = -1;
+            }
+        }
+        if (++received % 500 == 0) {
+            ESP_LOGI(TAG, "Replayed %lu datagrams", received);
+        }
+    }
+}
+
+} // namespace
+
+void ProtocolTrace::RecordAudio(const AudioStreamPacketView& packet) {
+    TraceAudioHeader header = {
+        .sample_rate = (uint32_t)packet.sample_rate,
+        .frame_duration = (uint16_t)packet.frame_duration,
+        .reserved = 0,
+        .timestamp = packet.timestamp,
+        .sequence = packet.sequence,
+    };
+    TraceRecorder::GetInstance().Send(kProtocolTraceAudio, &header, sizeof(header), packet.payload, packet.payload_size);
+}
+
+void ProtocolTrace::RecordText(const char* data, size_t size) {
+    TraceRecorder::GetInstance().Send(kProtocolTraceText, nullptr, 0, data, size);
+}
+
+void ProtocolTrace::RecordControl(const uint8_t* data, size_t size) {
+    TraceRecorder::GetInstance().Send(kProtocolTraceControl, nullptr, 0, data, size);
+}
+
+void ProtocolTrace::StartReplay() {
+    static bool started = false;
+    if (started) {
+        return;
+    }
+    started = true;
+    xTaskCreate(ReplayTask, "protocol_replay", 6144, nullptr, 4, nullptr);
+}
@@ -0,0 +1,39 @@
+#ifndef PROTOCOL_TRACE_H
+#define PROTOCOL_TRACE_H
+
+#include "protocol.h"
+
+#include <cstdint>
+#include <cstddef>
+
+#define PROTOCOL_TRACE_MTU 1400
+#define PROTOCOL_TRACE_VERSION 1
+
+enum ProtocolTraceType : uint8_t {
+    kProtocolTraceAudio = 1,    // 下行音频包
+    kProtocolTraceText = 2,     // JSON 消息
+    kProtocolTraceControl = 3,  // 二进制控制消息
+};
+
+// 下行流量的录制和回放，用来在测试架上重现现场的抖动和丢包，对比抖动缓冲、解码队列和界面刷新的参数
+// 录制：传输层解析出来的每条消息带接收时间发到 CONFIG_PROTOCOL_TRACE_SERVER，由 scripts/protocol_trace.py 保存
+// 回放：监听 CONFIG_PROTOCOL_TRACE_REPLAY_PORT，把脚本按原速或加速发回的消息交给当前 Protocol，
+//       和从服务器收到的一样分发给 Application，不需要连接服务器
+// CONFIG_USE_PROTOCOL_TRACE 关闭时所有调用都是空操作
+class ProtocolTrace {
+public:
+#if CONFIG_USE_PROTOCOL_TRACE
+    static void RecordAudio(const AudioStreamPacketView& packet);
+    static void RecordText(const char* data, size_t size);
+    static void RecordControl(const uint8_t* data, size_t size);
+    // 启动回放接收任务，网络就绪后调用一次
+    static void StartReplay();
+#else
+    static void RecordAudio(const AudioStreamPacketView&) {}
+    static void RecordText(const char*, size_t) {}
+    static void RecordControl(const uint8_t*, size_t) {}
+    static void StartReplay() {}
+#endif
+};
+
+#endif // PROTOCOL_TRACE_H
@@ -0,0 +1,104 @@
+#include "transport_policy.h"
+#include "settings.h"
+
+#include <esp_log.h>
+
+#define TAG "TransportPolicy"
+
+static const char* const kKeyPrefix[kTransportCount] = {"ws", "mq"};
+
+const char* TransportKindName(TransportKind kind) {
+    return kind == kTransportWebsocket ? "websocket" : "mqtt+udp";
+}
+
+void TransportPolicy::Load() {
+    Settings settings("transport");
+    std::string prefix;
+    for (int i = 0; i < kTransportCount; i++) {
+        prefix = kKeyPrefix[i];
+        links_[i].handshake_ms = settings.GetInt(prefix + "_rtt");
+        links_[i].loss_permille = settings.GetInt(prefix + "_loss");
+        links_[i].failures = settings.GetInt(prefix + "_fail");
+    }
+}
+
+void TransportPolicy::Save(TransportKind kind) {
+    Settings settings("transport", true);
+    std::string prefix = kKeyPrefix[kind];
+    settings.SetInt(prefix + "_rtt", links_[kind].handshake_ms);
+    settings.SetInt(prefix + "_loss", links_[kind].loss_permille);
+    settings.SetInt(prefix + "_fail", links_[kind].failures);
+}
+
+void TransportPolicy::OnHandshake(TransportKind kind, bool success, int elapsed_ms) {
+    auto& link = links_[kind];
+    if (!success) {
+        link.failures++;
+    } else {
+        // 第一次直接采用，之后按 1/4 平滑
+        link.handshake_ms = link.handshake_ms == 0 ? elapsed_ms : (link.handshake_ms * 3 + elapsed_ms) / 4;
+        if (link.handshake_ms == 0) {
+            link.handshake_ms = 1;
+        }
+        link.failures = 0;
+    }
+    Save(kind);
+}
+
+void TransportPolicy::OnFailure(TransportKind kind) {
+    links_[kind].failures++;
+    Save(kind);
+}
+
+void TransportPolicy::OnSession(TransportKind kind, uint32_t received, uint32_t lost) {
+    // 包太少的会话不足以说明丢包率
+    if (received + lost < 20) {
+        return;
+    }
+    auto& link = links_[kind];
+    int loss_permille = lost * 1000 / (received + lost);
+    link.loss_permille = (link.loss_permille * 3 + loss_permille) / 4;
+    Save(kind);
+}
+
+int TransportPolicy::Score(TransportKind kind) const {
+    auto& link = links_[kind];
+    if (link.handshake_ms == 0 && link.failures == 0) {
+        return -1;
+    }
+    return link.handshake_ms + link.loss_permille * TRANSPORT_POLICY_LOSS_PENALTY_MS / 10 +
+        link.failures * TRANSPORT_POLICY_FAILURE_PENALTY_MS;
+}
+
+TransportKind TransportPolicy::Choose(TransportKind current) const {
+    auto other = OtherTransport(current);
+    int current_score = Score(current);
+    int other_score = Score(other);
+    // 当前传输层在失败而另一种没有失败记录（包括还没用过）时直接换
+    if (links_[current].failures > 0 && links_[other].failures == 0) {
+        return other;
+    }
+    if (current_score < 0 || other_score < 0) {
+        return current;
+    }
+    if (other_score * 100 < current_score * (100 - TRANSPORT_POLICY_HYSTERESIS_PERCENT)) {
+        return other;
+    }
+    return current;
+}
+
+void TransportPolicy::Reset() {
+    for (int i = 0; i < kTransportCount; i++) {
+        links_[i] = LinkQuality();
+        Save((TransportKind)i);
+    }
+}
+
+void TransportPolicy::LogStatus() const {
+    for (int i = 0; i < kTransportCount; i++) {
+        auto& link = links_[i];
+        ESP_LOGI(TAG, "%s: handshake %d ms, loss %d.%d%%, failures %d, score %d", TransportKindName((TransportKind)i),
+            link.handshake_ms, link.loss_permille / 10, link.loss_permille % 10, link.failures,
+            Score((TransportKind)i));
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef TRANSPORT_POLICY_H
+#define TRANSPORT_POLICY_H
+
+#include <cstdint>
+
+// 连续失败一次折算的握手毫秒数
+#define TRANSPORT_POLICY_FAILURE_PENALTY_MS 2000
+// 下行每 1% 丢包折算的握手毫秒数
+#define TRANSPORT_POLICY_LOSS_PENALTY_MS 50
+// 另一种传输层的得分至少好这么多才切换，避免来回抖动
+#define TRANSPORT_POLICY_HYSTERESIS_PERCENT 30
+
+enum TransportKind {
+    kTransportWebsocket,
+    kTransportMqttUdp,
+    kTransportCount
+};
+
+const char* TransportKindName(TransportKind kind);
+
+inline TransportKind OtherTransport(TransportKind kind) {
+    return kind == kTransportWebsocket ? kTransportMqttUdp : kTransportWebsocket;
+}
+
+// 按传输层统计链路质量，决定优先使用 WebSocket 还是 MQTT+UDP
+// 握手时间（建连 + 一次 hello 往返，近似 RTT）和下行丢包率做指数平滑，连续失败额外加罚，得分越低越好
+// 统计结果保存在 NVS 中，重启后继续使用，只在主循环中访问
+class TransportPolicy {
+public:
+    void Load();
+    void OnHandshake(TransportKind kind, bool success, int elapsed_ms);
+    // 会话中出现网络错误
+    void OnFailure(TransportKind kind);
+    // 通道关闭时记录本次会话的下行收包和丢包数
+    void OnSession(TransportKind kind, uint32_t received, uint32_t lost);
+
+    // 当前使用 current，返回应该使用的传输层
+    TransportKind Choose(TransportKind current) const;
+    // 还没有统计数据时返回 -1
+    int Score(TransportKind kind) const;
+    int failures(TransportKind kind) const { return links_[kind].failures; }
+    void LogStatus() const;
+    // 换了网络，原来的统计不再代表当前链路
+    void Reset();
+
+private:
+    struct LinkQuality {
+        int handshake_ms = 0;   // 0 表示还没有成功握手过
+        int loss_permille = 0;
+        int failures = 0;       // 连续失败次数，握手成功后清零
+    };
+    LinkQuality links_[kTransportCount];
+
+    void Save(TransportKind kind);
+};
+
+#endif // TRANSPORT_POLICY_H
@@ -0,0 +1,141 @@
+#include "udp_fec.h"
+
+#include <esp_log.h>
+#include <cstring>
+#include <algorithm>
+
+#define TAG "UdpFec"
+
+// 每个包在校验数据中的格式：[长度高字节][长度低字节][负载]
+static void XorPacket(uint8_t* parity, const uint8_t* payload, size_t size) {
+    parity[0] ^= (size >> 8) & 0xFF;
+    parity[1] ^= size & 0xFF;
+    for (size_t i = 0; i < size; i++) {
+        parity[2 + i] ^= payload[i];
+    }
+}
+
+void UdpFecEncoder::Configure(int group) {
+    group_ = std::min(std::max(group, 0), UDP_FEC_MAX_GROUP);
+    count_ = 0;
+    valid_ = true;
+    parity_size_ = 0;
+    if (group_ > 0) {
+        parity_.assign(UDP_FEC_MAX_PAYLOAD + 2, 0);
+    } else {
+        parity_ = std::vector<uint8_t>();
+    }
+}
+
+bool UdpFecEncoder::Add(uint32_t sequence, uint32_t timestamp, const uint8_t* payload, size_t size) {
+    if (group_ == 0) {
+        return false;
+    }
+    if (count_ == 0) {
+        base_sequence_ = sequence;
+        timestamp_ = 0;
+        valid_ = true;
+        parity_size_ = 0;
+        std::fill(parity_.begin(), parity_.end(), 0);
+    }
+    if (size > UDP_FEC_MAX_PAYLOAD) {
+        valid_ = false;
+    } else if (valid_) {
+        XorPacket(parity_.data(), payload, size);
+        timestamp_ ^= timestamp;
+        parity_size_ = std::max(parity_size_, size + 2);
+    }
+    if (++count_ < group_) {
+        return false;
+    }
+    count_ = 0;
+    return valid_;
+}
+
+void UdpFecDecoder::Configure(int group) {
+    group_ = std::min(std::max(group, 0), UDP_FEC_MAX_GROUP);
+    if (group_ == 0) {
+        window_.clear();
+        window_.shrink_to_fit();
+        recovered_ = std::vector<uint8_t>();
+        return;
+    }
+    // 保留两组，校验包稍晚到达也能恢复
+    window_.resize(group_ * 2);
+    for (auto& entry : window_) {
+        entry.valid = false;
+        entry.data.reserve(UDP_FEC_MAX_PAYLOAD);
+    }
+    recovered_.reserve(UDP_FEC_MAX_PAYLOAD + 2);
+}
+
+void UdpFecDecoder::Reset() {
+    for (auto& entry : window_) {
+        entry.valid = false;
+    }
+}
+
+void UdpFecDecoder::OnPacket(uint32_t sequence, uint32_t timestamp, const uint8_t* payload, size_t size) {
+    if (group_ == 0 || size > UDP_FEC_MAX_PAYLOAD) {
+        return;
+    }
+    auto& entry = window_[sequence % window_.size()];
+    entry.valid = true;
+    entry.sequence = sequence;
+    entry.timestamp = timestamp;
+    entry.size = size;
+    entry.data.assign(payload, payload + size);
+}
+
+const UdpFecDecoder::Entry* UdpFecDecoder::Find(uint32_t sequence) const {
+    auto& entry = window_[sequence % window_.size()];
+    if (entry.valid && entry.sequence == sequence) {
+        return &entry;
+    }
+    return nullptr;
+}
+
+bool UdpFecDecoder::Recover(uint32_t base_sequence, int count, uint32_t timestamp_xor, const uint8_t* parity, size_t size,
+    uint32_t& sequence, uint32_t& timestamp, const uint8_t*& payload, size_t& payload_size) {
+    if (group_ == 0 || count <= 0 || count > (int)window_.size() || size < 2 || size > UDP_FEC_MAX_PAYLOAD + 2) {
+        return false;
+    }
+
+    int missing = -1;
+    for (int i = 0; i < count; i++) {
+        if (Find(base_sequence + i) == nullptr) {
+            if (missing >= 0) {
+                // 丢了不止一个，无法恢复
+                return false;
+            }
+            missing = i;
+        }
+    }
+    if (missing < 0) {
+        return false;
+    }
+
+    recovered_.assign(parity, parity + size);
+    recovered_.resize(UDP_FEC_MAX_PAYLOAD + 2, 0);
+    timestamp = timestamp_xor;
+    for (int i = 0; i < count; i++) {
+        if (i == missing) {
+            continue;
+        }
+        auto entry = Find(base_sequence + i);
+        XorPacket(recovered_.data(), entry->data.data(), entry->size);
+        timestamp ^= entry->timestamp;
+    }
+
+    payload_size = (recovered_[0] << 8) | recovered_[1];
+    if (payload_size + 2 > size) {
+        ESP_LOGW(TAG, "Invalid recovered packet size: %u", payload_size);
+        return false;
+    }
+    sequence = base_sequence + missing;
+    payload = recovered_.data() + 2;
+    // 恢复出来的包也放进窗口，避免重复恢复
+    OnPacket(sequence, timestamp, payload, payload_size);
+    payload = Find(sequence)->data.data();
+    return true;
+}
@@ -0,0 +1,69 @@
+#ifndef UDP_FEC_H
+#define UDP_FEC_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#define UDP_FEC_MAX_GROUP 8
+// 超过这个长度的包不做校验，语音帧一般只有几十到两三百字节
+#define UDP_FEC_MAX_PAYLOAD 512
+
+// UDP 音频通道的 XOR 校验
+// 每 group 个音频包发送一个校验包，校验包的负载是组内每个包 [长度 2 字节][负载] 补零到等长后的异或，
+// 包头中 sequence 为组内第一个包的序号，flags 为组大小，timestamp 为组内时间戳的异或。
+// 一组中丢失一个包时可以用其余的包和校验包恢复
+class UdpFecEncoder {
+public:
+    // group 为 0 表示关闭
+    void Configure(int group);
+    bool enabled() const { return group_ > 0; }
+    int group() const { return group_; }
+
+    // 每发送一个音频包调用一次，返回 true 表示这一组已满，可以发送校验包
+    bool Add(uint32_t sequence, uint32_t timestamp, const uint8_t* payload, size_t size);
+
+    uint32_t base_sequence() const { return base_sequence_; }
+    uint32_t timestamp() const { return timestamp_; }
+    const uint8_t* data() const { return parity_.data(); }
+    size_t size() const { return parity_size_; }
+
+private:
+    int group_ = 0;
+    int count_ = 0;
+    bool valid_ = true;
+    uint32_t base_sequence_ = 0;
+    uint32_t timestamp_ = 0;
+    std::vector<uint8_t> parity_;
+    size_t parity_size_ = 0;
+};
+
+class UdpFecDecoder {
+public:
+    void Configure(int group);
+    void Reset();
+    bool enabled() const { return group_ > 0; }
+
+    // 收到音频包时保存一份明文，用于之后的恢复
+    void OnPacket(uint32_t sequence, uint32_t timestamp, const uint8_t* payload, size_t size);
+    // 收到校验包，组内正好缺一个包时恢复它，payload 指向内部缓冲区，下一次调用前有效
+    bool Recover(uint32_t base_sequence, int count, uint32_t timestamp_xor, const uint8_t* parity, size_t size,
+        uint32_t& sequence, uint32_t& timestamp, const uint8_t*& payload, size_t& payload_size);
+
+private:
+    struct Entry {
+        bool valid = false;
+        uint32_t sequence = 0;
+        uint32_t timestamp = 0;
+        uint16_t size = 0;
+        std::vector<uint8_t> data;
+    };
+
+    int group_ = 0;
+    std::vector<Entry> window_;
+    std::vector<uint8_t> recovered_;
+
+    const Entry* Find(uint32_t sequence) const;
+};
+
+#endif // UDP_FEC_H
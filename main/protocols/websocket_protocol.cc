@@ -3,15 +3,24 @@
 #include "system_info.h"
 #include "application.h"
 #include "settings.h"
+#include "json_arena.h"
+#include "audio_trace.h"
+#include "protocol_trace.h"
+#include "metrics.h"
 
 #include <cstring>
 #include <cJSON.h>
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <algorithm>
 #include <arpa/inet.h>
 #include "assets/lang_config.h"
 
 #define TAG "WS"
 
+static MetricHistogram metric_send_us("ws.send_us", METRIC_NETWORK_US_BOUNDS);
+static MetricCounter metric_rx_oversize("ws.rx_oversize");
+
 WebsocketProtocol::WebsocketProtocol() {
     event_group_handle_ = xEventGroupCreate();
 }
@@ -34,9 +43,8 @@ bool WebsocketProtocol::SendAudio(const AudioStreamPacket& packet) {
     }
 
     if (version_ == 2) {
-        std::string serialized;
-        serialized.resize(sizeof(BinaryProtocol2) + packet.payload.size());
-        auto bp2 = (BinaryProtocol2*)serialized.data();
+        send_buffer_.resize(sizeof(BinaryProtocol2) + packet.payload.size());
+        auto bp2 = (BinaryProtocol2*)send_buffer_.data();
         bp2->version = htons(version_);
         bp2->type = 0;
         bp2->reserved = 0;
@@ -44,22 +52,105 @@ bool WebsocketProtocol::SendAudio(const AudioStreamPacket& packet) {
         bp2->payload_size = htonl(packet.payload.size());
         memcpy(bp2->payload, packet.payload.data(), packet.payload.size());
 
-        return websocket_->Send(serialized.data(), serialized.size(), true);
+        return SendAudioBuffer(send_buffer_.data(), send_buffer_.size());
     } else if (version_ == 3) {
-        std::string serialized;
-        serialized.resize(sizeof(BinaryProtocol3) + packet.payload.size());
-        auto bp3 = (BinaryProtocol3*)serialized.data();
+        send_buffer_.resize(sizeof(BinaryProtocol3) + packet.payload.size());
+        auto bp3 = (BinaryProtocol3*)send_buffer_.data();
         bp3->type = 0;
         bp3->reserved = 0;
         bp3->payload_size = htons(packet.payload.size());
         memcpy(bp3->payload, packet.payload.data(), packet.payload.size());
 
-        return websocket_->Send(serialized.data(), serialized.size(), true);
+        return SendAudioBuffer(send_buffer_.data(), send_buffer_.size());
+    } else if (version_ == 4) {
+        // 放不下时先把已缓存的帧发出去
+        if (batch_frames_ > 0 && send_buffer_.size() + 2 + packet.payload.size() > WEBSOCKET_AUDIO_BATCH_MAX_BYTES) {
+            if (!FlushAudio()) {
+                return false;
+            }
+        }
+        if (batch_frames_ == 0) {
+            send_buffer_.resize(sizeof(BinaryProtocol4));
+            auto bp4 = (BinaryProtocol4*)send_buffer_.data();
+            bp4->type = 0;
+            bp4->frame_count = 0;
+            bp4->reserved = 0;
+            bp4->timestamp = htonl(packet.timestamp);
+        }
+        uint16_t size = htons(packet.payload.size());
+        auto size_bytes = (const uint8_t*)&size;
+        send_buffer_.insert(send_buffer_.end(), size_bytes, size_bytes + 2);
+        send_buffer_.insert(send_buffer_.end(), packet.payload.begin(), packet.payload.end());
+        batch_frames_++;
+        if (batch_frames_ >= WEBSOCKET_AUDIO_BATCH_MAX_FRAMES) {
+            return FlushAudio();
+        }
+        return true;
+    } else if (version_ == 5) {
+        uint8_t flags = 0;
+        if (uplink_fec_) {
+            flags |= BINARY_FRAME_FLAG_FEC;
+        }
+        // Opus 的 DTX 帧只有 1~2 字节的 TOC
+        if (packet.payload.size() <= 2) {
+            flags |= BINARY_FRAME_FLAG_DTX;
+        }
+        // 发送失败时主循环重发同一个包，序号在发送成功后才递增
+        if (!SendSequenced(flags, packet.timestamp, packet.payload.data(), packet.payload.size())) {
+            return false;
+        }
+        local_sequence_++;
+        return true;
     } else {
-        return websocket_->Send(packet.payload.data(), packet.payload.size(), true);
+        return SendAudioBuffer(packet.payload.data(), packet.payload.size());
     }
 }
 
+bool WebsocketProtocol::FlushAudio(bool force) {
+    if (batch_frames_ == 0 || (!force && batch_frames_ < min_batch_frames_)) {
+        return true;
+    }
+    auto bp4 = (BinaryProtocol4*)send_buffer_.data();
+    bp4->frame_count = batch_frames_;
+    batch_frames_ = 0;
+    if (websocket_ == nullptr) {
+        return false;
+    }
+    return SendAudioBuffer(send_buffer_.data(), send_buffer_.size());
+}
+
+bool WebsocketProtocol::SendSequenced(uint8_t flags, uint32_t timestamp, const uint8_t* data, size_t size) {
+    send_buffer_.resize(sizeof(BinaryProtocol5) + size);
+    auto bp5 = (BinaryProtocol5*)send_buffer_.data();
+    bp5->type = BINARY_PROTOCOL_TYPE_OPUS;
+    bp5->flags = flags;
+    bp5->payload_size = htons(size);
+    bp5->sequence = htonl(local_sequence_ + 1);
+    bp5->timestamp = htonl(timestamp);
+    if (size > 0) {
+        memcpy(bp5->payload, data, size);
+    }
+    return SendAudioBuffer(send_buffer_.data(), send_buffer_.size());
+}
+
+void WebsocketProtocol::SendStopListening() {
+    // 版本 5 用一个空的结束帧标出这段话的最后一个序号，服务器不必等停止消息就可以开始识别
+    if (version_ == 5 && websocket_ != nullptr && local_sequence_ > 0) {
+        if (SendSequenced(BINARY_FRAME_FLAG_END, 0, nullptr, 0)) {
+            local_sequence_++;
+        }
+    }
+    Protocol::SendStopListening();
+}
+
+// 每次发送的耗时，4G 模组上包含一次 AT 命令往返
+bool WebsocketProtocol::SendAudioBuffer(const void* data, size_t size) {
+    int64_t start = esp_timer_get_time();
+    bool ok = websocket_->Send(data, size, true);
+    metric_send_us.Record(esp_timer_get_time() - start);
+    return ok;
+}
+
 bool WebsocketProtocol::SendText(const std::string& text) {
     if (websocket_ == nullptr) {
         return false;
@@ -79,10 +170,12 @@ bool WebsocketProtocol::IsAudioChannelOpened() const {
 }
 
 void WebsocketProtocol::CloseAudioChannel() {
+    batch_frames_ = 0;
     if (websocket_ != nullptr) {
         delete websocket_;
         websocket_ = nullptr;
     }
+    FailStreams();
 }
 
 bool WebsocketProtocol::OpenAudioChannel() {
@@ -99,6 +192,12 @@ bool WebsocketProtocol::OpenAudioChannel() {
     }
 
     error_occurred_ = false;
+    compact_control_ = false;
+    streams_enabled_ = false;
+    batch_frames_ = 0;
+    local_sequence_ = 0;
+    min_batch_frames_ = std::min(Board::GetInstance().GetUplinkBatchFrames(), WEBSOCKET_AUDIO_BATCH_MAX_FRAMES);
+    send_buffer_.reserve(WEBSOCKET_AUDIO_BATCH_MAX_BYTES);
 
     websocket_ = Board::GetInstance().CreateWebSocket();
     
@@ -115,62 +214,72 @@ bool WebsocketProtocol::OpenAudioChannel() {
 
     websocket_->OnData([this](const char* data, size_t len, bool binary) {
         if (binary) {
-            if (on_incoming_audio_ != nullptr) {
-                if (version_ == 2) {
-                    BinaryProtocol2* bp2 = (BinaryProtocol2*)data;
-                    bp2->version = ntohs(bp2->version);
-                    bp2->type = ntohs(bp2->type);
-                    bp2->timestamp = ntohl(bp2->timestamp);
-                    bp2->payload_size = ntohl(bp2->payload_size);
-                    auto payload = (uint8_t*)bp2->payload;
-                    on_incoming_audio_(AudioStreamPacket{
-                        .sample_rate = server_sample_rate_,
-                        .frame_duration = server_frame_duration_,
-                        .timestamp = bp2->timestamp,
-                        .payload = std::vector<uint8_t>(payload, payload + bp2->payload_size)
-                    });
-                } else if (version_ == 3) {
-                    BinaryProtocol3* bp3 = (BinaryProtocol3*)data;
-                    bp3->type = bp3->type;
-                    bp3->payload_size = ntohs(bp3->payload_size);
-                    auto payload = (uint8_t*)bp3->payload;
-                    on_incoming_audio_(AudioStreamPacket{
-                        .sample_rate = server_sample_rate_,
-                        .frame_duration = server_frame_duration_,
-                        .timestamp = 0,
-                        .payload = std::vector<uint8_t>(payload, payload + bp3->payload_size)
-                    });
+            BinaryFrame frame;
+            if (!ParseBinaryFrame(version_, (const uint8_t*)data, len, frame)) {
+                ESP_LOGW(TAG, "Invalid binary frame, %u bytes", len);
+                return;
+            }
+            if (frame.type == BINARY_PROTOCOL_TYPE_CONTROL && SupportsCompactControl()) {
+                ProtocolTrace::RecordControl(frame.payload, frame.payload_size);
+                DispatchControl(frame.payload, frame.payload_size);
+            } else if (on_incoming_audio_ != nullptr) {
+                // 直接引用 WebSocket 接收缓冲区，由接收方决定是否拷贝
+                AudioStreamPacketView packet;
+                packet.trace_us = AudioTrace::Now();
+                packet.sample_rate = server_sample_rate_;
+                packet.frame_duration = server_frame_duration_;
+                if (version_ == 4) {
+                    // 逐帧拆开回调，长度表越界时丢弃剩余部分
+                    BinaryBatchReader reader(frame);
+                    for (int i = 0; reader.Next(packet.payload, packet.payload_size); i++) {
+                        packet.timestamp = frame.timestamp + i * server_frame_duration_;
+                        ProtocolTrace::RecordAudio(packet);
+                        on_incoming_audio_(packet);
+                        AudioTrace::Record(kAudioTraceReceive, packet.trace_us);
+                    }
+                    if (reader.truncated()) {
+                        ESP_LOGW(TAG, "Invalid batched frame size");
+                    }
+                } else if (frame.payload_size == 0 && (frame.flags & BINARY_FRAME_FLAG_END)) {
+                    // 空的结束帧只占一个序号，不交给播放
+                    return;
                 } else {
-                    on_incoming_audio_(AudioStreamPacket{
-                        .sample_rate = server_sample_rate_,
-                        .frame_duration = server_frame_duration_,
-                        .timestamp = 0,
-                        .payload = std::vector<uint8_t>((uint8_t*)data, (uint8_t*)data + len)
-                    });
+                    packet.timestamp = frame.timestamp;
+                    packet.sequence = frame.sequence;
+                    packet.payload = frame.payload;
+                    packet.payload_size = frame.payload_size;
+                    ProtocolTrace::RecordAudio(packet);
+                    on_incoming_audio_(packet);
+                    AudioTrace::Record(kAudioTraceReceive, packet.trace_us);
                 }
             }
         } else {
-            // Parse JSON data
-            auto root = cJSON_Parse(data);
+            // Parse JSON data，直接解析接收缓冲区中的文本，树建在复用的预分配缓冲区中
+            ProtocolTrace::RecordText(data, len);
+            size_t rx_size = 0;
+            void* rx_buffer = rx_buffers_.Select(len, rx_size);
+            if (rx_buffer == nullptr) {
+                metric_rx_oversize.Add();
+            }
+            JsonArena arena(rx_buffer, rx_size);
+            auto root = arena.Parse(data, len);
             auto type = cJSON_GetObjectItem(root, "type");
             if (cJSON_IsString(type)) {
                 if (strcmp(type->valuestring, "hello") == 0) {
                     ParseServerHello(root);
                 } else {
-                    if (on_incoming_json_ != nullptr) {
-                        on_incoming_json_(root);
-                    }
+                    DispatchJson(root);
                 }
             } else {
-                ESP_LOGE(TAG, "Missing message type, data: %s", data);
+                ESP_LOGE(TAG, "Missing message type, data: %.*s", (int)len, data);
             }
-            cJSON_Delete(root);
         }
         last_incoming_time_ = std::chrono::steady_clock::now();
     });
 
     websocket_->OnDisconnected([this]() {
         ESP_LOGI(TAG, "Websocket disconnected");
+        FailStreams();
         if (on_audio_channel_closed_ != nullptr) {
             on_audio_channel_closed_();
         }
@@ -204,26 +313,81 @@ bool WebsocketProtocol::OpenAudioChannel() {
     return true;
 }
 
+bool WebsocketProtocol::SupportsCompactControl() const {
+    // 版本 1 的二进制帧是裸 Opus 数据，没有 type 字段可以区分
+    return version_ >= 2;
+}
+
+bool WebsocketProtocol::SendControl(const std::string& frame) {
+    if (!compact_control_) {
+        return false;
+    }
+    return SendBinary(BINARY_PROTOCOL_TYPE_CONTROL, (const uint8_t*)frame.data(), frame.size());
+}
+
+bool WebsocketProtocol::SupportsStreams() const {
+    return version_ >= 2;
+}
+
+bool WebsocketProtocol::SendStreamFrame(const uint8_t* data, size_t size) {
+    if (!streams_enabled_) {
+        return false;
+    }
+    return SendBinary(BINARY_PROTOCOL_TYPE_STREAM, data, size);
+}
+
+bool WebsocketProtocol::SendBinary(uint16_t type, const uint8_t* data, size_t size) {
+    if (websocket_ == nullptr) {
+        return false;
+    }
+
+    // 控制消息和数据流在主循环之外组包，不复用音频的 send_buffer_
+    std::vector<uint8_t> buffer;
+    if (version_ == 2) {
+        buffer.resize(sizeof(BinaryProtocol2) + size);
+        auto bp2 = (BinaryProtocol2*)buffer.data();
+        bp2->version = htons(version_);
+        bp2->type = htons(type);
+        bp2->reserved = 0;
+        bp2->timestamp = 0;
+        bp2->payload_size = htonl(size);
+        memcpy(bp2->payload, data, size);
+    } else if (version_ == 5) {
+        buffer.resize(sizeof(BinaryProtocol5) + size);
+        auto bp5 = (BinaryProtocol5*)buffer.data();
+        bp5->type = type;
+        bp5->flags = 0;
+        bp5->payload_size = htons(size);
+        bp5->sequence = 0;
+        bp5->timestamp = 0;
+        memcpy(bp5->payload, data, size);
+    } else {
+        buffer.resize(sizeof(BinaryProtocol3) + size);
+        auto bp3 = (BinaryProtocol3*)buffer.data();
+        bp3->type = type;
+        bp3->reserved = 0;
+        bp3->payload_size = htons(size);
+        memcpy(bp3->payload, data, size);
+    }
+
+    if (!websocket_->Send(buffer.data(), buffer.size(), true)) {
+        ESP_LOGE(TAG, "Failed to send binary message, type: %u", type);
+        SetError(Lang::Strings::SERVER_ERROR);
+        return false;
+    }
+    return true;
+}
+
 std::string WebsocketProtocol::GetHelloMessage() {
     // keys: message type, version, audio_params (format, sample_rate, channels)
     cJSON* root = cJSON_CreateObject();
     cJSON_AddStringToObject(root, "type", "hello");
     cJSON_AddNumberToObject(root, "version", version_);
     cJSON* features = cJSON_CreateObject();
-#if CONFIG_USE_SERVER_AEC
-    cJSON_AddBoolToObject(features, "aec", true);
-#endif
-#if CONFIG_IOT_PROTOCOL_MCP
-    cJSON_AddBoolToObject(features, "mcp", true);
-#endif
+    AddFeatures(features);
     cJSON_AddItemToObject(root, "features", features);
     cJSON_AddStringToObject(root, "transport", "websocket");
-    cJSON* audio_params = cJSON_CreateObject();
-    cJSON_AddStringToObject(audio_params, "format", "opus");
-    cJSON_AddNumberToObject(audio_params, "sample_rate", 16000);
-    cJSON_AddNumberToObject(audio_params, "channels", 1);
-    cJSON_AddNumberToObject(audio_params, "frame_duration", OPUS_FRAME_DURATION_MS);
-    cJSON_AddItemToObject(root, "audio_params", audio_params);
+    cJSON_AddItemToObject(root, "audio_params", CreateAudioParams());
     auto json_str = cJSON_PrintUnformatted(root);
     std::string message(json_str);
     cJSON_free(json_str);
@@ -244,16 +408,18 @@ void WebsocketProtocol::ParseServerHello(const cJSON* root) {
         ESP_LOGI(TAG, "Session ID: %s", session_id_.c_str());
     }
 
-    auto audio_params = cJSON_GetObjectItem(root, "audio_params");
-    if (cJSON_IsObject(audio_params)) {
-        auto sample_rate = cJSON_GetObjectItem(audio_params, "sample_rate");
-        if (cJSON_IsNumber(sample_rate)) {
-            server_sample_rate_ = sample_rate->valueint;
-        }
-        auto frame_duration = cJSON_GetObjectItem(audio_params, "frame_duration");
-        if (cJSON_IsNumber(frame_duration)) {
-            server_frame_duration_ = frame_duration->valueint;
-        }
+    // 不认识版本 5 的服务器在 hello 中回复自己的版本，后续按服务器的版本收发
+    auto version = cJSON_GetObjectItem(root, "version");
+    if (version_ == 5 && cJSON_IsNumber(version) && version->valueint >= 1 && version->valueint < 5) {
+        ESP_LOGW(TAG, "Server does not support protocol version 5, fall back to %d", version->valueint);
+        version_ = version->valueint;
+    }
+
+    ParseAudioParams(cJSON_GetObjectItem(root, "audio_params"));
+    ParseFeatures(cJSON_GetObjectItem(root, "features"));
+    // 版本 5 的双方总是交换接收报告，不需要单独协商
+    if (version_ == 5) {
+        receiver_report_enabled_ = true;
     }
 
     xEventGroupSetBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT);
@@ -3,13 +3,23 @@
 
 
 #include "protocol.h"
+#include "json_arena.h"
 
 #include <web_socket.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
+#include <vector>
 
 #define WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT (1 << 0)
 
+// 协议版本 4 每个二进制包最多合并的帧数和字节数
+#define WEBSOCKET_AUDIO_BATCH_MAX_FRAMES 8
+#define WEBSOCKET_AUDIO_BATCH_MAX_BYTES 2048
+
+// 文本消息解析用的两档接收缓冲区：tts/stt/llm 等短消息用小的一档，长的 mcp 消息用大的一档
+#define WEBSOCKET_RX_SMALL_SIZE 2048
+#define WEBSOCKET_RX_LARGE_SIZE 16384
+
 class WebsocketProtocol : public Protocol {
 public:
     WebsocketProtocol();
@@ -17,17 +27,35 @@ public:
 
     bool Start() override;
     bool SendAudio(const AudioStreamPacket& packet) override;
+    bool FlushAudio(bool force = true) override;
     bool OpenAudioChannel() override;
     void CloseAudioChannel() override;
+    void SendStopListening() override;
     bool IsAudioChannelOpened() const override;
 
 private:
     EventGroupHandle_t event_group_handle_;
     WebSocket* websocket_ = nullptr;
     int version_ = 1;
+    // 序列化缓冲区，只在主循环中使用，避免每帧分配
+    std::vector<uint8_t> send_buffer_;
+    int batch_frames_ = 0;
+    // 主循环调用 FlushAudio(false) 时至少攒够的帧数，由板子的网络决定
+    int min_batch_frames_ = 1;
+    // 版本 5 已经发出的最后一个音频帧序号
+    uint32_t local_sequence_ = 0;
+    // 只在 WebSocket 的接收回调中使用
+    JsonRxBuffers rx_buffers_{WEBSOCKET_RX_SMALL_SIZE, WEBSOCKET_RX_LARGE_SIZE};
 
     void ParseServerHello(const cJSON* root);
     bool SendText(const std::string& text) override;
+    bool SendControl(const std::string& frame) override;
+    bool SupportsCompactControl() const override;
+    bool SendStreamFrame(const uint8_t* data, size_t size) override;
+    bool SupportsStreams() const override;
+    bool SendBinary(uint16_t type, const uint8_t* data, size_t size);
+    bool SendAudioBuffer(const void* data, size_t size);
+    bool SendSequenced(uint8_t flags, uint32_t timestamp, const uint8_t* data, size_t size);
     std::string GetHelloMessage();
 };
 
@@ -0,0 +1,78 @@
+#include "quick_boot.h"
+
+#include <esp_log.h>
+#include <esp_attr.h>
+#include <esp_sleep.h>
+#include <esp_system.h>
+#include <cstring>
+#include <ctime>
+
+#define TAG "QuickBoot"
+
+#define QUICK_BOOT_MAGIC 0x51424F54
+
+struct QuickBootContext {
+    uint32_t magic;
+    // time() 的值，系统时间在深度睡眠期间由 RTC 计时器继续走
+    int64_t version_checked_at;
+    char ssid[33];
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t phy;
+};
+
+// RTC_DATA_ATTR 只在深度睡眠唤醒时保留，上电、软件复位和 OTA 重启后都从零开始
+static RTC_DATA_ATTR QuickBootContext context;
+
+void QuickBoot::Initialize() {
+    bool deep_sleep = esp_reset_reason() == ESP_RST_DEEPSLEEP;
+    if (deep_sleep && context.magic == QUICK_BOOT_MAGIC) {
+        active_ = true;
+        switch (esp_sleep_get_wakeup_cause()) {
+            case ESP_SLEEP_WAKEUP_EXT0:
+            case ESP_SLEEP_WAKEUP_EXT1:
+            case ESP_SLEEP_WAKEUP_GPIO:
+            case ESP_SLEEP_WAKEUP_TOUCHPAD:
+                woken_by_user_ = true;
+                break;
+            default:
+                break;
+        }
+        ESP_LOGI(TAG, "Quick boot from deep sleep (%s wake)", woken_by_user_ ? "user" : "other");
+        return;
+    }
+    memset(&context, 0, sizeof(context));
+    context.magic = QUICK_BOOT_MAGIC;
+}
+
+bool QuickBoot::VersionCheckDue() const {
+    if (context.version_checked_at == 0) {
+        return true;
+    }
+    int64_t elapsed = (int64_t)time(nullptr) - context.version_checked_at;
+    return elapsed < 0 || elapsed >= CONFIG_QUICK_BOOT_VERSION_CHECK_HOURS * 3600LL;
+}
+
+void QuickBoot::MarkVersionChecked() {
+    // 系统时间可能还没同步，只要求单调，按差值判断
+    int64_t now = time(nullptr);
+    context.version_checked_at = now != 0 ? now : 1;
+}
+
+bool QuickBoot::GetNetwork(Network& network) const {
+    if (!active_ || context.ssid[0] == '\0' || context.channel == 0) {
+        return false;
+    }
+    network.ssid = context.ssid;
+    memcpy(network.bssid, context.bssid, sizeof(network.bssid));
+    network.channel = context.channel;
+    network.phy = context.phy;
+    return true;
+}
+
+void QuickBoot::SetNetwork(const Network& network) {
+    strlcpy(context.ssid, network.ssid.c_str(), sizeof(context.ssid));
+    memcpy(context.bssid, network.bssid, sizeof(context.bssid));
+    context.channel = network.channel;
+    context.phy = network.phy;
+}
@@ -0,0 +1,46 @@
+#ifndef QUICK_BOOT_H
+#define QUICK_BOOT_H
+
+#include <cstdint>
+#include <string>
+
+// 深度睡眠唤醒的快速启动（CONFIG_QUICK_BOOT）
+// 运行期间把可以复用的状态写在 RTC 慢速内存中（上电和软件复位时清零，深度睡眠期间保留）：
+// 上次连上的 AP、上次检查版本的时间。深度睡眠唤醒后 Wi-Fi 直连不读 NVS，版本检查间隔没到时不再发 HTTP 请求，
+// 按键唤醒时跳过启动提示，协议启动后直接开始对话
+class QuickBoot {
+public:
+    struct Network {
+        std::string ssid;
+        uint8_t bssid[6];
+        int channel;
+        int phy;
+    };
+
+    static QuickBoot& GetInstance() {
+        static QuickBoot instance;
+        return instance;
+    }
+
+    // 启动时尽早调用一次
+    void Initialize();
+    // 本次启动是深度睡眠唤醒并且上下文有效
+    bool active() const { return active_; }
+    // 由按键或触摸唤醒，用户大概率马上要说话；定时器唤醒不算
+    bool woken_by_user() const { return woken_by_user_; }
+
+    // 距离上次成功检查版本超过 CONFIG_QUICK_BOOT_VERSION_CHECK_HOURS
+    bool VersionCheckDue() const;
+    void MarkVersionChecked();
+
+    bool GetNetwork(Network& network) const;
+    void SetNetwork(const Network& network);
+
+private:
+    bool active_ = false;
+    bool woken_by_user_ = false;
+
+    QuickBoot() = default;
+};
+
+#endif // QUICK_BOOT_H
@@ -1,87 +1,558 @@
 #include "settings.h"
+#include "metrics.h"
+#include "flash_guard.h"
 
 #include <esp_log.h>
+#include <esp_system.h>
+#include <esp_timer.h>
 #include <nvs_flash.h>
 
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+
 #define TAG "Settings"
 
-Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
-    nvs_open(ns.c_str(), read_write_ ? NVS_READWRITE : NVS_READONLY, &nvs_handle_);
+// 整个 namespace 存成一个 blob 时使用的 key
+#define RECORD_KEY "_rec"
+#define RECORD_MAGIC 0x5352
+#define RECORD_VERSION 1
+
+// 最后一次修改后等待这么久再提交，连续修改最多推迟到 FLUSH_MAX_DELAY_MS
+#define FLUSH_DELAY_MS 1000
+#define FLUSH_MAX_DELAY_MS 5000
+
+static MetricCounter metric_commits("settings.commits");
+static MetricHistogram metric_flush_us("settings.flush_us", METRIC_DURATION_US_BOUNDS);
+
+static void FlushPending(bool forced);
+
+namespace {
+
+struct SettingValue {
+    bool is_string = false;
+    int32_t int_value = 0;
+    std::string string_value;
+};
+
+struct SettingsNamespace {
+    std::map<std::string, SettingValue> values;
+    // 以一条记录保存（CONFIG_SETTINGS_RECORD_STORE），提交时整条重写
+    bool record = false;
+    // 未提交的修改
+    bool erase_all = false;
+    std::set<std::string> dirty;
+    std::set<std::string> erased;
+    std::vector<Settings::ChangeCallback> callbacks;
+};
+
+#if CONFIG_SETTINGS_RECORD_STORE
+// 组件直接用 NVS API 读写的 namespace，保持每个值一个 key
+const char* const kPerKeyNamespaces[] = {
+    "wifi",     // esp-wifi-connect 的配网页面
+};
+
+bool UseRecord(const std::string& ns) {
+    for (auto name : kPerKeyNamespaces) {
+        if (ns == name) {
+            return false;
+        }
+    }
+    return true;
 }
 
-Settings::~Settings() {
-    if (nvs_handle_ != 0) {
-        if (read_write_ && dirty_) {
-            ESP_ERROR_CHECK(nvs_commit(nvs_handle_));
+/*
+ * 记录格式，多字节整数为小端：
+ * |magic 2u|version 1u|count 2u|
+ * 每个值：|type 1u|key_len 1u|key|，整数为 |value 4u|，字符串为 |length 2u|bytes|
+ * 解析遇到未知的类型或越界时整条记录作废
+ */
+enum RecordType : uint8_t {
+    kRecordInt = 0,
+    kRecordString = 1,
+};
+
+void PutU16(std::string& out, uint16_t value) {
+    out.push_back((char)(value & 0xFF));
+    out.push_back((char)(value >> 8));
+}
+
+uint16_t GetU16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+std::string EncodeRecord(const std::map<std::string, SettingValue>& values) {
+    size_t size = 5;
+    for (auto& item : values) {
+        size += 2 + item.first.size() + (item.second.is_string ? 2 + item.second.string_value.size() : 4);
+    }
+    std::string out;
+    out.reserve(size);
+    PutU16(out, RECORD_MAGIC);
+    out.push_back((char)RECORD_VERSION);
+    PutU16(out, values.size());
+    for (auto& item : values) {
+        auto& value = item.second;
+        out.push_back((char)(value.is_string ? kRecordString : kRecordInt));
+        out.push_back((char)item.first.size());
+        out += item.first;
+        if (value.is_string) {
+            PutU16(out, value.string_value.size());
+            out += value.string_value;
+        } else {
+            uint32_t v = (uint32_t)value.int_value;
+            for (int i = 0; i < 4; i++) {
+                out.push_back((char)(v >> (i * 8)));
+            }
         }
-        nvs_close(nvs_handle_);
     }
+    return out;
 }
 
-std::string Settings::GetString(const std::string& key, const std::string& default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
+bool DecodeRecord(const uint8_t* data, size_t size, std::map<std::string, SettingValue>& values) {
+    if (size < 5 || GetU16(data) != RECORD_MAGIC) {
+        return false;
+    }
+    if (data[2] != RECORD_VERSION) {
+        ESP_LOGE(TAG, "Unsupported record version: %u", data[2]);
+        return false;
+    }
+    int count = GetU16(data + 3);
+    const uint8_t* p = data + 5;
+    const uint8_t* end = data + size;
+    for (int i = 0; i < count; i++) {
+        if (end - p < 2 || end - p - 2 < p[1]) {
+            return false;
+        }
+        uint8_t type = p[0];
+        std::string key((const char*)p + 2, p[1]);
+        p += 2 + p[1];
+        SettingValue value;
+        if (type == kRecordInt) {
+            if (end - p < 4) {
+                return false;
+            }
+            value.int_value = (int32_t)(p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24));
+            p += 4;
+        } else if (type == kRecordString) {
+            if (end - p < 2 || end - p - 2 < GetU16(p)) {
+                return false;
+            }
+            value.is_string = true;
+            value.string_value.assign((const char*)p + 2, GetU16(p));
+            p += 2 + GetU16(p);
+        } else {
+            return false;
+        }
+        values[key] = std::move(value);
     }
+    return true;
+}
+#endif
 
-    size_t length = 0;
-    if (nvs_get_str(nvs_handle_, key.c_str(), nullptr, &length) != ESP_OK) {
-        return default_value;
+class SettingsStore {
+public:
+    std::mutex mutex;
+
+    // 调用者需要持有 mutex
+    SettingsNamespace& Get(const std::string& ns) {
+        auto it = namespaces_.find(ns);
+        if (it != namespaces_.end()) {
+            return it->second;
+        }
+        auto& space = namespaces_[ns];
+        Load(ns, space);
+        return space;
+    }
+
+    // 调用者需要持有 mutex
+    void ScheduleFlush() {
+        if (timer_ == nullptr) {
+            esp_timer_create_args_t timer_args = {
+                .callback = [](void* arg) {
+                    OnFlushTimer();
+                },
+                .arg = nullptr,
+                .dispatch_method = ESP_TIMER_TASK,
+                .name = "settings_flush",
+                .skip_unhandled_events = true,
+            };
+            ESP_ERROR_CHECK(esp_timer_create(&timer_args, &timer_));
+            // esp_restart 会先调用关机回调，重启前把缓存写入 NVS
+            esp_register_shutdown_handler([]() {
+                Settings::Flush();
+            });
+        }
+        auto now = esp_timer_get_time();
+        if (first_pending_us_ == 0) {
+            first_pending_us_ = now;
+        } else if (now - first_pending_us_ >= FLUSH_MAX_DELAY_MS * 1000) {
+            return;
+        }
+        esp_timer_stop(timer_);
+        esp_timer_start_once(timer_, FLUSH_DELAY_MS * 1000);
+    }
+
+    // 播放中提交会让音频任务停在 cache 关闭期间，等到 FlashGuard 报告的间隙再提交
+    // 返回 false 表示已经推迟太久，需要立即提交。调用者需要持有 mutex
+    bool DeferFlush() {
+        auto now = esp_timer_get_time();
+        if (deferred_since_us_ == 0) {
+            deferred_since_us_ = now;
+            FlashGuard::GetInstance().OnDeferred();
+        } else if (now - deferred_since_us_ >= FLASH_GUARD_MAX_DEFER_MS * 1000) {
+            return false;
+        }
+        esp_timer_stop(timer_);
+        esp_timer_start_once(timer_, FLASH_GUARD_RETRY_MS * 1000);
+        return true;
+    }
+
+    struct PendingWrite {
+        std::string ns;
+        bool erase_all;
+        std::vector<std::string> erased;
+        std::vector<std::pair<std::string, SettingValue>> values;
+        // 整条记录，record 为 true 时代替 erased 和 values
+        bool record = false;
+        std::string blob;
+    };
+
+    // 取出所有未提交的修改，调用者需要持有 mutex
+    std::vector<PendingWrite> TakePending() {
+        std::vector<PendingWrite> pending;
+        for (auto& item : namespaces_) {
+            auto& space = item.second;
+            if (!space.erase_all && space.dirty.empty() && space.erased.empty()) {
+                continue;
+            }
+            PendingWrite write = {item.first, space.erase_all, {space.erased.begin(), space.erased.end()}, {}};
+#if CONFIG_SETTINGS_RECORD_STORE
+            if (space.record) {
+                write.record = true;
+                write.erased.clear();
+                if (!space.values.empty()) {
+                    write.blob = EncodeRecord(space.values);
+                }
+            } else
+#endif
+            for (auto& key : space.dirty) {
+                write.values.emplace_back(key, space.values[key]);
+            }
+            space.erase_all = false;
+            space.dirty.clear();
+            space.erased.clear();
+            pending.push_back(std::move(write));
+        }
+        first_pending_us_ = 0;
+        deferred_since_us_ = 0;
+        if (timer_ != nullptr) {
+            esp_timer_stop(timer_);
+        }
+        return pending;
     }
 
-    std::string value;
-    value.resize(length);
-    ESP_ERROR_CHECK(nvs_get_str(nvs_handle_, key.c_str(), value.data(), &length));
-    while (!value.empty() && value.back() == '\0') {
-        value.pop_back();
+private:
+    std::map<std::string, SettingsNamespace> namespaces_;
+    esp_timer_handle_t timer_ = nullptr;
+    int64_t first_pending_us_ = 0;
+    int64_t deferred_since_us_ = 0;
+
+    static void OnFlushTimer();
+
+    // 调用者需要持有 mutex
+    void Load(const std::string& ns, SettingsNamespace& space) {
+        nvs_handle_t handle;
+#if CONFIG_SETTINGS_RECORD_STORE
+        space.record = UseRecord(ns);
+#endif
+        if (nvs_open(ns.c_str(), NVS_READONLY, &handle) != ESP_OK) {
+            return;
+        }
+#if CONFIG_SETTINGS_RECORD_STORE
+        if (space.record) {
+            // 一次读出整条记录；还没有记录时按单独的 key 读入，下次提交时转换成记录并删除旧的 key
+            size_t length = 0;
+            if (nvs_get_blob(handle, RECORD_KEY, nullptr, &length) == ESP_OK) {
+                std::vector<uint8_t> blob(length);
+                if (nvs_get_blob(handle, RECORD_KEY, blob.data(), &length) == ESP_OK &&
+                    DecodeRecord(blob.data(), length, space.values)) {
+                    nvs_close(handle);
+                    ESP_LOGD(TAG, "Loaded %u keys from %s record", space.values.size(), ns.c_str());
+                    return;
+                }
+                ESP_LOGE(TAG, "Invalid record in %s, fall back to keys", ns.c_str());
+                space.values.clear();
+            }
+        }
+#endif
+        nvs_iterator_t it = nullptr;
+        esp_err_t err = nvs_entry_find(NVS_DEFAULT_PART_NAME, ns.c_str(), NVS_TYPE_ANY, &it);
+        while (err == ESP_OK) {
+            nvs_entry_info_t info;
+            nvs_entry_info(it, &info);
+            SettingValue value;
+            if (info.type == NVS_TYPE_I32) {
+                if (nvs_get_i32(handle, info.key, &value.int_value) == ESP_OK) {
+                    space.values[info.key] = value;
+                }
+            } else if (info.type == NVS_TYPE_STR) {
+                size_t length = 0;
+                if (nvs_get_str(handle, info.key, nullptr, &length) == ESP_OK) {
+                    value.is_string = true;
+                    value.string_value.resize(length);
+                    nvs_get_str(handle, info.key, value.string_value.data(), &length);
+                    while (!value.string_value.empty() && value.string_value.back() == '\0') {
+                        value.string_value.pop_back();
+                    }
+                    space.values[info.key] = value;
+                }
+            }
+            err = nvs_entry_next(&it);
+        }
+        nvs_release_iterator(it);
+        nvs_close(handle);
+        ESP_LOGD(TAG, "Loaded %u keys from %s", space.values.size(), ns.c_str());
+#if CONFIG_SETTINGS_RECORD_STORE
+        if (space.record && !space.values.empty()) {
+            space.erase_all = true;
+            ScheduleFlush();
+        }
+#endif
     }
-    return value;
+};
+
+SettingsStore& Store() {
+    static SettingsStore store;
+    return store;
 }
 
-void Settings::SetString(const std::string& key, const std::string& value) {
-    if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_str(nvs_handle_, key.c_str(), value.c_str()));
-        dirty_ = true;
-    } else {
-        ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
+} // namespace
+
+Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
+}
+
+Settings::~Settings() {
+}
+
+std::string Settings::GetString(const std::string& key, const std::string& default_value) {
+    auto& store = Store();
+    std::lock_guard<std::mutex> lock(store.mutex);
+    auto& space = store.Get(ns_);
+    auto it = space.values.find(key);
+    if (it == space.values.end() || !it->second.is_string) {
+        return default_value;
     }
+    return it->second.string_value;
 }
 
 int32_t Settings::GetInt(const std::string& key, int32_t default_value) {
-    if (nvs_handle_ == 0) {
+    auto& store = Store();
+    std::lock_guard<std::mutex> lock(store.mutex);
+    auto& space = store.Get(ns_);
+    auto it = space.values.find(key);
+    if (it == space.values.end() || it->second.is_string) {
         return default_value;
     }
+    return it->second.int_value;
+}
 
-    int32_t value;
-    if (nvs_get_i32(nvs_handle_, key.c_str(), &value) != ESP_OK) {
-        return default_value;
+void Settings::SetString(const std::string& key, const std::string& value) {
+    if (!read_write_) {
+        ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
+        return;
+    }
+    std::vector<ChangeCallback> callbacks;
+    {
+        auto& store = Store();
+        std::lock_guard<std::mutex> lock(store.mutex);
+        auto& space = store.Get(ns_);
+        auto& item = space.values[key];
+        if (item.is_string && item.string_value == value && space.erased.count(key) == 0 && !space.erase_all) {
+            return;
+        }
+        item.is_string = true;
+        item.string_value = value;
+        space.dirty.insert(key);
+        space.erased.erase(key);
+        store.ScheduleFlush();
+        callbacks = space.callbacks;
+    }
+    for (auto& callback : callbacks) {
+        callback(key);
     }
-    return value;
 }
 
 void Settings::SetInt(const std::string& key, int32_t value) {
-    if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_i32(nvs_handle_, key.c_str(), value));
-        dirty_ = true;
-    } else {
+    if (!read_write_) {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
+        return;
+    }
+    std::vector<ChangeCallback> callbacks;
+    {
+        auto& store = Store();
+        std::lock_guard<std::mutex> lock(store.mutex);
+        auto& space = store.Get(ns_);
+        auto it = space.values.find(key);
+        if (it != space.values.end() && !it->second.is_string && it->second.int_value == value) {
+            return;
+        }
+        auto& item = space.values[key];
+        item.is_string = false;
+        item.int_value = value;
+        item.string_value.clear();
+        space.dirty.insert(key);
+        space.erased.erase(key);
+        store.ScheduleFlush();
+        callbacks = space.callbacks;
+    }
+    for (auto& callback : callbacks) {
+        callback(key);
     }
 }
 
 void Settings::EraseKey(const std::string& key) {
-    if (read_write_) {
-        auto ret = nvs_erase_key(nvs_handle_, key.c_str());
-        if (ret != ESP_ERR_NVS_NOT_FOUND) {
-            ESP_ERROR_CHECK(ret);
-        }
-    } else {
+    if (!read_write_) {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
+        return;
+    }
+    std::vector<ChangeCallback> callbacks;
+    {
+        auto& store = Store();
+        std::lock_guard<std::mutex> lock(store.mutex);
+        auto& space = store.Get(ns_);
+        if (space.values.erase(key) == 0) {
+            return;
+        }
+        space.dirty.erase(key);
+        space.erased.insert(key);
+        store.ScheduleFlush();
+        callbacks = space.callbacks;
+    }
+    for (auto& callback : callbacks) {
+        callback(key);
     }
 }
 
 void Settings::EraseAll() {
-    if (read_write_) {
-        ESP_ERROR_CHECK(nvs_erase_all(nvs_handle_));
-    } else {
+    if (!read_write_) {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
+        return;
+    }
+    std::vector<std::string> keys;
+    std::vector<ChangeCallback> callbacks;
+    {
+        auto& store = Store();
+        std::lock_guard<std::mutex> lock(store.mutex);
+        auto& space = store.Get(ns_);
+        for (auto& item : space.values) {
+            keys.push_back(item.first);
+        }
+        space.values.clear();
+        space.dirty.clear();
+        space.erased.clear();
+        space.erase_all = true;
+        store.ScheduleFlush();
+        callbacks = space.callbacks;
+    }
+    for (auto& key : keys) {
+        for (auto& callback : callbacks) {
+            callback(key);
+        }
+    }
+}
+
+void Settings::OnChanged(const std::string& ns, ChangeCallback callback) {
+    auto& store = Store();
+    std::lock_guard<std::mutex> lock(store.mutex);
+    store.Get(ns).callbacks.push_back(callback);
+}
+
+void SettingsStore::OnFlushTimer() {
+    bool forced = false;
+    if (!FlashGuard::GetInstance().IsGap()) {
+        auto& store = Store();
+        std::lock_guard<std::mutex> lock(store.mutex);
+        if (store.DeferFlush()) {
+            return;
+        }
+        forced = true;
+    }
+    FlushPending(forced);
+}
+
+void Settings::Flush() {
+    FlushPending(false);
+}
+
+static void FlushPending(bool forced) {
+    std::vector<SettingsStore::PendingWrite> pending;
+    {
+        auto& store = Store();
+        std::lock_guard<std::mutex> lock(store.mutex);
+        pending = store.TakePending();
+    }
+    if (pending.empty()) {
+        return;
+    }
+    auto start_time = esp_timer_get_time();
+    FlashGuard::Scope scope(kFlashOpSettings, forced);
+
+    // 每个 namespace 打开一次、提交一次
+    for (auto& write : pending) {
+        nvs_handle_t handle;
+        esp_err_t err = nvs_open(write.ns.c_str(), NVS_READWRITE, &handle);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to open %s: %s", write.ns.c_str(), esp_err_to_name(err));
+            continue;
+        }
+        if (write.erase_all) {
+            nvs_erase_all(handle);
+        }
+#if CONFIG_SETTINGS_RECORD_STORE
+        if (write.record) {
+            // 整条记录一次写入，NVS 写完新数据后才作废旧的，掉电时保留其中一份完整的记录
+            if (write.blob.empty()) {
+                err = nvs_erase_key(handle, RECORD_KEY);
+                if (err == ESP_ERR_NVS_NOT_FOUND) {
+                    err = ESP_OK;
+                }
+            } else {
+                err = nvs_set_blob(handle, RECORD_KEY, write.blob.data(), write.blob.size());
+            }
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to write %s record: %s", write.ns.c_str(), esp_err_to_name(err));
+            }
+        }
+#endif
+        for (auto& key : write.erased) {
+            nvs_erase_key(handle, key.c_str());
+        }
+        for (auto& item : write.values) {
+            if (item.second.is_string) {
+                err = nvs_set_str(handle, item.first.c_str(), item.second.string_value.c_str());
+            } else {
+                err = nvs_set_i32(handle, item.first.c_str(), item.second.int_value);
+            }
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to write %s.%s: %s", write.ns.c_str(), item.first.c_str(), esp_err_to_name(err));
+            }
+        }
+        err = nvs_commit(handle);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to commit %s: %s", write.ns.c_str(), esp_err_to_name(err));
+        }
+        nvs_close(handle);
+        if (write.record) {
+            ESP_LOGI(TAG, "Committed %s: %u byte record%s", write.ns.c_str(), write.blob.size(),
+                write.erase_all ? ", erased all" : "");
+        } else {
+            ESP_LOGI(TAG, "Committed %s: %u keys%s", write.ns.c_str(), write.values.size() + write.erased.size(),
+                write.erase_all ? ", erased all" : "");
+        }
+        metric_commits.Add();
     }
+    metric_flush_us.Record(esp_timer_get_time() - start_time);
 }
@@ -1,11 +1,19 @@
 #ifndef SETTINGS_H
 #define SETTINGS_H
 
+#include <functional>
 #include <string>
 #include <nvs_flash.h>
 
+// NVS 设置，所有 Settings 对象共享一份进程内缓存
+// 每个 namespace 第一次使用时从 NVS 读入内存，之后的读取不再访问 flash
+// 写入只更新缓存，由后台定时器合并后提交到 NVS，重启前（esp_restart）自动提交
+// 开启 CONFIG_SETTINGS_RECORD_STORE 时每个 namespace 在 NVS 中是一条二进制记录，读取和提交都只访问一次
 class Settings {
 public:
+    // key 发生变化时回调，在调用 Set/Erase 的任务中执行
+    using ChangeCallback = std::function<void(const std::string& key)>;
+
     Settings(const std::string& ns, bool read_write = false);
     ~Settings();
 
@@ -16,11 +24,13 @@ public:
     void EraseKey(const std::string& key);
     void EraseAll();
 
+    static void OnChanged(const std::string& ns, ChangeCallback callback);
+    // 立即提交所有未写入的修改，深度睡眠前调用
+    static void Flush();
+
 private:
     std::string ns_;
-    nvs_handle_t nvs_handle_ = 0;
     bool read_write_ = false;
-    bool dirty_ = false;
 };
 
 #endif
@@ -0,0 +1,68 @@
+#include "signal_levels.h"
+#include "pcm_kernels.h"
+#include "metrics.h"
+#include "async_log.h"
+
+#include <esp_log.h>
+
+#include <algorithm>
+
+#define TAG "SignalLevels"
+
+// 削波的样本数，持续增长说明麦克风增益（AUDIO_CODEC_DEFAULT_MIC_GAIN）或音量偏大
+static MetricCounter metric_capture_clipped("audio.capture_clipped");
+static MetricCounter metric_playback_clipped("audio.playback_clipped");
+
+void SignalLevels::Publish(SignalDirection direction, const int16_t* data, size_t frames, int stride) {
+    if (frames == 0) {
+        return;
+    }
+    pcm::LevelStats stats;
+    pcm::AnalyzeLevel(data, frames, stride, stats);
+    uint16_t clipped = std::min<uint32_t>(stats.clipped, UINT16_MAX);
+    if (clipped > 0) {
+        if (direction == kSignalCapture) {
+            metric_capture_clipped.Add(clipped);
+            LOGW_LIMITED(TAG, 10000, "Microphone clipping, %u samples in one frame", clipped);
+        } else {
+            metric_playback_clipped.Add(clipped);
+        }
+    }
+
+    auto& slot = slots_[direction];
+    uint32_t version = slot.version.load(std::memory_order_relaxed);
+    slot.version.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.sequence.store(slot.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    slot.energy.store((uint32_t)(stats.sum_squares / frames), std::memory_order_relaxed);
+    slot.peak_clipped.store((uint32_t)std::min<int32_t>(stats.peak, UINT16_MAX) | ((uint32_t)clipped << 16),
+        std::memory_order_relaxed);
+    slot.crossings_samples.store(std::min<uint32_t>(stats.zero_crossings, UINT16_MAX) |
+        ((uint32_t)std::min<size_t>(frames, UINT16_MAX) << 16), std::memory_order_relaxed);
+    slot.version.store(version + 2, std::memory_order_release);
+}
+
+SignalLevel SignalLevels::Get(SignalDirection direction) const {
+    auto& slot = slots_[direction];
+    SignalLevel level;
+    // 写入者被抢占在写入中途时不能一直等，几次都没读到完整的一帧就当作没有数据
+    for (int attempt = 0; attempt < 4; attempt++) {
+        uint32_t version = slot.version.load(std::memory_order_acquire);
+        if (version & 1) {
+            continue;
+        }
+        level.sequence = slot.sequence.load(std::memory_order_relaxed);
+        level.energy = slot.energy.load(std::memory_order_relaxed);
+        uint32_t peak_clipped = slot.peak_clipped.load(std::memory_order_relaxed);
+        uint32_t crossings_samples = slot.crossings_samples.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.version.load(std::memory_order_relaxed) == version) {
+            level.peak = peak_clipped & 0xFFFF;
+            level.clipped = peak_clipped >> 16;
+            level.zero_crossings = crossings_samples & 0xFFFF;
+            level.samples = crossings_samples >> 16;
+            return level;
+        }
+    }
+    return SignalLevel();
+}
@@ -0,0 +1,58 @@
+#ifndef SIGNAL_LEVELS_H
+#define SIGNAL_LEVELS_H
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+enum SignalDirection {
+    kSignalCapture,    // 16kHz 采集帧的第一路麦克风
+    kSignalPlayback,   // 混音后送进 codec 的播放帧
+    kSignalDirectionCount
+};
+
+// 一帧的电平
+struct SignalLevel {
+    uint32_t sequence = 0;        // 每发布一帧加一，0 表示还没有数据
+    uint32_t energy = 0;          // 样本平方的均值
+    uint16_t peak = 0;
+    uint16_t clipped = 0;
+    uint16_t zero_crossings = 0;
+    uint16_t samples = 0;
+
+    float rms() const { return std::sqrt((float)energy); }
+    // 相对满幅的 dB，静音时为 -96
+    float dbfs() const { return energy > 0 ? 10.0f * std::log10((float)energy / (32768.0f * 32768.0f)) : -96.0f; }
+};
+
+// 采集和播放帧的电平统计，每帧在音频路径上只算一次
+// 能量门控、削波检测等读取最近一帧的结果，不再各自遍历 PCM
+// 每个方向只有一个写入者（采集任务 / 解码通道），读取用版本号检查并重试，不加锁
+class SignalLevels {
+public:
+    static SignalLevels& GetInstance() {
+        static SignalLevels instance;
+        return instance;
+    }
+
+    // 统计 stride 路交织数据的第一路并发布
+    void Publish(SignalDirection direction, const int16_t* data, size_t frames, int stride = 1);
+    // 和写入冲突太多次时返回 sequence 为 0 的空结果
+    SignalLevel Get(SignalDirection direction) const;
+
+private:
+    struct Slot {
+        // 写入期间为奇数
+        std::atomic<uint32_t> version{0};
+        std::atomic<uint32_t> sequence{0};
+        std::atomic<uint32_t> energy{0};
+        std::atomic<uint32_t> peak_clipped{0};
+        std::atomic<uint32_t> crossings_samples{0};
+    };
+    Slot slots_[kSignalDirectionCount];
+
+    SignalLevels() = default;
+};
+
+#endif // SIGNAL_LEVELS_H
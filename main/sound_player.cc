@@ -0,0 +1,255 @@
+#include "sound_player.h"
+#include "protocol.h"
+
+#include <esp_log.h>
+#include <esp_partition.h>
+#include <arpa/inet.h>
+#include <algorithm>
+
+#define TAG "SoundPlayer"
+
+void SoundPlayer::AddCacheable(std::string_view sound) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (sound.empty() || FindCache(sound) >= 0 || cache_count_ >= SOUND_PLAYER_MAX_CACHED) {
+        return;
+    }
+    cache_[cache_count_++].data = sound.data();
+}
+
+void SoundPlayer::AddPcm(std::string_view sound, std::string_view pcm) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (sound.empty() || pcm.size() < sizeof(int16_t) || pcm_count_ >= SOUND_PLAYER_MAX_PCM) {
+        return;
+    }
+    if ((uintptr_t)pcm.data() % alignof(int16_t) != 0) {
+        ESP_LOGW(TAG, "Unaligned PCM sound, fall back to p3");
+        return;
+    }
+    auto& asset = pcm_assets_[pcm_count_++];
+    asset.data = sound.data();
+    asset.pcm = (const int16_t*)pcm.data();
+    asset.samples = pcm.size() / sizeof(int16_t);
+}
+
+int SoundPlayer::FindCache(std::string_view sound) const {
+    for (int i = 0; i < cache_count_; i++) {
+        if (cache_[i].data == sound.data()) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool SoundPlayer::Enqueue(std::string_view sound, uint32_t start_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (queue_count_ >= SOUND_PLAYER_QUEUE_SIZE) {
+        ESP_LOGW(TAG, "Too many sounds in queue, drop the newest one");
+        return false;
+    }
+    queue_[(queue_head_ + queue_count_) % SOUND_PLAYER_QUEUE_SIZE] = QueueItem{sound, start_ms};
+    queue_count_++;
+    return true;
+}
+
+void SoundPlayer::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_count_ = 0;
+    current_ = std::string_view();
+    offset_ = 0;
+    current_cache_ = -1;
+    current_pcm_ = nullptr;
+    current_file_ = P3File();
+    // 正在解码的帧不再写入缓存
+    generation_++;
+    for (int i = 0; i < cache_count_; i++) {
+        if (cache_[i].filling) {
+            cache_[i].filling = false;
+            cache_[i].pcm.clear();
+        }
+    }
+}
+
+bool SoundPlayer::IsPlaying() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_count_ > 0 || !current_.empty();
+}
+
+bool SoundPlayer::Start(const QueueItem& item) {
+    current_ = item.sound;
+    offset_ = 0;
+    current_pcm_ = nullptr;
+    current_cache_ = -1;
+    if (P3File::IsIndexed(current_)) {
+        // 提示音解码器固定为 16kHz 60ms
+        if (!current_file_.Open(current_) || current_file_.sample_rate() != 16000 || current_file_.frame_duration() != 60) {
+            ESP_LOGW(TAG, "Unsupported p3 v2 sound (%d Hz, %d ms)", current_file_.sample_rate(), current_file_.frame_duration());
+            current_ = std::string_view();
+            return false;
+        }
+        offset_ = current_file_.FrameAt(item.start_ms);
+    } else {
+        current_file_ = P3File();
+    }
+    if (item.start_ms > 0) {
+        // 从中间开始播放时不使用 PCM，也不写入缓存
+        if (!current_file_.indexed()) {
+            SeekV1(item.start_ms);
+        }
+        return true;
+    }
+
+    for (int i = 0; i < pcm_count_; i++) {
+        if (pcm_assets_[i].data == current_.data()) {
+            current_pcm_ = pcm_assets_[i].pcm;
+            current_pcm_samples_ = pcm_assets_[i].samples;
+            return true;
+        }
+    }
+    current_cache_ = FindCache(current_);
+    if (current_cache_ >= 0) {
+        auto& entry = cache_[current_cache_];
+        if (entry.ready) {
+            // 缓存就绪后不再修改，可以直接引用
+            current_pcm_ = entry.pcm.data();
+            current_pcm_samples_ = entry.pcm.size();
+            current_cache_ = -1;
+        } else if (entry.filling) {
+            // 同一个提示音还在填充中，这次不再重复缓存
+            current_cache_ = -1;
+        } else {
+            entry.filling = true;
+            entry.pcm.clear();
+        }
+    }
+    return true;
+}
+
+// v1 没有偏移表，只能逐帧跳过
+void SoundPlayer::SeekV1(uint32_t start_ms) {
+    for (uint32_t skipped = 0; skipped < start_ms / 60; skipped++) {
+        if (offset_ + sizeof(BinaryProtocol3) > current_.size()) {
+            break;
+        }
+        auto p3 = (const BinaryProtocol3*)(current_.data() + offset_);
+        offset_ = std::min(current_.size(), offset_ + sizeof(BinaryProtocol3) + ntohs(p3->payload_size));
+    }
+}
+
+bool SoundPlayer::Next(SoundFrame& frame, size_t pcm_chunk_samples) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (current_.empty()) {
+        if (queue_count_ == 0) {
+            return false;
+        }
+        QueueItem item = queue_[queue_head_];
+        queue_head_ = (queue_head_ + 1) % SOUND_PLAYER_QUEUE_SIZE;
+        queue_count_--;
+        Start(item);
+    }
+
+    frame = SoundFrame();
+    frame.generation = generation_;
+    if (current_pcm_ != nullptr) {
+        frame.pcm = current_pcm_ + offset_;
+        frame.samples = std::min(pcm_chunk_samples, current_pcm_samples_ - offset_);
+        offset_ += frame.samples;
+        frame.last = offset_ >= current_pcm_samples_;
+    } else if (current_file_.indexed()) {
+        if (!current_file_.GetFrame(offset_, frame.payload, frame.payload_size)) {
+            frame.payload = nullptr;
+            frame.payload_size = 0;
+        }
+        offset_++;
+        frame.last = offset_ >= current_file_.frame_count();
+        frame.cache_index = current_cache_;
+    } else {
+        if (offset_ + sizeof(BinaryProtocol3) > current_.size()) {
+            frame.last = true;
+        } else {
+            auto p3 = (const BinaryProtocol3*)(current_.data() + offset_);
+            size_t payload_size = ntohs(p3->payload_size);
+            offset_ += sizeof(BinaryProtocol3);
+            if (offset_ + payload_size > current_.size()) {
+                ESP_LOGW(TAG, "Truncated sound frame at offset %u", (unsigned)offset_);
+                payload_size = current_.size() - offset_;
+            }
+            frame.payload = p3->payload;
+            frame.payload_size = payload_size;
+            offset_ += payload_size;
+            frame.last = offset_ + sizeof(BinaryProtocol3) > current_.size();
+        }
+        frame.cache_index = current_cache_;
+    }
+
+    if (frame.last) {
+        current_ = std::string_view();
+        current_cache_ = -1;
+        current_pcm_ = nullptr;
+        current_file_ = P3File();
+    }
+    return frame.payload_size > 0 || frame.samples > 0 || frame.last;
+}
+
+void SoundPlayer::AppendCache(const SoundFrame& frame, const std::vector<int16_t>& pcm) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (frame.cache_index < 0 || frame.generation != generation_) {
+        return;
+    }
+    auto& entry = cache_[frame.cache_index];
+    if (!entry.filling) {
+        return;
+    }
+    entry.pcm.insert(entry.pcm.end(), pcm.begin(), pcm.end());
+    if (frame.last) {
+        entry.filling = false;
+        entry.ready = !entry.pcm.empty();
+        entry.pcm.shrink_to_fit();
+        ESP_LOGI(TAG, "Cached %u samples of decoded sound", (unsigned)entry.pcm.size());
+    }
+}
+
+std::string_view SoundPlayer::MapPartition(const char* label) {
+    auto partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (partition == nullptr) {
+        ESP_LOGW(TAG, "Sound partition %s not found", label);
+        return std::string_view();
+    }
+    // 先只映射文件头和偏移表，得到文件长度后再映射整个文件
+    P3FileHeader header;
+    if (esp_partition_read(partition, 0, &header, sizeof(header)) != ESP_OK
+            || !P3File::IsIndexed(std::string_view((const char*)&header, sizeof(header)))) {
+        ESP_LOGW(TAG, "No p3 v2 sound in partition %s", label);
+        return std::string_view();
+    }
+    size_t table_size = ntohl(header.data_offset);
+    uint32_t count = ntohl(header.frame_count);
+    if (table_size > partition->size || count >= table_size / sizeof(uint32_t)) {
+        ESP_LOGW(TAG, "Invalid p3 v2 header in partition %s", label);
+        return std::string_view();
+    }
+    uint32_t total;
+    if (esp_partition_read(partition, sizeof(P3FileHeader) + count * sizeof(uint32_t), &total, sizeof(total)) != ESP_OK) {
+        return std::string_view();
+    }
+    size_t size = table_size + ntohl(total);
+    if (size > partition->size) {
+        ESP_LOGW(TAG, "Truncated p3 v2 sound in partition %s", label);
+        return std::string_view();
+    }
+
+    const void* data = nullptr;
+    esp_partition_mmap_handle_t handle;
+    esp_err_t err = esp_partition_mmap(partition, 0, size, ESP_PARTITION_MMAP_DATA, &data, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to map sound partition %s: %s", label, esp_err_to_name(err));
+        return std::string_view();
+    }
+    P3File file;
+    if (!file.Open(std::string_view((const char*)data, size))) {
+        esp_partition_munmap(handle);
+        ESP_LOGW(TAG, "Invalid p3 v2 sound in partition %s", label);
+        return std::string_view();
+    }
+    ESP_LOGI(TAG, "Mapped %u bytes of sound from partition %s, %lu ms", (unsigned)size, label, (unsigned long)file.duration_ms());
+    return std::string_view((const char*)data, size);
+}
@@ -0,0 +1,90 @@
+#ifndef SOUND_PLAYER_H
+#define SOUND_PLAYER_H
+
+#include <string_view>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+#include "p3_file.h"
+
+#define SOUND_PLAYER_QUEUE_SIZE 16
+#define SOUND_PLAYER_MAX_CACHED 3
+#define SOUND_PLAYER_MAX_PCM 8
+
+// 播放时取出的一帧，Opus 帧直接指向 flash 中的资源，缓存命中时指向解码后的 PCM
+struct SoundFrame {
+    const uint8_t* payload = nullptr;
+    size_t payload_size = 0;
+    const int16_t* pcm = nullptr;
+    size_t samples = 0;
+    int cache_index = -1;       // >= 0 表示解码结果需要写入缓存
+    uint32_t generation = 0;
+    bool last = false;
+};
+
+// 内嵌 p3 提示音的流式播放
+// 资源由 EMBED_FILES 映射在 flash 中，播放时由音频任务逐帧读取，不再整段拷贝进解码队列
+// 常用的短提示音可以注册为可缓存，第一次播放时顺便保存解码后的 PCM，之后直接输出
+// 构建时预解码的 PCM 资源注册后，播放对应的 p3 时直接输出 PCM，不经过解码器
+// v2 的 p3 带偏移表，可以从任意位置开始播放，较长的音频可以放在单独的 flash 分区里映射后播放
+class SoundPlayer {
+public:
+    void AddCacheable(std::string_view sound);
+    // pcm 为 16 位单声道，采样率必须与输出采样率一致
+    void AddPcm(std::string_view sound, std::string_view pcm);
+
+    // 任意任务调用，按顺序播放，start_ms 为开始播放的位置
+    bool Enqueue(std::string_view sound, uint32_t start_ms = 0);
+    void Clear();
+    bool IsPlaying();
+
+    // 音频任务调用，pcm_chunk_samples 为缓存命中时每次输出的样本数
+    bool Next(SoundFrame& frame, size_t pcm_chunk_samples);
+    // 解码任务调用
+    void AppendCache(const SoundFrame& frame, const std::vector<int16_t>& pcm);
+
+    // 把分区开头的 v2 p3 映射到地址空间，映射一直保留，失败时返回空
+    static std::string_view MapPartition(const char* label);
+
+private:
+    struct PcmAsset {
+        const char* data = nullptr;
+        const int16_t* pcm = nullptr;
+        size_t samples = 0;
+    };
+
+    struct CacheEntry {
+        const char* data = nullptr;
+        std::vector<int16_t> pcm;
+        bool ready = false;
+        bool filling = false;
+    };
+
+    struct QueueItem {
+        std::string_view sound;
+        uint32_t start_ms = 0;
+    };
+
+    std::mutex mutex_;
+    QueueItem queue_[SOUND_PLAYER_QUEUE_SIZE];
+    size_t queue_head_ = 0;
+    size_t queue_count_ = 0;
+    std::string_view current_;
+    size_t offset_ = 0;         // v1 为字节偏移，v2 为帧序号，PCM 为样本偏移
+    P3File current_file_;
+    int current_cache_ = -1;
+    const int16_t* current_pcm_ = nullptr;
+    size_t current_pcm_samples_ = 0;
+    uint32_t generation_ = 0;
+    CacheEntry cache_[SOUND_PLAYER_MAX_CACHED];
+    int cache_count_ = 0;
+    PcmAsset pcm_assets_[SOUND_PLAYER_MAX_PCM];
+    int pcm_count_ = 0;
+
+    int FindCache(std::string_view sound) const;
+    bool Start(const QueueItem& item);
+    void SeekV1(uint32_t start_ms);
+};
+
+#endif // SOUND_PLAYER_H
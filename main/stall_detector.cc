@@ -0,0 +1,122 @@
+#include "stall_detector.h"
+
+#if CONFIG_STALL_DETECTOR
+#include "metrics.h"
+
+#include <esp_log.h>
+
+#define TAG "StallDetector"
+
+// 看门狗检查间隔
+#define STALL_CHECK_INTERVAL_MS 100
+
+// 循环耗时的分桶，单位微秒
+#define STALL_LOOP_US_BOUNDS {1000, 5000, 10000, 20000, 50000, 100000, 200000, 500000, 1000000, 5000000}
+
+namespace {
+
+struct LoopSlot {
+    const char* name;
+    uint32_t budget_us;
+    MetricHistogram duration;
+    MetricCounter stalls;
+    // 正在进行的工作，start_us 为 0 表示空闲
+    std::atomic<uint32_t> start_us{0};
+    std::atomic<const char*> label{nullptr};
+    std::atomic<const void*> caller{nullptr};
+    std::atomic<bool> reported{false};
+};
+
+// 顺序与 StallLoop 一致
+LoopSlot slots[kStallLoopCount] = {
+    {"main", CONFIG_STALL_BUDGET_MAIN_MS * 1000, {"loop.main_us", STALL_LOOP_US_BOUNDS}, MetricCounter("loop.main_stalls")},
+    {"audio_input", CONFIG_STALL_BUDGET_AUDIO_MS * 1000, {"loop.audio_input_us", STALL_LOOP_US_BOUNDS}, MetricCounter("loop.audio_input_stalls")},
+    {"audio_output", CONFIG_STALL_BUDGET_AUDIO_MS * 1000, {"loop.audio_output_us", STALL_LOOP_US_BOUNDS}, MetricCounter("loop.audio_output_stalls")},
+    {"display_lock", CONFIG_STALL_BUDGET_DISPLAY_MS * 1000, {"loop.display_lock_us", STALL_LOOP_US_BOUNDS}, MetricCounter("loop.display_lock_stalls")},
+};
+
+esp_timer_handle_t watchdog_timer = nullptr;
+std::atomic<bool> watchdog_armed{false};
+
+uint32_t NowUs() {
+    // 0 表示空闲
+    uint32_t now = esp_timer_get_time();
+    return now == 0 ? 1 : now;
+}
+
+void ArmWatchdog() {
+    if (watchdog_armed.exchange(true)) {
+        return;
+    }
+    if (watchdog_timer == nullptr) {
+        esp_timer_create_args_t timer_args = {
+            .callback = [](void* arg) {
+                // 先清除标记再检查，检查期间开始的工作会自己重新启动定时器
+                watchdog_armed = false;
+                bool busy = false;
+                uint32_t now = NowUs();
+                for (auto& slot : slots) {
+                    uint32_t start = slot.start_us.load();
+                    if (start == 0) {
+                        continue;
+                    }
+                    busy = true;
+                    uint32_t elapsed = now - start;
+                    if (elapsed > slot.budget_us && !slot.reported.exchange(true)) {
+                        slot.stalls.Add();
+                        ESP_LOGW(TAG, "%s loop stalled for %lu ms in %s, started at %lu ms, Backtrace: %p",
+                            slot.name, elapsed / 1000, slot.label.load(), start / 1000, slot.caller.load());
+                    }
+                }
+                if (busy) {
+                    ArmWatchdog();
+                }
+            },
+            .arg = nullptr,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "stall_watchdog",
+            .skip_unhandled_events = true,
+        };
+        esp_timer_create(&timer_args, &watchdog_timer);
+    }
+    esp_timer_start_once(watchdog_timer, STALL_CHECK_INTERVAL_MS * 1000);
+}
+
+} // namespace
+
+void StallDetector::Begin(StallLoop loop, const char* label, const void* caller) {
+    auto& slot = slots[loop];
+    slot.label = label;
+    slot.caller = caller;
+    slot.reported = false;
+    slot.start_us = NowUs();
+    // 只有工作进行期间才需要看门狗，空闲时不定时唤醒
+    ArmWatchdog();
+}
+
+void StallDetector::End(StallLoop loop) {
+    auto& slot = slots[loop];
+    uint32_t start = slot.start_us.exchange(0);
+    if (start == 0) {
+        return;
+    }
+    uint32_t duration = NowUs() - start;
+    slot.duration.Record(duration);
+    if (duration > slot.budget_us) {
+        if (!slot.reported) {
+            slot.stalls.Add();
+        }
+        ESP_LOGW(TAG, "%s loop spent %lu ms in %s, started at %lu ms, Backtrace: %p",
+            slot.name, duration / 1000, slot.label.load(), start / 1000, slot.caller.load());
+    }
+}
+
+void StallDetector::Record(StallLoop loop, const char* label, const void* caller, uint32_t duration_us) {
+    auto& slot = slots[loop];
+    slot.duration.Record(duration_us);
+    if (duration_us > slot.budget_us) {
+        slot.stalls.Add();
+        ESP_LOGW(TAG, "%s waited %lu ms in %s, Backtrace: %p", slot.name, duration_us / 1000, label, caller);
+    }
+}
+#endif // CONFIG_STALL_DETECTOR
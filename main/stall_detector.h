@@ -0,0 +1,51 @@
+#ifndef STALL_DETECTOR_H
+#define STALL_DETECTOR_H
+
+#include <atomic>
+#include <cstdint>
+
+#include <esp_timer.h>
+
+enum StallLoop {
+    kStallLoopMain,
+    kStallLoopAudioInput,
+    kStallLoopAudioOutput,
+    kStallLoopDisplay,          // 等待显示锁（LVGL 任务持有锁渲染期间）
+    kStallLoopCount
+};
+
+// 主循环、音频循环和显示锁的卡顿检测
+// 循环每处理一项工作前调用 Begin，结束后调用 End；工作超过耗时预算时，看门狗定时器在工作还没结束时先报告一次，
+// 结束后再报告总耗时。报告带上工作的名字和调度它的代码地址（idf.py monitor 会解析成函数和行号），
+// 每个循环的耗时直方图和超时次数登记为 loop.* 指标
+// CONFIG_STALL_DETECTOR 关闭时所有调用都是空操作
+class StallDetector {
+public:
+#if CONFIG_STALL_DETECTOR
+    // label 需要是字符串常量
+    static void Begin(StallLoop loop, const char* label, const void* caller = nullptr);
+    static void End(StallLoop loop);
+    // 记录已经结束的一次等待，用于可能被多个任务同时进入的地方（显示锁）
+    static void Record(StallLoop loop, const char* label, const void* caller, uint32_t duration_us);
+#else
+    static void Begin(StallLoop, const char*, const void* = nullptr) {}
+    static void End(StallLoop) {}
+    static void Record(StallLoop, const char*, const void*, uint32_t) {}
+#endif
+};
+
+// 作用域内的工作
+class StallScope {
+public:
+    StallScope(StallLoop loop, const char* label, const void* caller = nullptr) : loop_(loop) {
+        StallDetector::Begin(loop, label, caller);
+    }
+    ~StallScope() { StallDetector::End(loop_); }
+    StallScope(const StallScope&) = delete;
+    StallScope& operator=(const StallScope&) = delete;
+
+private:
+    StallLoop loop_;
+};
+
+#endif // STALL_DETECTOR_H
@@ -0,0 +1,94 @@
+#include "stream_uploader.h"
+#include "application.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <vector>
+
+#define TAG "StreamUploader"
+
+StreamUploader::StreamUploader(const std::string& kind, const std::string& metadata)
+    : kind_(kind), metadata_(metadata) {
+}
+
+StreamUploader::~StreamUploader() {
+    if (id_ < 0) {
+        return;
+    }
+    auto& app = Application::GetInstance();
+    auto protocol = app.GetProtocol();
+    protocol->ReleaseStream(id_);
+    if (!finished_) {
+        // 中途放弃的上传通知服务器丢弃已收到的数据
+        int id = id_;
+        app.Schedule([protocol, id]() {
+            protocol->CloseStream(id, true);
+        });
+    }
+}
+
+bool StreamUploader::Open() {
+    auto& app = Application::GetInstance();
+    auto protocol = app.GetProtocol();
+    if (protocol == nullptr || !protocol->streams_enabled()) {
+        return false;
+    }
+
+    // 超时返回后 lambda 仍可能执行，状态放在共享的 promise 中
+    auto promise = std::make_shared<std::promise<int>>();
+    auto future = promise->get_future();
+    app.Schedule([protocol, promise, kind = kind_, metadata = metadata_]() {
+        promise->set_value(protocol->OpenStream(kind, metadata));
+    });
+    if (future.wait_for(std::chrono::milliseconds(STREAM_UPLOADER_TIMEOUT_MS)) != std::future_status::ready) {
+        ESP_LOGW(TAG, "Timeout opening %s stream", kind_.c_str());
+        return false;
+    }
+    id_ = future.get();
+    if (id_ < 0) {
+        return false;
+    }
+    ESP_LOGI(TAG, "Opened %s stream %d", kind_.c_str(), id_);
+    return true;
+}
+
+bool StreamUploader::Write(const uint8_t* data, size_t size) {
+    if (id_ < 0) {
+        return false;
+    }
+    auto& app = Application::GetInstance();
+    auto protocol = app.GetProtocol();
+    while (size > 0) {
+        size_t chunk = std::min<size_t>(size, PROTOCOL_STREAM_MAX_FRAME);
+        if (!protocol->WaitStreamCredit(id_, chunk, STREAM_UPLOADER_TIMEOUT_MS)) {
+            ESP_LOGW(TAG, "Stream %d has no credit or failed", id_);
+            return false;
+        }
+        int id = id_;
+        app.Schedule([protocol, id, payload = std::vector<uint8_t>(data, data + chunk)]() {
+            protocol->SendStreamData(id, payload.data(), payload.size());
+        });
+        data += chunk;
+        size -= chunk;
+    }
+    return true;
+}
+
+bool StreamUploader::Finish(std::string& result, int timeout_ms) {
+    if (id_ < 0) {
+        return false;
+    }
+    auto& app = Application::GetInstance();
+    auto protocol = app.GetProtocol();
+    int id = id_;
+    app.Schedule([protocol, id]() {
+        protocol->CloseStream(id, false);
+    });
+    finished_ = protocol->WaitStreamResult(id_, result, timeout_ms);
+    if (!finished_) {
+        ESP_LOGW(TAG, "Stream %d finished without result", id_);
+    }
+    return finished_;
+}
@@ -0,0 +1,29 @@
+#ifndef STREAM_UPLOADER_H
+#define STREAM_UPLOADER_H
+
+#include <string>
+#include <cstdint>
+
+#define STREAM_UPLOADER_TIMEOUT_MS 10000
+
+// 在非主循环任务中通过当前会话上传数据，实际发送都调度到主循环中执行
+// 服务器授予的额度限制了排队中未发送的数据量
+class StreamUploader {
+public:
+    StreamUploader(const std::string& kind, const std::string& metadata);
+    ~StreamUploader();
+
+    // 会话没有打开或服务器不支持数据流时返回 false，调用方应回退到独立的 HTTP 连接
+    bool Open();
+    bool Write(const uint8_t* data, size_t size);
+    // 结束上传并等待服务器返回结果
+    bool Finish(std::string& result, int timeout_ms = STREAM_UPLOADER_TIMEOUT_MS);
+
+private:
+    std::string kind_;
+    std::string metadata_;
+    int id_ = -1;
+    bool finished_ = false;
+};
+
+#endif // STREAM_UPLOADER_H
@@ -0,0 +1,144 @@
+#include "task_manifest.h"
+#include "metrics.h"
+
+#include <esp_log.h>
+
+#define TAG "TaskManifest"
+
+// 绑定核心后会参与负载统计的最低优先级
+#define TASK_MANIFEST_REALTIME_PRIORITY 3
+
+static MetricGauge metric_violations("tasks.violations");
+static MetricGauge metric_core0_pinned("tasks.core0_pinned");
+static MetricGauge metric_core1_pinned("tasks.core1_pinned");
+
+#if CONFIG_FREERTOS_UNICORE
+// 单核芯片不绑核，所有任务由优先级排序
+#define CORE_AUDIO tskNO_AFFINITY
+#define CORE_SYSTEM tskNO_AFFINITY
+#define CORE_ENCODER tskNO_AFFINITY
+#else
+// 开启 AFE 时采集、AFE 和解码放在 core 1，界面、网络和编码放在 core 0
+#if CONFIG_USE_AUDIO_PROCESSOR
+#define CORE_AUDIO 1
+#else
+#define CORE_AUDIO tskNO_AFFINITY
+#endif
+#define CORE_SYSTEM 0
+#define CORE_ENCODER (CONFIG_AUDIO_ENCODER_TASK_CORE < 0 ? tskNO_AFFINITY : CONFIG_AUDIO_ENCODER_TASK_CORE)
+#endif
+
+#if CONFIG_SPIRAM
+#define PLACEMENT_LARGE kTaskStackPsram
+#else
+#define PLACEMENT_LARGE kTaskStackInternal
+#endif
+
+TaskManifest::TaskManifest() {
+    specs_[kTaskAudioInput] = {"audio_input", 8, CORE_AUDIO, 4096 * 2, kTaskStackInternal};
+    specs_[kTaskAudioOutput] = {"audio_output", 8, CORE_AUDIO, 4096, kTaskStackInternal};
+    specs_[kTaskAudioEncoder] = {"audio_encoder", 3, CORE_ENCODER, 4096 * 7, kTaskStackInternal};
+    specs_[kTaskAudioProcessor] = {"audio_communication", 3, tskNO_AFFINITY, 4096, kTaskStackInternal};
+    specs_[kTaskAudioFrontEnd] = {"audio_front_end", 3, tskNO_AFFINITY, 0, kTaskStackInternal};
+    specs_[kTaskWakeWordDetect] = {"audio_detection", 3, tskNO_AFFINITY, 0, kTaskStackInternal};
+    specs_[kTaskWakeWordEncode] = {"encode_detect_packets", 2, tskNO_AFFINITY, 4096 * 8, PLACEMENT_LARGE};
+#if CONFIG_FREERTOS_UNICORE
+    specs_[kTaskBootInit] = {"boot_init", 4, tskNO_AFFINITY, 4096 * 2, kTaskStackInternal};
+    // 单核上检查版本和首次播放的解码抢同一个核，放在解码之下
+    specs_[kTaskCheckVersion] = {"check_version", 1, tskNO_AFFINITY, 4096 * 2, kTaskStackInternal};
+#else
+    specs_[kTaskBootInit] = {"boot_init", 4, 1, 4096 * 2, kTaskStackInternal};
+    specs_[kTaskCheckVersion] = {"check_version", 2, tskNO_AFFINITY, 4096 * 2, kTaskStackInternal};
+#endif
+    specs_[kTaskAudioWorker] = {"audio_worker", 2, CORE_AUDIO == tskNO_AFFINITY ? tskNO_AFFINITY : 1, 4096 * 7, kTaskStackInternal};
+    specs_[kTaskUiWorker] = {"ui_worker", 2, CORE_SYSTEM, 4096 * 2, kTaskStackInternal};
+    specs_[kTaskBackground] = {"background_task", 2, CORE_SYSTEM, 4096 * 2, kTaskStackInternal};
+    specs_[kTaskLvgl] = {"taskLVGL", 1, tskNO_AFFINITY, 0, kTaskStackInternal};
+    specs_[kTaskToolCall] = {"tool_call", 1, tskNO_AFFINITY, 0, kTaskStackInternal};
+    specs_[kTaskTimerService] = {"timer_service", 3, tskNO_AFFINITY, 4096, kTaskStackInternal};
+    specs_[kTaskAsyncLog] = {"async_log", 1, tskNO_AFFINITY, 3072, kTaskStackInternal};
+    specs_[kTaskLedEffect] = {"led_effect", 2, tskNO_AFFINITY, 3072, kTaskStackInternal};
+}
+
+void TaskManifest::Override(TaskRole role, UBaseType_t priority, BaseType_t core) {
+    specs_[role].priority = priority;
+    specs_[role].core = core;
+}
+
+int TaskManifest::Validate() {
+    int violations = 0;
+    for (auto& spec : specs_) {
+        if (spec.core != tskNO_AFFINITY && (spec.core < 0 || spec.core >= portNUM_PROCESSORS)) {
+            ESP_LOGE(TAG, "%s pinned to core %d, only %d cores", spec.name, (int)spec.core, portNUM_PROCESSORS);
+            spec.core = tskNO_AFFINITY;
+            violations++;
+        }
+        if (spec.priority >= configMAX_PRIORITIES) {
+            ESP_LOGE(TAG, "%s priority %u out of range", spec.name, (unsigned)spec.priority);
+            spec.priority = configMAX_PRIORITIES - 1;
+            violations++;
+        }
+        ESP_LOGD(TAG, "%s: priority %u, core %d, stack %lu %s", spec.name, (unsigned)spec.priority, (int)spec.core,
+            spec.stack_size, spec.placement == kTaskStackPsram ? "PSRAM" : "internal");
+    }
+
+    // 左边的任务等待或需要跟上右边的任务时，右边的优先级不能更高
+    static const struct {
+        TaskRole higher;
+        TaskRole lower;
+        const char* reason;
+    } kOrder[] = {
+        {kTaskAudioInput, kTaskAudioEncoder, "capture must not wait for encoding"},
+        {kTaskAudioInput, kTaskAudioProcessor, "capture feeds the AFE"},
+        {kTaskAudioOutput, kTaskAudioWorker, "playback must preempt decoding"},
+        {kTaskAudioWorker, kTaskLvgl, "decoding must not queue behind UI refresh"},
+        {kTaskAudioProcessor, kTaskLvgl, "AFE fetch must not queue behind UI refresh"},
+        {kTaskAudioEncoder, kTaskLvgl, "encoding must not queue behind UI refresh"},
+        {kTaskAudioEncoder, kTaskToolCall, "tool calls must not delay the uplink"},
+        {kTaskTimerService, kTaskAsyncLog, "log output must not delay timers"},
+    };
+    for (auto& rule : kOrder) {
+        auto& higher = specs_[rule.higher];
+        auto& lower = specs_[rule.lower];
+        if (higher.priority <= lower.priority) {
+            ESP_LOGE(TAG, "Priority inversion: %s (%u) <= %s (%u), %s", higher.name, (unsigned)higher.priority,
+                lower.name, (unsigned)lower.priority, rule.reason);
+            violations++;
+        }
+    }
+
+    // 实时任务的栈在 PSRAM 中时，flash 写入期间 cache 关闭会让任务停住
+    for (auto role : {kTaskAudioInput, kTaskAudioOutput, kTaskTimerService}) {
+        if (specs_[role].placement == kTaskStackPsram) {
+            ESP_LOGE(TAG, "%s must use an internal stack", specs_[role].name);
+            specs_[role].placement = kTaskStackInternal;
+            violations++;
+        }
+    }
+
+    int pinned[2] = {};
+    for (auto& spec : specs_) {
+        if (spec.core >= 0 && spec.core < 2 && spec.priority >= TASK_MANIFEST_REALTIME_PRIORITY) {
+            pinned[spec.core]++;
+        }
+    }
+    metric_core0_pinned.Set(pinned[0]);
+    metric_core1_pinned.Set(pinned[1]);
+    metric_violations.Set(violations);
+#if !CONFIG_FREERTOS_UNICORE
+    if ((pinned[0] == 0) != (pinned[1] == 0)) {
+        ESP_LOGW(TAG, "All pinned realtime tasks are on core %d", pinned[0] > 0 ? 0 : 1);
+    }
+#endif
+    ESP_LOGI(TAG, "%d tasks, %d/%d realtime tasks pinned to core 0/1, %d violations", kTaskRoleCount,
+        pinned[0], pinned[1], violations);
+    return violations;
+}
+
+bool TaskManifest::Create(TaskRole role, std::function<void()> entry, TaskHandle_t* handle, uint32_t stack_size) {
+    auto& spec = specs_[role];
+    if (stack_size == 0) {
+        stack_size = spec.stack_size;
+    }
+    return TaskStack::Create(spec.name, stack_size, spec.priority, spec.placement, std::move(entry), handle, spec.core);
+}
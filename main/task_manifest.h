@@ -0,0 +1,63 @@
+#ifndef TASK_MANIFEST_H
+#define TASK_MANIFEST_H
+
+#include "task_stack.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <functional>
+
+// 各子系统常驻或反复创建的任务
+enum TaskRole {
+    kTaskAudioInput,
+    kTaskAudioOutput,
+    kTaskAudioEncoder,
+    kTaskAudioProcessor,        // AFE 音频处理（audio_communication）
+    kTaskAudioFrontEnd,         // 唤醒词和音频处理共用的 AFE 前端
+    kTaskWakeWordDetect,
+    kTaskWakeWordEncode,        // 唤醒词预录音频的 Opus 编码
+    kTaskBootInit,
+    kTaskCheckVersion,
+    kTaskAudioWorker,           // 后台解码通道
+    kTaskUiWorker,
+    kTaskBackground,
+    kTaskLvgl,
+    kTaskToolCall,
+    kTaskTimerService,
+    kTaskAsyncLog,
+    kTaskLedEffect,
+    kTaskRoleCount
+};
+
+struct TaskSpec {
+    const char* name;
+    UBaseType_t priority;
+    BaseType_t core;            // tskNO_AFFINITY 表示不绑定核心
+    uint32_t stack_size;        // 0 表示由创建者按配置决定
+    TaskStackPlacement placement;
+};
+
+// 所有任务的优先级、绑核和栈位置集中在这里，按芯片（单核/双核）给出默认值，板子可以在构造函数中调整
+// Application 启动时检查一次组合：核心越界、优先级倒置、实时任务的栈放在 PSRAM，结果打印出来并作为 tasks.* 指标查询
+class TaskManifest {
+public:
+    static TaskManifest& GetInstance() {
+        static TaskManifest instance;
+        return instance;
+    }
+
+    const TaskSpec& Get(TaskRole role) const { return specs_[role]; }
+    // 只影响之后创建的任务，后台 worker 在 Application 构造时已经创建
+    void Override(TaskRole role, UBaseType_t priority, BaseType_t core);
+    // 返回发现的问题数，越界的核心和优先级会被改成可用的值
+    int Validate();
+    // 按清单创建任务，stack_size 为 0 的条目需要传入栈大小
+    bool Create(TaskRole role, std::function<void()> entry, TaskHandle_t* handle = nullptr, uint32_t stack_size = 0);
+
+private:
+    TaskSpec specs_[kTaskRoleCount];
+
+    TaskManifest();
+};
+
+#endif // TASK_MANIFEST_H
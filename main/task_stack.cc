@@ -0,0 +1,46 @@
+#include "task_stack.h"
+
+#include <esp_log.h>
+#include <esp_memory_utils.h>
+#include <freertos/idf_additions.h>
+
+#define TAG "TaskStack"
+
+static void TaskMain(void* arg) {
+    auto entry = static_cast<std::function<void()>*>(arg);
+    (*entry)();
+    delete entry;
+    TaskStack::Delete(nullptr);
+}
+
+bool TaskStack::Create(const char* name, uint32_t stack_size, UBaseType_t priority, TaskStackPlacement placement,
+    std::function<void()> entry, TaskHandle_t* handle, BaseType_t core) {
+    auto arg = new std::function<void()>(std::move(entry));
+#if CONFIG_TASK_STACK_PSRAM
+    if (placement == kTaskStackPsram) {
+        if (xTaskCreatePinnedToCoreWithCaps(TaskMain, name, stack_size, arg, priority, handle, core,
+                MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) == pdPASS) {
+            return true;
+        }
+        ESP_LOGW(TAG, "Failed to create %s with PSRAM stack, fall back to internal RAM", name);
+    }
+#endif
+    if (xTaskCreatePinnedToCore(TaskMain, name, stack_size, arg, priority, handle, core) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create %s, stack size: %lu", name, stack_size);
+        delete arg;
+        return false;
+    }
+    return true;
+}
+
+void TaskStack::Delete(TaskHandle_t handle) {
+#if CONFIG_TASK_STACK_PSRAM
+    // WithCaps 创建的任务需要用 vTaskDeleteWithCaps 释放栈和 TCB，按栈地址区分
+    TaskHandle_t task = handle != nullptr ? handle : xTaskGetCurrentTaskHandle();
+    if (esp_ptr_external_ram(pxTaskGetStackStart(task))) {
+        vTaskDeleteWithCaps(task);
+        return;
+    }
+#endif
+    vTaskDelete(handle);
+}
@@ -0,0 +1,27 @@
+#ifndef TASK_STACK_H
+#define TASK_STACK_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <functional>
+
+// 任务栈的位置
+// PSRAM 栈的任务不能做 Flash 操作（擦写分区、esp_ota_begin/end、直接 nvs_commit），只用于网络和计算类任务；
+// Settings 的修改由 esp_timer 任务延迟提交，在 PSRAM 栈的任务中调用不受影响
+enum TaskStackPlacement {
+    kTaskStackInternal,
+    kTaskStackPsram,
+};
+
+class TaskStack {
+public:
+    // 创建任务，entry 返回后任务删除自己并释放栈
+    // 没有开启 CONFIG_TASK_STACK_PSRAM 或 PSRAM 分配失败时放在内部 SRAM
+    static bool Create(const char* name, uint32_t stack_size, UBaseType_t priority, TaskStackPlacement placement,
+        std::function<void()> entry, TaskHandle_t* handle = nullptr, BaseType_t core = tskNO_AFFINITY);
+    // 删除任务，handle 为 nullptr 时删除当前任务；栈在 PSRAM 中时一并释放
+    static void Delete(TaskHandle_t handle);
+};
+
+#endif // TASK_STACK_H
@@ -0,0 +1,116 @@
+#include "thermal_governor.h"
+#include "board.h"
+#include "metrics.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <soc/soc_caps.h>
+#if SOC_TEMP_SENSOR_SUPPORTED
+#include <driver/temperature_sensor.h>
+#endif
+
+#define TAG "ThermalGovernor"
+
+// 降一级前需要连续满足恢复条件的评估次数
+#define THERMAL_RECOVER_EVALUATIONS 3
+// 恢复时温度需要低于阈值多少度
+#define THERMAL_HYSTERESIS_C 5
+// CPU 占用的恢复回差
+#define THERMAL_LOAD_HYSTERESIS 15
+
+static MetricGauge metric_level("thermal.level");
+static MetricGauge metric_temperature("thermal.temp_c");
+static MetricCounter metric_transitions("thermal.transitions");
+
+static const ThermalStep steps[kThermalLevelCount] = {
+    {10, 20, false, false},
+    {3, 50, false, false},
+    {1, 100, true, false},
+    {0, 100, true, true},
+};
+
+static const char* level_names[kThermalLevelCount] = {"normal", "warm", "hot", "critical"};
+
+const ThermalStep& ThermalGovernor::GetStep(ThermalLevel level) {
+    return steps[level];
+}
+
+bool ThermalGovernor::ReadTemperature(float& celsius) {
+    if (Board::GetInstance().GetTemperature(celsius)) {
+        return true;
+    }
+#if SOC_TEMP_SENSOR_SUPPORTED
+    if (!sensor_checked_) {
+        sensor_checked_ = true;
+        // 板子自己装过温度传感器驱动时这里会失败，只按 CPU 占用调节
+        temperature_sensor_config_t config = TEMPERATURE_SENSOR_CONFIG_DEFAULT(20, 100);
+        temperature_sensor_handle_t handle = nullptr;
+        if (temperature_sensor_install(&config, &handle) == ESP_OK && temperature_sensor_enable(handle) == ESP_OK) {
+            sensor_ = handle;
+        } else {
+            ESP_LOGW(TAG, "Chip temperature sensor not available");
+        }
+    }
+    if (sensor_ != nullptr) {
+        return temperature_sensor_get_celsius(static_cast<temperature_sensor_handle_t>(sensor_), &celsius) == ESP_OK;
+    }
+#endif
+    return false;
+}
+
+// margin 为 0 时是升级的阈值，恢复时用带回差的阈值
+ThermalLevel ThermalGovernor::TargetLevel(float celsius, bool has_temperature, int load, int margin) const {
+    int level = kThermalLevelNormal;
+    if (has_temperature) {
+        if (celsius >= CONFIG_THERMAL_GOVERNOR_CRITICAL_C - margin) {
+            level = kThermalLevelCritical;
+        } else if (celsius >= CONFIG_THERMAL_GOVERNOR_HOT_C - margin) {
+            level = kThermalLevelHot;
+        } else if (celsius >= CONFIG_THERMAL_GOVERNOR_WARM_C - margin) {
+            level = kThermalLevelWarm;
+        }
+    }
+    // CPU 紧张时至少降到 warm，已经过热时再多降一级
+    int load_threshold = CONFIG_THERMAL_GOVERNOR_CPU_LOAD - (margin > 0 ? THERMAL_LOAD_HYSTERESIS : 0);
+    if (load >= 0 && load >= load_threshold) {
+        level = level == kThermalLevelNormal ? kThermalLevelWarm : std::min<int>(level + 1, kThermalLevelCritical);
+    }
+    return static_cast<ThermalLevel>(level);
+}
+
+bool ThermalGovernor::Update() {
+    float celsius = 0;
+    bool has_temperature = ReadTemperature(celsius);
+    int load = Metrics::GetInstance().cpu_load_percent();
+    if (has_temperature) {
+        metric_temperature.Set(celsius);
+    }
+
+    ThermalLevel current = level_;
+    ThermalLevel next = current;
+    ThermalLevel target = TargetLevel(celsius, has_temperature, load, 0);
+    if (target > current) {
+        next = static_cast<ThermalLevel>(current + 1);
+        recover_count_ = 0;
+    } else if (TargetLevel(celsius, has_temperature, load, THERMAL_HYSTERESIS_C) < current) {
+        if (++recover_count_ >= THERMAL_RECOVER_EVALUATIONS) {
+            next = static_cast<ThermalLevel>(current - 1);
+            recover_count_ = 0;
+        }
+    } else {
+        recover_count_ = 0;
+    }
+    if (next == current) {
+        return false;
+    }
+
+    level_ = next;
+    metric_level.Set(next);
+    metric_transitions.Add();
+    if (has_temperature) {
+        ESP_LOGW(TAG, "%s -> %s (%.1f C, CPU %d%%)", level_names[current], level_names[next], celsius, load);
+    } else {
+        ESP_LOGW(TAG, "%s -> %s (CPU %d%%)", level_names[current], level_names[next], load);
+    }
+    return true;
+}
@@ -0,0 +1,50 @@
+#ifndef THERMAL_GOVERNOR_H
+#define THERMAL_GOVERNOR_H
+
+#include <atomic>
+
+// 降档等级，每一级在上一级的基础上再关掉一部分开销
+enum ThermalLevel {
+    kThermalLevelNormal,
+    kThermalLevelWarm,      // 降低 Opus complexity，灯效降帧
+    kThermalLevelHot,       // 再降 complexity，屏幕降低刷新频率
+    kThermalLevelCritical,  // 再关闭 AFE 的神经网络降噪
+    kThermalLevelCount
+};
+
+// 每一级对应的设置
+struct ThermalStep {
+    int max_complexity;
+    int led_frame_ms;
+    bool display_throttled;
+    bool afe_reduced;
+};
+
+// 按芯片温度和 CPU 占用逐级降低负载，条件恢复后逐级还原（CONFIG_THERMAL_GOVERNOR）
+// 温度优先用 Board::GetTemperature，板子没有实现时读芯片内部的温度传感器；CPU 占用来自 Metrics 的采样
+// 每次评估最多升一级；温度低于阈值减去回差、CPU 也不紧张，并且连续几次评估都满足时才降一级
+// 只负责决定等级，具体设置由 Application 在主循环中应用
+class ThermalGovernor {
+public:
+    static ThermalGovernor& GetInstance() {
+        static ThermalGovernor instance;
+        return instance;
+    }
+
+    // 由时钟定时器在 Metrics::Sample 之后调用，等级变化时返回 true
+    bool Update();
+    ThermalLevel level() const { return level_.load(std::memory_order_relaxed); }
+    static const ThermalStep& GetStep(ThermalLevel level);
+
+private:
+    std::atomic<ThermalLevel> level_{kThermalLevelNormal};
+    int recover_count_ = 0;
+    bool sensor_checked_ = false;
+    void* sensor_ = nullptr;
+
+    ThermalGovernor() = default;
+    bool ReadTemperature(float& celsius);
+    ThermalLevel TargetLevel(float celsius, bool has_temperature, int load, int margin) const;
+};
+
+#endif // THERMAL_GOVERNOR_H
@@ -0,0 +1,137 @@
+#include "timer_service.h"
+#include "task_manifest.h"
+#include "metrics.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#define TAG "TimerService"
+
+static MetricCounter metric_wakeups("timer.wakeups");
+// 和别的定时器合并在同一次唤醒中执行的回调数
+static MetricCounter metric_coalesced("timer.coalesced");
+
+TimerService::TimerService() {
+    esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+            auto self = static_cast<TimerService*>(arg);
+            xTaskNotifyGive(self->task_);
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "timer_service",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &wakeup_timer_));
+    // 回调里会读写 Settings，栈放在内部 SRAM
+    TaskManifest::GetInstance().Create(kTaskTimerService, [this]() { Run(); }, &task_);
+}
+
+TimerService::TimerId TimerService::Create(const char* name, std::function<void()> callback, uint32_t slack_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Timer timer;
+    timer.name = name;
+    timer.callback = std::move(callback);
+    timer.slack_us = slack_ms * 1000LL;
+    timers_.push_back(std::move(timer));
+    return timers_.size() - 1;
+}
+
+void TimerService::StartOnce(TimerId id, uint32_t timeout_ms) {
+    Start(id, timeout_ms, false);
+}
+
+void TimerService::StartPeriodic(TimerId id, uint32_t period_ms) {
+    Start(id, period_ms, true);
+}
+
+void TimerService::Start(TimerId id, uint32_t interval_ms, bool periodic) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& timer = timers_[id];
+    timer.deadline_us = esp_timer_get_time() + interval_ms * 1000LL;
+    timer.period_us = periodic ? interval_ms * 1000LL : 0;
+    timer.active = true;
+    timer.generation++;
+    Rearm();
+}
+
+void TimerService::Stop(TimerId id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& timer = timers_[id];
+    if (!timer.active) {
+        return;
+    }
+    timer.active = false;
+    timer.generation++;
+    Rearm();
+}
+
+bool TimerService::IsActive(TimerId id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return timers_[id].active;
+}
+
+// 唤醒时间取所有定时器“截止时间 + slack”的最小值，唤醒时执行所有已经到截止时间的定时器
+void TimerService::Rearm() {
+    int64_t wakeup_us = INT64_MAX;
+    for (auto& timer : timers_) {
+        if (timer.active) {
+            wakeup_us = std::min(wakeup_us, timer.deadline_us + timer.slack_us);
+        }
+    }
+    if (wakeup_us == armed_us_) {
+        return;
+    }
+    esp_timer_stop(wakeup_timer_);
+    armed_us_ = wakeup_us;
+    if (wakeup_us == INT64_MAX) {
+        return;
+    }
+    int64_t delay_us = std::max<int64_t>(wakeup_us - esp_timer_get_time(), 1);
+    ESP_ERROR_CHECK(esp_timer_start_once(wakeup_timer_, delay_us));
+}
+
+void TimerService::Run() {
+    std::vector<std::pair<Timer*, uint32_t>> due;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        metric_wakeups.Add();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            armed_us_ = INT64_MAX;
+            int64_t now = esp_timer_get_time();
+            due.clear();
+            for (auto& timer : timers_) {
+                if (!timer.active || timer.deadline_us > now) {
+                    continue;
+                }
+                if (timer.period_us > 0) {
+                    // 按原来的节拍继续，落后超过一个周期时不补执行
+                    timer.deadline_us += timer.period_us;
+                    if (timer.deadline_us <= now) {
+                        timer.deadline_us = now + timer.period_us;
+                    }
+                } else {
+                    timer.active = false;
+                }
+                due.emplace_back(&timer, timer.generation);
+            }
+            Rearm();
+        }
+        if (due.size() > 1) {
+            metric_coalesced.Add(due.size() - 1);
+        }
+        for (auto& [timer, generation] : due) {
+            {
+                // 收集之后又被 Stop 或重新 Start 的定时器不再执行这一次
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (timer->generation != generation) {
+                    continue;
+                }
+            }
+            timer->callback();
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef TIMER_SERVICE_H
+#define TIMER_SERVICE_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+// 共享的软件定时器：所有定时器共用一个单次 esp_timer，只在最近的截止时间到达时唤醒，没有到期的定时器时不唤醒
+// 每个定时器可以带一段允许推迟的时间（slack），截止时间相近的定时器合并到同一次唤醒里执行
+// 回调在低优先级的 timer_service 任务中执行，不占用高优先级的 esp_timer 任务，不影响音频 DMA 回调和采集任务的调度
+// 需要精确时间的定时器（播放排空、刷新率控制、Settings 提交）仍然直接使用 esp_timer
+class TimerService {
+public:
+    using TimerId = int;
+
+    static TimerService& GetInstance() {
+        static TimerService instance;
+        return instance;
+    }
+
+    // 创建后定时器处于停止状态，计时从 Start 开始；定时器不会删除，对象析构前要 Stop
+    TimerId Create(const char* name, std::function<void()> callback, uint32_t slack_ms = 0);
+    // 重新开始计时，已经在计时的定时器按新的时间重来
+    void StartOnce(TimerId id, uint32_t timeout_ms);
+    void StartPeriodic(TimerId id, uint32_t period_ms);
+    void Stop(TimerId id);
+    bool IsActive(TimerId id);
+
+private:
+    struct Timer {
+        const char* name;
+        std::function<void()> callback;
+        int64_t slack_us;
+        int64_t deadline_us = 0;
+        int64_t period_us = 0;
+        bool active = false;
+        // 每次 Start/Stop 加 1，用来丢弃已经过时的到期
+        uint32_t generation = 0;
+    };
+
+    std::mutex mutex_;
+    // deque 追加时已有元素的地址不变，回调在锁外调用
+    std::deque<Timer> timers_;
+    esp_timer_handle_t wakeup_timer_ = nullptr;
+    TaskHandle_t task_ = nullptr;
+    int64_t armed_us_ = INT64_MAX;
+
+    TimerService();
+    void Start(TimerId id, uint32_t interval_ms, bool periodic);
+    void Rearm();
+    void Run();
+};
+
+#endif // TIMER_SERVICE_H
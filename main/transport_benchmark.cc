@@ -0,0 +1,328 @@
+#include "transport_benchmark.h"
+#include "audio_payload_pool.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <cJSON.h>
+#include <arpa/inet.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#define TAG "TransportBenchmark"
+
+TransportBenchmark::TransportBenchmark() {
+    esp_timer_create_args_t send_timer_args = {
+        .callback = [](void* arg) {
+            static_cast<TransportBenchmark*>(arg)->SendNext();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "benchmark_send",
+        .skip_unhandled_events = true,
+    };
+    esp_timer_create(&send_timer_args, &send_timer_);
+
+    esp_timer_create_args_t drain_timer_args = {
+        .callback = [](void* arg) {
+            static_cast<TransportBenchmark*>(arg)->Finish();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "benchmark_drain",
+        .skip_unhandled_events = true,
+    };
+    esp_timer_create(&drain_timer_args, &drain_timer_);
+}
+
+TransportBenchmark::~TransportBenchmark() {
+    if (send_timer_ != nullptr) {
+        esp_timer_stop(send_timer_);
+        esp_timer_delete(send_timer_);
+    }
+    if (drain_timer_ != nullptr) {
+        esp_timer_stop(drain_timer_);
+        esp_timer_delete(drain_timer_);
+    }
+    free(task_snapshot_);
+}
+
+void TransportBenchmark::OnSend(std::function<bool(const AudioStreamPacket& packet)> callback) {
+    on_send_ = callback;
+}
+
+void TransportBenchmark::OnFinished(std::function<void()> callback) {
+    on_finished_ = callback;
+}
+
+bool TransportBenchmark::LoadFrames(const std::string_view& sound) {
+    frames_.clear();
+    size_t offset = 0;
+    while (offset + sizeof(BinaryProtocol3) <= sound.size()) {
+        auto p3 = (const BinaryProtocol3*)(sound.data() + offset);
+        size_t payload_size = ntohs(p3->payload_size);
+        offset += sizeof(BinaryProtocol3);
+        if (offset + payload_size > sound.size()) {
+            break;
+        }
+        frames_.push_back({p3->payload, payload_size});
+        offset += payload_size;
+    }
+    return !frames_.empty();
+}
+
+bool TransportBenchmark::Start(const std::string_view& sound, int frames_per_second, int duration_seconds) {
+    if (running_) {
+        ESP_LOGW(TAG, "Benchmark is already running");
+        return false;
+    }
+    if (frames_per_second <= 0 || duration_seconds <= 0 || !LoadFrames(sound)) {
+        ESP_LOGE(TAG, "Invalid benchmark parameters");
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        frames_per_second_ = frames_per_second;
+        total_packets_ = frames_per_second * duration_seconds;
+        sent_ = 0;
+        send_failed_ = 0;
+        bytes_sent_ = 0;
+        received_ = 0;
+        duplicated_ = 0;
+        reordered_ = 0;
+        bytes_received_ = 0;
+        highest_sequence_ = 0;
+        received_map_.assign(total_packets_, false);
+        rtt_min_ms_ = UINT32_MAX;
+        rtt_max_ms_ = 0;
+        rtt_sum_ms_ = 0;
+        last_rtt_ms_ = -1;
+        jitter_us_ = 0;
+        start_free_internal_ = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+        min_free_internal_ = start_free_internal_;
+        min_free_heap_ = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+        task_usage_.clear();
+    }
+
+    packet_.sample_rate = 16000;
+    packet_.frame_duration = frame_duration_;
+    packet_.payload.reserve(AUDIO_PAYLOAD_MAX_SIZE);
+
+    ESP_LOGI(TAG, "Start benchmark: %d fps, %d s, %u canned frames", frames_per_second, duration_seconds, frames_.size());
+    SnapshotTasks();
+    running_ = true;
+    start_time_us_ = esp_timer_get_time();
+    end_time_us_ = 0;
+    esp_timer_start_periodic(send_timer_, 1000000 / frames_per_second);
+    return true;
+}
+
+void TransportBenchmark::Stop() {
+    if (!running_) {
+        return;
+    }
+    esp_timer_stop(send_timer_);
+    esp_timer_stop(drain_timer_);
+    if (end_time_us_ == 0) {
+        end_time_us_ = esp_timer_get_time();
+    }
+    Finish();
+}
+
+void TransportBenchmark::SendNext() {
+    if (sent_ >= total_packets_) {
+        esp_timer_stop(send_timer_);
+        end_time_us_ = esp_timer_get_time();
+        // 等待最后的回包
+        esp_timer_start_once(drain_timer_, TRANSPORT_BENCHMARK_DRAIN_MS * 1000);
+        return;
+    }
+
+    auto& frame = frames_[sent_ % frames_.size()];
+    packet_.payload.assign(frame.data, frame.data + frame.size);
+    if (packet_.payload.size() < TRANSPORT_BENCHMARK_HEADER_SIZE) {
+        packet_.payload.resize(TRANSPORT_BENCHMARK_HEADER_SIZE);
+    }
+    uint32_t sequence = sent_ + 1;
+    uint32_t now_ms = esp_timer_get_time() / 1000;
+    *(uint32_t*)&packet_.payload[0] = htonl(sequence);
+    *(uint32_t*)&packet_.payload[4] = htonl(now_ms);
+    packet_.timestamp = now_ms;
+
+    bool queued = on_send_ && on_send_(packet_);
+    size_t free_internal = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t free_heap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    sent_++;
+    if (queued) {
+        bytes_sent_ += packet_.payload.size();
+    } else {
+        send_failed_++;
+    }
+    min_free_internal_ = std::min(min_free_internal_, free_internal);
+    min_free_heap_ = std::min(min_free_heap_, free_heap);
+}
+
+void TransportBenchmark::OnPacket(const AudioStreamPacketView& packet) {
+    if (!running_ || packet.payload_size < TRANSPORT_BENCHMARK_HEADER_SIZE) {
+        return;
+    }
+    uint32_t sequence = ntohl(*(const uint32_t*)&packet.payload[0]);
+    uint32_t send_ms = ntohl(*(const uint32_t*)&packet.payload[4]);
+    int32_t rtt = static_cast<int32_t>(uint32_t(esp_timer_get_time() / 1000) - send_ms);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (sequence == 0 || sequence > received_map_.size() || rtt < 0) {
+        return;
+    }
+    if (received_map_[sequence - 1]) {
+        duplicated_++;
+        return;
+    }
+    received_map_[sequence - 1] = true;
+    received_++;
+    bytes_received_ += packet.payload_size;
+    if (sequence < highest_sequence_) {
+        reordered_++;
+    } else {
+        highest_sequence_ = sequence;
+    }
+
+    rtt_min_ms_ = std::min<uint32_t>(rtt_min_ms_, rtt);
+    rtt_max_ms_ = std::max<uint32_t>(rtt_max_ms_, rtt);
+    rtt_sum_ms_ += rtt;
+    // RFC 3550 的平滑方式，统计相邻两包 RTT 的变化
+    if (last_rtt_ms_ >= 0) {
+        int delta_us = std::abs(rtt - last_rtt_ms_) * 1000;
+        jitter_us_ += (delta_us - jitter_us_) / 16;
+    }
+    last_rtt_ms_ = rtt;
+}
+
+void TransportBenchmark::Finish() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    CollectTaskUsage();
+    LogResult();
+    if (on_finished_) {
+        on_finished_();
+    }
+}
+
+void TransportBenchmark::SnapshotTasks() {
+    free(task_snapshot_);
+    task_snapshot_size_ = uxTaskGetNumberOfTasks() + 5;
+    task_snapshot_ = (TaskStatus_t*)malloc(sizeof(TaskStatus_t) * task_snapshot_size_);
+    if (task_snapshot_ == nullptr) {
+        task_snapshot_size_ = 0;
+        return;
+    }
+    task_snapshot_size_ = uxTaskGetSystemState(task_snapshot_, task_snapshot_size_, &snapshot_run_time_);
+}
+
+void TransportBenchmark::CollectTaskUsage() {
+    if (task_snapshot_ == nullptr || task_snapshot_size_ == 0) {
+        return;
+    }
+    UBaseType_t size = uxTaskGetNumberOfTasks() + 5;
+    auto tasks = (TaskStatus_t*)malloc(sizeof(TaskStatus_t) * size);
+    if (tasks == nullptr) {
+        return;
+    }
+    configRUN_TIME_COUNTER_TYPE run_time;
+    size = uxTaskGetSystemState(tasks, size, &run_time);
+    uint64_t total = uint64_t(run_time - snapshot_run_time_) * CONFIG_FREERTOS_NUMBER_OF_CORES;
+
+    std::vector<TaskUsage> usage;
+    for (UBaseType_t i = 0; i < size && total > 0; i++) {
+        for (UBaseType_t j = 0; j < task_snapshot_size_; j++) {
+            if (tasks[i].xHandle == task_snapshot_[j].xHandle) {
+                uint32_t elapsed = tasks[i].ulRunTimeCounter - task_snapshot_[j].ulRunTimeCounter;
+                usage.push_back({tasks[i].pcTaskName, uint32_t(uint64_t(elapsed) * 1000 / total)});
+                break;
+            }
+        }
+    }
+    free(tasks);
+
+    // 只保留占用最高的几个任务
+    std::sort(usage.begin(), usage.end(), [](const TaskUsage& a, const TaskUsage& b) {
+        return a.permille > b.permille;
+    });
+    if (usage.size() > TRANSPORT_BENCHMARK_MAX_TASKS) {
+        usage.resize(TRANSPORT_BENCHMARK_MAX_TASKS);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_usage_ = std::move(usage);
+}
+
+void TransportBenchmark::LogResult() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t duration_ms = (end_time_us_ - start_time_us_) / 1000;
+    uint32_t delivered = sent_ - send_failed_;
+    uint32_t lost = delivered > received_ ? delivered - received_ : 0;
+    ESP_LOGI(TAG, "Sent %lu (failed %lu) in %lld ms, received %lu, lost %lu, reordered %lu, duplicated %lu",
+        sent_, send_failed_, duration_ms, received_, lost, reordered_, duplicated_);
+    if (duration_ms > 0) {
+        ESP_LOGI(TAG, "Throughput: up %llu kbps, down %llu kbps",
+            bytes_sent_ * 8 / duration_ms, bytes_received_ * 8 / duration_ms);
+    }
+    if (received_ > 0) {
+        ESP_LOGI(TAG, "RTT: min %lu ms, avg %llu ms, max %lu ms, jitter %d ms",
+            rtt_min_ms_, rtt_sum_ms_ / received_, rtt_max_ms_, jitter_us_ / 1000);
+    }
+    ESP_LOGI(TAG, "Heap: internal free %u -> min %u, total min %u",
+        start_free_internal_, min_free_internal_, min_free_heap_);
+    for (auto& task : task_usage_) {
+        ESP_LOGI(TAG, "CPU %-16s %lu.%lu%%", task.name.c_str(), task.permille / 10, task.permille % 10);
+    }
+}
+
+std::string TransportBenchmark::GetResultJson() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t duration_ms = (end_time_us_ - start_time_us_) / 1000;
+    uint32_t delivered = sent_ - send_failed_;
+    uint32_t lost = delivered > received_ ? delivered - received_ : 0;
+
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddBoolToObject(root, "running", running_);
+    cJSON_AddNumberToObject(root, "frames_per_second", frames_per_second_);
+    cJSON_AddNumberToObject(root, "duration_ms", duration_ms > 0 ? duration_ms : 0);
+    cJSON_AddNumberToObject(root, "sent", sent_);
+    cJSON_AddNumberToObject(root, "send_failed", send_failed_);
+    cJSON_AddNumberToObject(root, "received", received_);
+    cJSON_AddNumberToObject(root, "lost", lost);
+    cJSON_AddNumberToObject(root, "reordered", reordered_);
+    cJSON_AddNumberToObject(root, "duplicated", duplicated_);
+    if (duration_ms > 0) {
+        cJSON_AddNumberToObject(root, "uplink_kbps", bytes_sent_ * 8 / duration_ms);
+        cJSON_AddNumberToObject(root, "downlink_kbps", bytes_received_ * 8 / duration_ms);
+    }
+    if (received_ > 0) {
+        cJSON* rtt = cJSON_CreateObject();
+        cJSON_AddNumberToObject(rtt, "min", rtt_min_ms_);
+        cJSON_AddNumberToObject(rtt, "avg", rtt_sum_ms_ / received_);
+        cJSON_AddNumberToObject(rtt, "max", rtt_max_ms_);
+        cJSON_AddNumberToObject(rtt, "jitter", jitter_us_ / 1000);
+        cJSON_AddItemToObject(root, "rtt_ms", rtt);
+    }
+    cJSON* heap = cJSON_CreateObject();
+    cJSON_AddNumberToObject(heap, "internal_free_start", start_free_internal_);
+    cJSON_AddNumberToObject(heap, "internal_free_min", min_free_internal_);
+    cJSON_AddNumberToObject(heap, "free_min", min_free_heap_);
+    cJSON_AddItemToObject(root, "heap", heap);
+    cJSON* cpu = cJSON_CreateObject();
+    for (auto& task : task_usage_) {
+        cJSON_AddNumberToObject(cpu, task.name.c_str(), task.permille / 10.0);
+    }
+    cJSON_AddItemToObject(root, "cpu_percent", cpu);
+
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
+}
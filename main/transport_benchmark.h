@@ -0,0 +1,101 @@
+#ifndef TRANSPORT_BENCHMARK_H
+#define TRANSPORT_BENCHMARK_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+
+#include "protocol.h"
+
+#define TRANSPORT_BENCHMARK_HEADER_SIZE 8
+#define TRANSPORT_BENCHMARK_DRAIN_MS 2000
+#define TRANSPORT_BENCHMARK_MAX_TASKS 8
+
+// 传输层基准测试
+// 按固定帧率循环发送内嵌 p3 中的 Opus 帧，服务器（scripts/transport_benchmark_server.py）原样回传，
+// 每帧负载的前 8 字节被替换为 [sequence BE32][发送时间 ms BE32]，接收端据此统计 RTT、抖动、丢包和乱序
+class TransportBenchmark {
+public:
+    TransportBenchmark();
+    ~TransportBenchmark();
+
+    // 在 esp_timer 任务中调用，返回 false 表示发送队列已满
+    void OnSend(std::function<bool(const AudioStreamPacket& packet)> callback);
+    // 发送结束并等待回包后调用
+    void OnFinished(std::function<void()> callback);
+
+    bool Start(const std::string_view& sound, int frames_per_second, int duration_seconds);
+    void Stop();
+    bool running() const { return running_; }
+
+    // 网络任务调用
+    void OnPacket(const AudioStreamPacketView& packet);
+
+    void LogResult() const;
+    std::string GetResultJson() const;
+
+private:
+    struct Frame {
+        const uint8_t* data;
+        size_t size;
+    };
+    struct TaskUsage {
+        std::string name;
+        uint32_t permille;
+    };
+
+    esp_timer_handle_t send_timer_ = nullptr;
+    esp_timer_handle_t drain_timer_ = nullptr;
+    std::function<bool(const AudioStreamPacket& packet)> on_send_;
+    std::function<void()> on_finished_;
+    std::atomic<bool> running_{false};
+
+    std::vector<Frame> frames_;
+    AudioStreamPacket packet_;
+    uint32_t total_packets_ = 0;
+    int frame_duration_ = 60;  // 内嵌提示音按 60ms 编码
+    int frames_per_second_ = 0;
+    int64_t start_time_us_ = 0;
+    int64_t end_time_us_ = 0;
+
+    // 统计数据，发送侧在 esp_timer 任务中更新，接收侧在网络任务中更新
+    mutable std::mutex mutex_;
+    uint32_t sent_ = 0;
+    uint32_t send_failed_ = 0;
+    uint64_t bytes_sent_ = 0;
+    uint32_t received_ = 0;
+    uint32_t duplicated_ = 0;
+    uint32_t reordered_ = 0;
+    uint64_t bytes_received_ = 0;
+    uint32_t highest_sequence_ = 0;
+    std::vector<bool> received_map_;
+    uint32_t rtt_min_ms_ = 0;
+    uint32_t rtt_max_ms_ = 0;
+    uint64_t rtt_sum_ms_ = 0;
+    int32_t last_rtt_ms_ = -1;
+    int jitter_us_ = 0;
+    size_t min_free_internal_ = 0;
+    size_t min_free_heap_ = 0;
+    size_t start_free_internal_ = 0;
+
+    // 基准测试期间各任务的 CPU 占用
+    TaskStatus_t* task_snapshot_ = nullptr;
+    UBaseType_t task_snapshot_size_ = 0;
+    configRUN_TIME_COUNTER_TYPE snapshot_run_time_ = 0;
+    std::vector<TaskUsage> task_usage_;
+
+    bool LoadFrames(const std::string_view& sound);
+    void SendNext();
+    void Finish();
+    void SnapshotTasks();
+    void CollectTaskUsage();
+};
+
+#endif // TRANSPORT_BENCHMARK_H
@@ -0,0 +1,93 @@
+#include "uplink_gate.h"
+
+#include <esp_log.h>
+
+#define TAG "UplinkGate"
+
+UplinkGate::UplinkGate(int sample_rate, int preroll_ms, int hangover_ms)
+    : sample_rate_(sample_rate), preroll_ms_(preroll_ms), hangover_ms_(hangover_ms) {
+}
+
+void UplinkGate::Reset(bool enabled) {
+    pending_enabled_ = enabled;
+    reset_pending_ = true;
+}
+
+void UplinkGate::OnVadStateChange(bool speaking) {
+    speaking_ = speaking;
+    if (!speaking) {
+        hangover_left_ms_ = hangover_ms_;
+    }
+}
+
+void UplinkGate::RecycleChunk(Chunk& chunk) {
+    chunk.data.clear();
+    spare_chunks_.push_back(std::move(chunk.data));
+}
+
+void UplinkGate::ClearPreroll() {
+    for (auto& chunk : preroll_) {
+        RecycleChunk(chunk);
+    }
+    preroll_.clear();
+    preroll_buffered_ms_ = 0;
+}
+
+void UplinkGate::Process(std::span<const int16_t> data, const SendCallback& send) {
+    if (reset_pending_.exchange(false)) {
+        enabled_ = pending_enabled_;
+        sending_ = !enabled_;
+        hangover_left_ms_ = 0;
+        timestamp_ = 0;
+        ClearPreroll();
+        suppressed_ms_ = 0;
+    }
+
+    int duration_ms = data.size() * 1000 / sample_rate_;
+    uint32_t timestamp = timestamp_;
+    timestamp_ += duration_ms;
+
+    if (!enabled_) {
+        send(data, timestamp, false);
+        return;
+    }
+
+    if (speaking_ || hangover_left_ms_ > 0) {
+        if (!speaking_) {
+            hangover_left_ms_ -= duration_ms;
+        }
+        bool onset = !sending_;
+        sending_ = true;
+        // 先补发语音开始之前的音频
+        for (auto& chunk : preroll_) {
+            send(chunk.data, chunk.timestamp, onset);
+            onset = false;
+        }
+        ClearPreroll();
+        send(data, timestamp, onset);
+        return;
+    }
+
+    if (sending_) {
+        sending_ = false;
+        ESP_LOGD(TAG, "Uplink gated at %lu ms", timestamp);
+    }
+    std::vector<int16_t> buffer;
+    if (!spare_chunks_.empty()) {
+        buffer = std::move(spare_chunks_.back());
+        spare_chunks_.pop_back();
+    }
+    buffer.assign(data.begin(), data.end());
+    preroll_.push_back(Chunk{std::move(buffer), timestamp});
+    preroll_buffered_ms_ += duration_ms;
+    while (preroll_.size() > 1) {
+        int front_ms = preroll_.front().data.size() * 1000 / sample_rate_;
+        if (preroll_buffered_ms_ - front_ms < preroll_ms_) {
+            break;
+        }
+        preroll_buffered_ms_ -= front_ms;
+        suppressed_ms_ += front_ms;
+        RecycleChunk(preroll_.front());
+        preroll_.pop_front();
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef UPLINK_GATE_H
+#define UPLINK_GATE_H
+
+#include <atomic>
+#include <deque>
+#include <span>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+// 基于 VAD 的上行门控
+// 静音时不编码不发送，只把最近的音频保存在 pre-roll 中，检测到语音时先补发 pre-roll，避免吞掉开头
+// 同时维护一个按采集时长递增的时间戳，被跳过的静音也会推进时间戳，服务器可据此还原时间轴
+// Process 和 OnVadStateChange 只在音频处理任务中调用
+// 输入和发送的数据都是借用的，只在调用期间有效；pre-roll 的块复用已释放的缓冲区，稳定后不再分配内存
+class UplinkGate {
+public:
+    // onset 为 true 表示这是一段语音的第一个块，调用方可以借机重置编码器
+    typedef std::function<void(std::span<const int16_t> data, uint32_t timestamp, bool onset)> SendCallback;
+
+    UplinkGate(int sample_rate, int preroll_ms, int hangover_ms);
+
+    // 其它任务调用，下一次 Process 时生效
+    void Reset(bool enabled);
+
+    void OnVadStateChange(bool speaking);
+    void Process(std::span<const int16_t> data, const SendCallback& send);
+
+    uint32_t suppressed_ms() const { return suppressed_ms_; }
+
+private:
+    struct Chunk {
+        std::vector<int16_t> data;
+        uint32_t timestamp;
+    };
+
+    int sample_rate_;
+    int preroll_ms_;
+    int hangover_ms_;
+
+    std::atomic<bool> reset_pending_{false};
+    std::atomic<bool> pending_enabled_{false};
+    bool enabled_ = false;
+    bool speaking_ = false;
+    bool sending_ = true;
+    int hangover_left_ms_ = 0;
+    uint32_t timestamp_ = 0;
+    std::deque<Chunk> preroll_;
+    std::vector<std::vector<int16_t>> spare_chunks_;
+    int preroll_buffered_ms_ = 0;
+    std::atomic<uint32_t> suppressed_ms_{0};
+
+    void RecycleChunk(Chunk& chunk);
+    void ClearPreroll();
+};
+
+#endif // UPLINK_GATE_H
@@ -1,54 +1,184 @@
 import socket
+import struct
 import wave
 import argparse
+from array import array
 
 
 '''
-  Create a UDP socket and bind it to the server's IP:8000.
-  Listen for incoming messages and print them to the console.
-  Save the audio to a WAV file.
+  接收设备 AudioDebugger（CONFIG_USE_AUDIO_DEBUGGER）发送的调试数据，格式见 main/audio_processing/audio_debugger.cc。
+  按时间戳对齐麦克风、参考信号、AFE 输出、TTS 和送给 codec 的播放数据，保存为多轨 WAV，事件保存为时间线。
+
+    python audio_debug_server.py --port 8000 --samplerate 16000 --output debug
+
+  Ctrl+C 停止后生成 debug.wav（每个声道一个通道）和 debug_timeline.txt。
 '''
-def main(samplerate, channels):
-    # Create a UDP socket
-    server_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
-    server_socket.bind(('0.0.0.0', 8000))
 
-    # Create WAV file with parameters
-    filename = f"{samplerate}_{channels}.wav"
-    wav_file = wave.open(filename, "wb")
-    wav_file.setnchannels(channels)     # channels parameter
-    wav_file.setsampwidth(2)            # 2 bytes per sample (16-bit)
-    wav_file.setframerate(samplerate)   # samplerate parameter
+DATAGRAM_HEADER = struct.Struct('<4sBBHI')
+RECORD_HEADER = struct.Struct('<BBHIII')
+RECORD_PCM = 1
+RECORD_EVENT = 2
+CHANNEL_NAMES = {0: 'mic', 1: 'reference', 2: 'afe_output', 3: 'tts', 4: 'playback', 5: 'events'}
+# 按序号推算的位置和时间戳相差超过这个值时（例如 TTS 停顿后重新开始）按时间戳重新定位
+REANCHOR_SECONDS = 0.1
+
+
+class Clock:
+    # 设备时间戳是 32 位微秒，约 71 分钟回绕一次，按相邻时间戳的差值展开
+    def __init__(self):
+        self.last = None
+        self.value = 0
+
+    def unwrap(self, timestamp):
+        if self.last is not None:
+            delta = (timestamp - self.last) & 0xFFFFFFFF
+            if delta >= 0x80000000:
+                delta -= 0x100000000
+            self.value += delta
+        self.last = timestamp
+        return self.value / 1000000
+
+
+def resample(samples, source_rate, target_rate):
+    if source_rate == target_rate or len(samples) == 0:
+        return samples
+    count = len(samples) * target_rate // source_rate
+    output = array('h', bytes(count * 2))
+    step = source_rate / target_rate
+    last = len(samples) - 1
+    for i in range(count):
+        position = i * step
+        index = int(position)
+        fraction = position - index
+        next_index = min(index + 1, last)
+        output[i] = int(samples[index] + (samples[next_index] - samples[index]) * fraction)
+    return output
+
+
+class Track:
+    def __init__(self, name):
+        self.name = name
+        self.records = []
+
+    def build(self, start_time, target_rate):
+        output = array('h')
+        anchor = None
+        for timestamp, sequence, rate, samples in self.records:
+            if anchor is None or anchor[2] != rate:
+                anchor = (sequence, timestamp, rate)
+            position = anchor[1] + (sequence - anchor[0]) / rate
+            if abs(position - timestamp) > REANCHOR_SECONDS:
+                anchor = (sequence, timestamp, rate)
+                position = timestamp
+            data = resample(samples, rate, target_rate)
+            offset = max(0, round((position - start_time) * target_rate))
+            if len(output) < offset + len(data):
+                output.extend(array('h', bytes((offset + len(data) - len(output)) * 2)))
+            output[offset:offset + len(data)] = data
+        return output
 
-    print(f"Start saving audio from 0.0.0.0:8000 to {filename}...")
+
+def parse(message, clock, tracks, events, stats):
+    if len(message) < DATAGRAM_HEADER.size:
+        stats['invalid'] += 1
+        return
+    magic, version, _, count, sequence = DATAGRAM_HEADER.unpack_from(message)
+    if magic != b'XZDB' or version != 1:
+        stats['invalid'] += 1
+        return
+    gap = 0 if stats['next_sequence'] is None else (sequence - stats['next_sequence']) & 0xFFFFFFFF
+    if gap < 0x80000000:
+        stats['lost'] += gap
+        stats['next_sequence'] = (sequence + 1) & 0xFFFFFFFF
+    else:
+        # 乱序到达的数据报，之前已经算作丢失
+        stats['lost'] -= 1
+    stats['received'] += 1
+
+    offset = DATAGRAM_HEADER.size
+    for _ in range(count):
+        if offset + RECORD_HEADER.size > len(message):
+            break
+        record_type, channel, length, timestamp, record_sequence, rate = RECORD_HEADER.unpack_from(message, offset)
+        offset += RECORD_HEADER.size
+        payload = message[offset:offset + length]
+        offset += length
+        time = clock.unwrap(timestamp)
+        if record_type == RECORD_PCM and rate > 0:
+            samples = array('h')
+            samples.frombytes(payload[:len(payload) // 2 * 2])
+            track = tracks.setdefault(channel, Track(CHANNEL_NAMES.get(channel, f'channel{channel}')))
+            track.records.append((time, record_sequence, rate, samples))
+        elif record_type == RECORD_EVENT:
+            events.append((time, record_sequence, payload.decode('utf-8', 'replace')))
+
+
+def save(prefix, target_rate, tracks, events, stats):
+    times = [track.records[0][0] for track in tracks.values() if track.records] + [event[0] for event in events]
+    if not times:
+        print("No data received")
+        return
+    start_time = min(times)
+
+    channels = sorted(tracks)
+    built = [tracks[channel].build(start_time, target_rate) for channel in channels]
+    length = max((len(data) for data in built), default=0)
+    if built:
+        interleaved = array('h', bytes(length * len(built) * 2))
+        for index, data in enumerate(built):
+            interleaved[index:index + len(data) * len(built):len(built)] = data
+        filename = f"{prefix}.wav"
+        with wave.open(filename, "wb") as wav_file:
+            wav_file.setnchannels(len(built))
+            wav_file.setsampwidth(2)
+            wav_file.setframerate(target_rate)
+            wav_file.writeframes(interleaved.tobytes())
+        print(f"WAV file '{filename}' saved: {length / target_rate:.1f}s, tracks: "
+              f"{', '.join(tracks[channel].name for channel in channels)}")
+
+    filename = f"{prefix}_timeline.txt"
+    with open(filename, "w") as f:
+        f.write(f"# datagrams received: {stats['received']}, lost: {stats['lost']}, invalid: {stats['invalid']}\n")
+        for index, channel in enumerate(channels):
+            track = tracks[channel]
+            first = track.records[0]
+            f.write(f"# track {index}: {track.name}, source rate {first[2]} Hz, "
+                    f"starts at {first[0] - start_time:.3f}s\n")
+        for time, sequence, name in sorted(events):
+            f.write(f"{time - start_time:10.3f}  {name}\n")
+    print(f"Timeline '{filename}' saved: {len(events)} events")
+
+
+def main(port, samplerate, output):
+    server_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    server_socket.bind(('0.0.0.0', port))
+    clock = Clock()
+    tracks = {}
+    events = []
+    stats = {'received': 0, 'lost': 0, 'invalid': 0, 'next_sequence': None}
+    print(f"Start receiving debug data on 0.0.0.0:{port}...")
 
     try:
         while True:
-            # Receive a message from the client
-            message, address = server_socket.recvfrom(8000)
-            
-            # Write PCM data to WAV file
-            wav_file.writeframes(message)
-
-            # Print length of the message
-            print(f"Received {len(message)} bytes from {address}")
-    
+            message, address = server_socket.recvfrom(2048)
+            parse(message, clock, tracks, events, stats)
+            if stats['received'] % 100 == 0:
+                print(f"Received {stats['received']} datagrams from {address}, lost {stats['lost']}")
     except KeyboardInterrupt:
         print("\nStopping recording...")
-    
     finally:
-        # Close files and socket
-        wav_file.close()
         server_socket.close()
-        print(f"WAV file '{filename}' saved successfully")
+        save(output, samplerate, tracks, events, stats)
 
 
 if __name__ == "__main__":
-    parser = argparse.ArgumentParser(description='UDP音频数据接收器，保存为WAV文件')
-    parser.add_argument('--samplerate', '-s', type=int, default=16000, 
-                        help='采样率 (默认: 16000)')
-    parser.add_argument('--channels', '-c', type=int, default=2, 
-                        help='声道数 (默认: 2)')
-    
+    parser = argparse.ArgumentParser(description='UDP音频调试数据接收器，保存为多轨WAV和事件时间线')
+    parser.add_argument('--port', '-p', type=int, default=8000,
+                        help='监听端口 (默认: 8000)')
+    parser.add_argument('--samplerate', '-s', type=int, default=16000,
+                        help='输出WAV采样率，各声道重采样到这个采样率 (默认: 16000)')
+    parser.add_argument('--output', '-o', default='audio_debug',
+                        help='输出文件名前缀 (默认: audio_debug)')
+
     args = parser.parse_args()
-    main(args.samplerate, args.channels)
+    main(args.port, args.samplerate, args.output)
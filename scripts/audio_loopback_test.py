@@ -0,0 +1,244 @@
+import sys
+import json
+import socket
+import argparse
+import numpy as np
+from audio_debug_server import parse, Clock
+
+'''
+  音频链路回环回归测试，配合设备的 CONFIG_AUDIO_LOOPBACK_TEST 使用。
+  设备先录一段静音，再通过扬声器播放一段已知的 p3，同时经过 AFE 录音，全部数据由 AudioDebugger 发到这里。
+  脚本计算：
+    start_latency_ms   从 loopback_play 事件到播放数据出现声音的时间（解码和播放队列）
+    acoustic_latency_ms 播放数据到麦克风的延迟（codec 输出、扬声器、麦克风、输入缓冲）
+    erle_db            播放期间 麦克风能量 / AFE 输出能量，即 AEC 的回声消除量
+    dropouts           丢失的数据报、各通道序号不连续的次数和播放数据中间的断音
+    golden_correlation 可选，播放数据和参考 p3/wav 的归一化相关系数
+  超出阈值时以状态码 1 退出，--report 保存 JSON 结果，方便对比不同 AFE 配置的效果。
+
+    python audio_loopback_test.py --board esp-box-3 --report box3.json
+
+  然后在设备上调用 MCP 工具 self.audio_debug.loopback_test，或打开 CONFIG_AUDIO_LOOPBACK_ON_BOOT 后重启。
+'''
+
+ANALYSIS_RATE = 16000
+PLAYBACK, MIC, AFE_OUTPUT = 'playback', 'mic', 'afe_output'
+
+# 各参考板的阈值，是同一套固件下测得的基线留出余量，调整 AFE 配置后按新基线更新
+BOARDS = {
+    'esp-box-3': {'max_acoustic_latency_ms': 120, 'min_erle_db': 15, 'max_start_latency_ms': 300},
+    'lichuang-dev': {'max_acoustic_latency_ms': 150, 'min_erle_db': 12, 'max_start_latency_ms': 300},
+    'esp32s3-korvo2-v3': {'max_acoustic_latency_ms': 120, 'min_erle_db': 15, 'max_start_latency_ms': 300},
+}
+DEFAULT_THRESHOLDS = {'max_acoustic_latency_ms': 200, 'min_erle_db': 10, 'max_start_latency_ms': 400,
+                      'max_dropouts': 0, 'min_golden_correlation': 0.8}
+# 播放数据中间连续为 0 超过这个时长算一次断音
+DROPOUT_SECONDS = 0.02
+SILENCE_LEVEL = 64
+
+
+def build(track, start_time, end_time):
+    # 按序号拼接连续的采样，统一重采样到 ANALYSIS_RATE，返回样本和序号不连续的次数
+    length = int((end_time - start_time) * ANALYSIS_RATE)
+    output = np.zeros(max(length, 0), dtype=np.float32)
+    gaps = 0
+    expected = None
+    for timestamp, sequence, rate, samples in track.records:
+        if expected is not None and sequence != expected:
+            gaps += 1
+        expected = sequence + len(samples)
+        data = np.frombuffer(samples.tobytes(), dtype=np.int16).astype(np.float32)
+        if rate != ANALYSIS_RATE:
+            positions = np.arange(int(len(data) * ANALYSIS_RATE / rate)) * rate / ANALYSIS_RATE
+            data = np.interp(positions, np.arange(len(data)), data).astype(np.float32)
+        offset = round((timestamp - start_time) * ANALYSIS_RATE)
+        if offset >= len(output) or offset + len(data) <= 0:
+            continue
+        begin = max(0, -offset)
+        end = min(len(data), len(output) - offset)
+        output[offset + begin:offset + end] = data[begin:end]
+    return output, gaps
+
+
+def first_sound(data):
+    indices = np.nonzero(np.abs(data) > SILENCE_LEVEL)[0]
+    return int(indices[0]) if len(indices) else None
+
+
+def correlate_lag(reference, signal, max_lag):
+    # signal 相对 reference 的延迟（采样数），FFT 互相关
+    size = 1 << int(np.ceil(np.log2(len(reference) + len(signal))))
+    spectrum = np.fft.rfft(signal, size) * np.conj(np.fft.rfft(reference, size))
+    correlation = np.fft.irfft(spectrum, size)[:max_lag]
+    lag = int(np.argmax(correlation))
+    norm = np.sqrt(np.sum(reference ** 2) * np.sum(signal ** 2))
+    return lag, float(correlation[lag] / norm) if norm > 0 else 0.0
+
+
+def count_zero_runs(data):
+    # 只统计第一个和最后一个有声音的采样之间，结尾本来就是静音
+    active = np.nonzero(np.abs(data) > SILENCE_LEVEL)[0]
+    if len(active) == 0:
+        return 0
+    segment = data[active[0]:active[-1] + 1] == 0
+    min_run = int(DROPOUT_SECONDS * ANALYSIS_RATE)
+    runs, current = 0, 0
+    for zero in segment:
+        current = current + 1 if zero else 0
+        if current == min_run:
+            runs += 1
+    return runs
+
+
+def load_golden(path):
+    if path.endswith('.wav'):
+        import wave
+        with wave.open(path, 'rb') as wav_file:
+            rate = wav_file.getframerate()
+            channels = wav_file.getnchannels()
+            data = np.frombuffer(wav_file.readframes(wav_file.getnframes()), dtype=np.int16)
+            data = data[::channels].astype(np.float32)
+    else:
+        import opuslib
+        sys.path.insert(0, __file__.rsplit('/', 1)[0] + '/p3_tools')
+        from p3_format import P3Reader
+        with open(path, 'rb') as f:
+            reader = P3Reader(f)
+            rate = reader.sample_rate
+            decoder = opuslib.Decoder(rate, 1)
+            frame_size = int(rate * reader.frame_duration / 1000)
+            data = np.concatenate([np.frombuffer(decoder.decode(packet, frame_size), dtype=np.int16)
+                                   for packet in reader]).astype(np.float32)
+    if rate != ANALYSIS_RATE:
+        positions = np.arange(int(len(data) * ANALYSIS_RATE / rate)) * rate / ANALYSIS_RATE
+        data = np.interp(positions, np.arange(len(data)), data).astype(np.float32)
+    return data
+
+
+def receive(port, timeout):
+    server_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    server_socket.bind(('0.0.0.0', port))
+    server_socket.settimeout(timeout)
+    clock = Clock()
+    tracks = {}
+    events = []
+    stats = {'received': 0, 'lost': 0, 'invalid': 0, 'next_sequence': None}
+    print(f"Waiting for loopback test on 0.0.0.0:{port}...")
+    try:
+        while True:
+            message, _ = server_socket.recvfrom(2048)
+            parse(message, clock, tracks, events, stats)
+            names = [event[2] for event in events]
+            if 'loopback_end' in names or 'loopback_abort' in names:
+                break
+    except socket.timeout:
+        print("Timed out waiting for loopback_end")
+    finally:
+        server_socket.close()
+    return tracks, events, stats
+
+
+def analyze(tracks, events, stats, golden):
+    def last_event(name):
+        times = [time for time, _, event in events if event == name]
+        return times[-1] if times else None
+
+    report = {'datagrams_received': stats['received'], 'datagrams_lost': stats['lost']}
+    if last_event('loopback_abort') is not None:
+        report['error'] = 'aborted by device state change'
+        return report
+    lead, play, end = last_event('loopback_start'), last_event('loopback_play'), last_event('loopback_end')
+    if None in (lead, play, end):
+        report['error'] = 'incomplete event sequence'
+        return report
+    by_name = {track.name: track for track in tracks.values()}
+    missing = [name for name in (PLAYBACK, MIC, AFE_OUTPUT) if name not in by_name]
+    if missing:
+        report['error'] = f"missing tracks: {', '.join(missing)}"
+        return report
+
+    playback, playback_gaps = build(by_name[PLAYBACK], play, end)
+    mic, mic_gaps = build(by_name[MIC], play, end)
+    afe, afe_gaps = build(by_name[AFE_OUTPUT], play, end)
+    lead_mic, _ = build(by_name[MIC], lead, play)
+    report['sequence_gaps'] = {PLAYBACK: playback_gaps, MIC: mic_gaps, AFE_OUTPUT: afe_gaps}
+    report['playback_zero_runs'] = count_zero_runs(playback)
+    report['dropouts'] = stats['lost'] + playback_gaps + mic_gaps + afe_gaps + report['playback_zero_runs']
+
+    onset = first_sound(playback)
+    if onset is None:
+        report['error'] = 'no sound in playback track'
+        return report
+    report['start_latency_ms'] = round(onset * 1000 / ANALYSIS_RATE, 1)
+    lag, correlation = correlate_lag(playback, mic, ANALYSIS_RATE // 2)
+    report['acoustic_latency_ms'] = round(lag * 1000 / ANALYSIS_RATE, 1)
+    report['echo_correlation'] = round(correlation, 3)
+
+    # 能量都减去静音段测得的底噪，避免安静环境下 ERLE 被底噪限制
+    noise = float(np.mean(lead_mic ** 2)) if len(lead_mic) else 0.0
+    mic_energy = max(float(np.mean(mic ** 2)) - noise, 1.0)
+    afe_energy = max(float(np.mean(afe ** 2)), 1.0)
+    report['noise_floor_dbfs'] = round(10 * np.log10(max(noise, 1.0) / 32768 ** 2), 1)
+    report['erle_db'] = round(10 * np.log10(mic_energy / afe_energy), 1)
+
+    if golden is not None:
+        left = playback[onset:onset + len(golden)]
+        _, report['golden_correlation'] = correlate_lag(golden[:len(left)], left, ANALYSIS_RATE // 10)
+        report['golden_correlation'] = round(report['golden_correlation'], 3)
+    return report
+
+
+def check(report, thresholds):
+    failures = []
+    if 'error' in report:
+        return [report['error']]
+    if report['acoustic_latency_ms'] > thresholds['max_acoustic_latency_ms']:
+        failures.append(f"acoustic latency {report['acoustic_latency_ms']}ms > {thresholds['max_acoustic_latency_ms']}ms")
+    if report['start_latency_ms'] > thresholds['max_start_latency_ms']:
+        failures.append(f"start latency {report['start_latency_ms']}ms > {thresholds['max_start_latency_ms']}ms")
+    if report['erle_db'] < thresholds['min_erle_db']:
+        failures.append(f"ERLE {report['erle_db']}dB < {thresholds['min_erle_db']}dB")
+    if report['dropouts'] > thresholds['max_dropouts']:
+        failures.append(f"{report['dropouts']} dropouts > {thresholds['max_dropouts']}")
+    if 'golden_correlation' in report and report['golden_correlation'] < thresholds['min_golden_correlation']:
+        failures.append(f"golden correlation {report['golden_correlation']} < {thresholds['min_golden_correlation']}")
+    return failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description='音频回环回归测试：延迟、AEC 回声消除量和断音')
+    parser.add_argument('--port', '-p', type=int, default=8000, help='监听端口 (默认: 8000)')
+    parser.add_argument('--board', choices=sorted(BOARDS), help='使用参考板的默认阈值')
+    parser.add_argument('--golden', help='设备播放的原始音频 (p3 或 wav)，用于校验播放数据')
+    parser.add_argument('--timeout', type=float, default=30, help='等待测试结束的秒数 (默认: 30)')
+    parser.add_argument('--report', help='保存 JSON 结果')
+    for name, value in DEFAULT_THRESHOLDS.items():
+        parser.add_argument('--' + name.replace('_', '-'), type=type(value), help=f'(默认: {value}，或参考板的值)')
+    args = parser.parse_args()
+
+    thresholds = dict(DEFAULT_THRESHOLDS)
+    if args.board:
+        thresholds.update(BOARDS[args.board])
+    for name in DEFAULT_THRESHOLDS:
+        if getattr(args, name) is not None:
+            thresholds[name] = getattr(args, name)
+
+    golden = load_golden(args.golden) if args.golden else None
+    tracks, events, stats = receive(args.port, args.timeout)
+    report = analyze(tracks, events, stats, golden)
+    failures = check(report, thresholds)
+    report['board'] = args.board
+    report['thresholds'] = thresholds
+    report['passed'] = not failures
+
+    print(json.dumps(report, indent=2, ensure_ascii=False))
+    if args.report:
+        with open(args.report, 'w') as f:
+            json.dump(report, f, indent=2, ensure_ascii=False)
+    for failure in failures:
+        print(f"FAIL: {failure}")
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
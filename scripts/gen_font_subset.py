@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+import argparse
+import hashlib
+import json
+import os
+import shutil
+import subprocess
+import sys
+
+'''
+  按板子和语言裁剪资源分区中的二进制字体（lv_font_conv --format bin）
+  字体只保留 language.json 中用到的字符、配置的动态字符范围（对话文本等运行时才知道的内容）和额外的符号，
+  字形越少，查找越快，占用的 flash 和 OTA 资源包越小
+  字体在板级 config.json 的 fonts 中配置，写在顶层对所有 build 生效，写在 builds 的某一项里只对这个 build 生效:
+    "fonts": {
+        "text_font": {
+            "source": "fonts/NotoSansSC-Regular.otf",
+            "size": 16,
+            "bpp": 4,
+            "ranges": ["0x4E00-0x9FA5"],
+            "charset": "fonts/common_3500.txt",
+            "symbols": "，。！？"
+        },
+        "icon_font": {"source": "fonts/fa-solid-900.ttf", "size": 16, "bpp": 1, "ranges": ["0xF000-0xF2FF"], "language": false}
+    }
+  source 和 charset 相对于板级目录；language 为 false 时不加入语言文件中的字符（图标字体）
+  生成的文件名为 <字体名>.bin，覆盖 boards/<板子>/assets 中的同名文件，结果按参数缓存，参数不变时不重新生成
+'''
+
+LV_FONT_CONV = 'lv_font_conv'
+
+
+def load_fonts(config_path, build_name):
+    if not config_path or not os.path.exists(config_path):
+        return {}
+    with open(config_path, 'r', encoding='utf-8') as f:
+        config = json.load(f)
+    fonts = dict(config.get('fonts', {}))
+    for build in config.get('builds', []):
+        if build.get('name') == build_name:
+            fonts.update(build.get('fonts', {}))
+    return fonts
+
+
+def language_glyphs(language_path):
+    with open(language_path, 'r', encoding='utf-8') as f:
+        data = json.load(f)
+    glyphs = set()
+    for value in data['strings'].values():
+        glyphs.update(value)
+    # printf 占位符格式化后是 ASCII，由 ranges 覆盖
+    return {c for c in glyphs if ord(c) >= 0x20}
+
+
+def parse_ranges(ranges):
+    result = []
+    for item in ranges:
+        item = item.strip()
+        if not item:
+            continue
+        start, _, end = item.partition('-')
+        start = int(start, 0)
+        end = int(end, 0) if end else start
+        if start > end or end > 0x10FFFF:
+            raise ValueError(f"Invalid glyph range: {item}")
+        result.append((start, end))
+    return result
+
+
+def collect_glyphs(font, board_dir, language, dynamic_ranges):
+    glyphs = set()
+    if font.get('language', True):
+        glyphs |= language
+        for start, end in parse_ranges(dynamic_ranges):
+            glyphs.update(chr(c) for c in range(start, end + 1))
+    for start, end in parse_ranges(font.get('ranges', [])):
+        glyphs.update(chr(c) for c in range(start, end + 1))
+    if 'charset' in font:
+        with open(os.path.join(board_dir, font['charset']), 'r', encoding='utf-8') as f:
+            glyphs.update(c for c in f.read() if ord(c) >= 0x20)
+    glyphs.update(font.get('symbols', ''))
+    return sorted(glyphs)
+
+
+def to_ranges(glyphs):
+    # 连续的码点合并成范围，命令行不会太长
+    ranges = []
+    for c in (ord(g) for g in glyphs):
+        if ranges and ranges[-1][1] == c - 1:
+            ranges[-1][1] = c
+        else:
+            ranges.append([c, c])
+    return [f"0x{start:X}-0x{end:X}" if start != end else f"0x{start:X}" for start, end in ranges]
+
+
+def generate(name, font, board_dir, glyphs, cache_dir, output_dir):
+    source = os.path.join(board_dir, font['source'])
+    if not os.path.exists(source):
+        raise FileNotFoundError(f"Font source not found: {source}")
+    size = int(font['size'])
+    bpp = int(font.get('bpp', 4))
+    ranges = to_ranges(glyphs)
+
+    with open(source, 'rb') as f:
+        digest = hashlib.sha256(f.read())
+    digest.update(json.dumps([size, bpp, ranges]).encode())
+    cached = os.path.join(cache_dir, f"{name}-{digest.hexdigest()[:16]}.bin")
+    if not os.path.exists(cached):
+        if shutil.which(LV_FONT_CONV) is None:
+            raise RuntimeError(f"{LV_FONT_CONV} not found, install it with: npm install -g lv_font_conv")
+        os.makedirs(cache_dir, exist_ok=True)
+        command = [LV_FONT_CONV, '--font', source, '--size', str(size), '--bpp', str(bpp),
+                   '--format', 'bin', '--no-compress', '-o', cached]
+        for item in ranges:
+            command += ['-r', item]
+        subprocess.run(command, check=True, stdout=subprocess.DEVNULL)
+
+    output = os.path.join(output_dir, f"{name}.bin")
+    shutil.copyfile(cached, output)
+    return os.path.getsize(output)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Subset LVGL binary fonts for the assets partition")
+    parser.add_argument("--config", help="board config.json")
+    parser.add_argument("--board", required=True, help="board build name")
+    parser.add_argument("--language", required=True, help="language.json of the build")
+    parser.add_argument("--dynamic-ranges", default="", help="glyph ranges for runtime text, comma separated")
+    parser.add_argument("--cache-dir", required=True, help="directory for generated fonts")
+    parser.add_argument("--output-dir", required=True, help="assets directory")
+    args = parser.parse_args()
+
+    fonts = load_fonts(args.config, args.board)
+    if not fonts:
+        return
+    board_dir = os.path.dirname(args.config)
+    language = language_glyphs(args.language)
+    dynamic_ranges = args.dynamic_ranges.split(',')
+    for name, font in fonts.items():
+        glyphs = collect_glyphs(font, board_dir, language, dynamic_ranges)
+        try:
+            size = generate(name, font, board_dir, glyphs, args.cache_dir, args.output_dir)
+        except (OSError, RuntimeError, subprocess.CalledProcessError) as e:
+            # 保留 boards/<板子>/assets 中预先生成的字体
+            print(f"-- Font subset {name} skipped: {e}", file=sys.stderr)
+            continue
+        print(f"-- Font subset {name}: {len(glyphs)} glyphs, {size / 1024:.1f} KB")
+
+
+if __name__ == "__main__":
+    main()
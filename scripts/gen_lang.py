@@ -7,7 +7,7 @@ HEADER_TEMPLATE = """// Auto-generated language config
 #pragma once
 
 #include <string_view>
-
+{extra_includes}
 #ifndef {lang_code_for_font}
     #define {lang_code_for_font}  // 預設語言
 #endif
@@ -28,7 +28,32 @@ namespace Lang {{
 }}
 """
 
-def generate_header(input_path, output_path):
+def generate_pcm_sounds(pcm_sounds, pcm_sample_rate):
+    # 预解码的 PCM 提示音，与同名的 p3 配对
+    sounds = [f'''
+        constexpr int PCM_SAMPLE_RATE = {pcm_sample_rate};''']
+    pairs = []
+    for base_name in pcm_sounds:
+        sounds.append(f'''
+        extern const char pcm_{base_name}_start[] asm("_binary_{base_name}_pcm_start");
+        extern const char pcm_{base_name}_end[] asm("_binary_{base_name}_pcm_end");
+        static const std::string_view PCM_{base_name.upper()} {{
+        static_cast<const char*>(pcm_{base_name}_start),
+        static_cast<size_t>(pcm_{base_name}_end - pcm_{base_name}_start)
+        }};''')
+        pairs.append(f'            {{P3_{base_name.upper()}, PCM_{base_name.upper()}}},')
+    sounds.append(f'''
+        static const std::array<std::pair<std::string_view, std::string_view>, {len(pairs)}> PCM_ASSETS {{{{
+{chr(10).join(pairs)}
+        }}}};''')
+    return sounds
+
+def generate_asset_sound(base_name):
+    # 资源分区中的提示音，播放时按文件名查找
+    return f'''
+        static const AssetRef P3_{base_name.upper()} {{"{base_name}.p3"}};'''
+
+def generate_header(input_path, output_path, pcm_sounds=None, pcm_sample_rate=None, assets_partition=False):
     with open(input_path, 'r', encoding='utf-8') as f:
         data = json.load(f)
 
@@ -49,6 +74,9 @@ def generate_header(input_path, output_path):
     for file in os.listdir(os.path.dirname(input_path)):
         if file.endswith('.p3'):
             base_name = os.path.splitext(file)[0]
+            if assets_partition:
+                sounds.append(generate_asset_sound(base_name))
+                continue
             sounds.append(f'''
         extern const char p3_{base_name}_start[] asm("_binary_{base_name}_p3_start");
         extern const char p3_{base_name}_end[] asm("_binary_{base_name}_p3_end");
@@ -61,6 +89,9 @@ def generate_header(input_path, output_path):
     for file in os.listdir(os.path.join(os.path.dirname(output_path), 'common')):
         if file.endswith('.p3'):
             base_name = os.path.splitext(file)[0]
+            if assets_partition:
+                sounds.append(generate_asset_sound(base_name))
+                continue
             sounds.append(f'''
         extern const char p3_{base_name}_start[] asm("_binary_{base_name}_p3_start");
         extern const char p3_{base_name}_end[] asm("_binary_{base_name}_p3_end");
@@ -69,12 +100,22 @@ def generate_header(input_path, output_path):
         static_cast<size_t>(p3_{base_name}_end - p3_{base_name}_start)
         }};''')
 
+    sounds.sort()
+    extra_includes = ""
+    if assets_partition:
+        extra_includes = '#include "assets_partition.h"\n'
+    elif pcm_sample_rate is not None:
+        # 放在最后，引用前面定义的 P3_ 资源
+        sounds += generate_pcm_sounds(pcm_sounds or [], pcm_sample_rate)
+        extra_includes = "#include <array>\n#include <utility>\n"
+
     # 填充模板
     content = HEADER_TEMPLATE.format(
+        extra_includes=extra_includes,
         lang_code=lang_code,
         lang_code_for_font=lang_code.replace('-', '_').lower(),
         strings="\n".join(sorted(strings)),
-        sounds="\n".join(sorted(sounds))
+        sounds="\n".join(sounds)
     )
 
     # 写入文件
@@ -86,6 +127,10 @@ if __name__ == "__main__":
     parser = argparse.ArgumentParser()
     parser.add_argument("--input", required=True, help="输入JSON文件路径")
     parser.add_argument("--output", required=True, help="输出头文件路径")
+    parser.add_argument("--pcm-sounds", default="", help="预解码为 PCM 的提示音，逗号分隔")
+    parser.add_argument("--pcm-sample-rate", type=int, help="PCM 提示音的采样率，不指定时不生成")
+    parser.add_argument("--assets-partition", action="store_true", help="提示音放在资源分区中")
     args = parser.parse_args()
 
-    generate_header(args.input, args.output)
\ No newline at end of file
+    pcm_sounds = [name for name in args.pcm_sounds.split(",") if name]
+    generate_header(args.input, args.output, pcm_sounds, args.pcm_sample_rate, args.assets_partition)
\ No newline at end of file
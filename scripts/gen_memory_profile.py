@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+import argparse
+import json
+import os
+
+'''
+  按板子的内存档位生成 memory_profile.h，并打印各内存池的静态和峰值占用
+  档位默认由芯片和是否有 PSRAM 决定，板级 config.json 可以指定档位或单独覆盖某一项:
+    "memory_profile": {"tier": "standard", "audio_queue_ms": 3600}
+  写在顶层对所有 build 生效，写在 builds 的某一项里只对这个 build 生效
+'''
+
+HEADER_TEMPLATE = """// Auto-generated memory profile for {board} ({target}, {tier})
+#pragma once
+
+{defines}
+"""
+
+# 各档位的缓冲区大小
+TIERS = {
+    # 没有 PSRAM（C3、C6、不带 PSRAM 的 ESP32/S3），缓冲区都在内部 RAM 中
+    'minimal': {
+        'audio_queue_ms': 1200,
+        'lcd_buffer_lines': 10,
+        'background_max_pending': 10,
+        'jpeg_chunk_count': 4,
+        'wake_word_preroll_ms': 1500,
+        'audio_internal_kb': 16,
+        'lcd_internal_kb': 16,
+    },
+    'standard': {
+        'audio_queue_ms': 2400,
+        'lcd_buffer_lines': 20,
+        'background_max_pending': 30,
+        'jpeg_chunk_count': 8,
+        'wake_word_preroll_ms': 2000,
+        'audio_internal_kb': 64,
+        'lcd_internal_kb': 32,
+    },
+    # P4 等大容量 PSRAM 的板子，更深的队列吸收网络抖动，JPEG 编码可以领先上传更多
+    'large': {
+        'audio_queue_ms': 4800,
+        'lcd_buffer_lines': 40,
+        'background_max_pending': 60,
+        'jpeg_chunk_count': 16,
+        'wake_word_preroll_ms': 2000,
+        'audio_internal_kb': 128,
+        'lcd_internal_kb': 64,
+    },
+}
+
+MACROS = {
+    'audio_queue_ms': 'MEMORY_PROFILE_AUDIO_QUEUE_MS',
+    'lcd_buffer_lines': 'MEMORY_PROFILE_LCD_BUFFER_LINES',
+    'background_max_pending': 'MEMORY_PROFILE_BACKGROUND_MAX_PENDING',
+    'jpeg_chunk_count': 'MEMORY_PROFILE_JPEG_CHUNK_COUNT',
+    'wake_word_preroll_ms': 'MEMORY_PROFILE_WAKE_WORD_PREROLL_MS',
+    # PSRAM 争用严重时最多把多少 KB 的音频 / 绘制缓冲区挪到内部 RAM，见 main/memory_placement.h
+    'audio_internal_kb': 'MEMORY_PROFILE_AUDIO_INTERNAL_KB',
+    'lcd_internal_kb': 'MEMORY_PROFILE_LCD_INTERNAL_KB',
+}
+
+# 与代码中的常量保持一致
+OPUS_FRAME_DURATION_MS = 60
+AUDIO_PACKET_AVERAGE_BYTES = 400    # application.h AUDIO_PACKET_QUEUE_BYTES
+AUDIO_PAYLOAD_MAX_SIZE = 1500       # protocols/audio_payload_pool.h
+JPEG_CHUNK_SIZE = 4096              # boards/common/esp32_camera.cc
+BACKGROUND_TASK_BYTES = 64          # 排队中的 std::function 及链表节点的估计值
+
+
+def default_tier(target, psram):
+    if not psram:
+        return 'minimal'
+    return 'large' if target == 'esp32p4' else 'standard'
+
+
+def load_overrides(config_path, build_name):
+    if not config_path or not os.path.exists(config_path):
+        return {}
+    with open(config_path, 'r', encoding='utf-8') as f:
+        config = json.load(f)
+    overrides = dict(config.get('memory_profile', {}))
+    for build in config.get('builds', []):
+        if build.get('name') == build_name:
+            overrides.update(build.get('memory_profile', {}))
+    return overrides
+
+
+def validate(profile):
+    for key, value in profile.items():
+        if key not in MACROS:
+            raise ValueError(f"Unknown memory_profile key: {key}")
+        if not isinstance(value, int) or value <= 0:
+            raise ValueError(f"memory_profile.{key} must be a positive integer")
+    if profile['audio_queue_ms'] % OPUS_FRAME_DURATION_MS != 0:
+        raise ValueError(f"memory_profile.audio_queue_ms must be a multiple of {OPUS_FRAME_DURATION_MS}")
+
+
+def estimate(profile, psram, display_width, payload_pool):
+    # (名称, 参数, 字节数, 内存类型, 是否启动时就分配)
+    psram_or_internal = 'psram' if psram else 'internal'
+    packets = profile['audio_queue_ms'] // OPUS_FRAME_DURATION_MS
+    pools = [
+        ('audio send+decode queues', f"{packets} packets", 2 * packets * AUDIO_PACKET_AVERAGE_BYTES,
+         psram_or_internal, True),
+        ('audio payload pool', f"{payload_pool} buffers", payload_pool * AUDIO_PAYLOAD_MAX_SIZE, 'internal', True),
+        ('wake word preroll', f"{profile['wake_word_preroll_ms']} ms", profile['wake_word_preroll_ms'] * 16 * 2,
+         psram_or_internal, True),
+        ('background tasks', f"{profile['background_max_pending']} pending/lane",
+         3 * profile['background_max_pending'] * BACKGROUND_TASK_BYTES, 'internal', False),
+        ('jpeg chunks', f"{profile['jpeg_chunk_count']} x {JPEG_CHUNK_SIZE}",
+         profile['jpeg_chunk_count'] * JPEG_CHUNK_SIZE, psram_or_internal, False),
+    ]
+    if display_width > 0:
+        pools.append(('lcd draw buffer (default)', f"{profile['lcd_buffer_lines']} lines x {display_width}",
+                      profile['lcd_buffer_lines'] * display_width * 2, 'dma', True))
+    return pools
+
+
+def print_report(board, target, tier, pools):
+    print(f"-- Memory profile for {board} ({target}): {tier}")
+    print(f"--   {'pool':<28}{'size':<24}{'bytes':>10}  capability")
+    for name, size, nbytes, caps, _ in pools:
+        print(f"--   {name:<28}{size:<24}{nbytes:>10}  {caps}")
+    for caps in sorted(set(pool[3] for pool in pools)):
+        static = sum(pool[2] for pool in pools if pool[3] == caps and pool[4])
+        peak = sum(pool[2] for pool in pools if pool[3] == caps)
+        print(f"--   {caps:<10} static {static / 1024:7.1f} KB, expected peak {peak / 1024:7.1f} KB")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate per-board memory profile header")
+    parser.add_argument("--config", help="board config.json")
+    parser.add_argument("--board", required=True, help="board build name")
+    parser.add_argument("--target", required=True, help="IDF target")
+    parser.add_argument("--psram", type=int, default=0, help="1 if PSRAM is enabled")
+    parser.add_argument("--display-width", type=int, default=0, help="DISPLAY_WIDTH from config.h, 0 if unknown")
+    parser.add_argument("--payload-pool", type=int, default=0, help="CONFIG_AUDIO_PAYLOAD_POOL_SIZE")
+    parser.add_argument("--output", required=True, help="output header")
+    args = parser.parse_args()
+
+    overrides = load_overrides(args.config, args.board)
+    tier = overrides.pop('tier', default_tier(args.target, args.psram))
+    if tier not in TIERS:
+        raise ValueError(f"Unknown memory tier: {tier}")
+    profile = dict(TIERS[tier])
+    profile.update(overrides)
+    validate(profile)
+
+    defines = '\n'.join(f"#define {MACROS[key]} {value}" for key, value in profile.items())
+    content = HEADER_TEMPLATE.format(board=args.board, target=args.target, tier=tier, defines=defines)
+    # 内容不变时不重写，避免每次配置都重新编译
+    if not os.path.exists(args.output) or open(args.output, encoding='utf-8').read() != content:
+        with open(args.output, 'w', encoding='utf-8') as f:
+            f.write(content)
+
+    print_report(args.board, args.target, tier, estimate(profile, args.psram, args.display_width, args.payload_pool))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,137 @@
+import argparse
+import sys
+
+
+'''
+  生成压缩固件，设备端由 main/ota_lzss.cc 边下载边解压。
+
+    python ota_compress.py build/xiaozhi.bin xiaozhi.bin.lzss --window 12 --lookahead 5
+
+  OTA 服务器的 CheckVersion 响应中加入（window/lookahead 与压缩时相同）:
+    "firmware": { "version": "...", "url": "<完整固件>",
+                  "compressed": { "type": "lzss", "window": 12, "lookahead": 5, "url": "<压缩固件>" } }
+  设备在 CheckVersion 请求的 ota.compression 中列出支持的格式。
+'''
+
+MAX_CHAIN = 64
+
+
+class BitWriter:
+    def __init__(self):
+        self.output = bytearray()
+        self.value = 0
+        self.count = 0
+
+    def write(self, value, bits):
+        self.value = (self.value << bits) | value
+        self.count += bits
+        while self.count >= 8:
+            self.count -= 8
+            self.output.append((self.value >> self.count) & 0xFF)
+        self.value &= (1 << self.count) - 1
+
+    def finish(self):
+        if self.count > 0:
+            self.output.append((self.value << (8 - self.count)) & 0xFF)
+        return bytes(self.output)
+
+
+def compress(data, window_bits, lookahead_bits):
+    window = 1 << window_bits
+    max_length = 1 << lookahead_bits
+    # 引用编码的位数比等长的字面量少时才使用
+    min_length = (1 + window_bits + lookahead_bits) // 9 + 1
+    writer = BitWriter()
+    chains = {}
+    position = 0
+
+    def insert(i):
+        if i + 3 <= len(data):
+            chains.setdefault(data[i:i + 3], []).append(i)
+
+    while position < len(data):
+        best_length, best_distance = 0, 0
+        candidates = chains.get(data[position:position + 3], [])
+        limit = min(max_length, len(data) - position)
+        for candidate in reversed(candidates[-MAX_CHAIN:]):
+            distance = position - candidate
+            if distance > window:
+                break
+            length = 0
+            while length < limit and data[candidate + length] == data[position + length]:
+                length += 1
+            if length > best_length:
+                best_length, best_distance = length, distance
+                if length == limit:
+                    break
+
+        if best_length >= min_length:
+            writer.write(0, 1)
+            writer.write(best_distance - 1, window_bits)
+            writer.write(best_length - 1, lookahead_bits)
+            for i in range(position, position + best_length):
+                insert(i)
+            position += best_length
+        else:
+            writer.write(1, 1)
+            writer.write(data[position], 8)
+            insert(position)
+            position += 1
+    return writer.finish()
+
+
+def decompress(data, window_bits, lookahead_bits):
+    # 与设备端相同的解码过程，用来确认压缩结果
+    output = bytearray()
+    value, count = 0, 0
+    state, index = 'tag', 0
+    for byte in data:
+        value = (value << 8) | byte
+        count += 8
+        while True:
+            need = {'tag': 1, 'literal': 8, 'index': window_bits, 'count': lookahead_bits}[state]
+            if count < need:
+                break
+            count -= need
+            field = (value >> count) & ((1 << need) - 1)
+            value &= (1 << count) - 1
+            if state == 'tag':
+                state = 'literal' if field else 'index'
+            elif state == 'literal':
+                output.append(field)
+                state = 'tag'
+            elif state == 'index':
+                index = field + 1
+                state = 'count'
+            else:
+                for _ in range(field + 1):
+                    output.append(output[-index] if index <= len(output) else 0)
+                state = 'tag'
+    return bytes(output)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='生成 LZSS 压缩固件')
+    parser.add_argument('input', help='固件 .bin')
+    parser.add_argument('output', help='输出的压缩固件')
+    parser.add_argument('--window', type=int, default=12, help='窗口位数 (默认: 12，即 4KB)')
+    parser.add_argument('--lookahead', type=int, default=5, help='长度位数 (默认: 5，最长 32 字节)')
+    args = parser.parse_args()
+    if not (4 <= args.window <= 15 and 3 <= args.lookahead < args.window):
+        print("Invalid window/lookahead")
+        sys.exit(1)
+
+    with open(args.input, 'rb') as f:
+        data = f.read()
+    compressed = compress(data, args.window, args.lookahead)
+    if decompress(compressed, args.window, args.lookahead) != data:
+        print("Compression verification failed")
+        sys.exit(1)
+
+    with open(args.output, 'wb') as f:
+        f.write(compressed)
+    print(f"{args.output}: {len(compressed)} bytes ({len(compressed) * 100 / len(data):.1f}% of {len(data)})")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,131 @@
+import argparse
+import struct
+import sys
+import zlib
+
+
+'''
+  生成差分升级补丁，设备端由 main/ota_delta.cc 解码。
+  old.bin 必须是设备上正在运行的固件（与 OTA 服务器下发的 firmware.delta.from 版本一致）。
+
+    python ota_delta.py build/old.bin build/xiaozhi.bin xiaozhi.patch
+
+  OTA 服务器的 CheckVersion 响应中加入:
+    "firmware": { "version": "...", "url": "<完整固件>", "delta": { "from": "<旧版本>", "url": "<补丁>" } }
+  补丁与设备当前固件不匹配或下载失败时，设备会改用完整固件升级。
+'''
+
+OP_END = 0x00
+OP_COPY = 0x01
+OP_INSERT = 0x02
+
+BLOCK_SIZE = 64
+MIN_COPY = 32
+
+
+def crc32(data):
+    # 与 esp_rom_crc32_le(0, ...) 相同
+    return zlib.crc32(data) & 0xFFFFFFFF
+
+
+def build_index(source):
+    # 源固件按 BLOCK_SIZE 对齐分块建立索引，目标固件逐字节查找
+    index = {}
+    for offset in range(0, len(source) - BLOCK_SIZE + 1, BLOCK_SIZE):
+        index.setdefault(source[offset:offset + BLOCK_SIZE], offset)
+    return index
+
+
+def diff(source, target):
+    index = build_index(source)
+    ops = []
+    insert_start = 0
+    position = 0
+    while position + BLOCK_SIZE <= len(target):
+        source_offset = index.get(target[position:position + BLOCK_SIZE])
+        if source_offset is None:
+            position += 1
+            continue
+
+        # 向前后扩展匹配区域
+        start, source_start = position, source_offset
+        while start > insert_start and source_start > 0 and target[start - 1] == source[source_start - 1]:
+            start -= 1
+            source_start -= 1
+        end, source_end = position + BLOCK_SIZE, source_offset + BLOCK_SIZE
+        while end < len(target) and source_end < len(source) and target[end] == source[source_end]:
+            end += 1
+            source_end += 1
+
+        if end - start < MIN_COPY:
+            position += 1
+            continue
+        if start > insert_start:
+            ops.append((OP_INSERT, target[insert_start:start]))
+        ops.append((OP_COPY, source_start, end - start))
+        insert_start = position = end
+
+    if insert_start < len(target):
+        ops.append((OP_INSERT, target[insert_start:]))
+    return ops
+
+
+def encode(source, target, ops):
+    output = bytearray(b"XZD1")
+    output += struct.pack("<IIII", len(source), crc32(source), len(target), crc32(target))
+    for op in ops:
+        if op[0] == OP_COPY:
+            output += struct.pack("<BII", OP_COPY, op[1], op[2])
+        else:
+            output += struct.pack("<BI", OP_INSERT, len(op[1]))
+            output += op[1]
+    output += bytes([OP_END])
+    return bytes(output)
+
+
+def apply(source, patch):
+    # 按设备端的规则解码一遍，确认补丁正确
+    source_size, source_crc, target_size, target_crc = struct.unpack_from("<IIII", patch, 4)
+    assert patch[:4] == b"XZD1" and source_size == len(source) and source_crc == crc32(source)
+    target = bytearray()
+    position = 20
+    while patch[position] != OP_END:
+        if patch[position] == OP_COPY:
+            offset, length = struct.unpack_from("<II", patch, position + 1)
+            target += source[offset:offset + length]
+            position += 9
+        else:
+            length, = struct.unpack_from("<I", patch, position + 1)
+            target += patch[position + 5:position + 5 + length]
+            position += 5 + length
+    assert len(target) == target_size and crc32(target) == target_crc
+    return bytes(target)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='生成差分升级补丁')
+    parser.add_argument('source', help='设备上正在运行的固件')
+    parser.add_argument('target', help='新固件')
+    parser.add_argument('output', help='输出的补丁文件')
+    args = parser.parse_args()
+
+    with open(args.source, 'rb') as f:
+        source = f.read()
+    with open(args.target, 'rb') as f:
+        target = f.read()
+
+    ops = diff(source, target)
+    patch = encode(source, target, ops)
+    if apply(source, patch) != target:
+        print("Patch verification failed")
+        sys.exit(1)
+
+    with open(args.output, 'wb') as f:
+        f.write(patch)
+    copied = sum(op[2] for op in ops if op[0] == OP_COPY)
+    print(f"{args.output}: {len(patch)} bytes ({len(patch) * 100 / len(target):.1f}% of {len(target)}), "
+          f"{copied} bytes copied from source, {len(ops)} ops")
+
+
+if __name__ == "__main__":
+    main()
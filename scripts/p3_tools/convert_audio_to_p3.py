@@ -1,14 +1,14 @@
 # convert audio files to protocol v3 stream
 import librosa
 import opuslib
-import struct
 import sys
 import tqdm
 import numpy as np
 import argparse
 import pyloudnorm as pyln
+from p3_format import write_p3
 
-def encode_audio_to_opus(input_file, output_file, target_lufs=None):
+def encode_audio_to_opus(input_file, output_file, target_lufs=None, indexed=False):
     # Load audio file using librosa
     audio, sample_rate = librosa.load(input_file, sr=None, mono=False, dtype=np.float32)
     
@@ -39,14 +39,14 @@ def encode_audio_to_opus(input_file, output_file, target_lufs=None):
     encoder = opuslib.Encoder(sample_rate, 1, opuslib.APPLICATION_AUDIO)
 
     # Encode and save
+    duration = 60  # 60ms per frame
+    frame_size = int(sample_rate * duration / 1000)
+    frames = []
+    for i in tqdm.tqdm(range(0, len(audio) - frame_size, frame_size)):
+        frame = audio[i:i + frame_size]
+        frames.append(encoder.encode(frame.tobytes(), frame_size=frame_size))
     with open(output_file, 'wb') as f:
-        duration = 60  # 60ms per frame
-        frame_size = int(sample_rate * duration / 1000)
-        for i in tqdm.tqdm(range(0, len(audio) - frame_size, frame_size)):
-            frame = audio[i:i + frame_size]
-            opus_data = encoder.encode(frame.tobytes(), frame_size=frame_size)
-            packet = struct.pack('>BBH', 0, 0, len(opus_data)) + opus_data
-            f.write(packet)
+        write_p3(f, frames, sample_rate, duration, indexed)
 
 if __name__ == "__main__":
     parser = argparse.ArgumentParser(description='Convert audio to Opus with loudness normalization')
@@ -56,7 +56,9 @@ if __name__ == "__main__":
                        help='Target loudness in LUFS (default: -16)')
     parser.add_argument('-d', '--disable-loudnorm', action='store_true',
                        help='Disable loudness normalization')
+    parser.add_argument('-i', '--indexed', action='store_true',
+                       help='Write p3 v2 with a seek table (for long audio)')
     args = parser.parse_args()
 
     target_lufs = None if args.disable_loudnorm else args.lufs
-    encode_audio_to_opus(args.input_file, args.output_file, target_lufs)
\ No newline at end of file
+    encode_audio_to_opus(args.input_file, args.output_file, target_lufs, args.indexed)
\ No newline at end of file
@@ -0,0 +1,48 @@
+# convert p3 stream to raw 16-bit little-endian mono PCM for embedding
+import argparse
+import sys
+import opuslib
+import numpy as np
+from p3_format import P3Reader
+
+# Opus 解码器可以直接输出的采样率
+OPUS_SAMPLE_RATES = (8000, 12000, 16000, 24000, 48000)
+
+
+def decode_p3_to_pcm(input_file, output_file, sample_rate):
+    pcm_frames = []
+    with open(input_file, "rb") as f:
+        reader = P3Reader(f)
+        decode_rate = sample_rate if sample_rate in OPUS_SAMPLE_RATES else reader.sample_rate
+        decoder = opuslib.Decoder(decode_rate, 1)
+        frame_size = int(decode_rate * reader.frame_duration / 1000)
+        for opus_data in reader:
+            pcm = decoder.decode(opus_data, frame_size)
+            pcm_frames.append(np.frombuffer(pcm, dtype=np.int16))
+
+    if not pcm_frames:
+        raise ValueError(f"No valid audio data found in {input_file}")
+    pcm_data = np.concatenate(pcm_frames)
+
+    if decode_rate != sample_rate:
+        import librosa
+        audio = librosa.resample(pcm_data.astype(np.float32) / 32768, orig_sr=decode_rate, target_sr=sample_rate)
+        pcm_data = np.clip(audio * 32768, -32768, 32767).astype(np.int16)
+
+    with open(output_file, "wb") as f:
+        f.write(pcm_data.astype("<i2").tobytes())
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Decode p3 to raw PCM at the board output sample rate")
+    parser.add_argument("input_file", help="Input p3 file")
+    parser.add_argument("output_file", help="Output raw PCM file (s16le, mono)")
+    parser.add_argument("-r", "--rate", type=int, default=16000,
+                        help="Output sample rate (default: 16000)")
+    args = parser.parse_args()
+
+    try:
+        decode_p3_to_pcm(args.input_file, args.output_file, args.rate)
+    except ValueError as e:
+        print(e, file=sys.stderr)
+        sys.exit(1)
@@ -0,0 +1,94 @@
+# p3 文件的读写
+# v1: 每帧 [1字节类型, 1字节保留, 2字节长度] + Opus 数据，采样率固定 16000Hz，帧长 60ms
+# v2: 文件头 + 每帧的偏移表 + 连续的 Opus 数据，可以直接定位任意一帧
+#     头部: "P3V2", 版本(1), 保留(1), 帧长ms(2), 采样率(4), 帧数(4), 第一帧偏移(4)
+#     偏移表: 帧数 + 1 个 uint32，相对第一帧，最后一项为数据总长度
+#     所有字段为大端序
+import struct
+
+P3_V2_MAGIC = b"P3V2"
+P3_V2_HEADER = ">4sBBHIII"
+P3_V2_HEADER_SIZE = struct.calcsize(P3_V2_HEADER)
+
+
+def write_p3(f, frames, sample_rate=16000, frame_duration=60, indexed=False):
+    """写入 Opus 帧列表，indexed 为 True 时写 v2"""
+    if not indexed:
+        for opus_data in frames:
+            f.write(struct.pack(">BBH", 0, 0, len(opus_data)) + opus_data)
+        return
+
+    data_offset = P3_V2_HEADER_SIZE + 4 * (len(frames) + 1)
+    f.write(struct.pack(P3_V2_HEADER, P3_V2_MAGIC, 2, 0, frame_duration,
+                        sample_rate, len(frames), data_offset))
+    offset = 0
+    for opus_data in frames:
+        f.write(struct.pack(">I", offset))
+        offset += len(opus_data)
+    f.write(struct.pack(">I", offset))
+    for opus_data in frames:
+        f.write(opus_data)
+
+
+class P3Reader:
+    """读取 v1 或 v2 的 p3 文件，v2 可以按毫秒定位"""
+
+    def __init__(self, f):
+        self.f = f
+        self.sample_rate = 16000
+        self.frame_duration = 60
+        self.offsets = None
+        header = f.read(P3_V2_HEADER_SIZE)
+        if len(header) == P3_V2_HEADER_SIZE and header[:4] == P3_V2_MAGIC:
+            _, version, _, self.frame_duration, self.sample_rate, count, data_offset = \
+                struct.unpack(P3_V2_HEADER, header)
+            if version != 2:
+                raise ValueError(f"Unsupported p3 version {version}")
+            self.offsets = struct.unpack(f">{count + 1}I", f.read(4 * (count + 1)))
+            self.data_offset = data_offset
+            self.index = 0
+        else:
+            f.seek(0)
+
+    @property
+    def indexed(self):
+        return self.offsets is not None
+
+    @property
+    def frame_count(self):
+        return len(self.offsets) - 1 if self.indexed else None
+
+    def seek_ms(self, ms):
+        """跳到 ms 所在的帧，v1 需要逐帧跳过"""
+        index = int(ms // self.frame_duration)
+        if self.indexed:
+            self.index = min(index, self.frame_count)
+            return
+        for _ in range(index):
+            if self.read_frame() is None:
+                break
+
+    def read_frame(self):
+        """返回下一帧的 Opus 数据，结束时返回 None"""
+        if self.indexed:
+            if self.index >= self.frame_count:
+                return None
+            start, end = self.offsets[self.index], self.offsets[self.index + 1]
+            self.index += 1
+            self.f.seek(self.data_offset + start)
+            opus_data = self.f.read(end - start)
+            return opus_data if len(opus_data) == end - start else None
+
+        header = self.f.read(4)
+        if len(header) < 4:
+            return None
+        _, _, opus_len = struct.unpack(">BBH", header)
+        opus_data = self.f.read(opus_len)
+        return opus_data if len(opus_data) == opus_len else None
+
+    def __iter__(self):
+        while True:
+            opus_data = self.read_frame()
+            if opus_data is None:
+                return
+            yield opus_data
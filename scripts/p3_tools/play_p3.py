@@ -1,71 +1,62 @@
 # 播放p3格式的音频文件
 import opuslib
-import struct
 import numpy as np
 import sounddevice as sd
 import argparse
+from p3_format import P3Reader
 
-def play_p3_file(input_file):
+def play_p3_file(input_file, start_seconds=0):
     """
     播放p3格式的音频文件
-    p3格式: [1字节类型, 1字节保留, 2字节长度, Opus数据]
+    v1: [1字节类型, 1字节保留, 2字节长度, Opus数据] 的序列
+    v2: 带文件头和偏移表，见 p3_format.py
     """
-    # 初始化Opus解码器
-    sample_rate = 16000  # 采样率固定为16000Hz
-    channels = 1  # 单声道
-    decoder = opuslib.Decoder(sample_rate, channels)
-    
-    # 帧大小 (60ms)
-    frame_size = int(sample_rate * 60 / 1000)
-    
-    # 打开音频流
-    stream = sd.OutputStream(
-        samplerate=sample_rate,
-        channels=channels,
-        dtype='int16'
-    )
-    stream.start()
-    
-    try:
-        with open(input_file, 'rb') as f:
+    with open(input_file, 'rb') as f:
+        reader = P3Reader(f)
+        sample_rate = reader.sample_rate
+        channels = 1  # 单声道
+        # 初始化Opus解码器
+        decoder = opuslib.Decoder(sample_rate, channels)
+        frame_size = int(sample_rate * reader.frame_duration / 1000)
+
+        if reader.indexed:
+            print(f"p3 v2: {reader.frame_count} 帧, {reader.frame_count * reader.frame_duration / 1000:.1f} 秒")
+        if start_seconds > 0:
+            reader.seek_ms(start_seconds * 1000)
+
+        # 打开音频流
+        stream = sd.OutputStream(
+            samplerate=sample_rate,
+            channels=channels,
+            dtype='int16'
+        )
+        stream.start()
+        try:
             print(f"正在播放: {input_file}")
-            
-            while True:
-                # 读取头部 (4字节)
-                header = f.read(4)
-                if not header or len(header) < 4:
-                    break
-                
-                # 解析头部
-                packet_type, reserved, data_len = struct.unpack('>BBH', header)
-                
-                # 读取Opus数据
-                opus_data = f.read(data_len)
-                if not opus_data or len(opus_data) < data_len:
-                    break
-                
+            for opus_data in reader:
                 # 解码Opus数据
                 pcm_data = decoder.decode(opus_data, frame_size)
-                
+
                 # 将字节转换为numpy数组
                 audio_array = np.frombuffer(pcm_data, dtype=np.int16)
-                
+
                 # 播放音频
                 stream.write(audio_array)
-                
-    except KeyboardInterrupt:
-        print("\n播放已停止")
-    finally:
-        stream.stop()
-        stream.close()
-        print("播放完成")
+
+        except KeyboardInterrupt:
+            print("\n播放已停止")
+        finally:
+            stream.stop()
+            stream.close()
+            print("播放完成")
 
 def main():
     parser = argparse.ArgumentParser(description='播放p3格式的音频文件')
     parser.add_argument('input_file', help='输入的p3文件路径')
+    parser.add_argument('-s', '--start', type=float, default=0, help='从第几秒开始播放')
     args = parser.parse_args()
     
-    play_p3_file(args.input_file)
+    play_p3_file(args.input_file, args.start)
 
 if __name__ == "__main__":
     main() 
@@ -0,0 +1,218 @@
+import sys
+import json
+import time
+import base64
+import random
+import socket
+import struct
+import argparse
+
+'''
+  录制和回放设备的下行流量，配合设备的 CONFIG_USE_PROTOCOL_TRACE 使用，数据报格式见 main/protocols/protocol_trace.cc。
+
+  录制（设备正常连接服务器对话，Ctrl+C 停止）:
+    python protocol_trace.py record --port 8001 --output field.jsonl
+  回放到设备（设备待命即可，不需要连接服务器，trace 中的 tts start 消息会把设备切到说话状态）:
+    python protocol_trace.py replay field.jsonl --device 192.168.2.50 --speed 1.0
+  查看到达间隔的抖动和丢包:
+    python protocol_trace.py stats field.jsonl
+
+  trace 文件每行一条消息: {"t": 相对时间秒, "type": "audio"|"text"|"control", ...}
+  回放时可以用 --loss / --jitter 在原有抖动上叠加固定种子的随机丢包和延迟，结果可以重复
+'''
+
+HEADER = struct.Struct('<4sBBBBII')
+AUDIO_HEADER = struct.Struct('<IHHII')
+MAGIC = b'XZTR'
+VERSION = 1
+MTU = 1400
+MAX_FRAGMENT = MTU - HEADER.size
+TYPES = {1: 'audio', 2: 'text', 3: 'control'}
+TYPE_IDS = {name: type_id for type_id, name in TYPES.items()}
+# 回放时默认跳过的 JSON 消息，会在设备上执行工具调用或修改设置
+DEFAULT_EXCLUDE = 'mcp,iot'
+
+
+def decode(type_id, body):
+    message = {'type': TYPES[type_id]}
+    if type_id == 1:
+        sample_rate, frame_duration, _, timestamp, sequence = AUDIO_HEADER.unpack_from(body)
+        message.update(sample_rate=sample_rate, frame_duration=frame_duration, timestamp=timestamp,
+                       sequence=sequence, payload=base64.b64encode(body[AUDIO_HEADER.size:]).decode())
+    elif type_id == 2:
+        message['text'] = body.decode('utf-8', 'replace')
+    else:
+        message['payload'] = base64.b64encode(body).decode()
+    return message
+
+
+def encode(message):
+    if message['type'] == 'audio':
+        return AUDIO_HEADER.pack(message['sample_rate'], message['frame_duration'], 0,
+                                 message['timestamp'], message['sequence']) + base64.b64decode(message['payload'])
+    if message['type'] == 'text':
+        return message['text'].encode('utf-8')
+    return base64.b64decode(message['payload'])
+
+
+def record(port, output):
+    server_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    server_socket.bind(('0.0.0.0', port))
+    print(f"Recording downlink traffic on 0.0.0.0:{port}...")
+    start = None
+    last_device_us = None
+    device_time = 0
+    fragments = {}
+    count = 0
+    with open(output, 'w') as f:
+        try:
+            while True:
+                data, _ = server_socket.recvfrom(2048)
+                if len(data) < HEADER.size:
+                    continue
+                magic, version, type_id, fragment, fragment_count, sequence, timestamp_us = HEADER.unpack_from(data)
+                if magic != MAGIC or version != VERSION or type_id not in TYPES:
+                    continue
+                parts = fragments.setdefault(sequence, {})
+                parts[fragment] = data[HEADER.size:]
+                if len(parts) < fragment_count:
+                    continue
+                body = b''.join(parts[i] for i in range(fragment_count))
+                del fragments[sequence]
+                # 设备的接收时间，32 位微秒展开后作为时间轴，不受主机接收抖动影响
+                if last_device_us is not None:
+                    device_time += (timestamp_us - last_device_us) & 0xFFFFFFFF
+                last_device_us = timestamp_us
+                if start is None:
+                    start = device_time
+                message = {'t': round((device_time - start) / 1000000, 6)}
+                message.update(decode(type_id, body))
+                f.write(json.dumps(message, ensure_ascii=False) + '\n')
+                count += 1
+                if count % 100 == 0:
+                    print(f"Recorded {count} messages")
+        except KeyboardInterrupt:
+            print(f"\nSaved {count} messages to {output}")
+        finally:
+            server_socket.close()
+
+
+def load(path):
+    with open(path) as f:
+        return [json.loads(line) for line in f if line.strip()]
+
+
+def text_type(message):
+    try:
+        return json.loads(message['text']).get('type')
+    except ValueError:
+        return None
+
+
+def replay(path, device, port, speed, loss, jitter_ms, seed, exclude):
+    messages = load(path)
+    excluded = set(filter(None, exclude.split(',')))
+    rng = random.Random(seed)
+    # 先算出每条消息的发送时间再排序，叠加的延迟可以让消息乱序，和现场一样
+    schedule = []
+    for index, message in enumerate(messages):
+        if message['type'] == 'text' and text_type(message) in excluded:
+            continue
+        if message['type'] == 'audio' and rng.random() < loss:
+            continue
+        delay = rng.uniform(0, jitter_ms / 1000) if message['type'] == 'audio' and jitter_ms > 0 else 0
+        schedule.append((message['t'] / speed + delay, index, message))
+    schedule.sort(key=lambda item: (item[0], item[1]))
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    print(f"Replaying {len(schedule)} of {len(messages)} messages to {device}:{port} at {speed}x")
+    start = time.monotonic()
+    for sequence, (send_time, _, message) in enumerate(schedule):
+        wait = start + send_time - time.monotonic()
+        if wait > 0:
+            time.sleep(wait)
+        body = encode(message)
+        fragment_count = max(1, (len(body) + MAX_FRAGMENT - 1) // MAX_FRAGMENT)
+        timestamp_us = int(send_time * 1000000) & 0xFFFFFFFF
+        for fragment in range(fragment_count):
+            chunk = body[fragment * MAX_FRAGMENT:(fragment + 1) * MAX_FRAGMENT]
+            header = HEADER.pack(MAGIC, VERSION, TYPE_IDS[message['type']], fragment, fragment_count,
+                                 sequence, timestamp_us)
+            sock.sendto(header + chunk, (device, port))
+    sock.close()
+    print(f"Done in {time.monotonic() - start:.1f}s")
+
+
+def percentile(values, p):
+    if not values:
+        return 0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def stats(path):
+    messages = load(path)
+    audio = [m for m in messages if m['type'] == 'audio']
+    texts = {}
+    for message in messages:
+        if message['type'] == 'text':
+            texts[text_type(message)] = texts.get(text_type(message), 0) + 1
+    print(f"messages: {len(messages)}, audio packets: {len(audio)}, "
+          f"control: {sum(1 for m in messages if m['type'] == 'control')}")
+    print("text messages: " + ', '.join(f"{name}={count}" for name, count in sorted(texts.items(), key=str)))
+    if len(audio) < 2:
+        return
+
+    # 抖动 = 实际到达间隔与帧长之差，连续的 TTS 段之间的长停顿不计入
+    intervals = []
+    for previous, current in zip(audio, audio[1:]):
+        interval = (current['t'] - previous['t']) * 1000
+        if interval < 1000:
+            intervals.append(interval - current['frame_duration'])
+    sequenced = [m['sequence'] for m in audio if m['sequence'] != 0]
+    lost = reordered = 0
+    for previous, current in zip(sequenced, sequenced[1:]):
+        if current > previous + 1:
+            lost += current - previous - 1
+        elif current <= previous:
+            reordered += 1
+    print(f"arrival jitter ms: p50 {percentile(intervals, 50):.1f}, p95 {percentile(intervals, 95):.1f}, "
+          f"p99 {percentile(intervals, 99):.1f}, max {max(intervals, default=0):.1f}")
+    if sequenced:
+        print(f"sequence: lost {lost}, late or reordered {reordered}")
+    else:
+        print("sequence: transport has no sequence numbers (WebSocket)")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='录制和回放设备的下行协议流量')
+    commands = parser.add_subparsers(dest='command', required=True)
+
+    record_parser = commands.add_parser('record', help='接收设备发送的下行消息并保存')
+    record_parser.add_argument('--port', '-p', type=int, default=8001, help='监听端口 (默认: 8001)')
+    record_parser.add_argument('--output', '-o', default='protocol_trace.jsonl', help='输出文件')
+
+    replay_parser = commands.add_parser('replay', help='把 trace 发回设备')
+    replay_parser.add_argument('trace', help='trace 文件')
+    replay_parser.add_argument('--device', '-d', required=True, help='设备 IP')
+    replay_parser.add_argument('--port', '-p', type=int, default=8002, help='设备回放端口 (默认: 8002)')
+    replay_parser.add_argument('--speed', type=float, default=1.0, help='回放速度倍数 (默认: 1.0)')
+    replay_parser.add_argument('--loss', type=float, default=0.0, help='额外的音频丢包率 0~1')
+    replay_parser.add_argument('--jitter', type=float, default=0.0, help='额外的音频随机延迟上限，毫秒')
+    replay_parser.add_argument('--seed', type=int, default=1, help='随机种子 (默认: 1)')
+    replay_parser.add_argument('--exclude', default=DEFAULT_EXCLUDE,
+                               help=f'跳过的 JSON 消息类型，逗号分隔 (默认: {DEFAULT_EXCLUDE})')
+
+    stats_parser = commands.add_parser('stats', help='统计到达间隔抖动和丢包')
+    stats_parser.add_argument('trace', help='trace 文件')
+
+    args = parser.parse_args()
+    if args.command == 'record':
+        record(args.port, args.output)
+    elif args.command == 'replay':
+        if args.speed <= 0:
+            print("Speed must be positive", file=sys.stderr)
+            sys.exit(1)
+        replay(args.trace, args.device, args.port, args.speed, args.loss, args.jitter, args.seed, args.exclude)
+    else:
+        stats(args.trace)
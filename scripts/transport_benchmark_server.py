@@ -0,0 +1,228 @@
+import argparse
+import asyncio
+import json
+import os
+import socket
+import sys
+import threading
+import uuid
+
+
+'''
+  传输层基准测试服务器，配合固件的 self.transport_benchmark.* MCP 工具使用（需要开启 CONFIG_ENABLE_TRANSPORT_BENCHMARK）。
+  设备连上后回复 hello，通过 MCP 触发基准测试，原样回传设备发来的音频包，测试结束后取回结果。
+  返回码非 0 表示结果超出 --max-loss / --max-rtt 门限，可以用来卡固件发布。
+
+  WebSocket（协议版本 1~4）:
+    python transport_benchmark_server.py websocket --port 8765
+    设备的 websocket url 设置为 ws://<host>:8765/
+
+  MQTT + UDP（需要 paho-mqtt）:
+    python transport_benchmark_server.py mqtt --broker <host> --device-topic devices/<client_id> --server-topic <publish topic>
+    设备 publish 的 topic 即 --server-topic，服务器回复发到 --device-topic
+'''
+
+START_REQUEST_ID = 1
+RESULT_REQUEST_ID = 2
+
+
+def mcp_message(session_id, request_id, name, arguments):
+    return json.dumps({
+        "session_id": session_id,
+        "type": "mcp",
+        "payload": {
+            "jsonrpc": "2.0",
+            "id": request_id,
+            "method": "tools/call",
+            "params": {"name": name, "arguments": arguments},
+        },
+    })
+
+
+def parse_tool_result(payload):
+    # tools/call 的结果放在 content[0].text 中
+    result = payload.get("result", {})
+    for item in result.get("content", []):
+        if item.get("type") == "text":
+            try:
+                return json.loads(item["text"])
+            except (ValueError, KeyError):
+                return None
+    return None
+
+
+def check_result(result, args):
+    print(json.dumps(result, indent=2, ensure_ascii=False))
+    sent = result.get("sent", 0) - result.get("send_failed", 0)
+    loss = result.get("lost", 0) / sent * 100 if sent > 0 else 100
+    rtt = result.get("rtt_ms", {}).get("avg")
+    print(f"loss {loss:.2f}%, avg rtt {rtt} ms")
+    ok = True
+    if args.max_loss is not None and loss > args.max_loss:
+        print(f"FAIL: loss {loss:.2f}% > {args.max_loss}%")
+        ok = False
+    if args.max_rtt is not None and (rtt is None or rtt > args.max_rtt):
+        print(f"FAIL: avg rtt {rtt} ms > {args.max_rtt} ms")
+        ok = False
+    return ok
+
+
+class Benchmark:
+    def __init__(self, args, send_text):
+        self.args = args
+        self.send_text = send_text
+        self.session_id = str(uuid.uuid4())
+        self.result = None
+        self.done = asyncio.Event()
+
+    def start_arguments(self):
+        return {"frames_per_second": self.args.fps, "duration": self.args.duration}
+
+    async def run(self):
+        await self.send_text(mcp_message(self.session_id, START_REQUEST_ID,
+                                         "self.transport_benchmark.start", self.start_arguments()))
+        print(f"Benchmark started: {self.args.fps} fps, {self.args.duration} s")
+        # 设备发送结束后还要等待 2 秒回包
+        await asyncio.sleep(self.args.duration + 4)
+        await self.send_text(mcp_message(self.session_id, RESULT_REQUEST_ID,
+                                         "self.transport_benchmark.get_result", {}))
+        try:
+            await asyncio.wait_for(self.done.wait(), timeout=10)
+        except asyncio.TimeoutError:
+            print("Timeout waiting for benchmark result")
+
+    def on_text(self, message):
+        if message.get("type") != "mcp":
+            return
+        payload = message.get("payload", {})
+        if payload.get("id") == RESULT_REQUEST_ID:
+            self.result = parse_tool_result(payload)
+            self.done.set()
+
+
+async def run_websocket(args):
+    import websockets
+
+    finished = asyncio.get_running_loop().create_future()
+
+    async def handler(websocket, path=None):
+        headers = getattr(websocket, "request_headers", None) or websocket.request.headers
+        version = headers.get("Protocol-Version", "1")
+        print(f"Device {headers.get('Device-Id')} connected, protocol version {version}")
+        benchmark = Benchmark(args, websocket.send)
+        task = None
+        received = 0
+        async for data in websocket:
+            if isinstance(data, bytes):
+                # 版本 1~4 的二进制包原样回传，设备按同样的格式解析
+                received += 1
+                await websocket.send(data)
+                continue
+            message = json.loads(data)
+            if message.get("type") == "hello":
+                await websocket.send(json.dumps({
+                    "type": "hello",
+                    "transport": "websocket",
+                    "session_id": benchmark.session_id,
+                    "audio_params": {"sample_rate": 16000, "frame_duration": 60},
+                }))
+                if task is None:
+                    task = asyncio.create_task(benchmark.run())
+            else:
+                benchmark.on_text(message)
+                if benchmark.done.is_set() and not finished.done():
+                    print(f"Echoed {received} packets")
+                    finished.set_result(benchmark.result)
+
+    async with websockets.serve(handler, "0.0.0.0", args.port, max_size=None):
+        print(f"Benchmark server listening on ws://0.0.0.0:{args.port}/")
+        return await finished
+
+
+def udp_echo(sock):
+    # 加密的包原样回传，设备用包头作为 nonce 可以直接解密
+    while True:
+        data, address = sock.recvfrom(2048)
+        sock.sendto(data, address)
+
+
+async def run_mqtt(args):
+    import paho.mqtt.client as mqtt
+
+    loop = asyncio.get_running_loop()
+    udp = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    udp.bind(("0.0.0.0", args.udp_port))
+    threading.Thread(target=udp_echo, args=(udp,), daemon=True).start()
+
+    client = mqtt.Client()
+    if args.username:
+        client.username_pw_set(args.username, args.password)
+
+    async def send_text(text):
+        client.publish(args.device_topic, text)
+
+    benchmark = Benchmark(args, send_text)
+
+    def on_message(client, userdata, msg):
+        message = json.loads(msg.payload)
+        if message.get("type") == "hello":
+            nonce = "01000000" + os.urandom(12).hex()
+            client.publish(args.device_topic, json.dumps({
+                "type": "hello",
+                "transport": "udp",
+                "session_id": benchmark.session_id,
+                "audio_params": {"sample_rate": 16000, "frame_duration": 60},
+                "udp": {
+                    "server": args.udp_host,
+                    "port": args.udp_port,
+                    "key": os.urandom(16).hex(),
+                    "nonce": nonce,
+                },
+            }))
+            loop.call_soon_threadsafe(lambda: asyncio.ensure_future(benchmark.run()))
+        else:
+            loop.call_soon_threadsafe(benchmark.on_text, message)
+
+    client.on_message = on_message
+    client.connect(args.broker, args.broker_port)
+    client.subscribe(args.server_topic)
+    client.loop_start()
+    print(f"Waiting for device hello on {args.server_topic}, UDP echo on {args.udp_host}:{args.udp_port}")
+    await benchmark.done.wait()
+    client.publish(args.device_topic, json.dumps({"type": "goodbye", "session_id": benchmark.session_id}))
+    client.loop_stop()
+    return benchmark.result
+
+
+def main():
+    parser = argparse.ArgumentParser(description='传输层基准测试服务器，回传设备发来的音频包并汇总测试结果')
+    parser.add_argument('--fps', type=int, default=17, help='每秒发送的包数 (默认: 17，即 60ms 帧实时速率)')
+    parser.add_argument('--duration', type=int, default=30, help='测试时长，秒 (默认: 30)')
+    parser.add_argument('--max-loss', type=float, default=None, help='允许的最大丢包率，百分比')
+    parser.add_argument('--max-rtt', type=float, default=None, help='允许的最大平均 RTT，毫秒')
+    subparsers = parser.add_subparsers(dest='transport', required=True)
+
+    ws = subparsers.add_parser('websocket', help='WebSocket 协议版本 1~4')
+    ws.add_argument('--port', type=int, default=8765, help='监听端口 (默认: 8765)')
+
+    mq = subparsers.add_parser('mqtt', help='MQTT + UDP')
+    mq.add_argument('--broker', required=True, help='MQTT broker 地址')
+    mq.add_argument('--broker-port', type=int, default=1883, help='MQTT broker 端口 (默认: 1883)')
+    mq.add_argument('--username', default=None)
+    mq.add_argument('--password', default=None)
+    mq.add_argument('--server-topic', required=True, help='设备 publish 的 topic')
+    mq.add_argument('--device-topic', required=True, help='设备订阅的 topic')
+    mq.add_argument('--udp-host', required=True, help='设备可以访问的本机地址')
+    mq.add_argument('--udp-port', type=int, default=8884, help='UDP 回传端口 (默认: 8884)')
+
+    args = parser.parse_args()
+    runner = run_websocket if args.transport == 'websocket' else run_mqtt
+    result = asyncio.run(runner(args))
+    if result is None:
+        print("No benchmark result received")
+        sys.exit(2)
+    sys.exit(0 if check_result(result, args) else 1)
+
+
+if __name__ == "__main__":
+    main()